@@ -39,7 +39,6 @@ from __future__ import division, print_function
 # Import Python modules
 import os
 import sys
-import time
 
 instance = None
 
@@ -105,45 +104,63 @@ class GMSVToolKitConfig(object):
         self.SRC_DIR = os.path.join(self.GMSVTOOLKIT_ROOT, "src")
         self.PLOT_DATA_DIR = os.path.join(self.GMSVTOOLKIT_ROOT, "plots", "data")
 
-        #
-        # Read GMSVToolkit version
-        #
-        version_file = open(os.path.join(self.GMSVTOOLKIT_DIR, "version.txt"), 'r')
-        self.VERSION = version_file.readline().strip()
-        version_file.close()
-
         #
         # Acceptance and Unit Test Directories
         #
         self.TEST_REF_DIR = os.path.join(self.TEST_DIR, "ref_data")
 
-        #
-        # GP Directories
-        #
-        self.GP_BIN_DIR = os.path.join(self.SRC_DIR, "gp", "bin")
-        if not os.path.exists(self.GP_BIN_DIR):
-            print("Can't find GP bin directory %s." % (self.GP_BIN_DIR))
-            print("Did you successfully build the executables?")
-            print("If not, please run make in %s." % (self.SRC_DIR))
-            sys.exit(3)
+        # The version and the bin directories are only looked at when a
+        # module asks for them, see the properties below, so a module
+        # that never runs a GP, UCB or USGS program does not pay for
+        # (or fail on) the checks of the others
+        self._version = None
+        self._bin_dirs = {}
 
-        #
-        # UCB Directories
-        #
-        self.UCB_BIN_DIR = os.path.join(self.SRC_DIR, "ucb", "rotd50")
-        if not os.path.exists(self.UCB_BIN_DIR):
-            print("Can't find UCB bin directory %s." % (self.UCB_BIN_DIR))
-            print("Did you successfully build the executables?")
-            print("If not, please run make in %s." % (self.SRC_DIR))
-            sys.exit(3)
+    def _bin_dir(self, name, bin_dir):
+        """
+        Returns bin_dir, the bin directory of the name codes, after
+        making sure (once) that it exists
+        """
+        if name not in self._bin_dirs:
+            if not os.path.exists(bin_dir):
+                print("Can't find %s bin directory %s." % (name, bin_dir))
+                print("Did you successfully build the executables?")
+                print("If not, please run make in %s." % (self.SRC_DIR))
+                sys.exit(3)
+            self._bin_dirs[name] = bin_dir
+        return self._bin_dirs[name]
+
+    @property
+    def VERSION(self):
+        """
+        GMSVToolkit version, from version.txt
+        """
+        if self._version is None:
+            version_file = open(os.path.join(self.GMSVTOOLKIT_DIR,
+                                             "version.txt"), 'r')
+            self._version = version_file.readline().strip()
+            version_file.close()
+        return self._version
+
+    @property
+    def GP_BIN_DIR(self):
+        """
+        GP Directories
+        """
+        return self._bin_dir("GP", os.path.join(self.SRC_DIR, "gp", "bin"))
 
-        #
-        # USGS Directories
-        #
-        self.USGS_BIN_DIR = os.path.join(self.SRC_DIR, "usgs", "bin")
-        if not os.path.exists(self.USGS_BIN_DIR):
-            print("Can't find USGS bin directory %s." %
-                  (self.USGS_BIN_DIR))
-            print("Did you successfully build the executables?")
-            print("If not, please run make in %s." % (self.SRC_DIR))
-            sys.exit(3)
+    @property
+    def UCB_BIN_DIR(self):
+        """
+        UCB Directories
+        """
+        return self._bin_dir("UCB", os.path.join(self.SRC_DIR,
+                                                 "ucb", "rotd50"))
+
+    @property
+    def USGS_BIN_DIR(self):
+        """
+        USGS Directories
+        """
+        return self._bin_dir("USGS", os.path.join(self.SRC_DIR,
+                                                  "usgs", "bin"))
@@ -39,6 +39,7 @@ import sys
 
 # Import Broadband modules
 from station import Station
+from utils.file_utilities import cached_read
 
 # Sets maximum allowed len for station name, code limits are:
 # jbsim: 64 characters
@@ -49,6 +50,59 @@ from station import Station
 # syn1D: 256 characters
 MAX_STATION_NAME_LEN = 15
 
+def parse_station_file(a_station_filename):
+    """
+    Parses a station list file, returns a tuple of (lon, lat, scode,
+    vs30, low_freq_corner, high_freq_corner) entries, with None for
+    the optional fields that are not in the file
+    """
+    entries = []
+    station_file = open(a_station_filename, "r")
+
+    # Read lines one by one
+    for line in station_file:
+        line = line.strip()
+        if not line:
+            continue
+        if line.startswith("#"):
+            continue
+        sta = line.split()
+
+        if len(sta) >= 3:
+            vs30 = None
+            low_freq_corner = None
+            high_freq_corner = None
+            if len(sta[2]) > MAX_STATION_NAME_LEN:
+                print("Error: station name %s too long!" % (sta[2]))
+                print("Maximum limit is %d!" % (MAX_STATION_NAME_LEN))
+                sys.exit(-1)
+            if len(sta) >= 4:
+                vs30 = int(float(sta[3]))
+            if len(sta) >= 6:
+                # We have lf and hf, make sure they are not zero!
+                if float(sta[4]) <= 0:
+                    print("warning: station %s has lf<=0, using 1e-15" %
+                          (sta[2]))
+                    low_freq_corner = 1.0e-15
+                else:
+                    low_freq_corner = float(sta[4])
+                if float(sta[5]) <= 0:
+                    print("warning: station %s has hf<=0, using 1e+15" %
+                          (sta[2]))
+                    high_freq_corner = 1.0e+15
+                else:
+                    high_freq_corner = float(sta[5])
+            entries.append((float(sta[0]), float(sta[1]), sta[2], vs30,
+                            low_freq_corner, high_freq_corner))
+    station_file.close()
+
+    # Error message if we weren't able to read any stations
+    if len(entries) == 0:
+        print("No stations read from station file :", a_station_filename)
+        sys.exit(-1)
+
+    return tuple(entries)
+
 class StationList(object):
     """
     Input Station List file and serve up stations infor as needed
@@ -63,60 +117,27 @@ class StationList(object):
             sys.exit(-1)
         self.a_station_filename = a_station_list
 
-        # Start with empty station list
-        self.site_list = []
-
-        # Open file
+        # Parse the file (or re-use an earlier parse of it), and make
+        # our own Station objects so callers can modify them
         try:
-            station_file = open(self.a_station_filename, "r")
+            entries = cached_read(self.a_station_filename,
+                                  parse_station_file)
         except OSError:
             print("Error opening station list file : ", a_station_list)
             sys.exit(-1)
-
-        # Read lines one by one
-        for line in station_file:
-            line = line.strip()
-            if not line:
-                continue
-            if line.startswith("#"):
-                continue
-            sta = line.split()
-
-            if len(sta) >= 3:
-                station = Station()
-                station.lon = float(sta[0])
-                station.lat = float(sta[1])
-                station.scode = sta[2]
-                if len(station.scode) > MAX_STATION_NAME_LEN:
-                    print("Error: station name %s too long!" % (station.scode))
-                    print("Maximum limit is %d!" % (MAX_STATION_NAME_LEN))
-                    sys.exit(-1)
-                if len(sta) >= 4:
-                    station.vs30 = int(float(sta[3]))
-                if len(sta) >= 6:
-                    # We have lf and hf, make sure they are not zero!
-                    if float(sta[4]) <= 0:
-                        print("warning: station %s has lf<=0, using 1e-15" %
-                              (sta[2]))
-                        station.low_freq_corner = 1.0e-15
-                    else:
-                        station.low_freq_corner = float(sta[4])
-                    if float(sta[5]) <= 0:
-                        print("warning: station %s has hf<=0, using 1e+15" %
-                              (sta[2]))
-                        station.high_freq_corner = 1.0e+15
-                    else:
-                        station.high_freq_corner = float(sta[5])
-                self.site_list.append(station)
-        # Remember to close the file
-        try:
-            station_file.close
-        except OSError:
-            print("Error closing station list file :", a_station_list)
-        # Error message if we weren't able to read any stations
-        if len(self.site_list) == 0:
-            print("No stations read from station file :", a_station_list)
-            sys.exit(-1)
+        self.site_list = []
+        for (lon, lat, scode, vs30, low_freq_corner,
+             high_freq_corner) in entries:
+            station = Station()
+            station.lon = lon
+            station.lat = lat
+            station.scode = scode
+            if vs30 is not None:
+                station.vs30 = vs30
+            if low_freq_corner is not None:
+                station.low_freq_corner = low_freq_corner
+                station.high_freq_corner = high_freq_corner
+            self.site_list.append(station)
 
     @staticmethod
     def build(stat_list, output_file):
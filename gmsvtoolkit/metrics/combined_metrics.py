@@ -0,0 +1,377 @@
+#!/usr/bin/env python
+"""
+BSD 3-Clause License
+
+Copyright (c) 2022, University of Southern California
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+Program to compute all the intensity measures of a 3-component
+acceleration record in one pass: PSa and RotD50/RotD100 (librotd),
+Fourier amplitude spectra (as smc2fs2), PGA/PGV/PGD (as integ_diff
+followed by wcc_getpeak) and significant duration (as wcc_duration).
+Each record is read once and the velocity, displacement and spectra
+are computed once and shared by the measures that need them. The
+results for a station go to a single .ims file
+"""
+from __future__ import division, print_function
+
+# Import Python modules
+import os
+import sys
+import glob
+import argparse
+import multiprocessing
+from multiprocessing.pool import ThreadPool
+import numpy as np
+
+# Import GMSVToolkit modules
+from core import constants
+from metrics import rotdlib
+from utils.file_utilities import read_file_bbp2
+from core.station_list import StationList
+from utils import os_utilities
+
+# Components of a bbp file, in column order
+COMPONENTS = ["N", "E", "Z"]
+
+def fas_frequencies(dt, npts, nfreq=100, flow=0.1, fhigh=50.0):
+    """
+    Log-spaced output frequencies of the FAS, from flow to the
+    smaller of fhigh and the Nyquist frequency
+    """
+    fhigh = min(fhigh, 0.5 / dt)
+    return np.logspace(np.log10(flow), np.log10(fhigh), nfreq)
+
+def ko_weights(fft_freqs, out_freqs, bandwidth):
+    """
+    Konno and Ohmachi weights, normalized, of the fft frequencies for
+    each output frequency (one row per output frequency). With a
+    bandwidth of 0 the rows linearly interpolate the spectrum instead
+    """
+    weights = np.zeros((len(out_freqs), len(fft_freqs)))
+    if bandwidth <= 0.0:
+        for idx, freq in enumerate(out_freqs):
+            jdx = min(max(np.searchsorted(fft_freqs, freq), 1),
+                      len(fft_freqs) - 1)
+            frac = ((freq - fft_freqs[jdx - 1]) /
+                    (fft_freqs[jdx] - fft_freqs[jdx - 1]))
+            weights[idx, jdx - 1] = 1.0 - frac
+            weights[idx, jdx] = frac
+        return weights
+    positive = fft_freqs > 0.0
+    for idx, freq in enumerate(out_freqs):
+        arg = np.zeros(len(fft_freqs))
+        arg[positive] = bandwidth * np.log10(fft_freqs[positive] / freq)
+        row = np.ones(len(fft_freqs))
+        nonzero = arg != 0.0
+        row[nonzero] = (np.sin(arg[nonzero]) / arg[nonzero]) ** 4
+        row[~positive] = 0.0
+        weights[idx] = row / np.sum(row)
+    return weights
+
+def significant_duration(acc, dt, pstart, pend):
+    """
+    Times at which the normalized Arias intensity (the running
+    integral of acc^2, accumulated as in wcc_duration) first exceeds
+    pstart and pend, and the duration between the two
+    """
+    husid = np.cumsum(acc * acc) * dt
+    if husid[-1] <= 0.0:
+        return -99.9, -99.9, 0.0
+    husid = husid / husid[-1]
+    t_start = np.argmax(husid > pstart) * dt
+    t_end = np.argmax(husid > pend) * dt
+    return t_start, t_end, t_end - t_start
+
+def compute_metrics(input_bbp_file, ko_bandwidth=40.0,
+                    percentiles=None, durations=((0.05, 0.75),
+                                                 (0.05, 0.95))):
+    """
+    Reads input_bbp_file (acceleration, cm/s/s) once and returns a
+    dictionary with all its intensity measures
+    """
+    # RotD50 and RotD100 always come first, as in the rotd100 output
+    all_percentiles = [50, 100]
+    if percentiles is not None:
+        all_percentiles.extend([percentile for percentile in percentiles
+                                if percentile not in all_percentiles])
+
+    time, acc_n, acc_e, acc_z = read_file_bbp2(input_bbp_file)
+    if len(time) < 2:
+        raise ValueError("%s: cannot determine dt" % (input_bbp_file))
+    dt = time[1] - time[0]
+    npts = len(time)
+    accs = [acc_n, acc_e, acc_z]
+
+    # Velocity and displacement, simple rule as in integ_diff
+    vels = [np.cumsum(acc) * dt for acc in accs]
+    disps = [np.cumsum(vel) * dt for vel in vels]
+
+    peaks = []
+    for acc, vel, disp in zip(accs, vels, disps):
+        peaks.append([np.max(np.abs(acc)), np.max(np.abs(vel)),
+                      np.max(np.abs(disp))])
+
+    arias = [np.pi / (2.0 * constants.G2CMSS) * np.sum(acc * acc) * dt /
+             100.0 for acc in accs]
+    durs = [[significant_duration(acc, dt, pstart, pend)
+             for pstart, pend in durations] for acc in accs]
+
+    # Fourier amplitude spectra: one FFT per component, smoothed at the
+    # output frequencies with a weight matrix shared by the components
+    npw2 = 1
+    while npw2 < npts:
+        npw2 = 2 * npw2
+    fft_freqs = np.fft.rfftfreq(npw2, dt)
+    out_freqs = fas_frequencies(dt, npts)
+    weights = ko_weights(fft_freqs, out_freqs, ko_bandwidth)
+    fas = [weights.dot(np.abs(np.fft.rfft(acc, npw2)) * dt)
+           for acc in accs]
+
+    # PSa and RotDnn, librotd interpolates the records in process
+    psa_n, psa_e, rotd = rotdlib.rotd_compute(acc_e / constants.G2CMSS,
+                                              acc_n / constants.G2CMSS,
+                                              dt,
+                                              percentiles=all_percentiles)
+
+    return {"dt": dt, "npts": npts, "peaks": peaks, "arias": arias,
+            "durations": durations, "durs": durs,
+            "periods": rotdlib.ROTD_PERIODS,
+            "percentiles": all_percentiles,
+            "psa_n": psa_n, "psa_e": psa_e, "rotd": rotd,
+            "freqs": out_freqs, "fas": fas, "ko_bandwidth": ko_bandwidth}
+
+def write_metrics_file(output_file, label, metrics):
+    """
+    Writes the results of compute_metrics to output_file: the peak
+    and duration measures of each component, then the response
+    spectra and the Fourier spectra tables
+    """
+    out_file = open(output_file, 'w')
+    out_file.write("# Intensity measures of %s\n" % (label))
+    out_file.write("# dt= %.6g npts= %d\n" % (metrics["dt"],
+                                              metrics["npts"]))
+    dur_labels = ["D%d-%d(s)" % (int(round(100 * pstart)),
+                                 int(round(100 * pend)))
+                  for pstart, pend in metrics["durations"]]
+    out_file.write("# Comp PGA(cm/s/s) PGV(cm/s) PGD(cm) AI(m/s) %s\n" %
+                   (" ".join(dur_labels)))
+    for comp, peak, arias, durs in zip(COMPONENTS, metrics["peaks"],
+                                       metrics["arias"], metrics["durs"]):
+        out_file.write("%s %.6e %.6e %.6e %.6e %s\n" %
+                       (comp, peak[0], peak[1], peak[2], arias,
+                        " ".join(["%.4f" % (dur[2]) for dur in durs])))
+    labels = ["RotD%02d" % (int(round(pct)))
+              for pct in metrics["percentiles"]]
+    out_file.write("# Period(s) Psa5_N(g) Psa5_E(g) %s\n" %
+                   (" ".join(labels)))
+    for period, val_n, val_e, val_rotd in zip(metrics["periods"],
+                                              metrics["psa_n"],
+                                              metrics["psa_e"],
+                                              metrics["rotd"]):
+        out_file.write("%10.4f %s\n" %
+                       (period, " ".join(["%.6e" % (value) for value in
+                                          [val_n, val_e] + val_rotd])))
+    out_file.write("# Freq(Hz) FAS_N FAS_E FAS_Z (cm/s, Konno-Ohmachi "
+                   "b=%g)\n" % (metrics["ko_bandwidth"]))
+    for idx, freq in enumerate(metrics["freqs"]):
+        out_file.write("%.6e %s\n" %
+                       (freq, " ".join(["%.6e" % (fas[idx]) for
+                                        fas in metrics["fas"]])))
+    out_file.close()
+
+class CombinedMetrics(object):
+    """
+    Module computing all the intensity measures of each record in a
+    single pass
+    """
+
+    def __init__(self):
+        """
+        Initializes class variables
+        """
+        self.percentiles = None
+        self.ko_bandwidth = 40.0
+        self.jobs = 1
+
+    def parse_arguments(self, argv=None):
+        """
+        This function takes care of parsing the command-line arguments and
+        asking the user for any missing parameters that we need, from
+        argv (sys.argv[1:] if None)
+        """
+        parser = argparse.ArgumentParser(description="Compute PSa/RotDnn, "
+                                         "FAS, peaks and durations for "
+                                         "one or more seismograms.")
+        parser.add_argument("--input-dir", dest="input_dir",
+                            help="input directory")
+        parser.add_argument("--output-dir", dest="output_dir",
+                            help="output directory")
+        parser.add_argument("-i", "--input", "--input-file",
+                            dest="input_file",
+                            help="input acceleration BBP file")
+        parser.add_argument("-o", "--output", "--output-file",
+                            dest="output_file",
+                            help="output ims file")
+        parser.add_argument("--batch-file", "-b", dest="batch_file",
+                            help="file with list of timeseries to process")
+        parser.add_argument("--station-list", "-s", dest="station_list",
+                            help="station list for batch processing")
+        parser.add_argument("--percentiles", dest="percentiles",
+                            help="comma-separated list of extra RotDnn "
+                            "percentiles to output (e.g. 0,84)")
+        parser.add_argument("--ko-bandwidth", dest="ko_bandwidth",
+                            type=float, default=40.0,
+                            help="Konno-Ohmachi bandwidth of the FAS "
+                            "(0 = no smoothing, default: 40)")
+        parser.add_argument("--jobs", "-j", dest="jobs", type=int,
+                            default=multiprocessing.cpu_count(),
+                            help="number of files processed in parallel "
+                            "(default: number of CPUs)")
+        args = parser.parse_args(argv)
+
+        return args
+
+    def run(self, argv=None):
+        """
+        Run CombinedMetrics module
+        """
+        # Parse command-line options
+        args = self.parse_arguments(argv)
+
+        if args.percentiles is not None:
+            self.percentiles = [int(percentile) for percentile in
+                                args.percentiles.split(",")]
+        self.ko_bandwidth = args.ko_bandwidth
+        self.jobs = args.jobs
+
+        # The response spectra need librotd
+        if rotdlib.load_library() is None:
+            print("[ERROR]: librotd.so not found, build src/ucb/rotd50 first!")
+            sys.exit(1)
+
+        # Set input and output directories
+        if args.input_dir is None:
+            input_dir = "."
+        else:
+            input_dir = args.input_dir
+        if args.output_dir is None:
+            output_dir = "."
+        else:
+            output_dir = args.output_dir
+
+        if args.input_file is not None:
+            if args.output_file is not None:
+                output_base = os.path.splitext(args.output_file)[0]
+            else:
+                output_base = os.path.splitext(args.input_file)[0]
+            self.run_files([(args.input_file, output_base)],
+                           input_dir, output_dir)
+        elif args.batch_file is not None:
+            self.run_batch_mode(args.batch_file, input_dir, output_dir)
+        elif args.station_list is not None:
+            self.run_station_mode(args.station_list, input_dir, output_dir)
+        else:
+            print("[ERROR]: Must specify either input file, batch file, or station file!")
+            sys.exit(1)
+
+    def run_files(self, files, input_dir, output_dir):
+        """
+        Computes the intensity measures of a list of (input_file,
+        output_base) acceleration seismograms, shared out over a pool
+        of self.jobs threads
+        """
+        jobs = max(1, self.jobs)
+
+        for input_file, _ in files:
+            print("[METRICS]: Processing %s" % (input_file))
+
+        def run_one(idx):
+            input_file, output_base = files[idx]
+            metrics = compute_metrics(os.path.join(input_dir, input_file),
+                                      self.ko_bandwidth, self.percentiles)
+            write_metrics_file(os.path.join(output_dir,
+                                            "%s.ims" % (output_base)),
+                               os.path.basename(input_file), metrics)
+
+        if jobs > 1 and len(files) > 1:
+            pool = ThreadPool(min(jobs, len(files)))
+            pool.map(run_one, range(len(files)))
+            pool.close()
+            pool.join()
+        else:
+            for idx in range(len(files)):
+                run_one(idx)
+
+    def run_batch_mode(self, batch_file, input_dir, output_dir):
+        """
+        Computes the intensity measures of a list of acceleration
+        seismograms
+        """
+        files = []
+        input_list = open(batch_file, 'r')
+        for line in input_list:
+            line = line.strip()
+            if not line:
+                continue
+
+            input_file = line
+            output_base = os.path.splitext(input_file)[0]
+            files.append((input_file, output_base))
+        input_list.close()
+
+        self.run_files(files, input_dir, output_dir)
+
+    def run_station_mode(self, station_file, input_dir, output_dir):
+        """
+        Computes the intensity measures of the stations in a station
+        list
+        """
+        stations = StationList(station_file)
+        station_list = stations.get_station_list()
+
+        files = []
+        for station in station_list:
+            station_name = station.scode
+
+            # Find input file
+            input_list = glob.glob("%s%s*%s*.acc.bbp" %
+                                   (input_dir, os.sep, station_name))
+            if len(input_list) != 1:
+                print("[ERROR]: Can't find input file for station %s" % (station_name))
+                sys.exit(1)
+
+            input_file = os.path.basename(input_list[0])
+            output_base = input_file[0:input_file.find(".acc.bbp")]
+            files.append((input_file, output_base))
+
+        self.run_files(files, input_dir, output_dir)
+
+if __name__ == '__main__':
+    print("Running module: %s" % (os.path.basename(sys.argv[0])))
+    os_utilities.run_entry_point(lambda argv: CombinedMetrics().run(argv))
@@ -0,0 +1,283 @@
+#!/usr/bin/env python
+"""
+BSD 3-Clause License
+
+Copyright (c) 2022, University of Southern California
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+Python binding to librotd (src/ucb/rotd50/rotdlib.f), computing the
+PSa and RotDnn of a pair, or a batch of pairs, of components in
+memory, without running the rotdnn program
+"""
+from __future__ import division, print_function
+
+# Import Python modules
+import os
+import struct
+import ctypes
+
+# Import GMSVToolkit modules
+from core import gmsvtoolkit_config
+from utils import result_cache
+from utils import gmsvlib
+
+# Periods used by the rotd50/rotd100/rotdnn programs
+ROTD_PERIODS = [0.010, 0.011, 0.012, 0.013, 0.015, 0.017, 0.020, 0.022,
+                0.025, 0.029, 0.032, 0.035, 0.040, 0.045, 0.050, 0.055,
+                0.060, 0.065, 0.075, 0.085, 0.100, 0.110, 0.120, 0.130,
+                0.150, 0.170, 0.200, 0.220, 0.240, 0.260, 0.280, 0.300,
+                0.350, 0.400, 0.450, 0.500, 0.550, 0.600, 0.650, 0.750,
+                0.850, 1.000, 1.100, 1.200, 1.300, 1.500, 1.700, 2.000,
+                2.200, 2.400, 2.600, 2.800, 3.000, 3.500, 4.000, 4.400,
+                5.000, 5.500, 6.000, 6.500, 7.500, 8.500, 10.000]
+
+# Loaded library, False if we already tried and it is not there
+ROTD_LIB = None
+
+def load_library():
+    """
+    Returns the librotd library, or None if it has not been built.
+    Without librotd.so, libgmsv (which links librotd in) is used
+    """
+    global ROTD_LIB
+    if ROTD_LIB is None:
+        install = gmsvtoolkit_config.GMSVToolKitConfig.get_instance()
+        lib_file = os.path.join(install.UCB_BIN_DIR, "librotd.so")
+        ROTD_LIB = False
+        if os.path.exists(lib_file):
+            ROTD_LIB = ctypes.CDLL(lib_file)
+            float_p = ctypes.POINTER(ctypes.c_float)
+            ROTD_LIB.rotd_compute.restype = ctypes.c_int
+            ROTD_LIB.rotd_compute.argtypes = [float_p, float_p,
+                                              ctypes.c_int, ctypes.c_float,
+                                              float_p, ctypes.c_int,
+                                              ctypes.c_float, ctypes.c_int,
+                                              float_p, ctypes.c_int,
+                                              ctypes.c_int, ctypes.c_int,
+                                              ctypes.c_float, ctypes.c_int,
+                                              float_p, float_p, float_p]
+            ROTD_LIB.rotd_compute_batch.restype = ctypes.c_int
+            ROTD_LIB.rotd_compute_batch.argtypes = [float_p, float_p,
+                                                    ctypes.c_int,
+                                                    ctypes.c_int,
+                                                    ctypes.c_float,
+                                                    float_p, ctypes.c_int,
+                                                    ctypes.c_float,
+                                                    ctypes.c_int,
+                                                    float_p, ctypes.c_int,
+                                                    ctypes.c_int,
+                                                    float_p, float_p,
+                                                    float_p]
+        else:
+            # gmsv_rotd_* take the same arguments
+            lib = gmsvlib.load_library()
+            if lib is not None:
+                lib.rotd_compute = lib.gmsv_rotd_compute
+                lib.rotd_compute_batch = lib.gmsv_rotd_compute_batch
+                ROTD_LIB = lib
+    if ROTD_LIB is False:
+        return None
+    return ROTD_LIB
+
+def rotd_compute(acc_e, acc_n, dt, periods=None, percentiles=(50, 100),
+                 interp=2, damping=0.05, rotmode=0, nthreads=1,
+                 accuracy=0.0, precision=0):
+    """
+    Computes the as-recorded PSa and the RotDnn percentiles of the
+    acc_e/acc_n pair (in g, time step dt, lists or arrays; float32
+    arrays are passed to librotd without a copy). Returns three lists, one
+    value per period: psa_n, psa_e and rotd, each rotd item being the
+    list of percentiles for that period. The options are the same as
+    in the rotdnn input file, precision being 0 (double) or 1 (single).
+    With GMSVTOOLKIT_CACHE_DIR set the results are kept in the result
+    cache, keyed on the float32 samples and all the options but
+    nthreads, and a hit does not call librotd at all
+    """
+    lib = load_library()
+    if lib is None:
+        raise OSError("librotd.so not found, build src/ucb/rotd50 first")
+    if periods is None:
+        periods = ROTD_PERIODS
+    npts = min(len(acc_e), len(acc_n))
+    nper = len(periods)
+    npct = len(percentiles)
+
+    # float32 arrays go to librotd as they are
+    c_acc_e = gmsvlib.float32_array(acc_e[0:npts])
+    c_acc_n = gmsvlib.float32_array(acc_n[0:npts])
+    c_periods = (ctypes.c_float * nper)(*periods)
+    c_pct = (ctypes.c_float * npct)(*percentiles)
+    c_psa_n = (ctypes.c_float * nper)()
+    c_psa_e = (ctypes.c_float * nper)()
+    c_rotd = (ctypes.c_float * (nper * npct))()
+
+    # The key uses the values librotd gets, the float32 arrays and
+    # the C types of the scalars
+    cache = result_cache.get_cache()
+    result = None
+    if cache is not None:
+        key = result_cache.make_key("rotd_compute",
+                                    c_acc_e.tobytes(), c_acc_n.tobytes(),
+                                    struct.pack("<f", dt),
+                                    bytes(c_periods), bytes(c_pct),
+                                    struct.pack("<f", damping),
+                                    interp, rotmode,
+                                    struct.pack("<f", accuracy),
+                                    precision)
+        result = cache.get(key)
+    nbytes = ctypes.sizeof(c_psa_n)
+    if result is not None and len(result) == (2 + npct) * nbytes:
+        ctypes.memmove(c_psa_n, result[0:nbytes], nbytes)
+        ctypes.memmove(c_psa_e, result[nbytes:2 * nbytes], nbytes)
+        ctypes.memmove(c_rotd, result[2 * nbytes:], npct * nbytes)
+    else:
+        status = lib.rotd_compute(gmsvlib.float_pointer(c_acc_e),
+                                  gmsvlib.float_pointer(c_acc_n), npts, dt,
+                                  c_periods, nper, damping, interp,
+                                  c_pct, npct, rotmode, nthreads, accuracy,
+                                  precision,
+                                  c_psa_n, c_psa_e, c_rotd)
+        if status != 0:
+            raise ValueError("rotd_compute: bad arguments")
+        if cache is not None:
+            cache.put(key, bytes(c_psa_n) + bytes(c_psa_e) + bytes(c_rotd))
+
+    rotd = [list(c_rotd[idx * npct:(idx + 1) * npct]) for idx in range(nper)]
+    return list(c_psa_n), list(c_psa_e), rotd
+
+def rotd_compute_batch(pairs, dt, periods=None, percentiles=(50, 100),
+                       interp=2, damping=0.05, nthreads=1):
+    """
+    Same as rotd_compute for a list of (acc_e, acc_n) pairs, all at time
+    step dt, in a single librotd call (on a GPU if librotd was built
+    with OFFLOAD). The pairs are cut to the shortest record. Returns a
+    list with the (psa_n, psa_e, rotd) of each pair. Pairs found in the
+    result cache are not sent to librotd
+    """
+    lib = load_library()
+    if lib is None:
+        raise OSError("librotd.so not found, build src/ucb/rotd50 first")
+    if periods is None:
+        periods = ROTD_PERIODS
+    npair = len(pairs)
+    npts = min([min(len(acc_e), len(acc_n)) for acc_e, acc_n in pairs])
+    nper = len(periods)
+    npct = len(percentiles)
+    nval = nper * (2 + npct)
+
+    c_periods = (ctypes.c_float * nper)(*periods)
+    c_pct = (ctypes.c_float * npct)(*percentiles)
+    c_pairs = [(gmsvlib.float32_array(acc_e[0:npts]),
+                gmsvlib.float32_array(acc_n[0:npts]))
+               for acc_e, acc_n in pairs]
+
+    # Each pair's values, psa_n, psa_e and rotd, as rotd_compute
+    # caches them. The misses are computed cut to the same npts as
+    # when all the pairs are there, so a hit gives the same values
+    cache = result_cache.get_cache()
+    values = [None] * npair
+    keys = [None] * npair
+    if cache is not None:
+        for idx, (c_acc_e, c_acc_n) in enumerate(c_pairs):
+            keys[idx] = result_cache.make_key("rotd_compute_batch",
+                                              c_acc_e.tobytes(),
+                                              c_acc_n.tobytes(),
+                                              struct.pack("<f", dt),
+                                              bytes(c_periods), bytes(c_pct),
+                                              struct.pack("<f", damping),
+                                              interp)
+            result = cache.get(keys[idx])
+            if result is not None and len(result) == 4 * nval:
+                values[idx] = list(struct.unpack("<%df" % (nval), result))
+    todo = [idx for idx in range(npair) if values[idx] is None]
+
+    if todo:
+        nrun = len(todo)
+        c_acc_e = gmsvlib.float32_array([c_pairs[idx][0] for idx in todo])
+        c_acc_n = gmsvlib.float32_array([c_pairs[idx][1] for idx in todo])
+        c_psa_n = (ctypes.c_float * (nrun * nper))()
+        c_psa_e = (ctypes.c_float * (nrun * nper))()
+        c_rotd = (ctypes.c_float * (nrun * nper * npct))()
+
+        status = lib.rotd_compute_batch(gmsvlib.float_pointer(c_acc_e),
+                                        gmsvlib.float_pointer(c_acc_n),
+                                        npts, nrun, dt,
+                                        c_periods, nper, damping, interp,
+                                        c_pct, npct, nthreads,
+                                        c_psa_n, c_psa_e, c_rotd)
+        if status != 0:
+            raise ValueError("rotd_compute_batch: bad arguments")
+
+        for run, idx in enumerate(todo):
+            values[idx] = (c_psa_n[run * nper:(run + 1) * nper] +
+                           c_psa_e[run * nper:(run + 1) * nper] +
+                           c_rotd[run * nper * npct:(run + 1) * nper * npct])
+            if cache is not None:
+                cache.put(keys[idx], struct.pack("<%df" % (nval), *values[idx]))
+
+    results = []
+    for idx in range(npair):
+        psa_n = values[idx][0:nper]
+        psa_e = values[idx][nper:2 * nper]
+        rotd = [values[idx][2 * nper + per * npct:
+                            2 * nper + (per + 1) * npct]
+                for per in range(nper)]
+        results.append((psa_n, psa_e, rotd))
+    return results
+
+def fortran_e10_5(value):
+    """
+    Formats value as Fortran's e10.5 edit descriptor does
+    (e.g. .14132E+00), so outputs match the rotdnn program
+    """
+    if value == 0.0:
+        return ".00000E+00"
+    mantissa, exponent = ("%.4e" % (abs(value))).split("e")
+    exponent = int(exponent) + 1
+    digits = mantissa.replace(".", "")
+    sign = "-" if value < 0 else ""
+    return "%s.%sE%+03d" % (sign, digits, exponent)
+
+def write_rotdxx_file(output_file, label_e, label_n, periods,
+                      percentiles, damping, psa_n, psa_e, rotd):
+    """
+    Writes the results of rotd_compute in the same format as the
+    rotdnn program
+    """
+    labels = ["RotD%02d" % (int(round(pct))) for pct in percentiles]
+    out_file = open(output_file, 'w')
+    out_file.write("#  Psa5_N Psa5_E %s\n" % (" ".join(labels)))
+    out_file.write("#  %-80s\n" % (label_e[0:80]))
+    out_file.write("#  %-80s\n" % (label_n[0:80]))
+    out_file.write("#  %5d%10.4f\n" % (len(periods), damping))
+    for period, val_n, val_e, val_rotd in zip(periods, psa_n, psa_e, rotd):
+        values = [val_n, val_e] + val_rotd
+        out_file.write("%10.4f %s\n" %
+                       (period, " ".join([fortran_e10_5(value)
+                                          for value in values])))
+    out_file.close()
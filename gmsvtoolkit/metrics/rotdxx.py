@@ -42,11 +42,16 @@ import atexit
 import shutil
 import argparse
 import tempfile
+import multiprocessing
+from multiprocessing.pool import ThreadPool
 
 # Import GMSVToolkit modules
 from utils import os_utilities
+from core import constants
 from core import gmsvtoolkit_config
-from utils.peer_formatter import bbp2peer, peer2bbp
+from metrics import rotdlib
+from utils.file_utilities import bbp_get_dt, read_file_bbp2
+from utils.peer_formatter import bbp2peer, peer2bbp, bbp2wccbin
 from core.station_list import StationList
 
 def cleanup(dir_name):
@@ -56,75 +61,130 @@ def cleanup(dir_name):
     shutil.rmtree(dir_name)
 
 def do_rotdxx(workdir, peer_input_e_file, peer_input_n_file,
-              output_rotd100_file, logfile):
+              output_rotd100_file, logfile, percentiles=None):
     """
-    This function runs the rotd100 command inside workdir, using
-    the inputs and outputs specified
+    This function runs the rotdnn command inside workdir, using
+    the inputs and outputs specified. The output has the RotD50 and
+    RotD100 columns, followed by any extra percentiles requested
+    """
+    do_rotdxx_batch(workdir, [(peer_input_e_file, peer_input_n_file,
+                               output_rotd100_file)],
+                    logfile, percentiles)
+
+def do_rotdxx_batch(workdir, pairs, logfile, percentiles=None, nthreads=1):
+    """
+    Runs a single rotdnn for all the (E, N, output) file triples in
+    pairs, using its Npairs support; rotdnn shares the pairs out over
+    nthreads OpenMP threads (0 = all). The files, and the rotdnn
+    control file, are in workdir, where rotdnn is run without
+    changing our own working directory, so several calls can run at
+    the same time as long as they use different workdirs
     """
     install = gmsvtoolkit_config.GMSVToolKitConfig.get_instance()
 
     # Make sure we don't have absolute path names
-    peer_input_e_file = os.path.basename(peer_input_e_file)
-    peer_input_n_file = os.path.basename(peer_input_n_file)
-    output_rotd100_file = os.path.basename(output_rotd100_file)
-
-    # Save cwd, change back to it at the end
-    old_cwd = os.getcwd()
-    os.chdir(workdir)
+    pairs = [(os.path.basename(peer_input_e_file),
+              os.path.basename(peer_input_n_file),
+              os.path.basename(output_rotd100_file))
+             for (peer_input_e_file, peer_input_n_file,
+                  output_rotd100_file) in pairs]
 
     # Make sure we remove the output files first or Fortran will
     # complain if they already exist
-    try:
-        os.unlink(output_rotd100_file)
-    except OSError:
-        pass
-
-    # Write config file for rotd100 program
-    rd100_config_filename = "rotd100_inp.cfg"
+    for _, _, output_rotd100_file in pairs:
+        try:
+            os.unlink(os.path.join(workdir, output_rotd100_file))
+        except OSError:
+            pass
+
+    # RotD50 and RotD100 always come first, as in the rotd100 output
+    all_percentiles = [50, 100]
+    if percentiles is not None:
+        all_percentiles.extend([percentile for percentile in percentiles
+                                if percentile not in all_percentiles])
+
+    # Write config file for rotdnn program
+    rd100_config_filename = os.path.join(workdir, "rotdnn_inp.cfg")
     rd100_conf = open(rd100_config_filename, 'w')
     # This flag indicates inputs acceleration
     rd100_conf.write("2 interp flag\n")
-    # This flag indicate we are processing two input files
-    rd100_conf.write("1 Npairs\n")
+    # Number of pairs of input files
+    rd100_conf.write("%d Npairs\n" % (len(pairs)))
     # Number of headers in the file
     rd100_conf.write("6 Nhead\n")
-    rd100_conf.write("%s\n" % peer_input_e_file)
-    rd100_conf.write("%s\n" % peer_input_n_file)
-    rd100_conf.write("%s\n" % output_rotd100_file)
+    # Percentiles to compute in the same pass
+    rd100_conf.write("percentiles %s\n" %
+                     (" ".join(["%g" % (percentile) for
+                                percentile in all_percentiles])))
+    if len(pairs) > 1:
+        rd100_conf.write("nthreads %d\n" % (nthreads))
+    for peer_input_e_file, peer_input_n_file, output_rotd100_file in pairs:
+        rd100_conf.write("%s\n" % peer_input_e_file)
+        rd100_conf.write("%s\n" % peer_input_n_file)
+        rd100_conf.write("%s\n" % output_rotd100_file)
     # Close file
     rd100_conf.close()
 
     progstring = ("%s >> %s 2>&1" %
                   (os.path.join(install.UCB_BIN_DIR,
-                                "rotd100"), logfile))
-    os_utilities.runprog(progstring, abort_on_error=True, print_cmd=False)
+                                "rotdnn"), logfile))
+    os_utilities.runprog(progstring, abort_on_error=True, print_cmd=False,
+                         cwd=workdir)
 
-    # Delete RotD100 control file
+    # Delete RotDnn control file
     os.unlink(rd100_config_filename)
 
-    # Restore working directory
-    os.chdir(old_cwd)
+def do_rotdxx_lib(input_bbp_file, output_rotdxx_file,
+                  vertical=False, percentiles=None):
+    """
+    Same as bbp2peer followed by do_rotdxx, but reads the bbp file
+    directly and computes RotDXX in process with librotd
+    """
+    # RotD50 and RotD100 always come first, as in the rotd100 output
+    all_percentiles = [50, 100]
+    if percentiles is not None:
+        all_percentiles.extend([percentile for percentile in percentiles
+                                if percentile not in all_percentiles])
+
+    # Read the acceleration components, convert to g
+    _, acc_n, acc_e, acc_z = read_file_bbp2(input_bbp_file)
+    acc_n = acc_n / constants.G2CMSS
+    acc_e = acc_e / constants.G2CMSS
+    acc_z = acc_z / constants.G2CMSS
+    dt = bbp_get_dt(input_bbp_file)
+
+    if vertical:
+        acc_e = acc_z
+        acc_n = acc_z
+    psa_n, psa_e, rotd = rotdlib.rotd_compute(acc_e, acc_n, dt,
+                                              percentiles=all_percentiles)
+    rotdlib.write_rotdxx_file(output_rotdxx_file,
+                              os.path.basename(input_bbp_file),
+                              os.path.basename(input_bbp_file),
+                              rotdlib.ROTD_PERIODS, all_percentiles, 0.05,
+                              psa_n, psa_e, rotd)
 
 def do_split_rotdxx(in_rotdxx_file, out_rotdxx_file, mode):
     """
-    Create a RotD50 or RotD100 file out of the RotDXX
-    mode selects the output: rotd50 or rotd100
+    Create a RotD50, RotD100 (or any other RotDnn present in the
+    input) file out of the RotDXX
+    mode selects the output: rotd50, rotd100, rotd84, ...
     """
-    if mode.lower() != "rotd50" and mode.lower() != "rotd100":
-        print("[ERROR]: mode must be set to 'rotd50' or 'rotd100'!")
-        sys.exit(1)
-    
     # Open input and output files
     in_file = open(in_rotdxx_file, 'r')
+
+    # First line names the columns after the period
+    labels = [label.lower() for label in in_file.readline().split()[1:]]
+    if not mode.lower().startswith("rotd") or mode.lower() not in labels:
+        print("[ERROR]: mode %s not in RotDXX file %s!" %
+              (mode, in_rotdxx_file))
+        sys.exit(1)
+    column = labels.index(mode.lower()) + 1
+
     out_file = open(out_rotdxx_file, 'w')
 
     # Rewrite first line with correct header
-    if mode.lower() == "rotd50":
-        out_file.write("#  Psa5_N Psa5_E RotD50\n")
-    else:
-        out_file.write("#  Psa5_N Psa5_E RotD100\n")
-    # Skip first line
-    line = in_file.readline()
+    out_file.write("#  Psa5_N Psa5_E RotD%s\n" % (mode[4:]))
     
     for line in in_file:
         line = line.strip()
@@ -133,11 +193,7 @@ def do_split_rotdxx(in_rotdxx_file, out_rotdxx_file, mode):
             out_file.write("%s\n" % (line))
             continue
         pieces = line.split()
-        if mode.lower() == "rotd50":
-            pieces = pieces[0:4]
-        else:
-            pieces = pieces[0:5]
-            del pieces[3]
+        pieces = pieces[0:3] + [pieces[column]]
         out_file.write("  %s\n" % (" ".join(pieces)))
 
     # Close everything
@@ -155,11 +211,14 @@ class RotDXX(object):
         """
         self.vertical = None
         self.mode = None
+        self.percentiles = None
+        self.jobs = 1
 
-    def parse_arguments(self):
+    def parse_arguments(self, argv=None):
         """
         This function takes care of parsing the command-line arguments and
-        asking the user for any missing parameters that we need
+        asking the user for any missing parameters that we need, from
+        argv (sys.argv[1:] if None)
         """
         parser = argparse.ArgumentParser(description="Compute RotDXX "
                                          " for one or more seismograms.")
@@ -183,16 +242,23 @@ class RotDXX(object):
                             help="enable RotD100 output")
         parser.add_argument("--rotd50", dest="rotd50", action="store_true",
                             help="enable RotD50 output (default)")
-        args = parser.parse_args()
+        parser.add_argument("--percentiles", dest="percentiles",
+                            help="comma-separated list of extra RotDnn "
+                            "percentiles to output (e.g. 0,84)")
+        parser.add_argument("--jobs", "-j", dest="jobs", type=int,
+                            default=multiprocessing.cpu_count(),
+                            help="number of files processed in parallel "
+                            "(default: number of CPUs)")
+        args = parser.parse_args(argv)
 
         return args
 
-    def run(self):
+    def run(self, argv=None):
         """
         Run RotDXX module
         """
         # Parse command-line options
-        args = self.parse_arguments()
+        args = self.parse_arguments(argv)
 
         # Set mode
         self.mode = "rotd50"
@@ -200,6 +266,10 @@ class RotDXX(object):
             self.mode = "both"
         elif args.rotd100:
             self.mode = "rotd100"
+        if args.percentiles is not None:
+            self.percentiles = [int(percentile) for percentile in
+                                args.percentiles.split(",")]
+        self.jobs = args.jobs
 
         # Set input and output directories
         if args.input_dir is None:
@@ -246,54 +316,104 @@ class RotDXX(object):
         """
         Calculate RotDXX for a single acceleration seismogram
         """
-        if temp_dir is None:
-            # Create temp directory if needed
-            temp_dir = tempfile.mkdtemp()
-            # And clean up later
-            atexit.register(cleanup, temp_dir)
-        
-        print("[ROTDXX]: Processing %s" % (input_file))
-        peer_n_file = "temp-peer_n.peer"
-        peer_e_file = "temp-peer_e.peer"
-        peer_z_file = "temp-peer_z.peer"
-        output_temp_file = "temp.rdxx"
-        logfile = "temp-rotdxx-log.txt"
-        bbp2peer(os.path.join(input_dir, input_file),
-                 os.path.join(temp_dir, peer_n_file),
-                 os.path.join(temp_dir, peer_e_file),
-                 os.path.join(temp_dir, peer_z_file))
-        output_temp_file = os.path.join(temp_dir,
-                                        output_temp_file)
-        if self.vertical:
-            # Calculate RotDXX for vertical component
-            do_rotdxx(temp_dir, peer_z_file, peer_z_file,
-                      output_temp_file, logfile)
-        else:
-            # Calculate RotDXX for horizontal components
-            do_rotdxx(temp_dir, peer_e_file, peer_n_file,
-                      output_temp_file, logfile)
+        self.run_files([(input_file, output_base)],
+                       input_dir, output_dir, temp_dir)
+
+    def write_outputs(self, rotdxx_file, output_base, output_dir):
+        """
+        Splits the RotDXX file into the output files of the
+        selected mode and percentiles
+        """
         if self.mode == "rotd50" or self.mode == "both":
             output_file = "%s.rd50" % (output_base)
-            do_split_rotdxx(os.path.join(temp_dir, output_temp_file),
+            do_split_rotdxx(rotdxx_file,
                             os.path.join(output_dir, output_file),
                             "rotd50")
         if self.mode == "rotd100" or self.mode == "both":
             output_file = "%s.rd100" % (output_base)
-            do_split_rotdxx(os.path.join(temp_dir, output_temp_file),
+            do_split_rotdxx(rotdxx_file,
                             os.path.join(output_dir, output_file),
                             "rotd100")
-
-    def run_batch_mode(self, batch_file, input_dir,
-                       output_dir, temp_dir=None):
+        if self.percentiles is not None:
+            for percentile in self.percentiles:
+                if percentile == 50 or percentile == 100:
+                    continue
+                output_file = "%s.rd%02d" % (output_base, percentile)
+                do_split_rotdxx(rotdxx_file,
+                                os.path.join(output_dir, output_file),
+                                "rotd%02d" % (percentile))
+
+    def run_files(self, files, input_dir, output_dir, temp_dir=None):
         """
-        Calculates RotDXX for a list of acceleration seismograms
+        Calculate RotDXX for a list of (input_file, output_base)
+        acceleration seismograms. With librotd the files are shared
+        out over a pool of self.jobs threads, otherwise they all go
+        to a single rotdnn run. Each file has its own temporary
+        names, so the outputs do not depend on the order the files
+        are processed in
         """
         if temp_dir is None:
             # Create temp directory if needed
             temp_dir = tempfile.mkdtemp()
             # And clean up later
             atexit.register(cleanup, temp_dir)
+        jobs = max(1, self.jobs)
+
+        for input_file, _ in files:
+            print("[ROTDXX]: Processing %s" % (input_file))
+        temp_files = [os.path.join(temp_dir, "temp-%05d.rdxx" % (idx))
+                      for idx in range(len(files))]
+
+        if rotdlib.load_library() is not None:
+            # Compute in process, no need for the PEER files
+            def run_one(idx):
+                input_file, output_base = files[idx]
+                do_rotdxx_lib(os.path.join(input_dir, input_file),
+                              temp_files[idx], self.vertical,
+                              self.percentiles)
+                self.write_outputs(temp_files[idx], output_base, output_dir)
+            if jobs > 1 and len(files) > 1:
+                pool = ThreadPool(min(jobs, len(files)))
+                pool.map(run_one, range(len(files)))
+                pool.close()
+                pool.join()
+            else:
+                for idx in range(len(files)):
+                    run_one(idx)
+            return
+
+        # Binary input, the rotd programs recognize it by its size.
+        # rotdnn copies the input names to the output comments, a
+        # single file keeps the names it always had
+        pairs = []
+        for idx, (input_file, _) in enumerate(files):
+            prefix = "temp-"
+            if len(files) > 1:
+                prefix = "temp-%05d-" % (idx)
+            peer_n_file = "%swcc_n.bin" % (prefix)
+            peer_e_file = "%swcc_e.bin" % (prefix)
+            peer_z_file = "%swcc_z.bin" % (prefix)
+            bbp2wccbin(os.path.join(input_dir, input_file),
+                       os.path.join(temp_dir, peer_n_file),
+                       os.path.join(temp_dir, peer_e_file),
+                       os.path.join(temp_dir, peer_z_file))
+            if self.vertical:
+                # Calculate RotDXX for vertical component
+                pairs.append((peer_z_file, peer_z_file, temp_files[idx]))
+            else:
+                # Calculate RotDXX for horizontal components
+                pairs.append((peer_e_file, peer_n_file, temp_files[idx]))
+        do_rotdxx_batch(temp_dir, pairs, "temp-rotdxx-log.txt",
+                        self.percentiles, jobs)
+        for idx, (_, output_base) in enumerate(files):
+            self.write_outputs(temp_files[idx], output_base, output_dir)
 
+    def run_batch_mode(self, batch_file, input_dir,
+                       output_dir, temp_dir=None):
+        """
+        Calculates RotDXX for a list of acceleration seismograms
+        """
+        files = []
         input_list = open(batch_file, 'r')
         for line in input_list:
             line = line.strip()
@@ -302,46 +422,39 @@ class RotDXX(object):
 
             input_file = line
             output_base = os.path.splitext(input_file)[0]
-
-            # Run RotDXX
-            self.run_single_file(input_file, output_base,
-                                 input_dir, output_dir, temp_dir)
-
+            files.append((input_file, output_base))
         input_list.close()
 
+        # Run RotDXX
+        self.run_files(files, input_dir, output_dir, temp_dir)
+
     def run_station_mode(self, station_file, input_dir,
                          output_dir, temp_dir=None):
         """
         Calculates RotDXX for stations in a station list
         """
-        if temp_dir is None:
-            # Create temp directory if needed
-            temp_dir = tempfile.mkdtemp()
-            # And clean up later
-            atexit.register(cleanup, temp_dir)
-
-            stations = StationList(station_file)
-            station_list = stations.get_station_list()
+        stations = StationList(station_file)
+        station_list = stations.get_station_list()
 
-            # Loop through stations
-            for station in station_list:
-                station_name = station.scode
+        # Loop through stations
+        files = []
+        for station in station_list:
+            station_name = station.scode
 
-                # Find input file
-                input_list = glob.glob("%s%s*%s*.acc.bbp" %
-                                       (input_dir, os.sep, station_name))
-                if len(input_list) != 1:
-                    print("[ERROR]: Can't find input file for station %s" % (station_name))
-                    sys.exit(1)
+            # Find input file
+            input_list = glob.glob("%s%s*%s*.acc.bbp" %
+                                   (input_dir, os.sep, station_name))
+            if len(input_list) != 1:
+                print("[ERROR]: Can't find input file for station %s" % (station_name))
+                sys.exit(1)
 
-                input_file = os.path.basename(input_list[0])
-                output_base = input_file[0:input_file.find(".acc.bbp")]
+            input_file = os.path.basename(input_list[0])
+            output_base = input_file[0:input_file.find(".acc.bbp")]
+            files.append((input_file, output_base))
 
-                # Run RotDXX
-                self.run_single_file(input_file, output_base,
-                                     input_dir, output_dir, temp_dir)
+        # Run RotDXX
+        self.run_files(files, input_dir, output_dir, temp_dir)
 
 if __name__ == '__main__':
     print("Running module: %s" % (os.path.basename(sys.argv[0])))
-    ME = RotDXX()
-    ME.run()
+    os_utilities.run_entry_point(lambda argv: RotDXX().run(argv))
@@ -46,6 +46,8 @@ import pylab
 # Imports needed from the GMSVToolkit
 from core import exceptions
 from plots import plot_config
+from utils import file_utilities
+from utils import os_utilities
 
 # Constants
 MIN_Y_AXIS = -1.75
@@ -54,73 +56,51 @@ COMP_EXT_RD50 = 'rotd50'
 COMP_TITLE_RD50 = 'RotD50'
 DIST_PERIODS = [0.01, 0.05, 0.1, 0.2, 0.5, 1.0, 2.0, 5.0]
 
-def read_resid(resid_file, component, period, summary_output):
+def read_resid(resid_file, component, periods, summary_outputs):
     """
-    Reads the residual file resid_file and returns all data for the
-    requested periods
+    Reads the residual file resid_file once and returns all data for
+    each of the requested periods
     """
-    # Start empty
-    data = []
-    distance = []
-
-    # Read residuals file and get information we need
-    input_file = open(resid_file, 'r')
-    # Look over header and figure out which column contains the period
-    # we need to plot
-    header = input_file.readline()
-    header = header.strip()
-    items = header.split()
-    index = -1
-    for idx, item in enumerate(items):
-        try:
-            val = float(item)
-            if val == period:
-                # Found period, save index
-                index = idx
-                break
-        except:
-            pass
-
-    if index < 0:
-        # If we don't have this period, nothing to do
-        print("Residuals file %s does not have data for period %f" %
-              (resid_file, period))
-        # Close input file
-        input_file.close()
-        # Return empty sets
-        return data, distance
-
-    # Index #7 has distance
-    # Index #12 has component
-    # Indexes #10 and #11 have period range for valid data
-
-    # Read the rest of the file
-    for line in input_file:
-        items = line.split()
-        comp = items[12]
-        dist = items[7]
-        tmin = items[10]
-        tmax = items[11]
-        value = items[index]
-        # Skip components we don't know
-        if comp != component:
-            continue
-        if period >= float(tmin) and period <= float(tmax):
-            # Data within range, take it
-            data.append(float(value))
-            distance.append(float(dist))
+    all_data = []
+    all_distances = []
 
-    # Done reading the file
-    input_file.close()
+    # Read only the columns we need from the residuals file
+    columns = ["close_dist", "T_min", "T_max", "comp"]
+    meta, all_values = file_utilities.read_resid_periods(resid_file, columns,
+                                                         periods)
+    for period, values, summary_output in zip(periods, all_values,
+                                              summary_outputs):
+        # Start empty
+        data = []
+        distance = []
+        all_data.append(data)
+        all_distances.append(distance)
 
-    # Write summary output for later processing
-    output_file = open(summary_output, 'w')
-    for dist, val in zip(distance, data):
-        output_file.write("%f %f\n" % (dist, val))
-    output_file.close()
+        if values is None:
+            # If we don't have this period, nothing to do
+            print("Residuals file %s does not have data for period %f" %
+                  (resid_file, period))
+            continue
+
+        for dist, tmin, tmax, comp, value in zip(meta["close_dist"],
+                                                 meta["T_min"], meta["T_max"],
+                                                 meta["comp"], values):
+            # Skip components we don't know
+            if comp != component:
+                continue
+            if period >= float(tmin) and period <= float(tmax):
+                # Data within range, take it
+                data.append(float(value))
+                distance.append(float(dist))
+
+        # Write summary output for later processing
+        output_file = open(summary_output, 'w')
+        for dist, val in zip(distance, data):
+            output_file.write("%f %f\n" % (dist, val))
+        output_file.close()
 
     # Return the data we found
-    return data, distance
+    return all_data, all_distances
 
 def plot_dist_gof(resid_file, comp_label, input_dir,
                   output_dir, plot_title=None,
@@ -135,16 +115,12 @@ def plot_dist_gof(resid_file, comp_label, input_dir,
     if plot_periods is None:
         plot_periods = DIST_PERIODS
 
-    # Collect all the data
-    all_data = []
-    all_distances = []
-    # Read the residuals data
-    for period in plot_periods:
-        summary_output = os.path.join(input_dir, "%s-resid-%.3f-%s.txt" %
-                                      (comp_label, period, component))
-        data, distance = read_resid(resid_file, component, period, summary_output)
-        all_data.append(data)
-        all_distances.append(distance)
+    # Collect all the data from the residuals file
+    summary_outputs = [os.path.join(input_dir, "%s-resid-%.3f-%s.txt" %
+                                    (comp_label, period, component))
+                       for period in plot_periods]
+    all_data, all_distances = read_resid(resid_file, component,
+                                         plot_periods, summary_outputs)
 
     # Now create the 2 plots, 1 linear and 1 log
     dist_linear_file = os.path.join(output_dir, "gof-dist-linear-%s-%s.png" %
@@ -225,10 +201,11 @@ def create_dist_gof(all_data, all_distances, plot_title,
     fig.savefig(dist_gof_file, format="png", transparent=False, dpi=plot_config.dpi)
     pylab.close()
 
-def parse_arguments():
+def parse_arguments(argv=None):
     """
     This function takes care of parsing the command-line arguments and
-    asking the user for any missing parameters that we need
+    asking the user for any missing parameters that we need, from
+    argv (sys.argv[1:] if None)
     """
     parser = argparse.ArgumentParser(description="Generates PSA distance  comparison "
                                      " GoF plots.")
@@ -244,16 +221,16 @@ def parse_arguments():
                         help="select RotD50 comparison (default)")
     parser.add_argument("--plot-title", "--title", dest="plot_title",
                         help="set plot title")
-    args = parser.parse_args()
+    args = parser.parse_args(argv)
 
     return args
 
-def run():
+def run(argv=None):
     """
     Generate PSA Distance GoF plot
     """
     # Parse command-line options
-    args = parse_arguments()
+    args = parse_arguments(argv)
 
     # Look at paths
     input_dir = ""
@@ -284,10 +261,10 @@ def run():
         sys,exit(1)
 
     # Select the residuals file
-    resid_file = os.path.join(input_dir, "%s.%s-resid.txt" %
-                              (args.comp_label, extension))
+    resid_file = file_utilities.get_resid_file(input_dir, args.comp_label,
+                                               extension)
     plot_dist_gof(resid_file, args.comp_label, input_dir,
                   output_dir, plot_title)
 
 if __name__ == '__main__':
-    run()
+    os_utilities.run_entry_point(run)
@@ -47,6 +47,8 @@ import matplotlib.gridspec as gridspec
 # Imports needed from the GMSVToolkit
 from core import exceptions
 from plots import plot_config
+from utils.file_utilities import read_numeric_table
+from utils import os_utilities
 
 # Constants
 MIN_Y_AXIS = -1.75
@@ -108,19 +110,14 @@ def read_data(datafile, min_period, max_period=MAX_PERIOD):
     data = [[], [],]
 
     # Read input file
-    in_file = open(datafile, "r")
-    for line in in_file:
-        if line.startswith("#") or line.startswith("%"):
-            continue
-        tmp = line.split()
-        period = float(tmp[0])
+    table = read_numeric_table(datafile)
+    for row in table:
+        period = float(row[0])
         # Extract subset of period values
         if ((period >= min_period) and
             (period <= max_period)):
-            data[0].append(float(tmp[0]))
-            data[1].append(float(tmp[1]))
-    # Close file
-    in_file.close()
+            data[0].append(float(row[0]))
+            data[1].append(float(row[1]))
     # Return data
     return data
 
@@ -991,10 +988,11 @@ def plot_fas_gof(plottitle, gof_fileroot, indir,
                   transparent=False, dpi=plot_config.dpi)
     pylab.close()
 
-def parse_arguments():
+def parse_arguments(argv=None):
     """
     This function takes care of parsing the command-line arguments and
-    asking the user for any missing parameters that we need
+    asking the user for any missing parameters that we need, from
+    argv (sys.argv[1:] if None)
     """
     parser = argparse.ArgumentParser(description="Generates PSA comparison GoF plot.")
     parser.add_argument("--input-dir", dest="input_dir",
@@ -1021,16 +1019,16 @@ def parse_arguments():
     parser.add_argument("--plot-title", "--title", dest="plot_title",
                         default="GOF Comparison Plot",
                         help="select plot title for the GoF plot")
-    args = parser.parse_args()
+    args = parser.parse_args(argv)
     
     return args
 
-def run():
+def run(argv=None):
     """
     Generate PSA GoF plot
     """
     # Parse command-line options
-    args = parse_arguments()
+    args = parse_arguments(argv)
 
     # Look at paths
     input_dir = ""
@@ -1071,4 +1069,4 @@ def run():
          lfreq=args.lfreq, hfreq=args.hfreq)
 
 if __name__ == '__main__':
-    run()
+    os_utilities.run_entry_point(run)
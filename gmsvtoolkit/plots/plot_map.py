@@ -52,6 +52,7 @@ import pylab
 from core import gmsvtoolkit_config
 from utils import fault_utilities
 from plots import plot_config
+from utils import os_utilities
 
 # GMT "bf" native binary header and format
 GMT_HDR_FORMAT = '<3i10d80s80s80s80s320s160s'
@@ -305,10 +306,11 @@ def plot_station_map(plottitle, plotregion, topo, coastal, border,
                   transparent=False, dpi=plot_config.dpi)
     pylab.close()
 
-def parse_arguments():
+def parse_arguments(argv=None):
     """
     This function takes care of parsing the command-line arguments and
-    asking the user for any missing parameters that we need
+    asking the user for any missing parameters that we need, from
+    argv (sys.argv[1:] if None)
     """
     parser = argparse.ArgumentParser(description="Generates station map plot.")
     parser.add_argument("--input-dir", dest="input_dir",
@@ -321,15 +323,15 @@ def parse_arguments():
                         help="station list")
     parser.add_argument("--plot-title", "--title", dest="plot_title",
                         help="set plot title")
-    args = parser.parse_args()
+    args = parser.parse_args(argv)
 
     return args
 
-def run():
+def run(argv=None):
     """
     Generate station plot
     """
-    args = parse_arguments()
+    args = parse_arguments(argv)
 
     # Look at paths
     input_dir = ""
@@ -392,4 +394,4 @@ def run():
                      map_prefix, [hypo_coord])
 
 if __name__ == '__main__':
-    run()
+    os_utilities.run_entry_point(run)
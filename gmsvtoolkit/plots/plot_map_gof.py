@@ -51,6 +51,8 @@ from core import gmsvtoolkit_config
 from utils import fault_utilities
 from plots import plot_map
 from plots import plot_config
+from utils import file_utilities
+from utils import os_utilities
 
 # Constants
 MIN_Y_AXIS = -1.75
@@ -59,76 +61,56 @@ COMP_EXT_RD50 = 'rotd50'
 COMP_TITLE_RD50 = 'RotD50'
 DIST_PERIODS = [0.01, 0.05, 0.1, 0.2, 0.5, 1.0, 2.0, 5.0]
 
-def read_resid(resid_file, component, period, summary_output):
+def read_resid(resid_file, component, periods, summary_outputs):
     """
-    Reads the residual file resid_file and returns all data for the
-    requested period
+    Reads the residual file resid_file once and returns all data for
+    each of the requested periods
     """
-    # Start empty
-    sta_x_data = []
-    sta_y_data = []
-    sta_resid_data = []
-
-    # Read residuals file and get information we need
-    input_file = open(resid_file, 'r')
-    # Look over header and figure out which column contains the period
-    # we need to plot
-    header = input_file.readline()
-    header = header.strip()
-    items = header.split()
-    index = -1
-    for idx, item in enumerate(items):
-        try:
-            val = float(item)
-            if val == period:
-                # Found period, save index
-                index = idx
-                break
-        except:
-            pass
-
-    if index < 0:
-        # If we don't have this period, nothing to do
-        print ("Residuals file %s does not have data for period %f" %
-               (resid_file, period))
-        # Close input file
-        input_file.close()
-        # Return empty sets
-        return sta_x_data, sta_y_data, sta_resid_data
-
-    # Index #3 has lon, #4 has lat
-    # Index #12 has component
-    # Indexes #10 and #11 have period range for valid data
-
-    # Read the rest of the file
-    for line in input_file:
-        items = line.split()
-        comp = items[12]
-        lon = items[3]
-        lat = items[4]
-        tmin = items[10]
-        tmax = items[11]
-        value = items[index]
-        # Skip components we don't know
-        if comp != component:
-            continue
-        if period >= float(tmin) and period <= float(tmax):
-            # Data within range, take it
-            sta_x_data.append(float(lon))
-            sta_y_data.append(float(lat))
-            sta_resid_data.append(float(value))
+    all_sta_x_data = []
+    all_sta_y_data = []
+    all_sta_resid_data = []
 
-    # Done reading the file
-    input_file.close()
+    # Read only the columns we need from the residuals file
+    columns = ["lon", "lat", "T_min", "T_max", "comp"]
+    meta, all_values = file_utilities.read_resid_periods(resid_file, columns,
+                                                         periods)
+    for period, values, summary_output in zip(periods, all_values,
+                                              summary_outputs):
+        # Start empty
+        sta_x_data = []
+        sta_y_data = []
+        sta_resid_data = []
+        all_sta_x_data.append(sta_x_data)
+        all_sta_y_data.append(sta_y_data)
+        all_sta_resid_data.append(sta_resid_data)
 
-    # Write summary output for later processing
-    output_file = open(summary_output, 'w')
-    for lon, lat, val in zip(sta_x_data, sta_y_data, sta_resid_data):
-        output_file.write("%f %f %f\n" % (lon, lat, val))
-    output_file.close()
+        if values is None:
+            # If we don't have this period, nothing to do
+            print("Residuals file %s does not have data for period %f" %
+                  (resid_file, period))
+            continue
+
+        for lon, lat, tmin, tmax, comp, value in zip(meta["lon"], meta["lat"],
+                                                     meta["T_min"],
+                                                     meta["T_max"],
+                                                     meta["comp"], values):
+            # Skip components we don't know
+            if comp != component:
+                continue
+            if period >= float(tmin) and period <= float(tmax):
+                # Data within range, take it
+                sta_x_data.append(float(lon))
+                sta_y_data.append(float(lat))
+                sta_resid_data.append(float(value))
+
+        # Write summary output for later processing
+        output_file = open(summary_output, 'w')
+        for lon, lat, val in zip(sta_x_data, sta_y_data, sta_resid_data):
+            output_file.write("%f %f %f\n" % (lon, lat, val))
+        output_file.close()
 
     # Return the data we found
-    return sta_x_data, sta_y_data, sta_resid_data
+    return all_sta_x_data, all_sta_y_data, all_sta_resid_data
 
 def plot_map_gof(src_file, station_file, resid_file, comp_label, input_dir,
                  output_dir, plot_title=None, plot_periods=None,
@@ -175,19 +157,12 @@ def plot_map_gof(src_file, station_file, resid_file, comp_label, input_dir,
     border = os.path.join(install.PLOT_DATA_DIR, 'wdb_borders_h.txt')
 
     # Collect all the data from the residuals file
-    all_sta_x_data = []
-    all_sta_y_data = []
-    all_sta_resid_data = []
-    for period in plot_periods:
-        summary_output = os.path.join(input_dir, "%s-resid-map-%.3f-%s.txt" %
-                                      (comp_label, period, component))
-        sta_x_data, sta_y_data, sta_resid_data = read_resid(resid_file,
-                                                            component,
-                                                            period,
-                                                            summary_output)
-        all_sta_x_data.append(sta_x_data)
-        all_sta_y_data.append(sta_y_data)
-        all_sta_resid_data.append(sta_resid_data)
+    summary_outputs = [os.path.join(input_dir, "%s-resid-map-%.3f-%s.txt" %
+                                    (comp_label, period, component))
+                       for period in plot_periods]
+    (all_sta_x_data, all_sta_y_data,
+     all_sta_resid_data) = read_resid(resid_file, component,
+                                      plot_periods, summary_outputs)
 
     # Now create the map GOF
     map_gof_file = os.path.join(output_dir, "gof-map-%s-%s.png" %
@@ -330,10 +305,11 @@ def create_map_gof(all_sta_x_data, all_sta_y_data, all_sta_resid_data,
     fig.savefig(map_gof_file, format="png", transparent=False, dpi=plot_config.dpi)
     pylab.close()
 
-def parse_arguments():
+def parse_arguments(argv=None):
     """
     This function takes care of parsing the command-line arguments and
-    asking the user for any missing parameters that we need
+    asking the user for any missing parameters that we need, from
+    argv (sys.argv[1:] if None)
     """
     parser = argparse.ArgumentParser(description="Generates PSA Vs30 comparison "
                                      " GoF plot.")
@@ -353,16 +329,16 @@ def parse_arguments():
                         help="select RotD50 comparison (default)")
     parser.add_argument("--plot-title", "--title", dest="plot_title",
                         help="set plot title")
-    args = parser.parse_args()
+    args = parser.parse_args(argv)
 
     return args
 
-def run():
+def run(argv=None):
     """
     Generate PSA Vs30 GoF plot
     """
     # Parse command-line options
-    args = parse_arguments()
+    args = parse_arguments(argv)
 
     # Look at paths
     input_dir = ""
@@ -403,10 +379,10 @@ def run():
         sys,exit(1)
 
     # Select the residuals file
-    resid_file = os.path.join(input_dir, "%s.%s-resid.txt" %
-                              (args.comp_label, extension))
+    resid_file = file_utilities.get_resid_file(input_dir, args.comp_label,
+                                               extension)
     plot_map_gof(src_file, station_file, resid_file, args.comp_label,
                  input_dir, output_dir, plot_title)
     
 if __name__ == '__main__':
-    run()
+    os_utilities.run_entry_point(run)
@@ -38,6 +38,7 @@ from __future__ import division, print_function
 import os
 import sys
 import glob
+import multiprocessing
 import matplotlib as mpl
 mpl.use('AGG')
 import pylab
@@ -47,6 +48,34 @@ import argparse
 from plots import plot_config
 from core.station_list import StationList
 from utils.file_utilities import read_rdxx
+from utils import os_utilities
+
+# Line styles for the input files
+ALL_STYLES = ['C0', 'C2', 'k', 'r', 'b', 'm', 'g', 'c', 'y',
+              'brown', 'gold', 'blueviolet', 'grey', 'pink']
+
+# Figure re-used by plot_rdxx_job for all the stations a process plots
+_BATCH_FIGURE = None
+
+def check_rdxx_plot(input_files, rdxxs, output_file, mode):
+    """
+    Checks the inputs of one comparison plot, exits with an error
+    message if they cannot be plotted
+    """
+    if mode.lower() not in ["rotd50", "rotd100"]:
+        print("[ERROR]: mode must be set to rotd50 or rotd100!")
+        sys.exit(1)
+    if len(input_files) > len(ALL_STYLES):
+        print("[ERROR]: Too many files to plot!")
+        sys.exit(-1)
+    for rdxx in rdxxs:
+        if len(rdxx[0]) != len(rdxxs[0][0]):
+            print("[PLOTRDXX]: All inputs must have the same number of periods!")
+            sys.exit(1)
+    if (not output_file.lower().endswith(".png") and
+        not output_file.lower().endswith(".pdf")):
+        print("[ERROR]: Unknown format!")
+        sys.exit(1)
 
 def create_rdxx_plot(station_id, input_files, labels, output_file,
                      lfreq=None, hfreq=None, mode="rotd50",
@@ -58,22 +87,29 @@ def create_rdxx_plot(station_id, input_files, labels, output_file,
     if not quiet:
         print("[PLOTRDXX]: Plotting comparison for station %s..." % (station_id))
 
+    # Read input files
+    rdxxs = [read_rdxx(input_file) for input_file in input_files]
+    check_rdxx_plot(input_files, rdxxs, output_file, mode)
+
+    fig = pylab.figure()
+    render_rdxx_plot(fig, station_id, rdxxs, labels, output_file,
+                     lfreq=lfreq, hfreq=hfreq, mode=mode)
+    pylab.close(fig)
+
+def render_rdxx_plot(fig, station_id, rdxxs, labels, output_file,
+                     lfreq=None, hfreq=None, mode="rotd50"):
+    """
+    Draws the comparison plot of the RotDXX data rdxxs (as returned by
+    read_rdxx, checked by check_rdxx_plot) on fig and saves it
+    """
     # Select plot titles
     if mode.lower() == "rotd50":
         plot_titles = ["Hor 1", "Hor 2", "RotD50"]
-    elif mode.lower() == "rotd100":
-        plot_titles = ["Hor 1", "Hor 2", "RotD100"]
     else:
-        print("[ERROR]: mode must be set to rotd50 or rotd100!")
-        sys.exit(1)
+        plot_titles = ["Hor 1", "Hor 2", "RotD100"]
 
     # Select line styles to use
-    all_styles = ['C0', 'C2', 'k', 'r', 'b', 'm', 'g', 'c', 'y',
-                  'brown', 'gold', 'blueviolet', 'grey', 'pink']
-    if len(input_files) > len(all_styles):
-        print("[ERROR]: Too many files to plot!")
-        sys.exit(-1)
-    styles = all_styles[0:len(input_files)]
+    styles = ALL_STYLES[0:len(rdxxs)]
 
     # Convert min/max frequencies to periods
     if lfreq is None:
@@ -86,9 +122,6 @@ def create_rdxx_plot(station_id, input_files, labels, output_file,
     else:
         pmin = 1.0 / float(hfreq)
 
-    # Read input files
-    rdxxs = [read_rdxx(input_file) for input_file in input_files]
-
     # Check nummber of periods, separate PSA by component
     periods = rdxxs[0][0]
     min_y = min(rdxxs[0][1])
@@ -106,9 +139,6 @@ def create_rdxx_plot(station_id, input_files, labels, output_file,
         max_y = max(max_y, max(rdxx[1]))
         max_y = max(max_y, max(rdxx[2]))
         max_y = max(max_y, max(rdxx[3]))
-        if len(rdxx[0]) != len(periods):
-            print("[PLOTRDXX]: All inputs must have the same number of periods!")
-            sys.exit(1)
 
     # Figure out plot limits
     min_x = min(periods)
@@ -126,96 +156,101 @@ def create_rdxx_plot(station_id, input_files, labels, output_file,
     mpl.rcParams['lines.scale_dashes'] = False
 
     # Start plot
-    pylab.clf()
-    pylab.suptitle('PSA for station %s, %s' %
-                   (station_id, " vs ".join(labels)), size=14)
-
-    pylab.subplots_adjust(top=0.85)
-    pylab.subplots_adjust(bottom=0.15)
-    pylab.subplots_adjust(left=0.075)
-    pylab.subplots_adjust(right=0.975)
-    pylab.subplots_adjust(hspace=0.3)
-    pylab.subplots_adjust(wspace=0.3)
-
-    # First plot
-    ax1 = pylab.subplot(131)
-    for psa, label, style in zip(psa_h1, labels, styles):
-        pylab.plot(periods, psa, style, label=label, lw=0.5)
-    pylab.xlim(min_x, max_x)
-    pylab.xscale('log')
-    pylab.ylim(min_horiz_y, max_horiz_y)
-    pylab.ylabel("PSA (g)")
-    ax1.set_title('%s' % (plot_titles[0]), fontsize='small')
-    pylab.xlabel('Period (s)')
-    # Add vertical lines
-    if pmin is not None:
-        pylab.vlines(pmin, min_horiz_y, max_horiz_y,
-                     color='violet', linestyles='--')
-    if pmax is not None:
-        pylab.vlines(pmax, min_horiz_y, max_horiz_y, color='r', linestyles='--')
-    pylab.legend(prop=mpl.font_manager.FontProperties(size=8))
-
-    # Second plot
-    ax2 = pylab.subplot(132)
-    for psa, label, style in zip(psa_h2, labels, styles):
-        pylab.plot(periods, psa, style, label=label, lw=0.5)
-    pylab.xlim(min_x, max_x)
-    pylab.xscale('log')
-    pylab.ylim(min_horiz_y, max_horiz_y)
-    pylab.ylabel("PSA (g)")
-    ax2.set_title('%s' % (plot_titles[1]), fontsize='small')
-    pylab.xlabel('Period (s)')
-    # Add vertical lines
-    if pmin is not None:
-        pylab.vlines(pmin, min_horiz_y, max_horiz_y,
-                     color='violet', linestyles='--')
-    if pmax is not None:
-        pylab.vlines(pmax, min_horiz_y, max_horiz_y, color='r', linestyles='--')
-    pylab.legend(prop=mpl.font_manager.FontProperties(size=8))
-
-    # Third plot
-    ax3 = pylab.subplot(133)
-    for psa, label, style in zip(psa_rdxx, labels, styles):
-        pylab.plot(periods, psa, style, label=label, lw=0.5)
-    pylab.xlim(min_x, max_x)
-    pylab.xscale('log')
-    pylab.ylim(min_horiz_y, max_horiz_y)
-    pylab.ylabel("PSA (g)")
-    ax3.set_title('%s' % (plot_titles[2]), fontsize='small')
-    pylab.xlabel('Period (s)')
-    # Add vertical lines
-    if pmin is not None:
-        pylab.vlines(pmin, min_horiz_y, max_horiz_y,
-                     color='violet', linestyles='--')
-    if pmax is not None:
-        pylab.vlines(pmax, min_horiz_y, max_horiz_y, color='r', linestyles='--')
-    pylab.legend(prop=mpl.font_manager.FontProperties(size=8))
+    fig.clf()
+    fig.suptitle('PSA for station %s, %s' %
+                 (station_id, " vs ".join(labels)), size=14)
+
+    fig.subplots_adjust(top=0.85)
+    fig.subplots_adjust(bottom=0.15)
+    fig.subplots_adjust(left=0.075)
+    fig.subplots_adjust(right=0.975)
+    fig.subplots_adjust(hspace=0.3)
+    fig.subplots_adjust(wspace=0.3)
+
+    # The three plots only differ in the data and the title
+    for subplot, all_psa, plot_title in zip([131, 132, 133],
+                                            [psa_h1, psa_h2, psa_rdxx],
+                                            plot_titles):
+        axs = fig.add_subplot(subplot)
+        for psa, label, style in zip(all_psa, labels, styles):
+            axs.plot(periods, psa, style, label=label, lw=0.5)
+        axs.set_xlim(min_x, max_x)
+        axs.set_xscale('log')
+        axs.set_ylim(min_horiz_y, max_horiz_y)
+        axs.set_ylabel("PSA (g)")
+        axs.set_title('%s' % (plot_title), fontsize='small')
+        axs.set_xlabel('Period (s)')
+        # Add vertical lines
+        if pmin is not None:
+            axs.vlines(pmin, min_horiz_y, max_horiz_y,
+                       color='violet', linestyles='--')
+        if pmax is not None:
+            axs.vlines(pmax, min_horiz_y, max_horiz_y, color='r',
+                       linestyles='--')
+        axs.legend(prop=mpl.font_manager.FontProperties(size=8))
 
     # All done, save plot
-    pylab.gcf().set_size_inches(10, 4)
-    
+    fig.set_size_inches(10, 4)
+
     if output_file.lower().endswith(".png"):
         fmt = 'png'
-    elif output_file.lower().endswith(".pdf"):
-        fmt = 'pdf'
     else:
-        print("[ERROR]: Unknown format!")
-        sys.exit(1)
+        fmt = 'pdf'
+
+    fig.savefig(output_file, format=fmt,
+                transparent=False,
+                dpi=plot_config.dpi)
 
-    pylab.savefig(output_file, format=fmt,
-                  transparent=False,
-                  dpi=plot_config.dpi)
-    pylab.close()
+def plot_rdxx_job(job):
+    """
+    Renders one (station_id, rdxxs, labels, output_file, lfreq, hfreq,
+    mode) plot for create_rdxx_plots, re-using this process' figure
+    """
+    global _BATCH_FIGURE
+
+    if _BATCH_FIGURE is None:
+        _BATCH_FIGURE = pylab.figure()
+    station_id, rdxxs, labels, output_file, lfreq, hfreq, mode = job
+    render_rdxx_plot(_BATCH_FIGURE, station_id, rdxxs, labels, output_file,
+                     lfreq=lfreq, hfreq=hfreq, mode=mode)
+
+def create_rdxx_plots(jobs, num_procs=1):
+    """
+    Generates the comparison plots for a list of (station_id,
+    input_files, labels, output_file, lfreq, hfreq, mode) jobs. All
+    the spectra are read and checked first, then the plots are drawn
+    by num_procs processes. Each plot goes to its own output file, so
+    the outputs do not depend on the order the processes finish in
+    """
+    plot_jobs = []
+    for station_id, input_files, labels, output_file, lfreq, hfreq, mode in jobs:
+        rdxxs = [read_rdxx(input_file) for input_file in input_files]
+        check_rdxx_plot(input_files, rdxxs, output_file, mode)
+        plot_jobs.append((station_id, rdxxs, labels, output_file,
+                          lfreq, hfreq, mode))
+
+    num_procs = max(1, min(num_procs, len(plot_jobs)))
+    if num_procs > 1:
+        pool = multiprocessing.Pool(num_procs)
+        pool.map(plot_rdxx_job, plot_jobs,
+                 chunksize=max(1, len(plot_jobs) // (4 * num_procs)))
+        pool.close()
+        pool.join()
+    else:
+        for plot_job in plot_jobs:
+            plot_rdxx_job(plot_job)
 
 class PlotRotDXX(object):
 
     def __init__(self):
         self.comp_label = None
+        self.jobs = 1
 
-    def parse_arguments(self):
+    def parse_arguments(self, argv=None):
         """
         This function takes care of parsing the command-line arguments and
-        asking the user for any missing parameters that we need
+        asking the user for any missing parameters that we need, from
+        argv (sys.argv[1:] if None)
         """
         parser = argparse.ArgumentParser(description="Plot RotD50/RotD100 "
                                          " comparison of two or more files.")
@@ -244,17 +279,22 @@ class PlotRotDXX(object):
                             help="adds vertical line at this low frequency corner")
         parser.add_argument("--high-freq", "--hf", dest="hfreq",
                             help="adds vertical line at this high frequency corner")
+        parser.add_argument("--jobs", "-j", dest="jobs", type=int,
+                            default=multiprocessing.cpu_count(),
+                            help="number of plots drawn in parallel in "
+                            "batch and station list modes "
+                            "(default: number of CPUs)")
         parser.add_argument('input_files', nargs='*')
-        args = parser.parse_args()
+        args = parser.parse_args(argv)
 
         return args
         
-    def run(self):
+    def run(self, argv=None):
         """
         Run PlotRotDXX module
         """
         # Parse command-line options
-        args = self.parse_arguments()
+        args = self.parse_arguments(argv)
 
         # Make sure we have something to do
         if len(args.input_files) == 0:
@@ -268,6 +308,7 @@ class PlotRotDXX(object):
             sys.exit(1)
         if args.rotd100:
             self.mode = "rotd100"
+        self.jobs = args.jobs
 
         # Look at paths
         output_dir = ""
@@ -338,6 +379,7 @@ class PlotRotDXX(object):
             sys.exit(1)
 
         # Open batch file
+        jobs = []
         input_list = open(batch_file, 'r')
         for line in input_list:
             line = line.strip()
@@ -348,11 +390,12 @@ class PlotRotDXX(object):
             lfreq = None
             hfreq = None
             
-            self.run_directory_mode(station_name, extension, lfreq,
-                                    hfreq, input_dirs, labels,
-                                    output_dir, comp_label)
+            jobs.append(self.directory_job(station_name, extension, lfreq,
+                                           hfreq, input_dirs, labels,
+                                           output_dir, comp_label))
 
         input_list.close()
+        self.run_jobs(jobs)
 
     def run_station_mode(self, station_file, input_dirs, labels,
                          output_dir, comp_label):
@@ -371,20 +414,46 @@ class PlotRotDXX(object):
         station_list = stations.get_station_list()
 
         # Loop through stations
+        jobs = []
         for station in station_list:
             station_name = station.scode
             lfreq = station.low_freq_corner
             hfreq = station.high_freq_corner
 
-            self.run_directory_mode(station_name, extension, lfreq,
-                                    hfreq, input_dirs, labels,
-                                    output_dir, comp_label)
+            jobs.append(self.directory_job(station_name, extension, lfreq,
+                                           hfreq, input_dirs, labels,
+                                           output_dir, comp_label))
+        self.run_jobs(jobs)
+
+    def run_jobs(self, jobs):
+        """
+        Generates the RotDXX comparison plots of a station list or
+        batch file, with self.jobs processes
+        """
+        for job in jobs:
+            print("[PLOTRDXX]: Generating RotDXX comparison plot for station %s" % (job[0]))
+        create_rdxx_plots(jobs, self.jobs)
 
     def run_directory_mode(self, station_name, extension, lfreq, hfreq,
                            input_dirs, labels, output_dir, comp_label):
         """
+        Finds files matching the station name and generates comparison
+        plot
+        """
+        (station_name, input_files, labels, output_file,
+         lfreq, hfreq, _) = self.directory_job(station_name, extension,
+                                               lfreq, hfreq, input_dirs,
+                                               labels, output_dir,
+                                               comp_label)
+        self.run_single_station(input_files, labels, output_file,
+                                station_name, lfreq=lfreq, hfreq=hfreq)
+
+    def directory_job(self, station_name, extension, lfreq, hfreq,
+                      input_dirs, labels, output_dir, comp_label):
+        """
         Used by both station_mode and batch_mode, finds files matching
-        the station name and generates comparison plot
+        the station name and returns the create_rdxx_plots job for the
+        comparison plot
         """
         # Make list of all input files
         input_files = []
@@ -407,13 +476,9 @@ class PlotRotDXX(object):
                                          self.mode)
         output_file = os.path.join(output_dir, output_file)
 
-        self.run_single_station(input_files, labels, output_file,
-                                station_name, lfreq=lfreq, hfreq=hfreq)
+        return (station_name, input_files, labels, output_file,
+                lfreq, hfreq, self.mode)
             
 if __name__ == '__main__':
     print("Running module: %s" % (os.path.basename(sys.argv[0])))
-    ME = PlotRotDXX()
-    ME.run()
-    
-
-
+    os_utilities.run_entry_point(lambda argv: PlotRotDXX().run(argv))
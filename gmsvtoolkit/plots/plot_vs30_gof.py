@@ -46,6 +46,8 @@ import pylab
 # Imports needed from the GMSVToolkit
 from core import exceptions
 from plots import plot_config
+from utils import file_utilities
+from utils import os_utilities
 
 # Constants
 MIN_Y_AXIS = -1.75
@@ -54,73 +56,51 @@ COMP_EXT_RD50 = 'rotd50'
 COMP_TITLE_RD50 = 'RotD50'
 PLOT_PERIODS = [0.01, 0.05, 0.1, 0.2, 0.5, 1.0, 2.0, 5.0]
 
-def read_resid(resid_file, component, period, summary_output):
+def read_resid(resid_file, component, periods, summary_outputs):
     """
-    Reads the residual file resid_file and returns all data for the
-    requested period
+    Reads the residual file resid_file once and returns all data for
+    each of the requested periods
     """
-    # Start empty
-    data = []
-    vs30s = []
-
-    # Read residuals file and get information we need
-    input_file = open(resid_file, 'r')
-    # Look over header and figure out which column contains the period
-    # we need to plot
-    header = input_file.readline()
-    header = header.strip()
-    items = header.split()
-    index = -1
-    for idx, item in enumerate(items):
-        try:
-            val = float(item)
-            if val == period:
-                # Found period, save index
-                index = idx
-                break
-        except:
-            pass
-
-    if index < 0:
-        # If we don't have this period, nothing to do
-        print("Residuals file %s does not have data for period %f" %
-              (resid_file, period))
-        # Close input file
-        input_file.close()
-        # Return empty sets
-        return data, vs30s
-
-    # Index #6 has vs30
-    # Index #12 has component
-    # Indexes #10 and #11 have period range for valid data
-
-    # Read the rest of the file
-    for line in input_file:
-        items = line.split()
-        comp = items[12]
-        vs30 = items[6]
-        tmin = items[10]
-        tmax = items[11]
-        value = items[index]
-        # Skip components we don't know
-        if comp != component:
-            continue
-        if period >= float(tmin) and period <= float(tmax):
-            # Data within range, take it
-            data.append(float(value))
-            vs30s.append(float(vs30))
+    all_data = []
+    all_vs30s = []
 
-    # Done reading the file
-    input_file.close()
+    # Read only the columns we need from the residuals file
+    columns = ["Vs30", "T_min", "T_max", "comp"]
+    meta, all_values = file_utilities.read_resid_periods(resid_file, columns,
+                                                         periods)
+    for period, values, summary_output in zip(periods, all_values,
+                                              summary_outputs):
+        # Start empty
+        data = []
+        vs30s = []
+        all_data.append(data)
+        all_vs30s.append(vs30s)
 
-    # Write summary output for later processing
-    output_file = open(summary_output, 'w')
-    for vs30, val in zip(vs30s, data):
-        output_file.write("%f %f\n" % (vs30, val))
-    output_file.close()
+        if values is None:
+            # If we don't have this period, nothing to do
+            print("Residuals file %s does not have data for period %f" %
+                  (resid_file, period))
+            continue
+
+        for vs30, tmin, tmax, comp, value in zip(meta["Vs30"],
+                                                 meta["T_min"], meta["T_max"],
+                                                 meta["comp"], values):
+            # Skip components we don't know
+            if comp != component:
+                continue
+            if period >= float(tmin) and period <= float(tmax):
+                # Data within range, take it
+                data.append(float(value))
+                vs30s.append(float(vs30))
+
+        # Write summary output for later processing
+        output_file = open(summary_output, 'w')
+        for vs30, val in zip(vs30s, data):
+            output_file.write("%f %f\n" % (vs30, val))
+        output_file.close()
 
     # Return the data we found
-    return data, vs30s
+    return all_data, all_vs30s
 
 def plot_vs30_gof(resid_file, comp_label, input_dir,
                   output_dir, plot_title=None,
@@ -135,16 +115,12 @@ def plot_vs30_gof(resid_file, comp_label, input_dir,
     if plot_periods is None:
         plot_periods = PLOT_PERIODS
 
-    # Collect all the data
-    all_data = []
-    all_vs30s = []
-    # Read the residuals data
-    for period in plot_periods:
-        summary_output = os.path.join(input_dir, "%s-resid-vs30-%.3f-%s.txt" %
-                                      (comp_label, period, component))
-        data, vs30s = read_resid(resid_file, component, period, summary_output)
-        all_data.append(data)
-        all_vs30s.append(vs30s)
+    # Collect all the data from the residuals file
+    summary_outputs = [os.path.join(input_dir, "%s-resid-vs30-%.3f-%s.txt" %
+                                    (comp_label, period, component))
+                       for period in plot_periods]
+    all_data, all_vs30s = read_resid(resid_file, component,
+                                     plot_periods, summary_outputs)
 
     # Now create the GoF plot
     vs30_gof_file = os.path.join(output_dir,
@@ -211,10 +187,11 @@ def create_vs30_gof(all_data, all_vs30s, plot_title,
     fig.savefig(vs30_gof_file, format="png", transparent=False, dpi=plot_config.dpi)
     pylab.close()
 
-def parse_arguments():
+def parse_arguments(argv=None):
     """
     This function takes care of parsing the command-line arguments and
-    asking the user for any missing parameters that we need
+    asking the user for any missing parameters that we need, from
+    argv (sys.argv[1:] if None)
     """
     parser = argparse.ArgumentParser(description="Generates PSA Vs30 comparison "
                                      " GoF plot.")
@@ -230,16 +207,16 @@ def parse_arguments():
                         help="select RotD50 comparison (default)")
     parser.add_argument("--plot-title", "--title", dest="plot_title",
                         help="set plot title")
-    args = parser.parse_args()
+    args = parser.parse_args(argv)
 
     return args
 
-def run():
+def run(argv=None):
     """
     Generate PSA Vs30 GoF plot
     """
     # Parse command-line options
-    args = parse_arguments()
+    args = parse_arguments(argv)
 
     # Look at paths
     input_dir = ""
@@ -270,10 +247,10 @@ def run():
         sys,exit(1)
 
     # Select the residuals file
-    resid_file = os.path.join(input_dir, "%s.%s-resid.txt" %
-                              (args.comp_label, extension))
+    resid_file = file_utilities.get_resid_file(input_dir, args.comp_label,
+                                               extension)
     plot_vs30_gof(resid_file, args.comp_label, input_dir,
                   output_dir, plot_title)
 
 if __name__ == '__main__':
-    run()
+    os_utilities.run_entry_point(run)
@@ -1,5 +1,5 @@
-void *check_malloc(int);
-void *check_realloc(void *, int);
+void *check_malloc(size_t);
+void *check_realloc(void *, size_t);
 FILE *fopfile(char*, char*);
 int opfile_ro(char *);
 int opfile(char *);
@@ -9,6 +9,33 @@ int rite(int, void *, int);
 
 void swap_in_place(int,char *);
 
-void read_specfile(char *,float *,float *,int,int,int);
-void read_bbpfile(char *,float *,float *,float *,int);
-void read_bbpfile_3comp(char *,float *,float *,float *,float *,int);
+int spec_read(char *,int,int,int,int,float **,float **);
+float *spec_cache(char *,int,int,int,int *,float **);
+void spec_cache_free();
+
+struct rtb_header;
+struct pinterp;
+void rtb_write(char *,int,int,float *,char *,float *);
+FILE *rtb_open(char *,struct rtb_header *);
+int rtb_meta_index(char *);
+void rtb_read_meta(FILE *,struct rtb_header *,int,char *);
+void rtb_read_resid(FILE *,struct rtb_header *,int,float *);
+
+struct pinterp *pinterp_get(float *,int,float *,int);
+void pinterp_apply(struct pinterp *,float *,float *);
+int pinterp_regrid(float **,int,float *,int,int,float **,float **);
+
+struct rag_header;
+void rag_write(char *,int,char (*)[16],int,float *,int,float *,int,float *,int *,int *,double *,double *);
+float *rag_periods(char *,int *);
+void rag_merge(char *,int,char (*)[16],int,float *,int,float *,int,float *,int *,int *,double *,double *);
+
+struct resid_stat;
+int read_statlist(char *,struct resid_stat **);
+void resid_spectrum(float *,float *,int,float *,float *,int,float *,int,float *);
+char *format_station(struct resid_stat *,float *,int,char *,char *,char *,char *,char *);
+
+void welford(float,int *,double *,double *);
+void welford_merge(int *,double *,double *,int,double,double);
+int row_slot(float *,char *,int,char (*)[16],int,int,float *,float *);
+void uncert_write(char *,int,float *,int *,double *,double *);
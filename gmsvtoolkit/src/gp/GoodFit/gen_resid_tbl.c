@@ -17,6 +17,7 @@
 #include <sys/types.h>
 #include <string.h>
 
+#include "structure.h"
 #include "function.h"
 #include "getpar.h"
 
@@ -24,14 +25,15 @@
 
 int main(int ac,char **av)
 {
-FILE *fpr, *fopfile();
-float *per, *sa1, *sa2, *res1, *res2, *avgr, v[8];
+FILE *fopfile();
+float *per, *sa1, *sa2, *res1, *res2, *avgr;
 float rpga1, rpga2, avgpga, rpgv1, rpgv2, avgpgv;
-int i, np2, np;
+int i, np, nps, fmt;
+float *sper, *obs[3], *sim[3];
 float flo = 0.0;
 float fhi = 0.0;
 
-char statinfo[512], str[SLEN];
+char statinfo[512];
 char eq[128], mag[16], stat[16], lon[16], lat[16];
 char seqno[16], vs30[16], cd[16], xc[16], yc[16], tmin[16], tmax[16];
 
@@ -113,6 +115,8 @@ if(bbp_format == 1)
 
 getpar("respect_format","d",&respect_format);
 
+/* without np= a two-column file is read to its end */
+np = 0;
 if(respect_format == 0 && bbp_format == 0)
    getpar("np","d",&np);
 
@@ -133,50 +137,30 @@ else
 sprintf(statinfo,"%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s",eq,mag,stat,lon,lat,seqno,vs30,cd,xc,yc,tmin,tmax);
 
 if(respect_format)
-   {
-   fpr = fopfile(datafile1,"r");
-
-   fgets(str,SLEN,fpr);
-   fgets(str,SLEN,fpr);
-   fgets(str,SLEN,fpr);
-   fgets(str,SLEN,fpr);
-
-   sscanf(str,"%d",&np);
-
-   fclose(fpr);
-   }
+   fmt = SPEC_RESPECT;
 else if(bbp_format == 1)
-   {
-   fpr = fopfile(datafile1,"r");
-
-   fgets(str,SLEN,fpr);
-   while(strncmp(str,"#",1) == 0)
-      fgets(str,SLEN,fpr);
-
-   np = 1;
-   while(fgets(str,SLEN,fpr) != NULL)
-      np++;
-
-   fclose(fpr);
-   }
-
-per = (float *)check_malloc(np*sizeof(float));
-sa1 = (float *)check_malloc(np*sizeof(float));
-sa2 = (float *)check_malloc(np*sizeof(float));
-res1 = (float *)check_malloc(np*sizeof(float));
-res2 = (float *)check_malloc(np*sizeof(float));
-avgr = (float *)check_malloc(np*sizeof(float));
+   fmt = SPEC_BBP;
+else
+   fmt = SPEC_2COL;
 
 if(bbp_format == 1)
-   read_bbpfile(datafile1,per,sa1,sa2,np);
+   {
+   np = spec_read(datafile1,SPEC_BBP,0,2,np,&per,obs);
+   sa1 = obs[0];
+   sa2 = obs[1];
+   }
 else
    {
-   read_specfile(datafile1,per,sa1,np,sa_field,respect_format);
-   read_specfile(datafile2,per,sa2,np,sa_field,respect_format);
+   np = spec_read(datafile1,fmt,sa_field,1,np,&per,&sa1);
+   free(per);
+   spec_read(datafile2,fmt,sa_field,1,np,&per,&sa2);
    }
 
 if(simfile1[0] == '\0' || (bbp_format == 0 && simfile2[0] == '\0'))
    {
+   res1 = (float *)check_malloc(np*sizeof(float));
+   res2 = (float *)check_malloc(np*sizeof(float));
+   avgr = (float *)check_malloc(np*sizeof(float));
    for(i=0;i<np;i++)
       {
       res1[i] = sa1[i];
@@ -198,13 +182,27 @@ if(simfile1[0] == '\0' || (bbp_format == 0 && simfile2[0] == '\0'))
    }
 else
    {
+   /* sim spectra may be on another period grid, see pinterp_regrid() */
    if(bbp_format == 1)
-      read_bbpfile(simfile1,per,res1,res2,np);
+      {
+     nps = spec_read(simfile1,SPEC_BBP,0,2,0,&sper,sim);
+     obs[0] = sa1;
+     obs[1] = sa2;
+     np = pinterp_regrid(&per,np,sper,nps,2,obs,sim);
+     sa1 = obs[0];
+     sa2 = obs[1];
+     free(sper);
+     }
    else
       {
-      read_specfile(simfile1,per,res1,np,sa_field,respect_format);
-      read_specfile(simfile2,per,res2,np,sa_field,respect_format);
+      spec_read(simfile1,fmt,sa_field,1,np,&sper,&sim[0]);
+      free(sper);
+      free(per);
+      spec_read(simfile2,fmt,sa_field,1,np,&per,&sim[1]);
       }
+   res1 = sim[0];
+   res2 = sim[1];
+   avgr = (float *)check_malloc(np*sizeof(float));
 
    for(i=0;i<np;i++)
       {
@@ -333,7 +331,7 @@ fprintf(stdout,"\n");
  return(0);
 }
 
-void *check_malloc(int len)
+void *check_malloc(size_t len)
 {
 char *ptr;
 
@@ -348,86 +346,27 @@ if(ptr == NULL)
 return(ptr);
 }
 
-FILE *fopfile(char *name,char *mode)
+void *check_realloc(void *ptr,size_t len)
 {
-FILE *fp;
+ptr = (char *) realloc (ptr,len);
 
-if((fp = fopen(name,mode)) == NULL)
+if(ptr == NULL)
    {
-   fprintf(stderr,"CAN'T FOPEN FILE = %s, MODE = %s\n", name, mode);
+   fprintf(stderr,"*****  memory reallocation error\n");
    exit(-1);
    }
-return(fp);
-}
-
-void read_specfile(char *file,float *per,float *sa,int np,int sa_field,int flag)
-{
-FILE *fpr;
-float v[8];
-int i, np2;
-char str[SLEN];
-
-fpr = fopfile(file,"r");
-
-if(flag)
-   {
-   fgets(str,SLEN,fpr);
-   fgets(str,SLEN,fpr);
-   fgets(str,SLEN,fpr);
-   fgets(str,SLEN,fpr);
-
-   sscanf(str,"%d",&np2);
 
-   if(np2 != np)
-      {
-      fprintf(stderr,"No. periods not equal, exiting...\n");
-      exit(-1);
-      }
-
-   for(i=0;i<np;i++)
-      {
-      fgets(str,SLEN,fpr);
-      sscanf(str,"%f %f %f %f %f %f %f %f",&v[0],&v[1],&v[2],&v[3],&v[4],&v[5],&v[6],&v[7]);
-      per[i] = v[1];
-      sa[i] = v[sa_field-1];
-      }
-   }
-else
-   {
-   for(i=0;i<np;i++)
-      {
-      fgets(str,SLEN,fpr);
-      sscanf(str,"%f %f",&per[i],&sa[i]);
-      }
-   }
-
-fclose(fpr);
+return(ptr);
 }
 
-void read_bbpfile(char *file,float *per,float *sa1,float *sa2,int np)
+FILE *fopfile(char *name,char *mode)
 {
-FILE *fpr;
-int i, nr;
-char str[SLEN];
-
-fpr = fopfile(file,"r");
-
-fgets(str,SLEN,fpr);
-while(strncmp(str,"#",1) == 0)
-   fgets(str,SLEN,fpr);
+FILE *fp;
 
-for(i=0;i<np;i++)
+if((fp = fopen(name,mode)) == NULL)
    {
-   nr = sscanf(str,"%f %f %f",&per[i],&sa1[i],&sa2[i]);
-   if(nr < 3)
-      {
-      fprintf(stderr,"Error in file= %s\n",file);
-      fprintf(stderr,"found %d columns, expecting at least 3, exiting...\n",nr);
-      exit(-1);
-      }
-
-   if(i < np-1)
-      fgets(str,SLEN,fpr);
+   fprintf(stderr,"CAN'T FOPEN FILE = %s, MODE = %s\n", name, mode);
+   exit(-1);
    }
-fclose(fpr);
+return(fp);
 }
@@ -14,16 +14,17 @@
 #include <sys/time.h>
 #include <sys/types.h>
 
-void *check_malloc(int);
-FILE *fopfile(char*, char*);
+#include "structure.h"
+#include "function.h"
 
 main(int ac,char **av)
 {
-FILE *fpr, *fopfile();
-float *per, *sa1, *sa2, *res1, *res2, *avgr, v[8];
-int i, np2, np;
+FILE *fopfile();
+float *per, *sa1, *sa2, *res1, *res2, *avgr;
+float *sper, *sim1, *sim2;
+int i, np, fmt;
 
-char statinfo[512], string[512];
+char statinfo[512];
 char eq[16], mag[16], stat[16], lon[16], lat[16];
 char seqno[16], vs30[16], cd[16], xc[16], yc[16];
 
@@ -60,56 +61,17 @@ endpar();
 
 sprintf(statinfo,"%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s",eq,mag,stat,lon,lat,seqno,vs30,cd,xc,yc);
 
-fpr = fopfile(datafile1,"r");
+fmt = SPEC_RESPECT;
+np = 0;
 
-fgets(string,512,fpr);
-fgets(string,512,fpr);
-fgets(string,512,fpr);
-fgets(string,512,fpr);
+np = spec_read(datafile1,fmt,sa_field,1,np,&per,&sa1);
+spec_read(datafile2,fmt,sa_field,1,np,&sper,&sa2);
+free(sper);
 
-sscanf(string,"%d",&np);
-
-per = (float *)check_malloc(np*sizeof(float));
-sa1 = (float *)check_malloc(np*sizeof(float));
-sa2 = (float *)check_malloc(np*sizeof(float));
 res1 = (float *)check_malloc(np*sizeof(float));
 res2 = (float *)check_malloc(np*sizeof(float));
 avgr = (float *)check_malloc(np*sizeof(float));
 
-for(i=0;i<np;i++)
-   {
-   fgets(string,512,fpr);
-   sscanf(string,"%f %f %f %f %f %f %f %f",&v[0],&v[1],&v[2],&v[3],&v[4],&v[5],&v[6],&v[7]);
-   per[i] = v[1];
-   sa1[i] = v[sa_field-1];
-   }
-
-fclose(fpr);
-
-fpr = fopfile(datafile2,"r");
-
-fgets(string,512,fpr);
-fgets(string,512,fpr);
-fgets(string,512,fpr);
-fgets(string,512,fpr);
-
-sscanf(string,"%d",&np2);
-
-if(np2 != np)
-   {
-   fprintf(stderr,"No. periods not equal, exiting...\n");
-   exit(-1);
-   }
-
-for(i=0;i<np;i++)
-   {
-   fgets(string,512,fpr);
-   sscanf(string,"%f %f %f %f %f %f %f %f",&v[0],&v[1],&v[2],&v[3],&v[4],&v[5],&v[6],&v[7]);
-   sa2[i] = v[sa_field-1];
-   }
-
-fclose(fpr);
-
 if(simfile1[0] == '\0' || simfile2[0] == '\0')
    {
    for(i=0;i<np;i++)
@@ -121,61 +83,23 @@ if(simfile1[0] == '\0' || simfile2[0] == '\0')
    }
 else
    {
-   fpr = fopfile(simfile1,"r");
-
-   fgets(string,512,fpr);
-   fgets(string,512,fpr);
-   fgets(string,512,fpr);
-   fgets(string,512,fpr);
-
-   sscanf(string,"%d",&np2);
-
-   if(np2 != np)
-      {
-      fprintf(stderr,"No. periods not equal, exiting...\n");
-      exit(-1);
-      }
+   spec_read(simfile1,fmt,sa_field,1,np,&sper,&sim1);
+   free(sper);
+   spec_read(simfile2,fmt,sa_field,1,np,&sper,&sim2);
+   free(sper);
 
    for(i=0;i<np;i++)
       {
-      fgets(string,512,fpr);
-      sscanf(string,"%f %f %f %f %f %f %f %f",&v[0],&v[1],&v[2],&v[3],&v[4],&v[5],&v[6],&v[7]);
-
       res1[i] = -99;
-      if(v[sa_field-1] != 0.0)
-         res1[i] = log(sa1[i]/v[sa_field-1]);
-      }
-
-   fclose(fpr);
-
-   fpr = fopfile(simfile2,"r");
-
-   fgets(string,512,fpr);
-   fgets(string,512,fpr);
-   fgets(string,512,fpr);
-   fgets(string,512,fpr);
-
-   sscanf(string,"%d",&np2);
-
-   if(np2 != np)
-      {
-      fprintf(stderr,"No. periods not equal, exiting...\n");
-      exit(-1);
-      }
-
-   for(i=0;i<np;i++)
-      {
-      fgets(string,512,fpr);
-      sscanf(string,"%f %f %f %f %f %f %f %f",&v[0],&v[1],&v[2],&v[3],&v[4],&v[5],&v[6],&v[7]);
+      if(sim1[i] != 0.0)
+         res1[i] = log(sa1[i]/sim1[i]);
 
       res2[i] = -99;
-      if(v[sa_field-1] != 0.0)
-         res2[i] = log(sa2[i]/v[sa_field-1]);
+      if(sim2[i] != 0.0)
+         res2[i] = log(sa2[i]/sim2[i]);
 
       avgr[i] = 0.5*(res1[i]+res2[i]);
       }
-
-   fclose(fpr);
    }
 
 if(print_header)
@@ -219,7 +143,7 @@ for(i=0;i<np;i++)
 fprintf(stdout,"\n");
 }
 
-void *check_malloc(int len)
+void *check_malloc(size_t len)
 {
 char *ptr;
 
@@ -234,6 +158,19 @@ if(ptr == NULL)
 return(ptr);
 }
 
+void *check_realloc(void *ptr,size_t len)
+{
+ptr = (char *) realloc (ptr,len);
+
+if(ptr == NULL)
+   {
+   fprintf(stderr,"*****  memory reallocation error\n");
+   exit(-1);
+   }
+
+return(ptr);
+}
+
 FILE *fopfile(char *name,char *mode)
 {
 FILE *fp;
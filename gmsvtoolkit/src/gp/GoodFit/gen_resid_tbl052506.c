@@ -13,18 +13,19 @@
 #include <sys/time.h>
 #include <sys/types.h>
 
-void *check_malloc(int);
-FILE *fopfile(char*, char*);
+#include "structure.h"
+#include "function.h"
 
 main(int ac,char **av)
 {
-FILE *fpr, *fopfile();
-float *per, *sa1, *sa2, *res1, *res2, *avgr, v[8];
-int i, np2, np;
+FILE *fopfile();
+float *per, *sa1, *sa2, *res1, *res2, *avgr;
+float *sper, *sim1, *sim2;
+int i, np, fmt;
 float flo = 0.0;
 float fhi = 0.0;
 
-char statinfo[512], string[512];
+char statinfo[512];
 char eq[16], mag[16], stat[16], lon[16], lat[16];
 char seqno[16], vs30[16], cd[16], xc[16], yc[16], tmin[16], tmax[16];
 
@@ -86,58 +87,21 @@ else
 
 sprintf(statinfo,"%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s",eq,mag,stat,lon,lat,seqno,vs30,cd,xc,yc,tmin,tmax);
 
-fpr = fopfile(datafile1,"r");
-
-read_specfile(datafile1,per,sa1,np,sa_field,respect_format);
-
-fgets(string,512,fpr);
-fgets(string,512,fpr);
-fgets(string,512,fpr);
-fgets(string,512,fpr);
+fmt = SPEC_2COL;
+if(respect_format)
+   {
+   fmt = SPEC_RESPECT;
+   np = 0;
+   }
 
-sscanf(string,"%d",&np);
+np = spec_read(datafile1,fmt,sa_field,1,np,&per,&sa1);
+spec_read(datafile2,fmt,sa_field,1,np,&sper,&sa2);
+free(sper);
 
-per = (float *)check_malloc(np*sizeof(float));
-sa1 = (float *)check_malloc(np*sizeof(float));
-sa2 = (float *)check_malloc(np*sizeof(float));
 res1 = (float *)check_malloc(np*sizeof(float));
 res2 = (float *)check_malloc(np*sizeof(float));
 avgr = (float *)check_malloc(np*sizeof(float));
 
-for(i=0;i<np;i++)
-   {
-   fgets(string,512,fpr);
-   sscanf(string,"%f %f %f %f %f %f %f %f",&v[0],&v[1],&v[2],&v[3],&v[4],&v[5],&v[6],&v[7]);
-   per[i] = v[1];
-   sa1[i] = v[sa_field-1];
-   }
-
-fclose(fpr);
-
-fpr = fopfile(datafile2,"r");
-
-fgets(string,512,fpr);
-fgets(string,512,fpr);
-fgets(string,512,fpr);
-fgets(string,512,fpr);
-
-sscanf(string,"%d",&np2);
-
-if(np2 != np)
-   {
-   fprintf(stderr,"No. periods not equal, exiting...\n");
-   exit(-1);
-   }
-
-for(i=0;i<np;i++)
-   {
-   fgets(string,512,fpr);
-   sscanf(string,"%f %f %f %f %f %f %f %f",&v[0],&v[1],&v[2],&v[3],&v[4],&v[5],&v[6],&v[7]);
-   sa2[i] = v[sa_field-1];
-   }
-
-fclose(fpr);
-
 if(simfile1[0] == '\0' || simfile2[0] == '\0')
    {
    for(i=0;i<np;i++)
@@ -149,61 +113,23 @@ if(simfile1[0] == '\0' || simfile2[0] == '\0')
    }
 else
    {
-   fpr = fopfile(simfile1,"r");
-
-   fgets(string,512,fpr);
-   fgets(string,512,fpr);
-   fgets(string,512,fpr);
-   fgets(string,512,fpr);
-
-   sscanf(string,"%d",&np2);
-
-   if(np2 != np)
-      {
-      fprintf(stderr,"No. periods not equal, exiting...\n");
-      exit(-1);
-      }
+   spec_read(simfile1,fmt,sa_field,1,np,&sper,&sim1);
+   free(sper);
+   spec_read(simfile2,fmt,sa_field,1,np,&sper,&sim2);
+   free(sper);
 
    for(i=0;i<np;i++)
       {
-      fgets(string,512,fpr);
-      sscanf(string,"%f %f %f %f %f %f %f %f",&v[0],&v[1],&v[2],&v[3],&v[4],&v[5],&v[6],&v[7]);
-
       res1[i] = -99;
-      if(v[sa_field-1] != 0.0)
-         res1[i] = log(sa1[i]/v[sa_field-1]);
-      }
-
-   fclose(fpr);
-
-   fpr = fopfile(simfile2,"r");
-
-   fgets(string,512,fpr);
-   fgets(string,512,fpr);
-   fgets(string,512,fpr);
-   fgets(string,512,fpr);
-
-   sscanf(string,"%d",&np2);
-
-   if(np2 != np)
-      {
-      fprintf(stderr,"No. periods not equal, exiting...\n");
-      exit(-1);
-      }
-
-   for(i=0;i<np;i++)
-      {
-      fgets(string,512,fpr);
-      sscanf(string,"%f %f %f %f %f %f %f %f",&v[0],&v[1],&v[2],&v[3],&v[4],&v[5],&v[6],&v[7]);
+      if(sim1[i] != 0.0)
+         res1[i] = log(sa1[i]/sim1[i]);
 
       res2[i] = -99;
-      if(v[sa_field-1] != 0.0)
-         res2[i] = log(sa2[i]/v[sa_field-1]);
+      if(sim2[i] != 0.0)
+         res2[i] = log(sa2[i]/sim2[i]);
 
       avgr[i] = 0.5*(res1[i]+res2[i]);
       }
-
-   fclose(fpr);
    }
 
 if(print_header)
@@ -273,7 +199,7 @@ if(pgv1 >= 0.0)
 fprintf(stdout,"\n");
 }
 
-void *check_malloc(int len)
+void *check_malloc(size_t len)
 {
 char *ptr;
 
@@ -288,49 +214,27 @@ if(ptr == NULL)
 return(ptr);
 }
 
-FILE *fopfile(char *name,char *mode)
+void *check_realloc(void *ptr,size_t len)
 {
-FILE *fp;
+ptr = (char *) realloc (ptr,len);
 
-if((fp = fopen(name,mode)) == NULL)
+if(ptr == NULL)
    {
-   fprintf(stderr,"CAN'T FOPEN FILE = %s, MODE = %s\n", name, mode);
+   fprintf(stderr,"*****  memory reallocation error\n");
    exit(-1);
    }
-return(fp);
+
+return(ptr);
 }
 
-void read_specfile(char *file,float *per,float *sa,int np,int sa_field,int flag)
+FILE *fopfile(char *name,char *mode)
 {
-FILE *fpr;
-float v[8];
-int i, np2;
-char string[512];
-
-fpr = fopfile(file,"r");
+FILE *fp;
 
-if(flag)
+if((fp = fopen(name,mode)) == NULL)
    {
-   fgets(string,512,fpr);
-   fgets(string,512,fpr);
-   fgets(string,512,fpr);
-   fgets(string,512,fpr);
-
-   sscanf(string,"%d",&np2);
-
-   if(np2 != np)
-      {
-      fprintf(stderr,"No. periods not equal, exiting...\n");
-      exit(-1);
-      }
-
-   for(i=0;i<np;i++)
-      {
-      fgets(string,512,fpr);
-      sscanf(string,"%f %f %f %f %f %f %f %f",&v[0],&v[1],&v[2],&v[3],&v[4],&v[5],&v[6],&v[7]);
-      sa[i] = v[sa_field-1];
-      }
+   fprintf(stderr,"CAN'T FOPEN FILE = %s, MODE = %s\n", name, mode);
+   exit(-1);
    }
-
-fclose(fpr);
+return(fp);
 }
@@ -0,0 +1,243 @@
+/*
+ * gen_resid_tbl_batch: multi-station version of gen_resid_tbl_3comp
+ * (bbp_format=1) that computes the whole residual table in one process.
+ *
+ * Usage: gen_resid_tbl_batch statlist= eqname= mag= comp1= comp2= comp3=
+ *                            [outfile=] [binfile=] [print_header=1]
+ *                            [nthreads=1]
+ *
+ * statlist has one station per line (blank lines and '#' lines skipped):
+ *
+ *    stat lon lat vs30 cd flo fhi obsfile simfile
+ *
+ * lon, lat, vs30 and cd are copied into the table as given, flo and fhi
+ * set T_max/T_min exactly like gen_resid_tbl_3comp.  Stations are done
+ * in parallel (nthreads=, OpenMP) but written in statlist order, so the
+ * output is identical to concatenating the per-station runs.
+ *
+ * binfile= also (or, with outfile=none, only) writes the table in the
+ * columnar binary form of resid_bin.c.
+ *
+ * The table uses the periods of the first station's sim file.  Obs or
+ * sim spectra on another period grid are interpolated onto it (log-log,
+ * period_interp.c), with the weights shared by all stations on that grid.
+ * Stations with the same obsfile (e.g. several simulations of one
+ * station) parse it only once, see spec_cache() in spec_read.c.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "structure.h"
+#include "function.h"
+#include "getpar.h"
+
+#define SLEN 1024
+
+void write_binary(char *,struct resid_stat *,int,char *,char *,char *,char *,char *);
+
+int main(int ac,char **av)
+{
+FILE *fpw;
+struct resid_stat *st;
+float *tper, *tsa[3];
+int i, ns, tnp;
+
+char statlist[SLEN], outfile[SLEN], binfile[SLEN];
+char eq[128], mag[16];
+char comp1[128], comp2[128], comp3[128];
+int print_header = 1;
+int nthreads = 1;
+
+outfile[0] = '\0';
+binfile[0] = '\0';
+sprintf(eq,"-999");
+sprintf(mag,"-999");
+
+setpar(ac,av);
+mstpar("statlist","s",statlist);
+mstpar("comp1","s",comp1);
+mstpar("comp2","s",comp2);
+mstpar("comp3","s",comp3);
+getpar("eqname","s",eq);
+getpar("mag","s",mag);
+getpar("outfile","s",outfile);
+getpar("binfile","s",binfile);
+getpar("print_header","d",&print_header);
+getpar("nthreads","d",&nthreads);
+endpar();
+
+ns = read_statlist(statlist,&st);
+if(ns == 0)
+   {
+   fprintf(stderr,"No stations in statlist= %s, exiting...\n",statlist);
+   exit(-1);
+   }
+
+#ifdef _OPENMP
+if(nthreads > 0)
+   omp_set_num_threads(nthreads);
+#endif
+
+/* table periods */
+tnp = spec_read(st[0].simfile,SPEC_BBP,0,3,0,&tper,tsa);
+for(i=0;i<3;i++)
+   free(tsa[i]);
+
+#pragma omp parallel for schedule(dynamic,1)
+for(i=0;i<ns;i++)
+   st[i].buf = format_station(&st[i],tper,tnp,eq,mag,comp1,comp2,comp3);
+
+if(binfile[0] != '\0')
+   write_binary(binfile,st,ns,eq,mag,comp1,comp2,comp3);
+
+if(strcmp(outfile,"none") == 0)
+   fpw = NULL;
+else if(outfile[0] == '\0')
+   fpw = stdout;
+else
+   fpw = fopfile(outfile,"w");
+
+if(fpw != NULL && print_header)
+   {
+   fprintf(fpw,"%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t\%s","EQ",
+                                                            "Mag",
+                                                            "stat",
+                                                            "lon",
+                                                            "lat",
+                                                            "stat_seq_no",
+                                                            "Vs30",
+                                                            "close_dist",
+                                                            "Xcos",
+                                                            "Ycos",
+                                                            "T_min",
+                                                            "T_max",
+                                                            "comp");
+   for(i=0;i<st[0].np;i++)
+      fprintf(fpw,"\t%.5e",st[0].per[i]);
+
+   fprintf(fpw,"\n");
+   }
+
+for(i=0;i<ns;i++)
+   {
+   if(fpw != NULL)
+      fputs(st[i].buf,fpw);
+   free(st[i].buf);
+   free(st[i].per);
+   free(st[i].res);
+   }
+
+if(fpw != NULL && fpw != stdout)
+   fclose(fpw);
+
+free(st);
+free(tper);
+spec_cache_free();
+return(0);
+}
+
+/*
+   Same rows as the text table: three per station, comp1..comp3, with
+   the metadata fields kept as the strings printed in the text form.
+*/
+
+void write_binary(char *file,struct resid_stat *st,int ns,char *eq,char *mag,char *comp1,char *comp2,char *comp3)
+{
+char *meta, *mp, *fld[RTB_NMETA];
+float *res;
+int i, k, n, np;
+
+np = st[0].np;
+meta = (char *)check_malloc(3*ns*RTB_NMETA*RTB_MWIDTH);
+res = (float *)check_malloc(3*ns*np*sizeof(float));
+memset(meta,0,3*ns*RTB_NMETA*RTB_MWIDTH);
+
+for(i=0;i<ns;i++)
+   {
+   if(st[i].np != np)
+      {
+      fprintf(stderr,"station %s has %d periods, %s has %d; binfile= needs the same periods, exiting...\n",
+                         st[i].stat,st[i].np,st[0].stat,np);
+      exit(-1);
+      }
+
+   fld[0] = eq;
+   fld[1] = mag;
+   fld[2] = st[i].stat;
+   fld[3] = st[i].lon;
+   fld[4] = st[i].lat;
+   fld[5] = "-999";
+   fld[6] = st[i].vs30;
+   fld[7] = st[i].cd;
+   fld[8] = "-999";
+   fld[9] = "-999";
+   fld[10] = st[i].tmin;
+   fld[11] = st[i].tmax;
+
+   for(n=0;n<3;n++)
+      {
+      fld[12] = (n == 0) ? comp1 : ((n == 1) ? comp2 : comp3);
+
+      mp = meta + (3*i+n)*RTB_NMETA*RTB_MWIDTH;
+      for(k=0;k<RTB_NMETA;k++)
+         strncpy(mp + k*RTB_MWIDTH,fld[k],RTB_MWIDTH-1);
+
+      memcpy(res + (3*i+n)*np,st[i].res + n*np,np*sizeof(float));
+      }
+   }
+
+rtb_write(file,3*ns,np,st[0].per,meta,res);
+
+free(meta);
+free(res);
+}
+
+void *check_malloc(size_t len)
+{
+char *ptr;
+
+ptr = (char *) malloc (len);
+
+if(ptr == NULL)
+   {
+   fprintf(stderr,"*****  memory allocation error\n");
+   exit(-1);
+   }
+
+return(ptr);
+}
+
+void *check_realloc(void *ptr,size_t len)
+{
+ptr = (char *) realloc (ptr,len);
+
+if(ptr == NULL)
+   {
+   fprintf(stderr,"*****  memory reallocation error\n");
+   exit(-1);
+   }
+
+return(ptr);
+}
+
+FILE *fopfile(char *name,char *mode)
+{
+FILE *fp;
+
+if((fp = fopen(name,mode)) == NULL)
+   {
+   fprintf(stderr,"CAN'T FOPEN FILE = %s, MODE = %s\n", name, mode);
+   exit(-1);
+   }
+return(fp);
+}
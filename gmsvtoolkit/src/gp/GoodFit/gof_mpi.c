@@ -0,0 +1,339 @@
+/*
+ * gof_mpi: PSa goodness of fit of a whole station set, from the RotD
+ * spectra to the bias/sigma files, with the stations distributed over
+ * MPI ranks.
+ *
+ * Usage: mpirun -np N gof_mpi statlist= comp1= comp2= comp3= fileroot=
+ *                             [comps=] [bin_var=cdst] [bins=] [suffix=]
+ *                             [min_cdst= max_cdst= min_vs30= max_vs30=]
+ *                             [nthreads=1]
+ *
+ * statlist is the station list of gen_resid_tbl_batch,
+ *
+ *    stat lon lat vs30 cd flo fhi obsfile simfile
+ *
+ * Rank r takes the stations i with i % nranks == r, computes their
+ * residuals as gen_resid_tbl_batch does (nthreads= OpenMP threads per
+ * rank) and adds them to per component, bin and period accumulators as
+ * resid2uncer_varN does.  The (n, mean, M2) states of all the ranks are
+ * combined with one MPI_Allreduce (welford_merge) and rank 0 writes the
+ * files, named as those of resid2uncer_varN comps=.  comps= (default
+ * comp1,comp2,comp3) selects the components.
+ *
+ * The results are those of gen_resid_tbl_batch binfile= followed by
+ * resid2uncer_varN, up to the rounding of the merged sums (about 1e-15).
+ * Built without USE_MPI (make gof_mpi MPICC=gcc MPIFLAGS=) this is one
+ * rank.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "structure.h"
+#include "function.h"
+#include "getpar.h"
+
+#define SLEN 1024
+#define MAXCOMP 3
+#define MAXBIN 20
+
+#ifdef USE_MPI
+/* MPI_Op of the accumulators: n, mean, M2 as three doubles per cell */
+static void merge_op(void *in,void *inout,int *len,MPI_Datatype *dtype)
+{
+double *a, *b;
+int i, na;
+
+a = (double *) inout;
+b = (double *) in;
+for(i=0;i<*len;i++)
+   {
+   na = (int)a[3*i];
+   welford_merge(&na,&a[3*i+1],&a[3*i+2],(int)b[3*i],b[3*i+1],b[3*i+2]);
+   a[3*i] = na;
+   }
+}
+#endif
+
+int main(int ac,char **av)
+{
+struct resid_stat *st;
+float *tper, *tsa[3], rowv[6], lim[8], bins[MAXBIN+1];
+double *mean, *m2, *acc;
+int *nval, *nstat_read, *mine;
+int i, j, k, n, ns, nmine, tnp, ncomp, nbin, bvar, ic, ib, jc;
+int rank, nranks;
+char *sptr, *cname[3], root[SLEN];
+
+char statlist[SLEN], fileroot[SLEN], comps[MAXCOMP*16];
+char comp1[16], comp2[16], comp3[16], comp[MAXCOMP][16];
+char bin_var[16], suffix[128], sfx[136];
+char eq[128], mag[16];
+int nthreads = 1;
+
+float min_cdst = -1e+15;
+float max_cdst =  1e+15;
+float min_vs30 = -1e+15;
+float max_vs30 =  1e+15;
+
+rank = 0;
+nranks = 1;
+#ifdef USE_MPI
+MPI_Init(&ac,&av);
+MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+MPI_Comm_size(MPI_COMM_WORLD,&nranks);
+#endif
+
+comps[0] = '\0';
+sprintf(bin_var,"cdst");
+suffix[0] = '\0';
+sprintf(eq,"-999");
+sprintf(mag,"-999");
+
+setpar(ac,av);
+mstpar("statlist","s",statlist);
+mstpar("fileroot","s",fileroot);
+mstpar("comp1","s",comp1);
+mstpar("comp2","s",comp2);
+mstpar("comp3","s",comp3);
+getpar("comps","s",comps);
+getpar("min_cdst","f",&min_cdst);
+getpar("max_cdst","f",&max_cdst);
+getpar("min_vs30","f",&min_vs30);
+getpar("max_vs30","f",&max_vs30);
+getpar("bin_var","s",bin_var);
+getpar("suffix","s",suffix);
+nbin = getpar("bins","vf[21]",bins) - 1;
+getpar("nthreads","d",&nthreads);
+endpar();
+
+cname[0] = comp1;
+cname[1] = comp2;
+cname[2] = comp3;
+if(comps[0] == '\0')
+   sprintf(comps,"%s,%s,%s",comp1,comp2,comp3);
+
+ncomp = 0;
+for(sptr=strtok(comps,",");sptr!=NULL;sptr=strtok(NULL,","))
+   {
+   if(ncomp == MAXCOMP)
+      {
+      fprintf(stderr,"more than %d components in comps=, exiting...\n",MAXCOMP);
+      exit(-1);
+      }
+   strncpy(comp[ncomp],sptr,15);
+   comp[ncomp][15] = '\0';
+   ncomp++;
+   }
+
+/* the batch rows have Xcos = Ycos = -999, so only their limits are open */
+lim[0] = min_vs30;
+lim[1] = max_vs30;
+lim[2] = min_cdst;
+lim[3] = max_cdst;
+lim[4] = -1e+15;
+lim[5] =  1e+15;
+lim[6] = -1e+15;
+lim[7] =  1e+15;
+
+if(strcmp(bin_var,"vs30") == 0)
+   bvar = 0;
+else if(strcmp(bin_var,"cdst") == 0)
+   bvar = 1;
+else
+   {
+   fprintf(stderr,"bin_var= %s not one of cdst, vs30, exiting...\n",bin_var);
+   exit(-1);
+   }
+
+if(nbin < 1)
+   {
+   nbin = 1;
+   bins[0] = lim[2*bvar];
+   bins[1] = lim[2*bvar+1];
+   }
+
+sfx[0] = '\0';
+if(suffix[0] != '\0')
+   sprintf(sfx,"-%s",suffix);
+
+ns = read_statlist(statlist,&st);
+if(ns == 0)
+   {
+   fprintf(stderr,"No stations in statlist= %s, exiting...\n",statlist);
+   exit(-1);
+   }
+
+#ifdef _OPENMP
+if(nthreads > 0)
+   omp_set_num_threads(nthreads);
+#endif
+
+/* table periods, from the first station's sim file on every rank */
+tnp = spec_read(st[0].simfile,SPEC_BBP,0,3,0,&tper,tsa);
+for(i=0;i<3;i++)
+   free(tsa[i]);
+
+/* this rank's stations */
+mine = (int *) check_malloc ((ns/nranks + 1)*sizeof(int));
+nmine = 0;
+for(i=rank;i<ns;i=i+nranks)
+   mine[nmine++] = i;
+
+#pragma omp parallel for private(i) schedule(dynamic,1)
+for(n=0;n<nmine;n++)
+   {
+   i = mine[n];
+   st[i].buf = format_station(&st[i],tper,tnp,eq,mag,comp1,comp2,comp3);
+   free(st[i].buf);
+   }
+spec_cache_free();
+
+nval = (int *) check_malloc (ncomp*nbin*tnp*sizeof(int));
+mean = (double *) check_malloc (ncomp*nbin*tnp*sizeof(double));
+m2 = (double *) check_malloc (ncomp*nbin*tnp*sizeof(double));
+nstat_read = (int *) check_malloc (ncomp*nbin*sizeof(int));
+
+for(i=0;i<ncomp*nbin*tnp;i++)
+   {
+   nval[i] = 0;
+   mean[i] = 0.0;
+   m2[i] = 0.0;
+   }
+for(i=0;i<ncomp*nbin;i++)
+   nstat_read[i] = 0;
+
+/* accumulate in statlist order, the rows of each station comp1..comp3 */
+for(n=0;n<nmine;n++)
+   {
+   i = mine[n];
+   rowv[0] = atof(st[i].vs30);
+   rowv[1] = atof(st[i].cd);
+   rowv[2] = -999;
+   rowv[3] = -999;
+   rowv[4] = atof(st[i].tmin);
+   rowv[5] = atof(st[i].tmax);
+
+   for(jc=0;jc<3;jc++)
+      {
+      if((k = row_slot(rowv,cname[jc],ncomp,comp,bvar,nbin,bins,lim)) < 0)
+         continue;
+
+      nstat_read[k]++;
+      for(j=0;j<tnp;j++)
+         {
+         if(tper[j] >= rowv[4] && tper[j] <= rowv[5])
+            welford(st[i].res[jc*tnp+j],nval+k*tnp+j,mean+k*tnp+j,m2+k*tnp+j);
+         }
+      }
+   free(st[i].res);
+   free(st[i].per);
+   }
+
+/* combine the ranks */
+acc = (double *) check_malloc (3*ncomp*nbin*tnp*sizeof(double));
+for(i=0;i<ncomp*nbin*tnp;i++)
+   {
+   acc[3*i] = nval[i];
+   acc[3*i+1] = mean[i];
+   acc[3*i+2] = m2[i];
+   }
+
+#ifdef USE_MPI
+   {
+   MPI_Datatype cell;
+   MPI_Op merge;
+
+   MPI_Type_contiguous(3,MPI_DOUBLE,&cell);
+   MPI_Type_commit(&cell);
+   MPI_Op_create(merge_op,1,&merge);
+
+   MPI_Allreduce(MPI_IN_PLACE,acc,ncomp*nbin*tnp,cell,merge,MPI_COMM_WORLD);
+   MPI_Allreduce(MPI_IN_PLACE,nstat_read,ncomp*nbin,MPI_INT,MPI_SUM,MPI_COMM_WORLD);
+
+   MPI_Op_free(&merge);
+   MPI_Type_free(&cell);
+   }
+#endif
+
+for(i=0;i<ncomp*nbin*tnp;i++)
+   {
+   nval[i] = (int)acc[3*i];
+   mean[i] = acc[3*i+1];
+   m2[i] = acc[3*i+2];
+   }
+
+if(rank == 0)
+   {
+   for(ic=0;ic<ncomp;ic++)
+      {
+      for(ib=0;ib<nbin;ib++)
+         {
+         k = ic*nbin + ib;
+         fprintf(stderr,"%s nstat_read= %d\n",comp[ic],nstat_read[k]);
+
+         if(nbin == 1)
+            sprintf(root,"%s%s-%s",fileroot,sfx,comp[ic]);
+         else
+            sprintf(root,"%s_%c%g-%g%s-%s",fileroot,"vrxy"[bvar],bins[ib],bins[ib+1],sfx,comp[ic]);
+
+         uncert_write(root,tnp,tper,nval+k*tnp,mean+k*tnp,m2+k*tnp);
+         }
+      }
+   }
+
+#ifdef USE_MPI
+MPI_Finalize();
+#endif
+return(0);
+}
+
+void *check_malloc(size_t len)
+{
+char *ptr;
+
+ptr = (char *) malloc (len);
+
+if(ptr == NULL)
+   {
+   fprintf(stderr,"*****  memory allocation error\n");
+   exit(-1);
+   }
+
+return(ptr);
+}
+
+void *check_realloc(void *ptr,size_t len)
+{
+ptr = (char *) realloc (ptr,len);
+
+if(ptr == NULL)
+   {
+   fprintf(stderr,"*****  memory reallocation error\n");
+   exit(-1);
+   }
+
+return(ptr);
+}
+
+FILE *fopfile(char *name,char *mode)
+{
+FILE *fp;
+
+if((fp = fopen(name,mode)) == NULL)
+   {
+   fprintf(stderr,"CAN'T FOPEN FILE = %s, MODE = %s\n", name, mode);
+   exit(-1);
+   }
+return(fp);
+}
@@ -0,0 +1,199 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "structure.h"
+#include "function.h"
+
+/*
+   Log-log interpolation between period grids.  The weights for a
+   (source,target) grid pair are computed once and cached, so a run over
+   many stations that share grids only pays for the lookup.
+*/
+
+#define PINTERP_TOL 1.0e-04
+#define PINTERP_MAXCACHE 64
+
+static struct pinterp *pinterp_cache[PINTERP_MAXCACHE];
+static int pinterp_ncache = 0;
+
+static int pinterp_same(float *a,int na,float *b,int nb)
+{
+int i;
+
+if(na != nb)
+   return(0);
+
+for(i=0;i<na;i++)
+   {
+   if(fabs(a[i]-b[i]) > PINTERP_TOL*fabs(b[i]))
+      return(0);
+   }
+
+return(1);
+}
+
+static struct pinterp *pinterp_init(float *src,int nsrc,float *dst,int ndst)
+{
+struct pinterp *pi;
+double lt, l0, l1;
+int i, j;
+
+pi = (struct pinterp *) check_malloc (sizeof(struct pinterp));
+pi->nsrc = nsrc;
+pi->ndst = ndst;
+pi->src = (float *) check_malloc (nsrc*sizeof(float));
+pi->dst = (float *) check_malloc (ndst*sizeof(float));
+memcpy(pi->src,src,nsrc*sizeof(float));
+memcpy(pi->dst,dst,ndst*sizeof(float));
+
+pi->ident = pinterp_same(src,nsrc,dst,ndst);
+pi->i0 = NULL;
+pi->w = NULL;
+if(pi->ident)
+   return(pi);
+
+pi->i0 = (int *) check_malloc (ndst*sizeof(int));
+pi->w = (float *) check_malloc (ndst*sizeof(float));
+
+/* src is increasing in period; a target within PINTERP_TOL of an end is kept */
+for(j=0;j<ndst;j++)
+   {
+   pi->i0[j] = -1;
+   pi->w[j] = 0.0;
+
+   for(i=0;i<nsrc;i++)
+      {
+      if(fabs(dst[j]-src[i]) <= PINTERP_TOL*fabs(dst[j]))
+         {
+         pi->i0[j] = (i < nsrc-1) ? i : i-1;
+         pi->w[j] = (i < nsrc-1) ? 0.0 : 1.0;
+         break;
+         }
+
+      if(i < nsrc-1 && dst[j] > src[i] && dst[j] < src[i+1])
+         {
+         lt = log(dst[j]);
+         l0 = log(src[i]);
+         l1 = log(src[i+1]);
+
+         pi->i0[j] = i;
+         pi->w[j] = (lt - l0)/(l1 - l0);
+         break;
+         }
+      }
+   }
+
+return(pi);
+}
+
+struct pinterp *pinterp_get(float *src,int nsrc,float *dst,int ndst)
+{
+struct pinterp *pi;
+int k;
+
+pi = NULL;
+
+#pragma omp critical (pinterp_cache)
+   {
+   for(k=0;k<pinterp_ncache;k++)
+      {
+      if(pinterp_cache[k]->nsrc == nsrc && pinterp_cache[k]->ndst == ndst &&
+         memcmp(pinterp_cache[k]->src,src,nsrc*sizeof(float)) == 0 &&
+         memcmp(pinterp_cache[k]->dst,dst,ndst*sizeof(float)) == 0)
+         {
+         pi = pinterp_cache[k];
+         break;
+         }
+      }
+
+   if(pi == NULL)
+      {
+      pi = pinterp_init(src,nsrc,dst,ndst);
+
+      /* past PINTERP_MAXCACHE grid pairs the weights are just not kept */
+      if(pinterp_ncache < PINTERP_MAXCACHE)
+         pinterp_cache[pinterp_ncache++] = pi;
+      }
+   }
+
+return(pi);
+}
+
+/*
+   out[ndst] from in[nsrc].  Targets outside the source grid, or next
+   to a non-positive value, come out as 0.0.
+*/
+
+void pinterp_apply(struct pinterp *pi,float *in,float *out)
+{
+float a, b;
+int j, i;
+
+if(pi->ident)
+   {
+   memcpy(out,in,pi->ndst*sizeof(float));
+   return;
+   }
+
+for(j=0;j<pi->ndst;j++)
+   {
+   i = pi->i0[j];
+   out[j] = 0.0;
+   if(i < 0)
+      continue;
+
+   a = in[i];
+   b = in[i+1];
+   if(pi->w[j] == 0.0)
+      out[j] = a;
+   else if(pi->w[j] == 1.0)
+      out[j] = b;
+   else if(a > 0.0 && b > 0.0)
+      out[j] = exp((1.0-pi->w[j])*log(a) + pi->w[j]*log(b));
+   }
+}
+
+/*
+   For the single-station tools: obs[nc] spectra on per[np] are put onto
+   the sim periods sper[nps].  On a matching grid only the periods are
+   taken from sper (as before); otherwise *per and each obs[k] are
+   replaced by new arrays on sper, and sim values at periods outside the
+   obs grid are zeroed so they are written as -99.  Returns the new np.
+*/
+
+int pinterp_regrid(float **per,int np,float *sper,int nps,int nc,float **obs,float **sim)
+{
+struct pinterp *pi;
+float *v;
+int j, k;
+
+pi = pinterp_get(*per,np,sper,nps);
+
+if(pi->ident)
+   {
+   memcpy(*per,sper,np*sizeof(float));
+   return(np);
+   }
+
+for(k=0;k<nc;k++)
+   {
+   v = (float *) check_malloc (nps*sizeof(float));
+   pinterp_apply(pi,obs[k],v);
+   free(obs[k]);
+   obs[k] = v;
+
+   for(j=0;j<nps;j++)
+      {
+      if(pi->i0[j] < 0 || v[j] <= 0.0)
+         sim[k][j] = 0.0;
+      }
+   }
+
+free(*per);
+*per = (float *) check_malloc (nps*sizeof(float));
+memcpy(*per,sper,nps*sizeof(float));
+
+return(nps);
+}
@@ -459,7 +459,7 @@ c       print maximum values
       end
 
       subroutine ucmpmx(dur1,kug,ug,time,pr,w,w2,w3,wd,d,z)
-      dimension ug(270000),time(270000),z(3),t(3),c(3),x(2,3)
+      dimension ug(*),time(*),z(3),t(3),c(3),x(2,3)
 
 	print *,dur1,kug,ug(1),time(1),time(kug),pr
       do 10 i=1,3
@@ -508,7 +508,7 @@ c    ,       'td =',f8.4,'   tv =',f8.4,'   ta =',f8.4)
       return
       end
       subroutine cmpmax (dur1,kug,ug,pr,w,w2,w3,wd,d,dt,z)
-      dimension ug(270000),x(2,3),t(3),z(3),c(3)
+      dimension ug(*),x(2,3),t(3),z(3),c(3)
 c
       do 10 i=1,3
       x(1,i)=0.
@@ -13,7 +13,7 @@
 #include <sys/time.h>
 #include <sys/types.h>
 
-void *check_malloc(int);
+void *check_malloc(size_t);
 void uncert(int,int,float *,float *,float *,float *,float *,float *);
 FILE *fopfile(char*, char*);
 char *skipval(int,char *);
@@ -157,7 +157,7 @@ for(i=0;i<nper;i++)
 fclose(fpw);
 }
 
-void *check_malloc(int len)
+void *check_malloc(size_t len)
 {
 char *ptr;
 
@@ -17,30 +17,56 @@
 #include <sys/types.h>
 #include <string.h>
 
-#include "getpar.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
-void *check_malloc(int);
-void uncert(int,int *,float *,float *,int,float *,float *,float *,float *,float *,float *,float *);
+#include "getpar.h"
+#include "structure.h"
+
+#define SLEN 8192
+#define MAXCOMP 8
+#define MAXBIN 20
+#define MAXMERGE 1024
+
+void *check_malloc(size_t);
+void *check_realloc(void *, size_t);
+void welford(float,int *,double *,double *);
+int row_slot(float *,char *,int,char (*)[16],int,int,float *,float *);
+void uncert_write(char *,int,float *,int *,double *,double *);
+void rag_write(char *,int,char (*)[16],int,float *,int,float *,int,float *,int *,int *,double *,double *);
+float *rag_periods(char *,int *);
+void rag_merge(char *,int,char (*)[16],int,float *,int,float *,int,float *,int *,int *,double *,double *);
+void boot_add(float **,int,float);
+void boot_bands(int,int *,float **,int,unsigned int,float,float,float *,float *);
+void boot_write(char *,int,float *,float,float *);
 FILE *fopfile(char*, char*);
 char *skipval(int,char *);
+int countval(char *);
+
+FILE *rtb_open(char *,struct rtb_header *);
+int rtb_meta_index(char *);
+void rtb_read_meta(FILE *,struct rtb_header *,int,char *);
+void rtb_read_resid(FILE *,struct rtb_header *,int,float *);
 char *getstr(char *,char *);
 char *getflt(float *,char *);
 
-float t95[] = {  6.3138, 2.9200, 2.3534, 2.1318, 2.0150, 1.9432, 1.8946,
-                 1.8595, 1.8331, 1.8125, 1.7959, 1.7823, 1.7709, 1.7613,
-                 1.7531, 1.7459, 1.7396, 1.7341, 1.7291, 1.7247, 1.7207,
-                 1.7171, 1.7139, 1.7109, 1.7081, 1.7056, 1.7033, 1.7011,
-                 1.6991, 1.6973, 1.6955, 1.6939, 1.6924, 1.6909, 1.6896,
-                 1.6883, 1.6871, 1.6860, 1.6849, 1.6839, 1.6829, 1.6820,
-                 1.6811, 1.6802, 1.6794, 1.6787, 1.6779, 1.6772, 1.6766,
-                 1.6759, 1.6753, 1.6747, 1.6741, 1.6736, 1.6730 };
-
 int main(int ac,char **av)
 {
-FILE *fpr, *fpw, *fopfile();
-float *per, *resid, vs30, cdst, xcos, ycos, *tmin, *tmax;
-float *bias, *sigma, *sigma0, *cl90m, *cl90p;
-int nstat, nper, *nval, nstat_read, i;
+FILE *fpr, *fopfile();
+struct rtb_header rh;
+float *per, *rv, *rtmin, *rtmax, rowv[6], lim[8];
+double *mean, *m2;
+int nstat, nper, nfld, *nval, *nstat_read, *slot, ncomp, nbin, bvar, single, binary, text, ic, ib, i, j, k;
+int nmerge;
+char *mcol[6], *ccol;
+
+float **bval, *blo, *bhi;
+int nboot = 0;
+int nthreads = 0;
+unsigned int boot_seed = 1;
+float boot_lo = 5.0;
+float boot_hi = 95.0;
 
 float min_cdst = -1e+15;
 float max_cdst =  1e+15;
@@ -50,17 +76,49 @@ float min_xcos = -1e+15;
 float max_xcos =  1e+15;
 float min_ycos = -1e+15;
 float max_ycos =  1e+15;
-
-char residfile[256], fileroot[256], comp[16], rdcomp[16];
-char *sptr, string[2048];
+float bins[MAXBIN+1];
+
+char residfile[256], fileroot[256], comps[MAXCOMP*16], rdcomp[16];
+char bin_var[16], suffix[128], sfx[136];
+char comp[MAXCOMP][16], root[512];
+char *sptr, string[SLEN];
+char aggfile[256], update[256], mergelist[SLEN], *mfile[MAXMERGE];
+
+nstat = -1;
+nper = -1;
+comps[0] = '\0';
+residfile[0] = '\0';
+aggfile[0] = '\0';
+update[0] = '\0';
+mergelist[0] = '\0';
 
 setpar(ac,av);
 
-mstpar("residfile","s",residfile);
+/*
+   Partial aggregates: aggfile= saves the accumulators (n, mean, M2 of
+   each comp, bin and period) after the run.  merge= (comma separated
+   aggregate files) adds saved aggregates in, residfile= being optional
+   then.  update= adds one aggregate in and, without aggfile=, saves the
+   result back to it, so new stations are summarized as
+
+      resid2uncer_varN residfile=new_stations update=all.agg ...
+
+   reading only the new rows.  The aggregates must come from runs with
+   the same comps=, bin_var=, bins=, limits and periods.
+*/
+getpar("merge","s",mergelist);
+getpar("update","s",update);
+getpar("aggfile","s",aggfile);
+if(mergelist[0] == '\0')
+   mstpar("residfile","s",residfile);
+else
+   getpar("residfile","s",residfile);
 mstpar("fileroot","s",fileroot);
-mstpar("comp","s",comp);
-mstpar("nstat","d",&nstat);
-mstpar("nper","d",&nper);
+single = (getpar("comps","s",comps) == 0);
+if(single)
+   mstpar("comp","s",comps);
+getpar("nstat","d",&nstat);
+getpar("nper","d",&nper);
 
 getpar("min_cdst","f",&min_cdst);
 getpar("max_cdst","f",&max_cdst);
@@ -71,108 +129,302 @@ getpar("max_xcos","f",&max_xcos);
 getpar("min_ycos","f",&min_ycos);
 getpar("max_ycos","f",&max_ycos);
 
+/* bins= edges over bin_var= (cdst, vs30, xcos or ycos) */
+sprintf(bin_var,"cdst");
+suffix[0] = '\0';
+getpar("bin_var","s",bin_var);
+getpar("suffix","s",suffix);
+nbin = getpar("bins","vf[21]",bins) - 1;
+if(nbin < 1)
+   nbin = getpar("cdst_bins","vf[21]",bins) - 1;
+
+getpar("nboot","d",&nboot);
+getpar("boot_seed","d",&boot_seed);
+getpar("boot_lo","f",&boot_lo);
+getpar("boot_hi","f",&boot_hi);
+getpar("nthreads","d",&nthreads);
+
 endpar();
 
-nval = (int *) check_malloc (nper*sizeof(float));
-tmin = (float *) check_malloc (nstat*sizeof(float));
-tmax = (float *) check_malloc (nstat*sizeof(float));
+/* comps= is a comma separated list, comp= a single component */
+ncomp = 0;
+for(sptr=strtok(comps,",");sptr!=NULL;sptr=strtok(NULL,","))
+   {
+   if(ncomp == MAXCOMP)
+      {
+      fprintf(stderr,"more than %d components in comps=, exiting...\n",MAXCOMP);
+      exit(-1);
+      }
+   strncpy(comp[ncomp],sptr,15);
+   comp[ncomp][15] = '\0';
+   ncomp++;
+   }
 
-per = (float *) check_malloc (nper*sizeof(float));
-bias = (float *) check_malloc (nper*sizeof(float));
-sigma = (float *) check_malloc (nper*sizeof(float));
-sigma0 = (float *) check_malloc (nper*sizeof(float));
-cl90m = (float *) check_malloc (nper*sizeof(float));
-cl90p = (float *) check_malloc (nper*sizeof(float));
-resid = (float *) check_malloc (nstat*nper*sizeof(float));
+nmerge = 0;
+for(sptr=strtok(mergelist,",");sptr!=NULL;sptr=strtok(NULL,","))
+   {
+   if(nmerge == MAXMERGE)
+      {
+      fprintf(stderr,"more than %d files in merge=, exiting...\n",MAXMERGE);
+      exit(-1);
+      }
+   mfile[nmerge] = sptr;
+   nmerge++;
+   }
 
-fpr = fopfile(residfile,"r");
+if(update[0] != '\0' && aggfile[0] == '\0')
+   strcpy(aggfile,update);
 
-fgets(string,2048,fpr);
-while(strncmp(string,"#",1) == 0)
-   fgets(string,2048,fpr);
+if(nboot > 0 && (nmerge > 0 || update[0] != '\0'))
+   {
+   fprintf(stderr,"nboot= needs all the residuals, not with merge= or update=, exiting...\n");
+   exit(-1);
+   }
 
-sptr = skipval(13,string);
+/* lim[] pairs and bvar index the row values vs30, cdst, xcos, ycos */
+lim[0] = min_vs30;
+lim[1] = max_vs30;
+lim[2] = min_cdst;
+lim[3] = max_cdst;
+lim[4] = min_xcos;
+lim[5] = max_xcos;
+lim[6] = min_ycos;
+lim[7] = max_ycos;
+
+if(strcmp(bin_var,"vs30") == 0)
+   bvar = 0;
+else if(strcmp(bin_var,"cdst") == 0)
+   bvar = 1;
+else if(strcmp(bin_var,"xcos") == 0)
+   bvar = 2;
+else if(strcmp(bin_var,"ycos") == 0)
+   bvar = 3;
+else
+   {
+   fprintf(stderr,"bin_var= %s not one of cdst, vs30, xcos, ycos, exiting...\n",bin_var);
+   exit(-1);
+   }
 
-for(i=0;i<nper;i++)
+/* without bins= there is one bin, the min/max range of bin_var */
+if(nbin < 1)
    {
-   sptr = getflt(&per[i],sptr);
-   nval[i] = 0;
+   nbin = 1;
+   bins[0] = lim[2*bvar];
+   bins[1] = lim[2*bvar+1];
    }
 
-nstat_read = 0;
-while(fgets(string,2048,fpr) != NULL)
+/* per-bin files are fileroot_<r|v|x|y><lo>-<hi>[-suffix]-comp */
+sfx[0] = '\0';
+if(suffix[0] != '\0')
+   sprintf(sfx,"-%s",suffix);
+
+/* binary residual table: read only the columns needed, one at a time */
+fpr = NULL;
+if(residfile[0] != '\0')
+   fpr = rtb_open(residfile,&rh);
+binary = (fpr != NULL);
+text = (residfile[0] != '\0' && !binary);
+
+/* merge= alone: the periods of the first aggregate */
+if(residfile[0] == '\0')
+   {
+   per = rag_periods(mfile[0],&nfld);
+   if(nper < 0 || nper > nfld)
+      nper = nfld;
+   }
+else if(binary)
    {
-   sscanf(string,"%*s %*f %*s %*f %*f %*d %f %f %f %f %f %f %s",&vs30,&cdst,&xcos,&ycos,&tmin[nstat_read],&tmax[nstat_read],rdcomp);
+   if(nper < 0 || nper > rh.nper)
+      nper = rh.nper;
 
-   if((vs30 >= min_vs30 && vs30 <= max_vs30) &&
-      (cdst >= min_cdst && cdst <= max_cdst) &&
-      (xcos >= min_xcos && xcos <= max_xcos) &&
-      (ycos >= min_ycos && ycos <= max_ycos) &&
-      (strcmp(rdcomp,comp)==0) )
-      {
-      sptr = skipval(13,string);
+   per = (float *) check_malloc (rh.nper*sizeof(float));
+   rv = (float *) check_malloc (rh.nrow*sizeof(float));
+   rtb_read_resid(fpr,&rh,-1,per);
+   }
+else
+   {
+   fpr = fopfile(residfile,"r");
 
-      for(i=0;i<nper;i++)
-         sptr = getflt(&resid[i+nstat_read*nper],sptr);
+   fgets(string,SLEN,fpr);
+   while(strncmp(string,"#",1) == 0)
+      fgets(string,SLEN,fpr);
 
-      nstat_read++;
-      }
+   sptr = skipval(13,string);
+   nfld = countval(sptr);
+   if(nper < 0 || nper > nfld)
+      nper = nfld;
 
-   if(nstat_read>nstat)
-      {
-      fprintf(stderr,"(nstat_read= %d) > (nstat= %d), exiting...\n",nstat_read,nstat);
-      exit(-1);
-      }
+   per = (float *) check_malloc (nper*sizeof(float));
+   rv = (float *) check_malloc (nper*sizeof(float));
+
+   for(i=0;i<nper;i++)
+      sptr = getflt(&per[i],sptr);
    }
 
-fclose(fpr);
+nval = (int *) check_malloc (ncomp*nbin*nper*sizeof(int));
+mean = (double *) check_malloc (ncomp*nbin*nper*sizeof(double));
+m2 = (double *) check_malloc (ncomp*nbin*nper*sizeof(double));
+nstat_read = (int *) check_malloc (ncomp*nbin*sizeof(int));
 
-fprintf(stderr,"nstat_read= %d\n",nstat_read);
+for(i=0;i<ncomp*nbin*nper;i++)
+   {
+   nval[i] = 0;
+   mean[i] = 0.0;
+   m2[i] = 0.0;
+   }
+for(i=0;i<ncomp*nbin;i++)
+   nstat_read[i] = 0;
+
+/* the bootstrap needs every residual, kept per accumulator cell */
+bval = NULL;
+blo = NULL;
+bhi = NULL;
+if(nboot > 0)
+   {
+   bval = (float **) check_malloc (ncomp*nbin*nper*sizeof(float *));
+   for(i=0;i<ncomp*nbin*nper;i++)
+      bval[i] = NULL;
+   }
 
-uncert(nstat_read,nval,tmin,tmax,nper,per,resid,bias,sigma,sigma0,cl90m,cl90p);
+if(binary)
+   {
+   slot = (int *) check_malloc (rh.nrow*sizeof(int));
+   rtmin = (float *) check_malloc (rh.nrow*sizeof(float));
+   rtmax = (float *) check_malloc (rh.nrow*sizeof(float));
+   for(k=0;k<6;k++)
+      mcol[k] = (char *) check_malloc (rh.nrow*rh.mwidth);
+   ccol = (char *) check_malloc (rh.nrow*rh.mwidth);
+
+   rtb_read_meta(fpr,&rh,rtb_meta_index("Vs30"),mcol[0]);
+   rtb_read_meta(fpr,&rh,rtb_meta_index("close_dist"),mcol[1]);
+   rtb_read_meta(fpr,&rh,rtb_meta_index("Xcos"),mcol[2]);
+   rtb_read_meta(fpr,&rh,rtb_meta_index("Ycos"),mcol[3]);
+   rtb_read_meta(fpr,&rh,rtb_meta_index("T_min"),mcol[4]);
+   rtb_read_meta(fpr,&rh,rtb_meta_index("T_max"),mcol[5]);
+   rtb_read_meta(fpr,&rh,rtb_meta_index("comp"),ccol);
+
+   for(i=0;i<rh.nrow;i++)
+      {
+      for(k=0;k<6;k++)
+         rowv[k] = atof(mcol[k] + i*rh.mwidth);
+
+      rtmin[i] = rowv[4];
+      rtmax[i] = rowv[5];
+      slot[i] = row_slot(rowv,ccol + i*rh.mwidth,ncomp,comp,bvar,nbin,bins,lim);
+      if(slot[i] >= 0)
+         nstat_read[slot[i]]++;
+      }
 
-sprintf(string,"%s.bias",fileroot);
-fpw = fopfile(string,"w");
+   for(j=0;j<nper;j++)
+      {
+      rtb_read_resid(fpr,&rh,j,rv);
 
-for(i=0;i<nper;i++)
-   fprintf(fpw,"%13.5e %13.5e\n",per[i],bias[i]);
+      for(i=0;i<rh.nrow;i++)
+         {
+         k = slot[i];
+         if(k >= 0 && per[j] >= rtmin[i] && per[j] <= rtmax[i])
+            {
+            welford(rv[i],nval+k*nper+j,mean+k*nper+j,m2+k*nper+j);
+            if(nboot > 0)
+               boot_add(&bval[k*nper+j],nval[k*nper+j],rv[i]);
+            }
+         }
+      }
 
-fclose(fpw);
+   for(k=0;k<ncomp*nbin;k++)
+      {
+      if(nstat > 0 && nstat_read[k] > nstat)
+         {
+         fprintf(stderr,"(nstat_read= %d) > (nstat= %d), exiting...\n",nstat_read[k],nstat);
+         exit(-1);
+         }
+      }
+   }
+else if(text)
+   {
+   while(fgets(string,SLEN,fpr) != NULL)
+      {
+      if(sscanf(string,"%*s %*f %*s %*f %*f %*d %f %f %f %f %f %f %15s",&rowv[0],&rowv[1],&rowv[2],&rowv[3],&rowv[4],&rowv[5],rdcomp) != 7)
+         continue;
 
-sprintf(string,"%s.sigma",fileroot);
-fpw = fopfile(string,"w");
+      if((k = row_slot(rowv,rdcomp,ncomp,comp,bvar,nbin,bins,lim)) < 0)
+         continue;
 
-for(i=0;i<nper;i++)
-   fprintf(fpw,"%13.5e %13.5e\n",per[i],sigma[i]);
+      sptr = skipval(13,string);
+      for(i=0;i<nper;i++)
+         sptr = getflt(&rv[i],sptr);
 
-fclose(fpw);
+      for(j=0;j<nper;j++)
+         {
+         if(per[j] >= rowv[4] && per[j] <= rowv[5])
+            {
+            welford(rv[j],nval+k*nper+j,mean+k*nper+j,m2+k*nper+j);
+            if(nboot > 0)
+               boot_add(&bval[k*nper+j],nval[k*nper+j],rv[j]);
+            }
+         }
+
+      nstat_read[k]++;
+      if(nstat > 0 && nstat_read[k] > nstat)
+         {
+         fprintf(stderr,"(nstat_read= %d) > (nstat= %d), exiting...\n",nstat_read[k],nstat);
+         exit(-1);
+         }
+      }
+   }
 
-sprintf(string,"%s.sigma0",fileroot);
-fpw = fopfile(string,"w");
+if(fpr != NULL)
+   fclose(fpr);
 
-for(i=0;i<nper;i++)
-   fprintf(fpw,"%13.5e %13.5e\n",per[i],sigma0[i]);
+/* saved aggregates are added to the accumulators of residfile */
+for(i=0;i<nmerge;i++)
+   rag_merge(mfile[i],ncomp,comp,nbin,bins,bvar,lim,nper,per,nstat_read,nval,mean,m2);
+if(update[0] != '\0')
+   rag_merge(update,ncomp,comp,nbin,bins,bvar,lim,nper,per,nstat_read,nval,mean,m2);
 
-fclose(fpw);
+if(aggfile[0] != '\0')
+   rag_write(aggfile,ncomp,comp,nbin,bins,bvar,lim,nper,per,nstat_read,nval,mean,m2);
 
-sprintf(string,"%s.m90",fileroot);
-fpw = fopfile(string,"w");
+if(nboot > 0)
+   {
+#ifdef _OPENMP
+   if(nthreads > 0)
+      omp_set_num_threads(nthreads);
+#endif
 
-for(i=0;i<nper;i++)
-   fprintf(fpw,"%13.5e %13.5e\n",per[i],cl90m[i]);
+   blo = (float *) check_malloc (ncomp*nbin*nper*sizeof(float));
+   bhi = (float *) check_malloc (ncomp*nbin*nper*sizeof(float));
+   boot_bands(ncomp*nbin*nper,nval,bval,nboot,boot_seed,boot_lo,boot_hi,blo,bhi);
+   }
 
-fclose(fpw);
+for(ic=0;ic<ncomp;ic++)
+   {
+   for(ib=0;ib<nbin;ib++)
+      {
+      k = ic*nbin + ib;
+      fprintf(stderr,"%s nstat_read= %d\n",comp[ic],nstat_read[k]);
 
-sprintf(string,"%s.p90",fileroot);
-fpw = fopfile(string,"w");
+      if(single && nbin == 1)
+         sprintf(root,"%s%s",fileroot,sfx);
+      else if(nbin == 1)
+         sprintf(root,"%s%s-%s",fileroot,sfx,comp[ic]);
+      else
+         sprintf(root,"%s_%c%g-%g%s-%s",fileroot,"vrxy"[bvar],bins[ib],bins[ib+1],sfx,comp[ic]);
 
-for(i=0;i<nper;i++)
-   fprintf(fpw,"%13.5e %13.5e\n",per[i],cl90p[i]);
+      uncert_write(root,nper,per,nval+k*nper,mean+k*nper,m2+k*nper);
 
-fclose(fpw);
+      if(nboot > 0)
+         {
+         boot_write(root,nper,per,boot_lo,blo+k*nper);
+         boot_write(root,nper,per,boot_hi,bhi+k*nper);
+         }
+      }
+   }
+
+return(0);
 }
 
-void *check_malloc(int len)
+void *check_malloc(size_t len)
 {
 char *ptr;
 
@@ -187,6 +439,19 @@ if(ptr == NULL)
 return(ptr);
 }
 
+void *check_realloc(void *ptr,size_t len)
+{
+ptr = (char *) realloc (ptr,len);
+
+if(ptr == NULL)
+   {
+   fprintf(stderr,"*****  memory reallocation error\n");
+   exit(-1);
+   }
+
+return(ptr);
+}
+
 FILE *fopfile(char *name,char *mode)
 {
 FILE *fp;
@@ -213,6 +478,26 @@ while(j--)
 return(str);
 }
 
+int countval(char *str)
+{
+int n = 0;
+
+while(str[0] != '\0')
+   {
+   while(str[0] == ' ' || str[0] == '\t' || str[0] == '\b' || str[0] == '\n')
+      str++;
+
+   if(str[0] == '\0')
+      break;
+   n++;
+
+   while(str[0] != '\0' && str[0] != ' ' && str[0] != '\t' && str[0] != '\b' && str[0] != '\n')
+      str++;
+   }
+
+return(n);
+}
+
 char *getstr(char *name,char *str)
 {
 sscanf(str,"%s",name);
@@ -239,75 +524,113 @@ while(str[0] == ' ' || str[0] == '\t' || str[0] == '\b' || str[0] == '\n')
 return(str);
 }
 
-void uncert(int ns,int *nv,float *tmin,float *tmax,int np,float *per,float *res,float *b,float *sig,float *sig0,float *m90,float *p90)
+/* append r as value n (1-based) of a cell, doubling at powers of two */
+void boot_add(float **v,int n,float r)
 {
-int i, j;
-float invn, invn1, ttfac;
+if((n & (n-1)) == 0)
+   *v = (float *) check_realloc (*v,2*n*sizeof(float));
+
+(*v)[n-1] = r;
+}
 
 /*
+   Counter-based random numbers: draw i of resample b for cell c is a
+   pure function of (seed,c,b,i), so the bootstrap gives the same bands
+   for any number of threads or order of evaluation.
+*/
+
+static unsigned long long boot_mix(unsigned long long x)
+{
+x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+return(x ^ (x >> 31));
+}
+
+static int boot_cmp(const void *a,const void *b)
+{
+double da = *(const double *)a;
+double db = *(const double *)b;
 
-Bias is given by:
-B = (1/n)*SUM(r[i])
+return((da > db) - (da < db));
+}
 
-Sigma is given by:
-sigma = sqrt { 1/(n-1) SUM(r[i] - B)**2 }
+/* percentile p (0-100) of sorted x[0..n-1], linear between order stats */
+static float boot_pctl(double *x,int n,float p)
+{
+double h;
+int i;
 
-NOTE:
-SUM(r[i] - B)**2 = SUM(r[i]*r[i] - 2*r[i]*B + B*B)
-	    = SUM(r[i]*r[i]) - 2*B*SUM(r[i]) + n*(B*B)
-	    = SUM(r[i]*r[i]) - 2*B*(n*B) + n*(B*B)      where n*B = SUM(r[i])
-            = SUM(r[i]*r[i]) - n*B*B
+h = 0.01*p*(n-1);
+if(h <= 0.0)
+   return(x[0]);
+if(h >= n-1)
+   return(x[n-1]);
 
-SO:
-sigma = sqrt { 1/(n-1) SUM(r[i]*r[i]) - n*B*B }
+i = (int)h;
+return(x[i] + (h-i)*(x[i+1]-x[i]));
+}
 
+/*
+   Bootstrap of the bias (mean residual) for every cell with nv > 1:
+   nboot resamples with replacement, then the plo/phi percentiles of the
+   resampled means.  Cells with nv <= 1 get 0.0 like uncert_write().
 */
 
-for(j=0;j<np;j++)
+void boot_bands(int ncell,int *nv,float **v,int nboot,unsigned int seed,float plo,float phi,float *blo,float *bhi)
+{
+#pragma omp parallel
    {
-   b[j] = 0.0;
-   m90[j] = 0.0;
-   nv[j] = 0;
-   }
+   double *bm, sum;
+   unsigned long long key, r;
+   int c, b, i, n;
 
-for(i=0;i<ns;i++)
-   {
-   for(j=0;j<np;j++)
+   bm = (double *) check_malloc (nboot*sizeof(double));
+
+#pragma omp for schedule(dynamic,1)
+   for(c=0;c<ncell;c++)
       {
-      if(per[j] >= tmin[i] && per[j] <= tmax[i])
+      n = nv[c];
+      if(n < 2)
          {
-         b[j] = b[j] + res[j + i*np];
-         m90[j] = m90[j] + res[j + i*np]*res[j + i*np];  /* temp for now */
-	 nv[j] = nv[j] + 1;
-	 }
+         blo[c] = 0.0;
+         bhi[c] = 0.0;
+         continue;
+         }
+
+      for(b=0;b<nboot;b++)
+         {
+         key = boot_mix(((unsigned long long)seed << 32) ^ (unsigned long long)c);
+         key = boot_mix(key ^ (unsigned long long)b);
+
+         sum = 0.0;
+         for(i=0;i<n;i++)
+            {
+            r = boot_mix(key + (unsigned long long)i);
+            sum = sum + v[c][((r >> 32)*(unsigned long long)n) >> 32];
+            }
+         bm[b] = sum/n;
+         }
+
+      qsort(bm,nboot,sizeof(double),boot_cmp);
+      blo[c] = boot_pctl(bm,nboot,plo);
+      bhi[c] = boot_pctl(bm,nboot,phi);
       }
+
+   free(bm);
    }
+}
 
-for(j=0;j<np;j++)
-   {
-   if(nv[j] > 1)
-      {
-      invn = 1.0/(float)(nv[j]);
-      invn1 = 1.0/(float)(nv[j]-1);
+void boot_write(char *root,int np,float *per,float p,float *band)
+{
+FILE *fpw, *fopfile();
+char string[1024];
+int j;
 
-      if(nv[j] > 56)
-         ttfac = 1.64*sqrt(invn);
-      else
-         ttfac = t95[nv[j]-2]*sqrt(invn);
+sprintf(string,"%s.boot%g",root,p);
+fpw = fopfile(string,"w");
 
-      b[j] = b[j]*invn;
-      sig[j] = sqrt(invn1*(m90[j] - nv[j]*b[j]*b[j]));  /* corrected for bias */
-      sig0[j] = sqrt(invn*(m90[j]));
-      m90[j] = b[j] - sig[j]*ttfac;
-      p90[j] = b[j] + sig[j]*ttfac;
-      }
-   else
-      {
-      b[j] = 0.0;
-      sig[j] = 0.0;
-      sig0[j] = 0.0;
-      m90[j] = 0.0;
-      p90[j] = 0.0;
-      }
-   }
+for(j=0;j<np;j++)
+   fprintf(fpw,"%13.5e %13.5e\n",per[j],band[j]);
+
+fclose(fpw);
 }
@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "structure.h"
+#include "function.h"
+
+/*
+   Partial GoF aggregates.  resid2uncer_varN aggfile= saves the (n, mean,
+   M2) accumulators of every component, bin and period, and merge= or
+   update= adds saved aggregates back in with welford_merge, so a set of
+   stations is summarized once and new stations only cost their own rows.
+   An aggregate can only be merged into accumulators of the same layout:
+   components, bin_var, bins, limits and periods.
+*/
+
+static void rag_fwrite(void *buf,int size,int n,FILE *fpw,char *file)
+{
+if(fwrite(buf,size,n,fpw) != n)
+   {
+   fprintf(stderr,"write error on %s, exiting...\n",file);
+   exit(-1);
+   }
+}
+
+static void rag_fread(void *buf,int size,int n,FILE *fpr,char *file)
+{
+if(fread(buf,size,n,fpr) != n)
+   {
+   fprintf(stderr,"short read on aggregate %s, exiting...\n",file);
+   exit(-1);
+   }
+}
+
+void rag_write(char *file,int ncomp,char (*comp)[16],int nbin,float *bins,int bvar,float *lim,int nper,float *per,int *nstat,int *nval,double *mean,double *m2)
+{
+FILE *fpw;
+struct rag_header ah;
+char cbuf[RAG_COMPCHAR];
+int i, ncell;
+
+memset(&ah,0,sizeof(ah));
+memcpy(ah.magic,RAG_MAGIC,8);
+ah.ncomp = ncomp;
+ah.nbin = nbin;
+ah.nper = nper;
+ah.bvar = bvar;
+ncell = ncomp*nbin*nper;
+
+fpw = fopfile(file,"w");
+
+rag_fwrite(&ah,sizeof(ah),1,fpw,file);
+rag_fwrite(bins,sizeof(float),nbin+1,fpw,file);
+rag_fwrite(lim,sizeof(float),8,fpw,file);
+for(i=0;i<ncomp;i++)
+   {
+   memset(cbuf,0,RAG_COMPCHAR);
+   strncpy(cbuf,comp[i],RAG_COMPCHAR-1);
+   rag_fwrite(cbuf,1,RAG_COMPCHAR,fpw,file);
+   }
+rag_fwrite(per,sizeof(float),nper,fpw,file);
+rag_fwrite(nstat,sizeof(int),ncomp*nbin,fpw,file);
+rag_fwrite(nval,sizeof(int),ncell,fpw,file);
+rag_fwrite(mean,sizeof(double),ncell,fpw,file);
+rag_fwrite(m2,sizeof(double),ncell,fpw,file);
+
+if(fclose(fpw) != 0)
+   {
+   fprintf(stderr,"write error on %s, exiting...\n",file);
+   exit(-1);
+   }
+}
+
+static FILE *rag_open(char *file,struct rag_header *ah)
+{
+FILE *fpr;
+
+fpr = fopfile(file,"r");
+
+if(fread(ah,sizeof(struct rag_header),1,fpr) != 1 ||
+   strncmp(ah->magic,RAG_MAGIC,8) != 0)
+   {
+   fprintf(stderr,"%s is not a GoF aggregate, exiting...\n",file);
+   exit(-1);
+   }
+
+if(ah->ncomp < 1 || ah->nbin < 1 || ah->nper < 0)
+   {
+   fprintf(stderr,"%s: bad aggregate header (byte order?), exiting...\n",file);
+   exit(-1);
+   }
+
+return(fpr);
+}
+
+/* the period list of an aggregate, for merge= without a residfile */
+float *rag_periods(char *file,int *nper)
+{
+FILE *fpr;
+struct rag_header ah;
+float *per;
+long off;
+
+fpr = rag_open(file,&ah);
+
+off = sizeof(ah) + (ah.nbin+1+8)*sizeof(float) + ah.ncomp*RAG_COMPCHAR;
+per = (float *) check_malloc ((ah.nper+1)*sizeof(float));
+if(fseek(fpr,off,SEEK_SET) != 0)
+   {
+   fprintf(stderr,"short read on aggregate %s, exiting...\n",file);
+   exit(-1);
+   }
+rag_fread(per,sizeof(float),ah.nper,fpr,file);
+fclose(fpr);
+
+*nper = ah.nper;
+return(per);
+}
+
+/*
+   Adds the aggregate of file to the accumulators nstat, nval, mean, m2,
+   laid out as in resid2uncer_varN, after checking that the file was made
+   with the same layout.
+*/
+
+void rag_merge(char *file,int ncomp,char (*comp)[16],int nbin,float *bins,int bvar,float *lim,int nper,float *per,int *nstat,int *nval,double *mean,double *m2)
+{
+FILE *fpr;
+struct rag_header ah;
+float fbuf[64], *fper;
+char fcomp[RAG_COMPCHAR];
+int i, ncell, same, *fnstat, *fnval;
+double *fmean, *fm2;
+
+fpr = rag_open(file,&ah);
+
+same = (ah.ncomp == ncomp && ah.nbin == nbin && ah.nper == nper && ah.bvar == bvar && nbin+1 <= 64);
+if(same)
+   {
+   rag_fread(fbuf,sizeof(float),nbin+1,fpr,file);
+   same = (memcmp(fbuf,bins,(nbin+1)*sizeof(float)) == 0);
+   }
+if(same)
+   {
+   rag_fread(fbuf,sizeof(float),8,fpr,file);
+   same = (memcmp(fbuf,lim,8*sizeof(float)) == 0);
+   }
+for(i=0;same && i<ncomp;i++)
+   {
+   rag_fread(fcomp,1,RAG_COMPCHAR,fpr,file);
+   same = (strncmp(fcomp,comp[i],RAG_COMPCHAR-1) == 0);
+   }
+if(same)
+   {
+   fper = (float *) check_malloc ((nper+1)*sizeof(float));
+   rag_fread(fper,sizeof(float),nper,fpr,file);
+   same = (memcmp(fper,per,nper*sizeof(float)) == 0);
+   free(fper);
+   }
+
+if(!same)
+   {
+   fprintf(stderr,"%s: aggregate of other comps, bins, limits or periods, exiting...\n",file);
+   exit(-1);
+   }
+
+ncell = ncomp*nbin*nper;
+fnstat = (int *) check_malloc (ncomp*nbin*sizeof(int));
+fnval = (int *) check_malloc ((ncell+1)*sizeof(int));
+fmean = (double *) check_malloc ((ncell+1)*sizeof(double));
+fm2 = (double *) check_malloc ((ncell+1)*sizeof(double));
+
+rag_fread(fnstat,sizeof(int),ncomp*nbin,fpr,file);
+rag_fread(fnval,sizeof(int),ncell,fpr,file);
+rag_fread(fmean,sizeof(double),ncell,fpr,file);
+rag_fread(fm2,sizeof(double),ncell,fpr,file);
+fclose(fpr);
+
+for(i=0;i<ncomp*nbin;i++)
+   nstat[i] = nstat[i] + fnstat[i];
+for(i=0;i<ncell;i++)
+   welford_merge(&nval[i],&mean[i],&m2[i],fnval[i],fmean[i],fm2[i]);
+
+free(fnstat);
+free(fnval);
+free(fmean);
+free(fm2);
+}
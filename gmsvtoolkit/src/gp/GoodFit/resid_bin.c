@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "structure.h"
+#include "function.h"
+
+/*
+   Columnar binary residual table.  Same content as the gen_resid_tbl text
+   table, but each metadata field and each period is a contiguous column
+   so readers can seek straight to the columns they need.  Metadata is
+   kept as the text strings (NUL padded to RTB_MWIDTH) so nothing is lost
+   converting between the two forms.
+*/
+
+static char *rtb_names[RTB_NMETA] = { "EQ", "Mag", "stat", "lon", "lat",
+                                      "stat_seq_no", "Vs30", "close_dist",
+                                      "Xcos", "Ycos", "T_min", "T_max",
+                                      "comp" };
+
+int rtb_meta_index(char *name)
+{
+int k;
+
+for(k=0;k<RTB_NMETA;k++)
+   {
+   if(strcmp(name,rtb_names[k]) == 0)
+      return(k);
+   }
+
+fprintf(stderr,"unknown residual table column %s, exiting...\n",name);
+exit(-1);
+}
+
+/*
+   meta is row-major [nrow][RTB_NMETA][RTB_MWIDTH], res is row-major
+   [nrow][nper]; both are written out transposed to columns.
+*/
+
+void rtb_write(char *file,int nrow,int nper,float *per,char *meta,float *res)
+{
+FILE *fpw;
+struct rtb_header rh;
+float *col;
+int i, j, k;
+
+memset(&rh,0,sizeof(rh));
+memcpy(rh.magic,RTB_MAGIC,8);
+rh.nrow = nrow;
+rh.nper = nper;
+rh.nmeta = RTB_NMETA;
+rh.mwidth = RTB_MWIDTH;
+
+fpw = fopfile(file,"w");
+
+fwrite(&rh,sizeof(rh),1,fpw);
+fwrite(per,sizeof(float),nper,fpw);
+
+for(k=0;k<RTB_NMETA;k++)
+   {
+   for(i=0;i<nrow;i++)
+      fwrite(meta + (i*RTB_NMETA + k)*RTB_MWIDTH,1,RTB_MWIDTH,fpw);
+   }
+
+col = (float *) check_malloc (nrow*sizeof(float));
+for(j=0;j<nper;j++)
+   {
+   for(i=0;i<nrow;i++)
+      col[i] = res[i*nper + j];
+   fwrite(col,sizeof(float),nrow,fpw);
+   }
+free(col);
+
+if(fclose(fpw) != 0)
+   {
+   fprintf(stderr,"write error on %s, exiting...\n",file);
+   exit(-1);
+   }
+}
+
+/*
+   Returns NULL (file closed) when file is not a binary residual table,
+   so callers can fall back to the text reader.
+*/
+
+FILE *rtb_open(char *file,struct rtb_header *rh)
+{
+FILE *fpr;
+
+fpr = fopfile(file,"r");
+
+if(fread(rh,sizeof(struct rtb_header),1,fpr) != 1 ||
+   strncmp(rh->magic,RTB_MAGIC,8) != 0)
+   {
+   fclose(fpr);
+   return(NULL);
+   }
+
+if(rh->nmeta != RTB_NMETA || rh->mwidth != RTB_MWIDTH || rh->nrow < 0 || rh->nper < 0)
+   {
+   fprintf(stderr,"%s: bad residual table header (byte order?), exiting...\n",file);
+   exit(-1);
+   }
+
+return(fpr);
+}
+
+static void rtb_seek_read(FILE *fpr,long off,void *buf,int size,int n)
+{
+if(fseek(fpr,off,SEEK_SET) != 0 || fread(buf,size,n,fpr) != n)
+   {
+   fprintf(stderr,"short read on residual table, exiting...\n");
+   exit(-1);
+   }
+}
+
+/* buf gets nrow strings of RTB_MWIDTH chars */
+void rtb_read_meta(FILE *fpr,struct rtb_header *rh,int k,char *buf)
+{
+long off;
+
+off = sizeof(struct rtb_header) + (long)rh->nper*sizeof(float) +
+      (long)k*rh->nrow*rh->mwidth;
+rtb_seek_read(fpr,off,buf,rh->mwidth,rh->nrow);
+}
+
+/* j < 0 reads the period list, otherwise the residuals for period j */
+void rtb_read_resid(FILE *fpr,struct rtb_header *rh,int j,float *buf)
+{
+long off;
+
+if(j < 0)
+   {
+   rtb_seek_read(fpr,(long)sizeof(struct rtb_header),buf,sizeof(float),rh->nper);
+   return;
+   }
+
+off = sizeof(struct rtb_header) + (long)rh->nper*sizeof(float) +
+      (long)rh->nmeta*rh->nrow*rh->mwidth + (long)j*rh->nrow*sizeof(float);
+rtb_seek_read(fpr,off,buf,sizeof(float),rh->nrow);
+}
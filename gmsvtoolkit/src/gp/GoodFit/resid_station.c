@@ -0,0 +1,155 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "structure.h"
+#include "function.h"
+
+/*
+   Station list and per-station residuals of gen_resid_tbl_batch, also
+   used by gof_mpi.  The spectra are read with spec_read.c, the obs
+   spectra through its cache.
+*/
+
+#define SLEN RESID_SLEN
+#define RES_LINE 64
+
+int read_statlist(char *file,struct resid_stat **stp)
+{
+FILE *fpr;
+struct resid_stat *st;
+int ns, nalloc;
+char str[4*SLEN];
+
+fpr = fopfile(file,"r");
+
+ns = 0;
+nalloc = 0;
+st = NULL;
+while(fgets(str,4*SLEN,fpr) != NULL)
+   {
+   if(str[0] == '#' || strspn(str," \t\r\n") == strlen(str))
+      continue;
+
+   if(ns == nalloc)
+      {
+      nalloc = nalloc ? 2*nalloc : 256;
+      st = (struct resid_stat *)check_realloc(st,nalloc*sizeof(struct resid_stat));
+      }
+
+   if(sscanf(str,"%63s %31s %31s %31s %31s %f %f %1023s %1023s",
+              st[ns].stat,st[ns].lon,st[ns].lat,st[ns].vs30,st[ns].cd,
+              &st[ns].flo,&st[ns].fhi,st[ns].obsfile,st[ns].simfile) != 9)
+      {
+      fprintf(stderr,"Bad line in statlist= %s:\n%s",file,str);
+      fprintf(stderr,"expecting: stat lon lat vs30 cd flo fhi obsfile simfile\n");
+      exit(-1);
+      }
+
+   st[ns].np = 0;
+   st[ns].per = NULL;
+   st[ns].buf = NULL;
+   ns++;
+   }
+fclose(fpr);
+
+*stp = st;
+return(ns);
+}
+
+/*
+   Residuals log(obs/sim) of one component on the table periods tper,
+   obs (sa on dper) and sim (on sper) interpolated to tper.  Targets
+   outside an interpolated obs grid get -99 like a zero sim value.
+*/
+
+void resid_spectrum(float *dper,float *sa,int ndo,float *sper,float *sim,int nds,float *tper,int np,float *res)
+{
+struct pinterp *pio, *pis;
+float *obs, *syn;
+int i;
+
+pio = pinterp_get(dper,ndo,tper,np);
+pis = pinterp_get(sper,nds,tper,np);
+obs = (float *)check_malloc(2*np*sizeof(float));
+syn = obs + np;
+
+pinterp_apply(pio,sa,obs);
+pinterp_apply(pis,sim,syn);
+for(i=0;i<np;i++)
+   {
+   if(syn[i] != 0.0 && (pio->ident || obs[i] > 0.0))
+      res[i] = log(obs[i]/syn[i]);
+   else
+      res[i] = -99;
+   }
+
+free(obs);
+}
+
+/*
+   Residuals log(obs/sim) for one station on the table periods tper,
+   formatted as the three comp rows of gen_resid_tbl_3comp.  The obs
+   spectra stay in the spec_cache() of the run.  sp->res and sp->per
+   keep the values as read back from the %.5e text, so the binary
+   table and gof_mpi summarize the same numbers as the text table.
+*/
+
+char *format_station(struct resid_stat *sp,float *tper,int np,char *eq,char *mag,char *comp1,char *comp2,char *comp3)
+{
+float *dper, *sa[3], *sper, *sim[3], *res;
+char statinfo[512], *buf, *bp, *vp, pstr[32];
+char *comp[3];
+int i, k, ndo, nds;
+
+comp[0] = comp1;
+comp[1] = comp2;
+comp[2] = comp3;
+
+dper = spec_cache(sp->obsfile,SPEC_BBP,0,3,&ndo,sa);
+nds = spec_read(sp->simfile,SPEC_BBP,0,3,0,&sper,sim);
+
+if(sp->fhi > 0.0)
+   sprintf(sp->tmin,"%.3f",1.0/sp->fhi);
+else
+   sprintf(sp->tmin,"-99999.999");
+
+if(sp->flo > 0.0)
+   sprintf(sp->tmax,"%.3f",1.0/sp->flo);
+else
+   sprintf(sp->tmax,"99999.999");
+
+sprintf(statinfo,"%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s",eq,mag,sp->stat,sp->lon,sp->lat,"-999",sp->vs30,sp->cd,"-999","-999",sp->tmin,sp->tmax);
+
+res = (float *)check_malloc(3*np*sizeof(float));
+buf = (char *)check_malloc(3*(strlen(statinfo) + 256 + RES_LINE*np));
+bp = buf;
+for(k=0;k<3;k++)
+   {
+   resid_spectrum(dper,sa[k],ndo,sper,sim[k],nds,tper,np,res+k*np);
+
+   bp += sprintf(bp,"%s\t%s",statinfo,comp[k]);
+   for(i=0;i<np;i++)
+      {
+      vp = bp + 1;
+      bp += sprintf(bp,"\t%.5e",res[k*np+i]);
+      res[k*np+i] = strtof(vp,NULL);
+      }
+   bp += sprintf(bp,"\n");
+   }
+sp->res = res;
+
+sp->np = np;
+sp->per = (float *)check_malloc(np*sizeof(float));
+for(i=0;i<np;i++)
+   {
+   sprintf(pstr,"%.5e",tper[i]);
+   sp->per[i] = strtof(pstr,NULL);
+   }
+free(sper);
+for(k=0;k<3;k++)
+   free(sim[k]);
+
+return(buf);
+}
@@ -0,0 +1,184 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "structure.h"
+#include "function.h"
+
+/*
+   Per-period residual statistics shared by resid2uncer_varN and
+   gof_mpi: the one-pass accumulators, their merge, the row to
+   accumulator mapping and the bias/sigma output files.
+*/
+
+static float t95[] = {  6.3138, 2.9200, 2.3534, 2.1318, 2.0150, 1.9432, 1.8946,
+                        1.8595, 1.8331, 1.8125, 1.7959, 1.7823, 1.7709, 1.7613,
+                        1.7531, 1.7459, 1.7396, 1.7341, 1.7291, 1.7247, 1.7207,
+                        1.7171, 1.7139, 1.7109, 1.7081, 1.7056, 1.7033, 1.7011,
+                        1.6991, 1.6973, 1.6955, 1.6939, 1.6924, 1.6909, 1.6896,
+                        1.6883, 1.6871, 1.6860, 1.6849, 1.6839, 1.6829, 1.6820,
+                        1.6811, 1.6802, 1.6794, 1.6787, 1.6779, 1.6772, 1.6766,
+                        1.6759, 1.6753, 1.6747, 1.6741, 1.6736, 1.6730 };
+
+/*
+
+One-pass (Welford) update of one period's accumulator:
+
+n = n + 1
+d = r - B
+B = B + d/n
+M2 = M2 + d*(r - B)
+
+so that afterwards B = (1/n)*SUM(r[i]) and M2 = SUM(r[i] - B)**2
+without keeping the residuals or cancelling SUM(r*r) - n*B*B.
+
+*/
+
+void welford(float r,int *nv,double *b,double *m2)
+{
+double d;
+
+*nv = *nv + 1;
+d = r - *b;
+*b = *b + d/(*nv);
+*m2 = *m2 + d*(r - *b);
+}
+
+/*
+
+Merge of two accumulators (Chan et al.), as if the residuals of b had
+been added to a one at a time (b is copied when a is empty):
+
+n = na + nb
+d = Bb - Ba
+B = Ba + d*nb/n
+M2 = M2a + M2b + d*d*na*nb/n
+
+*/
+
+void welford_merge(int *na,double *ba,double *m2a,int nb,double bb,double m2b)
+{
+double d;
+int n;
+
+if(nb == 0)
+   return;
+
+if(*na == 0)
+   {
+   *na = nb;
+   *ba = bb;
+   *m2a = m2b;
+   return;
+   }
+
+n = *na + nb;
+d = bb - *ba;
+*ba = *ba + d*nb/n;
+*m2a = *m2a + m2b + d*d*((double)(*na))*nb/n;
+*na = n;
+}
+
+/*
+   Accumulator slot (comp*nbin + bin) for a table row, or -1 when the row
+   is outside the limits, the components or the bins of v[bvar].
+   v[] = vs30, cdst, xcos, ycos (tmin, tmax unused here).
+*/
+
+int row_slot(float *v,char *rdcomp,int ncomp,char (*comp)[16],int bvar,int nbin,float *bins,float *lim)
+{
+int ic, ib;
+
+for(ib=0;ib<4;ib++)
+   {
+   if(!(v[ib] >= lim[2*ib] && v[ib] <= lim[2*ib+1]))
+      return(-1);
+   }
+
+for(ic=0;ic<ncomp;ic++)
+   {
+   if(strcmp(rdcomp,comp[ic]) == 0)
+      break;
+   }
+if(ic == ncomp)
+   return(-1);
+
+/* bins are [lo,hi), the last one [lo,hi] */
+for(ib=0;ib<nbin;ib++)
+   {
+   if(v[bvar] >= bins[ib] && (v[bvar] < bins[ib+1] ||
+                             (ib == nbin-1 && v[bvar] == bins[ib+1])))
+      return(ic*nbin + ib);
+   }
+
+return(-1);
+}
+
+/*
+
+Bias is given by:
+B = (1/n)*SUM(r[i])
+
+Sigma is given by:
+sigma = sqrt { 1/(n-1) SUM(r[i] - B)**2 } = sqrt { M2/(n-1) }
+
+Sigma0 (not corrected for bias) is given by:
+sigma0 = sqrt { 1/n SUM(r[i]*r[i]) } = sqrt { M2/n + B*B }
+
+*/
+
+void uncert_write(char *root,int np,float *per,int *nv,double *mean,double *m2)
+{
+FILE *fpw[5], *fopfile();
+char string[1024];
+float b, sig, sig0, m90, p90, ttfac;
+char *ext[5];
+int j, k;
+
+ext[0] = "bias";
+ext[1] = "sigma";
+ext[2] = "sigma0";
+ext[3] = "m90";
+ext[4] = "p90";
+
+for(k=0;k<5;k++)
+   {
+   sprintf(string,"%s.%s",root,ext[k]);
+   fpw[k] = fopfile(string,"w");
+   }
+
+for(j=0;j<np;j++)
+   {
+   if(nv[j] > 1)
+      {
+      if(nv[j] > 56)
+         ttfac = 1.64*sqrt(1.0/nv[j]);
+      else
+         ttfac = t95[nv[j]-2]*sqrt(1.0/nv[j]);
+
+      b = mean[j];
+      sig = sqrt(m2[j]/(nv[j]-1));  /* corrected for bias */
+      sig0 = sqrt(m2[j]/nv[j] + mean[j]*mean[j]);
+      m90 = b - sig*ttfac;
+      p90 = b + sig*ttfac;
+      }
+   else
+      {
+      b = 0.0;
+      sig = 0.0;
+      sig0 = 0.0;
+      m90 = 0.0;
+      p90 = 0.0;
+      }
+
+   fprintf(fpw[0],"%13.5e %13.5e\n",per[j],b);
+   fprintf(fpw[1],"%13.5e %13.5e\n",per[j],sig);
+   fprintf(fpw[2],"%13.5e %13.5e\n",per[j],sig0);
+   fprintf(fpw[3],"%13.5e %13.5e\n",per[j],m90);
+   fprintf(fpw[4],"%13.5e %13.5e\n",per[j],p90);
+   }
+
+for(k=0;k<5;k++)
+   fclose(fpw[k]);
+}
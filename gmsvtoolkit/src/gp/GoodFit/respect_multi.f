@@ -0,0 +1,309 @@
+c                              respect_multi.f - revision 1.0
+c*******************************************************************************
+c
+c     Batch version of respect: computes the response spectra of many
+c     accelerograms in one run and writes, for each of them, the same
+c     output file as respect/pseudo.  The files are shared out over
+c     OpenMP threads and the arrays are sized to each record, so there
+c     is no limit on the number of points.  The oscillators are the
+c     cmpmax/ucmpmx routines of pseudo.f, so the spectra are the same
+c     as those of respect.
+c
+c     The titles are always taken from the data file header, as when
+c     respect is answered "y" to both title questions, and all the
+c     points of each record are used.
+c
+c     The control input is read from standard input, one item per line:
+c
+c         format        "binary", "mclaren" or a fortran format
+c                       (blank = (8f9.6))
+c         ntypper       2 = wcc-pasadena standard periods
+c                       3 = user periods, 4 = user frequencies
+c         nper          (ntypper 3 or 4 only)
+c         periods       (ntypper 3 or 4 only, nper values)
+c         units         1 = cm/sec/sec, 2 = g's
+c         nhead         header cards to skip after the first two
+c         ndamp         number of dampings
+c         dampings      (ndamp values)
+c         anorm         normalization factor (0. is converted to 1.)
+c         nthreads      number of threads (0 = all available)
+c         nfile         number of records
+c
+c     followed by three lines per record:
+c
+c         component name
+c         input data file name
+c         response spectral output file name
+c
+c*******************************************************************************
+c
+c     * * * *    limitations    * * * *
+c
+c     1.  the number of periods must be <= 151
+c     2.  the number of dampings must be <= 50
+c
+c*******************************************************************************
+
+      program respect_multi
+
+      character*15  fmt
+      character*1   unit
+      integer       nhead,ndamp,nper,ntypper,nthreads,nfile
+      real          period(151),damp(50),anorm
+      character*12,  allocatable :: cname(:)
+      character*256, allocatable :: filin(:),filout(:)
+      integer,       allocatable :: icode(:)
+      integer       nans,nerr
+      real          resnew(112)
+!$    integer       omp_get_max_threads
+
+c...the wcc-pasadena standard periods (same as pseudo)
+
+      data (resnew(m), m=1,112) /
+     *     0.010, 0.011, 0.012, 0.013, 0.014, 0.015, 0.016, 0.017,
+     *     0.018, 0.019, 0.020, 0.022, 0.024, 0.026, 0.028, 0.030,
+     *     0.032, 0.034, 0.036, 0.038,
+     *     0.040, 0.042, 0.044, 0.046, 0.048, 0.050, 0.055, 0.060,
+     *     0.065, 0.070, 0.075, 0.080, 0.085, 0.090, 0.095, 0.100,
+     *     0.110, 0.120, 0.130, 0.140, 0.150, 0.160, 0.170, 0.180,
+     *     0.190, 0.200, 0.220, 0.240, 0.260, 0.280, 0.300, 0.320,
+     *     0.340, 0.360, 0.380, 0.400, 0.420, 0.440, 0.460, 0.480,
+     *     0.500, 0.550, 0.600, 0.650, 0.700, 0.750, 0.800, 0.850,
+     *     0.900, 0.950, 1.000, 1.100, 1.200, 1.300, 1.400, 1.500,
+     *     1.600, 1.700, 1.800, 1.900, 2.000, 2.200, 2.400, 2.600,
+     *     2.800, 3.000, 3.200, 3.400, 3.600, 3.800, 4.000, 4.200,
+     *     4.400, 4.600, 4.800, 5.000, 5.500, 6.000, 6.500, 7.000,
+     *     7.500, 8.000, 8.500, 9.000, 9.500, 10.00, 11.00, 12.00,
+     *     13.00, 14.00, 15.00, 20.00 /
+
+c --- read the options shared by all records
+
+      read (5,815) fmt
+815   format (a15)
+      if (fmt .eq. '               ') fmt = '(8f9.6)        '
+
+      read (5,*) ntypper
+      if (ntypper.lt.2 .or. ntypper.gt.4) stop 'Number of periods entered is invalid.'
+      if (ntypper.eq.2) then
+         nper = 112
+         do i=1,nper
+            period(i) = resnew(i)
+         enddo
+      else
+         read (5,*) nper
+         if (nper.lt.1 .or. nper.gt.151) stop 'Number of periods entered is invalid.'
+         read (5,*) (period(i),i=1,nper)
+         if (ntypper.eq.4) then
+            do i=1,nper
+               period(i) = 1/period(i)
+            enddo
+         end if
+      end if
+
+      read (5,*) nans
+      if (nans.eq.2) then
+         unit = 'g'
+      else
+         unit = 'c'
+      end if
+
+      read (5,*) nhead
+      read (5,*) ndamp
+      if (ndamp.lt.1 .or. ndamp.gt.50) stop 'Number of dampings entered is invalid.'
+      read (5,*) (damp(i),i=1,ndamp)
+      read (5,*) anorm
+      if (anorm .eq. 0.0) anorm = 1.0
+      read (5,*) nthreads
+!$    if (nthreads .le. 0) nthreads = omp_get_max_threads()
+      if (nthreads .le. 0) nthreads = 1
+
+c --- read the list of records
+
+      read (5,*) nfile
+      allocate ( cname(nfile), filin(nfile), filout(nfile), icode(nfile) )
+      do i=1,nfile
+         read (5,810) cname(i)
+         read (5,820) filin(i)
+         read (5,820) filout(i)
+      enddo
+810   format (a12)
+820   format (a256)
+
+c --- compute the spectra, one record per thread at a time
+
+!$omp parallel do num_threads(nthreads) schedule(dynamic,1)
+      do i=1,nfile
+         call rspfile (cname(i),filin(i),filout(i),fmt,unit,nhead,
+     &      anorm,nper,period,ndamp,damp,icode(i))
+      enddo
+!$omp end parallel do
+
+      nerr = 0
+      do i=1,nfile
+         if (icode(i).ne.0) then
+            nerr = nerr + 1
+            write (6,'(a,a)') '***** ERROR IN SPECTACULAR (PSEUDO) FOR ',trim(filin(i))
+         end if
+      enddo
+      if (nerr.ne.0) stop '***** EXECUTION TERMINATED *****'
+
+      stop
+      end
+
+c*******************************************************************************
+c
+c     subroutine rspfile: reads one accelerogram and writes its response
+c     spectra for all the dampings, as pseudo does for one component.
+c     Only local storage is used, so several records can be processed
+c     at the same time.  icode is set to 1 if the input file can not
+c     be read.
+
+      subroutine rspfile (cname,filin,filout,fmt,unit,nhead,anorm,
+     &   nper,period,ndamp,damp,icode)
+
+      character*12  cname
+      character*256 filin,filout
+      character*15  fmt
+      character*1   unit
+      integer       nhead,nper,ndamp,icode
+      real          period(nper),damp(ndamp),anorm
+
+      character*3   ccomp
+      character*10  stanam
+      character*65  title1,title2
+      character*80  dummy,head1,head2
+      real*8        conv
+      logical       untflg,bin,mcl,exlog
+      integer       iu,kg,keqdt,kug
+      real          dt,z(3),amaxg,q,anc
+      real          rd(151),rv(151),prv(151),aa(151),paa(151),b(151)
+      real, allocatable :: a(:),time(:)
+      parameter (conv=0.001019368)
+
+      icode = 0
+      untflg = .false.
+      if (unit.eq.' ' .or. unit.eq.'G' .or. unit.eq.'g') untflg=.true.
+      bin = fmt.eq.'binary         '
+      mcl = fmt.eq.'mclaren        '
+
+      inquire (file=filin,exist=exlog)
+      if (.not.exlog) then
+         icode = 1
+         return
+      end if
+      if (bin .or. mcl) then
+         open (newunit=iu,file=filin,form='unformatted',status='old',err=900)
+      else
+         open (newunit=iu,file=filin,status='old',err=900)
+      end if
+
+c --- header: title line, then the number of points and delta t
+
+      if (bin) then
+         read (iu,err=910,end=910) stanam,ccomp,title1
+         read (iu,err=910,end=910) kg,dt
+      else if (mcl) then
+         read (iu,err=910,end=910) head1,head2
+         read (head1,14) stanam,title1
+         read (head2,'(i10,f10.7)') kg,dt
+      else
+         read (iu,14,err=910,end=910) stanam,title1
+         read (iu,*,err=910,end=910) kg,dt
+      end if
+14    format (a10,5x,a65)
+      title2 = stanam //
+     &   '                                                       '
+      if (kg.lt.2) goto 910
+
+      keqdt=1
+      if (dt .le. 0.0) keqdt=0
+      do i=1,nhead
+         if (.not.(bin .or. mcl)) then
+            read (iu,'(a80)',err=910,end=910) dummy
+         else
+            if (bin) read (iu,err=910,end=910) dummy
+         end if
+      enddo
+
+c --- the data
+
+      allocate ( a(kg), time(kg) )
+      if (keqdt .eq. 1) then
+         if (bin .or. mcl) then
+            read (iu,err=920,end=920) (a(l),l=1,kg)
+         else
+            read (iu,fmt,err=920,end=920) (a(l),l=1,kg)
+         end if
+         do i=1,kg
+            time(i) = float(i-1)*dt
+         enddo
+      else
+         read (iu,fmt,err=920,end=920) (time(l),a(l),l=1,kg)
+      end if
+      close (iu)
+
+c...peak acceleration in g's of the first kg-1 values, as pseudo does
+
+      if (untflg) then
+         anc = anorm
+      else
+         anc = anorm*conv
+      end if
+      amaxg = 0.0
+      do k=1,kg-1
+         q = anc * abs(a(k))
+         if (q .ge. amaxg) amaxg = q
+      enddo
+
+c... convert acc's to cm/sec**2, and normalize
+
+      do i=1,kg
+         if (untflg) then
+            a(i) = a(i) * 981.0 * anorm
+         else
+            a(i) = a(i) * anorm
+         end if
+      enddo
+
+c --- compute the response and write it for each damping
+
+      open (newunit=iu,file=filout,status='replace')
+      kug = kg - 1
+      dur1 = 0.0
+      do 800 i=1,ndamp
+         d = damp(i)
+         yy = sqrt(1.-d*d)
+         do 600 n=1,nper
+            w = 4.*asin(1.0)/period(n)
+            wd = yy*w
+            w2 = w*w
+            w3 = w2*w
+            if (keqdt.eq.0 .or. period(n).lt.10.*dt) then
+               call ucmpmx (dur1,kug,a,time,period(n),w,w2,w3,wd,d,z)
+            else
+               call cmpmax (dur1,kug,a,period(n),w,w2,w3,wd,d,dt,z)
+            end if
+            rd(n) = z(1)
+            rv(n) = z(2)
+            aa(n) = z(3)/981.0
+            prv(n)= w*z(1)
+            paa(n) = w2*z(1)/ 981.0
+            b(n) = aa(n)/amaxg
+600      continue
+
+         write (iu,301) cname,title1,title2,nper,d
+301      format(a12/a65/a65/i4,f6.3,
+     *     ' Period  Rel Disp      Rel Vel     Pseudo RV   AbsoluteAcc  Pseudo AA       Ratio' )
+         write (iu,302) (n,period(n),rd(n),rv(n),prv(n),aa(n),paa(n),
+     *     b(n), n = 1,nper )
+302      format (i3, 7e13.5)
+800   continue
+      close (iu)
+      deallocate ( a, time )
+      return
+
+920   deallocate ( a, time )
+910   close (iu)
+900   icode = 1
+      return
+      end
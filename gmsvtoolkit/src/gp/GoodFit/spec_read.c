@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "structure.h"
+#include "function.h"
+
+/*
+   Spectrum readers of the gen_resid_tbl* tools.  Each file is opened and
+   read once: the number of periods is taken from the respect header or
+   the caller's np=, else the rows go into buffers doubled as they fill,
+   so there is no line-count pass.  spec_cache() keeps the parsed obs
+   spectra of a batch run, where several simulations of a station share
+   the same obs file.
+*/
+
+#define SLEN RESID_SLEN
+#define SPEC_NALLOC 128
+#define SPEC_NHASH 4096
+
+static struct spec_entry *spec_hash[SPEC_NHASH];
+
+/*
+   Reads file (fmt one of SPEC_2COL, SPEC_RESPECT, SPEC_BBP) into *per and
+   the nc spectra sa[0..nc-1], each in its own array so pinterp_regrid()
+   can replace them.  sa_field is the respect column (6=AA, 7=pseudo AA).
+   With np > 0 exactly np rows are returned (a respect header must agree,
+   a short file repeats its last line as the old readers did), with
+   np <= 0 every row is read.  Returns the number of rows.
+*/
+
+int spec_read(char *file,int fmt,int sa_field,int nc,int np,float **per,float **sa)
+{
+FILE *fpr;
+float v[8];
+int k, n, nr, nalloc, nhead, fixed;
+char str[SLEN];
+
+fpr = fopfile(file,"r");
+
+str[0] = '\0';
+fgets(str,SLEN,fpr);
+if(fmt == SPEC_RESPECT)
+   {
+   fgets(str,SLEN,fpr);
+   fgets(str,SLEN,fpr);
+   fgets(str,SLEN,fpr);
+
+   nhead = 0;
+   sscanf(str,"%d",&nhead);
+
+   if(np > 0 && nhead != np)
+      {
+      fprintf(stderr,"No. periods not equal, exiting...\n");
+      exit(-1);
+      }
+   np = nhead;
+
+   fgets(str,SLEN,fpr);
+   }
+else if(fmt == SPEC_BBP)
+   {
+   while(strncmp(str,"#",1) == 0)
+      fgets(str,SLEN,fpr);
+   }
+
+fixed = (np > 0 || fmt == SPEC_RESPECT);
+nalloc = (np > 0) ? np : SPEC_NALLOC;
+*per = (float *) check_malloc (nalloc*sizeof(float));
+for(k=0;k<nc;k++)
+   sa[k] = (float *) check_malloc (nalloc*sizeof(float));
+
+n = 0;
+while(n < np || !fixed)
+   {
+   if(n == nalloc)
+      {
+      nalloc = 2*nalloc;
+      *per = (float *) check_realloc (*per,nalloc*sizeof(float));
+      for(k=0;k<nc;k++)
+         sa[k] = (float *) check_realloc (sa[k],nalloc*sizeof(float));
+      }
+
+   if(fmt == SPEC_RESPECT)
+      {
+      sscanf(str,"%f %f %f %f %f %f %f %f",&v[0],&v[1],&v[2],&v[3],&v[4],&v[5],&v[6],&v[7]);
+      (*per)[n] = v[1];
+      sa[0][n] = v[sa_field-1];
+      }
+   else
+      {
+      v[1] = v[2] = v[3] = 0.0;
+      nr = sscanf(str,"%f %f %f %f",&v[0],&v[1],&v[2],&v[3]);
+      if(fmt == SPEC_BBP && nr < 3)
+         {
+         fprintf(stderr,"Error in file= %s\n",file);
+         fprintf(stderr,"found %d columns, expecting at least %d, exiting...\n",nr,nc+1);
+         exit(-1);
+         }
+
+      (*per)[n] = v[0];
+      for(k=0;k<nc;k++)
+         sa[k][n] = v[k+1];
+      }
+   n++;
+
+   /* with a fixed count a failed read keeps the last line */
+   if(fgets(str,SLEN,fpr) == NULL && !fixed)
+      break;
+   }
+fclose(fpr);
+
+return(n);
+}
+
+static unsigned int spec_key(char *file,int fmt,int sa_field,int nc)
+{
+unsigned int h;
+
+h = 2166136261u;
+while(*file != '\0')
+   h = (h ^ (unsigned char)(*file++))*16777619u;
+
+h = (h ^ (unsigned int)(fmt + 4*sa_field + 64*nc))*16777619u;
+return(h % SPEC_NHASH);
+}
+
+static struct spec_entry *spec_find(unsigned int key,char *file,int fmt,int sa_field,int nc)
+{
+struct spec_entry *sp;
+
+for(sp=spec_hash[key];sp!=NULL;sp=sp->next)
+   {
+   if(sp->fmt == fmt && sp->sa_field == sa_field && sp->nc == nc &&
+      strcmp(sp->file,file) == 0)
+      return(sp);
+   }
+
+return(NULL);
+}
+
+static void spec_entry_free(struct spec_entry *sp)
+{
+int k;
+
+free(sp->per);
+for(k=0;k<sp->nc;k++)
+   free(sp->sa[k]);
+free(sp->file);
+free(sp);
+}
+
+/*
+   spec_read() of every row of an obs file, through the cache: a file
+   already parsed with the same fmt, sa_field and nc is not read again.
+   The arrays returned are shared, not to be changed or freed, until
+   spec_cache_free().  Thread safe; the file is read outside the lock,
+   so threads reading different files do not wait on each other.
+*/
+
+float *spec_cache(char *file,int fmt,int sa_field,int nc,int *np,float **sa)
+{
+struct spec_entry *sp, *hit;
+unsigned int key;
+int k;
+
+key = spec_key(file,fmt,sa_field,nc);
+
+#pragma omp critical (spec_cache)
+hit = spec_find(key,file,fmt,sa_field,nc);
+
+if(hit == NULL)
+   {
+   sp = (struct spec_entry *) check_malloc (sizeof(struct spec_entry));
+   sp->file = (char *) check_malloc (strlen(file)+1);
+   strcpy(sp->file,file);
+   sp->fmt = fmt;
+   sp->sa_field = sa_field;
+   sp->nc = nc;
+   sp->np = spec_read(file,fmt,sa_field,nc,0,&sp->per,sp->sa);
+
+#pragma omp critical (spec_cache)
+      {
+      hit = spec_find(key,file,fmt,sa_field,nc);
+      if(hit == NULL)
+         {
+         sp->next = spec_hash[key];
+         spec_hash[key] = sp;
+         hit = sp;
+         }
+      }
+
+   /* another thread got there first */
+   if(hit != sp)
+      spec_entry_free(sp);
+   }
+
+*np = hit->np;
+for(k=0;k<nc;k++)
+   sa[k] = hit->sa[k];
+
+return(hit->per);
+}
+
+void spec_cache_free()
+{
+struct spec_entry *sp, *next;
+int i;
+
+for(i=0;i<SPEC_NHASH;i++)
+   {
+   for(sp=spec_hash[i];sp!=NULL;sp=next)
+      {
+      next = sp->next;
+      spec_entry_free(sp);
+      }
+   spec_hash[i] = NULL;
+   }
+}
@@ -95,3 +95,112 @@ struct tsheader_proc  /* structure for individual processor time slice header */
    float modellat;  /* latitude of model origin                             */
    float modellon;  /* longitude of model origin                            */
    };
+
+/*
+   Columnar binary residual table (see resid_bin.c), native byte order:
+
+      struct rtb_header
+      float per[nper]
+      char meta[nmeta][nrow][mwidth]     one column per metadata field
+      float resid[nper][nrow]            one column per period
+*/
+
+#define RTB_MAGIC "GFRESID1"
+#define RTB_NMETA 13
+#define RTB_MWIDTH 32
+
+struct rtb_header
+   {
+   char magic[8];
+   int nrow;
+   int nper;
+   int nmeta;
+   int mwidth;
+   int pad[4];
+   };
+
+/*
+   Partial GoF aggregate of resid2uncer_varN (see resid_agg.c), the
+   one-pass accumulators of the residuals read so far, native byte order:
+
+      struct rag_header
+      float bins[nbin+1]
+      float lim[8]                    min/max vs30, cdst, xcos, ycos
+      char comp[ncomp][RAG_COMPCHAR]
+      float per[nper]
+      int nstat[ncomp*nbin]           stations read per comp and bin
+      int nval[ncomp*nbin*nper]       then per accumulator cell
+      double mean[ncomp*nbin*nper]    the Welford n, mean and M2
+      double m2[ncomp*nbin*nper]
+*/
+
+#define RAG_MAGIC "GFAGGR01"
+#define RAG_COMPCHAR 16
+
+struct rag_header
+   {
+   char magic[8];
+   int ncomp;
+   int nbin;
+   int nper;
+   int bvar;
+   int pad[4];
+   };
+
+/* log-log period interpolation from one period grid onto another */
+
+struct pinterp
+   {
+   int nsrc;
+   int ndst;
+   int ident;      /* grids match, values are used as they are */
+   float *src;
+   float *dst;
+   int *i0;        /* dst[j] lies in [src[i0],src[i0+1]], -1 outside src */
+   float *w;       /* log-period weight of src[i0+1] */
+   };
+
+/* one station of a gen_resid_tbl_batch / gof_mpi statlist */
+
+#define RESID_SLEN 1024
+
+struct resid_stat
+   {
+   char stat[64];
+   char lon[32];
+   char lat[32];
+   char vs30[32];
+   char cd[32];
+   float flo;
+   float fhi;
+   char tmin[16];
+   char tmax[16];
+   char obsfile[RESID_SLEN];
+   char simfile[RESID_SLEN];
+   int np;
+   float *per;
+   float *res;
+   char *buf;
+   };
+
+/* spectrum file formats of spec_read.c */
+
+#define SPEC_2COL    0   /* per sa, np rows */
+#define SPEC_RESPECT 1   /* respect output, np on header line 4 */
+#define SPEC_BBP     2   /* '#' comments, then per sa1 sa2 [sa3] */
+
+#define SPEC_MAXCOMP 3
+
+/* one parsed file of the spec_cache() obs cache */
+
+struct spec_entry
+   {
+   char *file;
+   int fmt;
+   int sa_field;
+   int nc;
+   int np;
+   float *per;
+   float *sa[SPEC_MAXCOMP];
+   struct spec_entry *next;
+   };
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <sys/file.h>
 #include <sys/procfs.h>
@@ -22,11 +23,37 @@
 #define         KM2FT           (float)(3280.84)
 #define MAX_NLEN 100
 
-main(int ac,char **av)
+#include "getpar.h"
+
+void *check_malloc(size_t);
+void set_g2(float *,float *);
+void latlon2km(float *,float *,float *,float *,float *);
+void geoutm_(double *dlon, double *dlat, double *xr0,
+	     double *yr0, int *utm_zone, int *geo2utm);
+
+/*
+   Point mode: "nort east" (km from ref_lon, ref_lat) on stdin, "lon lat"
+   on stdout.
+
+   Grid mode (nx= and ny= given): the nodes east = x0 + ix*dx and
+   nort = y0 + iy*dy (dy defaults to dx) are converted and outfile gets
+   two float32 planes of nx*ny values, x varying fastest: lon then lat,
+   or lat then lon with latfirst=1.  The projection does not depend on
+   depth, so this one table serves every depth level of a 3D mesh.
+   Without utm=1 lon depends only on ix and lat only on iy, and the
+   planes are filled from those two vectors; with utm=1 each node is
+   projected once, nthreads= OpenMP threads sharing out the y rows.
+*/
+
+int main(int ac,char **av)
 {
 FILE *fpw, *fpr, *fopfile();
 float rlon, rlat, east, nort, ref_lon, ref_lat;
 float latavg, kmlon, kmlat;
+float *plon, *plat, *vlon, *vlat;
+int ix, iy;
+size_t ip, np;
+char outfile[512];
 
 float rperd = RPERD;
 float erad = ERAD;
@@ -41,12 +68,38 @@ int utm_zone = 11;
 
 int utm = 0;
 
+int nx = 0;
+int ny = 0;
+float x0 = 0.0;
+float y0 = 0.0;
+float dx = 1.0;
+float dy = -1.0;
+int latfirst = 0;
+int nthreads = 1;
+
+outfile[0] = '\0';
+
 setpar(ac,av);
 getpar("utm","d",&utm);
 mstpar("ref_lon","f",&ref_lon);
 mstpar("ref_lat","f",&ref_lat);
+getpar("nx","d",&nx);
+getpar("ny","d",&ny);
+if(nx > 0 && ny > 0)
+   {
+   mstpar("outfile","s",outfile);
+   getpar("x0","f",&x0);
+   getpar("y0","f",&y0);
+   getpar("dx","f",&dx);
+   getpar("dy","f",&dy);
+   getpar("latfirst","d",&latfirst);
+   getpar("nthreads","d",&nthreads);
+   }
 endpar();
 
+if(dy < 0.0)
+   dy = dx;
+
 if(utm == 1)
    {
    dlon = ref_lon;
@@ -62,6 +115,78 @@ else
    latlon2km(&latavg,&kmlat,&kmlon,&radc,&g2);
    }
 
+if(nx > 0 && ny > 0)
+   {
+   np = (size_t)(nx)*(size_t)(ny);
+   plon = (float *) check_malloc (np*sizeof(float));
+   plat = (float *) check_malloc (np*sizeof(float));
+
+   if(utm == 1)
+      {
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic,1) private(ix,ip,dlon,dlat,dxr,dyr)
+      for(iy=0;iy<ny;iy++)
+         {
+         for(ix=0;ix<nx;ix++)
+            {
+            ip = ix + (size_t)(iy)*nx;
+
+            dxr = xr0 + 1000.0*(x0 + ix*dx);
+            dyr = yr0 + 1000.0*(y0 + iy*dy);
+            geoutm_(&dlon,&dlat,&dxr,&dyr,&utm_zone,&utm2geo);
+            plon[ip] = dlon;
+            plat[ip] = dlat;
+            }
+         }
+      }
+   else
+      {
+      vlon = (float *) check_malloc (nx*sizeof(float));
+      vlat = (float *) check_malloc (ny*sizeof(float));
+
+      for(ix=0;ix<nx;ix++)
+         {
+         east = x0 + ix*dx;
+         vlon[ix] = ref_lon + east/kmlon;
+         }
+      for(iy=0;iy<ny;iy++)
+         {
+         nort = y0 + iy*dy;
+         vlat[iy] = ref_lat + nort/kmlat;
+         }
+
+#pragma omp parallel for num_threads(nthreads) schedule(static) private(ix,ip)
+      for(iy=0;iy<ny;iy++)
+         {
+         ip = (size_t)(iy)*nx;
+         for(ix=0;ix<nx;ix++)
+            {
+            plon[ip+ix] = vlon[ix];
+            plat[ip+ix] = vlat[iy];
+            }
+         }
+
+      free(vlon);
+      free(vlat);
+      }
+
+   fpw = fopfile(outfile,"w");
+   if(latfirst)
+      {
+      fwrite(plat,sizeof(float),np,fpw);
+      fwrite(plon,sizeof(float),np,fpw);
+      }
+   else
+      {
+      fwrite(plon,sizeof(float),np,fpw);
+      fwrite(plat,sizeof(float),np,fpw);
+      }
+   fclose(fpw);
+
+   free(plon);
+   free(plat);
+   exit(0);
+   }
+
 while(scanf("%f %f",&nort,&east) == 2)
    {
    if(utm == 1)
@@ -102,7 +227,7 @@ r = atan((1.0 - (1.0/FLAT_CONST))*tan(x));
 return(r);
 }
 
-set_g2(g2,fc)
+void set_g2(g2,fc)
 float *g2, *fc;
 {
 float f;
@@ -111,7 +236,7 @@ f = (1.0)/(*fc);
 *g2 = ((2.0)*f - f*f)/(((1.0) - f)*((1.0) - f));
 }
 
-latlon2km(arg,latkm,lonkm,rc,g2)
+void latlon2km(arg,latkm,lonkm,rc,g2)
 float *arg, *latkm, *lonkm, *rc, *g2;
 {
 float cosA, sinA, g2s2, den;
@@ -0,0 +1,176 @@
+#include "include.h"
+#include "function.h"
+#include "faultdist.h"
+#include "getpar.h"
+
+/*
+   Rrup, Rjb and Rx (km) from each station of statfile (lines of
+   lon lat name) to a fault, written to outfile as
+
+      rrup rjb rx name
+
+   The fault is either rectfile, lines of the FDIST_NPAR values of a
+   rectangle (see faultdist.h)
+
+      lon lat dep strike dip len wid [seg]
+
+   lon, lat, dep being its center, or one plane given as in an SRC file
+   by the center of its top edge lon= lat=, dtop=, len=, wid=, strike=
+   and dip=.  The stations are shared out over nthreads= OpenMP threads
+   (0 = all).
+*/
+
+#define LINELEN 1024
+
+char *check_malloc(int);
+FILE *fopfile(char *,char *);
+
+int main(int ac,char **av)
+{
+FILE *fpr, *fpw;
+struct fdist *fd;
+float *rect, *slon, *slat, *rrup, *rjb, *rx;
+float lon, lat, dtop, len, wid, strike, dip;
+int i, n, ns, nrect, nalloc;
+char (*sname)[64];
+char statfile[512], outfile[512], rectfile[512], str[LINELEN];
+
+int nthreads = 0;
+
+rectfile[0] = '\0';
+dtop = 0.0;
+strike = 0.0;
+dip = 90.0;
+
+setpar(ac,av);
+mstpar("statfile","s",statfile);
+mstpar("outfile","s",outfile);
+getpar("rectfile","s",rectfile);
+if(rectfile[0] == '\0')
+   {
+   mstpar("lon","f",&lon);
+   mstpar("lat","f",&lat);
+   mstpar("len","f",&len);
+   mstpar("wid","f",&wid);
+   getpar("dtop","f",&dtop);
+   getpar("strike","f",&strike);
+   getpar("dip","f",&dip);
+   }
+getpar("nthreads","d",&nthreads);
+endpar();
+
+if(rectfile[0] == '\0')
+   {
+   nrect = 1;
+   rect = (float *) check_malloc(FDIST_NPAR*sizeof(float));
+   fdist_plane(lon,lat,dtop,len,wid,strike,dip,rect);
+   }
+else
+   {
+   rect = NULL;
+   nrect = 0;
+   nalloc = 0;
+
+   fpr = fopfile(rectfile,"r");
+   while(fgets(str,LINELEN,fpr) != NULL)
+      {
+      if(nrect == nalloc)
+         {
+         nalloc = nalloc + 4096;
+         rect = (float *) realloc(rect,FDIST_NPAR*nalloc*sizeof(float));
+         if(rect == NULL)
+            {
+            fprintf(stderr,"*****  memory allocation error\n");
+            exit(-1);
+            }
+         }
+
+      rect[FDIST_NPAR*nrect+7] = 0.0;
+      n = sscanf(str,"%f %f %f %f %f %f %f %f",&rect[FDIST_NPAR*nrect],
+                     &rect[FDIST_NPAR*nrect+1],&rect[FDIST_NPAR*nrect+2],
+                     &rect[FDIST_NPAR*nrect+3],&rect[FDIST_NPAR*nrect+4],
+                     &rect[FDIST_NPAR*nrect+5],&rect[FDIST_NPAR*nrect+6],
+                     &rect[FDIST_NPAR*nrect+7]);
+      if(n < 7 || str[0] == '#')
+         continue;
+      nrect++;
+      }
+   fclose(fpr);
+   }
+
+if((fd = fdist_build(rect,nrect)) == NULL)
+   {
+   fprintf(stderr,"*** no fault rectangles (or no memory) from %s, exiting...\n",
+                             rectfile[0] != '\0' ? rectfile : "the plane parameters");
+   exit(-1);
+   }
+
+slon = NULL;
+slat = NULL;
+sname = NULL;
+ns = 0;
+nalloc = 0;
+
+fpr = fopfile(statfile,"r");
+while(fgets(str,LINELEN,fpr) != NULL)
+   {
+   if(ns == nalloc)
+      {
+      nalloc = nalloc + 4096;
+      slon = (float *) realloc(slon,nalloc*sizeof(float));
+      slat = (float *) realloc(slat,nalloc*sizeof(float));
+      sname = realloc(sname,nalloc*64);
+      if(slon == NULL || slat == NULL || sname == NULL)
+         {
+         fprintf(stderr,"*****  memory allocation error\n");
+         exit(-1);
+         }
+      }
+
+   if(sscanf(str,"%f %f %63s",&slon[ns],&slat[ns],sname[ns]) < 3 || str[0] == '#')
+      continue;
+   ns++;
+   }
+fclose(fpr);
+
+rrup = (float *) check_malloc((ns+1)*sizeof(float));
+rjb = (float *) check_malloc((ns+1)*sizeof(float));
+rx = (float *) check_malloc((ns+1)*sizeof(float));
+
+fdist_batch(fd,slon,slat,ns,rrup,rjb,rx,nthreads);
+
+fpw = fopfile(outfile,"w");
+for(i=0;i<ns;i++)
+   fprintf(fpw,"%13.5e %13.5e %13.5e %s\n",rrup[i],rjb[i],rx[i],sname[i]);
+fclose(fpw);
+
+fdist_free(fd);
+exit(0);
+}
+
+FILE *fopfile(char *name,char *mode)
+{
+FILE *fp;
+
+if((fp = fopen(name,mode)) == NULL)
+   {
+   fprintf(stderr,"CAN'T FOPEN FILE = %s, MODE = %s\n", name, mode);
+   exit(-1);
+   }
+return(fp);
+}
+
+char *check_malloc(int len)
+{
+char *ptr;
+
+ptr = (char *) malloc (len);
+
+if(ptr == NULL)
+   {
+   fprintf(stderr,"*****  memory allocation error\n");
+   exit(-1);
+   }
+
+return(ptr);
+}
@@ -0,0 +1,40 @@
+/*
+   faultdist.h - Rrup, Rjb and Rx from stations to a fault made of
+   rectangles, see faultdist_subs.c.
+
+   A rectangle is FDIST_NPAR floats: lon, lat and depth (km) of its
+   center, strike and dip (degrees), length along strike and width
+   down dip (km) and the segment it belongs to.
+*/
+
+#define         FDIST_NPAR      8
+
+struct fdist_rect
+   {
+   float c[3];          /* center, km: x east, y north, z down */
+   float us[3];         /* unit vector along strike */
+   float ud[3];         /* unit vector down dip */
+   float uh[2];         /* horizontal unit vector in the dip direction */
+   float hl, hw;        /* half length and half width */
+   float hwh;           /* half width of the surface projection */
+   int seg;
+   };
+
+struct fdist
+   {
+   int nrect;
+   struct fdist_rect *rc;
+   int *perm;           /* the rectangles in tree order */
+   unsigned char *axis; /* split axis of each node */
+   float *box;          /* 6 per node: min x,y,z then max x,y,z */
+   int nseg;
+   float *top;          /* 4 per segment: x, y on the top edge, uh */
+   float mlon, mlat;
+   float kperd_e, kperd_n;
+   };
+
+struct fdist *fdist_build(float *,int);
+void fdist_station(struct fdist *,float,float,float *,float *,float *);
+void fdist_batch(struct fdist *,float *,float *,int,float *,float *,float *,int);
+void fdist_free(struct fdist *);
+void fdist_plane(float,float,float,float,float,float,float,float *);
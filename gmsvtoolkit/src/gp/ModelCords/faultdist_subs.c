@@ -0,0 +1,443 @@
+#include "include.h"
+#include "function.h"
+#include "faultdist.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define         RPERD           0.017453292
+#define         FLAT_CONST      298.256
+#define         ERAD            6378.139
+
+/*
+   Rrup, Rjb and Rx of stations to a fault made of rectangles (the
+   subfaults of an SRF, or one rectangle per plane).
+
+   The rectangles are projected to km with the local scale of
+   fault_seg2lonlat.c (latlon2km() at the geocentric mean latitude of
+   the centers), x east, y north and z down, and put in a bounding
+   volume hierarchy: an implicit tree as the k-d tree of fd2close-dist,
+   the node of the range [lo,hi) of perm being its median
+   mid = (lo+hi)/2, the range split on the axis of largest spread of
+   the centers.  box[6*mid]
+   holds the bounds of all the rectangles of the range, so a station
+   visits about log(nrect) rectangles instead of all of them.
+
+      Rrup  closest distance to the rectangles
+      Rjb   closest horizontal distance to their surface projections
+      Rx    horizontal distance to the top edge of the segment of the
+            rectangle closest in Rjb, perpendicular to its strike and
+            positive on the hanging wall side (the top edge extended
+            along strike, as for the NGA models)
+
+   The stations are at the surface.
+*/
+
+/* geocentric latitude, as geocen() but without its printout */
+static float fdist_geocen(double x)
+{
+return(atan((1.0 - (1.0/FLAT_CONST))*tan(x)));
+}
+
+struct fdist_key
+   {
+   float v;
+   int ir;
+   };
+
+static int fdist_cmp(const void *a,const void *b)
+{
+const struct fdist_key *ka = (const struct fdist_key *) a;
+const struct fdist_key *kb = (const struct fdist_key *) b;
+
+if(ka->v < kb->v)
+   return(-1);
+if(ka->v > kb->v)
+   return(1);
+return(ka->ir - kb->ir);
+}
+
+/* the tree of fd, see the top of the file; -1 if out of memory */
+static int fdist_tree(struct fdist *fd)
+{
+struct fdist_rect *r;
+struct fdist_key *key;
+int *stk, nstk, lo, hi, mid, j, k, ax;
+float cmin[3], cmax[3], ext;
+
+key = (struct fdist_key *) malloc((fd->nrect+1)*sizeof(struct fdist_key));
+stk = (int *) malloc(2*(fd->nrect+1)*sizeof(int));
+if(key == NULL || stk == NULL)
+   {
+   free(key);
+   free(stk);
+   return(-1);
+   }
+
+for(j=0;j<fd->nrect;j++)
+   fd->perm[j] = j;
+
+nstk = 0;
+stk[nstk++] = 0;
+stk[nstk++] = fd->nrect;
+while(nstk > 0)
+   {
+   hi = stk[--nstk];
+   lo = stk[--nstk];
+   if(hi - lo < 1)
+      continue;
+
+   cmin[0] = cmin[1] = cmin[2] = 1.0e+20;
+   cmax[0] = cmax[1] = cmax[2] = -1.0e+20;
+   for(j=lo;j<hi;j++)
+      {
+      r = &fd->rc[fd->perm[j]];
+      for(k=0;k<3;k++)
+         {
+         if(r->c[k] < cmin[k])
+            cmin[k] = r->c[k];
+         if(r->c[k] > cmax[k])
+            cmax[k] = r->c[k];
+         }
+      }
+   ax = 0;
+   if(cmax[1]-cmin[1] > cmax[ax]-cmin[ax])
+      ax = 1;
+   if(cmax[2]-cmin[2] > cmax[ax]-cmin[ax])
+      ax = 2;
+
+   for(j=lo;j<hi;j++)
+      {
+      key[j-lo].v = fd->rc[fd->perm[j]].c[ax];
+      key[j-lo].ir = fd->perm[j];
+      }
+   qsort(key,hi-lo,sizeof(struct fdist_key),fdist_cmp);
+   for(j=lo;j<hi;j++)
+      fd->perm[j] = key[j-lo].ir;
+
+   /* the bounds of the rectangles themselves, not of their centers */
+   mid = (lo+hi)/2;
+   fd->axis[mid] = ax;
+   for(k=0;k<3;k++)
+      {
+      fd->box[6*mid+k] = 1.0e+20;
+      fd->box[6*mid+3+k] = -1.0e+20;
+      }
+   for(j=lo;j<hi;j++)
+      {
+      r = &fd->rc[fd->perm[j]];
+      for(k=0;k<3;k++)
+         {
+         ext = fabs(r->hl*r->us[k]) + fabs(r->hw*r->ud[k]);
+         if(r->c[k] - ext < fd->box[6*mid+k])
+            fd->box[6*mid+k] = r->c[k] - ext;
+         if(r->c[k] + ext > fd->box[6*mid+3+k])
+            fd->box[6*mid+3+k] = r->c[k] + ext;
+         }
+      }
+
+   stk[nstk++] = lo;
+   stk[nstk++] = mid;
+   stk[nstk++] = mid+1;
+   stk[nstk++] = hi;
+   }
+
+free(key);
+free(stk);
+return(0);
+}
+
+/*
+   The distance engine of the nrect rectangles rect (FDIST_NPAR floats
+   each, see faultdist.h), NULL if there are none or out of memory.
+*/
+struct fdist *fdist_build(float *rect,int nrect)
+{
+struct fdist *fd;
+struct fdist_rect *r;
+float *p, cosS, sinS, cosD, sinD, ztop, zbest;
+float latarg, radc, g2;
+float fc = FLAT_CONST;
+double slon, slat;
+int ir, is;
+
+if(nrect < 1)
+   return(NULL);
+
+fd = (struct fdist *) malloc(sizeof(struct fdist));
+if(fd == NULL)
+   return(NULL);
+
+fd->nrect = nrect;
+fd->rc = (struct fdist_rect *) malloc(nrect*sizeof(struct fdist_rect));
+fd->perm = (int *) malloc(nrect*sizeof(int));
+fd->axis = (unsigned char *) malloc(nrect*sizeof(unsigned char));
+fd->box = (float *) malloc(6*nrect*sizeof(float));
+fd->top = NULL;
+if(fd->rc == NULL || fd->perm == NULL || fd->axis == NULL || fd->box == NULL)
+   {
+   fdist_free(fd);
+   return(NULL);
+   }
+
+slon = 0.0;
+slat = 0.0;
+for(ir=0;ir<nrect;ir++)
+   {
+   slon = slon + rect[FDIST_NPAR*ir];
+   slat = slat + rect[FDIST_NPAR*ir+1];
+   }
+fd->mlon = slon/nrect;
+fd->mlat = slat/nrect;
+
+radc = ERAD*RPERD;
+set_g2(&g2,&fc);
+latarg = fdist_geocen(fd->mlat*RPERD);
+latlon2km(&latarg,&fd->kperd_n,&fd->kperd_e,&radc,&g2);
+
+fd->nseg = 1;
+for(ir=0;ir<nrect;ir++)
+   {
+   p = rect + FDIST_NPAR*ir;
+   r = &fd->rc[ir];
+
+   r->c[0] = (p[0] - fd->mlon)*fd->kperd_e;
+   r->c[1] = (p[1] - fd->mlat)*fd->kperd_n;
+   r->c[2] = p[2];
+
+   cosS = cos(p[3]*RPERD);
+   sinS = sin(p[3]*RPERD);
+   cosD = cos(p[4]*RPERD);
+   sinD = sin(p[4]*RPERD);
+
+   r->us[0] = sinS;
+   r->us[1] = cosS;
+   r->us[2] = 0.0;
+   r->ud[0] = cosS*cosD;
+   r->ud[1] = -sinS*cosD;
+   r->ud[2] = sinD;
+   r->uh[0] = cosS;
+   r->uh[1] = -sinS;
+
+   r->hl = 0.5*p[5];
+   r->hw = 0.5*p[6];
+   r->hwh = fabs(r->hw*cosD);
+
+   r->seg = (int)(p[7]);
+   if(r->seg < 0)
+      r->seg = 0;
+   if(r->seg + 1 > fd->nseg)
+      fd->nseg = r->seg + 1;
+   }
+
+/* the top edge of a segment is the one of its shallowest rectangle */
+fd->top = (float *) malloc(4*fd->nseg*sizeof(float));
+if(fd->top == NULL)
+   {
+   fdist_free(fd);
+   return(NULL);
+   }
+for(is=0;is<fd->nseg;is++)
+   {
+   zbest = 1.0e+20;
+   fd->top[4*is] = 0.0;
+   fd->top[4*is+1] = 0.0;
+   fd->top[4*is+2] = 1.0;
+   fd->top[4*is+3] = 0.0;
+   for(ir=0;ir<nrect;ir++)
+      {
+      r = &fd->rc[ir];
+      ztop = r->c[2] - r->hw*r->ud[2];
+      if(r->seg == is && ztop < zbest)
+         {
+         zbest = ztop;
+         fd->top[4*is] = r->c[0] - r->hw*r->ud[0];
+         fd->top[4*is+1] = r->c[1] - r->hw*r->ud[1];
+         fd->top[4*is+2] = r->uh[0];
+         fd->top[4*is+3] = r->uh[1];
+         }
+      }
+   }
+
+if(fdist_tree(fd) != 0)
+   {
+   fdist_free(fd);
+   return(NULL);
+   }
+
+return(fd);
+}
+
+void fdist_free(struct fdist *fd)
+{
+if(fd == NULL)
+   return;
+
+free(fd->rc);
+free(fd->perm);
+free(fd->axis);
+free(fd->box);
+free(fd->top);
+free(fd);
+}
+
+/* squared distance from s to the box b, horizontally only if dim == 2 */
+static float fdist_box(float *b,float *s,int dim)
+{
+float g, d;
+int k;
+
+d = 0.0;
+for(k=0;k<dim;k++)
+   {
+   g = 0.0;
+   if(s[k] < b[k])
+      g = b[k] - s[k];
+   else if(s[k] > b[3+k])
+      g = s[k] - b[3+k];
+   d = d + g*g;
+   }
+return(d);
+}
+
+/* squared distance from s to the rectangle r, or (dim == 2) to its surface projection */
+static float fdist_rect(struct fdist_rect *r,float *s,int dim)
+{
+float dx[3], e[3], a, b;
+int k;
+
+for(k=0;k<3;k++)
+   dx[k] = s[k] - r->c[k];
+
+a = dx[0]*r->us[0] + dx[1]*r->us[1];
+if(a > r->hl)
+   a = r->hl;
+if(a < -r->hl)
+   a = -r->hl;
+
+if(dim == 2)
+   {
+   b = dx[0]*r->uh[0] + dx[1]*r->uh[1];
+   if(b > r->hwh)
+      b = r->hwh;
+   if(b < -r->hwh)
+      b = -r->hwh;
+
+   e[0] = dx[0] - a*r->us[0] - b*r->uh[0];
+   e[1] = dx[1] - a*r->us[1] - b*r->uh[1];
+   return(e[0]*e[0] + e[1]*e[1]);
+   }
+
+b = dx[0]*r->ud[0] + dx[1]*r->ud[1] + dx[2]*r->ud[2];
+if(b > r->hw)
+   b = r->hw;
+if(b < -r->hw)
+   b = -r->hw;
+
+for(k=0;k<3;k++)
+   e[k] = dx[k] - a*r->us[k] - b*r->ud[k];
+return(e[0]*e[0] + e[1]*e[1] + e[2]*e[2]);
+}
+
+/* lowers *best (squared) and sets *ibest from the range [lo,hi) of the tree */
+static void fdist_near(struct fdist *fd,int lo,int hi,float *s,int dim,float *best,int *ibest)
+{
+float d;
+int mid, ax;
+
+if(hi - lo < 1)
+   return;
+
+mid = (lo+hi)/2;
+if(fdist_box(&fd->box[6*mid],s,dim) >= *best)
+   return;
+
+d = fdist_rect(&fd->rc[fd->perm[mid]],s,dim);
+if(d < *best || (d == *best && fd->perm[mid] < *ibest))
+   {
+   *best = d;
+   *ibest = fd->perm[mid];
+   }
+
+/* near side first, the far one is then often skipped */
+ax = fd->axis[mid];
+if(s[ax] < fd->rc[fd->perm[mid]].c[ax])
+   {
+   fdist_near(fd,lo,mid,s,dim,best,ibest);
+   fdist_near(fd,mid+1,hi,s,dim,best,ibest);
+   }
+else
+   {
+   fdist_near(fd,mid+1,hi,s,dim,best,ibest);
+   fdist_near(fd,lo,mid,s,dim,best,ibest);
+   }
+}
+
+/* Rrup, Rjb and Rx (km) of the station at slon, slat */
+void fdist_station(struct fdist *fd,float slon,float slat,float *rrup,float *rjb,float *rx)
+{
+float s[3], best, *t;
+int ibest;
+
+s[0] = (slon - fd->mlon)*fd->kperd_e;
+s[1] = (slat - fd->mlat)*fd->kperd_n;
+s[2] = 0.0;
+
+best = 1.0e+30;
+ibest = fd->nrect;
+fdist_near(fd,0,fd->nrect,s,3,&best,&ibest);
+*rrup = sqrt(best);
+
+best = 1.0e+30;
+ibest = fd->nrect;
+fdist_near(fd,0,fd->nrect,s,2,&best,&ibest);
+*rjb = sqrt(best);
+
+t = fd->top + 4*fd->rc[ibest].seg;
+*rx = (s[0] - t[0])*t[2] + (s[1] - t[1])*t[3];
+}
+
+/* the ns stations slon, slat, by nthreads OpenMP threads (0 = all) */
+void fdist_batch(struct fdist *fd,float *slon,float *slat,int ns,float *rrup,float *rjb,float *rx,int nthreads)
+{
+int i;
+
+#ifdef _OPENMP
+if(nthreads <= 0)
+   nthreads = omp_get_max_threads();
+#endif
+if(nthreads <= 0)
+   nthreads = 1;
+
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic,16)
+for(i=0;i<ns;i++)
+   fdist_station(fd,slon[i],slat[i],&rrup[i],&rjb[i],&rx[i]);
+}
+
+/*
+   The rectangle (FDIST_NPAR floats) of a plane given by the lon, lat
+   of the center of its top edge, as in an SRC file; it is segment 0.
+*/
+void fdist_plane(float lon,float lat,float dtop,float len,float wid,float strike,float dip,float *rect)
+{
+float latarg, radc, g2, kperd_n, kperd_e, dh;
+float fc = FLAT_CONST;
+
+radc = ERAD*RPERD;
+set_g2(&g2,&fc);
+latarg = fdist_geocen(lat*RPERD);
+latlon2km(&latarg,&kperd_n,&kperd_e,&radc,&g2);
+
+/* half the width down dip, its horizontal part in the dip direction */
+dh = 0.5*wid*cos(dip*RPERD);
+
+rect[0] = lon + dh*cos(strike*RPERD)/kperd_e;
+rect[1] = lat - dh*sin(strike*RPERD)/kperd_n;
+rect[2] = dtop + 0.5*wid*sin(dip*RPERD);
+rect[3] = strike;
+rect[4] = dip;
+rect[5] = len;
+rect[6] = wid;
+rect[7] = 0.0;
+}
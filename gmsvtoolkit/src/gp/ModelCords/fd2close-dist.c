@@ -2,6 +2,7 @@
 #include <fcntl.h>
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 
 #include <sys/file.h>
@@ -13,7 +14,28 @@
 #include <sys/time.h>
 #include <sys/types.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+   Closest distance from each station to the fault points (or, with
+   dlen= and dwid=, to the subfault rectangles centered on them).
+
+   The fault points go in a k-d tree, so each station visits about
+   log(nf) points instead of all nf, and the stations are shared out
+   over nthreads OpenMP threads.  Coordinates are km with x east,
+   y north and z down; the rectangles are dlen along strike and dwid
+   down dip, strike (clockwise from y) and dip in degrees.
+*/
+
+#define RPERD 0.017453293
+
 char *check_malloc();
+void kd_build();
+void kd_nearest();
+float rect_dist();
+float box_dist();
 
 struct fc
    {
@@ -30,6 +52,21 @@ struct sc
    char name[16];
    };
 
+/* geometry of the subfault rectangles, a half-lengths and unit vectors */
+struct rect
+   {
+   int on;
+   float hl, hw;
+   float us[3], ud[3];
+   float slack;
+   };
+
+struct kd_sort_key
+   {
+   float v;
+   int ip;
+   };
+
 main(ac,av)
 int ac;
 char **av;
@@ -37,16 +74,45 @@ char **av;
 FILE *fpw, *fpr, *fopfile();
 struct sc *sc;
 struct fc *fc;
-float xx, yy, zz, r, cdmin;
-int i, j, ns, nf;
+struct rect rc;
+float *cd, cdmin, strike, dip, dlen, dwid;
+int i, j, ns, nf, *kperm, nthreads;
+unsigned char *kaxis;
+float *kbox;
 char outfile[128], statfile[128], faultfile[128], str[512];
 
+dlen = -1.0;
+dwid = -1.0;
+strike = 0.0;
+dip = 90.0;
+nthreads = 0;
+
 setpar(ac,av);
 mstpar("statfile","s",statfile);
 mstpar("faultfile","s",faultfile);
 mstpar("outfile","s",outfile);
+getpar("dlen","f",&dlen);
+getpar("dwid","f",&dwid);
+getpar("strike","f",&strike);
+getpar("dip","f",&dip);
+getpar("nthreads","d",&nthreads);
 endpar();
 
+rc.on = 0;
+if(dlen > 0.0 && dwid > 0.0)
+   {
+   rc.on = 1;
+   rc.hl = 0.5*dlen;
+   rc.hw = 0.5*dwid;
+   rc.us[0] = sin(strike*RPERD);
+   rc.us[1] = cos(strike*RPERD);
+   rc.us[2] = 0.0;
+   rc.ud[0] = cos(strike*RPERD)*cos(dip*RPERD);
+   rc.ud[1] = -sin(strike*RPERD)*cos(dip*RPERD);
+   rc.ud[2] = sin(dip*RPERD);
+   rc.slack = sqrt(rc.hl*rc.hl + rc.hw*rc.hw);
+   }
+
 fpr = fopfile(statfile,"r");
 fscanf(fpr,"%d",&ns);
 
@@ -58,7 +124,8 @@ for(i=0;i<ns;i++)
 fclose(fpr);
 
 fpr = fopfile(faultfile,"r");
-fscanf(fpr,"%d",&nf);
+fgets(str,512,fpr);
+sscanf(str,"%d",&nf);
 
 fc = (struct fc *) check_malloc (nf*sizeof(struct fc));
 
@@ -70,26 +137,237 @@ for(j=0;j<nf;j++)
 
 fclose(fpr);
 
+kperm = (int *) check_malloc (nf*sizeof(int));
+kaxis = (unsigned char *) check_malloc (nf*sizeof(unsigned char));
+kbox = (float *) check_malloc (6*nf*sizeof(float));
+kd_build(fc,nf,kperm,kaxis,kbox);
+
+cd = (float *) check_malloc (ns*sizeof(float));
+
+#ifdef _OPENMP
+if(nthreads <= 0)
+   nthreads = omp_get_max_threads();
+#endif
+
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic,16) private(cdmin)
+for(i=0;i<ns;i++)
+   {
+   cdmin = 1.0e+20;
+   kd_nearest(fc,kperm,kaxis,kbox,0,nf,&sc[i],&rc,&cdmin);
+
+   /* search is done on squared distances */
+   cd[i] = 1.0e+10;
+   if(cdmin < 1.0e+20)
+      cd[i] = sqrt(cdmin);
+   }
+
 fpw = fopfile(outfile,"w");
 
 for(i=0;i<ns;i++)
+   fprintf(fpw,"%13.5e %s\n",cd[i],sc[i].name);
+
+fclose(fpw);
+}
+
+int kd_sort_cmp(const void *a,const void *b)
+{
+const struct kd_sort_key *ka = (const struct kd_sort_key *) a;
+const struct kd_sort_key *kb = (const struct kd_sort_key *) b;
+
+if(ka->v < kb->v)
+   return(-1);
+if(ka->v > kb->v)
+   return(1);
+return(ka->ip - kb->ip);
+}
+
+/*
+   Implicit k-d tree: the node of the range [lo,hi) of kperm is its
+   median mid = (lo+hi)/2, kaxis[mid] the axis of largest extent of
+   the range, the points before mid are below it on that axis and the
+   ones after it above.  kbox[6*mid] holds the bounding box of the
+   range, min x,y,z then max x,y,z.
+*/
+
+void kd_build(fc,nf,kperm,kaxis,kbox)
+struct fc *fc;
+int nf, *kperm;
+unsigned char *kaxis;
+float *kbox;
+{
+struct kd_sort_key *key;
+int *stk, nstk, lo, hi, mid, j, ax;
+float vmin[3], vmax[3], v;
+
+for(j=0;j<nf;j++)
+   kperm[j] = j;
+
+key = (struct kd_sort_key *) check_malloc ((nf+1)*sizeof(struct kd_sort_key));
+stk = (int *) check_malloc (2*(nf+1)*sizeof(int));
+
+nstk = 0;
+stk[nstk++] = 0;
+stk[nstk++] = nf;
+while(nstk > 0)
    {
-   cdmin = 1.0e+10;
-   for(j=0;j<nf;j++)
+   hi = stk[--nstk];
+   lo = stk[--nstk];
+   if(hi - lo < 1)
+      continue;
+
+   vmin[0] = vmin[1] = vmin[2] = 1.0e+20;
+   vmax[0] = vmax[1] = vmax[2] = -1.0e+20;
+   for(j=lo;j<hi;j++)
       {
-      xx = fc[j].x - sc[i].x;
-      yy = fc[j].y - sc[i].y;
-      zz = fc[j].z - sc[i].z;
+      for(ax=0;ax<3;ax++)
+         {
+	 v = (&fc[kperm[j]].x)[ax];
+	 if(v < vmin[ax])
+	    vmin[ax] = v;
+	 if(v > vmax[ax])
+	    vmax[ax] = v;
+	 }
+      }
+   ax = 0;
+   if(vmax[1]-vmin[1] > vmax[ax]-vmin[ax])
+      ax = 1;
+   if(vmax[2]-vmin[2] > vmax[ax]-vmin[ax])
+      ax = 2;
+
+   for(j=lo;j<hi;j++)
+      {
+      key[j-lo].v = (&fc[kperm[j]].x)[ax];
+      key[j-lo].ip = kperm[j];
+      }
+   qsort(key,hi-lo,sizeof(struct kd_sort_key),kd_sort_cmp);
+   for(j=lo;j<hi;j++)
+      kperm[j] = key[j-lo].ip;
 
-      r = sqrt(xx*xx + yy*yy + zz*zz);
-      if(r < cdmin)
-	 cdmin = r;
+   mid = (lo+hi)/2;
+   kaxis[mid] = ax;
+   for(j=0;j<3;j++)
+      {
+      kbox[6*mid+j] = vmin[j];
+      kbox[6*mid+3+j] = vmax[j];
       }
 
-   fprintf(fpw,"%13.5e %s\n",cdmin,sc[i].name);
+   stk[nstk++] = lo;
+   stk[nstk++] = mid;
+   stk[nstk++] = mid+1;
+   stk[nstk++] = hi;
    }
 
-fclose(fpw);
+free(key);
+free(stk);
+}
+
+/*
+   Squared distance from station s to the fault point (or rectangle)
+   nearest to it, lowering *best.  A range is skipped when its bounding
+   box is not closer than *best; with rectangles the box is grown by
+   rc->slack, the half diagonal, so that it holds all the rectangles.
+*/
+
+void kd_nearest(fc,kperm,kaxis,kbox,lo,hi,s,rc,best)
+struct fc *fc;
+struct sc *s;
+struct rect *rc;
+int *kperm, lo, hi;
+unsigned char *kaxis;
+float *kbox, *best;
+{
+float xx, yy, zz, r, slack;
+int mid;
+
+if(hi - lo < 1)
+   return;
+
+mid = (lo+hi)/2;
+slack = 0.0;
+if(rc->on)
+   slack = rc->slack;
+if(box_dist(&kbox[6*mid],s,slack) >= *best)
+   return;
+
+if(rc->on)
+   r = rect_dist(&fc[kperm[mid]],s,rc);
+else
+   {
+   xx = fc[kperm[mid]].x - s->x;
+   yy = fc[kperm[mid]].y - s->y;
+   zz = fc[kperm[mid]].z - s->z;
+   r = xx*xx + yy*yy + zz*zz;
+   }
+if(r < *best)
+   *best = r;
+
+/* near side first, the far one is then often skipped */
+if((&s->x)[kaxis[mid]] < (&fc[kperm[mid]].x)[kaxis[mid]])
+   {
+   kd_nearest(fc,kperm,kaxis,kbox,lo,mid,s,rc,best);
+   kd_nearest(fc,kperm,kaxis,kbox,mid+1,hi,s,rc,best);
+   }
+else
+   {
+   kd_nearest(fc,kperm,kaxis,kbox,mid+1,hi,s,rc,best);
+   kd_nearest(fc,kperm,kaxis,kbox,lo,mid,s,rc,best);
+   }
+}
+
+/* squared distance from station s to box b grown by slack */
+
+float box_dist(b,s,slack)
+float *b, slack;
+struct sc *s;
+{
+float v, g, r;
+int k;
+
+r = 0.0;
+for(k=0;k<3;k++)
+   {
+   v = (&s->x)[k];
+   g = 0.0;
+   if(v < b[k])
+      g = b[k] - v;
+   else if(v > b[3+k])
+      g = v - b[3+k];
+   g = g - slack;
+   if(g > 0.0)
+      r = r + g*g;
+   }
+return(r);
+}
+
+/* squared distance from station s to the rectangle centered on f */
+
+float rect_dist(f,s,rc)
+struct fc *f;
+struct sc *s;
+struct rect *rc;
+{
+float dx[3], a, b, e[3];
+int k;
+
+dx[0] = s->x - f->x;
+dx[1] = s->y - f->y;
+dx[2] = s->z - f->z;
+
+a = dx[0]*rc->us[0] + dx[1]*rc->us[1] + dx[2]*rc->us[2];
+b = dx[0]*rc->ud[0] + dx[1]*rc->ud[1] + dx[2]*rc->ud[2];
+if(a > rc->hl)
+   a = rc->hl;
+if(a < -rc->hl)
+   a = -rc->hl;
+if(b > rc->hw)
+   b = rc->hw;
+if(b < -rc->hw)
+   b = -rc->hw;
+
+for(k=0;k<3;k++)
+   e[k] = dx[k] - a*rc->us[k] - b*rc->ud[k];
+
+return(e[0]*e[0] + e[1]*e[1] + e[2]*e[2]);
 }
 
 FILE *fopfile(name,mode)
@@ -1,6 +1,10 @@
 void gcproj(float *,float *,float *,float *,float *,double *,double *,double *,double *,int);
 void gen_matrices(double *,double *,float *,float *,float *);
 
+void gcproj_batch(float *,float *,float *,float *,int,float *,double *,double *,double *,double *,int);
+void km2ll_batch(float *,float *,float *,float *,int,float,float,float *,float,float);
+void ll2km_batch(float *,float *,float *,float *,int,float,float,float,float,float,float,float,float);
+
 void latlon2km(float *,float *,float *,float *,float *);
 void set_g2(float *,float *);
 void geocen(float *,double);
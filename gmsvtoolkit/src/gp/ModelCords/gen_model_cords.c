@@ -7,6 +7,8 @@
 #define         FTWO            (float)(2.0)
 #define         KM2FT           (float)(3280.84)
 #define MAX_NLEN 100
+#define ROWBLOCK 64     /* rows formatted per block for text output */
+#define ROWPTLEN 64     /* max. characters of one text output line */
 
 struct fdcf
    {
@@ -44,26 +46,38 @@ struct gridparam
    };
 
 #include "function.h"
+#include "getpar.h"
+
+void geoutm_(double *dlon, double *dlat, double *xr0,
+	     double *yr0, int *utm_zone, int *geo2utm);
 
 void *check_malloc(size_t);
 void *check_realloc(void *,size_t);
-void set_gridparams(char *,struct gridparam *, char *,int);
+void set_gridparams(char *,struct gridparam *, char *,int,char *);
+void write_gridout(char *,struct gridparam *,float,float,float);
+int read_gridcache(char *,unsigned long long,struct gridparam *,int,float *);
+void write_gridcache(char *,unsigned long long,struct gridparam *,int,float *);
+unsigned long long hash_file(char *);
 void setcoef(struct fdcf *,struct fdcf *,float *,int);
 void gelim_double(double *,int,double *);
 void getlens(FILE *,char *,float *,float *,float *,float *,int *);
 
-main(int ac,char **av)
+int main(int ac,char **av)
 {
 struct gridparam gp;
-char gridfile[256], gridout[256];
+char gridfile[256], gridout[256], gridcache[256];
 FILE *fpw, *fpr, *fopfile();
 float *flon, *flat, modellon, modellat, modelrot, x, y;
 float ar1, ar2, ar3, ar4, latavg;
+float ar[4], *xg, *yg;
 float cosR, sinR, kmlon, kmlat;
 float xlen, ylen, zlen;
 float xmax, ymax, zmax;
 float dep, *cc1, *cc2, conv;
 int ix, iy, iz, ip;
+int iy0, ib, nb, nc, *rowlen;
+size_t lrow;
+char *rowbuf;
 char outfile[128], str[512], name[64];
 
 double rperd = RPERD;
@@ -83,6 +97,7 @@ int nzout = 1;
 int latfirst = 1;
 int feetout = 1;
 int gzip = 1;
+int binout = 0;
 
 double xr0, yr0, dlon, dlat, dxr, dyr;
 int geo2utm = 0;
@@ -101,10 +116,12 @@ float xshift = -1.0e+15;
 float yshift = -1.0e+15;
 
 sprintf(gridout,"gridout");
+gridcache[0] = '\0';
 
 setpar(ac,av);
 mstpar("gridfile","s",gridfile);
 getpar("gridout","s",gridout);
+getpar("gridcache","s",gridcache);
 mstpar("modellat","f",&modellat);
 mstpar("modellon","f",&modellon);
 mstpar("modelrot","f",&modelrot);
@@ -116,6 +133,7 @@ if(do_coords)
    getpar("latfirst","d",&latfirst);
    getpar("feetout","d",&feetout);
    getpar("gzip","d",&gzip);
+   getpar("binout","d",&binout);
    }
 
 getpar("geoproj","d",&geoproj);
@@ -124,7 +142,7 @@ getpar("xshift","f",&xshift);
 getpar("yshift","f",&yshift);
 endpar();
 
-set_gridparams(gridfile,&gp,gridout,0);  /* free surface = 0 */
+set_gridparams(gridfile,&gp,gridout,0,gridcache);  /* free surface = 0 */
 
 xmax = gp.xp[gp.nx-1];
 ymax = gp.yp[gp.ny-1];
@@ -268,33 +286,44 @@ if(do_coords)
    flon = (float *) check_realloc (flon,gp.nx*gp.ny*sizeof(float));
    flat = (float *) check_realloc (flat,gp.nx*gp.ny*sizeof(float));
 
-   for(iy=0;iy<gp.ny;iy++)
+   /* geoproj=0,1: the whole grid is projected with one batched call */
+
+   if(geoproj == 0 || geoproj == 1)
       {
-      fprintf(stderr,"iy=%d\n",iy);
+      xg = (float *) check_malloc (gp.nx*gp.ny*sizeof(float));
+      yg = (float *) check_malloc (gp.nx*gp.ny*sizeof(float));
 
-      if(geoproj == 0)
+      for(iy=0;iy<gp.ny;iy++)
          {
          for(ix=0;ix<gp.nx;ix++)
             {
             ip = ix + iy*gp.nx;
 
-            flon[ip] = modellon + (gp.xp[ix]+xshift)*ar1 - (gp.yp[iy]+yshift)*ar2;
-            flat[ip] = modellat - (gp.xp[ix]+xshift)*ar4 - (gp.yp[iy]+yshift)*ar3;
+            xg[ip] = gp.xp[ix];
+            yg[ip] = gp.yp[iy];
             }
          }
-      else if(geoproj == 1)
-         {
-         for(ix=0;ix<gp.nx;ix++)
-            {
-            ip = ix + iy*gp.nx;
 
-            x = gp.xp[ix];
-            y = gp.yp[iy];
-            gcproj(&x,&y,&flon[ip],&flat[ip],&erad,&g0,&b0,amat,ainv,xy2ll);
-            }
+      if(geoproj == 0)
+         {
+         ar[0] = ar1;
+         ar[1] = ar2;
+         ar[2] = ar3;
+         ar[3] = ar4;
+         km2ll_batch(xg,yg,flon,flat,gp.nx*gp.ny,modellon,modellat,ar,xshift,yshift);
          }
-      else if(geoproj == 2)
+      else
+         gcproj_batch(xg,yg,flon,flat,gp.nx*gp.ny,&erad,&g0,&b0,amat,ainv,xy2ll);
+
+      free(xg);
+      free(yg);
+      }
+   else if(geoproj == 2)
+      {
+      for(iy=0;iy<gp.ny;iy++)
          {
+         fprintf(stderr,"iy=%d\n",iy);
+
          for(ix=0;ix<gp.nx;ix++)
             {
             ip = ix + iy*gp.nx;
@@ -329,9 +358,27 @@ if(do_coords)
    else
       fprintf(stderr,"**** coordinate output format is LON LAT DEP\n");
 
+   if(binout)
+      fprintf(stderr,"**** output files are binary float32 planes (nx*ny each)\n");
+
    if(gzip)
       fprintf(stderr,"**** output files are compressed with 'gzip' (.gz)\n");
 
+   /*
+      Text output is formatted ROWBLOCK rows at a time, the rows of a
+      block in parallel, and each row is written with one call.  The
+      binary output (binout=1) is the first coordinate plane followed
+      by the second, in the order selected by latfirst, each nx*ny
+      float values with x varying fastest.
+   */
+
+   lrow = (size_t)(ROWPTLEN)*gp.nx;
+   if(binout == 0)
+      {
+      rowbuf = (char *) check_malloc (ROWBLOCK*lrow*sizeof(char));
+      rowlen = (int *) check_malloc (ROWBLOCK*sizeof(int));
+      }
+
    for(iz=0;iz<nzout;iz++)
       {
       fprintf(stderr,"iz=%d\n",iz);
@@ -344,13 +391,36 @@ if(do_coords)
       fpw = fopfile(outfile,"w");
 
       dep = (gp.zp[iz])*conv;
-      for(iy=0;iy<gp.ny;iy++)
+
+      if(binout)
          {
-         for(ix=0;ix<gp.nx;ix++)
+         fwrite(cc1,sizeof(float),gp.nx*gp.ny,fpw);
+         fwrite(cc2,sizeof(float),gp.nx*gp.ny,fpw);
+         }
+      else
+         {
+         for(iy0=0;iy0<gp.ny;iy0=iy0+ROWBLOCK)
             {
-            ip = ix + iy*gp.nx;
-
-            fprintf(fpw,"%10.4f %10.4f %5d %5d\n",cc1[ip],cc2[ip],ix,iy);
+            nb = ROWBLOCK;
+            if(iy0 + nb > gp.ny)
+               nb = gp.ny - iy0;
+
+#pragma omp parallel for schedule(dynamic,1) private(iy,ix,ip,nc)
+            for(ib=0;ib<nb;ib++)
+               {
+               iy = iy0 + ib;
+               nc = 0;
+               for(ix=0;ix<gp.nx;ix++)
+                  {
+                  ip = ix + iy*gp.nx;
+
+                  nc = nc + snprintf(rowbuf+ib*lrow+nc,lrow-nc,"%10.4f %10.4f %5d %5d\n",cc1[ip],cc2[ip],ix,iy);
+                  }
+               rowlen[ib] = nc;
+               }
+
+            for(ib=0;ib<nb;ib++)
+               fwrite(rowbuf+ib*lrow,1,rowlen[ib],fpw);
             }
          }
       fclose(fpw);
@@ -361,6 +431,12 @@ if(do_coords)
          system(str);
          }
       }
+
+   if(binout == 0)
+      {
+      free(rowbuf);
+      free(rowlen);
+      }
    }
 }
 
@@ -385,7 +461,7 @@ r = atan((1.0 - (1.0/FLAT_CONST))*tan(x));
 return(r);
 }
 
-set_g2X(g2,fc)
+void set_g2X(g2,fc)
 float *g2, *fc;
 {
 float f;
@@ -394,7 +470,7 @@ f = (1.0)/(*fc);
 *g2 = ((2.0)*f - f*f)/(((1.0) - f)*((1.0) - f));
 }
 
-latlon2kmX(arg,latkm,lonkm,rc,g2)
+void latlon2kmX(arg,latkm,lonkm,rc,g2)
 float *arg, *latkm, *lonkm, *rc, *g2;
 {
 float cosA, sinA, g2s2, den;
@@ -436,7 +512,14 @@ if(ptr == NULL)
 return(ptr);
 }
 
-void set_gridparams(char *gfile,struct gridparam *gp, char *gout,int fs)
+/*
+   If gcache names a directory, the grid (spacings, node positions and
+   FD coefficients) is saved there in binary form, keyed by a hash of
+   the gridfile contents and fs, and later runs with the same gridfile
+   read it back instead of rebuilding it.
+*/
+
+void set_gridparams(char *gfile,struct gridparam *gp, char *gout,int fs,char *gcache)
 {
 float x0[MAX_NLEN], x1[MAX_NLEN], dxlen[MAX_NLEN];
 float y0[MAX_NLEN], y1[MAX_NLEN], dylen[MAX_NLEN];
@@ -448,12 +531,24 @@ int nxlen, nylen, nzlen;
 int nx, ny, nz;
 int i, j;
 
-FILE *fpr, *fpw, *fopfile();
+FILE *fpr, *fopfile();
 char str[512];
 
 float hmin = 1.0e+15;
 float hmax = -1.0e+15;
-float szero = 0.0;
+unsigned long long ghash = 0;
+float lens[3];
+
+if(gcache[0] != '\0')
+   {
+   ghash = hash_file(gfile);
+   if(read_gridcache(gcache,ghash,gp,fs,lens) == 0)
+      {
+      if(gout[0] != '\0')
+         write_gridout(gout,gp,lens[0],lens[1],lens[2]);
+      return;
+      }
+   }
 
 fpr = fopfile(gfile,"r");
 
@@ -591,49 +686,227 @@ gp->hmin = hmin;
 gp->hmax = hmax;
 
 if(gout[0] != '\0')
+   write_gridout(gout,gp,xlen,ylen,zlen);
+
+if(gcache[0] != '\0')
    {
-   fpw = fopfile(gout,"w");
+   lens[0] = xlen;
+   lens[1] = ylen;
+   lens[2] = zlen;
+   write_gridcache(gcache,ghash,gp,fs,lens);
+   }
+}
 
-   fprintf(fpw,"xlen=%.5f\n",xlen);
-   fprintf(fpw,"nx=%d\n",nx);
-   for(i=0;i<nx;i++)
+void write_gridout(char *gout,struct gridparam *gp,float xlen,float ylen,float zlen)
+{
+FILE *fpw, *fopfile();
+float szero = 0.0;
+int i;
+
+fpw = fopfile(gout,"w");
+
+fprintf(fpw,"xlen=%.5f\n",xlen);
+fprintf(fpw,"nx=%d\n",gp->nx);
+for(i=0;i<gp->nx;i++)
+   {
+   fprintf(fpw,"%6d %13.5e %13.5e\n",i,gp->xp[i],gp->hx[i]);
+   if(gp->hx[i] <= (float)(0.0))
       {
-      fprintf(fpw,"%6d %13.5e %13.5e\n",i,gp->xp[i],gp->hx[i]);
-      if(gp->hx[i] <= (float)(0.0))
-         {
-         fprintf(stderr,"**** Problem with zero hx, check '%s'\n",gout);
-         fprintf(stderr,"     exiting...\n");
-         exit(-1);
-         }
+      fprintf(stderr,"**** Problem with zero hx, check '%s'\n",gout);
+      fprintf(stderr,"     exiting...\n");
+      exit(-1);
       }
+   }
 
-   fprintf(fpw,"ylen=%.5f\n",ylen);
-   fprintf(fpw,"ny=%d\n",ny);
-   for(i=0;i<ny;i++)
+fprintf(fpw,"ylen=%.5f\n",ylen);
+fprintf(fpw,"ny=%d\n",gp->ny);
+for(i=0;i<gp->ny;i++)
+   {
+   fprintf(fpw,"%6d %13.5e %13.5e\n",i,gp->yp[i],gp->hy[i]);
+   if(gp->hy[i] <= szero)
       {
-      fprintf(fpw,"%6d %13.5e %13.5e\n",i,gp->yp[i],gp->hy[i]);
-      if(gp->hy[i] <= szero)
-         {
-         fprintf(stderr,"**** Problem with zero hy, check '%s'\n",gout);
-         fprintf(stderr,"     exiting...\n");
-         exit(-1);
-         }
+      fprintf(stderr,"**** Problem with zero hy, check '%s'\n",gout);
+      fprintf(stderr,"     exiting...\n");
+      exit(-1);
+      }
+   }
+
+fprintf(fpw,"zlen=%.5f\n",zlen);
+fprintf(fpw,"nz=%d\n",gp->nz);
+for(i=0;i<gp->nz;i++)
+   {
+   fprintf(fpw,"%6d %13.5e %13.5e\n",i,gp->zp[i],gp->hz[i]);
+   if(gp->hz[i] <= (float)(0.0))
+      {
+      fprintf(stderr,"**** Problem with zero hz, check '%s'\n",gout);
+      fprintf(stderr,"     exiting...\n");
+      exit(-1);
+      }
+   }
+
+fclose(fpw);
+}
+
+/*
+   64-bit FNV-1a hash of the contents of a file.
+*/
+
+unsigned long long hash_file(char *file)
+{
+FILE *fpr, *fopfile();
+unsigned char buf[8192];
+unsigned long long h = 14695981039346656037ULL;
+size_t nr, i;
+
+fpr = fopfile(file,"r");
+while((nr = fread(buf,1,sizeof(buf),fpr)) > 0)
+   {
+   for(i=0;i<nr;i++)
+      {
+      h = h ^ buf[i];
+      h = h*1099511628211ULL;
       }
+   }
+fclose(fpr);
+
+return(h);
+}
+
+#define GRIDCACHE_MAGIC "GRIDPAR1"
 
-   fprintf(fpw,"zlen=%.5f\n",zlen);
-   fprintf(fpw,"nz=%d\n",nz);
-   for(i=0;i<nz;i++)
+/*
+   Grid cache file layout: the 8 byte magic, the gridfile hash, fs,
+   nx, ny, nz, hmin, hmax, xlen, ylen, zlen, then for each of x, y, z
+   the spacings, the node positions and the two coefficient arrays.
+*/
+
+void gridcache_name(char *name,char *dir,unsigned long long h,int fs)
+{
+sprintf(name,"%s/gridparam-%016llx-fs%d.bin",dir,h,fs);
+}
+
+/* returns 0 on success, -1 if there is no usable cache file */
+
+int read_gridcache(char *dir,unsigned long long h,struct gridparam *gp,int fs,float *lens)
+{
+FILE *fpr;
+char name[1024], magic[8];
+unsigned long long hc;
+int ic[4], nn[3], i;
+float fv[5];
+float **hg[3], **pg[3];
+struct fdcf **c0[3], **c1[3];
+
+gridcache_name(name,dir,h,fs);
+if((fpr = fopen(name,"r")) == NULL)
+   return(-1);
+
+if(fread(magic,1,8,fpr) != 8 || strncmp(magic,GRIDCACHE_MAGIC,8) != 0 ||
+   fread(&hc,sizeof(hc),1,fpr) != 1 || hc != h ||
+   fread(ic,sizeof(int),4,fpr) != 4 || ic[0] != fs ||
+   ic[1] < 1 || ic[2] < 1 || ic[3] < 1 ||
+   fread(fv,sizeof(float),5,fpr) != 5)
+   {
+   fclose(fpr);
+   return(-1);
+   }
+
+nn[0] = ic[1];
+nn[1] = ic[2];
+nn[2] = ic[3];
+
+hg[0] = &gp->hx; pg[0] = &gp->xp; c0[0] = &gp->cfx0; c1[0] = &gp->cfx1;
+hg[1] = &gp->hy; pg[1] = &gp->yp; c0[1] = &gp->cfy0; c1[1] = &gp->cfy1;
+hg[2] = &gp->hz; pg[2] = &gp->zp; c0[2] = &gp->cfz0; c1[2] = &gp->cfz1;
+
+for(i=0;i<3;i++)
+   {
+   *hg[i] = (float *) check_malloc (nn[i]*sizeof(float));
+   *pg[i] = (float *) check_malloc (nn[i]*sizeof(float));
+   *c0[i] = (struct fdcf *) check_malloc (nn[i]*sizeof(struct fdcf));
+   *c1[i] = (struct fdcf *) check_malloc (nn[i]*sizeof(struct fdcf));
+
+   if(fread(*hg[i],sizeof(float),nn[i],fpr) != nn[i] ||
+      fread(*pg[i],sizeof(float),nn[i],fpr) != nn[i] ||
+      fread(*c0[i],sizeof(struct fdcf),nn[i],fpr) != nn[i] ||
+      fread(*c1[i],sizeof(struct fdcf),nn[i],fpr) != nn[i])
       {
-      fprintf(fpw,"%6d %13.5e %13.5e\n",i,gp->zp[i],gp->hz[i]);
-      if(gp->hz[i] <= (float)(0.0))
+      fprintf(stderr,"**** grid cache '%s' is truncated, rebuilding\n",name);
+      for(;i>=0;i--)
          {
-         fprintf(stderr,"**** Problem with zero hz, check '%s'\n",gout);
-         fprintf(stderr,"     exiting...\n");
-         exit(-1);
+         free(*hg[i]);
+         free(*pg[i]);
+         free(*c0[i]);
+         free(*c1[i]);
          }
+      fclose(fpr);
+      return(-1);
       }
+   }
+fclose(fpr);
+
+gp->nx = nn[0];
+gp->ny = nn[1];
+gp->nz = nn[2];
+gp->hmin = fv[0];
+gp->hmax = fv[1];
+lens[0] = fv[2];
+lens[1] = fv[3];
+lens[2] = fv[4];
 
-   fclose(fpw);
+return(0);
+}
+
+void write_gridcache(char *dir,unsigned long long h,struct gridparam *gp,int fs,float *lens)
+{
+FILE *fpw;
+char name[1024], tmpname[1024];
+int ic[4];
+float fv[5];
+
+gridcache_name(name,dir,h,fs);
+sprintf(tmpname,"%s.%d",name,(int)getpid());
+
+if((fpw = fopen(tmpname,"w")) == NULL)
+   {
+   fprintf(stderr,"**** can't write grid cache '%s'\n",tmpname);
+   return;
+   }
+
+ic[0] = fs;
+ic[1] = gp->nx;
+ic[2] = gp->ny;
+ic[3] = gp->nz;
+fv[0] = gp->hmin;
+fv[1] = gp->hmax;
+fv[2] = lens[0];
+fv[3] = lens[1];
+fv[4] = lens[2];
+
+fwrite(GRIDCACHE_MAGIC,1,8,fpw);
+fwrite(&h,sizeof(h),1,fpw);
+fwrite(ic,sizeof(int),4,fpw);
+fwrite(fv,sizeof(float),5,fpw);
+
+fwrite(gp->hx,sizeof(float),gp->nx,fpw);
+fwrite(gp->xp,sizeof(float),gp->nx,fpw);
+fwrite(gp->cfx0,sizeof(struct fdcf),gp->nx,fpw);
+fwrite(gp->cfx1,sizeof(struct fdcf),gp->nx,fpw);
+
+fwrite(gp->hy,sizeof(float),gp->ny,fpw);
+fwrite(gp->yp,sizeof(float),gp->ny,fpw);
+fwrite(gp->cfy0,sizeof(struct fdcf),gp->ny,fpw);
+fwrite(gp->cfy1,sizeof(struct fdcf),gp->ny,fpw);
+
+fwrite(gp->hz,sizeof(float),gp->nz,fpw);
+fwrite(gp->zp,sizeof(float),gp->nz,fpw);
+fwrite(gp->cfz0,sizeof(struct fdcf),gp->nz,fpw);
+fwrite(gp->cfz1,sizeof(struct fdcf),gp->nz,fpw);
+
+if(fclose(fpw) != 0 || rename(tmpname,name) != 0)
+   {
+   fprintf(stderr,"**** can't write grid cache '%s'\n",name);
+   unlink(tmpname);
    }
 }
 
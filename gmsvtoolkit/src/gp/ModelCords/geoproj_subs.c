@@ -3,7 +3,12 @@
 #define         RPERD           0.017453292
 #define         FLAT_CONST      298.256
 
-void gcproj(float *xf,float *yf,float *rlon,float *rlat,float *ref_rad,double *g0,double *b0,double *amat,double *ainv,int gflag)
+/*
+   gcproj_one() is the projection of one point, shared by gcproj() and
+   gcproj_batch() so both give the same results.
+*/
+
+static inline void gcproj_one(float *xf,float *yf,float *rlon,float *rlat,float *ref_rad,double *g0,double *b0,double *amat,double *ainv,int gflag)
 {
 double xp, yp, zp;
 double xg, yg, zg;
@@ -96,6 +101,61 @@ else
    }
 }
 
+void gcproj(float *xf,float *yf,float *rlon,float *rlat,float *ref_rad,double *g0,double *b0,double *amat,double *ainv,int gflag)
+{
+gcproj_one(xf,yf,rlon,rlat,ref_rad,g0,b0,amat,ainv,gflag);
+}
+
+/*
+   Batched versions of the projections, for n points at once.  The
+   points are independent, so with -fopenmp large batches are shared
+   out over the threads; the results are the same as one call per point.
+
+   gcproj_batch():  gcproj() on xf[n], yf[n] <-> rlon[n], rlat[n]
+   km2ll_batch():   geoproj=0 model xp, yp (km) to lon, lat, with
+                    ar[4] = cosR/kmlon, sinR/kmlon, cosR/kmlat, sinR/kmlat
+   ll2km_batch():   geoproj=0 lon, lat to model xr, yr (km)
+*/
+
+#define GEOPROJ_PAR_MIN 4096
+
+void gcproj_batch(float *xf,float *yf,float *rlon,float *rlat,int n,float *ref_rad,double *g0,double *b0,double *amat,double *ainv,int gflag)
+{
+int i;
+
+#pragma omp parallel for schedule(static) if(n >= GEOPROJ_PAR_MIN)
+for(i=0;i<n;i++)
+   gcproj_one(&xf[i],&yf[i],&rlon[i],&rlat[i],ref_rad,g0,b0,amat,ainv,gflag);
+}
+
+void km2ll_batch(float *xp,float *yp,float *plon,float *plat,int n,float mlon,float mlat,float *ar,float xshift,float yshift)
+{
+int i;
+
+#pragma omp parallel for simd schedule(static) if(n >= GEOPROJ_PAR_MIN)
+for(i=0;i<n;i++)
+   {
+   plon[i] = mlon + (xp[i]+xshift)*ar[0] - (yp[i]+yshift)*ar[1];
+   plat[i] = mlat - (xp[i]+xshift)*ar[3] - (yp[i]+yshift)*ar[2];
+   }
+}
+
+void ll2km_batch(float *plon,float *plat,float *xr,float *yr,int n,float mlon,float mlat,float kperd_e,float kperd_n,float cosR,float sinR,float xshift,float yshift)
+{
+float xs, ys;
+int i;
+
+#pragma omp parallel for simd schedule(static) if(n >= GEOPROJ_PAR_MIN) private(xs,ys)
+for(i=0;i<n;i++)
+   {
+   xs = (plon[i] - mlon)*kperd_e;
+   ys = (mlat - plat[i])*kperd_n;
+
+   xr[i] = xs*cosR + ys*sinR - xshift;
+   yr[i] = -xs*sinR + ys*cosR - yshift;
+   }
+}
+
 void gen_matrices(double *amat,double *ainv,float *alpha,float *ref_lon,float *ref_lat)
 {
 double arg;
@@ -6,15 +6,21 @@
 #define         RPERD           0.017453292
 #define         FONE            (float)(1.0)
 #define         FTWO            (float)(2.0)
+#define         NHASH           (1<<18)
 
 void *check_malloc(size_t);
+void *check_realloc(void *,size_t);
 FILE *fopfile(char*, char*);
 
 #include "function.h"
+#include "getpar.h"
+
+void geoutm_(double *dlon, double *dlat, double *xr0,
+	     double *yr0, int *utm_zone, int *geo2utm);
 
 struct statinfo
    {
-   char name[8];
+   char name[64];
    float lat;
    float lon;
    float xp;
@@ -25,14 +31,18 @@ struct statinfo
    int iz;
    };
 
-main(int ac,char **av)
+int main(int ac,char **av)
 {
 FILE *fopfile(), *fp;
-struct statinfo si[MAX_STAT];
+struct statinfo *si;
 float mlat, mlon;
 float kperd_n, kperd_e, xlen, ylen, xs, ys;
 int i, ns, nx, ny, test;
 float cosR, sinR, xr, yr;
+float *slon, *slat, *sxr, *syr;
+int ic, nc, maxs, ih, last;
+int *hhead, *htail, *hnext;
+unsigned int namehash(char *);
 
 char infile[512], outfile[512], str[512];
 
@@ -154,87 +164,162 @@ else if(geoproj == 2)
    fprintf(stderr,"UTM Zone= %d\n",utm_zone);
    }
 
+/*
+   All the stations are read first, then projected in one batch and
+   mapped to the grid, and finally screened in input order.  Duplicate
+   names are found through a hash table of the stations kept so far, so
+   large station lists are no longer quadratic in the number of stations.
+*/
+
+maxs = MAX_STAT;
+si = (struct statinfo *) check_malloc (maxs*sizeof(struct statinfo));
+
 fp = fopfile(infile,"r");
 
-ns = 0;
+nc = 0;
 while(fgets(str,512,fp) != NULL)
    {
    if(str[0] != '#')
       {
+      if(nc == maxs)
+         {
+	 maxs = maxs + MAX_STAT;
+         si = (struct statinfo *) check_realloc (si,maxs*sizeof(struct statinfo));
+	 }
+
       if(read_depth)
-         sscanf(str,"%f %f %s %f",&si[ns].lon,&si[ns].lat,si[ns].name,&si[ns].zp);
+         sscanf(str,"%f %f %55s %f",&si[nc].lon,&si[nc].lat,si[nc].name,&si[nc].zp);
       else
          {
-         sscanf(str,"%f %f %s",&si[ns].lon,&si[ns].lat,si[ns].name);
-         si[ns].zp = 0.0;
+         sscanf(str,"%f %f %55s",&si[nc].lon,&si[nc].lat,si[nc].name);
+         si[nc].zp = 0.0;
          }
+      nc++;
+      }
+   }
+fclose(fp);
 
-      test = 1;
-      if(use_all == 0)
-         {
-         for(i=0;i<ns;i++)
-            {
-            if(strcmp(si[i].name,si[ns].name) == 0)
-	       {
-	       if(si[i].lon == si[ns].lon && si[i].lat == si[ns].lat)
-	          {
-	          test = 0;
-	          fprintf(stderr,"Station '%s' duplicated, only first occurrence used\n",si[ns].name);
-	          }
-	       else
-	          {
-	          fprintf(stderr,"Different location for '%s', check output\n",si[ns].name);
-	          sprintf(si[ns].name,"%sX",si[ns].name);
-	          }
-	       }
-            }
-         }
+slon = (float *) check_malloc ((nc+1)*sizeof(float));
+slat = (float *) check_malloc ((nc+1)*sizeof(float));
+sxr = (float *) check_malloc ((nc+1)*sizeof(float));
+syr = (float *) check_malloc ((nc+1)*sizeof(float));
 
-      if(test)
-         {
-         if(geoproj == 0)
-	    {
-            xs = (si[ns].lon - mlon)*kperd_e;
-            ys = (mlat - si[ns].lat)*kperd_n;
-
-            xr = xs*cosR + ys*sinR - xshift;
-            yr = -xs*sinR + ys*cosR - yshift;
-            }
-         else if(geoproj == 1)
-            {
-            gcproj(&xr,&yr,&si[ns].lon,&si[ns].lat,&erad,&g0,&b0,amat,ainv,ll2xy);
-	    }
-         else if(geoproj == 2)
-            {
-	    dlon = si[ns].lon;
-	    dlat = si[ns].lat;
-	    geoutm_(&dlon,&dlat,&dxr,&dyr,&utm_zone,&geo2utm);
+for(ic=0;ic<nc;ic++)
+   {
+   slon[ic] = si[ic].lon;
+   slat[ic] = si[ic].lat;
+   }
 
-	    xs = 0.001*(dxr - xr0);
-	    ys = 0.001*(yr0 - dyr);
+if(geoproj == 0)
+   ll2km_batch(slon,slat,sxr,syr,nc,mlon,mlat,kperd_e,kperd_n,cosR,sinR,xshift,yshift);
+else if(geoproj == 1)
+   gcproj_batch(sxr,syr,slon,slat,nc,&erad,&g0,&b0,amat,ainv,ll2xy);
+else if(geoproj == 2)
+   {
+   for(ic=0;ic<nc;ic++)
+      {
+      dlon = slon[ic];
+      dlat = slat[ic];
+      geoutm_(&dlon,&dlat,&dxr,&dyr,&utm_zone,&geo2utm);
 
-            xr = xs*cosR + ys*sinR - xshift;
-            yr = -xs*sinR + ys*cosR - yshift;
-	    }
+      xs = 0.001*(dxr - xr0);
+      ys = 0.001*(yr0 - dyr);
 
-         si[ns].xp = xr;
-         si[ns].yp = yr;
+      sxr[ic] = xs*cosR + ys*sinR - xshift;
+      syr[ic] = -xs*sinR + ys*cosR - yshift;
+      }
+   }
 
-         si[ns].ix = (int)(xr/h + 0.5);
-         si[ns].iy = (int)(yr/h + 0.5);
-         si[ns].iz = (int)(si[ns].zp/h + 1.5);
+#pragma omp parallel for schedule(static)
+for(ic=0;ic<nc;ic++)
+   {
+   si[ic].xp = sxr[ic];
+   si[ic].yp = syr[ic];
+
+   si[ic].ix = (int)(sxr[ic]/h + 0.5);
+   si[ic].iy = (int)(syr[ic]/h + 0.5);
+   si[ic].iz = (int)(si[ic].zp/h + 1.5);
+   }
+
+free(slon);
+free(slat);
+free(sxr);
+free(syr);
+
+/*
+   Screening.  The stations kept are compacted to the front of si[] and
+   chained by name hash, in input order, so the messages and renaming
+   of repeated names are the same as comparing with every earlier kept
+   station.
+*/
+
+hhead = (int *) check_malloc (NHASH*sizeof(int));
+htail = (int *) check_malloc (NHASH*sizeof(int));
+hnext = (int *) check_malloc ((nc+1)*sizeof(int));
+for(ih=0;ih<NHASH;ih++)
+   hhead[ih] = htail[ih] = -1;
+
+ns = 0;
+for(ic=0;ic<nc;ic++)
+   {
+   if(ic != ns)
+      si[ns] = si[ic];
 
-         if(printall == 0)
+   test = 1;
+   if(use_all == 0)
+      {
+      last = -1;
+      i = hhead[namehash(si[ns].name)];
+      while(i >= 0)
+         {
+         if(i > last && strcmp(si[i].name,si[ns].name) == 0)
 	    {
-            if(si[ns].ix >= xbnd && si[ns].ix < nx-xbnd && si[ns].iy >= ybnd && si[ns].iy < ny-ybnd)
-               ns++;
+	    if(si[i].lon == si[ns].lon && si[i].lat == si[ns].lat)
+	       {
+	       test = 0;
+	       fprintf(stderr,"Station '%s' duplicated, only first occurrence used\n",si[ns].name);
+	       }
+	    else
+	       {
+	       fprintf(stderr,"Different location for '%s', check output\n",si[ns].name);
+	       strcat(si[ns].name,"X");
+
+	       /* carry on with the later stations, now under the new name */
+	       last = i;
+	       i = hhead[namehash(si[ns].name)];
+	       continue;
+	       }
 	    }
-         else
-	    ns++;
+         i = hnext[i];
          }
       }
+
+   if(test)
+      {
+      if(printall == 0)
+         {
+         if(si[ns].ix < xbnd || si[ns].ix >= nx-xbnd || si[ns].iy < ybnd || si[ns].iy >= ny-ybnd)
+            test = 0;
+         }
+      }
+
+   if(test)
+      {
+      ih = namehash(si[ns].name);
+      hnext[ns] = -1;
+      if(hhead[ih] < 0)
+         hhead[ih] = ns;
+      else
+         hnext[htail[ih]] = ns;
+      htail[ih] = ns;
+
+      ns++;
+      }
    }
-fclose(fp);
+
+free(hhead);
+free(htail);
+free(hnext);
 
 fp = fopfile(outfile,"w");
 
@@ -261,7 +346,7 @@ r = atan((1.0 - (1.0/FLAT_CONST))*tan(x));
 return(r);
 }
 
-set_g2X(g2,fc)
+void set_g2X(g2,fc)
 float *g2, *fc;
 {
 float f;
@@ -270,7 +355,7 @@ f = (1.0)/(*fc);
 *g2 = ((2.0)*f - f*f)/(((1.0) - f)*((1.0) - f));
 }
 
-latlon2kmX(arg,latkm,lonkm,rc,g2)
+void latlon2kmX(arg,latkm,lonkm,rc,g2)
 float *arg, *latkm, *lonkm, *rc, *g2;
 {
 float cosA, sinA, g2s2, den;
@@ -296,6 +381,32 @@ if((fp = fopen(name,mode)) == NULL)
 return(fp);
 }
 
+unsigned int namehash(char *name)
+{
+unsigned int h = 2166136261u;
+
+while(*name != '\0')
+   {
+   h = (h ^ (unsigned char)(*name)) * 16777619u;
+   name++;
+   }
+
+return(h & (NHASH-1));
+}
+
+void *check_realloc(void *ptr,size_t len)
+{
+ptr = (char *) realloc (ptr,len);
+
+if(ptr == NULL)
+   {
+   fprintf(stderr,"*****  memory allocation error\n");
+   exit(-1);
+   }
+
+return(ptr);
+}
+
 void *check_malloc(size_t len)
 {
 char *ptr;
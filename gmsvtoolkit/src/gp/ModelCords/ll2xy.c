@@ -6,6 +6,7 @@
 #define         RPERD           0.017453292
 #define         FONE            (float)(1.0)
 #define         FTWO            (float)(2.0)
+#define         NBATCH          4096
 
 void *check_malloc(size_t);
 void *check_realloc(void *ptr,size_t len);
@@ -21,9 +22,10 @@ int main(int ac,char **av)
 {
 FILE *fopfile(), *fpw, *fpr;
 float mlat, mlon, xazim;
-float kperd_n, kperd_e, xs, ys, plon, plat;
-int i, mn, ns, nx, ny, test;
-float cosR, sinR, xr, yr;
+float kperd_n, kperd_e, xs, ys, *plon, *plat;
+int i, mn, ns, nx, ny, test, np, eof;
+float cosR, sinR, *xr, *yr;
+char (*line)[512];
 
 float xlen = 100.0;
 float ylen = 100.0;
@@ -147,63 +149,92 @@ if(strcmp(infile,"stdin") == 0)
 else
    fpr = fopfile(infile,"r");
 
-while(fgets(str,512,fpr) != NULL)
-   {
-   ns = sscanf(str,"%f %f %s",&plon,&plat,name);
+plon = (float *) check_malloc (NBATCH*sizeof(float));
+plat = (float *) check_malloc (NBATCH*sizeof(float));
+xr = (float *) check_malloc (NBATCH*sizeof(float));
+yr = (float *) check_malloc (NBATCH*sizeof(float));
+line = (char (*)[512]) check_malloc (NBATCH*sizeof(char[512]));
 
-   if(geoproj == 0)
+/*
+   Points are read and projected NBATCH at a time.  A line that can not
+   be read keeps the lon, lat of the line before it, as it always has.
+*/
+
+plon[NBATCH-1] = plat[NBATCH-1] = 0.0;
+eof = 0;
+while(eof == 0)
+   {
+   np = 0;
+   while(np < NBATCH && fgets(line[np],512,fpr) != NULL)
       {
-      xs = (plon - mlon)*kperd_e;
-      ys = (mlat - plat)*kperd_n;
+      if(np > 0)
+         {
+         plon[np] = plon[np-1];
+         plat[np] = plat[np-1];
+         }
+      else
+         {
+         plon[0] = plon[NBATCH-1];
+         plat[0] = plat[NBATCH-1];
+         }
 
-      xr = xs*cosR + ys*sinR - xshift;
-      yr = -xs*sinR + ys*cosR - yshift;
+      sscanf(line[np],"%f %f %s",&plon[np],&plat[np],name);
+      np++;
       }
+   if(np < NBATCH)
+      eof = 1;
+
+   if(geoproj == 0)
+      ll2km_batch(plon,plat,xr,yr,np,mlon,mlat,kperd_e,kperd_n,cosR,sinR,xshift,yshift);
    else if(geoproj == 1)
-      {
-      gcproj(&xr,&yr,&plon,&plat,&erad,&g0,&b0,amat,ainv,ll2xy);
-      }
+      gcproj_batch(xr,yr,plon,plat,np,&erad,&g0,&b0,amat,ainv,ll2xy);
    else if(geoproj == 2)
       {
-      dlon = plon;
-      dlat = plat;
-      geoutm_(&dlon,&dlat,&dxr,&dyr,&utm_zone,&geo2utm);
+      for(i=0;i<np;i++)
+         {
+         dlon = plon[i];
+         dlat = plat[i];
+         geoutm_(&dlon,&dlat,&dxr,&dyr,&utm_zone,&geo2utm);
 
-      xs = 0.001*(dxr - xr0);
-      ys = 0.001*(yr0 - dyr);
+         xs = 0.001*(dxr - xr0);
+         ys = 0.001*(yr0 - dyr);
 
-      xr = xs*cosR + ys*sinR - xshift;
-      yr = -xs*sinR + ys*cosR - yshift;
+         xr[i] = xs*cosR + ys*sinR - xshift;
+         yr[i] = -xs*sinR + ys*cosR - yshift;
+         }
       }
 
-/*
-   if(ns == 3)
-      fprintf(fpw,"%14.6e %14.6e %s\n",xr,yr,name);
-   else if(ns == 2)
-      fprintf(fpw,"%14.6e %14.6e\n",xr,yr);
-*/
-   ns = 0;
-   while(str[ns] == ' ' || str[ns] == '\t')
-      ns++;
-
-   test = 0;
-   while(test != 2 && str[ns] != '\n')
+   for(i=0;i<np;i++)
       {
-      if(str[ns] == ' ' || str[ns] == '\t' || str[ns] == '\n')
+      ns = 0;
+      while(line[i][ns] == ' ' || line[i][ns] == '\t')
+         ns++;
+
+      test = 0;
+      while(test != 2 && line[i][ns] != '\n')
          {
-         test++;
-	 if(test != 2)
-	    {
-            ns++;
-            while(str[ns] == ' ' || str[ns] == '\t')
+         if(line[i][ns] == ' ' || line[i][ns] == '\t' || line[i][ns] == '\n')
+            {
+            test++;
+	    if(test != 2)
+	       {
                ns++;
+               while(line[i][ns] == ' ' || line[i][ns] == '\t')
+                  ns++;
+	       }
 	    }
-	 }
-      else
-         ns++;
+         else
+            ns++;
+         }
+
+      fprintf(fpw,"%14.6e %14.6e%s",xr[i],yr[i],&line[i][ns]);
       }
 
-   fprintf(fpw,"%14.6e %14.6e%s",xr,yr,&str[ns]);
+   if(np > 0)
+      {
+      plon[NBATCH-1] = plon[np-1];
+      plat[NBATCH-1] = plat[np-1];
+      }
    }
 fclose(fpr);
 fclose(fpw);
@@ -1,16 +1,175 @@
 #include "include.h"
+#include "getpar.h"
 
-main(ac,av)
+#define         NBLOCK          262144     /* input lines classified at once */
+#define         MAXBIN          1048576
+
+/*
+   The lines of infile whose lon lat are inside (or on) the polygon of
+   edgefile are copied to outfile.  The edges are sorted into nbin
+   latitude bands, each edge listed in every band its latitude range
+   touches, so a point is tested against the few edges of its band
+   rather than the whole polygon.  Points are read in blocks of NBLOCK
+   lines and nthreads= OpenMP threads classify a block; the lines are
+   written in input order.
+*/
+
+struct edgebins
+   {
+   int nbin;
+   float ymin, ymax, scale;
+   int *start;          /* edges of band k: e[4*start[k] .. 4*start[k+1]-1] */
+   float *e;            /* x1 y1 x2 y2 of each listed edge */
+   };
+
+void *check_malloc(size_t);
+void *check_realloc(void *,size_t);
+FILE *fopfile(char*, char*);
+
+static inline int edge_band(struct edgebins *eb,float y)
+{
+int k;
+
+k = (int)((y - eb->ymin)*eb->scale);
+if(k < 0)
+   k = 0;
+if(k > eb->nbin-1)
+   k = eb->nbin-1;
+return(k);
+}
+
+void edgebins_build(struct edgebins *eb,float *xv,float *yv,int nv)
+{
+float x1, y1, x2, y2, lo, hi;
+int i, k, k0, k1, *fill;
+
+eb->ymin = yv[0];
+eb->ymax = yv[0];
+for(i=1;i<nv;i++)
+   {
+   if(yv[i] < eb->ymin)
+      eb->ymin = yv[i];
+   if(yv[i] > eb->ymax)
+      eb->ymax = yv[i];
+   }
+
+eb->nbin = nv;
+if(eb->nbin > MAXBIN)
+   eb->nbin = MAXBIN;
+if(eb->ymax > eb->ymin)
+   eb->scale = eb->nbin/(eb->ymax - eb->ymin);
+else
+   {
+   eb->nbin = 1;
+   eb->scale = 0.0;
+   }
+
+eb->start = (int *) check_malloc((eb->nbin+1)*sizeof(int));
+fill = (int *) check_malloc((eb->nbin+1)*sizeof(int));
+for(k=0;k<=eb->nbin;k++)
+   eb->start[k] = 0;
+
+/* two passes, counting and then filling the bands */
+
+for(i=0;i<nv;i++)
+   {
+   y1 = yv[(i+nv-1)%nv];
+   y2 = yv[i];
+   lo = (y1 < y2) ? y1 : y2;
+   hi = (y1 < y2) ? y2 : y1;
+
+   k1 = edge_band(eb,hi);
+   for(k=edge_band(eb,lo);k<=k1;k++)
+      eb->start[k+1]++;
+   }
+
+for(k=0;k<eb->nbin;k++)
+   {
+   eb->start[k+1] = eb->start[k+1] + eb->start[k];
+   fill[k] = eb->start[k];
+   }
+
+eb->e = (float *) check_malloc((4*(size_t)(eb->start[eb->nbin])+1)*sizeof(float));
+
+for(i=0;i<nv;i++)
+   {
+   x1 = xv[(i+nv-1)%nv];
+   y1 = yv[(i+nv-1)%nv];
+   x2 = xv[i];
+   y2 = yv[i];
+   lo = (y1 < y2) ? y1 : y2;
+   hi = (y1 < y2) ? y2 : y1;
+
+   k0 = edge_band(eb,lo);
+   k1 = edge_band(eb,hi);
+   for(k=k0;k<=k1;k++)
+      {
+      eb->e[4*fill[k]]   = x1;
+      eb->e[4*fill[k]+1] = y1;
+      eb->e[4*fill[k]+2] = x2;
+      eb->e[4*fill[k]+3] = y2;
+      fill[k]++;
+      }
+   }
+
+free(fill);
+}
+
+/*
+   Same crossing test as the per-edge loop over the whole polygon: 1 if
+   (xp,yp) is on an edge or has an odd number of crossings to its right.
+   Only the edges of the point's band can cross its latitude, and the
+   result does not depend on the order they are tested in.
+*/
+int inside(float xp,float yp,struct edgebins *eb)
+{
+float x1, y1, x2, y2, xx, *ep;
+int i, k, nleft;
+
+if(!(yp >= eb->ymin && yp <= eb->ymax))
+   return(0);
+
+k = edge_band(eb,yp);
+nleft = 0;
+for(i=eb->start[k];i<eb->start[k+1];i++)
+   {
+   ep = eb->e + 4*i;
+   x1 = ep[0];
+   y1 = ep[1];
+   x2 = ep[2];
+   y2 = ep[3];
+
+   if(y1 == yp && y2 == yp)
+      {
+      if((x1 < xp && x2 >= xp) || (x2 < xp && x1 >= xp))
+         return(1);
+      }
+   else if((y1 < yp && y2 >= yp) || (y2 < yp && y1 >= yp))
+      {
+      xx = x1 + (yp-y1)*(x2-x1)/(y2-y1);
+      if(xx == xp)
+         return(1);
+      else if(xx > xp)
+         nleft++;
+      }
+   }
+
+return(nleft%2);
+}
+
+int main(ac,av)
 int ac;
 char **av;
 {
 FILE *fpw, *fpr, *fopfile();
-float lonp, latp;
-int nx, ny, npts, i, j, ix, iy;
-int jp, ip, nedge;
-char string[512], infile[512], outfile[512];
-char edgefile[512];
-float elat[5000], elon[5000];
+struct edgebins eb;
+float lonp, latp, *plon, *plat, *elat, *elon;
+int i, n, nedge, nalloc, eof;
+char string[512], infile[512], outfile[512], *flag;
+char edgefile[512], *lines;
+size_t len, nchar, *off;
+
+int nthreads = 1;
 
 sprintf(infile,"stdin");
 sprintf(outfile,"stdout");
@@ -19,17 +178,39 @@ setpar(ac,av);
 getpar("infile","s",infile);
 getpar("outfile","s",outfile);
 mstpar("edgefile","s",edgefile);
+getpar("nthreads","d",&nthreads);
 endpar();
 
 fpr = fopfile(edgefile,"r");
 
+elon = NULL;
+elat = NULL;
+nalloc = 0;
 i = 0;
-while(fscanf(fpr,"%f %f",&elon[i],&elat[i]) != EOF)
+while(1)
+   {
+   if(i == nalloc)
+      {
+      nalloc = nalloc + 8192;
+      elon = (float *) check_realloc(elon,nalloc*sizeof(float));
+      elat = (float *) check_realloc(elat,nalloc*sizeof(float));
+      }
+   if(fscanf(fpr,"%f %f",&elon[i],&elat[i]) != 2)
+      break;
    i++;
+   }
 
 fclose(fpr);
 nedge = i;
 
+if(nedge < 1)
+   {
+   fprintf(stderr,"*** no vertices in %s, exiting...\n",edgefile);
+   exit(-1);
+   }
+
+edgebins_build(&eb,elon,elat,nedge);
+
 if(strcmp(infile,"stdin") == 0)
    fpr = stdin;
 else
@@ -40,57 +221,62 @@ if(strcmp(outfile,"stdout") == 0)
 else
    fpw = fopfile(outfile,"w");
 
-while(fgets(string,512,fpr) != NULL)
-   {
-   sscanf(string,"%f %f",&lonp,&latp);
+plon = (float *) check_malloc(NBLOCK*sizeof(float));
+plat = (float *) check_malloc(NBLOCK*sizeof(float));
+flag = (char *) check_malloc(NBLOCK*sizeof(char));
+off = (size_t *) check_malloc((NBLOCK+1)*sizeof(size_t));
 
-   if(inside(&lonp,&latp,elon,elat,nedge) == 1)
-      fprintf(fpw,"%s",string);
-   }
-fclose(fpr);
-fclose(fpw);
-}
+nalloc = 64*NBLOCK;
+lines = (char *) check_malloc(nalloc*sizeof(char));
 
-inside(xp,yp,xv,yv,nv)
-float *xp, *yp, *xv, *yv;
-int nv;
-{
-float x1, y1, x2, y2, xx;
-int i, flag;
-int nleft = 0;
+/* a line that does not parse keeps the lon lat of the line before */
+lonp = 0.0;
+latp = 0.0;
 
-x2 = xv[nv-1];
-y2 = yv[nv-1];
-for(i=0;i<nv;i++)
+eof = 0;
+while(eof == 0)
    {
-   x1 = x2;
-   y1 = y2;
-   x2 = xv[i];
-   y2 = yv[i];
-
-   if(y1 == (*yp) && y2 == (*yp))
+   n = 0;
+   nchar = 0;
+   while(n < NBLOCK)
       {
-      if((x1 < (*xp) && x2 >= (*xp)) || (x2 < (*xp) && x1 >= (*yp)))
-         return(1);
+      if(fgets(string,512,fpr) == NULL)
+         {
+         eof = 1;
+         break;
+         }
+
+      sscanf(string,"%f %f",&lonp,&latp);
+      plon[n] = lonp;
+      plat[n] = latp;
+
+      len = strlen(string);
+      if(nchar + len + 1 > nalloc)
+         {
+         nalloc = 2*nalloc;
+         lines = (char *) check_realloc(lines,nalloc*sizeof(char));
+         }
+      memcpy(lines+nchar,string,len+1);
+      off[n] = nchar;
+      nchar = nchar + len + 1;
+      n++;
       }
-   else if((y1 < (*yp) && y2 >= (*yp)) || (y2 < (*yp) && y1 >= (*yp)))
+
+#pragma omp parallel for num_threads(nthreads) schedule(static,4096)
+   for(i=0;i<n;i++)
+      flag[i] = inside(plon[i],plat[i],&eb);
+
+   for(i=0;i<n;i++)
       {
-      xx = x1 + ((*yp)-y1)*(x2-x1)/(y2-y1);
-      if(xx == (*xp))
-         return(1);
-      else if(xx > (*xp))
-         nleft++;
+      if(flag[i] == 1)
+         fputs(lines+off[i],fpw);
       }
    }
 
-if(nleft == 0)
-   flag = 0;
-else
-   flag = nleft%2;
-
-return(flag);
+fclose(fpr);
+fclose(fpw);
 }
- 
+
 FILE *fopfile(name,mode)
 char *name, *mode;
 {
@@ -103,3 +289,31 @@ if((fp = fopen(name,mode)) == NULL)
    }
 return(fp);
 }
+
+void *check_realloc(void *ptr,size_t len)
+{
+ptr = (char *) realloc (ptr,len);
+
+if(ptr == NULL)
+   {
+   fprintf(stderr,"*****  memory allocation error\n");
+   exit(-1);
+   }
+
+return(ptr);
+}
+
+void *check_malloc(size_t len)
+{
+char *ptr;
+
+ptr = (char *) malloc (len);
+
+if(ptr == NULL)
+   {
+   fprintf(stderr,"*****  memory allocation error\n");
+   exit(-1);
+   }
+
+return(ptr);
+}
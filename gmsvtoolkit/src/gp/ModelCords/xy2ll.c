@@ -6,6 +6,7 @@
 #define         RPERD           0.017453292
 #define         FONE            (float)(1.0)
 #define         FTWO            (float)(2.0)
+#define         NBATCH          4096
 
 void *check_malloc(int);
 FILE *fopfile(char*, char*);
@@ -21,15 +22,15 @@ int main(int ac,char **av)
 FILE *fopfile(), *fpr, *fpw;
 float mlat, mlon, xazim, mrot;
 float kperd_n, kperd_e, ar1, ar2, ar3, ar4;
-float xp, yp, plon, plat;
+float *xp, *yp, *plon, *plat, ar[4];
 float cosR, sinR;
-int nr;
+int *nr, i, np, eof;
 
 float xlen = 100.0;
 float ylen = 100.0;
 
 char infile[512], outfile[512], str[512];
-char name[16];
+char (*name)[16];
 
 float rperd = RPERD;
 float erad = ERAD;
@@ -107,10 +108,10 @@ if(geoproj == 0)
    geocen(&latavg,(double)(latavg*rperd));
    latlon2km(&latavg,&kperd_n,&kperd_e,&radc,&g2);
 
-   ar1 = cosR/kperd_e;
-   ar2 = sinR/kperd_e;
-   ar3 = cosR/kperd_n;
-   ar4 = sinR/kperd_n;
+   ar[0] = ar1 = cosR/kperd_e;
+   ar[1] = ar2 = sinR/kperd_e;
+   ar[2] = ar3 = cosR/kperd_n;
+   ar[3] = ar4 = sinR/kperd_n;
    }
 else if(geoproj == 1)
    {
@@ -130,7 +131,12 @@ else if(geoproj == 2)
    fprintf(stderr,"UTM Zone= %d xr0= %13.5e yr0= %13.5e\n",utm_zone,xr0,yr0);
    }
 
-name[0] = '\0';
+xp = (float *) check_malloc (NBATCH*sizeof(float));
+yp = (float *) check_malloc (NBATCH*sizeof(float));
+plon = (float *) check_malloc (NBATCH*sizeof(float));
+plat = (float *) check_malloc (NBATCH*sizeof(float));
+nr = (int *) check_malloc (NBATCH*sizeof(int));
+name = (char (*)[16]) check_malloc (NBATCH*sizeof(char[16]));
 
 if(strcmp(outfile,"stdout") == 0)
    fpw = stdout;
@@ -142,40 +148,47 @@ if(strcmp(infile,"stdin") == 0)
 else
    fpr = fopfile(infile,"r");
 
-while(fgets(str,512,fpr) != NULL)
+/* points are read and projected NBATCH at a time */
+
+eof = 0;
+while(eof == 0)
    {
-   nr = sscanf(str,"%f %f %s",&xp,&yp,name);
+   np = 0;
+   while(np < NBATCH && fgets(str,512,fpr) != NULL)
+      {
+      xp[np] = yp[np] = 0.0;
+      name[np][0] = '\0';
+      nr[np] = sscanf(str,"%f %f %15s",&xp[np],&yp[np],name[np]);
+      np++;
+      }
+   if(np < NBATCH)
+      eof = 1;
 
       if(geoproj == 0)
-         {
-         plon = mlon + (xp+xshift)*ar1 - (yp+yshift)*ar2;
-         plat = mlat - (xp+xshift)*ar4 - (yp+yshift)*ar3;
-         }
+         km2ll_batch(xp,yp,plon,plat,np,mlon,mlat,ar,xshift,yshift);
       else if(geoproj == 1)
-         {
-         gcproj(&xp,&yp,&plon,&plat,&erad,&g0,&b0,amat,ainv,xy2ll);
-         }
+         gcproj_batch(xp,yp,plon,plat,np,&erad,&g0,&b0,amat,ainv,xy2ll);
       else if(geoproj == 2)
          {
-         dxr = xr0 + 1000.0*((xp+xshift)*cosR - (yp+yshift)*sinR);
-         dyr = yr0 - 1000.0*((xp+xshift)*sinR + (yp+yshift)*cosR);
-         geoutm_(&dlon,&dlat,&dxr,&dyr,&utm_zone,&utm2geo);
-
-	 /*
-         dxr = xp;
-         dyr = yp;
-         geoutm_(&dlon,&dlat,&dxr,&dyr,&utm_zone,&utm2geo);
-	 */
-
-         plon = dlon;
-         plat = dlat;
+	 for(i=0;i<np;i++)
+	    {
+            dxr = xr0 + 1000.0*((xp[i]+xshift)*cosR - (yp[i]+yshift)*sinR);
+            dyr = yr0 - 1000.0*((xp[i]+xshift)*sinR + (yp[i]+yshift)*cosR);
+            geoutm_(&dlon,&dlat,&dxr,&dyr,&utm_zone,&utm2geo);
+
+            plon[i] = dlon;
+            plat[i] = dlat;
+	    }
          }
 
-   if(nr == 3)
-      fprintf(fpw,"%12.6f %12.6f %s\n",plon,plat,name);
+   for(i=0;i<np;i++)
+      {
+      if(nr[i] == 3)
+         fprintf(fpw,"%12.6f %12.6f %s\n",plon[i],plat[i],name[i]);
 
-   if(nr == 2)
-      fprintf(fpw,"%12.6f %12.6f\n",plon,plat);
+      if(nr[i] == 2)
+         fprintf(fpw,"%12.6f %12.6f\n",plon[i],plat[i]);
+      }
    }
 
 fclose(fpr);
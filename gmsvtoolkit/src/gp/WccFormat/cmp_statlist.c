@@ -1,72 +1,200 @@
+/**********************************************************************/
+/*                                                                    */
+/*           cmp_statlist                                             */
+/*                                                                    */
+/*           Reports the stations found in more than one of the       */
+/*           files of filelist= (station lists: the number of         */
+/*           stations, then one seisheader per station), as           */
+/*                                                                    */
+/*              STAT= name, FILES i and j                             */
+/*                                                                    */
+/*           for files i < j (counted from 0), once for each pair of  */
+/*           entries with that name, on stderr.                       */
+/*                                                                    */
+/*           Each file's names go into a hash table, so a pair of     */
+/*           files takes time linear in their lengths; nthreads=      */
+/*           OpenMP threads share out the files, and the report is    */
+/*           in the same order as for one thread.                     */
+/*                                                                    */
+/**********************************************************************/
+
 #include        "include.h"
 #include        "structure.h"
 #include        "function.h"
+#include        "getpar.h"
+
+#define         MAXFILES        10000
 
 int size_float = sizeof(float);
 float float_swap(char *);
 
-main(int ac, char **av)
+struct namehash         /* the names of one file, open addressing */
+   {
+   int n;               /* number of names */
+   char *name;          /* n names, STATCHAR apart */
+   int nslot;           /* power of 2, at least twice n */
+   int *first;          /* slot -> index of the name, -1 if empty */
+   int *count;          /* slot -> number of entries with that name */
+   };
+
+unsigned int name_hash(char *s)
+{
+unsigned int h = 2166136261u;
+int i;
+
+for(i=0;i<STATCHAR && s[i] != '\0';i++)
+   h = (h ^ (unsigned char)(s[i]))*16777619u;
+return(h);
+}
+
+void namehash_build(struct namehash *nh)
+{
+unsigned int h;
+int i, k;
+
+nh->nslot = 16;
+while(nh->nslot < 2*nh->n)
+   nh->nslot = 2*nh->nslot;
+
+nh->first = (int *) check_malloc(nh->nslot*sizeof(int));
+nh->count = (int *) check_malloc(nh->nslot*sizeof(int));
+for(k=0;k<nh->nslot;k++)
+   {
+   nh->first[k] = -1;
+   nh->count[k] = 0;
+   }
+
+for(i=0;i<nh->n;i++)
+   {
+   h = name_hash(nh->name+i*STATCHAR) & (nh->nslot-1);
+   while(nh->first[h] >= 0 && strcmp(nh->name+nh->first[h]*STATCHAR,nh->name+i*STATCHAR) != 0)
+      h = (h+1) & (nh->nslot-1);
+
+   if(nh->first[h] < 0)
+      nh->first[h] = i;
+   nh->count[h]++;
+   }
+}
+
+/* number of entries of nh named s */
+int namehash_count(struct namehash *nh,char *s)
+{
+unsigned int h;
+
+h = name_hash(s) & (nh->nslot-1);
+while(nh->first[h] >= 0)
+   {
+   if(strcmp(nh->name+nh->first[h]*STATCHAR,s) == 0)
+      return(nh->count[h]);
+   h = (h+1) & (nh->nslot-1);
+   }
+return(0);
+}
+
+/* appends a line to the growing buffer *buf (length *len, space *nalloc) */
+void buf_line(char **buf,size_t *len,size_t *nalloc,char *line)
+{
+size_t n;
+
+n = strlen(line);
+if(*len + n + 1 > *nalloc)
+   {
+   *nalloc = 2*(*nalloc) + n + 1024;
+   *buf = (char *) check_realloc(*buf,*nalloc);
+   }
+memcpy(*buf + *len,line,n+1);
+*len = *len + n;
+}
+
+int main(int ac, char **av)
 {
 FILE *fpr, *fopfile();
-struct seisheader seishead;
-int fd, i, j, k, n, ngf[10000], nfile;
+struct seisheader *seishead;
+struct namehash *nh;
+int fd, i, j, k, n, nfile;
+char **rep, line[256];
 
 int swap_bytes = 0;
+int nthreads = 1;
 
 char infile[128];
 char filelist[128];
-char *sptr1, *sptr2, *statlist[10000];
 
 setpar(ac, av);
 mstpar("filelist","s",filelist);
 getpar("swap_bytes","d",&swap_bytes);
+getpar("nthreads","d",&nthreads);
 endpar();
 
+nh = (struct namehash *) check_malloc(MAXFILES*sizeof(struct namehash));
+
 fpr = fopfile(filelist,"r");
 
 j = 0;
-while(fscanf(fpr,"%s",infile) != EOF)
+while(j < MAXFILES && fscanf(fpr,"%s",infile) != EOF)
    {
    fd = opfile_ro(infile);
 
-   reed(fd,&ngf[j],sizeof(int));
+   reed(fd,&nh[j].n,sizeof(int));
    if(swap_bytes)
-      swap_in_place(1,(char *)(&ngf[j]));
+      swap_in_place(1,(char *)(&nh[j].n));
 
-   statlist[j] = check_malloc (ngf[j]*STATCHAR*sizeof(char));
-   sptr1 = statlist[j];
+   seishead = (struct seisheader *) check_malloc(nh[j].n*sizeof(struct seisheader)+1);
+   reed(fd,seishead,nh[j].n*sizeof(struct seisheader));
 
-   for(i=0;i<ngf[j];i++)
+   nh[j].name = (char *) check_malloc (nh[j].n*STATCHAR*sizeof(char)+1);
+   for(i=0;i<nh[j].n;i++)
       {
-      reed(fd,&seishead,sizeof(struct seisheader));
-      strcpy(sptr1+i*STATCHAR,seishead.name);
+      strncpy(nh[j].name+i*STATCHAR,seishead[i].name,FD_STATCHAR);
+      nh[j].name[i*STATCHAR+FD_STATCHAR] = '\0';
       }
 
+   free(seishead);
    close(fd);
    j++;
    }
+fclose(fpr);
 
 nfile = j;
 
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic,1)
+for(i=0;i<nfile;i++)
+   namehash_build(&nh[i]);
+
+/* the report of file i against the later files, made in parallel */
+
+rep = (char **) check_malloc((nfile+1)*sizeof(char *));
+
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic,1) private(j,k,n,line)
 for(i=0;i<nfile;i++)
    {
-   sptr1 = statlist[i];
-   fprintf(stderr,"file %d of %d\n",i+1,nfile);
+   size_t len = 0;
+   size_t nalloc = 0;
+   char *sp;
+
+   rep[i] = NULL;
+   sprintf(line,"file %d of %d\n",i+1,nfile);
+   buf_line(&rep[i],&len,&nalloc,line);
+
    for(j=i+1;j<nfile;j++)
       {
-      sptr2 = statlist[j];
-
-      for(k=0;k<ngf[i];k++)
+      for(k=0;k<nh[i].n;k++)
          {
-         for(n=0;n<ngf[j];n++)
+         sp = nh[i].name+k*STATCHAR;
+         for(n=namehash_count(&nh[j],sp);n>0;n--)
             {
-	    if(strcmp(sptr1+k*STATCHAR,sptr2+n*STATCHAR) == 0)
-	       fprintf(stderr,"STAT= %s, FILES %d and %d\n",sptr1+k*STATCHAR,i,j);
-	    }
-	 }
-
+            sprintf(line,"STAT= %s, FILES %d and %d\n",sp,i,j);
+            buf_line(&rep[i],&len,&nalloc,line);
+            }
+         }
       }
    }
+
+for(i=0;i<nfile;i++)
+   {
+   fputs(rep[i],stderr);
+   free(rep[i]);
+   }
 }
 
 long long_swap(char *cbuf)
@@ -100,21 +228,3 @@ f_union.cval[0] = cbuf[3];
 
 return(f_union.fval);
 }
-
-void swap_in_place(int n,char *cbuf)
-{
-char cv;
-
-while(n--)
-   {
-   cv = cbuf[0];
-   cbuf[0] = cbuf[3];
-   cbuf[3] = cv;
-
-   cv = cbuf[1];
-   cbuf[1] = cbuf[2];
-   cbuf[2] = cv;
-
-   cbuf = cbuf + 4;
-   }
-}
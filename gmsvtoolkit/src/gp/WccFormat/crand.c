@@ -0,0 +1,97 @@
+#include "include.h"
+#include "structure.h"
+#include "function.h"
+
+/*
+   Random numbers for the perturbations of vango_wcc, wcc_addrand and
+   wcc_add, uniform in -1.0 -> 1.0, that can be drawn from any number
+   of threads and still give the numbers of a serial run.
+
+   crand_lcg(&state) is sfrand(), the linear congruential generator the
+   tools always used, and crand_lcg_skip(state,n) the state after n
+   calls of it (jump ahead in log2(n) steps).  A loop of draws split
+   over threads starts each block at crand_lcg_skip(seed,first) and
+   gets the numbers (and the outputs) of the serial loop.
+
+   crand_philox(seed,n) is the n-th number of the counter-based stream
+   of seed (Philox4x32-10, Salmon et al. 2011): it only depends on seed
+   and n, so the draws need no order at all.
+*/
+
+#define LCG_MULT        1103515245
+#define LCG_ADD         12345
+#define LCG_MASK        0x7fffffff
+
+#define PHILOX_M0       0xD2511F53
+#define PHILOX_M1       0xCD9E8D57
+#define PHILOX_W0       0x9E3779B9
+#define PHILOX_W1       0xBB67AE85
+#define PHILOX_ROUNDS   10
+
+double crand_lcg(long *state)
+{
+*state = ((*state) * LCG_MULT + LCG_ADD) & LCG_MASK;
+return((double)(*state)/1073741824.0 - 1.0);
+}
+
+long crand_lcg_skip(long state,long long n)
+{
+unsigned long long am, cm, ar, cr;
+
+if(n <= 0)
+   return(state);
+
+/* n steps of s -> (am*s + cm) & mask, composed by squaring */
+am = LCG_MULT;
+cm = LCG_ADD;
+ar = 1;
+cr = 0;
+while(n > 0)
+   {
+   if(n & 1)
+      {
+      ar = (ar*am) & LCG_MASK;
+      cr = (cr*am + cm) & LCG_MASK;
+      }
+   cm = ((am + 1)*cm) & LCG_MASK;
+   am = (am*am) & LCG_MASK;
+   n = n >> 1;
+   }
+
+/* only the low 31 bits of the state go into the next one */
+return((long)((ar*((unsigned long long)(state) & LCG_MASK) + cr) & LCG_MASK));
+}
+
+double crand_philox(long seed,long long n)
+{
+unsigned int c0, c1, c2, c3, k0, k1, t0, t1;
+unsigned long long p0, p1;
+int r;
+
+c0 = (unsigned int)((unsigned long long)(n));
+c1 = (unsigned int)((unsigned long long)(n) >> 32);
+c2 = 0;
+c3 = 0;
+k0 = (unsigned int)((unsigned long long)(seed));
+k1 = (unsigned int)((unsigned long long)(seed) >> 32);
+
+for(r=0;r<PHILOX_ROUNDS;r++)
+   {
+   if(r > 0)
+      {
+      k0 = k0 + PHILOX_W0;
+      k1 = k1 + PHILOX_W1;
+      }
+
+   p0 = (unsigned long long)(PHILOX_M0)*c0;
+   p1 = (unsigned long long)(PHILOX_M1)*c2;
+   t0 = (unsigned int)(p1 >> 32) ^ c1 ^ k0;
+   t1 = (unsigned int)(p0 >> 32) ^ c3 ^ k1;
+   c1 = (unsigned int)(p1);
+   c3 = (unsigned int)(p0);
+   c0 = t0;
+   c2 = t1;
+   }
+
+return((double)(c0)/2147483648.0 - 1.0);
+}
@@ -14,3 +14,18 @@
 #define CROPTR_FLAGS    O_CREAT | O_TRUNC | O_RDWR | O_LARGEFILE
 
 #endif
+
+/*
+   SIMD_CLONES in front of a function builds it for AVX-512, AVX2,
+   SSE4.2 and baseline x86-64, and the loader (ifunc) picks the variant
+   for the CPU it runs on, so one binary gets the widest vectors of
+   each node.  Contraction to FMA is off in all of them (AVX-512F has
+   its own FMA), so they round as the baseline code does.  It is empty when the build already
+   targets AVX2 (-march=native etc.), off x86-64 (NEON is the aarch64
+   baseline) and with -DNO_SIMD_CLONES.
+*/
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__) && defined(__ELF__) && !defined(__AVX2__) && !defined(NO_SIMD_CLONES)
+#define SIMD_CLONES __attribute__((target_clones("avx512f","avx2","sse4.2","default"),optimize("fp-contract=off")))
+#else
+#define SIMD_CLONES
+#endif
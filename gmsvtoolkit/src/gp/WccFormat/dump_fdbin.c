@@ -72,10 +72,7 @@ while(i<ngf)
 
 s = (float *)check_malloc(3*ngf*seishead.nt*sizeof(float));
 
-reed(fd,s,3*ngf*seishead.nt*sizeof(float));
-
-if(swap_bytes)
-   swap_in_place(3*ngf*seishead.nt,(char *)(s));
+reed_swap(fd,s,3*ngf*seishead.nt*sizeof(float),swap_bytes);
 
 for(i=1;i<3*ngf*seishead.nt;i=i+3)
    fprintf(fpr,"%13.5e\n",s[i]);
@@ -114,21 +111,3 @@ f_union.cval[0] = cbuf[3];
 
 return(f_union.fval);
 }
-
-void swap_in_place(int n,char *cbuf)
-{
-char cv;
-
-while(n--)
-   {
-   cv = cbuf[0];
-   cbuf[0] = cbuf[3];
-   cbuf[3] = cv;
-
-   cv = cbuf[1];
-   cbuf[1] = cbuf[2];
-   cbuf[2] = cv;
-
-   cbuf = cbuf + 4;
-   }
-}
@@ -1,11 +1,41 @@
 #include        "include.h"
 #include        "structure.h"
 #include        "function.h"
+#include        "getpar.h"
 
 int size_float = sizeof(float);
 float float_swap(char *);
 
-main(int ac, char **av)
+#define         FD_NHASH        65536
+#define         FD_BLKBYTES     (64*1048576)
+
+struct fdindex     /* one station of the FD seismogram files */
+   {
+   struct seisheader sh;
+   int file;       /* index in the filelist */
+   int ngf;        /* number of stations in that file */
+   int i;          /* position of the station in that file */
+   int hnext;      /* next entry in the same hash chain */
+   };
+
+struct fdrequest   /* one trace to extract in batch mode */
+   {
+   struct fdindex *fi;
+   struct statdata shead;
+   char outfile[512];
+   int tskip;      /* first time step read from the file */
+   int itshft;     /* first sample of s filled from the file */
+   int itend;      /* number of samples read from the file */
+   int order;      /* position in the request list */
+   float *s;
+   };
+
+void set_fdcomp(char *,int,int,float);
+void build_fdindex(char *,char (**)[512],struct fdindex **,int *,int *,int);
+struct fdindex *find_fdindex(char *,struct fdindex *,int *);
+void extract_batch(char (*)[512],struct fdindex *,int,int *,struct statdata *,char *,int,char *,char *,int,float,int,int,float,int,int,int,int);
+
+int main(int ac, char **av)
 {
 FILE *fpr, *fopfile();
 struct statdata shead;
@@ -35,7 +65,6 @@ int all_in_one = 0;
 int seisindx = -1;
 int notfound = 1;
 int search_by_stat = 1;
-int dcomp;
 
 int fd;
 char infile[128];
@@ -46,6 +75,15 @@ int itshft, itend;
 int tst2zero = 0;
 float tpadfront = 0.0;
 
+/* batch extraction (all_in_one=1 with statlist= or all_stats=1) */
+char statlist[512], outdir[512], outpack[512];
+char (*fdfiles)[512];
+struct fdindex *fdx;
+int nfdx, *fdhash;
+int all_stats = 0;
+int nthreads = 1;
+int max_mem = 1024;
+
 shead.stitle[0] = '\0';
 shead.stat[0] = '\0';
 shead.comp[0] = '\0';
@@ -63,11 +101,35 @@ setpar(ac, av);
 getpar("all_in_one","d",&all_in_one);
 getpar("read_tsheader","d",&read_tsheader);
 
+statlist[0] = '\0';
+outdir[0] = '\0';
+outpack[0] = '\0';
+
 if(all_in_one)
    {
    mstpar("filelist","s",filelist);
    getpar("seisindx","d",&seisindx);
 
+   getpar("statlist","s",statlist);
+   getpar("all_stats","d",&all_stats);
+   }
+
+if(all_in_one && (statlist[0] != '\0' || all_stats))
+   {
+   getpar("outdir","s",outdir);
+   getpar("outpack","s",outpack);
+   getpar("nthreads","d",&nthreads);
+   getpar("max_mem","d",&max_mem);
+   if(all_stats && outdir[0] == '\0' && outpack[0] == '\0')
+      sprintf(outdir,".");
+
+   getpar("nt","d",&shead.nt);
+   getpar("comp","s",shead.comp);
+   mstpar("ix","d",&ix);
+   }
+else if(all_in_one)
+   {
+
    search_by_stat = 1;
    if(seisindx >= 0)
       search_by_stat = 0;
@@ -100,8 +162,11 @@ else
    mstpar("comp","s",shead.comp);
    }
 
-mstpar("ix","d",&ix);
-mstpar("outfile","s",outfile);
+if(all_in_one == 0 || (statlist[0] == '\0' && all_stats == 0))
+   {
+   mstpar("ix","d",&ix);
+   mstpar("outfile","s",outfile);
+   }
 
 getpar("title","s",shead.stitle);
 getpar("epi","f",&shead.edist);
@@ -118,6 +183,22 @@ if(momten)
 
 endpar();
 
+/*
+   Batch mode: the station headers of all the files are indexed once,
+   then the requested traces are pulled out of each file in a single
+   pass over its time steps.
+*/
+
+if(all_in_one && (statlist[0] != '\0' || all_stats))
+   {
+   fdhash = (int *) check_malloc (FD_NHASH*sizeof(int));
+   build_fdindex(filelist,&fdfiles,&fdx,&nfdx,fdhash,swap_bytes);
+
+   extract_batch(fdfiles,fdx,nfdx,fdhash,&shead,statlist,all_stats,outdir,outpack,
+                 ix,scale,flip,tst2zero,tpadfront,outbin,swap_bytes,nthreads,max_mem);
+   exit(0);
+   }
+
 /*  read in input data filenames */
 
 if(momten == 0 && all_in_one == 0)
@@ -295,32 +376,7 @@ fprintf(stderr,"name= %s\n",seishead.name);
    if(shead.stat[0] == '\0')
       strcpy(shead.stat,seishead.name);
    if(shead.comp[0] == '\0')
-      {
-      if(ix == 2)
-	 {
-	 if(flip == 1)
-	    sprintf(shead.comp,"dwn");
-	 else
-	    sprintf(shead.comp,"ver");
-	 }
-      else
-	 {
-         if(ix == 0)
-	    dcomp = 90 + seishead.modelrot;
-         if(ix == 1)
-	    dcomp = 180 + seishead.modelrot;
-
-	 if(flip == -1)
-	    dcomp = dcomp + 180;
-
-	 while(dcomp < 0)
-	    dcomp = dcomp + 360;
-	 while(dcomp >= 360)
-	    dcomp = dcomp - 360;
-
-	 sprintf(shead.comp,"%d",dcomp);
-	 }
-      }
+      set_fdcomp(shead.comp,ix,flip,seishead.modelrot);
    if(shead.nt < 0 || shead.nt > seishead.nt)
       shead.nt = seishead.nt;
 
@@ -396,6 +452,387 @@ if(tpadfront > 0.0)
 write_wccseis(outfile,&shead,s,outbin);
 }
 
+/*
+   FD component name for ix (0,1,2) as written by the single station
+   mode: the azimuth of the model x or y axis, or "dwn"/"ver".
+*/
+void set_fdcomp(char *comp,int ix,int flip,float modelrot)
+{
+int dcomp;
+
+if(ix == 2)
+   {
+   if(flip == 1)
+      sprintf(comp,"dwn");
+   else
+      sprintf(comp,"ver");
+   }
+else
+   {
+   if(ix == 0)
+      dcomp = 90 + modelrot;
+   if(ix == 1)
+      dcomp = 180 + modelrot;
+
+   if(flip == -1)
+      dcomp = dcomp + 180;
+
+   while(dcomp < 0)
+      dcomp = dcomp + 360;
+   while(dcomp >= 360)
+      dcomp = dcomp - 360;
+
+   sprintf(comp,"%d",dcomp);
+   }
+}
+
+unsigned int fdname_hash(char *name)
+{
+unsigned int h = 2166136261u;
+int i;
+
+for(i=0;i<FD_STATCHAR && name[i] != '\0';i++)
+   h = (h ^ (unsigned char)(name[i])) * 16777619u;
+
+return(h & (FD_NHASH-1));
+}
+
+/*
+   Reads the station headers of every file in filelist (each file once,
+   all its headers in one read) into fdx[], in file order, and chains
+   them by name in hash[] so that find_fdindex() returns the first
+   occurrence, as the sequential search does.
+*/
+void build_fdindex(char *filelist,char (**files)[512],struct fdindex **fdx,int *nfdx,int *hash,int swap_bytes)
+{
+FILE *fpr, *fopfile();
+struct seisheader *sh;
+char str[512];
+int fd, nf, maxf, ngf, n, maxn, i, ih, *htail;
+
+maxf = 16;
+*files = (char (*)[512]) check_malloc (maxf*sizeof(char[512]));
+
+maxn = 1024;
+*fdx = (struct fdindex *) check_malloc (maxn*sizeof(struct fdindex));
+
+htail = (int *) check_malloc (FD_NHASH*sizeof(int));
+for(ih=0;ih<FD_NHASH;ih++)
+   hash[ih] = htail[ih] = -1;
+
+fpr = fopfile(filelist,"r");
+
+nf = 0;
+n = 0;
+while(fscanf(fpr,"%s",str) != EOF)
+   {
+   if(nf == maxf)
+      {
+      maxf = 2*maxf;
+      *files = (char (*)[512]) check_realloc (*files,maxf*sizeof(char[512]));
+      }
+   strcpy((*files)[nf],str);
+
+   fd = opfile_ro(str);
+   reed(fd,&ngf,sizeof(int));
+   if(swap_bytes)
+      swap_in_place(1,(char *)(&ngf));
+
+   sh = (struct seisheader *) check_malloc (ngf*sizeof(struct seisheader));
+   reed(fd,sh,ngf*sizeof(struct seisheader));
+   close(fd);
+
+   if(n + ngf > maxn)
+      {
+      while(n + ngf > maxn)
+         maxn = 2*maxn;
+      *fdx = (struct fdindex *) check_realloc (*fdx,maxn*sizeof(struct fdindex));
+      }
+
+   for(i=0;i<ngf;i++)
+      {
+      if(swap_bytes)
+         swap_in_place(10,(char *)(&sh[i].indx));
+
+      (*fdx)[n].sh = sh[i];
+      (*fdx)[n].file = nf;
+      (*fdx)[n].ngf = ngf;
+      (*fdx)[n].i = i;
+      (*fdx)[n].hnext = -1;
+
+      ih = fdname_hash(sh[i].name);
+      if(hash[ih] < 0)
+         hash[ih] = n;
+      else
+         (*fdx)[htail[ih]].hnext = n;
+      htail[ih] = n;
+
+      n++;
+      }
+
+   free(sh);
+   nf++;
+   }
+fclose(fpr);
+
+free(htail);
+*nfdx = n;
+
+fprintf(stderr,"indexed %d stations in %d files\n",n,nf);
+}
+
+struct fdindex *find_fdindex(char *name,struct fdindex *fdx,int *hash)
+{
+int k;
+
+for(k=hash[fdname_hash(name)];k>=0;k=fdx[k].hnext)
+   {
+   if(strcmp(name,fdx[k].sh.name) == 0)
+      return(&fdx[k]);
+   }
+
+return(NULL);
+}
+
+int cmp_fdrequest(const void *a,const void *b)
+{
+const struct fdrequest *ra = (const struct fdrequest *) a;
+const struct fdrequest *rb = (const struct fdrequest *) b;
+
+if(ra->fi != rb->fi)
+   return((ra->fi < rb->fi) ? -1 : 1);
+
+return(ra->order - rb->order);
+}
+
+/*
+   Extracts the stations named in statlist (lines "stat outfile"), or
+   all the indexed stations if all_stats is set (written as
+   outdir/stat.comp, or as traces of the WCC pack outpack).  Each
+   file is read once per group of requests whose traces fit in max_mem
+   MB, max_mem bytes of time steps at a time with pread(), and the
+   traces of the group are filled from each block by nthreads threads.
+   The header values, scaling and time shifts are those of the single
+   station mode.
+*/
+void extract_batch(char (*files)[512],struct fdindex *fdx,int nfdx,int *hash,struct statdata *shead0,char *statlist,int all_stats,char *outdir,char *outpack,int ix,float scale,int flip,int tst2zero,float tpadfront,int outbin,int swap_bytes,int nthreads,int max_mem)
+{
+FILE *fpr, *fopfile();
+struct fdrequest *rq;
+struct fdindex *fi;
+char str[1024], stat[512], ofile[512];
+float *buf, v;
+off_t hlen, off;
+size_t blen, memuse, nd;
+ssize_t nr;
+int nrq, maxrq, k, k0, k1, i, it, itb, tb, nb, nblk;
+int tmin, tmax, fd, ngf, file, ipad;
+
+maxrq = 1024;
+rq = (struct fdrequest *) check_malloc (maxrq*sizeof(struct fdrequest));
+nrq = 0;
+
+if(all_stats)
+   {
+   for(k=0;k<nfdx;k++)
+      {
+      if(find_fdindex(fdx[k].sh.name,fdx,hash) != &fdx[k])
+         continue;   /* a later copy of a name, the first one is used */
+
+      if(nrq == maxrq)
+         {
+         maxrq = 2*maxrq;
+         rq = (struct fdrequest *) check_realloc (rq,maxrq*sizeof(struct fdrequest));
+         }
+      rq[nrq].fi = &fdx[k];
+      rq[nrq].outfile[0] = '\0';
+      nrq++;
+      }
+   }
+else
+   {
+   fpr = fopfile(statlist,"r");
+   while(fgets(str,1024,fpr) != NULL)
+      {
+      if(sscanf(str,"%s %s",stat,ofile) != 2)
+         continue;
+
+      if((fi = find_fdindex(stat,fdx,hash)) == NULL)
+         {
+         fprintf(stderr,"Unable to find time history for stat= %s, skipping...\n",stat);
+         continue;
+         }
+
+      if(nrq == maxrq)
+         {
+         maxrq = 2*maxrq;
+         rq = (struct fdrequest *) check_realloc (rq,maxrq*sizeof(struct fdrequest));
+         }
+      rq[nrq].fi = fi;
+      strcpy(rq[nrq].outfile,ofile);
+      nrq++;
+      }
+   fclose(fpr);
+   }
+
+/* header and time window of each trace, as for a single station */
+
+for(k=0;k<nrq;k++)
+   {
+   fi = rq[k].fi;
+   rq[k].shead = *shead0;
+
+   strcpy(rq[k].shead.stat,fi->sh.name);
+   if(rq[k].shead.comp[0] == '\0')
+      set_fdcomp(rq[k].shead.comp,ix,flip,fi->sh.modelrot);
+   if(rq[k].shead.nt < 0 || rq[k].shead.nt > fi->sh.nt)
+      rq[k].shead.nt = fi->sh.nt;
+
+   rq[k].shead.dt = fi->sh.dt;
+
+   rq[k].tskip = 0;
+   rq[k].itshft = 0;
+   rq[k].itend = rq[k].shead.nt;
+   if(tst2zero == 1)
+      {
+      rq[k].itshft = (int)(rq[k].shead.sec/rq[k].shead.dt);
+      rq[k].shead.nt = rq[k].itshft + rq[k].shead.nt;
+      rq[k].shead.sec = 0.0;
+
+      if(rq[k].itshft < 0)
+         {
+         rq[k].tskip = -rq[k].itshft;
+         rq[k].itshft = 0;
+         rq[k].itend = rq[k].shead.nt;
+         }
+      else
+         rq[k].itend = rq[k].shead.nt - rq[k].itshft;
+      }
+
+   if(all_stats)
+      {
+      if(outpack[0] != '\0')
+         sprintf(rq[k].outfile,"%s:%s/%s",outpack,rq[k].shead.stat,rq[k].shead.comp);
+      else
+         sprintf(rq[k].outfile,"%s/%s.%s",outdir,rq[k].shead.stat,rq[k].shead.comp);
+      }
+   }
+
+fprintf(stderr,"extracting %d traces\n",nrq);
+
+/* requests of the same file together, in file order */
+
+for(k=0;k<nrq;k++)
+   rq[k].order = k;
+qsort(rq,nrq,sizeof(struct fdrequest),cmp_fdrequest);
+
+k0 = 0;
+while(k0 < nrq)
+   {
+   /* a group: requests of one file whose traces fit in max_mem */
+
+   file = rq[k0].fi->file;
+   ngf = rq[k0].fi->ngf;
+
+   memuse = 0;
+   k1 = k0;
+   while(k1 < nrq && rq[k1].fi->file == file && (k1 == k0 || memuse + rq[k1].shead.nt*sizeof(float) <= (size_t)(max_mem)*1048576))
+      {
+      memuse = memuse + rq[k1].shead.nt*sizeof(float);
+      k1++;
+      }
+
+   tmin = -1;
+   tmax = 0;
+   for(k=k0;k<k1;k++)
+      {
+      rq[k].s = (float *) check_malloc (rq[k].shead.nt*sizeof(float));
+      for(i=0;i<rq[k].itshft;i++)
+         rq[k].s[i] = 0.0;
+
+      if(tmin < 0 || rq[k].tskip < tmin)
+         tmin = rq[k].tskip;
+      if(rq[k].tskip + rq[k].itend > tmax)
+         tmax = rq[k].tskip + rq[k].itend;
+      }
+
+   hlen = sizeof(int) + (off_t)(ngf)*sizeof(struct seisheader);
+   blen = (size_t)(3*ngf)*sizeof(float);
+   nblk = FD_BLKBYTES/blen;
+   if(nblk < 1)
+      nblk = 1;
+
+   buf = (float *) check_malloc (nblk*blen);
+   fd = opfile_ro(files[file]);
+
+   for(tb=tmin;tb<tmax;tb=tb+nblk)
+      {
+      nb = nblk;
+      if(tb + nb > tmax)
+         nb = tmax - tb;
+
+      off = hlen + (off_t)(tb)*blen;
+      nd = 0;
+      while(nd < nb*blen)
+         {
+         nr = pread(fd,(char *)(buf) + nd,nb*blen - nd,off + nd);
+         if(nr < 0 && errno == EINTR)
+            continue;
+         if(nr <= 0)
+            {
+            fprintf(stderr,"READ ERROR in %s\n",files[file]);
+            exit(-1);
+            }
+         nd = nd + nr;
+         }
+
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic,16) private(it,itb,v)
+      for(k=k0;k<k1;k++)
+         {
+         for(itb=0;itb<nb;itb++)
+            {
+            it = tb + itb - rq[k].tskip;
+            if(it < 0 || it >= rq[k].itend)
+               continue;
+
+            v = buf[itb*3*ngf + 3*rq[k].fi->i + ix];
+            if(swap_bytes)
+               swap_in_place(1,(char *)(&v));
+
+            rq[k].s[it+rq[k].itshft] = scale*flip*v;
+            }
+         }
+      }
+
+   close(fd);
+   free(buf);
+
+   for(k=k0;k<k1;k++)
+      {
+      if(tpadfront > 0.0)
+         {
+         ipad = (int)(tpadfront/rq[k].shead.dt + 0.5);
+         rq[k].shead.nt = rq[k].shead.nt + ipad;
+         rq[k].shead.sec = rq[k].shead.sec - ipad*rq[k].shead.dt;
+
+         rq[k].s = (float *) check_realloc(rq[k].s,rq[k].shead.nt*sizeof(float));
+
+         for(i=rq[k].shead.nt-1;i>=ipad;i--)
+            rq[k].s[i] = rq[k].s[i-ipad];
+         for(i=0;i<ipad;i++)
+            rq[k].s[i] = 0.0;
+         }
+
+      write_wccseis(rq[k].outfile,&rq[k].shead,rq[k].s,outbin);
+      free(rq[k].s);
+      }
+
+   k0 = k1;
+   }
+
+free(rq);
+}
+
 long long_swap(char *cbuf)
 {
 union
@@ -427,21 +864,3 @@ f_union.cval[0] = cbuf[3];
 
 return(f_union.fval);
 }
-
-void swap_in_place(int n,char *cbuf)
-{
-char cv;
-
-while(n--)
-   {
-   cv = cbuf[0];
-   cbuf[0] = cbuf[3];
-   cbuf[3] = cv;
-
-   cv = cbuf[1];
-   cbuf[1] = cbuf[2];
-   cbuf[2] = cv;
-
-   cbuf = cbuf + 4;
-   }
-}
@@ -1,6 +1,7 @@
 #include "include.h"
 #include "structure.h"
 #include "function.h"
+#include "fftw3.h"
 
 float sin_table[] =
    {
@@ -27,7 +28,7 @@ float sin_table[] =
 	1.4980281e-06  /* sin(pi/2097152) */
    };
 /*
- * cfft - radix 2 FFT for complex data
+ * cfft_radix2 - radix 2 FFT for complex data
  *
  * n is the number of complex points.
  * x is the single precision (not double!!) complex vector.
@@ -36,7 +37,7 @@ float sin_table[] =
  * the routine does no normalization
  */
 
-void cfft(x,n,isign)
+static void cfft_radix2(x,n,isign)
 struct complex *x;
 int n,isign;
    {
@@ -108,7 +109,7 @@ int *n, *isign;
 forfft(x,(*n),(*isign));
 }
 
-void forfft(x,n,isign)
+static void forfft_radix2(x,n,isign)
 register struct complex *x;
 int n, isign;
    {
@@ -177,7 +178,7 @@ int *n, *isign;
 invfft(x,(*n),(*isign));
 }
 
-void invfft(x,n,isign)
+static void invfft_radix2(x,n,isign)
 register struct complex *x;
 int n, isign;
    {
@@ -427,3 +428,589 @@ for(j=0;j<n;j++)
    y[j].im = sumim;
    }
 }
+
+/*
+ * cfft, forfft, invfft, rfft_r2c/rfft_c2r and drfft_r2c/drfft_c2r
+ *
+ * Same arguments, sign conventions and packing as the radix 2 codes
+ * above, but the transforms are done by FFTW.  The plans are made once
+ * per length and kind and kept for the life of the process, so the
+ * repeated record lengths only pay for the planning on the first call.
+ *
+ * Environment:
+ *    GMSV_FFT=radix2          use the radix 2 codes above instead
+ *    GMSV_FFTW_WISDOM=file    read FFTW wisdom from file (file.double for
+ *                             the double precision plans), plan with
+ *                             FFTW_MEASURE and write the wisdom back on
+ *                             exit, so later runs reuse the measured plans
+ */
+
+#define		FFT_RADIX2	0
+#define		FFT_FFTW	1
+
+#define		FFT_MAXPLANS	64
+
+#define		FFT_C2C_FWD	0
+#define		FFT_C2C_BWD	1
+#define		FFT_R2C		2
+#define		FFT_C2R		3
+#define		FFT_R2C_IP	4
+#define		FFT_C2R_IP	5
+#define		FFT_DR2C_IP	6
+#define		FFT_DC2R_IP	7
+
+struct fft_plan
+   {
+   int n;
+   int kind;
+   fftwf_plan p;        /* single precision kinds */
+   fftw_plan dp;        /* FFT_DR2C_IP, FFT_DC2R_IP */
+   };
+
+static struct fft_plan fft_plans[FFT_MAXPLANS];
+static int fft_nplans = 0;
+static int fft_backend = -1;
+static unsigned fft_flags = FFTW_ESTIMATE;
+static char fft_wisdom[1024];
+static char fft_dwisdom[1040];
+
+static void fft_save_wisdom()
+{
+fftwf_export_wisdom_to_filename(fft_wisdom);
+fftw_export_wisdom_to_filename(fft_dwisdom);
+}
+
+static void fft_init()
+{
+char *env;
+
+fft_backend = FFT_FFTW;
+env = getenv("GMSV_FFT");
+if(env != NULL && strcmp(env,"radix2") == 0)
+   fft_backend = FFT_RADIX2;
+
+env = getenv("GMSV_FFTW_WISDOM");
+if(fft_backend == FFT_FFTW && env != NULL && env[0] != '\0')
+   {
+   strncpy(fft_wisdom,env,1023);
+   fft_wisdom[1023] = '\0';
+   sprintf(fft_dwisdom,"%s.double",fft_wisdom);
+   fftwf_import_wisdom_from_filename(fft_wisdom);
+   fftw_import_wisdom_from_filename(fft_dwisdom);
+   fft_flags = FFTW_MEASURE;
+   atexit(fft_save_wisdom);
+   }
+}
+
+static int fft_use_fftw()
+{
+int use;
+
+#pragma omp critical (fft1d_plans)
+   {
+   if(fft_backend < 0)
+      fft_init();
+   use = (fft_backend == FFT_FFTW);
+   }
+
+return(use);
+}
+
+/*
+ * Returns the cache entry with the plan for n points of the given kind,
+ * made if it is not in the cache yet (FFT_D* kinds are double precision,
+ * in dp).  The plans are made on scratch arrays (FFTW_MEASURE overwrites
+ * them) and run with the new-array interface on the caller's arrays,
+ * which must then be aligned as fftw_malloc() aligns.  The FFTW planner
+ * is not thread safe, so the lookup and the planning are serialized;
+ * executing a plan is.  If the cache is full the entry is a temporary
+ * one and *tmp is set, the caller then gives it back with fft_done().
+ */
+static struct fft_plan *fft_get(int n,int kind,int *tmp)
+{
+struct fft_plan *e;
+float *in, *out;
+double *din;
+int i;
+
+e = NULL;
+*tmp = 0;
+
+#pragma omp critical (fft1d_plans)
+   {
+   for(i=0;i<fft_nplans;i++)
+      {
+      if(fft_plans[i].n == n && fft_plans[i].kind == kind)
+         {
+         e = &fft_plans[i];
+         break;
+         }
+      }
+
+   if(e == NULL)
+      {
+      if(fft_nplans < FFT_MAXPLANS)
+         {
+         e = &fft_plans[fft_nplans];
+         fft_nplans++;
+         }
+      else
+         {
+         e = (struct fft_plan *) check_malloc(sizeof(struct fft_plan));
+         *tmp = 1;
+         }
+
+      e->n = n;
+      e->kind = kind;
+      e->p = NULL;
+      e->dp = NULL;
+
+      if(kind == FFT_DR2C_IP || kind == FFT_DC2R_IP)
+         {
+         din = (double *) fftw_malloc((n+2)*sizeof(double));
+
+         if(kind == FFT_DR2C_IP)
+            e->dp = fftw_plan_dft_r2c_1d(n,din,(fftw_complex *)din,fft_flags);
+         else
+            e->dp = fftw_plan_dft_c2r_1d(n,(fftw_complex *)din,din,fft_flags);
+
+         fftw_free(din);
+         }
+      else
+         {
+         in = (float *) fftwf_malloc((n+2)*sizeof(fftwf_complex));
+         out = (float *) fftwf_malloc((n+2)*sizeof(fftwf_complex));
+
+         if(kind == FFT_C2C_FWD)
+            e->p = fftwf_plan_dft_1d(n,(fftwf_complex *)in,(fftwf_complex *)in,FFTW_FORWARD,fft_flags);
+         else if(kind == FFT_C2C_BWD)
+            e->p = fftwf_plan_dft_1d(n,(fftwf_complex *)in,(fftwf_complex *)in,FFTW_BACKWARD,fft_flags);
+         else if(kind == FFT_R2C)
+            e->p = fftwf_plan_dft_r2c_1d(n,in,(fftwf_complex *)out,fft_flags);
+         else if(kind == FFT_C2R)
+            e->p = fftwf_plan_dft_c2r_1d(n,(fftwf_complex *)in,out,fft_flags);
+         else if(kind == FFT_R2C_IP)
+            e->p = fftwf_plan_dft_r2c_1d(n,in,(fftwf_complex *)in,fft_flags);
+         else
+            e->p = fftwf_plan_dft_c2r_1d(n,(fftwf_complex *)in,in,fft_flags);
+
+         fftwf_free(in);
+         fftwf_free(out);
+         }
+      }
+   }
+
+if(e->p == NULL && e->dp == NULL)
+   {
+   fprintf(stderr,"FFTW could not make a plan for %d points, exiting...\n",n);
+   exit(-1);
+   }
+
+return(e);
+}
+
+static void fft_done(struct fft_plan *e,int tmp)
+{
+if(tmp)
+   {
+#pragma omp critical (fft1d_plans)
+      {
+      if(e->p != NULL)
+         fftwf_destroy_plan(e->p);
+      if(e->dp != NULL)
+         fftw_destroy_plan(e->dp);
+      }
+   free(e);
+   }
+}
+
+/*
+ * rfft_r2c - real to complex transform in place, with the half
+ * spectrum laid out explicitly rather than packed as in forfft.
+ *
+ * x holds the n (even) real samples and has room for n+2 floats.  On
+ * return it holds the n/2+1 complex values X[0] ... X[n/2] (DC to
+ * Nyquist, with X[0].im = X[n/2].im = 0) of the transform with the sign
+ * of isign; this is the layout of forfft with abs(isign) > 1 and of
+ * FFTW's in-place r2c.  rfft_c2r takes that layout back to n real
+ * samples, with no 1/n.
+ */
+static void rfft_r2c_run(float *x,int n,int isign)
+{
+struct fft_plan *e;
+float *rs;
+int k, tmp;
+
+if(!fft_use_fftw())
+   {
+   forfft_radix2((struct complex *)x,n,(isign < 0) ? -2 : 2);
+   return;
+   }
+
+e = fft_get(n,FFT_R2C_IP,&tmp);
+if(fftwf_alignment_of(x) == 0)
+   fftwf_execute_dft_r2c(e->p,x,(fftwf_complex *)x);
+else
+   {
+   rs = (float *) fftwf_malloc((n+2)*sizeof(float));
+   memcpy(rs,x,n*sizeof(float));
+   fftwf_execute_dft_r2c(e->p,rs,(fftwf_complex *)rs);
+   memcpy(x,rs,(n+2)*sizeof(float));
+   fftwf_free(rs);
+   }
+fft_done(e,tmp);
+
+/* FFTW's forward transform has the -1 sign, conjugate for isign > 0 */
+if(isign > 0)
+   {
+   for(k=1;k<n/2;k++)
+      x[2*k+1] = -x[2*k+1];
+   }
+x[1] = x[n+1] = 0.0;
+}
+
+void rfft_r2c(float *x,int n,int isign)
+{
+double t0;
+
+t0 = prof_start();
+rfft_r2c_run(x,n,isign);
+prof_fft("rfft_r2c",t0,n);
+}
+
+static void rfft_c2r_run(float *x,int n,int isign)
+{
+struct fft_plan *e;
+float *rs;
+int k, tmp;
+
+if(!fft_use_fftw())
+   {
+   invfft_radix2((struct complex *)x,n,(isign < 0) ? -2 : 2);
+   return;
+   }
+
+/* FFTW's backward transform has the +1 sign, conjugate for isign < 0 */
+if(isign < 0)
+   {
+   for(k=1;k<n/2;k++)
+      x[2*k+1] = -x[2*k+1];
+   }
+
+e = fft_get(n,FFT_C2R_IP,&tmp);
+if(fftwf_alignment_of(x) == 0)
+   fftwf_execute_dft_c2r(e->p,(fftwf_complex *)x,x);
+else
+   {
+   rs = (float *) fftwf_malloc((n+2)*sizeof(float));
+   memcpy(rs,x,(n+2)*sizeof(float));
+   fftwf_execute_dft_c2r(e->p,(fftwf_complex *)rs,rs);
+   memcpy(x,rs,n*sizeof(float));
+   fftwf_free(rs);
+   }
+fft_done(e,tmp);
+}
+
+void rfft_c2r(float *x,int n,int isign)
+{
+double t0;
+
+t0 = prof_start();
+rfft_c2r_run(x,n,isign);
+prof_fft("rfft_c2r",t0,n);
+}
+
+/*
+ * drfft_r2c, drfft_c2r - double precision rfft_r2c and rfft_c2r, on n+2
+ * doubles; these always run on FFTW
+ */
+static void drfft_r2c_run(double *x,int n,int isign)
+{
+struct fft_plan *e;
+double *rs;
+int k, tmp;
+
+fft_use_fftw();
+
+e = fft_get(n,FFT_DR2C_IP,&tmp);
+if(fftw_alignment_of(x) == 0)
+   fftw_execute_dft_r2c(e->dp,x,(fftw_complex *)x);
+else
+   {
+   rs = (double *) fftw_malloc((n+2)*sizeof(double));
+   memcpy(rs,x,n*sizeof(double));
+   fftw_execute_dft_r2c(e->dp,rs,(fftw_complex *)rs);
+   memcpy(x,rs,(n+2)*sizeof(double));
+   fftw_free(rs);
+   }
+fft_done(e,tmp);
+
+if(isign > 0)
+   {
+   for(k=1;k<n/2;k++)
+      x[2*k+1] = -x[2*k+1];
+   }
+x[1] = x[n+1] = 0.0;
+}
+
+void drfft_r2c(double *x,int n,int isign)
+{
+double t0;
+
+t0 = prof_start();
+drfft_r2c_run(x,n,isign);
+prof_fft("drfft_r2c",t0,n);
+}
+
+static void drfft_c2r_run(double *x,int n,int isign)
+{
+struct fft_plan *e;
+double *rs;
+int k, tmp;
+
+fft_use_fftw();
+
+if(isign < 0)
+   {
+   for(k=1;k<n/2;k++)
+      x[2*k+1] = -x[2*k+1];
+   }
+
+e = fft_get(n,FFT_DC2R_IP,&tmp);
+if(fftw_alignment_of(x) == 0)
+   fftw_execute_dft_c2r(e->dp,(fftw_complex *)x,x);
+else
+   {
+   rs = (double *) fftw_malloc((n+2)*sizeof(double));
+   memcpy(rs,x,(n+2)*sizeof(double));
+   fftw_execute_dft_c2r(e->dp,(fftw_complex *)rs,rs);
+   memcpy(x,rs,n*sizeof(double));
+   fftw_free(rs);
+   }
+fft_done(e,tmp);
+}
+
+void drfft_c2r(double *x,int n,int isign)
+{
+double t0;
+
+t0 = prof_start();
+drfft_c2r_run(x,n,isign);
+prof_fft("drfft_c2r",t0,n);
+}
+
+static void cfft_run(x,n,isign)
+struct complex *x;
+int n,isign;
+{
+fftwf_complex *cs;
+struct fft_plan *e;
+int tmp;
+
+if(!fft_use_fftw())
+   {
+   cfft_radix2(x,n,isign);
+   return;
+   }
+
+cs = (fftwf_complex *) fftwf_malloc(n*sizeof(fftwf_complex));
+if(isign < 0)
+   e = fft_get(n,FFT_C2C_FWD,&tmp);
+else
+   e = fft_get(n,FFT_C2C_BWD,&tmp);
+
+memcpy(cs,x,n*sizeof(fftwf_complex));
+fftwf_execute_dft(e->p,cs,cs);
+memcpy(x,cs,n*sizeof(fftwf_complex));
+
+fft_done(e,tmp);
+fftwf_free(cs);
+}
+
+void cfft(struct complex *x,int n,int isign)
+{
+double t0;
+
+t0 = prof_start();
+cfft_run(x,n,isign);
+prof_fft("cfft",t0,n);
+}
+
+static void forfft_run(x,n,isign)
+register struct complex *x;
+int n, isign;
+{
+fftwf_complex *cs;
+struct fft_plan *e;
+float *rs;
+int k, n2, tmp;
+
+if(!fft_use_fftw())
+   {
+   forfft_radix2(x,n,isign);
+   return;
+   }
+
+/* with abs(isign) > 1 x has room for n/2+1 values, transform in place */
+if(abs(isign) > 1)
+   {
+   rfft_r2c_run((float *)x,n,isign);
+   return;
+   }
+
+n2 = n/2;
+rs = (float *) fftwf_malloc(n*sizeof(float));
+cs = (fftwf_complex *) fftwf_malloc((n2+1)*sizeof(fftwf_complex));
+e = fft_get(n,FFT_R2C,&tmp);
+
+memcpy(rs,x,n*sizeof(float));
+fftwf_execute_dft_r2c(e->p,rs,cs);
+
+/* FFTW's forward transform has the -1 sign, conjugate for isign > 0 */
+x[0].re = cs[0][0];
+for(k=1;k<n2;k++)
+   {
+   x[k].re = cs[k][0];
+   if(isign < 0)
+      x[k].im = cs[k][1];
+   else
+      x[k].im = -cs[k][1];
+   }
+
+/* Nyquist packed in x[0].im */
+x[0].im = cs[n2][0];
+
+fft_done(e,tmp);
+fftwf_free(rs);
+fftwf_free(cs);
+}
+
+void forfft(struct complex *x,int n,int isign)
+{
+double t0;
+
+t0 = prof_start();
+forfft_run(x,n,isign);
+prof_fft("forfft",t0,n);
+}
+
+static void invfft_run(x,n,isign)
+register struct complex *x;
+int n, isign;
+{
+fftwf_complex *cs;
+struct fft_plan *e;
+float *rs;
+int k, n2, tmp;
+
+if(!fft_use_fftw())
+   {
+   invfft_radix2(x,n,isign);
+   return;
+   }
+
+if(abs(isign) > 1)
+   {
+   rfft_c2r_run((float *)x,n,isign);
+   return;
+   }
+
+n2 = n/2;
+rs = (float *) fftwf_malloc(n*sizeof(float));
+cs = (fftwf_complex *) fftwf_malloc((n2+1)*sizeof(fftwf_complex));
+e = fft_get(n,FFT_C2R,&tmp);
+
+cs[0][0] = x[0].re;
+cs[0][1] = 0.0;
+for(k=1;k<n2;k++)
+   {
+   cs[k][0] = x[k].re;
+   if(isign > 0)
+      cs[k][1] = x[k].im;
+   else
+      cs[k][1] = -x[k].im;
+   }
+
+cs[n2][0] = x[0].im;
+cs[n2][1] = 0.0;
+
+/* FFTW's backward transform has the +1 sign and, as invfft_radix2, no 1/n */
+fftwf_execute_dft_c2r(e->p,cs,rs);
+memcpy(x,rs,n*sizeof(float));
+
+fft_done(e,tmp);
+fftwf_free(rs);
+fftwf_free(cs);
+}
+
+void invfft(struct complex *x,int n,int isign)
+{
+double t0;
+
+t0 = prof_start();
+invfft_run(x,n,isign);
+prof_fft("invfft",t0,n);
+}
+
+static int fft_p2(nt)
+int nt;
+{
+int n = 2;
+
+while(n < nt)
+   n = 2*n;
+
+return(n);
+}
+
+/*
+ * getnt_fft - smallest even length >= nt that the FFT is fast for,
+ * 2^a*3^b*5^c*7^d (a >= 1) on FFTW and the next power of 2 on the
+ * radix 2 codes (GMSV_FFT=radix2)
+ */
+int getnt_fft(nt)
+int nt;
+{
+int n, m;
+
+if(!fft_use_fftw())
+   return(fft_p2(nt));
+
+n = nt + (nt%2);
+if(n < 2)
+   n = 2;
+for(;;n=n+2)
+   {
+   m = n/2;
+   while(m%2 == 0)
+      m = m/2;
+   while(m%3 == 0)
+      m = m/3;
+   while(m%5 == 0)
+      m = m/5;
+   while(m%7 == 0)
+      m = m/7;
+
+   if(m == 1)
+      return(n);
+   }
+}
+
+/*
+ * getnt_fftpad - FFT length for filtering nt samples with a zero phase
+ * spectral factor: a fast length with at least nt/2 zeros of padding
+ * against the wrap around, but never longer than the next power of 2
+ * that was used before
+ */
+int getnt_fftpad(nt)
+int nt;
+{
+int n, np2;
+
+n = getnt_fft(nt + nt/2);
+np2 = fft_p2(nt);
+if(n > np2)
+   n = np2;
+
+return(n);
+}
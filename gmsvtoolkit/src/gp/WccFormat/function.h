@@ -3,27 +3,127 @@ void wcc_resamp_arbdt(int param_string_len, char** param_string,
 		      float** s1, struct statdata* head1);
 void wcc_siteamp14(int param_string_len, char** param_string, float** s1, struct statdata* head1);
 float wcc_getpeak(int param_string_len, char** param_string, float* seis, struct statdata* head1);
+void wcc_minmax(float* s, int nt, float* min, float* max);
+float wcc_absmax(float* s, int nt, int* imax);
+float wcc_vecmax(float** s, int ncomp, int nt, float* work, int* imax);
 void wcc_tfilter (int param_string_len, char** param_string, float* s1, struct statdata* shead1);
 void wcc_add(int param_string_len, char** param_string, float* s1, struct statdata* shead1, float* s2, struct statdata* shead2, float* p, struct statdata* shead3);
+void wcc_axpy(float a, float* x, float* y, int n);
+void wcc_fshift(float* s, int nt, float frac, float* w, int nfft);
+float* wcc_gfsum(struct gfterm* tm, int nterm, int fshift, int nthreads, struct statdata* hd);
 void integ_diff(int param_string_len, char** param_string, float* seis, struct statdata* shead);
 
+//parse the parameters once with *_config, then run *_apply per trace
+void wcc_tfilter_config(int param_string_len, char** param_string, struct tfilter_par* tp);
+void wcc_tfilter_apply(struct tfilter_par* tp, float* s1, struct statdata* shead1);
+void wcc_tfilter_coef(struct tfilter_par* tp, float dt, struct tfilter_coef* tc);
+void wcc_tfilter_run(struct tfilter_coef* tc, float* s1, int nt);
+void wcc_tfilter_sos(struct tfilter_par* tp, float dt, struct tfilter_sos* ts);
+void wcc_tfilter_sos_run(struct tfilter_sos* ts, float* s1, int nt);
+void wcc_tfilter_sos_multi(struct tfilter_sos* ts, float** s, int ntr, int nt, int nl);
+void integ_diff_config(int param_string_len, char** param_string, struct integ_diff_par* idp);
+void integ_diff_apply(struct integ_diff_par* idp, float* seis, struct statdata* shead);
+void integ_diff_stream(struct integ_diff_par* idp, char* infile, char* outfile, int chunk);
+void wcc_resamp_arbdt_config(int param_string_len, char** param_string, struct resamp_arbdt_par* rp);
+void wcc_resamp_arbdt_apply(struct resamp_arbdt_par* rp, float** s1, struct statdata* head1);
+void rsmp_poly_init(struct rsmp_poly* rs, double dt, double newdt, int taps, float kbeta, float nyq_perc);
+int rsmp_poly_run(struct rsmp_poly* rs, float* in, int nin, float* out, int nmax);
+int rsmp_poly_flush(struct rsmp_poly* rs, float* out, int nmax);
+void rsmp_poly_free(struct rsmp_poly* rs);
+void wcc_siteamp14_config(int param_string_len, char** param_string, struct siteamp14_par* sp);
+void siteamp_par_init(struct siteamp14_par* sp);
+void wcc_siteamp_config(int param_string_len, char** param_string, struct siteamp14_par* sp, char** accept);
+const struct siteamp_model* siteamp_model_find(char* name, char** accept);
+void wcc_siteamp14_apply(struct siteamp14_par* sp, float** s1, struct statdata* head1);
+void wcc_siteamp14_apply_cached(struct siteamp14_par* sp, struct siteamp14_cache* cc, float** s1, struct statdata* head1);
+void wcc_siteamp14_apply_room(struct siteamp14_par* sp, struct siteamp14_cache* cc, float* s1, struct statdata* head1);
+void siteamp14_cache_init(struct siteamp14_cache* cc, float pgabin);
+void siteamp14_cache_free(struct siteamp14_cache* cc);
+
 void *check_malloc(size_t);
 void *check_realloc(void *, size_t);
+size_t arena_mark(void);
+void *arena_alloc(size_t);
+void arena_release(size_t);
+void arena_reset(void);
+void arena_free(void);
+double prof_start(void);
+void prof_stop(char *, double, long long);
+void prof_io(char *, long long, long long);
+void prof_fft(char *, double, int);
+double crand_lcg(long *);
+long crand_lcg_skip(long, long long);
+double crand_philox(long, long long);
+int lsq_cholesky_factor(double *, int);
+void lsq_cholesky_solve(double *, int, double *);
+int lsq_cholesky(double *, int, double *);
+void gelim_double(double *, int, double *);
+void invmat3x3(float *, float *);
+void invmat4x4(float *, float *);
+double lsq_grid_step(int);
+double lsq_poly(double *, int, double);
+void lsq_sums(float *, float *, float *, int, double, double, int, double *, double *);
+void lsq_grid_sums(float *, int, int, double, int, double *, double *);
+int lsq_solve_sums(double *, double *, int, double *);
+int lsq_solve_grid_sums(double *, double *, int, double *);
+int lsq_grid_fit(float *, int, int, double *);
+int lsq_grid_fit_batch(float *, int, int, int, double *);
+void lsq_unscale(double *, int, double, double);
 float *read_wccseis(char *, struct statdata *, float *, int);
+int read_wcchead(char *, struct statdata *, int);
+float *read_wccrange(char *, struct statdata *, float *, int, int, int, int, int *);
 void write_wccseis(char *, struct statdata *, float *, int);
+float *map_wccseis(char *, struct wccmap *);
+size_t wccz_write(int, struct statdata *, float *, int);
+int wccz_check(void *);
+float *wccz_read(int, char *, int, struct statdata *, float *, int, int, int, int *);
+void unmap_wccseis(struct wccmap *);
+int tspyr_levn(int, int);
+off_t tspyr_offset(struct tspyr_head *, int);
+off_t tspyr_build(char *, char *, int, int, int, int);
+int tspyr_open(char *, struct tspyr_head *, struct tsheader *);
+void tspyr_read_peak(int, struct tspyr_head *, float *, int *, int);
+int tspyr_read_level(int, struct tspyr_head *, int, int, float *);
+struct traceio *traceio_open(char **, char *, char **, int, int, int, int, int, int);
+float *traceio_next(struct traceio *, struct statdata *, int *);
+void traceio_put(struct traceio *, int, struct statdata *, float *);
+void traceio_close(struct traceio *);
+struct wccpack *wccpack_open(char *, int);
+void wccpack_close(struct wccpack *);
+int wccpack_find(struct wccpack *, char *, char *);
+float *wccpack_read(struct wccpack *, int, struct statdata *, float *);
+void wccpack_add(struct wccpack *, char *, char *, struct statdata *, float *);
+int wccpack_path(char *, char *, char *, char *);
 FILE *fopfile(char*, char*);
 int opfile_ro(char *);
 int opfile(char *);
 int croptrfile(char *);
 int reed(int, void *, int);
 int rite(int, void *, int);
+int reed_swap(int, void *, int, int);
+int read_subgf(int, struct statdata *, float **);
 void getheader(char *,struct statdata *);
+char *format_e(char *,double,int,int);
+void bbp_format_init(struct bbp_format *,char *,char *);
+char *bbp_format_line(char *,struct bbp_format *,double,float,float,float);
 
 void swap_in_place(int,char *);
 void rotate(int, float *, float *, float *, float *, float *);
 void forfft(struct complex *, int, int);
 void invfft(struct complex *, int, int);
+void cfft(struct complex *, int, int);
+int getnt_fft(int);
+int getnt_fftpad(int);
+void rfft_r2c(float *, int, int);
+void rfft_c2r(float *, int, int);
+void drfft_r2c(double *, int, int);
+void drfft_c2r(double *, int, int);
+void spec_ampfac(struct complex *, float *, int);
+void spec_norm(float *, float, int);
+void spec_taper_norm(float *, float, int, float);
+const double *spec_logi(int);
 void dft(struct complex *, struct complex *, int, int);
+void invdft(struct complex *, struct complex *, int, int);
 void cfft_r(struct complex *, int, int);
 void czero(struct complex *, int);
 void makedir(char *);
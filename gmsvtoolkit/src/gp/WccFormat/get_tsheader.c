@@ -78,23 +78,6 @@ for(i=0;i<10;i++)
    fprintf(stderr,"s1[%d]= %13.5e\n",i,s1[i]);
 }
 
-void swap_in_place(int n,char *cbuf)
-{
-char cv;
-
-while(n--)
-   {
-   cv = cbuf[0];
-   cbuf[0] = cbuf[3];
-   cbuf[3] = cv;
-
-   cv = cbuf[1];
-   cbuf[1] = cbuf[2];
-   cbuf[2] = cv;
-
-   cbuf = cbuf + 4;
-   }
-}
 
 void split_bytes(char *cbuf,char *c1,char *c2)
 {
@@ -0,0 +1,331 @@
+/*
+   gmsvlib.c - the C ABI of libgmsv.so, see gmsvlib.h.
+
+   Thin wrappers: the stages are the *_config()/*_apply() pairs of the
+   *_sub.c files, set up from a stagefile line as wcc_pipeline does,
+   the I/O and FFTs are those of iofunc.c and fft1d.c, the residuals
+   resid_spectrum() of GoodFit/resid_station.c, the projections those
+   of ModelCords/geoproj_subs.c, the fault distances those of
+   ModelCords/faultdist_subs.c and rotd is librotd (ucb/rotd50),
+   linked in as librotd.a.
+*/
+
+#include "include.h"
+#include "structure.h"
+#include "function.h"
+#include "getpar.h"
+#include "gmsvlib.h"
+#include "rotdlib.h"
+
+#define         GMSV_MAXARGS    64
+
+#define         GMSV_TFILTER         1
+#define         GMSV_INTEG_DIFF      2
+#define         GMSV_RESAMP_ARBDT    3
+#define         GMSV_SITEAMP14       4
+#define         GMSV_GETPEAK         5
+
+#define         GMSV_ERAD       6378.139
+
+/* GoodFit/resid_station.c */
+void resid_spectrum(float *,float *,int,float *,float *,int,float *,int,float *);
+
+/* ModelCords/geoproj_subs.c */
+void gcproj_batch(float *,float *,float *,float *,int,float *,double *,double *,double *,double *,int);
+void gen_matrices(double *,double *,float *,float *,float *);
+
+/* ModelCords/faultdist_subs.c */
+struct fdist *fdist_build(float *,int);
+void fdist_batch(struct fdist *,float *,float *,int,float *,float *,float *,int);
+void fdist_free(struct fdist *);
+void fdist_plane(float,float,float,float,float,float,float,float *);
+
+/* the header is passed as it is to the WCC routines */
+typedef char gmsv_header_check[(sizeof(struct gmsv_header) == sizeof(struct statdata)) ? 1 : -1];
+
+struct gmsv_stage
+   {
+   int type;
+   int ac;
+   char *av[GMSV_MAXARGS];
+   char buf[1024];
+   float peak;
+   union
+      {
+      struct tfilter_par tf;
+      struct integ_diff_par id;
+      struct resamp_arbdt_par ra;
+      struct siteamp14_par sa;
+      } par;
+   };
+
+int gmsv_abi_version()
+{
+return(GMSV_ABI_VERSION);
+}
+
+float *gmsv_alloc(int n)
+{
+return((float *) check_malloc((n > 0 ? n : 1)*sizeof(float)));
+}
+
+void gmsv_free(void *p)
+{
+free(p);
+}
+
+float *gmsv_read_wcc(const char *file,int inbin,struct gmsv_header *h)
+{
+return(read_wccseis((char *)file,(struct statdata *)h,NULL,inbin));
+}
+
+void gmsv_write_wcc(const char *file,int outbin,const struct gmsv_header *h,const float *s)
+{
+write_wccseis((char *)file,(struct statdata *)h,(float *)s,outbin);
+}
+
+void gmsv_cfft(float *c,int n,int sign)
+{
+cfft((struct complex *)c,n,sign);
+}
+
+void gmsv_rfft_r2c(float *s,int n,int sign)
+{
+rfft_r2c(s,n,sign);
+}
+
+void gmsv_rfft_c2r(float *s,int n,int sign)
+{
+rfft_c2r(s,n,sign);
+}
+
+int gmsv_fftpad(int nt)
+{
+return(getnt_fftpad(nt));
+}
+
+gmsv_stage *gmsv_stage_new(const char *spec)
+{
+gmsv_stage *st;
+char *pb;
+
+st = (gmsv_stage *) check_malloc(sizeof(gmsv_stage));
+strncpy(st->buf,spec,1023);
+st->buf[1023] = '\0';
+st->peak = 0.0;
+
+/* split the line into an argument list, av[0] is the stage name */
+st->ac = 0;
+pb = strtok(st->buf," \t\n");
+while(pb != NULL && st->ac < GMSV_MAXARGS)
+   {
+   st->av[st->ac] = pb;
+   st->ac++;
+   pb = strtok(NULL," \t\n");
+   }
+
+if(st->ac == 0)
+   {
+   fprintf(stderr,"Empty stage, exiting...\n");
+   exit(-1);
+   }
+
+if(strcmp(st->av[0],"tfilter") == 0)
+   {
+   st->type = GMSV_TFILTER;
+   wcc_tfilter_config(st->ac,st->av,&st->par.tf);
+   }
+else if(strcmp(st->av[0],"integ_diff") == 0)
+   {
+   st->type = GMSV_INTEG_DIFF;
+   integ_diff_config(st->ac,st->av,&st->par.id);
+   }
+else if(strcmp(st->av[0],"resamp_arbdt") == 0)
+   {
+   st->type = GMSV_RESAMP_ARBDT;
+   wcc_resamp_arbdt_config(st->ac,st->av,&st->par.ra);
+   }
+else if(strcmp(st->av[0],"siteamp14") == 0)
+   {
+   st->type = GMSV_SITEAMP14;
+   wcc_siteamp14_config(st->ac,st->av,&st->par.sa);
+   }
+else if(strcmp(st->av[0],"getpeak") == 0)
+   st->type = GMSV_GETPEAK;
+else
+   {
+   fprintf(stderr,"Unknown stage %s, exiting...\n",st->av[0]);
+   exit(-1);
+   }
+
+return(st);
+}
+
+float *gmsv_stage_apply(gmsv_stage *st,float *s,struct gmsv_header *h)
+{
+struct statdata *shead = (struct statdata *) h;
+
+if(st->type == GMSV_TFILTER)
+   wcc_tfilter_apply(&st->par.tf,s,shead);
+else if(st->type == GMSV_INTEG_DIFF)
+   integ_diff_apply(&st->par.id,s,shead);
+else if(st->type == GMSV_RESAMP_ARBDT)
+   wcc_resamp_arbdt_apply(&st->par.ra,&s,shead);
+else if(st->type == GMSV_SITEAMP14)
+   wcc_siteamp14_apply(&st->par.sa,&s,shead);
+else if(st->type == GMSV_GETPEAK)
+   st->peak = wcc_getpeak(st->ac,st->av,s,shead);
+
+/* the stages' scratch memory, kept for the next trace */
+arena_reset();
+return(s);
+}
+
+int gmsv_stage_room(const gmsv_stage *st,int nt)
+{
+if(st->type == GMSV_RESAMP_ARBDT)
+   return(0);
+else if(st->type == GMSV_SITEAMP14)
+   return(getnt_fftpad(nt)+2);
+
+return(nt);
+}
+
+float *gmsv_stage_apply_buf(gmsv_stage *st,float *s,int cap,struct gmsv_header *h)
+{
+struct statdata *shead = (struct statdata *) h;
+float *s1;
+int room;
+
+room = gmsv_stage_room(st,h->nt);
+if(room == 0 || cap < room)
+   {
+   s1 = (float *) check_malloc(h->nt*sizeof(float));
+   memcpy(s1,s,h->nt*sizeof(float));
+   return(gmsv_stage_apply(st,s1,h));
+   }
+
+/* the other stages work in the nt samples they are given */
+if(st->type != GMSV_SITEAMP14)
+   return(gmsv_stage_apply(st,s,h));
+
+wcc_siteamp14_apply_room(&st->par.sa,NULL,s,shead);
+arena_reset();
+return(s);
+}
+
+float gmsv_stage_peak(const gmsv_stage *st)
+{
+return(st->peak);
+}
+
+void gmsv_stage_free(gmsv_stage *st)
+{
+free(st);
+}
+
+void gmsv_resid(const float *dper,const float *sa,int ndo,const float *sper,const float *sim,int nds,const float *per,int np,float *res)
+{
+resid_spectrum((float *)dper,(float *)sa,ndo,(float *)sper,(float *)sim,nds,(float *)per,np,res);
+}
+
+int gmsv_rotd_compute(const float *acc1,const float *acc2,int npts,float dt,const float *period,int nper,float damping,int interp,const float *pct,int npct,int rotmode,int nthreads,float accuracy,int precision,float *psa_n,float *psa_e,float *rotd)
+{
+return(rotd_compute(acc1,acc2,npts,dt,period,nper,damping,interp,pct,npct,rotmode,nthreads,accuracy,precision,psa_n,psa_e,rotd));
+}
+
+int gmsv_rotd_compute_batch(const float *acc1,const float *acc2,int npts,int npair,float dt,const float *period,int nper,float damping,int interp,const float *pct,int npct,int nthreads,float *psa_n,float *psa_e,float *rotd)
+{
+return(rotd_compute_batch(acc1,acc2,npts,npair,dt,period,nper,damping,interp,pct,npct,nthreads,psa_n,psa_e,rotd));
+}
+
+/* the traces share the factored normal matrix, see lsqfit.c */
+int gmsv_baseline(float *s,int nt,int ntr,int order)
+{
+double *c, h;
+long long itr, it;
+int n;
+
+if(order < 0 || order >= LSQ_MAXTERMS || nt < 0 || ntr < 0)
+   return(-1);
+
+n = order + 1;
+c = (double *) check_malloc((ntr*n + 1)*sizeof(double));
+if(lsq_grid_fit_batch(s,nt,ntr,n,c) != 0)
+   {
+   free(c);
+   return(-1);
+   }
+
+h = lsq_grid_step(nt);
+for(itr=0;itr<ntr;itr++)
+   {
+   for(it=0;it<nt;it++)
+      s[itr*nt + it] = s[itr*nt + it] - lsq_poly(c+itr*n,n,it*h - 1.0);
+   }
+
+free(c);
+return(0);
+}
+
+/*
+   The great circle projection (geoproj=1, the default) of xy2ll and
+   ll2xy, gflag=0 from model x, y (km) to lon, lat, gflag=1 back.
+*/
+
+static void gmsv_gcproj(float *x,float *y,float *lon,float *lat,int n,float mlon,float mlat,float xazim,int gflag)
+{
+double amat[9], ainv[9];
+double g0, b0;
+float mrot;
+float erad = GMSV_ERAD;
+
+mrot = xazim - 90.0;
+gen_matrices(amat,ainv,&mrot,&mlon,&mlat);
+
+g0 = 0.0;
+b0 = 0.0;
+gcproj_batch(x,y,lon,lat,n,&erad,&g0,&b0,amat,ainv,gflag);
+}
+
+int gmsv_xy2ll(const float *x,const float *y,int n,float mlon,float mlat,float xazim,float *lon,float *lat)
+{
+if(n < 0)
+   return(-1);
+
+gmsv_gcproj((float *)x,(float *)y,lon,lat,n,mlon,mlat,xazim,0);
+return(n);
+}
+
+int gmsv_ll2xy(const float *lon,const float *lat,int n,float mlon,float mlat,float xazim,float *x,float *y)
+{
+if(n < 0)
+   return(-1);
+
+gmsv_gcproj(x,y,(float *)lon,(float *)lat,n,mlon,mlat,xazim,1);
+return(n);
+}
+
+int gmsv_fault_dist(const float *rect,int nrect,const float *slon,const float *slat,int ns,int nthreads,float *rrup,float *rjb,float *rx)
+{
+struct fdist *fd;
+
+if(ns < 0)
+   return(-1);
+
+if((fd = fdist_build((float *)rect,nrect)) == NULL)
+   return(-1);
+
+fdist_batch(fd,(float *)slon,(float *)slat,ns,rrup,rjb,rx,nthreads);
+fdist_free(fd);
+return(ns);
+}
+
+int gmsv_fault_plane(float lon,float lat,float dtop,float len,float wid,float strike,float dip,float *rect)
+{
+if(len <= 0.0 || wid <= 0.0)
+   return(-1);
+
+fdist_plane(lon,lat,dtop,len,wid,strike,dip,rect);
+return(0);
+}
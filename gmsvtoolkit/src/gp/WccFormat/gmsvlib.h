@@ -0,0 +1,221 @@
+/*
+ * gmsvlib.h
+ * C ABI of libgmsv.so (gmsvlib.c): WCC trace I/O, the FFTs, the
+ * processing stages of wcc_pipeline, the GoodFit residuals, rotd, an
+ * SRF reader, baseline fits, the ModelCords projection and fault
+ * distances, for programs and bindings (utils/gmsvlib.py) that would
+ * otherwise run the tools one process per trace.
+ *
+ * The ABI is versioned.  GMSV_ABI_VERSION, the so name
+ * (libgmsv.so.GMSV_ABI_VERSION) and the symbol version node (GMSV_1,
+ * see libgmsv.map) change together whenever a declaration here changes
+ * in a way that breaks existing callers; additions keep the version.
+ * gmsv_abi_version() is the version the library was built with.  Only
+ * the gmsv_* names are exported.
+ *
+ *   struct gmsv_header  a trace header, byte for byte the header of a
+ *                    binary WCC file (struct statdata)
+ *   gmsv_alloc(n)    space for n samples; the traces given to the
+ *                    stages and from gmsv_read_wcc are such blocks, and
+ *                    are freed with gmsv_free()
+ *   gmsv_read_wcc(file, inbin, h)
+ *                    the h->nt samples of a WCC file (binary if inbin)
+ *   gmsv_write_wcc(file, outbin, h, s)
+ *   gmsv_cfft(c, n, sign)
+ *                    complex FFT of n (interleaved re, im) points, as
+ *                    cfft() of fft1d.c
+ *   gmsv_rfft_r2c(s, n, sign), gmsv_rfft_c2r(s, n, sign)
+ *                    real FFTs of n points in n+2 floats, as rfft_*()
+ *   gmsv_fftpad(nt)  the FFT length the stages use for nt samples
+ *
+ *   gmsv_stage_new(spec)
+ *                    a stage from a line of a wcc_pipeline stagefile,
+ *                    e.g. "tfilter fhi=0.1 flo=20.0 order=4": tfilter,
+ *                    integ_diff, resamp_arbdt, siteamp14 or getpeak
+ *   gmsv_stage_apply(st, s, h)
+ *                    runs the stage on the h->nt samples s, in place;
+ *                    the stages that change the length (resamp_arbdt)
+ *                    or need room (siteamp14) reallocate s, so the new
+ *                    pointer is returned and h is updated
+ *   gmsv_stage_room(st, nt)
+ *                    the floats a trace of nt samples needs to go
+ *                    through gmsv_stage_apply_buf() in place, 0 for a
+ *                    stage that changes the length (resamp_arbdt)
+ *   gmsv_stage_apply_buf(st, s, cap, h)
+ *                    the same as gmsv_stage_apply() on a buffer of cap
+ *                    floats the caller owns (a NumPy array, say); with
+ *                    cap >= gmsv_stage_room() it runs in s and returns
+ *                    s, otherwise s is left as it is and the result is
+ *                    a new block, to be freed with gmsv_free()
+ *   gmsv_stage_peak(st)
+ *                    the peak of the last trace seen by a getpeak stage
+ *   gmsv_stage_free(st)
+ *
+ *   gmsv_resid(dper, sa, ndo, sper, sim, nds, per, np, res)
+ *                    the residuals log(obs/sim) of gen_resid_tbl_batch
+ *                    on the np periods per, obs (sa) and sim being
+ *                    interpolated from their own period grids; -99
+ *                    where sim is 0 or per is outside the obs grid
+ *   gmsv_rotd_compute(...), gmsv_rotd_compute_batch(...)
+ *                    rotd_compute() and rotd_compute_batch() of
+ *                    librotd, see ucb/rotd50/rotdlib.h
+ *
+ *   gmsv_srf_open(file, idxfile)
+ *                    an SRF file, parsed once (srfindex.c); with idxfile
+ *                    the index is kept there for the next open.  NULL,
+ *                    with a message, if it cannot be read
+ *   gmsv_srf_version(sf), gmsv_srf_nseg(sf)
+ *   gmsv_srf_plane(sf, seg, pl)
+ *                    the PLANE block of segment seg (0 based), -1 if
+ *                    there is no such segment
+ *   gmsv_srf_npoints(sf, seg)
+ *                    the points of segment seg, all of them for seg < 0
+ *   gmsv_srf_points(sf, seg, first, n, lonlatdep, off)
+ *                    lon, lat, dep (and/or the byte offset) of n points
+ *                    from first of segment seg; returns how many
+ *   gmsv_srf_hypocenter(sf, hypo)
+ *                    lon, lat, dep of the point that ruptures first
+ *   gmsv_srf_moment(sf, velfile)
+ *                    the moment (dyne-cm) with mu from the GP 1D model
+ *                    velfile, -1 if it cannot be read
+ *   gmsv_srf_close(sf)
+ *
+ *   gmsv_baseline(s, nt, ntr, order)
+ *                    removes the least squares polynomial of the given
+ *                    order (integ_diff rbase=) from each of the ntr
+ *                    traces of nt samples s[itr*nt ...], in place; -1
+ *                    if the order is out of range or the fit singular
+ *
+ *   gmsv_xy2ll(x, y, n, mlon, mlat, xazim, lon, lat)
+ *                    n model points x, y (km) to lon, lat, the great
+ *                    circle projection (geoproj=1) of xy2ll with the
+ *                    origin at mlon, mlat and x along xazim; returns n
+ *   gmsv_ll2xy(lon, lat, n, mlon, mlat, xazim, x, y)
+ *                    the reverse, as ll2xy
+ *
+ *   gmsv_fault_dist(rect, nrect, slon, slat, ns, nthreads, rrup, rjb, rx)
+ *                    Rrup, Rjb and Rx (km) of ns stations to the nrect
+ *                    rectangles rect (8 floats each: lon, lat, dep of
+ *                    the center, strike, dip, len, wid, segment), as
+ *                    ModelCords/fault_dist, by nthreads OpenMP threads
+ *                    (0 = all); returns ns, -1 if there is no rectangle
+ *   gmsv_fault_plane(lon, lat, dtop, len, wid, strike, dip, rect)
+ *                    the rectangle of the plane of an SRC file, lon, lat
+ *                    being the center of its top edge
+ *
+ * A stage may be used by one thread at a time; the stages run in the
+ * calling thread.  As in the tools, bad stage arguments and unreadable
+ * files print a message and exit the process, so a binding should only
+ * pass arguments it has checked.
+ */
+#ifndef GMSVLIB_H
+#define GMSVLIB_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GMSV_ABI_VERSION 1
+
+struct gmsv_header
+   {
+   char stat[12];
+   char comp[4];
+   char stitle[64];
+   int nt;
+   float dt;
+   int hr;
+   int min;
+   float sec;
+   float edist;
+   float az;
+   float baz;
+   };
+
+typedef struct gmsv_stage gmsv_stage;
+
+struct gmsv_srf_plane
+   {
+   float elon;
+   float elat;
+   int nstk;
+   int ndip;
+   float len;
+   float wid;
+   float stk;
+   float dip;
+   float dtop;
+   float shyp;
+   float dhyp;
+   int npts;
+   };
+
+typedef struct gmsv_srf gmsv_srf;
+
+int gmsv_abi_version(void);
+
+float *gmsv_alloc(int n);
+void gmsv_free(void *p);
+float *gmsv_read_wcc(const char *file, int inbin, struct gmsv_header *h);
+void gmsv_write_wcc(const char *file, int outbin,
+                    const struct gmsv_header *h, const float *s);
+
+void gmsv_cfft(float *c, int n, int sign);
+void gmsv_rfft_r2c(float *s, int n, int sign);
+void gmsv_rfft_c2r(float *s, int n, int sign);
+int gmsv_fftpad(int nt);
+
+gmsv_stage *gmsv_stage_new(const char *spec);
+float *gmsv_stage_apply(gmsv_stage *st, float *s, struct gmsv_header *h);
+int gmsv_stage_room(const gmsv_stage *st, int nt);
+float *gmsv_stage_apply_buf(gmsv_stage *st, float *s, int cap,
+                           struct gmsv_header *h);
+float gmsv_stage_peak(const gmsv_stage *st);
+void gmsv_stage_free(gmsv_stage *st);
+
+void gmsv_resid(const float *dper, const float *sa, int ndo,
+                const float *sper, const float *sim, int nds,
+                const float *per, int np, float *res);
+
+int gmsv_rotd_compute(const float *acc1, const float *acc2, int npts,
+                      float dt, const float *period, int nper,
+                      float damping, int interp, const float *pct,
+                      int npct, int rotmode, int nthreads, float accuracy,
+                      int precision, float *psa_n, float *psa_e,
+                      float *rotd);
+
+int gmsv_rotd_compute_batch(const float *acc1, const float *acc2, int npts,
+                            int npair, float dt, const float *period,
+                            int nper, float damping, int interp,
+                            const float *pct, int npct, int nthreads,
+                            float *psa_n, float *psa_e, float *rotd);
+
+gmsv_srf *gmsv_srf_open(const char *file, const char *idxfile);
+float gmsv_srf_version(const gmsv_srf *sf);
+int gmsv_srf_nseg(const gmsv_srf *sf);
+int gmsv_srf_plane(const gmsv_srf *sf, int seg, struct gmsv_srf_plane *pl);
+int gmsv_srf_npoints(const gmsv_srf *sf, int seg);
+int gmsv_srf_points(const gmsv_srf *sf, int seg, int first, int n,
+                    float *lonlatdep, long long *off);
+int gmsv_srf_hypocenter(const gmsv_srf *sf, float *hypo);
+double gmsv_srf_moment(const gmsv_srf *sf, const char *velfile);
+void gmsv_srf_close(gmsv_srf *sf);
+
+int gmsv_baseline(float *s, int nt, int ntr, int order);
+
+int gmsv_xy2ll(const float *x, const float *y, int n, float mlon,
+               float mlat, float xazim, float *lon, float *lat);
+int gmsv_ll2xy(const float *lon, const float *lat, int n, float mlon,
+               float mlat, float xazim, float *x, float *y);
+
+int gmsv_fault_dist(const float *rect, int nrect, const float *slon,
+                    const float *slat, int ns, int nthreads, float *rrup,
+                    float *rjb, float *rx);
+int gmsv_fault_plane(float lon, float lat, float dtop, float len, float wid,
+                     float strike, float dip, float *rect);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
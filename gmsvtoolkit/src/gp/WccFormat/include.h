@@ -7,6 +7,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <math.h>
+#include <float.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <limits.h>
@@ -22,6 +23,7 @@
 #include <arpa/inet.h>
 
 #include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/resource.h>
 #include <sys/signal.h>
 #include <sys/syscall.h>
@@ -4,9 +4,6 @@
 #include "getpar.h"
 
 void t1t2(float *, int, float *, float *, float *, float *, float *, int);
-void gelim_double(double *, int, double *);
-void invmat3x3(float *, float *);
-void invmat4x4(float *, float *);
 void baseline(float *, int, float *, int);
 void get_trend(float *, int, float *, float *);
 void detrend(float *, int, float *, float *);
@@ -21,6 +18,7 @@ int main (ac, av)
 int ac;
 char **av;
 {
+struct integ_diff_par idp;
 struct statdata shead;
 float *seis;
 char filein[256];
@@ -29,14 +27,30 @@ char title[128], header[128];
 
 int inbin = 0;
 int outbin = 0;
+int chunk = 0;
 
 setpar(ac, av);
 mstpar("filein","s",filein);
 mstpar("fileout","s",fileout);
 getpar("inbin","d",&inbin);
 getpar("outbin","d",&outbin);
+getpar("chunk","d",&chunk);
 endpar();
 
+/* chunk=: binary trace in and out, chunk samples in memory at a time */
+if(chunk > 0)
+   {
+   if(!inbin || !outbin || strchr(filein,':') != NULL || strchr(fileout,':') != NULL)
+      {
+      fprintf(stderr,"chunk= needs inbin=1 outbin=1 and plain files, exiting...\n");
+      exit(-1);
+      }
+
+   integ_diff_config(ac,av,&idp);
+   integ_diff_stream(&idp,filein,fileout,chunk);
+   exit(0);
+   }
+
 seis = NULL;
 seis = read_wccseis(filein,&shead,seis,inbin);
 
@@ -4,7 +4,6 @@
 #include "getpar.h"
 
 void get_trend(float *, int, float *, float *);
-void gelim_double(double *, int, double *);
 
 void integrate(s,nt,dt,iv)
 float *s, *dt, *iv;
@@ -173,6 +172,88 @@ if(it2 < nt)
    }
 }
 
+/*
+   adjust start of time history so that when it is integrated,
+   the resulting time history will have zero mean as well.
+
+   Sample j (j = 0, 1, ...) is set to finaldisp - sum/(nt-j), sum
+   being the weighted sum (nt-it)*s[it] of the other samples (for
+   finaldisp=0 the whole weighted sum becomes 0), but with its size
+   kept within DEMEAN_TOL of the old one; the first sample that needs
+   no clipping ends it.  demean() recomputes the sum at every j, as it
+   always has.  demean_sums() (dmean=2) keeps it up to date as j moves
+   on, from the total and the changed samples before j, so it takes
+   one pass for the total and one over the changed samples; its sums
+   are in double, so where many samples are clipped one at the 10%
+   boundary can go the other way and the result differ from demean()
+   by more than round-off.
+*/
+
+#define DEMEAN_TOL 0.1
+
+/* the new value of sample j (old) from the sum of the others, 1 if more are to be changed */
+static int demean_step(float old,double sum,int nt,int j,float fdisp,float *snew)
+{
+float new, oabs, nabs, nsgn;
+float difp, tolp, tolm;
+
+tolp = 1.0 + DEMEAN_TOL;
+tolm = 1.0 - DEMEAN_TOL;
+
+new = fdisp - (float)(sum/(nt-j));
+nabs = new;
+nsgn = 1.0;
+if(nabs < 0.0)
+   {
+   nsgn = -1.0;
+   nabs = -new;
+   }
+
+oabs = old;
+if(oabs < 0.0)
+   oabs = -old;
+
+difp = nabs/oabs;
+if(difp > tolp)
+   new = tolp*oabs*nsgn;
+else if(difp < tolm)
+   new = tolm*oabs*nsgn;
+else
+   {
+   *snew = new;
+   return(0);
+   }
+
+*snew = new;
+return(1);
+}
+
+void demean_sums(s,nt,dt,fdisp)
+float *s, *dt, *fdisp;
+int nt;
+{
+double tot, before, upto;
+float old;
+int it, j, test;
+
+tot = 0.0;
+for(it=0;it<nt;it++)
+   tot = tot + (double)(nt-it)*s[it];
+
+/* before: the changed samples before j, upto: the old ones up to j */
+before = 0.0;
+upto = 0.0;
+test = 1;
+for(j=0;j<nt && test;j++)
+   {
+   old = s[j];
+   upto = upto + (double)(nt-j)*old;
+
+   test = demean_step(old,before + (tot - upto),nt,j,*fdisp,&s[j]);
+   before = before + (double)(nt-j)*s[j];
+   }
+}
+
 void demean(s,nt,dt,fdisp)
 float *s, *dt, *fdisp;
 int nt;
@@ -183,11 +264,6 @@ float difp, tolp, tolm;
 float tol = 0.1;
 float sum = 0.0;
 
-/*
-   adjust start of time history so that when it is integrated,
-   the resulting time history will have zero mean as well.
-*/
-
 tolp = 1.0 + tol;
 tolm = 1.0 - tol;
 
@@ -272,10 +348,12 @@ int nt;
 {
 int it, np;
 float *s1, b0;
+size_t mark;
 
 np = nt/4;
 
-s1 = (float *) check_malloc (nt*sizeof(float));
+mark = arena_mark();
+s1 = (float *) arena_alloc (nt*sizeof(float));
 
 for(it=0;it<nt;it++)
    s1[it] = s[it];
@@ -284,7 +362,7 @@ integrate(s1,nt,dt,iv);
 get_trend(s1+(nt-np),np,dt,&b0);
 
 s[0] = s[0] - b0/(*dt);
-free(s1);
+arena_release(mark);
 }
 
 void get_trend(s,nt,dt,b0)
@@ -312,263 +390,57 @@ if(str[i-1] != '\n')
    str[i-1] = '\n';
 }
 
+/*
+   baseline(): least squares polynomial of the given order in t = it*dt,
+   removed from s.  It is fitted by lsqfit.c in u = it*h - 1 (-1 ... 1
+   over the trace), the same polynomial but well conditioned.
+*/
+
 void baseline(s,nt,dt,order)
 float *s, *dt;
 int nt, order;
 {
-float y;
-double t0[11], ts[6];
-double x0[6], c0[36];
-int i, j, it;
-
-for(i=0;i<36;i++)
-   c0[i] = 0.0;
-
-for(i=0;i<6;i++)
-   x0[i] = 0.0;
-
-t0[0] = 1;
-for(it=0;it<nt;it++)
-   {
-   t0[1] = it*(*dt);
-   for(i=2;i<2*order+1;i++)
-      t0[i] = t0[i-1]*t0[1];
-
-   ts[0] = s[it];
-   for(i=1;i<order+1;i++)
-      ts[i] = t0[i]*s[it];
-
-   for(j=0;j<order+1;j++)
-      {
-      for(i=0;i<order+1;i++)
-	 c0[i+j*(order+1)] = c0[i+j*(order+1)] + t0[i+j];
-
-      x0[j] = x0[j] + ts[j];
-      }
-   }
-
-gelim_double(c0,order+1,x0);
+double x0[LSQ_MAXTERMS], h;
+int it;
 
+lsq_grid_fit(s,nt,order+1,x0);
 
+h = lsq_grid_step(nt);
 for(it=0;it<nt;it++)
-   {
-   t0[1] = it*(*dt);
-   for(i=2;i<order+1;i++)
-      t0[i] = t0[i-1]*t0[1];
-
-   y = x0[0];
-   for(i=1;i<order+1;i++)
-      y = y + x0[i]*t0[i];
-
-   s[it] = s[it] - y;
-   }
+   s[it] = s[it] - lsq_poly(x0,order+1,it*h - 1.0);
 }
 
-void invmat3x3(inv,mat)
-float *inv, *mat;
+/*
+   baseline() followed by integrate() in a single pass after the fit,
+   same result as the two calls
+*/
+void baseline_integ(s,nt,dt,order,iv)
+float *s, *dt, *iv;
+int nt, order;
 {
-int i;
-float ftmp, det;
-
-/* form cofactors */
- 
-inv[0] = mat[4]*mat[8] - mat[5]*mat[7];
-inv[1] = -mat[3]*mat[8] + mat[5]*mat[6];
-inv[2] = mat[3]*mat[7] - mat[4]*mat[6];
- 
-inv[3] = -mat[1]*mat[8] + mat[2]*mat[7];
-inv[4] = mat[0]*mat[8] - mat[2]*mat[6];
-inv[5] = -mat[0]*mat[7] + mat[1]*mat[6];
- 
-inv[6] = mat[1]*mat[5] - mat[2]*mat[4];
-inv[7] = -mat[0]*mat[5] + mat[2]*mat[3];
-inv[8] = mat[0]*mat[4] - mat[1]*mat[3];
-
-/* calculate determinant */
- 
-det = mat[0]*inv[0] + mat[1]*inv[1] + mat[2]*inv[2];
- 
-if(det != 0.0)
-   {
-   det = 1.0/det;
-   for(i=0;i<9;i++)
-      inv[i] = det*inv[i];
- 
-   /* transpose */
- 
-   ftmp = inv[1];
-   inv[1] = inv[3];
-   inv[3] = ftmp;
- 
-   ftmp = inv[2];
-   inv[2] = inv[6];
-   inv[6] = ftmp;
-
-   ftmp = inv[5];
-   inv[5] = inv[7];
-   inv[7] = ftmp;
-   }
-else
-   {
-   fprintf(stderr,"invmat3x3 error: matrix is singular, exiting...\n");
-   exit(-9);
-   }
-}
+double x0[LSQ_MAXTERMS], h;
+float v, s0;
+int it;
 
-void invmat4x4(v,m)
-float *v, *m;
-{
-int i;
-float ftmp, det;
-
-/* form cofactors */
- 
-v[0]  =   m[5]*(m[10]*m[15] - m[14]*m[11])
-        - m[6]*(m[9]*m[15] - m[13]*m[11])
-        + m[7]*(m[9]*m[14] - m[13]*m[10]);
-v[1]  = - m[4]*(m[10]*m[15] - m[14]*m[11])
-        + m[6]*(m[8]*m[15] - m[12]*m[11])
-        - m[7]*(m[8]*m[14] - m[12]*m[10]);
-v[2]  =   m[4]*(m[9]*m[15] - m[13]*m[11])
-        - m[5]*(m[8]*m[15] - m[12]*m[11])
-        + m[7]*(m[8]*m[13] - m[12]*m[9]);
-v[3]  = - m[4]*(m[9]*m[14] - m[13]*m[10])
-        + m[5]*(m[8]*m[14] - m[12]*m[10])
-        - m[6]*(m[8]*m[13] - m[12]*m[9]);
- 
-v[4]  = - m[1]*(m[10]*m[15] - m[14]*m[11])
-        + m[2]*(m[9]*m[15] - m[13]*m[11])
-        - m[3]*(m[9]*m[14] - m[13]*m[10]);
-v[5]  =   m[0]*(m[10]*m[15] - m[14]*m[11])
-        - m[2]*(m[8]*m[15] - m[12]*m[11])
-        + m[3]*(m[8]*m[14] - m[12]*m[10]);
-v[6]  = - m[0]*(m[9]*m[15] - m[13]*m[11])
-        + m[1]*(m[8]*m[15] - m[12]*m[11])
-        - m[3]*(m[8]*m[13] - m[12]*m[9]);
-v[7]  =   m[0]*(m[9]*m[14] - m[13]*m[10])
-        - m[1]*(m[8]*m[14] - m[12]*m[10])
-        + m[2]*(m[8]*m[13] - m[12]*m[9]);
-  
-v[8]  =   m[1]*(m[6]*m[15] - m[14]*m[7])
-        - m[2]*(m[5]*m[15] - m[13]*m[7])
-        + m[3]*(m[5]*m[14] - m[13]*m[6]);
-v[9]  = - m[0]*(m[6]*m[15] - m[14]*m[7])
-        + m[2]*(m[4]*m[15] - m[12]*m[7])
-        - m[3]*(m[4]*m[14] - m[12]*m[6]);
-v[10] =   m[0]*(m[5]*m[15] - m[13]*m[7])
-        - m[1]*(m[4]*m[15] - m[12]*m[7])
-        + m[3]*(m[4]*m[13] - m[12]*m[5]);
-v[11] = - m[0]*(m[5]*m[14] - m[13]*m[6])
-        + m[1]*(m[4]*m[14] - m[12]*m[6])
-        - m[2]*(m[4]*m[13] - m[12]*m[5]);
-  
-v[12] = - m[1]*(m[6]*m[11] - m[10]*m[7])
-        + m[2]*(m[5]*m[11] - m[9]*m[7])
-        - m[3]*(m[5]*m[10] - m[9]*m[6]);
-v[13] =   m[0]*(m[6]*m[11] - m[10]*m[7])
-        - m[2]*(m[4]*m[11] - m[8]*m[7])
-        + m[3]*(m[4]*m[10] - m[8]*m[6]);
-v[14] = - m[0]*(m[5]*m[11] - m[9]*m[7])
-        + m[1]*(m[4]*m[11] - m[8]*m[7])
-        - m[3]*(m[4]*m[9] - m[8]*m[5]);
-v[15] =   m[0]*(m[5]*m[10] - m[9]*m[6])
-        - m[1]*(m[4]*m[10] - m[8]*m[6])
-        + m[2]*(m[4]*m[9] - m[8]*m[5]);
- 
-/* calculate determinant */
- 
-det = m[0]*v[0] + m[1]*v[1] + m[2]*v[2] + m[3]*v[3];
- 
-if(det != 0.0)
-   {
-   det = 1.0/det;
-   for(i=0;i<16;i++)
-      v[i] = det*v[i];
- 
-   /* transpose */
- 
-   ftmp = v[1];
-   v[1] = v[4];
-   v[4] = ftmp;
- 
-   ftmp = v[2];
-   v[2] = v[8];
-   v[8] = ftmp;
- 
-   ftmp = v[3];
-   v[3] = v[12];
-   v[12] = ftmp;
- 
-   ftmp = v[7];
-   v[7] = v[13];
-   v[13] = ftmp;
- 
-   ftmp = v[11];
-   v[11] = v[14];
-   v[14] = ftmp;
- 
-   ftmp = v[6];
-   v[6] = v[9];
-   v[9] = ftmp;
-   }
-else
+lsq_grid_fit(s,nt,order+1,x0);
+
+h = lsq_grid_step(nt);
+s0 = *iv;
+for(it=0;it<nt;it++)
    {
-   fprintf(stderr,"invmat4x4 error: matrix is singular, exiting...\n");
-   exit(-9);
+   v = s[it] - lsq_poly(x0,order+1,it*h - 1.0);
+   s0 = v*(*dt) + s0;
+   s[it] = s0;
    }
 }
 
-/*
-Gauss elimination without pivoting (no row exchanges):
-We solve Ax = b where A is n by n, and x and b have length n
-by forming the decomposition A = LU via elimination.
-Originally a contains the matrix A and b contains the
-vector b.  At the end a contains the lower and upper
-triangular matrices L and U and b contains the solution
-vector x.  The diagonal of a contains the diagonal of U
-(the pivots) since the diagonal elements of U are all 1's.
-*/
-
-void gelim_double(a,n,b)
-double *a, *b;
-int n;
-   {
-	int i, j, jj;
-	double *pa, *paj;
-	double f, pivot;
-
-         for (j=0; j<n-1; j++)   /* lu decomp of a (no row exchanges) */
-	    {
-		pa= a + j*n;
-		pivot = pa[j];
-	 	for (i=j+1; i<n; i++)
-		   {
-			pa = a + i*n;
-			paj= a + j*n;
-	     		f = pa[j]/pivot;
-			pa[j] = f;
-			for (jj=j+1; jj<n; jj++) pa[jj] -= f*paj[jj];
-		   }
-	   }
-         for (i=1; i<n; i++)        /* forward elimination on b */
-	    {
-		pa = a + i*n;
-		for (j=0; j<i; j++) b[i] -= pa[j]*b[j];
-	    }
-         for (i=n-1; i>-1; i--)        /* back-substitution */
-	    {
-		pa = a + i*n;
-		for (j=n-1; j>i; j--) b[i] -= pa[j]*b[j];
-		b[i] = b[i]/pa[i];
-	    }
-    }
-
 void t1t2(s,nt,dt,t1,t2,tf1,tf2,iv0)
 float *s, *dt, *t1, *t2, *tf1, *tf2;
 int nt, iv0;
 {
 int it, it1, it2, itf1, itf2;
 float *v;
+size_t mark;
 float m0, af, am;
 float b0, t, y;
 float c0 = 0.0;
@@ -576,7 +448,8 @@ float c1 = 0.0;
 float c2 = 0.0;
 float c3 = 0.0;
 
-v = (float *)check_malloc(nt*sizeof(float));
+mark = arena_mark();
+v = (float *)arena_alloc(nt*sizeof(float));
 
 if((*t1) < 0.0)
    {
@@ -667,85 +540,256 @@ for(it=it1;it<it2;it++)
 for(it=it2;it<nt;it++)
    s[it] = s[it] - af;
 
-free(v);
+arena_release(mark);
+}
+
+/*
+   fdomain=1: integ and diff in the frequency domain.  The trace, zero
+   padded to at least 2*nt, is transformed once, multiplied by (i*w)^n
+   with n = diff - integ (so integ=2 gives displacement from
+   acceleration) and, with hp_fhi > 0, by an acausal high-pass in the
+   same pass, and transformed back.  The high-pass is the hp_order pole
+   Butterworth of wcc_tfilter fhi= with phase=0 at the trace dt,
+
+      1/(1 + (tan(pi*fhi*dt)/tan(pi*f*dt))^(2*hp_order))
+
+   or, with 0 < hp_fbot < hp_fhi, a cosine ramp from 0 at hp_fbot to 1
+   at hp_fhi.  DC and Nyquist are zeroed when n != 0; an integrated
+   trace is then shifted to equal init_val just before its first
+   sample, as integrate() starts from init_val.
+*/
+
+static double fd_hp_gain(struct integ_diff_par *idp,double dt,double whi,double f)
+{
+double fl, fl2;
+int j;
+
+if(idp->hp_fbot > 0.0 && idp->hp_fbot < idp->hp_fhi)
+   {
+   if(f <= idp->hp_fbot)
+      return(0.0);
+   if(f >= idp->hp_fhi)
+      return(1.0);
+   return(0.5*(1.0 - cos(3.14159265*(f - idp->hp_fbot)/(idp->hp_fhi - idp->hp_fbot))));
+   }
+
+fl = whi/tan(3.14159265*f*dt);
+fl2 = fl*fl;
+fl = fl2;
+for(j=1;j<idp->hp_order;j++)
+   fl = fl*fl2;
+
+return(1.0/(1.0 + fl));
+}
+
+void fd_integ_diff(struct integ_diff_par *idp,float *s,int nt,float dt,int npow,float init_val)
+{
+double w, dw, fac, whi, re, im;
+float *x;
+size_t mark;
+int i, j, n, nfft, hp;
+
+nfft = getnt_fft(2*nt);
+mark = arena_mark();
+x = (float *) arena_alloc((nfft+2)*sizeof(float));
+for(i=0;i<nt;i++)
+   x[i] = s[i];
+for(i=nt;i<nfft+2;i++)
+   x[i] = 0.0;
+
+rfft_r2c(x,nfft,-1);
+
+hp = (idp->hp_fhi > 0.0 && idp->hp_fhi < 0.5/dt);
+whi = tan(3.14159265*idp->hp_fhi*dt);
+dw = 2.0*3.14159265/(nfft*dt);
+n = nfft/2;
+
+for(i=1;i<n;i++)
+   {
+   w = i*dw;
+   fac = 1.0/nfft;
+   if(hp)
+      fac = fac*fd_hp_gain(idp,dt,whi,i/(nfft*dt));
+
+   re = fac*x[2*i];
+   im = fac*x[2*i+1];
+   for(j=0;j<npow;j++)         /* times i*w */
+      {
+      fac = re;
+      re = -w*im;
+      im = w*fac;
+      }
+   for(j=0;j>npow;j--)         /* divided by i*w */
+      {
+      fac = re;
+      re = im/w;
+      im = -fac/w;
+      }
+   x[2*i] = re;
+   x[2*i+1] = im;
+   }
+
+if(npow != 0 || hp)
+   x[0] = x[1] = 0.0;
+else
+   x[0] = x[0]/nfft;
+
+if(npow != 0)
+   x[2*n] = x[2*n+1] = 0.0;
+else
+   x[2*n] = x[2*n]/nfft;
+
+rfft_c2r(x,nfft,1);
+
+fac = 0.0;
+if(npow < 0)
+   fac = init_val - x[nfft-1];
+for(i=0;i<nt;i++)
+   s[i] = x[i] + fac;
+
+arena_release(mark);
 }
 
 void integ_diff(int param_string_len, char** param_string, float* seis, struct statdata* shead) {
-	float dt, sec, edist, az, baz;
-	int nt, hr, min, i, j, nt6;
-	int integ = 0;
-	int diff = 0;
-	int rtrend = 0;
-	int rbase = 0;
-	int dmean = 0;
-	int dtrend = 0;
-	int rmean = 0;
-	int taper = 0;
-	int boorebase = 0;
+	struct integ_diff_par idp;
+
+	integ_diff_config(param_string_len, param_string, &idp);
+	integ_diff_apply(&idp, seis, shead);
+}
+
+/* parse the integ_diff parameters once, for integ_diff_apply() */
+void integ_diff_config(int param_string_len, char** param_string, struct integ_diff_par* idp) {
+	gp_ctx *gp;
+
+	idp->integ = 0;
+	idp->diff = 0;
+	idp->rtrend = 0;
+	idp->rbase = 0;
+	idp->dmean = 0;
+	idp->dtrend = 0;
+	idp->rmean = 0;
+	idp->taper = 0;
+	idp->boorebase = 0;
 	
-	float tstart = -1.0e+15;
-	float tlen = -1.0e+15;
+	idp->tstart = -1.0e+15;
+	idp->tlen = -1.0e+15;
 	
-	float scale = 1.0;
+	idp->scale = 1.0;
 	
-	float t1 = -1.0;
-	float t2 = -1.0;
-	float tf1 = -1.0;
-	float tf2 = -1.0;
-	int v0correct = 0;
+	idp->t1 = -1.0;
+	idp->t2 = -1.0;
+	idp->tf1 = -1.0;
+	idp->tf2 = -1.0;
+	idp->v0correct = 0;
 	
-	float ts0 = 0.0;
-	float te0 = 0.0;
-	float ts1 = 9999.0;
-	float te1 = 9999.0;
-
-	float tfront = -1.0;
-	float tend = -1.0;
-
-	float finaldisp = 0.0;
-	float init_val = 0.0;
-
-	setpar(param_string_len, param_string);
-	getpar("integ","d",&integ);
-	getpar("diff","d",&diff);
-	getpar("rtrend","d",&rtrend);
-	getpar("rbase","d",&rbase);
-	getpar("dmean","d",&dmean);
-	getpar("dtrend","d",&dtrend);
-	getpar("boorebase","d",&boorebase);
-	if(boorebase)
+	idp->ts0 = 0.0;
+	idp->te0 = 0.0;
+	idp->ts1 = 9999.0;
+	idp->te1 = 9999.0;
+
+	idp->tfront = -1.0;
+	idp->tend = -1.0;
+
+	idp->finaldisp = 0.0;
+	idp->init_val = 0.0;
+
+	idp->fdomain = 0;
+	idp->hp_fhi = 0.0;
+	idp->hp_order = 4;
+	idp->hp_fbot = 0.0;
+
+	gp = gp_setpar(param_string_len, param_string);
+	gp_getpar(gp,"integ","d",&idp->integ);
+	gp_getpar(gp,"diff","d",&idp->diff);
+	gp_getpar(gp,"rtrend","d",&idp->rtrend);
+	gp_getpar(gp,"rbase","d",&idp->rbase);
+	if(idp->rbase < 0 || idp->rbase >= LSQ_MAXTERMS)
 	{
-		getpar("t1","f",&t1);
-      	getpar("t2","f",&t2);
-		getpar("tf1","f",&tf1);
-		getpar("tf2","f",&tf2);
-		getpar("v0correct","d",&v0correct);
+		fprintf(stderr,"*** rbase= %d, the order must be 0 ... %d, exiting...\n",idp->rbase,LSQ_MAXTERMS-1);
+		exit(-1);
 	}
-	getpar("rmean","d",&rmean);
-	if(rmean)
+	gp_getpar(gp,"dmean","d",&idp->dmean);
+	gp_getpar(gp,"dtrend","d",&idp->dtrend);
+	gp_getpar(gp,"boorebase","d",&idp->boorebase);
+	if(idp->boorebase)
+	{
+		gp_getpar(gp,"t1","f",&idp->t1);
+      	gp_getpar(gp,"t2","f",&idp->t2);
+		gp_getpar(gp,"tf1","f",&idp->tf1);
+		gp_getpar(gp,"tf2","f",&idp->tf2);
+		gp_getpar(gp,"v0correct","d",&idp->v0correct);
+	}
+	gp_getpar(gp,"rmean","d",&idp->rmean);
+	if(idp->rmean)
     {
-		getpar("tstart","f",&tstart);
-        getpar("tlen","f",&tlen);
+		gp_getpar(gp,"tstart","f",&idp->tstart);
+        gp_getpar(gp,"tlen","f",&idp->tlen);
     }
-	getpar("taper","d",&taper);
-	if(taper)
+	gp_getpar(gp,"taper","d",&idp->taper);
+	if(idp->taper)
     {
-		getpar("ts0","f",&ts0);
-		getpar("te0","f",&te0);
-		getpar("ts1","f",&ts1);
-		getpar("te1","f",&te1);
-		getpar("tfront","f",&tfront);
-		getpar("tend","f",&tend);
+		gp_getpar(gp,"ts0","f",&idp->ts0);
+		gp_getpar(gp,"te0","f",&idp->te0);
+		gp_getpar(gp,"ts1","f",&idp->ts1);
+		gp_getpar(gp,"te1","f",&idp->te1);
+		gp_getpar(gp,"tfront","f",&idp->tfront);
+		gp_getpar(gp,"tend","f",&idp->tend);
 	}
 
-	getpar("scale","f",&scale);
-	getpar("finaldisp","f",&finaldisp);
-	getpar("init_val","f",&init_val);
-	endpar();
+	gp_getpar(gp,"scale","f",&idp->scale);
+	gp_getpar(gp,"finaldisp","f",&idp->finaldisp);
+	gp_getpar(gp,"init_val","f",&idp->init_val);
+	gp_getpar(gp,"fdomain","d",&idp->fdomain);
+	if(idp->fdomain)
+	{
+		gp_getpar(gp,"hp_fhi","f",&idp->hp_fhi);
+		gp_getpar(gp,"hp_order","d",&idp->hp_order);
+		gp_getpar(gp,"hp_fbot","f",&idp->hp_fbot);
+	}
+	gp_endpar(gp);
+
+	if(idp->finaldisp != 0.0 && idp->dmean == 0)
+		idp->dmean = 1;
+}
+
+void integ_diff_apply(struct integ_diff_par* idp, float* seis, struct statdata* shead) {
+	int i;
+
+	/* t1, t2, the taper window and init_val are changed per trace */
+	int integ = idp->integ;
+	int diff = idp->diff;
+	int rtrend = idp->rtrend;
+	int rbase = idp->rbase;
+	int dmean = idp->dmean;
+	int dtrend = idp->dtrend;
+	int rmean = idp->rmean;
+	int taper = idp->taper;
+	int boorebase = idp->boorebase;
+	
+	float tstart = idp->tstart;
+	float tlen = idp->tlen;
+	
+	float scale = idp->scale;
+	
+	float t1 = idp->t1;
+	float t2 = idp->t2;
+	float tf1 = idp->tf1;
+	float tf2 = idp->tf2;
+	int v0correct = idp->v0correct;
+	
+	float ts0 = idp->ts0;
+	float te0 = idp->te0;
+	float ts1 = idp->ts1;
+	float te1 = idp->te1;
 
-	if(finaldisp != 0.0)
-		dmean = 1;	
+	float tfront = idp->tfront;
+	float tend = idp->tend;
 
+	float finaldisp = idp->finaldisp;
+	float init_val = idp->init_val;
+	double t0;
+
+	t0 = prof_start();
 	if(taper)
 	{
 		if(tfront > 0.0)
@@ -763,10 +807,19 @@ void integ_diff(int param_string_len, char** param_string, float* seis, struct s
 	if(rtrend) /*  remove linear trend  */
 		retrend(seis,shead->nt,&shead->dt);
 
-	if(rbase) /*  remove baseline polynomial  */
+	/*  remove baseline polynomial, integrating in the same pass
+	 *  when nothing else comes in between  */
+	if(rbase && integ && !idp->fdomain && !dmean && !dtrend && !rmean && !boorebase)
+	{
+		baseline_integ(seis,shead->nt,&shead->dt,rbase,&init_val);
+		integ = 0;
+	}
+	else if(rbase)
 		baseline(seis,shead->nt,&shead->dt,rbase);
 
-	if(dmean)
+	if(dmean == 2)
+		demean_sums(seis,shead->nt,&shead->dt,&finaldisp);
+	else if(dmean)
 		demean(seis,shead->nt,&shead->dt,&finaldisp);
 
 	/*
@@ -782,11 +835,19 @@ void integ_diff(int param_string_len, char** param_string, float* seis, struct s
 	if(boorebase) /*  remove tri-linear from vel */
 		t1t2(seis,shead->nt,&shead->dt,&t1,&t2,&tf1,&tf2,v0correct);
 
-	if(integ) /*  integrate  */
-		integrate(seis,shead->nt,&shead->dt,&init_val);
+	if(idp->fdomain) /*  integrate/differentiate and high-pass in one transform  */
+	{
+		if(integ || diff || idp->hp_fhi > 0.0)
+			fd_integ_diff(idp,seis,shead->nt,shead->dt,diff-integ,init_val);
+	}
+	else
+	{
+		if(integ) /*  integrate  */
+			integrate(seis,shead->nt,&shead->dt,&init_val);
 
-	if(diff) /*  differentiate  */
-		differ(seis,shead->nt,&shead->dt,&init_val);
+		if(diff) /*  differentiate  */
+			differ(seis,shead->nt,&shead->dt,&init_val);
+	}
 
 	if(taper) /*  smoothly taper record */
 		tapr(seis,shead->nt,(int)(ts0/shead->dt),(int)(te0/shead->dt),(int)(ts1/shead->dt),(int)(te1/shead->dt));
@@ -794,5 +855,610 @@ void integ_diff(int param_string_len, char** param_string, float* seis, struct s
 	for(i=0;i<shead->nt;i++)
 		seis[i] = scale*seis[i];
 
+	prof_stop("integ_diff", t0, shead->nt);
 }
 
+
+/*
+   integ_diff_stream(): the integ_diff_apply() chain on a binary trace
+   file, chunk samples at a time, so memory does not grow with nt.
+
+   rtrend, rbase, dmean, dtrend, rmean and boorebase need a statistic of
+   the whole trace: each takes one reading pass (demean one per adjusted
+   sample, dmean=2 two) that applies the operations before it on the fly.  The last
+   pass runs the whole chain, integ/diff/taper/scale included, and
+   writes the output.  Sums are formed in the same order and precision
+   as in the functions above, so the output is that of
+   integ_diff_apply().  Without those six, one pass over stdin is fine.
+*/
+
+#define IDS_RTREND      0
+#define IDS_RBASE       1
+#define IDS_DMEAN       2
+#define IDS_DTREND      3
+#define IDS_RMEAN       4
+#define IDS_T1T2        5
+#define IDS_ALL         6
+
+struct idstream
+   {
+   struct integ_diff_par *idp;
+   int fdr;
+   int nt;
+   float dt;
+   int chunk;
+   float *buf;
+   float rt_m0, rt_b0;          /* retrend() line */
+   double bl_x0[LSQ_MAXTERMS];  /* baseline() polynomial, in u = it*bl_h - 1 */
+   double bl_h;
+   int ndm;                     /* demean(): new leading samples */
+   float *dm;
+   float dt_b0;                 /* detrend() */
+   float rm_sum;                /* remean() */
+   int tt_on;                   /* t1t2() */
+   int tt_it1, tt_it2;
+   float tt_m0, tt_am, tt_af;
+   };
+
+/* operations before stage upto, on samples i0 ... i0+n-1 */
+static void ids_apply(struct idstream *st,float *s,int i0,int n,int upto)
+{
+struct integ_diff_par *idp = st->idp;
+float t, y;
+int i, it;
+
+if(upto > IDS_RTREND && idp->rtrend)
+   {
+   for(i=0;i<n;i++)
+      {
+      t = (i0+i)*st->dt;
+
+      y = st->rt_m0*t + st->rt_b0;
+      s[i] = s[i] - y;
+      }
+   }
+
+if(upto > IDS_RBASE && idp->rbase)
+   {
+   for(i=0;i<n;i++)
+      s[i] = s[i] - lsq_poly(st->bl_x0,idp->rbase+1,(i0+i)*st->bl_h - 1.0);
+   }
+
+if(upto > IDS_DMEAN)
+   {
+   for(it=i0;it<st->ndm && it<i0+n;it++)
+      s[it-i0] = st->dm[it];
+   }
+
+if(upto > IDS_DTREND && idp->dtrend && i0 == 0 && n > 0)
+   s[0] = s[0] - st->dt_b0/st->dt;
+
+if(upto > IDS_RMEAN && idp->rmean)
+   {
+   for(i=0;i<n;i++)
+      s[i] = s[i] - st->rm_sum;
+   }
+
+if(upto > IDS_T1T2 && st->tt_on)
+   {
+   for(i=0;i<n;i++)
+      {
+      it = i0 + i;
+      s[i] = s[i] - st->tt_m0;
+      if(it >= st->tt_it1 && it < st->tt_it2)
+         s[i] = s[i] - st->tt_am;
+      else if(it >= st->tt_it2)
+         s[i] = s[i] - st->tt_af;
+      }
+   }
+}
+
+/* reads the next block of at most chunk samples, rewinding first when i0=0 */
+static int ids_read(struct idstream *st,int i0,int upto)
+{
+int n;
+
+if(i0 == 0)
+   lseek(st->fdr,(off_t)(sizeof(struct statdata)),SEEK_SET);
+
+n = st->nt - i0;
+if(n > st->chunk)
+   n = st->chunk;
+
+reed(st->fdr,st->buf,n*sizeof(float));
+ids_apply(st,st->buf,i0,n,upto);
+
+return(n);
+}
+
+static void ids_retrend(struct idstream *st)
+{
+float t;
+float c0 = 0.0;
+float c1 = 0.0;
+float c2 = 0.0;
+float c3 = 0.0;
+int i, n, it;
+
+for(it=0;it<st->nt;it=it+n)
+   {
+   n = ids_read(st,it,IDS_RTREND);
+   for(i=0;i<n;i++)
+      {
+      t = (it+i)*st->dt;
+      c0 = c0 + t;
+      c1 = c1 + st->buf[i];
+      c2 = c2 + t*t;
+      c3 = c3 + t*st->buf[i];
+      }
+   }
+
+st->rt_m0 = (c0*c1 - st->nt*c3)/(c0*c0 - st->nt*c2);
+st->rt_b0 = (c0*c3 - c1*c2)/(c0*c0 - st->nt*c2);
+}
+
+static void ids_baseline(struct idstream *st)
+{
+double pt[4*(2*LSQ_MAXTERMS-1)], ps[4*LSQ_MAXTERMS];
+int i, n, it;
+
+for(i=0;i<4*(2*LSQ_MAXTERMS-1);i++)
+   pt[i] = 0.0;
+for(i=0;i<4*LSQ_MAXTERMS;i++)
+   ps[i] = 0.0;
+
+st->bl_h = lsq_grid_step(st->nt);
+for(it=0;it<st->nt;it=it+n)
+   {
+   n = ids_read(st,it,IDS_RBASE);
+   lsq_grid_sums(st->buf,it,n,st->bl_h,st->idp->rbase+1,pt,ps);
+   }
+
+lsq_solve_grid_sums(pt,ps,st->idp->rbase+1,st->bl_x0);
+}
+
+/* demean_sums(): one pass for the total, one up to the last changed sample */
+static void ids_demean_sums(struct idstream *st)
+{
+double tot, before, upto;
+float old;
+int i, j, n, it, test, ndmax;
+
+tot = 0.0;
+for(it=0;it<st->nt;it=it+n)
+   {
+   n = ids_read(st,it,IDS_DMEAN);
+   for(i=0;i<n;i++)
+      tot = tot + (double)(st->nt-(it+i))*st->buf[i];
+   }
+
+ndmax = 0;
+st->ndm = 0;
+
+before = 0.0;
+upto = 0.0;
+test = 1;
+for(it=0;it<st->nt && test;it=it+n)
+   {
+   n = ids_read(st,it,IDS_DMEAN);
+   for(i=0;i<n && test;i++)
+      {
+      j = it + i;
+      if(j == ndmax)
+         {
+         ndmax = ndmax + 64;
+         st->dm = (float *) check_realloc(st->dm,ndmax*sizeof(float));
+         }
+
+      old = st->buf[i];
+      upto = upto + (double)(st->nt-j)*old;
+
+      test = demean_step(old,before + (tot - upto),st->nt,j,st->idp->finaldisp,&st->dm[j]);
+      before = before + (double)(st->nt-j)*st->dm[j];
+      st->ndm = j + 1;
+      }
+   }
+}
+
+static void ids_demean(struct idstream *st)
+{
+float old, new, oabs, nabs, nsgn;
+float difp, tolp, tolm;
+float tol = 0.1;
+float sum = 0.0;
+int i, j, n, it, test, ndmax;
+
+tolp = 1.0 + tol;
+tolm = 1.0 - tol;
+
+ndmax = 0;
+st->ndm = 0;
+
+j = 0;
+test = 1;
+while(test)
+   {
+   old = 0.0;
+   sum = 0.0;
+   for(it=0;it<st->nt;it=it+n)
+      {
+      n = ids_read(st,it,IDS_DMEAN);
+      for(i=0;i<n;i++)
+         {
+         if(it+i < j)
+            sum = sum + (st->nt-(it+i))*st->dm[it+i];
+         else if(it+i == j)
+            old = st->buf[i];
+         else
+            sum = sum + (st->nt-(it+i))*st->buf[i];
+         }
+      }
+
+   new = st->idp->finaldisp - sum/(st->nt-j);
+   nabs = new;
+   nsgn = 1.0;
+   if(nabs < 0.0)
+      {
+      nsgn = -1.0;
+      nabs = -new;
+      }
+
+   oabs = old;
+   if(oabs < 0.0)
+      oabs = -old;
+
+   difp = nabs/oabs;
+   if(difp > tolp)
+      new = tolp*oabs*nsgn;
+   else if(difp < tolm)
+      new = tolm*oabs*nsgn;
+   else
+      test = 0;
+
+   if(j == ndmax)
+      {
+      ndmax = ndmax + 64;
+      st->dm = (float *) check_realloc(st->dm,ndmax*sizeof(float));
+      }
+   st->dm[j] = new;
+   j++;
+   st->ndm = j;
+   }
+}
+
+static void ids_detrend(struct idstream *st)
+{
+float s0;
+int i, n, it, np;
+
+np = st->nt/4;
+
+s0 = st->idp->init_val;
+st->dt_b0 = 0.0;
+for(it=0;it<st->nt;it=it+n)
+   {
+   n = ids_read(st,it,IDS_DTREND);
+   for(i=0;i<n;i++)
+      {
+      s0 = st->buf[i]*st->dt + s0;
+      if(it+i >= st->nt-np)
+         st->dt_b0 = st->dt_b0 + s0;
+      }
+   }
+
+st->dt_b0 = st->dt_b0/((float)(np));
+}
+
+static void ids_remean(struct idstream *st)
+{
+float *ts = &st->idp->tstart;
+float *tl = &st->idp->tlen;
+float dt = st->dt;
+int i, n, it, its, ite;
+float sum = 0.0;
+
+if(*ts < 0.0)
+   its = 0;
+else
+   its = (*ts)/dt;
+
+if(its < 0)
+   its = 0;
+
+if(*tl < 0.0)
+   ite = st->nt;
+else
+   ite = its + (*tl)/dt;
+
+if(ite > st->nt)
+   ite = st->nt;
+
+sum = 0.0;
+for(it=0;it<ite;it=it+n)
+   {
+   n = ids_read(st,it,IDS_RMEAN);
+   for(i=0;i<n;i++)
+      {
+      if(it+i >= its && it+i < ite)
+         sum = sum + st->buf[i];
+      }
+   }
+
+st->rm_sum = sum/(float)(ite-its);
+}
+
+static void ids_t1t2(struct idstream *st)
+{
+struct integ_diff_par *idp = st->idp;
+float t1 = idp->t1;
+float t2 = idp->t2;
+float tf1 = idp->tf1;
+float tf2 = idp->tf2;
+float dt = st->dt;
+int nt = st->nt;
+int i, n, it, it1, it2, itf1, itf2;
+float m0, mean, af, am;
+float b0, t, v;
+float c0 = 0.0;
+float c1 = 0.0;
+float c2 = 0.0;
+float c3 = 0.0;
+
+st->tt_on = 0;
+
+/* first and last sample above 50 */
+if(t1 < 0.0 || t2 < 0.0)
+   {
+   m0 = 50.0;
+   for(it=0;it<nt;it=it+n)
+      {
+      n = ids_read(st,it,IDS_T1T2);
+      for(i=0;i<n;i++)
+         {
+         if(st->buf[i] > m0 || -st->buf[i] > m0)
+            {
+            if(idp->t1 < 0.0 && t1 < 0.0)
+               t1 = (it+i)*dt;
+            if(idp->t2 < 0.0)
+               t2 = (it+i)*dt;
+            }
+         }
+      }
+   }
+
+if(t2 > (nt-1)*dt)
+   t2 = 0.5*(t1 + nt*dt);
+
+if(tf2 < 0.0)
+   tf2 = nt*dt;
+if(tf1 < 0.0)
+   tf1 = t2 + 0.1*(tf2 - t2);
+
+it1 = (int)(t1/dt + 1.5);
+it2 = (int)(t2/dt + 1.5);
+itf1 = (int)(tf1/dt + 1.5);
+itf2 = (int)(tf2/dt + 1.5);
+
+if(it1 < 0 || it1 >= nt)
+   return;
+if(it2 < 0 || it2 >= nt)
+   return;
+if(it2 < it1)
+   return;
+
+if(itf2 > nt)
+   itf2 = nt;
+
+m0 = 0.0;
+for(it=0;it<it1/2;it=it+n)
+   {
+   n = ids_read(st,it,IDS_T1T2);
+   for(i=0;i<n && it+i<it1/2;i++)
+      m0 = m0 + st->buf[i];
+   }
+
+m0 = m0/(float)(it1/2);
+mean = m0;
+
+/* line fit to the integral over tf1 ... tf2 */
+v = 0.0;
+for(it=0;it<itf2;it=it+n)
+   {
+   n = ids_read(st,it,IDS_T1T2);
+   for(i=0;i<n && it+i<itf2;i++)
+      {
+      v = (st->buf[i] - m0)*dt + v;
+      if(it+i >= itf1)
+         {
+         t = (it+i)*dt;
+         c0 = c0 + t;
+         c1 = c1 + v;
+         c2 = c2 + t*t;
+         c3 = c3 + t*v;
+         }
+      }
+   }
+
+af = (c0*c1 - (itf2-itf1)*c3)/(c0*c0 - (itf2-itf1)*c2);
+b0 = (c0*c3 - c1*c2)/(c0*c0 - (itf2-itf1)*c2);
+
+if(idp->v0correct)
+   {
+   m0 = -b0/af;
+   if(m0 > t1 && m0 < tf2)
+      t2 = m0;
+
+   it2 = (int)(t2/dt + 1.5);
+   }
+
+fprintf(stderr,"t1= %f t2= %f tf1= %f tf2= %f\n",t1,t2,tf1,tf2);
+
+am = (af*t2 + b0)/(t2 - t1);
+
+st->tt_on = 1;
+st->tt_it1 = it1;
+st->tt_it2 = it2;
+st->tt_m0 = mean;
+st->tt_am = am;
+st->tt_af = af;
+}
+
+void integ_diff_stream(struct integ_diff_par* idp, char* infile, char* outfile, int chunk)
+{
+struct idstream st;
+struct statdata shead;
+float *s;
+float ts0, te0, ts1, te1, fac0, fac1, s0, c0, prev, cur;
+int i, n, it, fdw, it0, it1, it2, it3;
+float pi = 3.14159265;
+
+if(chunk < 1)
+   chunk = 1;
+
+if(idp->fdomain)
+   {
+   fprintf(stderr,"integ_diff_stream: fdomain=1 transforms the whole trace, it cannot be used with chunk=, exiting...\n");
+   exit(-1);
+   }
+
+st.idp = idp;
+st.chunk = chunk;
+st.ndm = 0;
+st.dm = NULL;
+st.tt_on = 0;
+
+if(strcmp(infile,"stdin") == 0)
+   {
+   if(idp->rtrend || idp->rbase || idp->dmean || idp->dtrend || idp->rmean || idp->boorebase)
+      {
+      fprintf(stderr,"integ_diff_stream: rtrend/rbase/dmean/dtrend/rmean/boorebase reread the input, it cannot be stdin, exiting...\n");
+      exit(-1);
+      }
+   st.fdr = STDIN_FILENO;
+   }
+else
+   st.fdr = opfile_ro(infile);
+
+reed(st.fdr,&shead,sizeof(struct statdata));
+st.nt = shead.nt;
+st.dt = shead.dt;
+st.buf = (float *) check_malloc(chunk*sizeof(float));
+
+if(idp->rtrend)
+   ids_retrend(&st);
+if(idp->rbase)
+   ids_baseline(&st);
+if(idp->dmean == 2)
+   ids_demean_sums(&st);
+else if(idp->dmean)
+   ids_demean(&st);
+if(idp->dtrend)
+   ids_detrend(&st);
+if(idp->rmean)
+   ids_remean(&st);
+if(idp->boorebase)
+   ids_t1t2(&st);
+
+/* taper window as in integ_diff_apply() and tapr() */
+ts0 = idp->ts0;
+te0 = idp->te0;
+ts1 = idp->ts1;
+te1 = idp->te1;
+if(idp->taper)
+   {
+   if(idp->tfront > 0.0)
+      {
+      ts0 = 0.0;
+      te0 = idp->tfront;
+      }
+   if(idp->tend > 0.0)
+      {
+      ts1 = shead.nt*shead.dt - idp->tend;
+      te1 = shead.nt*shead.dt;
+      }
+   }
+it0 = (int)(ts0/shead.dt);
+it1 = (int)(te0/shead.dt);
+it2 = (int)(ts1/shead.dt);
+it3 = (int)(te1/shead.dt);
+if(it3 > st.nt)
+   it3 = st.nt;
+fac0 = pi/(float)(it1-it0);
+fac1 = pi/(float)(it3-it2);
+
+if(strcmp(outfile,"stdout") == 0)
+   fdw = STDOUT_FILENO;
+else
+   fdw = croptrfile(outfile);
+rite(fdw,&shead,sizeof(struct statdata));
+
+s0 = idp->init_val;
+prev = idp->init_val;
+c0 = 1.0/shead.dt;
+
+s = st.buf;
+for(it=0;it<st.nt;it=it+n)
+   {
+   if(st.fdr == STDIN_FILENO)
+      {
+      n = st.nt - it;
+      if(n > chunk)
+         n = chunk;
+      reed(st.fdr,s,n*sizeof(float));
+      ids_apply(&st,s,it,n,IDS_ALL);
+      }
+   else
+      n = ids_read(&st,it,IDS_ALL);
+
+   if(idp->integ)
+      {
+      for(i=0;i<n;i++)
+         {
+         s0 = s[i]*shead.dt + s0;
+         s[i] = s0;
+         }
+      }
+
+   if(idp->diff)
+      {
+      for(i=0;i<n;i++)
+         {
+         cur = s[i];
+         s[i] = (cur - prev)*c0;
+         prev = cur;
+         }
+      }
+
+   if(idp->taper)
+      {
+      for(i=0;i<n;i++)
+         {
+         if(it+i < it0)
+            s[i] = 0.0;
+         else if(it+i < it1)
+            s[i] = s[i]*0.5*(1.0 - cos((it+i-it0)*fac0));
+
+         if(it2 < st.nt)
+            {
+            if(it+i >= it3)
+               s[i] = 0.0;
+            else if(it+i >= it2)
+               s[i] = s[i]*0.5*(1.0 + cos((it+i-it2)*fac1));
+            }
+         }
+      }
+
+   for(i=0;i<n;i++)
+      s[i] = idp->scale*s[i];
+
+   rite(fdw,s,n*sizeof(float));
+   }
+
+if(st.fdr != STDIN_FILENO)
+   close(st.fdr);
+close(fdw);
+
+free(st.buf);
+if(st.dm != NULL)
+   free(st.dm);
+}
@@ -2,11 +2,284 @@
 #include        "structure.h"
 #include        "function.h"
 
+/* largest single read()/write() done by reed() and rite() */
+#define RW_CHUNK 16777216
+
+/* bytes read and then swapped at a time by reed_swap() */
+#define SWAP_CHUNK 262144
+
+/* span read at a time by read_wccrange() for decimated samples */
+#define WCC_RANGE_BLOCK 262144
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+static int wccpack_lookup(struct wccpack *,char *,char *,char *);
+
+/*
+   Fast text path of read_wccseis() and write_wccseis().  The samples
+   are parsed from, and formatted into, one memory block instead of one
+   fscanf()/fprintf() call per value.  The results are exactly those of
+   strtof() and "%13.5e" (format_e()): the fast paths use double
+   arithmetic and any value where that could round differently (ties,
+   long mantissas, denormals, inf/nan, ...) goes through the C library
+   instead.
+*/
+#define P10_MIN -40
+#define P10_MAX 60
+
+static const double p10[] = {
+   1e-40, 1e-39, 1e-38, 1e-37, 1e-36, 1e-35, 1e-34, 1e-33,
+   1e-32, 1e-31, 1e-30, 1e-29, 1e-28, 1e-27, 1e-26, 1e-25,
+   1e-24, 1e-23, 1e-22, 1e-21, 1e-20, 1e-19, 1e-18, 1e-17,
+   1e-16, 1e-15, 1e-14, 1e-13, 1e-12, 1e-11, 1e-10, 1e-9,
+   1e-8, 1e-7, 1e-6, 1e-5, 1e-4, 1e-3, 1e-2, 1e-1,
+   1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+   1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+   1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22, 1e23,
+   1e24, 1e25, 1e26, 1e27, 1e28, 1e29, 1e30, 1e31,
+   1e32, 1e33, 1e34, 1e35, 1e36, 1e37, 1e38, 1e39,
+   1e40, 1e41, 1e42, 1e43, 1e44, 1e45, 1e46, 1e47,
+   1e48, 1e49, 1e50, 1e51, 1e52, 1e53, 1e54, 1e55,
+   1e56, 1e57, 1e58, 1e59, 1e60
+   };
+
+/* reads the rest of fp into one null terminated block */
+static char *slurp_file(FILE *fp,size_t *len)
+{
+char *buf;
+size_t nalloc, nr;
+
+nalloc = 1048576;
+buf = (char *) check_malloc(nalloc);
+*len = 0;
+while((nr = fread(buf + *len,1,nalloc - *len - 1,fp)) > 0)
+   {
+   *len = *len + nr;
+   if(nalloc - *len - 1 == 0)
+      {
+      nalloc = 2*nalloc;
+      buf = (char *) check_realloc(buf,nalloc);
+      }
+   }
+buf[*len] = '\0';
+return(buf);
+}
+
+/*
+   Parses the float at *pp (leading white space skipped) as strtof()
+   does and moves *pp past it.  Returns 0 if there is no number.
+*/
+static int parse_float(char **pp,float *val)
+{
+char *p, *p0, *end;
+unsigned long long m;
+int neg, nd, nexp, eneg, e10;
+double d, back, next;
+float f;
+
+p = *pp;
+while(*p == ' ' || *p == '\n' || *p == '\t' || *p == '\r' || *p == '\v' || *p == '\f')
+   p++;
+p0 = p;
+
+neg = 0;
+if(*p == '-' || *p == '+')
+   {
+   neg = (*p == '-');
+   p++;
+   }
+
+m = 0;
+nd = 0;
+e10 = 0;
+while(*p >= '0' && *p <= '9')
+   {
+   m = 10*m + (*p - '0');
+   if(m) nd++;
+   p++;
+   }
+if(*p == '.')
+   {
+   p++;
+   while(*p >= '0' && *p <= '9')
+      {
+      m = 10*m + (*p - '0');
+      if(m) nd++;
+      e10--;
+      p++;
+      }
+   }
+
+if(p == p0 + neg || (p == p0 + neg + 1 && p[-1] == '.') || nd > 19)
+   goto slow;
+if((*p == 'e' || *p == 'E') && p > p0)
+   {
+   p++;
+   eneg = 0;
+   if(*p == '-' || *p == '+')
+      {
+      eneg = (*p == '-');
+      p++;
+      }
+   if(*p < '0' || *p > '9')
+      goto slow;
+   nexp = 0;
+   while(*p >= '0' && *p <= '9' && nexp < 10000)
+      {
+      nexp = 10*nexp + (*p - '0');
+      p++;
+      }
+   if(eneg)
+      nexp = -nexp;
+   e10 = e10 + nexp;
+   }
+if(*p != '\0' && *p != ' ' && *p != '\n' && *p != '\t' && *p != '\r' && *p != '\v' && *p != '\f')
+   goto slow;
+
+/* m and 10^|e10| are exact doubles, so d is correctly rounded */
+if(m == 0)
+   d = 0.0;
+else if(m < (1ULL << 53) && e10 >= -22 && e10 <= 22)
+   d = (e10 >= 0) ? (double) m * p10[e10 - P10_MIN] : (double) m / p10[-e10 - P10_MIN];
+else
+   goto slow;
+
+/* rounding d to float differs from strtof only when d is a midpoint */
+f = (float) d;
+if(d != 0.0 && (fabs(d) < FLT_MIN || fabs(d) > FLT_MAX))
+   goto slow;
+back = (double) f;
+if(d != back)
+   {
+   next = (double) nextafterf(f,(d > back) ? FLT_MAX : -FLT_MAX);
+   if(2.0*(d - back) == next - back)
+      goto slow;
+   }
+
+*val = neg ? -f : f;
+*pp = p;
+return(1);
+
+slow:
+*val = strtof(p0,&end);
+*pp = end;
+return(end != p0);
+}
+
+/*
+   Writes v as "%<width>.<prec>e" does, returns the position after it.
+   p needs room for width or prec+9 characters, whichever is more.  The
+   fast path is taken for prec <= 8 (the digits fit in a double with
+   room for the tie test); write_wccseis() and wcc2bbp use it.
+*/
+char *format_e(char *p,double v,int width,int prec)
+{
+double a, q, fl;
+long long n;
+int e10, nexp, k, len, neg;
+
+a = fabs(v);
+if(prec < 0 || prec > 8 || !(a <= DBL_MAX))
+   goto slow;
+
+if(a == 0.0)
+   {
+   n = 0;
+   e10 = 0;
+   }
+else
+   {
+   frexp(a,&nexp);
+   e10 = (int) floor((nexp - 1)*0.30102999566398120);
+   for(k=0;k<3;k++)
+      {
+      if(prec - e10 < P10_MIN || prec - e10 > P10_MAX)
+         goto slow;
+      q = a*p10[prec - e10 - P10_MIN];
+      if(q >= p10[prec + 1 - P10_MIN] - 0.5)
+         e10++;
+      else if(q < p10[prec - P10_MIN] - 0.5)
+         e10--;
+      else
+         break;
+      }
+   if(k == 3)
+      goto slow;
+
+   /* too close to a tie for q to decide the last digit */
+   fl = floor(q);
+   if(fabs(q - fl - 0.5) < 1.0e-6)
+      goto slow;
+   n = (long long) (q + 0.5);
+   }
+
+neg = (v < 0.0 || (v == 0.0 && signbit(v)));
+len = neg + 1 + (prec > 0 ? prec + 1 : 0) + 2 + (e10 <= -100 || e10 >= 100 ? 3 : 2);
+for(;width>len;width--)
+   *p++ = ' ';
+
+if(neg)
+   *p++ = '-';
+for(k=prec;k>=1;k--)
+   {
+   p[k + 1] = '0' + n%10;
+   n = n/10;
+   }
+p[0] = '0' + n;
+if(prec > 0)
+   {
+   p[1] = '.';
+   p = p + prec + 2;
+   }
+else
+   p = p + 1;
+
+*p++ = 'e';
+*p++ = (e10 < 0) ? '-' : '+';
+if(e10 < 0)
+   e10 = -e10;
+if(e10 >= 100)
+   {
+   *p++ = '0' + e10/100;
+   e10 = e10%100;
+   }
+*p++ = '0' + e10/10;
+*p++ = '0' + e10%10;
+return(p);
+
+slow:
+k = (width > prec + 9) ? width : prec + 9;
+snprintf(p,k + 1,"%*.*e",width,prec,v);
+return(p + strlen(p));
+}
+
 float *read_wccseis(char *ifile,struct statdata *shead,float *s,int bflag)
 {
 FILE *fpr;
 int fdr, nt6, i, j;
 char header1[1024];
+char *buf, *pb;
+size_t blen;
+char pname[1024], pstat[STATCHAR], pcomp[COMPCHAR];
+struct wccpack *wp;
+double t0;
+
+t0 = prof_start();
+if(wccpack_path(ifile,pname,pstat,pcomp))
+   {
+   wp = wccpack_open(pname,0);
+   s = wccpack_read(wp,wccpack_lookup(wp,pname,pstat,pcomp),shead,s);
+   wccpack_close(wp);
+   prof_io("read_wccseis",sizeof(struct statdata) + shead->nt*sizeof(float),0);
+   prof_stop("read_wccseis",t0,shead->nt);
+   return(s);
+   }
 
 shead->hr = 0;
 shead->min = 0;
@@ -23,9 +296,15 @@ if(bflag)
       fdr = opfile_ro(ifile);
 
    reed(fdr,shead,sizeof(struct statdata));
-   s = (float *) check_realloc(s,shead->nt*sizeof(float));
-   reed(fdr,s,shead->nt*sizeof(float));
+   if(wccz_check(shead))
+      s = wccz_read(fdr,(char *) shead,sizeof(struct statdata),shead,s,0,INT_MAX,1,&i);
+   else
+      {
+      s = (float *) check_realloc(s,shead->nt*sizeof(float));
+      reed(fdr,s,shead->nt*sizeof(float));
+      }
    close(fdr);
+   prof_io("read_wccseis",sizeof(struct statdata) + shead->nt*sizeof(float),0);
    }
 else
    {
@@ -49,15 +328,525 @@ else
 
    s = (float *) check_realloc(s,shead->nt*sizeof(float));
 
+   buf = slurp_file(fpr,&blen);
+   pb = buf;
    for(i=0;i<shead->nt;i++)
-      fscanf(fpr,"%f",&s[i]);
+      {
+      if(!parse_float(&pb,&s[i]))
+         break;
+      }
+   free(buf);
+
+   fclose(fpr);
+   prof_io("read_wccseis",blen,0);
+   }
+
+prof_stop("read_wccseis",t0,shead->nt);
+return(s);
+}
+
+/*
+   Header of the WCC trace ifile only (a binary file or pack trace reads
+   sizeof(struct statdata) bytes, text the two header lines).  Returns 0
+   without reading for stdin, whose samples would then be lost, so the
+   caller falls back to read_wccseis().
+*/
+int read_wcchead(char *ifile,struct statdata *shead,int bflag)
+{
+FILE *fpr;
+int fdr, ns;
+char header1[1024];
+char pname[1024], pstat[STATCHAR], pcomp[COMPCHAR];
+struct wccpack *wp;
+
+if(strcmp(ifile,"stdin") == 0)
+   return(0);
+
+if(wccpack_path(ifile,pname,pstat,pcomp))
+   {
+   wp = wccpack_open(pname,0);
+   lseek(wp->fd,wp->index[wccpack_lookup(wp,pname,pstat,pcomp)].offset,SEEK_SET);
+   reed(wp->fd,shead,sizeof(struct statdata));
+   wccpack_close(wp);
+   return(1);
+   }
+
+shead->hr = 0;
+shead->min = 0;
+shead->sec = 0;
+shead->edist = 0;
+shead->az = 0;
+shead->baz = 0;
+
+if(bflag)
+   {
+   if((fdr = opfile_ro(ifile)) < 0)
+      exit(-1);
+   reed(fdr,shead,sizeof(struct statdata));
+   if(wccz_check(shead))
+      free(wccz_read(fdr,(char *) shead,sizeof(struct statdata),shead,NULL,0,0,1,&ns));
+   close(fdr);
+   }
+else
+   {
+   fpr = fopfile(ifile,"r");
+   fgets(header1,1024,fpr);
+   getheader(header1,shead);
+
+   fgets(header1,1024,fpr);
+   sscanf(header1,"%d %f %d %d %f %f %f %f",&shead->nt,
+                                            &shead->dt,
+                                            &shead->hr,
+                                            &shead->min,
+                                            &shead->sec,
+                                            &shead->edist,
+                                            &shead->az,
+                                            &shead->baz);
+   fclose(fpr);
+   }
+return(1);
+}
+
+/*
+   Samples it0, it0+itskip, ... (before it1) of the WCC trace ifile into
+   s (reallocated), their number in *ns; it0 and it1 are clamped to
+   [0,nt] and shead gets the header of the whole trace.  A binary file
+   or pack trace is read over that span only: in blocks of
+   WCC_RANGE_BLOCK bytes when the samples are close, one read per sample
+   when itskip is larger than that.  Text is parsed only up to it1.
+   Not for stdin (see read_wcchead()).
+*/
+float *read_wccrange(char *ifile,struct statdata *shead,float *s,int bflag,int it0,int it1,int itskip,int *ns)
+{
+FILE *fpr;
+int fdr, nb, nc, i, k;
+off_t base;
+float *buf, v;
+char header1[1024];
+char *tbuf, *pb;
+size_t blen;
+char pname[1024], pstat[STATCHAR], pcomp[COMPCHAR];
+struct wccpack *wp;
+double t0;
 
+t0 = prof_start();
+if(itskip < 1)
+   itskip = 1;
+
+wp = NULL;
+fpr = NULL;
+if(wccpack_path(ifile,pname,pstat,pcomp))
+   {
+   wp = wccpack_open(pname,0);
+   fdr = wp->fd;
+   base = wp->index[wccpack_lookup(wp,pname,pstat,pcomp)].offset;
+   lseek(fdr,base,SEEK_SET);
+   reed(fdr,shead,sizeof(struct statdata));
+   base = base + sizeof(struct statdata);
+   }
+else if(bflag)
+   {
+   if((fdr = opfile_ro(ifile)) < 0)
+      exit(-1);
+   reed(fdr,shead,sizeof(struct statdata));
+   base = sizeof(struct statdata);
+
+   if(wccz_check(shead))
+      {
+      s = wccz_read(fdr,(char *) shead,sizeof(struct statdata),shead,s,it0,it1,itskip,ns);
+      close(fdr);
+      prof_stop("read_wccrange",t0,*ns);
+      return(s);
+      }
+   }
+else
+   {
+   read_wcchead(ifile,shead,0);
+   fpr = fopfile(ifile,"r");
+   fgets(header1,1024,fpr);
+   fgets(header1,1024,fpr);
+   }
+
+if(it0 < 0)
+   it0 = 0;
+if(it1 > shead->nt)
+   it1 = shead->nt;
+
+*ns = 0;
+if(it1 > it0)
+   *ns = (it1 - it0 + itskip - 1)/itskip;
+
+s = (float *) check_realloc(s,(*ns + 1)*sizeof(float));
+
+if(fpr != NULL)
+   {
+   tbuf = slurp_file(fpr,&blen);
    fclose(fpr);
+
+   pb = tbuf;
+   k = 0;
+   for(i=0;i<it1 && k<*ns;i++)
+      {
+      if(!parse_float(&pb,&v))
+         break;
+      if(i >= it0 && (i - it0)%itskip == 0)
+         s[k++] = v;
+      }
+   free(tbuf);
+
+   prof_io("read_wccrange",blen,0);
+   prof_stop("read_wccrange",t0,*ns);
+   return(s);
+   }
+
+if(itskip == 1)
+   {
+   lseek(fdr,base + (off_t) it0*sizeof(float),SEEK_SET);
+   reed(fdr,s,*ns*sizeof(float));
+   }
+else if(itskip*sizeof(float) > WCC_RANGE_BLOCK)
+   {
+   for(k=0;k<*ns;k++)
+      {
+      if(pread(fdr,&s[k],sizeof(float),base + ((off_t) it0 + (off_t) k*itskip)*sizeof(float)) != sizeof(float))
+         s[k] = 0.0;
+      }
+   }
+else
+   {
+   nb = (WCC_RANGE_BLOCK/sizeof(float))/itskip;
+   buf = (float *) check_malloc(nb*itskip*sizeof(float));
+
+   lseek(fdr,base + (off_t) it0*sizeof(float),SEEK_SET);
+   for(k=0;k<*ns;k=k+nb)
+      {
+      nc = nb;
+      if(k + nc > *ns)
+         nc = *ns - k;
+
+      /* the last block stops at its last sample */
+      reed(fdr,buf,((nc - 1)*itskip + 1)*sizeof(float));
+      if(k + nc < *ns)
+         lseek(fdr,(off_t) (itskip - 1)*sizeof(float),SEEK_CUR);
+
+      for(i=0;i<nc;i++)
+         s[k+i] = buf[i*itskip];
+      }
+   free(buf);
+   }
+
+if(wp != NULL)
+   wccpack_close(wp);
+else
+   close(fdr);
+
+prof_io("read_wccrange",sizeof(struct statdata) + (size_t) *ns*itskip*sizeof(float),0);
+prof_stop("read_wccrange",t0,*ns);
+return(s);
+}
+
+/*
+   Binary WCC trace without copying: the file is mapped (private, so
+   the samples can be changed in memory) and wm->shead and wm->s point
+   into the mapping.  Input that cannot be mapped, e.g. stdin or a
+   pipe, and compressed files (wcczip.c) are read into one malloc'd
+   block with the same layout.  Returns
+   wm->s; release with unmap_wccseis().
+*/
+float *map_wccseis(char *ifile,struct wccmap *wm)
+{
+struct statdata head;
+struct stat sbuf;
+size_t hlen, dlen;
+float *s;
+int fdr, itr, ns;
+char pname[1024], pstat[STATCHAR], pcomp[COMPCHAR];
+struct wccpack *wp;
+
+hlen = sizeof(struct statdata);
+
+if(wccpack_path(ifile,pname,pstat,pcomp))
+   {
+   wp = wccpack_open(pname,0);
+   itr = wccpack_lookup(wp,pname,pstat,pcomp);
+
+   wm->len = 0;
+   wm->base = check_malloc(hlen + wp->index[itr].nt*sizeof(float));
+   wm->shead = (struct statdata *) wm->base;
+   wm->s = (float *) ((char *) wm->base + hlen);
+   lseek(wp->fd,wp->index[itr].offset,SEEK_SET);
+   reed(wp->fd,wm->base,hlen + wp->index[itr].nt*sizeof(float));
+
+   wccpack_close(wp);
+   return(wm->s);
+   }
+
+if(strcmp(ifile,"stdin") == 0)
+   fdr = STDIN_FILENO;
+else
+   fdr = opfile_ro(ifile);
+
+if(fdr < 0)
+   exit(-1);
+
+wm->len = 0;
+if(fstat(fdr,&sbuf) == 0 && S_ISREG(sbuf.st_mode) && sbuf.st_size >= hlen)
+   {
+   wm->base = mmap(NULL,sbuf.st_size,PROT_READ | PROT_WRITE,MAP_PRIVATE,fdr,0);
+   if(wm->base != MAP_FAILED)
+      wm->len = sbuf.st_size;
+   }
+
+if(wm->len && wccz_check(wm->base))
+   {
+   munmap(wm->base,wm->len);
+   wm->len = 0;
+   lseek(fdr,0,SEEK_SET);
+   reed(fdr,&head,hlen);
+   }
+else if(!wm->len)
+   reed(fdr,&head,hlen);
+
+if(wm->len)
+   {
+   wm->shead = (struct statdata *) wm->base;
+   wm->s = (float *) ((char *) wm->base + hlen);
+
+   dlen = wm->shead->nt*sizeof(float);
+   if(wm->shead->nt < 0 || hlen + dlen > wm->len)
+      {
+      fprintf(stderr,"FILE %s TOO SHORT FOR nt= %d\n",ifile,wm->shead->nt);
+      exit(-1);
+      }
+   }
+else if(wccz_check(&head))
+   {
+   s = wccz_read(fdr,(char *) &head,hlen,&head,NULL,0,INT_MAX,1,&ns);
+   dlen = head.nt*sizeof(float);
+
+   wm->base = check_malloc(hlen + dlen);
+   wm->shead = (struct statdata *) wm->base;
+   wm->s = (float *) ((char *) wm->base + hlen);
+
+   *(wm->shead) = head;
+   memcpy(wm->s,s,dlen);
+   free(s);
+   }
+else
+   {
+   dlen = head.nt*sizeof(float);
+
+   wm->base = check_malloc(hlen + dlen);
+   wm->shead = (struct statdata *) wm->base;
+   wm->s = (float *) ((char *) wm->base + hlen);
+
+   *(wm->shead) = head;
+   reed(fdr,wm->s,dlen);
+   }
+
+close(fdr);
+return(wm->s);
+}
+
+void unmap_wccseis(struct wccmap *wm)
+{
+if(wm->len)
+   munmap(wm->base,wm->len);
+else
+   free(wm->base);
+
+wm->base = NULL;
+wm->shead = NULL;
+wm->s = NULL;
+}
+
+/*
+   WCC packs (see structure.h).  A path "pack:stat/comp" given to
+   read_wccseis(), write_wccseis() or map_wccseis() names the trace
+   stat/comp of the pack file "pack", so every tool can read and write
+   packs without changes.  wccpack_path() splits such a path, returning
+   0 for ordinary file names (a file that exists is never a pack path).
+*/
+int wccpack_path(char *path,char *pname,char *stat,char *comp)
+{
+char *colon, *slash;
+int len;
+
+colon = strrchr(path,':');
+if(colon == NULL || colon == path || access(path,F_OK) == 0)
+   return(0);
+
+slash = strchr(colon+1,'/');
+if(slash == NULL || slash == colon+1 || slash[1] == '\0')
+   return(0);
+
+len = colon - path;
+strncpy(pname,path,len);
+pname[len] = '\0';
+
+len = slash - (colon+1);
+if(len > STATCHAR-1)
+   len = STATCHAR-1;
+strncpy(stat,colon+1,len);
+stat[len] = '\0';
+
+strncpy(comp,slash+1,COMPCHAR-1);
+comp[COMPCHAR-1] = '\0';
+
+return(1);
+}
+
+/*
+   Opens a pack and loads its index.  With wflag the pack is created if
+   needed and locked for writing, and wccpack_close() writes the new
+   index.
+*/
+struct wccpack *wccpack_open(char *pname,int wflag)
+{
+struct wccpack *wp;
+struct wccpack_trailer tr;
+struct stat sbuf;
+
+wp = (struct wccpack *) check_malloc(sizeof(struct wccpack));
+wp->wflag = wflag;
+wp->ntrace = 0;
+wp->nalloc = 0;
+wp->index = NULL;
+wp->index_offset = sizeof(tr.magic);
+
+if(wflag)
+   {
+   if((wp->fd = open(pname,O_CREAT | RDWR_FLAGS,0664)) == -1)
+      {
+      fprintf(stderr,"CAN'T OPEN FILE %s\n",pname);
+      exit(-1);
+      }
+   flock(wp->fd,LOCK_EX);
+   }
+else
+   {
+   if((wp->fd = opfile_ro(pname)) == -1)
+      exit(-1);
+   }
+
+fstat(wp->fd,&sbuf);
+if(sbuf.st_size == 0 && wflag)
+   {
+   rite(wp->fd,WCCPACK_MAGIC,sizeof(tr.magic));
+   return(wp);
+   }
+
+if(sbuf.st_size < sizeof(tr.magic) + sizeof(tr))
+   {
+   fprintf(stderr,"%s IS NOT A WCC PACK\n",pname);
+   exit(-1);
    }
 
+lseek(wp->fd,sbuf.st_size - sizeof(tr),SEEK_SET);
+reed(wp->fd,&tr,sizeof(tr));
+if(strncmp(tr.magic,WCCPACK_MAGIC,sizeof(tr.magic)) != 0)
+   {
+   fprintf(stderr,"%s IS NOT A WCC PACK\n",pname);
+   exit(-1);
+   }
+
+wp->ntrace = tr.ntrace;
+wp->nalloc = tr.ntrace;
+wp->index_offset = tr.index_offset;
+wp->index = (struct wccpack_index *) check_malloc((wp->nalloc + 1)*sizeof(struct wccpack_index));
+
+lseek(wp->fd,wp->index_offset,SEEK_SET);
+reed(wp->fd,wp->index,wp->ntrace*sizeof(struct wccpack_index));
+
+return(wp);
+}
+
+void wccpack_close(struct wccpack *wp)
+{
+struct wccpack_trailer tr;
+
+if(wp->wflag)
+   {
+   memset(&tr,0,sizeof(tr));
+   tr.index_offset = wp->index_offset;
+   tr.ntrace = wp->ntrace;
+   memcpy(tr.magic,WCCPACK_MAGIC,sizeof(tr.magic));
+
+   lseek(wp->fd,wp->index_offset,SEEK_SET);
+   rite(wp->fd,wp->index,wp->ntrace*sizeof(struct wccpack_index));
+   rite(wp->fd,&tr,sizeof(tr));
+   ftruncate(wp->fd,lseek(wp->fd,0,SEEK_CUR));
+   }
+
+close(wp->fd);
+free(wp->index);
+free(wp);
+}
+
+/* index of the latest trace stat/comp in the pack, -1 if none */
+int wccpack_find(struct wccpack *wp,char *stat,char *comp)
+{
+int i;
+
+for(i=wp->ntrace-1;i>=0;i--)
+   {
+   if(strncmp(wp->index[i].stat,stat,STATCHAR) == 0 &&
+      strncmp(wp->index[i].comp,comp,COMPCHAR) == 0)
+      return(i);
+   }
+return(-1);
+}
+
+/* reads trace itr of the pack, s is reallocated as in read_wccseis() */
+float *wccpack_read(struct wccpack *wp,int itr,struct statdata *shead,float *s)
+{
+lseek(wp->fd,wp->index[itr].offset,SEEK_SET);
+reed(wp->fd,shead,sizeof(struct statdata));
+s = (float *) check_realloc(s,shead->nt*sizeof(float));
+reed(wp->fd,s,shead->nt*sizeof(float));
+
 return(s);
 }
 
+/* appends a trace to a pack opened for writing, indexed as stat/comp */
+void wccpack_add(struct wccpack *wp,char *stat,char *comp,struct statdata *shead,float *s)
+{
+struct wccpack_index *ip;
+
+if(wp->ntrace == wp->nalloc)
+   {
+   wp->nalloc = 2*wp->nalloc + 16;
+   wp->index = (struct wccpack_index *) check_realloc(wp->index,wp->nalloc*sizeof(struct wccpack_index));
+   }
+
+ip = wp->index + wp->ntrace;
+memset(ip,0,sizeof(struct wccpack_index));
+strncpy(ip->stat,stat,STATCHAR-1);
+strncpy(ip->comp,comp,COMPCHAR-1);
+ip->nt = shead->nt;
+ip->offset = wp->index_offset;
+
+lseek(wp->fd,wp->index_offset,SEEK_SET);
+rite(wp->fd,shead,sizeof(struct statdata));
+rite(wp->fd,s,shead->nt*sizeof(float));
+
+wp->index_offset = wp->index_offset + sizeof(struct statdata) + shead->nt*sizeof(float);
+wp->ntrace++;
+}
+
+/* trace stat/comp of pack pname, exits if it is not there */
+static int wccpack_lookup(struct wccpack *wp,char *pname,char *stat,char *comp)
+{
+int itr;
+
+if((itr = wccpack_find(wp,stat,comp)) < 0)
+   {
+   fprintf(stderr,"TRACE %s/%s NOT IN WCC PACK %s\n",stat,comp,pname);
+   exit(-1);
+   }
+return(itr);
+}
+
 void getheader(char *str,struct statdata *hd)
 {
 int i;
@@ -119,6 +908,21 @@ void write_wccseis(char *ofile,struct statdata *shead,float *s,int bflag)
 {
 FILE *fpw;
 int fdw, nt6, i, j;
+char *buf, *pb;
+char pname[1024], pstat[STATCHAR], pcomp[COMPCHAR];
+struct wccpack *wp;
+double t0;
+
+t0 = prof_start();
+if(wccpack_path(ofile,pname,pstat,pcomp))
+   {
+   wp = wccpack_open(pname,1);
+   wccpack_add(wp,pstat,pcomp,shead,s);
+   wccpack_close(wp);
+   prof_io("write_wccseis",0,sizeof(struct statdata) + shead->nt*sizeof(float));
+   prof_stop("write_wccseis",t0,shead->nt);
+   return;
+   }
 
 if(bflag)
    {
@@ -127,8 +931,14 @@ if(bflag)
    else
       fdw = croptrfile(ofile);
 
-   rite(fdw,shead,sizeof(struct statdata));
-   rite(fdw,s,shead->nt*sizeof(float));
+   if(bflag == WCC_ZIPPED)
+      prof_io("write_wccseis",0,wccz_write(fdw,shead,s,0));
+   else
+      {
+      rite(fdw,shead,sizeof(struct statdata));
+      rite(fdw,s,shead->nt*sizeof(float));
+      prof_io("write_wccseis",0,sizeof(struct statdata) + shead->nt*sizeof(float));
+      }
    close(fdw);
    }
 else
@@ -148,24 +958,116 @@ else
                                            shead->az,
                                            shead->baz);
 
+   /* 6 values of 13 characters and a newline per line */
+   buf = (char *) check_malloc((shead->nt/6 + 1)*(6*13 + 1) + 1);
+   pb = buf;
+
    nt6 = shead->nt/6;                                   
    for(i=0;i<nt6;i++)
       {
       for(j=0;j<6;j++)
-         fprintf(fpw,"%13.5e",s[6*i + j]);
+         pb = format_e(pb,s[6*i + j],13,5);
 
-      fprintf(fpw,"\n");                   
+      *pb++ = '\n';
       }
 
    if(6*nt6 != shead->nt)
       {
       for(i=6*nt6;i<shead->nt;i++)
-         fprintf(fpw,"%13.5e",s[i]);
+         pb = format_e(pb,s[i],13,5);
 
-      fprintf(fpw,"\n");             
+      *pb++ = '\n';
       }
+   fwrite(buf,1,pb - buf,fpw);
+   prof_io("write_wccseis",0,pb - buf);
+   free(buf);
    fclose(fpw);
    }
+
+prof_stop("write_wccseis",t0,shead->nt);
+}
+
+/*
+   1 if fmt is "text%W.Pe" (text without a '%', W and P optional) with
+   text of less than 16 characters, returned in pre, w and p
+*/
+static int bbp_eformat(char *fmt,char *pre,int *w,int *p)
+{
+char *pc;
+int n;
+
+pc = strchr(fmt,'%');
+if(pc == NULL || pc - fmt >= 16)
+   return(0);
+
+n = pc - fmt;
+strncpy(pre,fmt,n);
+pre[n] = '\0';
+
+pc++;
+*w = 0;
+while(*pc >= '0' && *pc <= '9')
+   *w = 10*(*w) + (*pc++ - '0');
+
+*p = 6;
+if(*pc == '.')
+   {
+   pc++;
+   *p = 0;
+   while(*pc >= '0' && *pc <= '9')
+      *p = 10*(*p) + (*pc++ - '0');
+   }
+
+if(pc[0] != 'e' || pc[1] != '\0' || *w > 64 || *p > 64)
+   return(0);
+return(1);
+}
+
+/*
+   The line format of a BBP file (wcc2bbp, respect2bbp): tformat for
+   the time or period, dformat for each of the three components.  When
+   both are "text%W.Pe" (the defaults %.6e and \t%.6e are) the lines
+   are made with format_e(), otherwise with snprintf().
+*/
+void bbp_format_init(struct bbp_format *bf,char *tformat,char *dformat)
+{
+sprintf(bf->frmt,"%s%s%s%s\n",tformat,dformat,dformat,dformat);
+bf->fast = bbp_eformat(tformat,bf->tpre,&bf->tw,&bf->tp) && bbp_eformat(dformat,bf->dpre,&bf->dw,&bf->dp);
+}
+
+/* one line of a BBP file at p (room for BBP_LINE), returns the position after it */
+char *bbp_format_line(char *p,struct bbp_format *bf,double t,float a1,float a2,float a3)
+{
+char *pc;
+int n;
+
+if(!bf->fast)
+   {
+   n = snprintf(p,BBP_LINE,bf->frmt,t,a1,a2,a3);
+   if(n >= BBP_LINE)
+      {
+      fprintf(stderr,"*** BBP line longer than %d characters, exiting...\n",BBP_LINE-1);
+      exit(-1);
+      }
+   return(p + n);
+   }
+
+for(pc=bf->tpre;*pc;pc++)
+   *p++ = *pc;
+p = format_e(p,t,bf->tw,bf->tp);
+
+for(pc=bf->dpre;*pc;pc++)
+   *p++ = *pc;
+p = format_e(p,a1,bf->dw,bf->dp);
+for(pc=bf->dpre;*pc;pc++)
+   *p++ = *pc;
+p = format_e(p,a2,bf->dw,bf->dp);
+for(pc=bf->dpre;*pc;pc++)
+   *p++ = *pc;
+p = format_e(p,a3,bf->dw,bf->dp);
+
+*p++ = '\n';
+return(p);
 }
 
 FILE *fopfile(char *name,char *mode)
@@ -204,10 +1106,33 @@ if ((fd = open (name, CROPTR_FLAGS, 0664)) == -1)
 return (fd);
 }
 
+/*
+   reed() and rite() transfer in pieces of at most RW_CHUNK bytes and
+   keep going after short transfers (pipes, network filesystems) and
+   interrupted calls; only end of file or an error before length bytes
+   is fatal.
+*/
 int reed(int fd, void *pntr, int length)
 {
-int temp;
-if ((temp = read(fd, pntr, length)) < length)
+int temp, nr;
+
+temp = 0;
+while(temp < length)
+   {
+   nr = length - temp;
+   if(nr > RW_CHUNK)
+      nr = RW_CHUNK;
+
+   nr = read(fd, (char *) pntr + temp, nr);
+   if(nr < 0 && errno == EINTR)
+      continue;
+   if(nr <= 0)
+      break;
+
+   temp = temp + nr;
+   }
+
+if (temp < length)
    {
    fprintf (stderr, "READ ERROR\n");
    fprintf (stderr, "%d attempted  %d read\n", length, temp);
@@ -216,10 +1141,143 @@ if ((temp = read(fd, pntr, length)) < length)
 return(temp);
 }
 
+/*
+   swap_in_place() reverses the byte order of n 4 byte words in cbuf
+   (any alignment), 32 or 16 bytes at a time with a byte shuffle when
+   the compiler targets AVX2, SSSE3 or NEON (e.g. -march=native), and
+   with __builtin_bswap32() otherwise; the compiler vectorizes that loop
+   too, for the CPU it runs on (SIMD_CLONES).  reed_swap() is reed() followed by swap_in_place() when swap is
+   set, done in SWAP_CHUNK pieces so the data are swapped while they
+   are still in cache.
+*/
+SIMD_CLONES void swap_in_place(int n,char *cbuf)
+{
+unsigned int w;
+int i = 0;
+
+#if defined(__AVX2__)
+const __m256i m32 = _mm256_setr_epi8(3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12,
+                                     3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12);
+__m256i v32;
+
+for(;i+8<=n;i=i+8)
+   {
+   v32 = _mm256_loadu_si256((__m256i *)(cbuf + 4*i));
+   _mm256_storeu_si256((__m256i *)(cbuf + 4*i),_mm256_shuffle_epi8(v32,m32));
+   }
+#endif
+
+#if defined(__SSSE3__)
+const __m128i m16 = _mm_setr_epi8(3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12);
+__m128i v16;
+
+for(;i+4<=n;i=i+4)
+   {
+   v16 = _mm_loadu_si128((__m128i *)(cbuf + 4*i));
+   _mm_storeu_si128((__m128i *)(cbuf + 4*i),_mm_shuffle_epi8(v16,m16));
+   }
+#elif defined(__ARM_NEON)
+for(;i+4<=n;i=i+4)
+   vst1q_u8((uint8_t *)(cbuf + 4*i),vrev32q_u8(vld1q_u8((uint8_t *)(cbuf + 4*i))));
+#endif
+
+for(;i<n;i++)
+   {
+   memcpy(&w,cbuf + 4*i,4);
+   w = __builtin_bswap32(w);
+   memcpy(cbuf + 4*i,&w,4);
+   }
+}
+
+int reed_swap(int fd, void *pntr, int length, int swap)
+{
+int nr, np;
+
+if(swap == 0)
+   return(reed(fd,pntr,length));
+
+nr = 0;
+while(nr < length)
+   {
+   np = length - nr;
+   if(np > SWAP_CHUNK)
+      np = SWAP_CHUNK;
+
+   reed(fd,(char *) pntr + nr,np);
+   swap_in_place(np/4,(char *) pntr + nr);
+
+   nr = nr + np;
+   }
+return(nr);
+}
+
+/*
+   read_subgf() reads the next subfault of a Green's function bank (the
+   file subgf2wcc takes apart): a record with the number of components
+   nc (at most 3), then for each one a record of range and start time,
+   one of nt and dt and one of the nt samples, all Fortran unformatted.
+   The header and samples of component j go to gfh[j] and gf[j] (which
+   are realloc'd); nt, dt, edist and the start time are set.  Returns nc.
+*/
+int read_subgf(int fdr, struct statdata *gfh, float **gf)
+{
+int j, nc, nt, nbyte;
+float dt, rng, tst;
+
+reed(fdr,&nbyte,sizeof(int));
+reed(fdr,&nc,sizeof(int));
+reed(fdr,&nbyte,sizeof(int));
+
+for(j=0;j<nc;j++)
+   {
+   reed(fdr,&nbyte,sizeof(int));
+   reed(fdr,&rng,sizeof(float));
+   reed(fdr,&tst,sizeof(float));
+   reed(fdr,&nbyte,sizeof(int));
+
+   reed(fdr,&nbyte,sizeof(int));
+   reed(fdr,&nt,sizeof(int));
+   reed(fdr,&dt,sizeof(float));
+   reed(fdr,&nbyte,sizeof(int));
+
+   gf[j] = (float *) check_realloc(gf[j],nt*sizeof(float));
+
+   reed(fdr,&nbyte,sizeof(int));
+   reed(fdr,gf[j],nt*sizeof(float));
+   reed(fdr,&nbyte,sizeof(int));
+
+   gfh[j].nt = nt;
+   gfh[j].dt = dt;
+   gfh[j].edist = rng;
+
+   gfh[j].hr = (int)(tst/3600.0);
+   gfh[j].min = (int)((tst - 3600.0*gfh[j].hr)/60.0);
+   gfh[j].sec = (float)(tst - 60.0*gfh[j].min - 3600.0*gfh[j].hr);
+   }
+return(nc);
+}
+
 int rite(int fd, void *pntr, int length)
 {
-int temp;
-if ((temp = write(fd, pntr, length)) < length)
+int temp, nw;
+
+temp = 0;
+while(temp < length)
+   {
+   nw = length - temp;
+   if(nw > RW_CHUNK)
+      nw = RW_CHUNK;
+
+   nw = write(fd, (char *) pntr + temp, nw);
+   if(nw < 0 && errno == EINTR)
+      continue;
+   if(nw <= 0)
+      break;
+
+   temp = temp + nw;
+   }
+
+if (temp < length)
    {
    fprintf (stderr, "WRITE ERROR\n");
    fprintf (stderr, "%d attempted  %d written\n", length, temp);
@@ -255,3 +1313,117 @@ if(ptr == NULL)
  
 return(ptr);
 }
+
+/*
+   Scratch arena of the calling thread.  The *_sub.c stages take their
+   per-trace work arrays with arena_alloc() between an arena_mark() and
+   an arena_release() of that mark, so a batch of traces reuses the
+   same memory instead of a malloc()/free() of each array per trace.
+   Blocks are ARENA_ALIGN aligned (enough for FFTW and SIMD loads).
+   When the arena is full a larger block is chained on; an
+   arena_reset(), which drivers call once per trace, then replaces the
+   chain by one block of the peak size.  Memory stays with the thread
+   until arena_free().
+*/
+
+struct arena_block
+   {
+   struct arena_block *prev;
+   size_t start;        /* arena offset of the block's first byte */
+   size_t size;
+   size_t used;
+   };
+
+#define ARENA_ALIGN 64
+#define ARENA_HEAD ((sizeof(struct arena_block) + ARENA_ALIGN-1) & ~(size_t)(ARENA_ALIGN-1))
+#define ARENA_MIN 1048576
+
+static __thread struct arena_block *arena_top = NULL;
+static __thread size_t arena_peak = 0;
+
+static struct arena_block *arena_block_new(size_t size,size_t start,struct arena_block *prev)
+{
+struct arena_block *b;
+void *ptr;
+
+if(posix_memalign(&ptr,ARENA_ALIGN,ARENA_HEAD + size) != 0)
+   {
+   fprintf(stderr,"*****  memory allocation error\n");
+   exit(-1);
+   }
+
+b = (struct arena_block *) ptr;
+b->prev = prev;
+b->start = start;
+b->size = size;
+b->used = 0;
+return(b);
+}
+
+size_t arena_mark(void)
+{
+if(arena_top == NULL)
+   return(0);
+return(arena_top->start + arena_top->used);
+}
+
+void *arena_alloc(size_t len)
+{
+struct arena_block *b;
+size_t size;
+char *ptr;
+
+len = (len + ARENA_ALIGN-1) & ~(size_t)(ARENA_ALIGN-1);
+b = arena_top;
+if(b == NULL || b->used + len > b->size)
+   {
+   size = ARENA_MIN;
+   if(b != NULL && 2*b->size > size)
+      size = 2*b->size;
+   if(len > size)
+      size = len;
+   b = arena_block_new(size,arena_mark(),b);
+   arena_top = b;
+   }
+
+ptr = (char *) b + ARENA_HEAD + b->used;
+b->used = b->used + len;
+if(b->start + b->used > arena_peak)
+   arena_peak = b->start + b->used;
+return(ptr);
+}
+
+/* frees everything allocated after mark */
+void arena_release(size_t mark)
+{
+struct arena_block *b;
+
+while(arena_top != NULL && arena_top->start > mark)
+   {
+   b = arena_top;
+   arena_top = b->prev;
+   free(b);
+   }
+if(arena_top != NULL)
+   arena_top->used = mark - arena_top->start;
+}
+
+/* empties the arena, one block large enough for the peak use so far */
+void arena_reset(void)
+{
+arena_release(0);
+if(arena_top != NULL && arena_top->size < arena_peak)
+   {
+   free(arena_top);
+   arena_top = arena_block_new(arena_peak,0,NULL);
+   }
+}
+
+void arena_free(void)
+{
+arena_release(0);
+if(arena_top != NULL)
+   free(arena_top);
+arena_top = NULL;
+arena_peak = 0;
+}
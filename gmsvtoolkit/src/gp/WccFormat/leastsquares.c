@@ -1,19 +1,21 @@
 #include "include.h"
 #include "structure.h"
 #include "function.h"
+#include "getpar.h"
 
 #define NPBLOCK 10000
 #define NPMAX 10000000
 
-void lsqr(float *x,float *y,float *w,int np,float *c0,int order);
+void lsqr(float *x,float *y,float *w,int np,double xc,double xs,double *c0,int order);
 
-main(int ac,char **av)
+int main(int ac,char **av)
 {
 FILE *fpr, *fpw, *fopfile();
-float *xp, *yp, *wp, *c0, x0, y0;
+float *xp, *yp, *wp, x0, y0;
+double c0[LSQ_MAXTERMS], cx[LSQ_MAXTERMS], xc, xs;
 int i, nterms, nx, ix, np, ip;
 int getxmin, getxmax;
-float dx, xb;
+float dx, xlo, xhi;
 float xmin = 1.0e+16;
 float xmax = -1.0e+16;
 
@@ -34,6 +36,12 @@ getpar("xmax","f",&xmax);
 getpar("nx","d",&nx);
 endpar();
 
+if(nterms < 1 || nterms > LSQ_MAXTERMS)
+   {
+   fprintf(stderr,"*** nterms= %d, it must be 1 ... %d, exiting...\n",nterms,LSQ_MAXTERMS);
+   exit(-1);
+   }
+
 getxmin = 1;
 if(xmin < 1.0e+16)
    getxmin = 0;
@@ -44,7 +52,6 @@ if(xmax > -1.0e+16)
 
 np = NPBLOCK;
 
-c0 = (float *) check_malloc (nterms*sizeof(float));
 xp = (float *) check_malloc (np*sizeof(float));
 yp = (float *) check_malloc (np*sizeof(float));
 wp = (float *) check_malloc (np*sizeof(float));
@@ -54,6 +61,9 @@ if(strcmp(infile,"stdin") == 0)
 else
    fpr = fopfile(infile,"r");
 
+xlo = 1.0e+16;
+xhi = -1.0e+16;
+
 ip = 0;
 while(fgets(str,512,fpr) != NULL)
    {
@@ -68,6 +78,11 @@ while(fgets(str,512,fpr) != NULL)
    if(sscanf(str,"%f %f %f",&xp[ip],&yp[ip],&wp[ip])==2)
       wp[ip] = 1.0;
 
+   if(xp[ip] < xlo)
+      xlo = xp[ip];
+   if(xp[ip] > xhi)
+      xhi = xp[ip];
+
    if(xp[ip] < xmin && getxmin)
       xmin = xp[ip];
    if(xp[ip] > xmax && getxmax)
@@ -82,7 +97,17 @@ xp = (float *) check_realloc (xp,np*sizeof(float));
 yp = (float *) check_realloc (yp,np*sizeof(float));
 wp = (float *) check_realloc (wp,np*sizeof(float));
 
-lsqr(xp,yp,wp,np,c0,nterms);
+/* fitted in u = (x-xc)/xs, -1 ... 1 over the points */
+xc = 0.5*((double)(xhi) + (double)(xlo));
+xs = 0.5*((double)(xhi) - (double)(xlo));
+if(!(xs > 0.0))
+   xs = 1.0;
+
+lsqr(xp,yp,wp,np,xc,xs,c0,nterms);
+
+for(i=0;i<nterms;i++)
+   cx[i] = c0[i];
+lsq_unscale(cx,nterms,xc,xs);
 
 if(strcmp(outfile,"stdout") == 0)
    fpw = stdout;
@@ -94,15 +119,7 @@ for(ix=0;ix<nx;ix++)
    {
    x0 = xmin + (ix+0.5)*dx;
 
-   xb = 1.0;
-   y0 = c0[0];
-   for(i=1;i<nterms;i++)
-      {
-      xb = xb*x0;
-      y0 = y0 + xb*c0[i];
-      }
-
-   fgets(str,512,fpr);
+   y0 = lsq_poly(c0,nterms,(x0 - xc)/xs);
    fprintf(fpw,"%13.5e %13.5e\n",x0,y0);
    }
 
@@ -115,151 +132,24 @@ for(i=1;i<nterms;i++)
 fprintf(stderr,"\n\n");
 
 for(i=0;i<nterms;i++)
-   fprintf(stderr,"\tc%d = %13.5e\n",i,c0[i]);
+   fprintf(stderr,"\tc%d = %13.5e\n",i,cx[i]);
 }
 
-void lsqr(float *x,float *y,float *w,int np,float *c0,int order)
-{
-double *t0, *ts, *b0, *a0, sum, f;
-int i, j, k, ip;
-
-t0 = (double *) check_malloc (2*order*sizeof(double));
-ts = (double *) check_malloc (order*sizeof(double));
-a0 = (double *) check_malloc (order*order*sizeof(double));
-b0 = (double *) check_malloc (order*sizeof(double));
-
-for(i=0;i<order*order;i++)
-   a0[i] = 0.0;
-
-for(i=0;i<order;i++)
-   b0[i] = 0.0;
-
-/*  BRUTE force
-for(j=0;j<order;j++)
-   {
-   for(i=0;i<order;i++)
-      {
-      sum = 0.0;
-      for(ip=0;ip<np;ip++)
-         {
-	 f = 1.0;
-         for(k=0;k<i+j;k++)
-            f = f*x[ip];
-
-	 sum = sum + f;
-	 }
-      a0[i+j*order] = sum;
-      }
-
-   sum = 0.0;
-   for(ip=0;ip<np;ip++)
-      {
-      f = 1.0;
-      for(k=0;k<j;k++)
-	 f = f*x[ip];
-
-      sum = sum + f*y[ip];
-      }
-   b0[j] = sum;
-   }
-*/
-
-/*  OLD way without weights 
-t0[0] = 1;
-for(ip=0;ip<np;ip++)
-   {
-   t0[1] = x[ip];
-   for(i=2;i<2*order;i++)
-      t0[i] = t0[i-1]*t0[1];
-
-   ts[0] = y[ip];
-   for(i=1;i<order;i++)
-      ts[i] = t0[i]*y[ip];
-
-   for(j=0;j<order;j++)
-      {
-      for(i=0;i<order;i++)
-	 a0[i+j*order] = a0[i+j*order] + t0[i+j];
-
-      b0[j] = b0[j] + ts[j];
-      }
-   }
-*/
-
-/*  NEW way w/weights 
+/*
+   The order coefficients of the least squares polynomial in
+   u = (x-xc)/xs, lsqfit.c
 */
-t0[0] = 1;
-for(ip=0;ip<np;ip++)
-   {
-   t0[1] = x[ip];
-   for(i=2;i<2*order;i++)
-      t0[i] = t0[i-1]*t0[1];
-
-   ts[0] = y[ip];
-   for(i=1;i<order;i++)
-      ts[i] = t0[i]*y[ip];
-
-   for(j=0;j<order;j++)
-      {
-      for(i=0;i<order;i++)
-	 a0[i+j*order] = a0[i+j*order] + t0[i+j]*w[ip];
-
-      b0[j] = b0[j] + ts[j]*w[ip];
-      }
-   }
-
-gelim_double(a0,order,b0);
+void lsqr(float *x,float *y,float *w,int np,double xc,double xs,double *c0,int order)
+{
+double pt[2*LSQ_MAXTERMS], ps[LSQ_MAXTERMS];
+int i;
 
+for(i=0;i<2*order-1;i++)
+   pt[i] = 0.0;
 for(i=0;i<order;i++)
-   c0[i] = b0[i];
+   ps[i] = 0.0;
 
-free(a0);
-free(b0);
-free(t0);
-free(ts);
+lsq_sums(x,y,w,np,xc,xs,order,pt,ps);
+if(lsq_solve_sums(pt,ps,order,c0) != 0)
+   fprintf(stderr,"*** the normal equations are singular (fewer points than terms?), the coefficients are set to 0\n");
 }
-
-/*
-Gauss elimination without pivoting (no row exchanges):
-We solve Ax = b where A is n by n, and x and b have length n
-by forming the decomposition A = LU via elimination.
-Originally a contains the matrix A and b contains the
-vector b.  At the end a contains the lower and upper
-triangular matrices L and U and b contains the solution
-vector x.  The diagonal of a contains the diagonal of U
-(the pivots) since the diagonal elements of U are all 1's.
-*/
-
-gelim_double(a,n,b)
-double *a, *b;
-int n;
-   {
-	int i, j, jj;
-	double *pa, *paj;
-	double f, pivot;
-
-         for (j=0; j<n-1; j++)   /* lu decomp of a (no row exchanges) */
-	    {
-		pa= a + j*n;
-		pivot = pa[j];
-	 	for (i=j+1; i<n; i++)
-		   {
-			pa = a + i*n;
-			paj= a + j*n;
-	     		f = pa[j]/pivot;
-			pa[j] = f;
-			for (jj=j+1; jj<n; jj++) pa[jj] -= f*paj[jj];
-		   }
-	   }
-         for (i=1; i<n; i++)        /* forward elimination on b */
-	    {
-		pa = a + i*n;
-		for (j=0; j<i; j++) b[i] -= pa[j]*b[j];
-	    }
-         for (i=n-1; i>-1; i--)        /* back-substitution */
-	    {
-		pa = a + i*n;
-		for (j=n-1; j>i; j--) b[i] -= pa[j]*b[j];
-		b[i] = b[i]/pa[i];
-	    }
-    }
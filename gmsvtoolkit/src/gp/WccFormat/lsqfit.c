@@ -0,0 +1,532 @@
+#include "include.h"
+#include "structure.h"
+#include "function.h"
+
+/*
+   Least squares polynomials and the small dense solvers they need,
+   for baseline() of integ_diff_sub.c and for leastsquares.
+
+   The polynomials are fitted in a variable scaled to -1 ... 1 over the
+   data (u = (x-xc)/xs, or u = it*h - 1 on the samples of a trace, h
+   from lsq_grid_step()), which keeps the normal equations well
+   conditioned at high order.  Their matrix only holds the 2*n-1 power
+   sums of u (element i,j is the sum of u^(i+j)), formed in one pass
+   with the n sums of u^k*y, and is solved by Cholesky.
+
+   The trace sums run in four lanes by sample index, which vectorizes
+   and does not depend on how a trace is split into blocks
+   (integ_diff_stream()).  Traces of one length share the sums of u and
+   so the factored matrix: lsq_grid_fit_batch() fits many of them,
+   each one with only its own n sums.
+
+   The solvers return -1 (and the fits all-zero coefficients) for a
+   matrix that is not positive definite, e.g. fewer points than terms.
+*/
+
+/* a = L*L' in place (L in the lower triangle), -1 if a is not positive definite */
+int lsq_cholesky_factor(double *a,int n)
+{
+double sum;
+int i, j, k;
+
+for(j=0;j<n;j++)
+   {
+   sum = a[j+j*n];
+   for(k=0;k<j;k++)
+      sum = sum - a[k+j*n]*a[k+j*n];
+
+   if(!(sum > 0.0))
+      return(-1);
+
+   a[j+j*n] = sqrt(sum);
+   for(i=j+1;i<n;i++)
+      {
+      sum = a[j+i*n];
+      for(k=0;k<j;k++)
+         sum = sum - a[k+i*n]*a[k+j*n];
+      a[j+i*n] = sum/a[j+j*n];
+      }
+   }
+return(0);
+}
+
+/* solves L*L'x = b with the factor of lsq_cholesky_factor(), x in b */
+void lsq_cholesky_solve(double *a,int n,double *b)
+{
+int i, k;
+
+for(i=0;i<n;i++)
+   {
+   for(k=0;k<i;k++)
+      b[i] = b[i] - a[k+i*n]*b[k];
+   b[i] = b[i]/a[i+i*n];
+   }
+
+for(i=n-1;i>=0;i--)
+   {
+   for(k=i+1;k<n;k++)
+      b[i] = b[i] - a[i+k*n]*b[k];
+   b[i] = b[i]/a[i+i*n];
+   }
+}
+
+/* solves a*x = b, a symmetric positive definite (destroyed), x in b */
+int lsq_cholesky(double *a,int n,double *b)
+{
+if(lsq_cholesky_factor(a,n) != 0)
+   return(-1);
+
+lsq_cholesky_solve(a,n,b);
+return(0);
+}
+
+/*
+Gauss elimination without pivoting (no row exchanges):
+We solve Ax = b where A is n by n, and x and b have length n
+by forming the decomposition A = LU via elimination.
+Originally a contains the matrix A and b contains the
+vector b.  At the end a contains the lower and upper
+triangular matrices L and U and b contains the solution
+vector x.  The diagonal of a contains the diagonal of U
+(the pivots) since the diagonal elements of U are all 1's.
+*/
+
+void gelim_double(a,n,b)
+double *a, *b;
+int n;
+   {
+	int i, j, jj;
+	double *pa, *paj;
+	double f, pivot;
+
+         for (j=0; j<n-1; j++)   /* lu decomp of a (no row exchanges) */
+	    {
+		pa= a + j*n;
+		pivot = pa[j];
+	 	for (i=j+1; i<n; i++)
+		   {
+			pa = a + i*n;
+			paj= a + j*n;
+	     		f = pa[j]/pivot;
+			pa[j] = f;
+			for (jj=j+1; jj<n; jj++) pa[jj] -= f*paj[jj];
+		   }
+	   }
+         for (i=1; i<n; i++)        /* forward elimination on b */
+	    {
+		pa = a + i*n;
+		for (j=0; j<i; j++) b[i] -= pa[j]*b[j];
+	    }
+         for (i=n-1; i>-1; i--)        /* back-substitution */
+	    {
+		pa = a + i*n;
+		for (j=n-1; j>i; j--) b[i] -= pa[j]*b[j];
+		b[i] = b[i]/pa[i];
+	    }
+    }
+
+void invmat3x3(inv,mat)
+float *inv, *mat;
+{
+int i;
+float ftmp, det;
+
+/* form cofactors */
+
+inv[0] = mat[4]*mat[8] - mat[5]*mat[7];
+inv[1] = -mat[3]*mat[8] + mat[5]*mat[6];
+inv[2] = mat[3]*mat[7] - mat[4]*mat[6];
+
+inv[3] = -mat[1]*mat[8] + mat[2]*mat[7];
+inv[4] = mat[0]*mat[8] - mat[2]*mat[6];
+inv[5] = -mat[0]*mat[7] + mat[1]*mat[6];
+
+inv[6] = mat[1]*mat[5] - mat[2]*mat[4];
+inv[7] = -mat[0]*mat[5] + mat[2]*mat[3];
+inv[8] = mat[0]*mat[4] - mat[1]*mat[3];
+
+/* calculate determinant */
+
+det = mat[0]*inv[0] + mat[1]*inv[1] + mat[2]*inv[2];
+
+if(det != 0.0)
+   {
+   det = 1.0/det;
+   for(i=0;i<9;i++)
+      inv[i] = det*inv[i];
+
+   /* transpose */
+
+   ftmp = inv[1];
+   inv[1] = inv[3];
+   inv[3] = ftmp;
+
+   ftmp = inv[2];
+   inv[2] = inv[6];
+   inv[6] = ftmp;
+
+   ftmp = inv[5];
+   inv[5] = inv[7];
+   inv[7] = ftmp;
+   }
+else
+   {
+   fprintf(stderr,"invmat3x3 error: matrix is singular, exiting...\n");
+   exit(-9);
+   }
+}
+
+void invmat4x4(v,m)
+float *v, *m;
+{
+int i;
+float ftmp, det;
+
+/* form cofactors */
+ 
+v[0]  =   m[5]*(m[10]*m[15] - m[14]*m[11])
+        - m[6]*(m[9]*m[15] - m[13]*m[11])
+        + m[7]*(m[9]*m[14] - m[13]*m[10]);
+v[1]  = - m[4]*(m[10]*m[15] - m[14]*m[11])
+        + m[6]*(m[8]*m[15] - m[12]*m[11])
+        - m[7]*(m[8]*m[14] - m[12]*m[10]);
+v[2]  =   m[4]*(m[9]*m[15] - m[13]*m[11])
+        - m[5]*(m[8]*m[15] - m[12]*m[11])
+        + m[7]*(m[8]*m[13] - m[12]*m[9]);
+v[3]  = - m[4]*(m[9]*m[14] - m[13]*m[10])
+        + m[5]*(m[8]*m[14] - m[12]*m[10])
+        - m[6]*(m[8]*m[13] - m[12]*m[9]);
+ 
+v[4]  = - m[1]*(m[10]*m[15] - m[14]*m[11])
+        + m[2]*(m[9]*m[15] - m[13]*m[11])
+        - m[3]*(m[9]*m[14] - m[13]*m[10]);
+v[5]  =   m[0]*(m[10]*m[15] - m[14]*m[11])
+        - m[2]*(m[8]*m[15] - m[12]*m[11])
+        + m[3]*(m[8]*m[14] - m[12]*m[10]);
+v[6]  = - m[0]*(m[9]*m[15] - m[13]*m[11])
+        + m[1]*(m[8]*m[15] - m[12]*m[11])
+        - m[3]*(m[8]*m[13] - m[12]*m[9]);
+v[7]  =   m[0]*(m[9]*m[14] - m[13]*m[10])
+        - m[1]*(m[8]*m[14] - m[12]*m[10])
+        + m[2]*(m[8]*m[13] - m[12]*m[9]);
+  
+v[8]  =   m[1]*(m[6]*m[15] - m[14]*m[7])
+        - m[2]*(m[5]*m[15] - m[13]*m[7])
+        + m[3]*(m[5]*m[14] - m[13]*m[6]);
+v[9]  = - m[0]*(m[6]*m[15] - m[14]*m[7])
+        + m[2]*(m[4]*m[15] - m[12]*m[7])
+        - m[3]*(m[4]*m[14] - m[12]*m[6]);
+v[10] =   m[0]*(m[5]*m[15] - m[13]*m[7])
+        - m[1]*(m[4]*m[15] - m[12]*m[7])
+        + m[3]*(m[4]*m[13] - m[12]*m[5]);
+v[11] = - m[0]*(m[5]*m[14] - m[13]*m[6])
+        + m[1]*(m[4]*m[14] - m[12]*m[6])
+        - m[2]*(m[4]*m[13] - m[12]*m[5]);
+  
+v[12] = - m[1]*(m[6]*m[11] - m[10]*m[7])
+        + m[2]*(m[5]*m[11] - m[9]*m[7])
+        - m[3]*(m[5]*m[10] - m[9]*m[6]);
+v[13] =   m[0]*(m[6]*m[11] - m[10]*m[7])
+        - m[2]*(m[4]*m[11] - m[8]*m[7])
+        + m[3]*(m[4]*m[10] - m[8]*m[6]);
+v[14] = - m[0]*(m[5]*m[11] - m[9]*m[7])
+        + m[1]*(m[4]*m[11] - m[8]*m[7])
+        - m[3]*(m[4]*m[9] - m[8]*m[5]);
+v[15] =   m[0]*(m[5]*m[10] - m[9]*m[6])
+        - m[1]*(m[4]*m[10] - m[8]*m[6])
+        + m[2]*(m[4]*m[9] - m[8]*m[5]);
+ 
+/* calculate determinant */
+ 
+det = m[0]*v[0] + m[1]*v[1] + m[2]*v[2] + m[3]*v[3];
+ 
+if(det != 0.0)
+   {
+   det = 1.0/det;
+   for(i=0;i<16;i++)
+      v[i] = det*v[i];
+ 
+   /* transpose */
+ 
+   ftmp = v[1];
+   v[1] = v[4];
+   v[4] = ftmp;
+ 
+   ftmp = v[2];
+   v[2] = v[8];
+   v[8] = ftmp;
+ 
+   ftmp = v[3];
+   v[3] = v[12];
+   v[12] = ftmp;
+ 
+   ftmp = v[7];
+   v[7] = v[13];
+   v[13] = ftmp;
+ 
+   ftmp = v[11];
+   v[11] = v[14];
+   v[14] = ftmp;
+ 
+   ftmp = v[6];
+   v[6] = v[9];
+   v[9] = ftmp;
+   }
+else
+   {
+   fprintf(stderr,"invmat4x4 error: matrix is singular, exiting...\n");
+   exit(-9);
+   }
+}
+
+/* the sample spacing of u = it*h - 1 on nt samples */
+double lsq_grid_step(int nt)
+{
+if(nt > 1)
+   return(2.0/(double)(nt-1));
+
+return(0.0);
+}
+
+/* p(u) = c[0] + c[1]*u + ... + c[n-1]*u^(n-1) */
+double lsq_poly(double *c,int n,double u)
+{
+double y;
+int i;
+
+y = c[n-1];
+for(i=n-2;i>=0;i--)
+   y = y*u + c[i];
+
+return(y);
+}
+
+/*
+   adds points x, y (weights w, 1 if NULL) to the sums pt[2*n-1] of
+   w*u^k and ps[n] of w*u^k*y, u = (x-xc)/xs
+*/
+void lsq_sums(float *x,float *y,float *w,int np,double xc,double xs,int n,double *pt,double *ps)
+{
+double u, uk;
+int ip, k;
+
+for(ip=0;ip<np;ip++)
+   {
+   u = (x[ip] - xc)/xs;
+   uk = 1.0;
+   if(w != NULL)
+      uk = w[ip];
+
+   for(k=0;k<n;k++)
+      {
+      pt[k] = pt[k] + uk;
+      ps[k] = ps[k] + uk*y[ip];
+      uk = uk*u;
+      }
+   for(;k<2*n-1;k++)
+      {
+      pt[k] = pt[k] + uk;
+      uk = uk*u;
+      }
+   }
+}
+
+/*
+   adds samples i0 ... i0+ns-1 of a trace (s[0] is sample i0) to the
+   lane sums pt[4*(2*n-1)] of u^k and ps[4*n] of u^k*s; either may be
+   NULL
+*/
+void lsq_grid_sums(float *s,int i0,int ns,double h,int n,double *pt,double *ps)
+{
+double u[4], uk[4], v;
+int k, l, it, ie;
+
+ie = i0 + ns;
+for(it=i0;it<ie && ((it & 3) || it+4 > ie);it++)
+   {
+   l = it & 3;
+   v = 1.0;
+   for(k=0;k<2*n-1;k++)
+      {
+      if(pt != NULL)
+         pt[4*k+l] = pt[4*k+l] + v;
+      if(ps != NULL && k < n)
+         ps[4*k+l] = ps[4*k+l] + v*s[it-i0];
+      v = v*(it*h - 1.0);
+      }
+   }
+
+for(;it+4<=ie;it=it+4)
+   {
+   for(l=0;l<4;l++)
+      {
+      u[l] = (it+l)*h - 1.0;
+      uk[l] = 1.0;
+      }
+
+   if(ps != NULL)
+      {
+      for(k=0;k<n;k++)
+         {
+         for(l=0;l<4;l++)
+            {
+            ps[4*k+l] = ps[4*k+l] + uk[l]*s[it-i0+l];
+            uk[l] = uk[l]*u[l];
+            }
+         }
+      }
+
+   if(pt != NULL)
+      {
+      for(l=0;l<4;l++)
+         uk[l] = 1.0;
+      for(k=0;k<2*n-1;k++)
+         {
+         for(l=0;l<4;l++)
+            {
+            pt[4*k+l] = pt[4*k+l] + uk[l];
+            uk[l] = uk[l]*u[l];
+            }
+         }
+      }
+   }
+
+for(;it<ie;it++)
+   {
+   l = it & 3;
+   v = 1.0;
+   for(k=0;k<2*n-1;k++)
+      {
+      if(pt != NULL)
+         pt[4*k+l] = pt[4*k+l] + v;
+      if(ps != NULL && k < n)
+         ps[4*k+l] = ps[4*k+l] + v*s[it-i0];
+      v = v*(it*h - 1.0);
+      }
+   }
+}
+
+/* the matrix of the power sums p[2*n-1] into a[n*n] */
+static void lsq_hankel(double *p,int n,double *a)
+{
+int i, j;
+
+for(j=0;j<n;j++)
+   {
+   for(i=0;i<n;i++)
+      a[i+j*n] = p[i+j];
+   }
+}
+
+/* the n coefficients c from the sums of lsq_sums(), -1 if singular */
+int lsq_solve_sums(double *pt,double *ps,int n,double *c)
+{
+double a[LSQ_MAXTERMS*LSQ_MAXTERMS];
+int i;
+
+lsq_hankel(pt,n,a);
+for(i=0;i<n;i++)
+   c[i] = ps[i];
+
+if(lsq_cholesky(a,n,c) != 0)
+   {
+   for(i=0;i<n;i++)
+      c[i] = 0.0;
+   return(-1);
+   }
+return(0);
+}
+
+/* the same from the lane sums of lsq_grid_sums() */
+int lsq_solve_grid_sums(double *pt,double *ps,int n,double *c)
+{
+double p[2*LSQ_MAXTERMS], q[LSQ_MAXTERMS];
+int i;
+
+for(i=0;i<2*n-1;i++)
+   p[i] = (pt[4*i] + pt[4*i+1]) + (pt[4*i+2] + pt[4*i+3]);
+for(i=0;i<n;i++)
+   q[i] = (ps[4*i] + ps[4*i+1]) + (ps[4*i+2] + ps[4*i+3]);
+
+return(lsq_solve_sums(p,q,n,c));
+}
+
+/* the n coefficients (in u = it*h - 1) of the polynomial fit to a trace */
+int lsq_grid_fit(float *s,int nt,int n,double *c)
+{
+double pt[4*(2*LSQ_MAXTERMS-1)], ps[4*LSQ_MAXTERMS];
+int i;
+
+for(i=0;i<4*(2*n-1);i++)
+   pt[i] = 0.0;
+for(i=0;i<4*n;i++)
+   ps[i] = 0.0;
+
+lsq_grid_sums(s,0,nt,lsq_grid_step(nt),n,pt,ps);
+return(lsq_solve_grid_sums(pt,ps,n,c));
+}
+
+/*
+   lsq_grid_fit() of the ntr traces s[itr*nt ...], coefficients in
+   c[itr*n ...]; the matrix is formed and factored once
+*/
+int lsq_grid_fit_batch(float *s,int nt,int ntr,int n,double *c)
+{
+double pt[4*(2*LSQ_MAXTERMS-1)], p[2*LSQ_MAXTERMS], a[LSQ_MAXTERMS*LSQ_MAXTERMS];
+double h;
+int i, itr;
+
+h = lsq_grid_step(nt);
+
+for(i=0;i<4*(2*n-1);i++)
+   pt[i] = 0.0;
+lsq_grid_sums(NULL,0,nt,h,n,pt,NULL);
+
+for(i=0;i<2*n-1;i++)
+   p[i] = (pt[4*i] + pt[4*i+1]) + (pt[4*i+2] + pt[4*i+3]);
+lsq_hankel(p,n,a);
+
+if(lsq_cholesky_factor(a,n) != 0)
+   {
+   for(i=0;i<ntr*n;i++)
+      c[i] = 0.0;
+   return(-1);
+   }
+
+#pragma omp parallel for schedule(static) private(i)
+for(itr=0;itr<ntr;itr++)
+   {
+   double ps[4*LSQ_MAXTERMS];
+   double *ct = c + (long long)(itr)*n;
+
+   for(i=0;i<4*n;i++)
+      ps[i] = 0.0;
+   lsq_grid_sums(s+(long long)(itr)*nt,0,nt,h,n,NULL,ps);
+
+   for(i=0;i<n;i++)
+      ct[i] = (ps[4*i] + ps[4*i+1]) + (ps[4*i+2] + ps[4*i+3]);
+   lsq_cholesky_solve(a,n,ct);
+   }
+return(0);
+}
+
+/* coefficients c of p((x-xc)/xs) turned into those of x^k, in place */
+void lsq_unscale(double *c,int n,double xc,double xs)
+{
+double f;
+int i, k;
+
+f = 1.0;
+for(k=1;k<n;k++)
+   {
+   f = f/xs;
+   c[k] = c[k]*f;
+   }
+
+/* p(x-xc) by repeated synthetic division (Taylor shift by -xc) */
+for(i=0;i<n-1;i++)
+   {
+   for(k=n-2;k>=i;k--)
+      c[k] = c[k] - xc*c[k+1];
+   }
+}
@@ -1,22 +1,33 @@
 #include        "include.h"
 #include        "structure.h"
 #include        "function.h"
+#include        "getpar.h"
 
 float float_swap(char *);
+void copy_band(int,off_t,int,off_t,off_t,char *,size_t);
 
-main(int ac, char **av)
+#define         MRG_BUFLEN      (16*1048576)
+
+int main(int ac, char **av)
 {
 FILE *fpr, *fopfile();
 struct tsheader tshead;
 struct tsheader_proc *tshead_p;
 int i, j, ix, iy, it;
 int dyts, nproc;
-float h, *val;
+float h;
 
 int swap_bytes = 0;
+int nthreads = 1;
+int pyramid = 0;
+int pyr_nlev = 3;
+int pyr_tskip = 4;
+int pyr_tile = 64;
+char pyrfile[256];
 char cbuf[512];
+char *cpbuf;
 
-off_t off, cur_off, head_off, nrite, nxblen;
+off_t off, head_off, nxblen, inoff, blen;
 
 int fdr, fdw;
 char str[512];
@@ -30,6 +41,11 @@ mstpar("filelist","s",filelist);
 mstpar("outfile","s",outfile);
 mstpar("nproc","d",&nproc);
 mstpar("h","f",&h);
+getpar("nthreads","d",&nthreads);
+getpar("pyramid","d",&pyramid);
+getpar("pyr_nlev","d",&pyr_nlev);
+getpar("pyr_tskip","d",&pyr_tskip);
+getpar("pyr_tile","d",&pyr_tile);
 endpar();
 
 tshead_p = (struct tsheader_proc *) check_malloc (nproc*sizeof(struct tsheader_proc));
@@ -75,20 +91,26 @@ tshead.modelrot = tshead_p[0].modelrot;
 tshead.modellat = tshead_p[0].modellat;
 tshead.modellon = tshead_p[0].modellon;
 
-val = (float *) check_malloc (3*tshead.nx*tshead.ny*sizeof(float));
-for(iy=0;iy<3*tshead.nx*tshead.ny;iy++)
-   val[iy] = 0;
+/*
+   The output is sized with ftruncate(), so the parts no processor
+   writes read back as zeros without a zero-fill pass, and the y-band
+   of each processor file is copied straight to its place in every
+   plane with positioned I/O.  The files are shared out over nthreads
+   threads.
+*/
 
 fdw = croptrfile(outfile);
 
 rite(fdw,&tshead,sizeof(struct tsheader));;
 
-for(it=0;it<tshead.nt;it++)
-   rite(fdw,val,3*tshead.nx*tshead.ny*sizeof(float));
-
-lseek(fdw,sizeof(struct tsheader),SEEK_SET);
 head_off = sizeof(struct tsheader);
-cur_off = sizeof(struct tsheader);
+nxblen = (off_t)(tshead.nx)*sizeof(float);
+
+if(ftruncate(fdw,head_off + (off_t)(3*tshead.nt)*tshead.ny*nxblen) != 0)
+   {
+   fprintf(stderr,"can't set size of %s, exiting ...\n",outfile);
+   exit(-1);
+   }
 
 dyts = (int)(tshead.dy/h + 0.5);
 
@@ -99,8 +121,11 @@ fprintf(stderr,"dy= %lg\n",tshead.dy);
 fprintf(stderr,"h= %lg\n",h);
 fprintf(stderr,"dyts= %d\n",dyts);
 
-nxblen = (off_t)(tshead.nx)*sizeof(float);
+#pragma omp parallel num_threads(nthreads) private(i,iy,it,j,fdr,off,inoff,blen,cpbuf)
+{
+cpbuf = (char *) check_malloc (MRG_BUFLEN);
 
+#pragma omp for schedule(dynamic,1)
 for(i=0;i<nproc;i++)
    {
    fprintf(stderr,"%d of %d\n",i+1,nproc);
@@ -111,33 +136,114 @@ for(i=0;i<nproc;i++)
 
    iy = iy/dyts;
 
-   /*
-   fprintf(stderr,"%5d: %5d %5d %5d, %5d\n",i,tshead_p[i].iyleft,tshead_p[i].iyright,tshead_p[i].localny,iy);
-   */
-
    if(tshead_p[i].localny > 0)
       {
       fdr = opfile_ro(infile[i]);
-      lseek(fdr,sizeof(struct tsheader_proc),SEEK_SET);
+
+      blen = (off_t)(tshead_p[i].localny)*nxblen;
+      inoff = sizeof(struct tsheader_proc);
 
       for(it=0;it<tshead.nt;it++)
          {
          for(j=0;j<3;j++)
             {
-	    reed(fdr,val,tshead.nx*tshead_p[i].localny*sizeof(float));
-
-	    off = head_off + (off_t)((3*it+j)*tshead.ny + iy)*nxblen - cur_off;
+	    off = head_off + ((off_t)(3*it+j)*tshead.ny + iy)*nxblen;
 
-	    lseek(fdw,off,SEEK_CUR);
-            nrite = rite(fdw,val,tshead.nx*tshead_p[i].localny*sizeof(float));
-	    cur_off = nrite + off + cur_off;
+	    copy_band(fdr,inoff,fdw,off,blen,cpbuf,MRG_BUFLEN);
+	    inoff = inoff + blen;
             }
          }
 
       close(fdr);
       }
    }
+
+free(cpbuf);
+}
+
 close(fdw);
+
+/*
+   With pyramid=1 the merged file is read back once to write the
+   sidecar outfile.pyr (see tspyr.c): pyr_nlev levels of every
+   pyr_tskip-th slice, halving the points in x and y each level, the
+   peak planes and the peaks of pyr_tile x pyr_tile tiles.
+*/
+if(pyramid)
+   {
+   sprintf(pyrfile,"%s.pyr",outfile);
+   fprintf(stderr,"pyramid %s: %lld bytes\n",pyrfile,
+                  (long long)(tspyr_build(outfile,pyrfile,pyr_nlev,pyr_tskip,pyr_tile,nthreads)));
+   }
+}
+
+/*
+   Copies len bytes from offset inoff of fdr to offset outoff of fdw,
+   in the kernel with copy_file_range() when the filesystems allow it,
+   otherwise through buf with pread()/pwrite().  File positions are not
+   used, so several threads can write the same output.
+*/
+void copy_band(int fdr,off_t inoff,int fdw,off_t outoff,off_t len,char *buf,size_t buflen)
+{
+ssize_t nr, nw, nd;
+size_t nc;
+int use_cfr = 1;
+
+while(len > 0)
+   {
+   nc = buflen;
+   if(nc > len)
+      nc = len;
+
+   if(use_cfr)
+      {
+      nr = copy_file_range(fdr,&inoff,fdw,&outoff,nc,0);
+      if(nr > 0)
+         {
+         len = len - nr;
+         continue;
+         }
+      if(nr < 0 && errno == EINTR)
+         continue;
+      if(nr < 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP))
+         {
+         use_cfr = 0;
+         continue;
+         }
+
+      fprintf(stderr,"READ ERROR in copy_file_range, %lld bytes left\n",(long long)(len));
+      exit(-1);
+      }
+
+   nr = pread(fdr,buf,nc,inoff);
+   if(nr < 0 && errno == EINTR)
+      continue;
+   if(nr <= 0)
+      {
+      fprintf(stderr,"READ ERROR\n");
+      fprintf(stderr,"%lld attempted  %lld read\n",(long long)(nc),(long long)(nr));
+      exit(-1);
+      }
+
+   nd = 0;
+   while(nd < nr)
+      {
+      nw = pwrite(fdw,buf+nd,nr-nd,outoff+nd);
+      if(nw < 0 && errno == EINTR)
+         continue;
+      if(nw <= 0)
+         {
+         fprintf(stderr,"WRITE ERROR\n");
+         fprintf(stderr,"%lld attempted  %lld written\n",(long long)(nr-nd),(long long)(nw));
+         exit(-1);
+         }
+      nd = nd + nw;
+      }
+
+   inoff = inoff + nr;
+   outoff = outoff + nr;
+   len = len - nr;
+   }
 }
 
 long long_swap(char *cbuf)
@@ -171,21 +277,3 @@ f_union.cval[0] = cbuf[3];
 
 return(f_union.fval);
 }
-
-void swap_in_place(int n,char *cbuf)
-{
-char cv;
-
-while(n--)
-   {
-   cv = cbuf[0];
-   cbuf[0] = cbuf[3];
-   cbuf[3] = cv;
-
-   cv = cbuf[1];
-   cbuf[1] = cbuf[2];
-   cbuf[2] = cv;
-
-   cbuf = cbuf + 4;
-   }
-}
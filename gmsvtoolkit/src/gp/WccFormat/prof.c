@@ -0,0 +1,211 @@
+/*
+ * prof.c - per-stage timers and counters.
+ *
+ * Environment:
+ *    GMSV_PROFILE=file.json   at exit, write the wall time, calls, bytes
+ *                             read and written, samples processed and FFT
+ *                             sizes of each stage to file.json; a process
+ *                             forked from the one that started (the
+ *                             nproc= workers) writes file.json.<pid>
+ *
+ * Without GMSV_PROFILE every call returns at once.  A stage is timed as
+ *
+ *    t0 = prof_start();
+ *    ...
+ *    prof_stop("wcc_tfilter",t0,nt);
+ *
+ * and the stage names are the keys of the "stages" object of the file.
+ * "fft_sizes" counts the FFTs of a stage by size, an n point FFT under
+ * the power of 2 at or below n.
+ * The wall time of a stage includes the stages it calls (the FFTs of a
+ * filter, say).  The counters are updated atomically, so threads may
+ * share a stage.  At most PROF_MAXSTAGE names are kept, the later ones
+ * are not counted.  The Fortran codes call the same functions through
+ * the shim of ucb/rotd50/prof_f.c.
+ */
+
+#include "include.h"
+
+#define		PROF_MAXSTAGE	64
+#define		PROF_NAMELEN	48
+#define		PROF_NSIZE	32
+
+struct prof_stage
+   {
+   char name[PROF_NAMELEN];
+   long long calls;
+   long long ns;                /* wall time, nanoseconds */
+   long long nread;             /* bytes */
+   long long nwritten;
+   long long samples;
+   long long nfft[PROF_NSIZE];  /* FFTs of 2^k <= n < 2^(k+1) points */
+   };
+
+static struct prof_stage prof_stages[PROF_MAXSTAGE];
+static int prof_nstage = 0;
+static char prof_lock = 0;
+static int prof_on = 0;
+static char prof_path[1024];
+static pid_t prof_pid;
+static double prof_t0;
+
+static double prof_clock()
+{
+struct timespec ts;
+
+clock_gettime(CLOCK_MONOTONIC,&ts);
+return(ts.tv_sec + 1.0e-09*ts.tv_nsec);
+}
+
+static void prof_dump()
+{
+FILE *fpw;
+struct prof_stage *ps;
+char path[1100];
+const char *prog;
+int i, k, n, first;
+
+prog = "unknown";
+#ifdef __GLIBC__
+prog = program_invocation_short_name;
+#endif
+
+if(getpid() == prof_pid)
+   strcpy(path,prof_path);
+else
+   sprintf(path,"%s.%d",prof_path,(int)getpid());
+
+if((fpw = fopen(path,"w")) == NULL)
+   {
+   fprintf(stderr,"CAN'T FOPEN FILE = %s, MODE = w\n",path);
+   return;
+   }
+
+n = __atomic_load_n(&prof_nstage,__ATOMIC_ACQUIRE);
+
+fprintf(fpw,"{\n");
+fprintf(fpw,"  \"program\": \"%s\",\n",prog);
+fprintf(fpw,"  \"pid\": %d,\n",(int)getpid());
+fprintf(fpw,"  \"wall_s\": %.6f,\n",prof_clock() - prof_t0);
+fprintf(fpw,"  \"stages\": {");
+for(i=0;i<n;i++)
+   {
+   ps = &prof_stages[i];
+   fprintf(fpw,"%s\n    \"%s\": {\"calls\": %lld, \"wall_s\": %.6f, \"bytes_read\": %lld, \"bytes_written\": %lld, \"samples\": %lld",
+      (i) ? "," : "",ps->name,ps->calls,1.0e-09*ps->ns,ps->nread,ps->nwritten,ps->samples);
+
+   first = 1;
+   for(k=0;k<PROF_NSIZE;k++)
+      {
+      if(ps->nfft[k] == 0)
+         continue;
+      fprintf(fpw,"%s\"%lld\": %lld",(first) ? ", \"fft_sizes\": {" : ", ",1LL << k,ps->nfft[k]);
+      first = 0;
+      }
+   if(!first)
+      fprintf(fpw,"}");
+   fprintf(fpw,"}");
+   }
+fprintf(fpw,"\n  }\n}\n");
+fclose(fpw);
+}
+
+__attribute__((constructor)) static void prof_init()
+{
+char *env;
+
+env = getenv("GMSV_PROFILE");
+if(env == NULL || env[0] == '\0')
+   return;
+
+strncpy(prof_path,env,1023);
+prof_path[1023] = '\0';
+prof_pid = getpid();
+prof_t0 = prof_clock();
+prof_on = 1;
+atexit(prof_dump);
+}
+
+/* the entry of stage, made on its first use; NULL when the table is full */
+static struct prof_stage *prof_find(char *stage)
+{
+struct prof_stage *ps;
+int i, n;
+
+n = __atomic_load_n(&prof_nstage,__ATOMIC_ACQUIRE);
+for(i=0;i<n;i++)
+   {
+   if(strcmp(prof_stages[i].name,stage) == 0)
+      return(&prof_stages[i]);
+   }
+
+while(__atomic_test_and_set(&prof_lock,__ATOMIC_ACQUIRE))
+   ;
+
+ps = NULL;
+n = prof_nstage;
+for(i=0;i<n;i++)
+   {
+   if(strcmp(prof_stages[i].name,stage) == 0)
+      ps = &prof_stages[i];
+   }
+if(ps == NULL && n < PROF_MAXSTAGE)
+   {
+   ps = &prof_stages[n];
+   strncpy(ps->name,stage,PROF_NAMELEN-1);
+   ps->name[PROF_NAMELEN-1] = '\0';
+   __atomic_store_n(&prof_nstage,n+1,__ATOMIC_RELEASE);
+   }
+
+__atomic_clear(&prof_lock,__ATOMIC_RELEASE);
+return(ps);
+}
+
+/* start time of a stage, -1 when profiling is off */
+double prof_start()
+{
+if(!prof_on)
+   return(-1.0);
+return(prof_clock());
+}
+
+/* one call of stage since t0 (from prof_start), over samples samples */
+void prof_stop(char *stage,double t0,long long samples)
+{
+struct prof_stage *ps;
+
+if(!prof_on || t0 < 0.0 || (ps = prof_find(stage)) == NULL)
+   return;
+
+__atomic_fetch_add(&ps->calls,1,__ATOMIC_RELAXED);
+__atomic_fetch_add(&ps->ns,(long long)(1.0e+09*(prof_clock() - t0)),__ATOMIC_RELAXED);
+__atomic_fetch_add(&ps->samples,samples,__ATOMIC_RELAXED);
+}
+
+void prof_io(char *stage,long long nread,long long nwritten)
+{
+struct prof_stage *ps;
+
+if(!prof_on || (ps = prof_find(stage)) == NULL)
+   return;
+
+__atomic_fetch_add(&ps->nread,nread,__ATOMIC_RELAXED);
+__atomic_fetch_add(&ps->nwritten,nwritten,__ATOMIC_RELAXED);
+}
+
+/* prof_stop() of an n point FFT, n also goes to the size counts */
+void prof_fft(char *stage,double t0,int n)
+{
+struct prof_stage *ps;
+int k;
+
+if(!prof_on || t0 < 0.0 || (ps = prof_find(stage)) == NULL)
+   return;
+
+prof_stop(stage,t0,n);
+
+k = 0;
+while(k < PROF_NSIZE-1 && (2LL << k) <= n)
+   k++;
+__atomic_fetch_add(&ps->nfft[k],1,__ATOMIC_RELAXED);
+}
@@ -1,3 +1,22 @@
+/**********************************************************************/
+/*                                                                    */
+/*           respect2bbp                                              */
+/*                                                                    */
+/*           The response spectra of respect (or respect_multi) for   */
+/*           nsfile, ewfile and udfile into the BBP file bbfile, one  */
+/*           line of period and the three column sa_column= values    */
+/*           per period (first damping of each file).                 */
+/*                                                                    */
+/*           Each file is read with one call and its table parsed in  */
+/*           place; the lines are formatted into one block            */
+/*           (bbp_format_line()) and written with one call.           */
+/*           filelist= does many stations in one run, by nthreads=    */
+/*           OpenMP threads, the lines being                          */
+/*                                                                    */
+/*              nsfile ewfile udfile bbfile                           */
+/*                                                                    */
+/**********************************************************************/
+
 #include "include.h"
 #include "structure.h"
 #include "function.h"
@@ -5,38 +24,53 @@
 
 #define SLEN 1024
 
+/* the header lines of a respect table, the 4th has the number of periods */
+#define RSP_NHEAD 4
+
+/* the output choices */
+struct rsp_par
+   {
+   char title[128];
+   char nsname[128];
+   char ewname[128];
+   char udname[128];
+   char units[128];
+   int sa_column;
+   struct bbp_format bf;
+   };
+
+void respect2bbp(char *,char *,char *,char *,struct rsp_par *);
+void read_respect(char *,int,int *,float **,float **);
+
 int main(int ac,char **av)
 {
 FILE *fpr;
-float *per1, *sa1, *per2, *sa2, *per3, *sa3;
-float v[8];
-int ip, np1, np2, np3;
+struct rsp_par rp;
+int n, nfile, nalloc;
+char (*nsfiles)[SLEN], (*ewfiles)[SLEN], (*udfiles)[SLEN], (*bbfiles)[SLEN];
 
 char nsfile[SLEN];
 char ewfile[SLEN];
 char udfile[SLEN];
 char bbfile[SLEN];
-char str[SLEN];
-
-char nsname[128];
-char ewname[128];
-char udname[128];
-char units[128];
+char str[4*SLEN];
+char filelist[SLEN];
 
 char tformat[16];
 char dformat[16];
-char frmt[256];
 
-char title[128];
+int nthreads = 1;
+
+rp.sa_column = 7; /* 3=rel disp, 4=rel vel, 5=pseudo rel vel, 6=absolute acc, 7=pseudo absolute acc; NGA=7 */
 
-int sa_column = 7; /* 3=rel disp, 4=rel vel, 5=pseudo rel vel, 6=absolute acc, 7=pseudo absolute acc; NGA=7 */
+rp.title[0] = '\0';
 
-title[0] = '\0';
+rp.nsname[0] = '\0';
+rp.ewname[0] = '\0';
+rp.udname[0] = '\0';
+rp.units[0] = '\0';
 
-nsname[0] = '\0';
-ewname[0] = '\0';
-udname[0] = '\0';
-units[0] = '\0';
+filelist[0] = '\0';
 
 sprintf(tformat,"%%.6e");
 sprintf(dformat,"\t%%.6e");
@@ -44,112 +78,201 @@ sprintf(bbfile,"stdout");
 
 setpar(ac,av);
 
-mstpar("nsfile","s",nsfile);
-mstpar("ewfile","s",ewfile);
-mstpar("udfile","s",udfile);
+getpar("filelist","s",filelist);
+if(filelist[0] == '\0')
+   {
+   mstpar("nsfile","s",nsfile);
+   mstpar("ewfile","s",ewfile);
+   mstpar("udfile","s",udfile);
+   }
 
-getpar("nsname","s",nsname);
-getpar("ewname","s",ewname);
-getpar("udname","s",udname);
+getpar("nsname","s",rp.nsname);
+getpar("ewname","s",rp.ewname);
+getpar("udname","s",rp.udname);
 
-getpar("units","s",units);
+getpar("units","s",rp.units);
 
 getpar("tformat","s",tformat);
 getpar("dformat","s",dformat);
 
 getpar("bbfile","s",bbfile);
-getpar("title","s",title);
-getpar("sa_column","d",&sa_column);
+getpar("title","s",rp.title);
+getpar("sa_column","d",&rp.sa_column);
+getpar("nthreads","d",&nthreads);
 
 endpar();
 
-fpr = fopfile(nsfile,"r");
-
-fgets(str,SLEN,fpr);
-fgets(str,SLEN,fpr);
-fgets(str,SLEN,fpr);
-fgets(str,SLEN,fpr);
-
-sscanf(str,"%d",&np1);
-
-per1 = (float *)check_malloc(np1*sizeof(float));
-sa1 = (float *)check_malloc(np1*sizeof(float));
-
-for(ip=0;ip<np1;ip++)
+if(rp.sa_column < 2 || rp.sa_column > 8)
    {
-   fgets(str,SLEN,fpr);
-   sscanf(str,"%f %f %f %f %f %f %f %f",&v[0],&v[1],&v[2],&v[3],&v[4],&v[5],&v[6],&v[7]);
-   per1[ip] = v[1];
-   sa1[ip] = v[sa_column-1];
+   fprintf(stderr,"*** sa_column= %d, it must be 2 ... 8, exiting...\n",rp.sa_column);
+   exit(-1);
    }
-fclose(fpr);
 
-fpr = fopfile(ewfile,"r");
+if(rp.units[0] == '\0')
+   sprintf(rp.units,"cm/s");
+if(rp.nsname[0] == '\0')
+   sprintf(rp.nsname,"N-S(%s)",rp.units);
+if(rp.ewname[0] == '\0')
+   sprintf(rp.ewname,"E-W(%s)",rp.units);
+if(rp.udname[0] == '\0')
+   sprintf(rp.udname,"U-D(%s)",rp.units);
 
-fgets(str,SLEN,fpr);
-fgets(str,SLEN,fpr);
-fgets(str,SLEN,fpr);
-fgets(str,SLEN,fpr);
+bbp_format_init(&rp.bf,tformat,dformat);
 
-sscanf(str,"%d",&np2);
+if(filelist[0] == '\0')
+   {
+   respect2bbp(nsfile,ewfile,udfile,bbfile,&rp);
+   exit(0);
+   }
 
-per2 = (float *)check_malloc(np2*sizeof(float));
-sa2 = (float *)check_malloc(np2*sizeof(float));
+nsfiles = NULL;
+ewfiles = NULL;
+udfiles = NULL;
+bbfiles = NULL;
+nfile = 0;
+nalloc = 0;
 
-for(ip=0;ip<np2;ip++)
+fpr = fopfile(filelist,"r");
+while(fgets(str,4*SLEN,fpr) != NULL)
    {
-   fgets(str,SLEN,fpr);
-   sscanf(str,"%f %f %f %f %f %f %f %f",&v[0],&v[1],&v[2],&v[3],&v[4],&v[5],&v[6],&v[7]);
-   per2[ip] = v[1];
-   sa2[ip] = v[sa_column-1];
+   if(nfile == nalloc)
+      {
+      nalloc = nalloc + 1024;
+      nsfiles = check_realloc(nsfiles,nalloc*SLEN);
+      ewfiles = check_realloc(ewfiles,nalloc*SLEN);
+      udfiles = check_realloc(udfiles,nalloc*SLEN);
+      bbfiles = check_realloc(bbfiles,nalloc*SLEN);
+      }
+
+   n = sscanf(str,"%1023s %1023s %1023s %1023s",nsfiles[nfile],ewfiles[nfile],udfiles[nfile],bbfiles[nfile]);
+   if(n < 4 || nsfiles[nfile][0] == '#')
+      continue;
+   nfile++;
    }
 fclose(fpr);
 
-fpr = fopfile(udfile,"r");
-
-fgets(str,SLEN,fpr);
-fgets(str,SLEN,fpr);
-fgets(str,SLEN,fpr);
-fgets(str,SLEN,fpr);
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic,1)
+for(n=0;n<nfile;n++)
+   respect2bbp(nsfiles[n],ewfiles[n],udfiles[n],bbfiles[n],&rp);
+}
 
-sscanf(str,"%d",&np3);
+/* the BBP file bbfile of the respect files nsfile, ewfile and udfile */
+void respect2bbp(char *nsfile,char *ewfile,char *udfile,char *bbfile,struct rsp_par *rp)
+{
+FILE *fpw;
+float *per1, *sa1, *per2, *sa2, *per3, *sa3;
+int ip, np1, np2, np3;
+char *buf, *pb;
 
-per3 = (float *)check_malloc(np3*sizeof(float));
-sa3 = (float *)check_malloc(np3*sizeof(float));
+read_respect(nsfile,rp->sa_column,&np1,&per1,&sa1);
+read_respect(ewfile,rp->sa_column,&np2,&per2,&sa2);
+read_respect(udfile,rp->sa_column,&np3,&per3,&sa3);
 
-for(ip=0;ip<np3;ip++)
+if(np2 < np1 || np3 < np1)
    {
-   fgets(str,SLEN,fpr);
-   sscanf(str,"%f %f %f %f %f %f %f %f",&v[0],&v[1],&v[2],&v[3],&v[4],&v[5],&v[6],&v[7]);
-   per3[ip] = v[1];
-   sa3[ip] = v[sa_column-1];
+   fprintf(stderr,"*** %s (%d periods) or %s (%d periods) shorter than %s (%d periods), exiting...\n",
+                             ewfile,np2,udfile,np3,nsfile,np1);
+   exit(-1);
    }
-fclose(fpr);
 
 if(strcmp(bbfile,"stdout") == 0)
-   fpr = stdout;
+   fpw = stdout;
 else
-   fpr = fopfile(bbfile,"w");
+   fpw = fopfile(bbfile,"w");
 
-if(title[0] != '\0')
-   fprintf(fpr,"# %s\n",title);
+if(rp->title[0] != '\0')
+   fprintf(fpw,"# %s\n",rp->title);
 
-if(units[0] == '\0')
-   sprintf(units,"cm/s");
-if(nsname[0] == '\0')
-   sprintf(nsname,"N-S(%s)",units);
-if(ewname[0] == '\0')
-   sprintf(ewname,"E-W(%s)",units);
-if(udname[0] == '\0')
-   sprintf(udname,"U-D(%s)",units);
+if(strcmp(rp->units,"-1") != 0)
+   fprintf(fpw,"#  period(sec)      %s      %s      %s\n",rp->nsname,rp->ewname,rp->udname);
 
-if(strcmp(units,"-1") != 0)
-   fprintf(fpr,"#  period(sec)      %s      %s      %s\n",nsname,ewname,udname);
+buf = (char *) check_malloc(((size_t) np1 + 1)*BBP_LINE);
+pb = buf;
+for(ip=0;ip<np1;ip++)
+   pb = bbp_format_line(pb,&rp->bf,per1[ip],sa1[ip],sa2[ip],sa3[ip]);
 
-sprintf(frmt,"%s%s%s%s\n",tformat,dformat,dformat,dformat);
+fwrite(buf,1,pb - buf,fpw);
+free(buf);
 
-for(ip=0;ip<np1;ip++)
-   fprintf(fpr,frmt,per1[ip],sa1[ip],sa2[ip],sa3[ip]);
+if(fpw != stdout)
+   fclose(fpw);
+else
+   fflush(fpw);
+
+free(per1);
+free(sa1);
+free(per2);
+free(sa2);
+free(per3);
+free(sa3);
+}
 
+/*
+   The periods (column 2) and the column sa_column values of the first
+   table of the respect file rfile.  The file is read with one call and
+   the lines parsed in place, up to column sa_column.
+*/
+void read_respect(char *rfile,int sa_column,int *np,float **per,float **sa)
+{
+FILE *fpr;
+char *buf, *pl, *pe;
+long len;
+int ip, il, ic;
+float v;
+
+fpr = fopfile(rfile,"r");
+fseek(fpr,0,SEEK_END);
+len = ftell(fpr);
+rewind(fpr);
+
+buf = (char *) check_malloc(len + 1);
+len = fread(buf,1,len,fpr);
+buf[len] = '\0';
 fclose(fpr);
+
+pl = buf;
+for(il=0;il<RSP_NHEAD-1 && pl != NULL;il++)
+   {
+   pl = strchr(pl,'\n');
+   if(pl != NULL)
+      pl++;
+   }
+
+if(pl == NULL || sscanf(pl,"%d",np) != 1 || *np < 0)
+   {
+   fprintf(stderr,"*** no table header (4th line: number of periods) in %s, exiting...\n",rfile);
+   exit(-1);
+   }
+
+*per = (float *) check_malloc((*np + 1)*sizeof(float));
+*sa = (float *) check_malloc((*np + 1)*sizeof(float));
+
+for(ip=0;ip<*np;ip++)
+   {
+   pl = strchr(pl,'\n');
+   if(pl == NULL)
+      {
+      fprintf(stderr,"*** %s ends after %d of %d periods, exiting...\n",rfile,ip,*np);
+      exit(-1);
+      }
+   pl++;
+
+   for(ic=1;ic<=sa_column;ic++)
+      {
+      v = strtof(pl,&pe);
+      if(pe == pl)
+         {
+         fprintf(stderr,"*** bad line %d of the table in %s, exiting...\n",ip+1,rfile);
+         exit(-1);
+         }
+      pl = pe;
+
+      if(ic == 2)
+         (*per)[ip] = v;
+      if(ic == sa_column)
+         (*sa)[ip] = v;
+      }
+   }
+
+free(buf);
 }
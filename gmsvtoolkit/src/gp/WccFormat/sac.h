@@ -304,6 +304,15 @@ static SACHEAD sac_null = {
 /* number of bytes in header that need to be swapped on PC (int+float+long)*/
 #define HD_SIZE 440
 
+/* SAC file returned by map_sac(): header and samples in place */
+typedef struct sac_map
+{
+  SACHEAD	*hd;		/* header, in place          */
+  float		*ar;		/* the samples, in place     */
+  void		*base;		/* mapping or malloc'd copy  */
+  size_t	len;		/* mapping length, 0 if copy */
+} SACMAP;
+
 #define TMARK	10
 #define USERN	40
 
@@ -315,5 +324,7 @@ int	write_sac(const char *, SACHEAD, const float *,int);
 int	wrtsac0(const char *, float, int, float, float, const float *,int);
 int	wrtsac2(const char *, int, const float *x, const float *y,int);
 void	swab4(char *, int);
+float	*map_sac(const char *, SACMAP *, int);
+void	unmap_sac(SACMAP *);
 
 #endif
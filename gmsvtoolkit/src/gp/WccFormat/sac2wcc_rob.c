@@ -1,106 +1,331 @@
+/**********************************************************************/
+/*                                                                    */
+/*           sac2wcc_rob                                              */
+/*                                                                    */
+/*           Converts the SAC file infile into the WCC trace outfile, */
+/*           the time of the first sample relative to the event time  */
+/*           (event_yr= ... event_sec=, from the SAC header if not    */
+/*           given).  The SAC file is mapped, not read (map_sac()),   */
+/*           its byte order found from the header version.            */
+/*                                                                    */
+/*           With filelist= many files are converted in one run, by   */
+/*           nthreads= OpenMP threads.  The lines of filelist are     */
+/*                                                                    */
+/*              sacfile outfile                                       */
+/*                                                                    */
+/*           or, with outpack= (all of them into that WCC pack),      */
+/*                                                                    */
+/*              sacfile [stat [comp]]                                 */
+/*                                                                    */
+/*           stat and comp of a line replacing stat= and comp=.  The  */
+/*           samples go into the pack from the mapped files.  A file  */
+/*           that cannot be read is reported and skipped, and the     */
+/*           run ends with an error.                                  */
+/*                                                                    */
+/*           stat and comp not given are kstnm and kcmpnm of the SAC  */
+/*           header.                                                  */
+/*                                                                    */
+/**********************************************************************/
+
 #include "include.h"
 #include "structure.h"
 #include "function.h"
+#include "getpar.h"
 #include "sac.h"
 
+#define LINELEN 1024
+
+/* files mapped at a time by the threads before they go into the pack */
+#define SAC_BATCH 1024
+
+/* the header choices of the command line */
+struct sac2wcc_par
+   {
+   char stat[16];
+   char comp[4];
+   char title[128];
+   int event_yr;
+   int event_jday;
+   int event_hr;
+   int event_min;
+   double event_sec;
+   int use_header_cmpaz;
+   };
+
+/* one line of filelist */
+struct sacline
+   {
+   char infile[LINELEN];
+   char outfile[LINELEN];
+   char stat[STATCHAR];
+   char comp[COMPCHAR];
+   };
+
+void sac2wcc_head(SACHEAD *,struct sac2wcc_par *,char *,char *,struct statdata *);
+void sac_string(char *,char *,int,int);
+struct sacline *read_saclist(char *,int,int *);
+
 int size_float = sizeof(float);
 int size_int = sizeof(int);
 
 int main(int ac, char **av)
 {
-struct statdata head1;
-float *s1, time_sec;
-SACHEAD sachd;
-int i, j, nt1;
-
-char infile[128];
-char outfile[128];
+struct statdata head1, *heads;
+struct sac2wcc_par sp;
+struct sacline *sl;
+struct wccpack *wp;
+SACMAP sm, *sms;
+float *s1;
+int n, n0, nb, nfile, nbad;
 
-char stat[16];
-char comp[4];
-char title[128];
+char infile[LINELEN];
+char outfile[LINELEN];
+char filelist[512];
+char outpack[512];
 
-int event_yr = -999;
-int event_jday = -999;
-int event_hr = -999;
-int event_min = -999;
-double event_sec = -1.0e+15;
-
-int use_header_cmpaz = 0;
 int outbin = 0;
+int nthreads = 1;
 
 int swap_bytes = 0;
 
-stat[0] = '\0';
-comp[0] = '\0';
-title[0] = '\0';
+sp.stat[0] = '\0';
+sp.comp[0] = '\0';
+sp.title[0] = '\0';
+sp.event_yr = -999;
+sp.event_jday = -999;
+sp.event_hr = -999;
+sp.event_min = -999;
+sp.event_sec = -1.0e+15;
+sp.use_header_cmpaz = 0;
+
+filelist[0] = '\0';
+outpack[0] = '\0';
 
 setpar(ac,av);
-mstpar("infile","s",infile);
-mstpar("outfile","s",outfile);
+getpar("filelist","s",filelist);
+if(filelist[0] == '\0')
+   {
+   mstpar("infile","s",infile);
+   mstpar("outfile","s",outfile);
+   }
+getpar("outpack","s",outpack);
+getpar("nthreads","d",&nthreads);
 getpar("swap_bytes","d",&swap_bytes);
-getpar("stat","s",stat);
-getpar("comp","s",comp);
-getpar("title","s",title);
+getpar("stat","s",sp.stat);
+getpar("comp","s",sp.comp);
+getpar("title","s",sp.title);
 getpar("outbin","d",&outbin);
-getpar("event_yr","d",&event_yr);
-getpar("event_jday","d",&event_jday);
-getpar("event_hr","d",&event_hr);
-getpar("event_min","d",&event_min);
-getpar("event_sec","F",&event_sec);
-getpar("use_header_cmpaz","d",&use_header_cmpaz);
+getpar("event_yr","d",&sp.event_yr);
+getpar("event_jday","d",&sp.event_jday);
+getpar("event_hr","d",&sp.event_hr);
+getpar("event_min","d",&sp.event_min);
+getpar("event_sec","F",&sp.event_sec);
+getpar("use_header_cmpaz","d",&sp.use_header_cmpaz);
 endpar();
 
-if((s1 = read_sac(infile,&sachd,swap_bytes)) == NULL)
+if(filelist[0] == '\0')
+   {
+   if((s1 = map_sac(infile,&sm,swap_bytes)) == NULL)
+      {
+      exit(-1);
+      }
+
+   sac2wcc_head(sm.hd,&sp,sp.stat,sp.comp,&head1);
+   write_wccseis(outfile,&head1,s1,outbin);
+   unmap_sac(&sm);
+   exit(0);
+   }
+
+sl = read_saclist(filelist,(outpack[0] != '\0'),&nfile);
+
+nbad = 0;
+if(outpack[0] == '\0')
+   {
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic,1) private(sm,s1,head1) reduction(+:nbad)
+   for(n=0;n<nfile;n++)
+      {
+      if((s1 = map_sac(sl[n].infile,&sm,swap_bytes)) == NULL)
+         {
+         nbad++;
+         continue;
+         }
+
+      sac2wcc_head(sm.hd,&sp,sp.stat,sp.comp,&head1);
+      write_wccseis(sl[n].outfile,&head1,s1,outbin);
+      unmap_sac(&sm);
+      }
+   }
+else
    {
+   sms = (SACMAP *) check_malloc(SAC_BATCH*sizeof(SACMAP));
+   heads = (struct statdata *) check_malloc(SAC_BATCH*sizeof(struct statdata));
+
+   wp = wccpack_open(outpack,1);
+   for(n0=0;n0<nfile;n0=n0+SAC_BATCH)
+      {
+      nb = nfile - n0;
+      if(nb > SAC_BATCH)
+         nb = SAC_BATCH;
+
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic,1) reduction(+:nbad)
+      for(n=0;n<nb;n++)
+         {
+         if(map_sac(sl[n0+n].infile,&sms[n],swap_bytes) == NULL)
+            {
+            nbad++;
+            continue;
+            }
+
+         sac2wcc_head(sms[n].hd,&sp,sl[n0+n].stat,sl[n0+n].comp,&heads[n]);
+         }
+
+      for(n=0;n<nb;n++)
+         {
+         if(sms[n].base == NULL)
+            continue;
+
+         wccpack_add(wp,heads[n].stat,heads[n].comp,&heads[n],sms[n].ar);
+         unmap_sac(&sms[n]);
+         }
+      }
+   wccpack_close(wp);
+
+   free(sms);
+   free(heads);
+   }
+
+free(sl);
+
+if(nbad)
+   {
+   fprintf(stderr,"*** %d of %d files of %s not converted\n",nbad,nfile,filelist);
    exit(-1);
    }
+exit(0);
+}
+
+/*
+   The WCC header of the SAC header sachd; stat and comp (if not "")
+   and the choices of sp replace the ones of sachd.
+*/
+void sac2wcc_head(SACHEAD *sachd,struct sac2wcc_par *sp,char *stat,char *comp,struct statdata *head1)
+{
+float time_sec;
+int event_yr, event_jday, event_hr, event_min;
+double event_sec;
+
+memset(head1,0,sizeof(struct statdata));
 
 if(stat[0] != '\0')
-   strcpy(head1.stat,stat);
+   strncpy(head1->stat,stat,STATCHAR-1);
+else
+   sac_string(head1->stat,sachd->kstnm,sizeof(sachd->kstnm),STATCHAR);
 
-if(comp[0] != '\0')
-   strcpy(head1.comp,comp);
+if(sp->use_header_cmpaz != 0)
+   snprintf(head1->comp,COMPCHAR,"%3.0f",sachd->cmpaz);
+else if(comp[0] != '\0')
+   strncpy(head1->comp,comp,COMPCHAR-1);
+else
+   sac_string(head1->comp,sachd->kcmpnm,sizeof(sachd->kcmpnm),COMPCHAR);
 
-if(use_header_cmpaz != 0)
-   sprintf(head1.comp,"%3.0f",sachd.cmpaz);
+if(sp->title[0] != '\0')
+   strncpy(head1->stitle,sp->title,TITLCHAR-1);
 
-if(title[0] != '\0')
-   strcpy(head1.stitle,title);
+event_yr = sp->event_yr;
+event_jday = sp->event_jday;
+event_hr = sp->event_hr;
+event_min = sp->event_min;
+event_sec = sp->event_sec;
 
 if(event_yr < 0)
-   event_yr = sachd.nzyear;
+   event_yr = sachd->nzyear;
 if(event_jday < 0)
-   event_jday = sachd.nzjday;
+   event_jday = sachd->nzjday;
 if(event_hr < 0)
-   event_hr = sachd.nzhour;
+   event_hr = sachd->nzhour;
 if(event_min < 0)
-   event_min = sachd.nzmin;
+   event_min = sachd->nzmin;
 if(event_sec < -1.0e+10)
-   event_sec = (double)(sachd.nzsec) + 0.001*((double)(sachd.nzmsec));
+   event_sec = (double)(sachd->nzsec) + 0.001*((double)(sachd->nzmsec));
 
-head1.nt = sachd.npts;
-head1.dt = sachd.delta;
+head1->nt = sachd->npts;
+head1->dt = sachd->delta;
 
-time_sec = 365*24*3600.0*(sachd.nzyear - event_yr)
-	      + 24*3600.0*(sachd.nzjday - event_jday)
-	      + 3600.0*(sachd.nzhour - event_hr)
-	      + 60.0*(sachd.nzmin - event_min)
-	      + (sachd.nzsec - event_sec)
-	      + 0.001*sachd.nzmsec
-	      + sachd.b;
+time_sec = 365*24*3600.0*(sachd->nzyear - event_yr)
+	      + 24*3600.0*(sachd->nzjday - event_jday)
+	      + 3600.0*(sachd->nzhour - event_hr)
+	      + 60.0*(sachd->nzmin - event_min)
+	      + (sachd->nzsec - event_sec)
+	      + 0.001*sachd->nzmsec
+	      + sachd->b;
 
-/*
-fprintf(stderr,"b=%g nzsec=%d nzmsec=%d esec=%.20f t=%.20f\n",sachd.b,sachd.nzsec,sachd.nzmsec,event_sec,time_sec);
-*/
+head1->hr = (int)(time_sec/3600.0);
+head1->min = (int)(time_sec/60.0) - 60*head1->hr;
+head1->sec = time_sec - 3600.0*head1->hr - 60.0*head1->min;
 
-head1.hr = (int)(time_sec/3600.0);
-head1.min = (int)(time_sec/60.0) - 60*head1.hr;
-head1.sec = time_sec - 3600.0*head1.hr - 60.0*head1.min;
+head1->edist = sachd->dist;
+head1->az = 0.0;
+head1->baz = 0.0;
+}
+
+/* the SAC string field f of n chars without its blanks, "" if undefined */
+void sac_string(char *str,char *f,int n,int len)
+{
+int i;
 
-head1.edist = sachd.dist;
-head1.az = 0.0;
-head1.baz = 0.0;
+if(n > len - 1)
+   n = len - 1;
+
+for(i=0;i<n && f[i] != ' ' && f[i] != '\0';i++)
+   str[i] = f[i];
+str[i] = '\0';
+
+if(strncmp(str,"-12345",6) == 0)
+   str[0] = '\0';
+}
+
+/* the lines of filelist, see the top of the file */
+struct sacline *read_saclist(char *filelist,int packed,int *nfile)
+{
+FILE *fpr, *fopfile();
+struct sacline *sl;
+char str[3*LINELEN];
+int n, nalloc, na;
+
+sl = NULL;
+n = 0;
+nalloc = 0;
+
+fpr = fopfile(filelist,"r");
+while(fgets(str,3*LINELEN,fpr) != NULL)
+   {
+   if(n == nalloc)
+      {
+      nalloc = nalloc + 1024;
+      sl = (struct sacline *) check_realloc(sl,nalloc*sizeof(struct sacline));
+      }
+
+   sl[n].outfile[0] = '\0';
+   sl[n].stat[0] = '\0';
+   sl[n].comp[0] = '\0';
+
+   if(packed)
+      na = sscanf(str,"%1023s %11s %3s",sl[n].infile,sl[n].stat,sl[n].comp);
+   else
+      na = sscanf(str,"%1023s %1023s",sl[n].infile,sl[n].outfile);
+
+   if(na < 1 || sl[n].infile[0] == '#')
+      continue;
+
+   if(!packed && na < 2)
+      {
+      fprintf(stderr,"*** no outfile for %s in %s (outpack= not given), exiting...\n",sl[n].infile,filelist);
+      exit(-1);
+      }
+   n++;
+   }
+fclose(fpr);
 
-write_wccseis(outfile,&head1,s1,outbin);
+*nfile = n;
+return(sl);
 }
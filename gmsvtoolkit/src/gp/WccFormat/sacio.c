@@ -9,14 +9,30 @@
 *	wrtsac2		write 2 1D arrays as XY SAC data
 *	wrtsac2_	fortran wrap for wrtsac2
 *	swab4		reverse byte order for integer/float
+*	map_sac		map SAC binary data, header and samples in place
+*	unmap_sac	release a map_sac() file
 *********************************************************************/
 
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "sac.h"
 
+/* header versions (internal4) of SAC files, 7 adds a footer */
+#define SAC_NVHDR	6
+#define SAC_NVHDR_MAX	7
+
+/* byte order reversal of iofunc.c, vectorized */
+void	swap_in_place(int, char *);
+
+static int	sac_check(const char *, SACHEAD *, size_t, int);
+static size_t	fread_fd(int, void *, size_t);
+
 /***********************************************************
 
   read_sachead
@@ -222,16 +238,202 @@ void	swab4(	char	*pt,
 		int	n
 	)
 {
-  int i;
-  char temp;
-  for(i=0;i<n;i+=4) {
-    temp = pt[i+3];
-    pt[i+3] = pt[i];
-    pt[i] = temp;
-    temp = pt[i+2];
-    pt[i+2] = pt[i+1];
-    pt[i+1] = temp;
+  swap_in_place(n/4, pt);
+}
+
+
+
+/***********************************************************
+
+  map_sac
+
+  Description:	SAC binary data without copying.  The file is mapped
+		(private, so the samples can be changed in memory) and
+		sm->hd and sm->ar point into the mapping; input that
+		cannot be mapped (stdin, a pipe) is read into one
+		malloc'd block with the same layout.  The header is
+		checked (version, npts against the file length, delta)
+		and its byte order taken from the version, so a file
+		written on the other byte order is swapped, header and
+		samples in one pass, whatever swap_bytes says; swap_bytes
+		only decides for files without a version.
+
+  Arguments:	const char *name 	file name, "stdin" for stdin
+		SACMAP *sm		filled in, release with unmap_sac()
+		int swap_bytes		byte order if not in the header
+
+  Return:	sm->ar, NULL if failed (with a message)
+
+************************************************************/
+
+float*	map_sac(const char	*name,
+		SACMAP		*sm,
+		int		swap_bytes
+	)
+{
+  struct stat	sbuf;
+  SACHEAD	hd;
+  size_t	hlen, dlen;
+  int		fd, swap;
+
+  hlen = sizeof(SACHEAD);
+  sm->base = NULL;
+  sm->len = 0;
+
+  if (strcmp(name, "stdin") == 0)
+     fd = STDIN_FILENO;
+  else if ((fd = open(name, O_RDONLY)) < 0) {
+     fprintf(stderr, "Unable to open %s\n",name);
+     return NULL;
+  }
+
+  if (fstat(fd, &sbuf) == 0 && S_ISREG(sbuf.st_mode) && sbuf.st_size >= hlen) {
+     sm->base = mmap(NULL, sbuf.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+     if (sm->base == MAP_FAILED)
+        sm->base = NULL;
+     else
+        sm->len = sbuf.st_size;
+  }
+
+  if (sm->base == NULL) {
+     /* read it: the header, then the samples it says */
+     if (fread_fd(fd, &hd, hlen) != hlen) {
+        fprintf(stderr, "Error in reading SAC header %s\n",name);
+        if (fd != STDIN_FILENO) close(fd);
+        return NULL;
+     }
+     if ((swap = sac_check(name, &hd, 0, swap_bytes)) < 0) {
+        if (fd != STDIN_FILENO) close(fd);
+        return NULL;
+     }
+
+     dlen = (size_t)(hd.npts)*sizeof(float);
+     if (hd.iftype == IXY || !hd.leven) dlen *= 2;
+
+     if ((sm->base = malloc(hlen + dlen)) == NULL) {
+        fprintf(stderr, "Error in allocating memory for reading %s\n",name);
+        if (fd != STDIN_FILENO) close(fd);
+        return NULL;
+     }
+     memcpy(sm->base, &hd, hlen);
+     if (fread_fd(fd, (char *) sm->base + hlen, dlen) != dlen) {
+        fprintf(stderr, "Error in reading SAC data %s\n",name);
+        free(sm->base);
+        sm->base = NULL;
+        if (fd != STDIN_FILENO) close(fd);
+        return NULL;
+     }
+  }
+  else {
+     if ((swap = sac_check(name, (SACHEAD *) sm->base, sm->len, swap_bytes)) < 0) {
+        munmap(sm->base, sm->len);
+        sm->base = NULL;
+        sm->len = 0;
+        close(fd);
+        return NULL;
+     }
+  }
+
+  if (fd != STDIN_FILENO) close(fd);
+
+  sm->hd = (SACHEAD *) sm->base;
+  sm->ar = (float *) ((char *) sm->base + hlen);
+
+  if (swap) {
+     dlen = (size_t)(sm->hd->npts)*sizeof(float);
+     if (sm->hd->iftype == IXY || !sm->hd->leven) dlen *= 2;
+     swab4((char *) sm->ar, dlen);
+  }
+
+  return sm->ar;
+
+}
+
+
+
+/* release a file of map_sac() */
+void	unmap_sac(SACMAP *sm)
+{
+  if (sm->len)
+     munmap(sm->base, sm->len);
+  else
+     free(sm->base);
+
+  sm->base = NULL;
+  sm->hd = NULL;
+  sm->ar = NULL;
+  sm->len = 0;
+}
+
+
+
+/*
+  fread() of an fd: reads len bytes unless the input ends first,
+  returns the bytes read
+*/
+static size_t	fread_fd(int fd, void *buf, size_t len)
+{
+  size_t	nr = 0;
+  ssize_t	n;
+
+  while (nr < len) {
+     n = read(fd, (char *) buf + nr, len - nr);
+     if (n <= 0) break;
+     nr += n;
+  }
+  return nr;
+}
+
+
+
+/*
+  Checks the SAC header hd (swapped to this byte order if needed, in
+  place) of a file of flen bytes (0: not known yet).  Returns 1 if the
+  file is in the other byte order, 0 if not, -1 (with a message) if it
+  is not a SAC file tools can use.
+*/
+static int	sac_check(const char	*name,
+		SACHEAD		*hd,
+		size_t		flen,
+		int		swap_bytes
+	)
+{
+  unsigned int	v;
+  size_t	dlen;
+  int		swap;
+
+  memcpy(&v, &hd->internal4, sizeof(v));
+  if (v >= SAC_NVHDR && v <= SAC_NVHDR_MAX)
+     swap = 0;
+  else if (__builtin_bswap32(v) >= SAC_NVHDR && __builtin_bswap32(v) <= SAC_NVHDR_MAX)
+     swap = 1;
+  else if (v == 0)
+     swap = (swap_bytes != 0);
+  else {
+     fprintf(stderr, "%s is not a SAC file (header version %d)\n",name,hd->internal4);
+     return -1;
+  }
+
+  if (swap)
+     swab4((char *) hd, HD_SIZE);
+
+  if (hd->npts < 0) {
+     fprintf(stderr, "Bad SAC header %s: npts= %d\n",name,hd->npts);
+     return -1;
+  }
+  if (hd->leven && hd->iftype != IXY && !(hd->delta > 0.0)) {
+     fprintf(stderr, "Bad SAC header %s: delta= %g\n",name,hd->delta);
+     return -1;
   }
+
+  dlen = (size_t)(hd->npts)*sizeof(float);
+  if (hd->iftype == IXY || !hd->leven) dlen *= 2;
+  if (flen && sizeof(SACHEAD) + dlen > flen) {
+     fprintf(stderr, "SAC file %s too short for npts= %d\n",name,hd->npts);
+     return -1;
+  }
+
+  return swap;
 }
 
 
@@ -0,0 +1,163 @@
+#include "include.h"
+#include "structure.h"
+#include "function.h"
+
+/*
+   Spectral weighting kernels shared by the FFT based tools (site
+   amplification, resampling): complex-by-real scaling of a half
+   spectrum, the end taper with dt scaling applied before the forward
+   FFT, and the 1/(nt*dt) normalization after the inverse.  The loops
+   have no calls or divisions and vectorize; the results are the same,
+   bit for bit, as the per-tool ampfac(), taper_norm() and norm() they
+   replace.
+*/
+
+#define SPEC_MAXWIN 16
+
+/* taper windows 1 + cos(arg) by length, kept for the process */
+static struct spec_win
+   {
+   int ntap;
+   double *w;
+   } spec_win[SPEC_MAXWIN];
+static int spec_nwin = 0;
+
+/* log(i), i < spec_nlogi, see spec_logi() */
+static double *spec_logi_tab = NULL;
+static int spec_nlogi = 0;
+
+/*
+   window of spec_taper_norm(), w[k] = 1 + cos((k+1)*pi/ntap) with the
+   float rounding of the original loop; *tmp = 1 when the table is full
+   and the caller must free it
+*/
+static double *spec_taper_win(int ntap,int *tmp)
+{
+double *w = NULL;
+float df, arg;
+int i, k;
+
+*tmp = 0;
+
+#pragma omp critical (spec1d_win)
+   {
+   for(i=0;i<spec_nwin;i++)
+      {
+      if(spec_win[i].ntap == ntap)
+         {
+         w = spec_win[i].w;
+         break;
+         }
+      }
+
+   if(w == NULL)
+      {
+      w = (double *) check_malloc(ntap*sizeof(double));
+
+      df = 3.14159/(float)(ntap);
+      for(k=0;k<ntap;k++)
+         {
+         arg = (k+1)*df;
+         w[k] = 1.0 + cos(arg);
+         }
+
+      if(spec_nwin < SPEC_MAXWIN)
+         {
+         spec_win[spec_nwin].ntap = ntap;
+         spec_win[spec_nwin].w = w;
+         spec_nwin++;
+         }
+      else
+         *tmp = 1;
+      }
+   }
+
+return(w);
+}
+
+/* g[i] = ampf[i]*g[i] for the bins 1 ... n/2-1 of an n point spectrum */
+SIMD_CLONES void spec_ampfac(struct complex *g,float *ampf,int n)
+{
+float *x = (float *)(g);
+int i;
+
+for(i=1;i<n/2;i++)
+   {
+   x[2*i] = ampf[i]*x[2*i];
+   x[2*i+1] = ampf[i]*x[2*i+1];
+   }
+}
+
+/* g = g/(dt*nt), after the inverse FFT */
+SIMD_CLONES void spec_norm(float *g,float dt,int nt)
+{
+float fac;
+int i;
+
+fac = 1.0/(dt*nt);
+for(i=0;i<nt;i++)
+   g[i] = g[i]*fac;
+}
+
+/*
+   g = g*dt, with a cosine taper to zero over the last nt*tap_per
+   samples, before the forward FFT
+*/
+SIMD_CLONES void spec_taper_norm(float *g,float dt,int nt,float tap_per)
+{
+double *w;
+double hdt;
+int i, ntap, nb, tmp;
+
+ntap = nt*tap_per;
+nb = nt - ntap;
+
+for(i=0;i<nb;i++)
+   g[i] = g[i]*dt;
+
+if(ntap > 0)
+   {
+   w = spec_taper_win(ntap,&tmp);
+
+   hdt = dt*0.5;
+   for(i=0;i<ntap;i++)
+      g[nb+i] = g[nb+i]*(float)(hdt*w[i]);
+
+   if(tmp)
+      free(w);
+   }
+}
+
+/*
+   table of log(i) for 1 <= i < n ([0] = 0), for log-frequency
+   interpolation on the bins i*df without a log per bin.  The table is
+   only ever replaced by a longer one; the old ones stay allocated, as
+   other threads may still read them, which costs at most the size of
+   the last one.
+*/
+const double *spec_logi(int n)
+{
+double *t;
+int i, nn;
+
+#pragma omp critical (spec1d_logi)
+   {
+   if(n > spec_nlogi)
+      {
+      nn = 1024;
+      while(nn < n)
+         nn = 2*nn;
+
+      t = (double *) check_malloc(nn*sizeof(double));
+      t[0] = 0.0;
+      for(i=1;i<nn;i++)
+         t[i] = log((double)(i));
+
+      spec_logi_tab = t;
+      spec_nlogi = nn;
+      }
+   t = spec_logi_tab;
+   }
+
+return(t);
+}
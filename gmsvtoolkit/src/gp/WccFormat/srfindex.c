@@ -0,0 +1,480 @@
+/*
+   Indexed reader of SRF files (gmsv_srf_* of gmsvlib.h).
+
+   One pass over the SRF collects the version, the PLANE block, and
+   for every point its byte offset in the file, lon, lat, dep, area,
+   tinit and total slip; the slip functions are skipped.  Magnitude,
+   hypocenter (the point with the smallest tinit, as srf_gethypo),
+   the points of a segment (as srf2xyz lonlatdep=1 nseg=) and the
+   segment parameters then come from that index.  With idxfile given
+   the index is also written there, and an index file that matches
+   the size and time of the SRF is read instead of the SRF.
+
+   The points of segment k are the k-th POINTS block or, when the
+   blocks are not one per plane, the next nstk*ndip points.
+*/
+
+#include "include.h"
+#include "structure.h"
+#include "function.h"
+#include "gmsvlib.h"
+
+#define SRF_IDX_MAGIC "GMSVSRF1"
+
+struct srf_ipt
+   {
+   long long off;       /* of the first line of the point */
+   float lon;
+   float lat;
+   float dep;
+   float area;
+   float tinit;
+   float slip;
+   };
+
+struct srf_ihead
+   {
+   char magic[8];
+   long long size;
+   long long mtime;
+   float version;
+   int nseg;
+   int npts;
+   int ihypo;
+   };
+
+struct gmsv_srf
+   {
+   struct srf_ihead h;
+   struct gmsv_srf_plane *pl;
+   int *first;          /* first point of each segment */
+   struct srf_ipt *pt;
+   };
+
+static char *srf_line(FILE *fp,char **buf,size_t *len,long long *off,long long *start)
+{
+ssize_t n;
+
+*start = *off;
+n = getline(buf,len,fp);
+if(n < 0)
+   return(NULL);
+
+*off = *off + n;
+return(*buf);
+}
+
+/* next line that is not blank or a comment */
+static char *srf_data_line(FILE *fp,char **buf,size_t *len,long long *off,long long *start)
+{
+char *str;
+
+while((str = srf_line(fp,buf,len,off,start)) != NULL)
+   {
+   str = str + strspn(str," \t\r\n");
+   if(str[0] != '\0' && str[0] != '#')
+      return(str);
+   }
+
+return(NULL);
+}
+
+static int srf_count(char *str)
+{
+int n = 0;
+
+while(1)
+   {
+   str = str + strspn(str," \t\r\n");
+   if(str[0] == '\0')
+      return(n);
+   str = str + strcspn(str," \t\r\n");
+   n++;
+   }
+}
+
+static int srf_parse(struct gmsv_srf *sf,const char *file)
+{
+FILE *fp;
+struct srf_ipt *p;
+char *buf = NULL, *str;
+size_t len = 0;
+long long off = 0, start;
+float stk, dip, rake, slip1, slip2, slip3, tmin;
+int *bcount = NULL;
+int i, k, iblk, np, nalloc, nt1, nt2, nt3, nskip, nrest;
+
+if((fp = fopen(file,"r")) == NULL)
+   {
+   fprintf(stderr,"CAN'T FOPEN FILE = %s, MODE = r\n",file);
+   return(-1);
+   }
+
+if((str = srf_data_line(fp,&buf,&len,&off,&start)) == NULL || sscanf(str,"%f",&sf->h.version) != 1)
+   {
+   fprintf(stderr,"%s: not an SRF file\n",file);
+   fclose(fp);
+   free(buf);
+   return(-1);
+   }
+
+sf->h.nseg = 0;
+sf->h.npts = 0;
+sf->h.ihypo = -1;
+nalloc = 0;
+iblk = 0;
+tmin = 1.0e+15;
+
+str = srf_data_line(fp,&buf,&len,&off,&start);
+if(str != NULL && strncmp(str,"PLANE",5) == 0)
+   {
+   sscanf(str+5,"%d",&sf->h.nseg);
+   sf->pl = (struct gmsv_srf_plane *) check_malloc((sf->h.nseg+1)*sizeof(struct gmsv_srf_plane));
+   for(i=0;i<sf->h.nseg;i++)
+      {
+      str = srf_data_line(fp,&buf,&len,&off,&start);
+      if(str == NULL || sscanf(str,"%f %f %d %d %f %f",&sf->pl[i].elon,&sf->pl[i].elat,
+                          &sf->pl[i].nstk,&sf->pl[i].ndip,&sf->pl[i].len,&sf->pl[i].wid) != 6)
+         break;
+      str = srf_data_line(fp,&buf,&len,&off,&start);
+      if(str == NULL || sscanf(str,"%f %f %f %f %f",&sf->pl[i].stk,&sf->pl[i].dip,
+                          &sf->pl[i].dtop,&sf->pl[i].shyp,&sf->pl[i].dhyp) != 5)
+         break;
+      sf->pl[i].npts = 0;
+      }
+   if(i < sf->h.nseg)
+      {
+      fprintf(stderr,"%s: bad PLANE block, segment %d\n",file,i);
+      fclose(fp);
+      free(buf);
+      return(-1);
+      }
+   str = srf_data_line(fp,&buf,&len,&off,&start);
+   }
+
+while(str != NULL)
+   {
+   if(strncmp(str,"POINTS",6) != 0 || sscanf(str+6,"%d",&np) != 1)
+      {
+      fprintf(stderr,"%s: expecting POINTS, found %s",file,str);
+      fclose(fp);
+      free(buf);
+      free(bcount);
+      return(-1);
+      }
+
+   bcount = (int *) check_realloc(bcount,(iblk+1)*sizeof(int));
+   bcount[iblk] = np;
+
+   if(sf->h.npts + np > nalloc)
+      {
+      nalloc = sf->h.npts + np;
+      sf->pt = (struct srf_ipt *) check_realloc(sf->pt,nalloc*sizeof(struct srf_ipt));
+      }
+
+   for(i=0;i<np;i++)
+      {
+      p = sf->pt + sf->h.npts;
+      str = srf_data_line(fp,&buf,&len,&off,&start);
+      p->off = start;
+      if(str == NULL || sscanf(str,"%f %f %f %f %f %f %f",&p->lon,&p->lat,&p->dep,
+                                   &stk,&dip,&p->area,&p->tinit) != 7)
+         break;
+
+      str = srf_data_line(fp,&buf,&len,&off,&start);
+      if(str == NULL || sscanf(str,"%f %f %d %f %d %f %d",&rake,&slip1,&nt1,
+                                   &slip2,&nt2,&slip3,&nt3) != 7)
+         break;
+      p->slip = sqrt(slip1*slip1 + slip2*slip2 + slip3*slip3);
+
+      if(p->tinit < tmin)
+         {
+         tmin = p->tinit;
+         sf->h.ihypo = sf->h.npts;
+         }
+
+      /* the slip functions */
+      nskip = nt1 + nt2 + nt3;
+      while(nskip > 0 && (str = srf_line(fp,&buf,&len,&off,&start)) != NULL)
+         nskip = nskip - srf_count(str);
+      sf->h.npts++;
+      }
+
+   if(i < np)
+      {
+      fprintf(stderr,"%s: bad point %d of POINTS block %d\n",file,i,iblk);
+      fclose(fp);
+      free(buf);
+      free(bcount);
+      return(-1);
+      }
+
+   iblk++;
+   str = srf_data_line(fp,&buf,&len,&off,&start);
+   }
+
+fclose(fp);
+free(buf);
+
+/* one POINTS block per plane, or one block for all of them */
+nrest = sf->h.npts;
+for(k=0;k<sf->h.nseg;k++)
+   {
+   if(iblk == sf->h.nseg)
+      sf->pl[k].npts = bcount[k];
+   else
+      {
+      np = sf->pl[k].nstk*sf->pl[k].ndip;
+      if(np > nrest || k == sf->h.nseg - 1)
+         np = nrest;
+      sf->pl[k].npts = np;
+      nrest = nrest - np;
+      }
+   }
+free(bcount);
+
+return(0);
+}
+
+static void srf_first(struct gmsv_srf *sf)
+{
+int i;
+
+sf->first = (int *) check_malloc((sf->h.nseg+1)*sizeof(int));
+sf->first[0] = 0;
+for(i=0;i<sf->h.nseg;i++)
+   sf->first[i+1] = sf->first[i] + sf->pl[i].npts;
+}
+
+static int srf_read_index(struct gmsv_srf *sf,const char *idxfile,struct stat *sb)
+{
+FILE *fp;
+int ok;
+
+if((fp = fopen(idxfile,"r")) == NULL)
+   return(-1);
+
+ok = (fread(&sf->h,sizeof(struct srf_ihead),1,fp) == 1 &&
+      memcmp(sf->h.magic,SRF_IDX_MAGIC,8) == 0 &&
+      sf->h.size == (long long) sb->st_size &&
+      sf->h.mtime == (long long) sb->st_mtime);
+
+if(ok)
+   {
+   sf->pl = (struct gmsv_srf_plane *) check_malloc((sf->h.nseg+1)*sizeof(struct gmsv_srf_plane));
+   sf->pt = (struct srf_ipt *) check_malloc((sf->h.npts+1)*sizeof(struct srf_ipt));
+   ok = (fread(sf->pl,sizeof(struct gmsv_srf_plane),sf->h.nseg,fp) == (size_t) sf->h.nseg &&
+         fread(sf->pt,sizeof(struct srf_ipt),sf->h.npts,fp) == (size_t) sf->h.npts);
+   if(!ok)
+      {
+      free(sf->pl);
+      free(sf->pt);
+      sf->pl = NULL;
+      sf->pt = NULL;
+      }
+   }
+fclose(fp);
+
+return(ok ? 0 : -1);
+}
+
+/* a failed write leaves no index, the next open parses the SRF again */
+static void srf_write_index(struct gmsv_srf *sf,const char *idxfile)
+{
+FILE *fp;
+char tmpfile[4096];
+int ok;
+
+snprintf(tmpfile,sizeof(tmpfile),"%s.%d",idxfile,(int) getpid());
+if((fp = fopen(tmpfile,"w")) == NULL)
+   return;
+
+ok = (fwrite(&sf->h,sizeof(struct srf_ihead),1,fp) == 1 &&
+      fwrite(sf->pl,sizeof(struct gmsv_srf_plane),sf->h.nseg,fp) == (size_t) sf->h.nseg &&
+      fwrite(sf->pt,sizeof(struct srf_ipt),sf->h.npts,fp) == (size_t) sf->h.npts);
+ok = (fclose(fp) == 0) && ok;
+
+if(!ok || rename(tmpfile,idxfile) != 0)
+   unlink(tmpfile);
+}
+
+gmsv_srf *gmsv_srf_open(const char *file,const char *idxfile)
+{
+struct gmsv_srf *sf;
+struct stat sb;
+
+if(stat(file,&sb) != 0)
+   {
+   fprintf(stderr,"CAN'T FOPEN FILE = %s, MODE = r\n",file);
+   return(NULL);
+   }
+
+sf = (struct gmsv_srf *) check_malloc(sizeof(struct gmsv_srf));
+sf->pl = NULL;
+sf->pt = NULL;
+if(idxfile == NULL || idxfile[0] == '\0' || srf_read_index(sf,idxfile,&sb) != 0)
+   {
+   if(srf_parse(sf,file) != 0)
+      {
+      free(sf->pl);
+      free(sf->pt);
+      free(sf);
+      return(NULL);
+      }
+
+   memcpy(sf->h.magic,SRF_IDX_MAGIC,8);
+   sf->h.size = (long long) sb.st_size;
+   sf->h.mtime = (long long) sb.st_mtime;
+   if(idxfile != NULL && idxfile[0] != '\0')
+      srf_write_index(sf,idxfile);
+   }
+
+srf_first(sf);
+return(sf);
+}
+
+void gmsv_srf_close(gmsv_srf *sf)
+{
+free(sf->pl);
+free(sf->pt);
+free(sf->first);
+free(sf);
+}
+
+float gmsv_srf_version(const gmsv_srf *sf)
+{
+return(sf->h.version);
+}
+
+int gmsv_srf_nseg(const gmsv_srf *sf)
+{
+return(sf->h.nseg);
+}
+
+int gmsv_srf_npoints(const gmsv_srf *sf,int seg)
+{
+if(seg < 0)
+   return(sf->h.npts);
+if(seg >= sf->h.nseg)
+   return(0);
+
+return(sf->pl[seg].npts);
+}
+
+int gmsv_srf_plane(const gmsv_srf *sf,int seg,struct gmsv_srf_plane *pl)
+{
+if(seg < 0 || seg >= sf->h.nseg)
+   return(-1);
+
+*pl = sf->pl[seg];
+return(0);
+}
+
+int gmsv_srf_hypocenter(const gmsv_srf *sf,float *hypo)
+{
+if(sf->h.ihypo < 0)
+   return(-1);
+
+hypo[0] = sf->pt[sf->h.ihypo].lon;
+hypo[1] = sf->pt[sf->h.ihypo].lat;
+hypo[2] = sf->pt[sf->h.ihypo].dep;
+return(0);
+}
+
+int gmsv_srf_points(const gmsv_srf *sf,int seg,int first,int n,float *lonlatdep,long long *off)
+{
+int i, i0, np;
+
+i0 = 0;
+np = sf->h.npts;
+if(seg >= 0)
+   {
+   if(seg >= sf->h.nseg)
+      return(0);
+   i0 = sf->first[seg];
+   np = sf->pl[seg].npts;
+   }
+
+if(first < 0)
+   first = 0;
+if(n > np - first)
+   n = np - first;
+
+for(i=0;i<n;i++)
+   {
+   if(lonlatdep != NULL)
+      {
+      lonlatdep[3*i] = sf->pt[i0+first+i].lon;
+      lonlatdep[3*i+1] = sf->pt[i0+first+i].lat;
+      lonlatdep[3*i+2] = sf->pt[i0+first+i].dep;
+      }
+   if(off != NULL)
+      off[i] = sf->pt[i0+first+i].off;
+   }
+
+return(n > 0 ? n : 0);
+}
+
+/*
+   Moment (dyne-cm) = sum of mu*area*slip, mu from the layer of velfile
+   (the GP 1D model: nlay, then thickness vp vs den per layer, km, km/s,
+   g/cm^3) holding the point
+*/
+double gmsv_srf_moment(const gmsv_srf *sf,const char *velfile)
+{
+FILE *fp;
+float *th, *vs, vp, den;
+double moment, *mu, ztop;
+int i, k, nlay;
+char str[1024];
+
+if((fp = fopen(velfile,"r")) == NULL)
+   {
+   fprintf(stderr,"CAN'T FOPEN FILE = %s, MODE = r\n",velfile);
+   return(-1.0);
+   }
+
+nlay = 0;
+if(fgets(str,1024,fp) != NULL)
+   sscanf(str,"%d",&nlay);
+if(nlay <= 0)
+   {
+   fprintf(stderr,"%s: bad velocity model\n",velfile);
+   fclose(fp);
+   return(-1.0);
+   }
+
+th = (float *) check_malloc(2*nlay*sizeof(float));
+vs = th + nlay;
+mu = (double *) check_malloc(nlay*sizeof(double));
+for(i=0;i<nlay;i++)
+   {
+   if(fgets(str,1024,fp) == NULL || sscanf(str,"%f %f %f %f",&th[i],&vp,&vs[i],&den) != 4)
+      {
+      fprintf(stderr,"%s: bad layer %d\n",velfile,i+1);
+      fclose(fp);
+      free(th);
+      free(mu);
+      return(-1.0);
+      }
+   mu[i] = 1.0e+10*(double)vs[i]*(double)vs[i]*(double)den;
+   }
+fclose(fp);
+
+moment = 0.0;
+for(i=0;i<sf->h.npts;i++)
+   {
+   ztop = 0.0;
+   for(k=0;k<nlay-1;k++)
+      {
+      ztop = ztop + th[k];
+      if(sf->pt[i].dep < ztop)
+         break;
+      }
+   moment = moment + mu[k]*(double)sf->pt[i].area*(double)sf->pt[i].slip;
+   }
+
+free(th);
+free(mu);
+return(moment);
+}
@@ -3,6 +3,8 @@
 #define COMPCHAR 4
 #define TITLCHAR 64
 
+#define LSQ_MAXTERMS 16   /* terms of the lsqfit.c polynomials */
+
 struct complex
   {
   float re;
@@ -24,6 +26,248 @@ struct statdata
    float baz;
    };
 
+struct wccmap      /* binary WCC trace returned by map_wccseis */
+   {
+   struct statdata *shead;  /* header, in place */
+   float *s;                /* shead->nt samples, in place */
+   void *base;              /* start of the mapping or of the malloc'd copy */
+   size_t len;              /* length of the mapping, 0 if malloc'd */
+   };
+
+/*
+   WCC pack: many traces in one file.  After the 8 byte magic
+   WCCPACK_MAGIC each trace is stored as in a binary WCC file (statdata
+   then nt floats); then comes the index, one wccpack_index per trace,
+   and last a wccpack_trailer.  Traces added later under the same
+   station/component replace the earlier ones.
+*/
+#define WCCPACK_MAGIC "WCCPACK1"
+
+struct wccpack_index
+   {
+   char stat[STATCHAR];
+   char comp[COMPCHAR];
+   int nt;
+   int pad;
+   long long offset;        /* file offset of the trace's statdata */
+   };
+
+struct wccpack_trailer
+   {
+   long long index_offset;  /* file offset of the index */
+   int ntrace;
+   int pad;
+   char magic[8];
+   };
+
+struct wccpack      /* open pack, see wccpack_open() */
+   {
+   int fd;
+   int wflag;
+   int ntrace;
+   int nalloc;
+   long long index_offset;
+   struct wccpack_index *index;
+   };
+
+/*
+   Compressed binary WCC file (wcczip.c), written by write_wccseis()
+   with bflag WCC_ZIPPED and read by every binary reader: the
+   wccz_head, then nchunk+1 long long file offsets of the chunks (the
+   last one the end of the file) and the chunks, each chunk samples but
+   the last.
+*/
+#define WCCZ_MAGIC "WCCZIP01"
+#define WCCZ_CHUNK 4096
+#define WCC_ZIPPED 2
+
+struct wccz_head
+   {
+   char magic[8];
+   struct statdata shead;
+   int chunk;
+   int nchunk;
+   };
+
+#define BBP_LINE 1024   /* longest line of a BBP file */
+
+struct bbp_format   /* line format of a BBP file, see bbp_format_init() */
+   {
+   char frmt[256];            /* tformat dformat dformat dformat */
+   char tpre[16], dpre[16];   /* fast path: text before the %e */
+   int tw, tp, dw, dp;        /* and its width and precision */
+   int fast;
+   };
+
+struct traceio;     /* read-ahead/write-behind of a trace list, see traceio.c */
+
+/* parsed parameters of the processing stages, see the *_config() functions */
+
+struct tfilter_par      /* wcc_tfilter */
+   {
+   int order;
+   float fhi;
+   float flo;
+   int phase;
+   int sos;             /* 1 = real second-order sections, see wcc_tfilter_sos() */
+   };
+
+#define TFILTER_MAXORDER 32
+
+struct tfilter_sect     /* bilinear factors of one first-order section */
+   {
+   int lp;              /* 1 low-pass, 0 high-pass */
+   float are, aim;
+   float bre, bim;
+   float cre, cim;      /* low-pass only */
+   };
+
+struct tfilter_coef     /* wcc_tfilter cascade for one dt, see wcc_tfilter_coef() */
+   {
+   int order;
+   float fhi;
+   float flo;
+   float dt;
+   int phase;
+   int nsect;
+   struct tfilter_sect sect[2*TFILTER_MAXORDER];
+   };
+
+#define TFILTER_MAXLANE 16
+
+struct tfilter_sos      /* the same cascade as real biquads, see wcc_tfilter_sos() */
+   {
+   float dt;
+   int phase;
+   int nsos;
+   double b0[TFILTER_MAXORDER+2], b1[TFILTER_MAXORDER+2], b2[TFILTER_MAXORDER+2];
+   double a1[TFILTER_MAXORDER+2], a2[TFILTER_MAXORDER+2];
+   };
+
+struct integ_diff_par   /* integ_diff */
+   {
+   int integ;
+   int diff;
+   int rtrend;
+   int rbase;
+   int dmean;
+   int dtrend;
+   int rmean;
+   int taper;
+   int boorebase;
+   float tstart;
+   float tlen;
+   float scale;
+   float t1;
+   float t2;
+   float tf1;
+   float tf2;
+   int v0correct;
+   float ts0;
+   float te0;
+   float ts1;
+   float te1;
+   float tfront;
+   float tend;
+   float finaldisp;
+   float init_val;
+   int fdomain;         /* 1 = integ/diff by (i*w)^(diff-integ) in one transform */
+   float hp_fhi;        /* fdomain: > 0 high-pass in the same transform */
+   int hp_order;        /* its Butterworth order, as wcc_tfilter phase=0 */
+   float hp_fbot;       /* 0 < hp_fbot < hp_fhi: cosine ramp up from hp_fbot instead */
+   };
+
+struct resamp_arbdt_par /* wcc_resamp_arbdt */
+   {
+   float single_dt;     /* newdt as float and as double */
+   double double_dt;
+   int order;
+   float nyq_perc;
+   float tap_perc;
+   int ntout;
+   int use_fftw;
+   int use_double;
+   double *work;        /* use_double work array, kept across traces, */
+   int nwork;           /* so one par per thread */
+   int polyphase;       /* 1 = time-domain FIR, see rsmp_poly_init() */
+   int taps;            /* zero crossings of the sinc on each side */
+   float kbeta;         /* Kaiser window beta */
+   float lp_flo;        /* > 0: low-pass applied to the resampled spectrum */
+   int lp_order;        /* its Butterworth order, as wcc_tfilter phase=0 */
+   float lp_ftop;       /* > lp_flo: cosine roll-off to 0 at lp_ftop instead */
+   };
+
+#define         RSMP_MAXPHASE   4096
+
+struct rsmp_poly        /* streaming polyphase resampler state */
+   {
+   double rate;         /* input samples per output sample, newdt/dt */
+   int exact;           /* 1 = rate is M/L, one phase per L; 0 = nph phases, interpolated */
+   int L, M;
+   int nph;
+   int half;            /* taps on each side of the output time */
+   int ntap;
+   float *h;            /* (nph+1)*ntap coefficients, phase by phase */
+   float *xb;           /* input samples x0 ... x0+nxb-1 still needed */
+   long long x0;
+   int nxb, cap;
+   long long j;         /* next output sample */
+   float *zero;         /* ntap zeros for rsmp_poly_flush() */
+   };
+
+struct siteamp_model    /* one entry of the site amplification model registry */
+   {
+   char *name;
+   int nmatch;          /* leading characters of model= that select it */
+   void (*ampf)(float *,float *,int,float *,float *,float *,float *,float *,float *,float *,float *,float *,float *,float *);
+   };
+
+struct siteamp14_par    /* wcc_siteamp, wcc_siteamp09, wcc_siteamp14 */
+   {
+   float vref;
+   float vsite;
+   float vpga;
+   float pga;
+   float tap_per;
+   float fmin;
+   float fmidbot;
+   float fmid;
+   float fhigh;
+   float fhightop;
+   float fmax;
+   float flowcap;
+   char model[128];
+   const struct siteamp_model *mod;  /* the model named by model */
+   };
+
+#define SITEAMP14_MAXCURVE 256
+
+struct siteamp14_curve  /* one ampf curve and what it was computed for */
+   {
+   const struct siteamp_model *mod;
+   float vref, vsite, vpga, pga;
+   int nt_p2;
+   float dt;
+   float *ampf;
+   };
+
+struct siteamp14_cache  /* ampf curves kept by wcc_siteamp14_apply_cached() */
+   {
+   float pgabin;        /* pga rounded to steps of pgabin in ln(pga), 0 = exact */
+   int ncurve, next;
+   int nhit, nmiss;
+   struct siteamp14_curve curve[SITEAMP14_MAXCURVE];
+   };
+
+struct gfterm           /* one term of wcc_gfsum(): scale*s shifted to start at t */
+   {
+   float *s;
+   int nt;
+   float dt;
+   double t;            /* start time, seconds (header time plus shift) */
+   float scale;
+   };
+
 struct mtheader    /* header for moment tensor output information */
    {
    char title[128];
@@ -80,6 +324,22 @@ struct tsheader    /* structure for time slice header information */
    float modellon;  /* longitude of model origin                            */
    };
 
+/*
+   Pyramid sidecar of a time slice file (tspyr.c): decimated slices and
+   peak planes, written by merge_ts pyramid=1 as <outfile>.pyr
+*/
+#define TSPYR_MAGIC "TSPYR001"
+
+struct tspyr_head
+   {
+   char magic[8];
+   struct tsheader tshead;   /* header of the time slice file */
+   int nlev;                 /* levels 1..nlev, every 2**l-th point in x and y */
+   int tskip;                /* the levels keep every tskip-th slice */
+   int nkeep;                /* (nt + tskip - 1)/tskip slices per level */
+   int tile;                 /* tile width (points) of the tile peaks */
+   };
+
 struct tsheader_proc  /* structure for individual processor time slice header */
    {
    int ix0;          /* starting x grid location for output */
@@ -4,11 +4,9 @@
 
 main(int ac, char **av)
 {
-struct statdata gfh;
-float *gf;
-int k, isub, j, nc, nt;
-int nbyte;
-float dt, rng, tst;
+struct statdata gfh, h[3];
+float *gf[3];
+int k, isub, j, nc;
 
 int fdr;
 char infile[128];
@@ -37,66 +35,28 @@ sprintf(gfh.stat,"%d",isub);
 
 fdr = opfile_ro(infile);
 
-for(k=0;k<isub;k++)
-   {
-   reed(fdr,&nbyte,sizeof(int));
-   reed(fdr,&nc,sizeof(int));
-   reed(fdr,&nbyte,sizeof(int));
-
-   for(j=0;j<nc;j++)
-      {
-      reed(fdr,&nbyte,sizeof(int));
-      reed(fdr,&rng,sizeof(float));
-      reed(fdr,&tst,sizeof(float));
-      reed(fdr,&nbyte,sizeof(int));
+for(j=0;j<3;j++)
+   gf[j] = NULL;
 
-      reed(fdr,&nbyte,sizeof(int));
-      reed(fdr,&nt,sizeof(int));
-      reed(fdr,&dt,sizeof(float));
-      reed(fdr,&nbyte,sizeof(int));
-
-      gf = (float *) check_realloc(gf,nt*sizeof(float));
-
-      reed(fdr,&nbyte,sizeof(int));
-      reed(fdr,gf,nt*sizeof(float));
-      reed(fdr,&nbyte,sizeof(int));
-      }
-   }
+for(k=0;k<isub;k++)
+   read_subgf(fdr,h,gf);
 
-reed(fdr,&nbyte,sizeof(int));
-reed(fdr,&nc,sizeof(int));
-reed(fdr,&nbyte,sizeof(int));
+nc = read_subgf(fdr,h,gf);
 
 for(j=0;j<nc;j++)
    {
-   reed(fdr,&nbyte,sizeof(int));
-   reed(fdr,&rng,sizeof(float));
-   reed(fdr,&tst,sizeof(float));
-   reed(fdr,&nbyte,sizeof(int));
-
-   reed(fdr,&nbyte,sizeof(int));
-   reed(fdr,&nt,sizeof(int));
-   reed(fdr,&dt,sizeof(float));
-   reed(fdr,&nbyte,sizeof(int));
-
-   gf = (float *) check_realloc(gf,nt*sizeof(float));
-
-   reed(fdr,&nbyte,sizeof(int));
-   reed(fdr,gf,nt*sizeof(float));
-   reed(fdr,&nbyte,sizeof(int));
-
-   gfh.nt = nt;
-   gfh.dt = dt;
-   gfh.edist = rng;
+   gfh.nt = h[j].nt;
+   gfh.dt = h[j].dt;
+   gfh.edist = h[j].edist;
 
-   gfh.hr = (int)(tst/3600.0);
-   gfh.min = (int)((tst - 3600.0*gfh.hr)/60.0);
-   gfh.sec = (float)(tst - 60.0*gfh.min - 3600.0*gfh.hr);
+   gfh.hr = h[j].hr;
+   gfh.min = h[j].min;
+   gfh.sec = h[j].sec;
 
    strcpy(gfh.comp,comp[j]);
    sprintf(outfile,"%s.%s",gfh.stat,gfh.comp);
 
-   write_wccseis(outfile,&gfh,gf,outbin);
+   write_wccseis(outfile,&gfh,gf[j],outbin);
    }
 close(fdr);
 }
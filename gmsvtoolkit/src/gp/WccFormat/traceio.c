@@ -0,0 +1,242 @@
+/*
+   Read-ahead and write-behind of the traces of a batch driver.
+
+   A reader thread reads the traces infiles[first], infiles[first+step],
+   ... up to depth ahead of the caller, and a writer thread writes the
+   traces the caller has finished with, so the processing of one trace
+   overlaps the reading of the next ones and the writing of the last
+   ones.  The threads and the caller exchange traces through bounded
+   single-producer single-consumer rings (read-ahead, write-behind, and
+   the buffers the writer hands back to the reader for reuse); a ring
+   is two counters, each stored by one side only, so no locks are
+   taken.  A side finding its ring full or empty spins briefly and then
+   sleeps in growing steps.
+
+      tio = traceio_open(infiles,outpath,outfiles,first,step,n,depth,inbin,outbin);
+      while((s = traceio_next(tio,&shead,&i)) != NULL)
+         {
+         ... process s, which may be realloc'ed ...
+         traceio_put(tio,i,&shead,s);
+         }
+      traceio_close(tio);
+
+   The traces are read with read_wccseis() and written with
+   write_wccseis() to outpath/outfiles[i], in the order they were put.
+   A read or write error exits the program, as it does without the
+   threads.
+*/
+
+#include "include.h"
+#include "structure.h"
+#include "function.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+struct traceio_slot
+   {
+   struct statdata shead;
+   float *s;
+   int index;           /* position in infiles, -1 ends the queue */
+   };
+
+struct traceio_ring     /* written by one thread, read by one other */
+   {
+   int size;
+   struct traceio_slot *slot;
+   unsigned long head;  /* slots pushed, stored by the producer only */
+   unsigned long tail;  /* slots popped, stored by the consumer only */
+   };
+
+struct traceio
+   {
+   char **infiles, **outfiles, *outpath;
+   int first, step, n;
+   int inbin, outbin;
+   struct traceio_ring rd;      /* reader -> caller */
+   struct traceio_ring wr;      /* caller -> writer */
+   struct traceio_ring fr;      /* writer -> reader, empty buffers */
+   pthread_t reader, writer;
+   };
+
+static void ring_init(struct traceio_ring *r,int size)
+{
+r->size = size;
+r->slot = (struct traceio_slot *) check_malloc(size*sizeof(struct traceio_slot));
+r->head = 0;
+r->tail = 0;
+}
+
+/* spins a little, then sleeps from 10us up to 1ms */
+static void ring_wait(int *nwait)
+{
+struct timespec ts;
+
+if(*nwait < 64)
+   sched_yield();
+else
+   {
+   ts.tv_sec = 0;
+   ts.tv_nsec = 10000L << ((*nwait - 64) < 7 ? (*nwait - 64) : 7);
+   nanosleep(&ts,NULL);
+   }
+(*nwait)++;
+}
+
+/* 0 if the ring is full and wait is 0 */
+static int ring_push(struct traceio_ring *r,struct traceio_slot *sl,int wait)
+{
+unsigned long head;
+int nwait = 0;
+
+head = r->head;
+while(head - __atomic_load_n(&r->tail,__ATOMIC_ACQUIRE) == r->size)
+   {
+   if(!wait)
+      return(0);
+   ring_wait(&nwait);
+   }
+
+r->slot[head % r->size] = *sl;
+__atomic_store_n(&r->head,head+1,__ATOMIC_RELEASE);
+return(1);
+}
+
+/* 0 if the ring is empty and wait is 0 */
+static int ring_pop(struct traceio_ring *r,struct traceio_slot *sl,int wait)
+{
+unsigned long tail;
+int nwait = 0;
+
+tail = r->tail;
+while(__atomic_load_n(&r->head,__ATOMIC_ACQUIRE) == tail)
+   {
+   if(!wait)
+      return(0);
+   ring_wait(&nwait);
+   }
+
+*sl = r->slot[tail % r->size];
+__atomic_store_n(&r->tail,tail+1,__ATOMIC_RELEASE);
+return(1);
+}
+
+static void *traceio_reader(void *arg)
+{
+struct traceio *tio = (struct traceio *) arg;
+struct traceio_slot sl, fsl;
+int i;
+
+for(i=tio->first;i<tio->n;i=i+tio->step)
+   {
+   sl.s = NULL;
+   if(ring_pop(&tio->fr,&fsl,0))
+      sl.s = fsl.s;
+
+   sl.s = read_wccseis(tio->infiles[i],&sl.shead,sl.s,tio->inbin);
+   sl.index = i;
+   ring_push(&tio->rd,&sl,1);
+   }
+
+sl.s = NULL;
+sl.index = -1;
+ring_push(&tio->rd,&sl,1);
+return(NULL);
+}
+
+static void *traceio_writer(void *arg)
+{
+struct traceio *tio = (struct traceio *) arg;
+struct traceio_slot sl;
+char str[2048];
+
+while(ring_pop(&tio->wr,&sl,1) && sl.index >= 0)
+   {
+   set_fullpath(str,tio->outpath,tio->outfiles[sl.index]);
+   write_wccseis(str,&sl.shead,sl.s,tio->outbin);
+
+   if(!ring_push(&tio->fr,&sl,0))
+      free(sl.s);
+   }
+return(NULL);
+}
+
+struct traceio *traceio_open(char **infiles,char *outpath,char **outfiles,int first,int step,int n,int depth,int inbin,int outbin)
+{
+struct traceio *tio;
+
+if(depth < 1)
+   depth = 1;
+if(step < 1)
+   step = 1;
+
+tio = (struct traceio *) check_malloc(sizeof(struct traceio));
+tio->infiles = infiles;
+tio->outfiles = outfiles;
+tio->outpath = outpath;
+tio->first = first;
+tio->step = step;
+tio->n = n;
+tio->inbin = inbin;
+tio->outbin = outbin;
+
+/* room for the end marker after depth traces */
+ring_init(&tio->rd,depth+1);
+ring_init(&tio->wr,depth+1);
+ring_init(&tio->fr,2*depth+2);
+
+if(pthread_create(&tio->reader,NULL,traceio_reader,tio) != 0 ||
+   pthread_create(&tio->writer,NULL,traceio_writer,tio) != 0)
+   {
+   fprintf(stderr,"*****  cannot start the trace I/O threads\n");
+   exit(-1);
+   }
+
+return(tio);
+}
+
+/* the next trace, in infiles order; NULL after the last one */
+float *traceio_next(struct traceio *tio,struct statdata *shead,int *index)
+{
+struct traceio_slot sl;
+
+ring_pop(&tio->rd,&sl,1);
+*index = sl.index;
+if(sl.index < 0)
+   return(NULL);
+
+*shead = sl.shead;
+return(sl.s);
+}
+
+/* trace index is written as outfiles[index]; s now belongs to tio */
+void traceio_put(struct traceio *tio,int index,struct statdata *shead,float *s)
+{
+struct traceio_slot sl;
+
+sl.shead = *shead;
+sl.s = s;
+sl.index = index;
+ring_push(&tio->wr,&sl,1);
+}
+
+/* waits for the last writes; every trace must have been taken by traceio_next() */
+void traceio_close(struct traceio *tio)
+{
+struct traceio_slot sl;
+
+sl.s = NULL;
+sl.index = -1;
+ring_push(&tio->wr,&sl,1);
+
+pthread_join(tio->reader,NULL);
+pthread_join(tio->writer,NULL);
+
+while(ring_pop(&tio->fr,&sl,0))
+   free(sl.s);
+
+free(tio->rd.slot);
+free(tio->wr.slot);
+free(tio->fr.slot);
+free(tio);
+}
@@ -1,6 +1,7 @@
 #include        "include.h"
 #include        "structure.h"
 #include        "function.h"
+#include        "getpar.h"
 
 #define MAXL 512
 #define         MAX_STAT 10000
@@ -9,6 +10,10 @@
 #define         RPERD           0.017453292
 #define         FONE            (float)(1.0)
 #define         FTWO            (float)(2.0)
+#define         TS_TILE         4096           /* points per tile */
+#define         TS_BLKBYTES     (256*1048576)  /* time slices per block */
+
+void peak_block(float *,int *,float *,int,int,int,int,int,int);
 
 struct xyz
    {
@@ -17,7 +22,13 @@ struct xyz
    float z;
    };
 
-main(int ac,char **av)
+void getf(char *,float *);
+void getd(char *,int *);
+void set_g2(float *,float *);
+void latlon2km(float *,float *,float *,float *,float *);
+void write_out(char *,int,struct xyz *,int,int);
+
+int main(int ac,char **av)
 {
 FILE *fpr, *fopfile();
 struct xyz *c0, *c1, *c2;
@@ -29,6 +40,11 @@ int dxts, dyts, dzts;
 int fdr, i, i1, i2, ip, ic;
 int ix, iy, iz, nx, ny, nz;
 int ntts, ts, nxts, nyts, nzts, n1, n2;
+int nblk, nb, ib, np;
+off_t data_off, map_off;
+size_t map_len, blk_len;
+struct stat sbuf;
+char *map;
 char gridfile[512], str[512], infile[512], outfile[512];
 
 float scale = 1.0;
@@ -39,6 +55,13 @@ int vectorpeak = 0;
 int read_header = 0;
 int swap_bytes = 0;
 
+int pyramid = 0;
+int pyrlev = 0;
+int fdp = -1;
+int s;
+struct tspyr_head pyrhead;
+char pyrfile[520];
+
 float c0mx, c0my, c1mx, c1my, c2mx, c2my;
 int c0mt, c1mt, c2mt;
 float c0max = 0.0;
@@ -105,6 +128,9 @@ getpar("scale","f",&scale);
 getpar("outbin","d",&outbin);
 getpar("swap_bytes","d",&swap_bytes);
 
+getpar("pyramid","d",&pyramid);
+getpar("pyrlev","d",&pyrlev);
+
 getpar("lonlat","d",&lonlat);
 if(lonlat && read_header == 0)
    {
@@ -305,6 +331,23 @@ if(yzts)
    p2 = ys;
    }
 
+/*
+   With pyramid=1 the peaks over all the slices (getpeak or vectorpeak
+   with ntts the number of slices), or with pyrlev=l > 0 slice ts every
+   2**l-th point in x and y, are read from the sidecar infile.pyr that
+   merge_ts pyramid=1 writes (see tspyr.c), when it matches the file.
+*/
+if(pyramid)
+   {
+   if(read_header == 0 || swap_bytes || ncomp != 3 || n1 != tshead.nx || n2 != tshead.ny)
+      fprintf(stderr,"pyramid needs read_header=1, swap_bytes=0, ncomp=3 and the whole plane, not used\n");
+   else
+      {
+      sprintf(pyrfile,"%s.pyr",infile);
+      fdp = tspyr_open(pyrfile,&pyrhead,&tshead);
+      }
+   }
+
 fprintf(stderr,"n1= %d n2= %d\n",n1,n2);
 
 val = (float *) check_malloc (3*n1*n2*sizeof(float));
@@ -313,72 +356,107 @@ c0 = (struct xyz *) check_malloc (n1*n2*sizeof(struct xyz));
 c1 = (struct xyz *) check_malloc (n1*n2*sizeof(struct xyz));
 c2 = (struct xyz *) check_malloc (n1*n2*sizeof(struct xyz));
 
-if(getpeak || vectorpeak)
+if((getpeak || vectorpeak) && fdp >= 0 && ntts == tshead.nt)
    {
-   val2 = (float *) check_malloc (3*n1*n2*sizeof(float));
-
-   for(i=0;i<3*n1*n2;i++)
+   fprintf(stderr,"peaks from %s\n",pyrfile);
+   tspyr_read_peak(fdp,&pyrhead,val,itlist,vectorpeak);
+   }
+else if(getpeak || vectorpeak)
+   {
+   /*
+      The time slices are read through a mapping of the file (or with
+      reed() into a buffer if it can not be mapped), nblk slices at a
+      time, and the peaks of each block are found by peak_block().
+      Pages of a block are dropped once it is done, so files much
+      larger than memory can be processed.
+   */
+
+   np = n1*n2;
+   for(i=0;i<3*np;i++)
+      {
       val[i] = -1.0;
+      itlist[i] = 0;
+      }
+
+   blk_len = (size_t)(ncomp)*np*sizeof(float);
+   nblk = TS_BLKBYTES/blk_len;
+   if(nblk < 1)
+      nblk = 1;
+   if(nblk > ntts)
+      nblk = ntts;
+
+   data_off = lseek(fdr,0,SEEK_CUR);
+   map_off = data_off - data_off%sysconf(_SC_PAGESIZE);
+   map_len = (data_off - map_off) + (size_t)(ntts)*blk_len;
 
-   for(i=0;i<ntts;i++)
+   map = MAP_FAILED;
+   if(fstat(fdr,&sbuf) == 0 && S_ISREG(sbuf.st_mode) && map_off + map_len <= sbuf.st_size)
       {
-      fprintf(stderr,"%5d of %5d\n",i+1,ntts);
+      map = mmap(NULL,map_len,PROT_READ,MAP_SHARED,fdr,map_off);
+      if(map != MAP_FAILED)
+         madvise(map,map_len,MADV_SEQUENTIAL);
+      }
 
-      reed(fdr,val2,ncomp*n1*n2*sizeof(float));
-      if(swap_bytes)
-         swap_in_place(ncomp*n1*n2,(char *)(val2));
+   if(map == MAP_FAILED)
+      val2 = (float *) check_malloc (nblk*blk_len);
 
-      for(i2=0;i2<n2;i2++)
-         {
-         for(i1=0;i1<n1;i1++)
-            {
-            ip = i1 + i2*n1;
+   for(i=0;i<ntts;i=i+nblk)
+      {
+      nb = nblk;
+      if(i + nb > ntts)
+         nb = ntts - i;
 
-	    if(vectorpeak)
-	       {
-	       vec = (val2[ip]*val2[ip] + val2[ip+n1*n2]*val2[ip+n1*n2] + val2[ip+2*n1*n2]*val2[ip+2*n1*n2]);
+      fprintf(stderr,"%5d of %5d\n",i+nb,ntts);
 
-	       if(vec > val[ip])
-                  {
-		  val[ip] = vec;
-		  itlist[ip] = i;
-		  }
-	       }
-	    else
-	       {
-               for(ic=0;ic<3;ic++)
-                  {
-	          if(val2[ip + ic*n1*n2] > val[ip + ic*n1*n2])
-		     {
-	             val[ip + ic*n1*n2] = val2[ip + ic*n1*n2];
-		     itlist[ip+ic*n1*n2] = i;
-		     }
-
-	          else if(-val2[ip + ic*n1*n2] > val[ip + ic*n1*n2])
-		     {
-	             val[ip + ic*n1*n2] = -val2[ip + ic*n1*n2];
-		     itlist[ip+ic*n1*n2] = i;
-		     }
-	          }
-	       }
-            }
+      if(map != MAP_FAILED)
+         val2 = (float *) (map + (data_off - map_off) + (size_t)(i)*blk_len);
+      else
+         {
+         for(ib=0;ib<nb;ib++)
+            reed(fdr,(char *)(val2) + ib*blk_len,blk_len);
          }
+
+      peak_block(val,itlist,val2,nb,i,np,ncomp,vectorpeak,swap_bytes);
+
+      if(map != MAP_FAILED)
+         madvise(map,(data_off - map_off) + (size_t)(i + nb)*blk_len,MADV_DONTNEED);
       }
 
-   free(val2);
+   if(map != MAP_FAILED)
+      munmap(map,map_len);
+   else
+      free(val2);
+   }
+else if(fdp >= 0 && pyrlev > 0 && tspyr_read_level(fdp,&pyrhead,pyrlev,ts,val) == 0)
+   {
+   fprintf(stderr,"level %d of %s\n",pyrlev,pyrfile);
+
+   s = 1 << pyrlev;
+   n1 = tspyr_levn(n1,pyrlev);
+   n2 = tspyr_levn(n2,pyrlev);
+   for(i=0;i<n1;i++)
+      p1[i] = p1[i*s];
+   for(i=0;i<n2;i++)
+      p2[i] = p2[i*s];
+
+   for(i=0;i<3*n1*n2;i++)
+      itlist[i] = ts;
    }
 else
    {
+   if(fdp >= 0 && pyrlev > 0)
+      fprintf(stderr,"level %d of slice %d not in %s, full plane used\n",pyrlev,ts,pyrfile);
+
    for(i=0;i<3*n1*n2;i++)
       itlist[i] = ts;
 
    lseek(fdr,ncomp*ts*n1*n2*sizeof(float),SEEK_CUR);
-   reed(fdr,val,ncomp*n1*n2*sizeof(float));
-   if(swap_bytes)
-      swap_in_place(ncomp*n1*n2,(char *)(val));
+   reed_swap(fdr,val,ncomp*n1*n2*sizeof(float),swap_bytes);
    }
 
 close(fdr);
+if(fdp >= 0)
+   close(fdp);
 
 for(i2=0;i2<n2;i2++)
    {
@@ -513,7 +591,7 @@ write_out(outfile,1,c1,n1*n2,outbin);
 write_out(outfile,2,c2,n1*n2,outbin);
 }
 
-getf(s,f)
+void getf(s,f)
 char *s;
 float *f;
 {
@@ -526,7 +604,7 @@ else
    *f = atof(s+1);
 }
 
-getd(s,d)
+void getd(s,d)
 char *s;
 int *d;
 {
@@ -547,7 +625,7 @@ r = atan((1.0 - (1.0/FLAT_CONST))*tan(x));
 return(r);
 }
 
-set_g2(g2,fc)
+void set_g2(g2,fc)
 float *g2, *fc;
 {
 float f;
@@ -556,7 +634,7 @@ f = (1.0)/(*fc);
 *g2 = ((2.0)*f - f*f)/(((1.0) - f)*((1.0) - f));
 }
 
-latlon2km(arg,latkm,lonkm,rc,g2)
+void latlon2km(arg,latkm,lonkm,rc,g2)
 float *arg, *latkm, *lonkm, *rc, *g2;
 {
 float cosA, sinA, g2s2, den;
@@ -570,7 +648,7 @@ den = sqrt((FONE)/((FONE) + g2s2));
 *latkm = (*rc)*(sqrt((FONE) + g2s2*((FTWO) + (*g2))))*den*den*den;
 }
 
-write_out(outf,code,cc,nn,ob)
+void write_out(outf,code,cc,nn,ob)
 char *outf;
 struct xyz *cc;
 int ob, nn, code;
@@ -596,20 +674,87 @@ else
    }
 }
 
-void swap_in_place(int n,char *cbuf)
+static inline float swap_float(float v,int swap_bytes)
 {
-char cv;
+union
+   {
+   float fval;
+   unsigned int ival;
+   } u;
+
+if(swap_bytes == 0)
+   return(v);
 
-while(n--)
+u.fval = v;
+u.ival = __builtin_bswap32(u.ival);
+return(u.fval);
+}
+
+/*
+   Running peaks over nb time slices stored one after the other in buf,
+   each of ncomp planes of np values; it0 is the time index of the
+   first slice.  For getpeak val[] holds the peak absolute value of each
+   of the 3 components, for vectorpeak val[0..np-1] holds the peak of
+   the squared vector amplitude, and itlist[] the time index of each
+   peak.  The points are split into tiles that are shared out over the
+   threads, and each tile walks through the slices in time order, so
+   ties go to the earliest time as when one slice is read at a time.
+   Components not in the file (ncomp < 3) are taken as zero.
+*/
+void peak_block(float *val,int *itlist,float *buf,int nb,int it0,int np,int ncomp,int vectorpeak,int swap_bytes)
+{
+float *pt, v, vec;
+int ip0, ip1, ip, it, ic;
+
+#pragma omp parallel for schedule(dynamic,1) private(pt,v,vec,ip1,ip,it,ic)
+for(ip0=0;ip0<np;ip0=ip0+TS_TILE)
    {
-   cv = cbuf[0];
-   cbuf[0] = cbuf[3];
-   cbuf[3] = cv;
+   ip1 = ip0 + TS_TILE;
+   if(ip1 > np)
+      ip1 = np;
 
-   cv = cbuf[1];
-   cbuf[1] = cbuf[2];
-   cbuf[2] = cv;
+   for(it=0;it<nb;it++)
+      {
+      pt = buf + (size_t)(it)*ncomp*np;
 
-   cbuf = cbuf + 4;
+      if(vectorpeak)
+         {
+         for(ip=ip0;ip<ip1;ip++)
+            {
+            vec = 0.0;
+            for(ic=0;ic<ncomp && ic<3;ic++)
+               {
+               v = swap_float(pt[ip + ic*np],swap_bytes);
+               vec = vec + v*v;
+               }
+
+            if(vec > val[ip])
+               {
+               val[ip] = vec;
+               itlist[ip] = it0 + it;
+               }
+            }
+         }
+      else
+         {
+         for(ic=0;ic<3;ic++)
+            {
+            for(ip=ip0;ip<ip1;ip++)
+               {
+               v = 0.0;
+               if(ic < ncomp)
+                  v = swap_float(pt[ip + ic*np],swap_bytes);
+               if(v < 0.0)
+                  v = -v;
+
+               if(v > val[ip + ic*np])
+                  {
+                  val[ip + ic*np] = v;
+                  itlist[ip + ic*np] = it0 + it;
+                  }
+               }
+            }
+         }
+      }
    }
 }
@@ -0,0 +1,359 @@
+/*
+ * tspyr.c - pyramid sidecar of a merged time slice file (structure.h),
+ * written by merge_ts pyramid=1 as <outfile>.pyr and read by ts2xyz.
+ *
+ * After the tspyr_head the file holds
+ *
+ *    peak planes   pk[3][ny][nx] the peak |v| of each component over
+ *                  all the slices and ipk[3][ny][nx] its slice, then
+ *                  vpk[ny][nx] the peak squared vector amplitude and
+ *                  ivpk[ny][nx] its slice (floats, then ints)
+ *    tile peaks    tpk[3][nty][ntx] the largest pk of each block of
+ *                  tile x tile points and itpk[3][nty][ntx] its slice
+ *    levels        for l = 1 .. nlev, every 2**l-th point in x and y
+ *                  of every tskip-th slice, laid out as the time slice
+ *                  file itself: nkeep slices of 3 planes of nyl rows
+ *                  of nxl values
+ *
+ * A peak map then costs one read of 8*nx*ny values instead of the
+ * whole file, and a coarse snapshot 3*nxl*nyl.  The peaks are the same
+ * numbers ts2xyz getpeak or vectorpeak finds over all the slices (ties
+ * to the earliest slice).
+ */
+
+#include "include.h"
+#include "structure.h"
+#include "function.h"
+
+static void tspyr_pread(int fd,void *buf,size_t len,off_t off)
+{
+ssize_t nr;
+
+while(len > 0)
+   {
+   nr = pread(fd,buf,len,off);
+   if(nr < 0 && errno == EINTR)
+      continue;
+   if(nr <= 0)
+      {
+      fprintf(stderr,"READ ERROR in time slice pyramid, %lld bytes left\n",(long long)(len));
+      exit(-1);
+      }
+
+   buf = (char *) buf + nr;
+   off = off + nr;
+   len = len - nr;
+   }
+}
+
+static void tspyr_pwrite(int fd,void *buf,size_t len,off_t off)
+{
+ssize_t nw;
+
+while(len > 0)
+   {
+   nw = pwrite(fd,buf,len,off);
+   if(nw < 0 && errno == EINTR)
+      continue;
+   if(nw <= 0)
+      {
+      fprintf(stderr,"WRITE ERROR in time slice pyramid, %lld bytes left\n",(long long)(len));
+      exit(-1);
+      }
+
+   buf = (char *) buf + nw;
+   off = off + nw;
+   len = len - nw;
+   }
+}
+
+/* points of level lev along a line of n points */
+int tspyr_levn(int n,int lev)
+{
+return((n - 1)/(1 << lev) + 1);
+}
+
+/*
+   File offset of a section: lev = 0 the peak planes, lev = -1 the tile
+   peaks, lev = 1 .. nlev that level.
+*/
+off_t tspyr_offset(struct tspyr_head *ph,int lev)
+{
+off_t off, np;
+int ntx, nty, l;
+
+np = (off_t)(ph->tshead.nx)*ph->tshead.ny;
+off = sizeof(struct tspyr_head);
+if(lev == 0)
+   return(off);
+
+off = off + 8*np*sizeof(float);
+if(lev < 0)
+   return(off);
+
+ntx = (ph->tshead.nx + ph->tile - 1)/ph->tile;
+nty = (ph->tshead.ny + ph->tile - 1)/ph->tile;
+off = off + 6*(off_t)(ntx)*nty*sizeof(float);
+
+for(l=1;l<lev;l++)
+   off = off + (off_t)(ph->nkeep)*3*tspyr_levn(ph->tshead.nx,l)*tspyr_levn(ph->tshead.ny,l)*sizeof(float);
+return(off);
+}
+
+/*
+   Pyramid pyrfile of the merged time slice file tsfile, nlev levels of
+   every tskip-th slice and tile peaks over tile x tile points.  The
+   slices are read once, in order; the points of each are shared out
+   over nthreads threads.  Returns the bytes written.
+*/
+off_t tspyr_build(char *tsfile,char *pyrfile,int nlev,int tskip,int tile,int nthreads)
+{
+struct tspyr_head ph;
+float *buf, *pk, *vpk, *lbuf, *tpk, v, vec;
+int *ipk, *ivpk, *itpk;
+int fdr, fdw, it, ik, ic, ip, l, s, nxl, nyl, ix, iy, jx, jy, ntx, nty, nx, ny;
+off_t np, off, blen;
+
+fdr = opfile_ro(tsfile);
+
+memset(&ph,0,sizeof(ph));
+memcpy(ph.magic,TSPYR_MAGIC,sizeof(ph.magic));
+reed(fdr,&ph.tshead,sizeof(struct tsheader));
+
+if(tskip < 1)
+   tskip = 1;
+if(tile < 1)
+   tile = 1;
+if(nlev < 0)
+   nlev = 0;
+if(nthreads < 1)
+   nthreads = 1;
+
+nx = ph.tshead.nx;
+ny = ph.tshead.ny;
+while(nlev > 0 && tspyr_levn(nx,nlev) == 1 && tspyr_levn(ny,nlev) == 1)
+   nlev--;
+
+ph.nlev = nlev;
+ph.tskip = tskip;
+ph.tile = tile;
+ph.nkeep = (ph.tshead.nt + tskip - 1)/tskip;
+
+np = (off_t)(nx)*ny;
+blen = 3*np*sizeof(float);
+
+buf = (float *) check_malloc(blen);
+pk = (float *) check_malloc(3*np*sizeof(float));
+ipk = (int *) check_malloc(3*np*sizeof(int));
+vpk = (float *) check_malloc(np*sizeof(float));
+ivpk = (int *) check_malloc(np*sizeof(int));
+lbuf = (float *) check_malloc(3*tspyr_levn(nx,1)*tspyr_levn(ny,1)*sizeof(float) + sizeof(float));
+
+for(ip=0;ip<3*np;ip++)
+   {
+   pk[ip] = -1.0;
+   ipk[ip] = 0;
+   }
+for(ip=0;ip<np;ip++)
+   {
+   vpk[ip] = -1.0;
+   ivpk[ip] = 0;
+   }
+
+fdw = croptrfile(pyrfile);
+if(ftruncate(fdw,tspyr_offset(&ph,nlev+1)) != 0)
+   {
+   fprintf(stderr,"can't set size of %s, exiting ...\n",pyrfile);
+   exit(-1);
+   }
+
+for(it=0;it<ph.tshead.nt;it++)
+   {
+   tspyr_pread(fdr,buf,blen,sizeof(struct tsheader) + it*blen);
+
+#pragma omp parallel for num_threads(nthreads) schedule(static) private(ic,v,vec)
+   for(ip=0;ip<np;ip++)
+      {
+      vec = 0.0;
+      for(ic=0;ic<3;ic++)
+         {
+         v = buf[ip + ic*np];
+         vec = vec + v*v;
+         if(v < 0.0)
+            v = -v;
+
+         if(v > pk[ip + ic*np])
+            {
+            pk[ip + ic*np] = v;
+            ipk[ip + ic*np] = it;
+            }
+         }
+
+      if(vec > vpk[ip])
+         {
+         vpk[ip] = vec;
+         ivpk[ip] = it;
+         }
+      }
+
+   if(it%tskip != 0)
+      continue;
+
+   ik = it/tskip;
+   for(l=1;l<=nlev;l++)
+      {
+      s = 1 << l;
+      nxl = tspyr_levn(nx,l);
+      nyl = tspyr_levn(ny,l);
+
+      ip = 0;
+      for(ic=0;ic<3;ic++)
+         {
+         for(iy=0;iy<nyl;iy++)
+            {
+            for(ix=0;ix<nxl;ix++)
+               lbuf[ip++] = buf[ic*np + (off_t)(iy*s)*nx + ix*s];
+            }
+         }
+
+      off = tspyr_offset(&ph,l) + (off_t)(ik)*3*nxl*nyl*sizeof(float);
+      tspyr_pwrite(fdw,lbuf,3*nxl*nyl*sizeof(float),off);
+      }
+   }
+close(fdr);
+
+/* the tile peaks, ties to the first point of the tile */
+ntx = (nx + tile - 1)/tile;
+nty = (ny + tile - 1)/tile;
+tpk = (float *) check_malloc(3*ntx*nty*sizeof(float));
+itpk = (int *) check_malloc(3*ntx*nty*sizeof(int));
+
+for(ic=0;ic<3;ic++)
+   {
+   for(jy=0;jy<nty;jy++)
+      {
+      for(jx=0;jx<ntx;jx++)
+         {
+         ip = jx + (jy + ic*nty)*ntx;
+         tpk[ip] = -1.0;
+         itpk[ip] = 0;
+
+         for(iy=jy*tile;iy<ny && iy<(jy+1)*tile;iy++)
+            {
+            for(ix=jx*tile;ix<nx && ix<(jx+1)*tile;ix++)
+               {
+               off = ic*np + (off_t)(iy)*nx + ix;
+               if(pk[off] > tpk[ip])
+                  {
+                  tpk[ip] = pk[off];
+                  itpk[ip] = ipk[off];
+                  }
+               }
+            }
+         }
+      }
+   }
+
+tspyr_pwrite(fdw,&ph,sizeof(ph),0);
+off = tspyr_offset(&ph,0);
+tspyr_pwrite(fdw,pk,3*np*sizeof(float),off);
+tspyr_pwrite(fdw,ipk,3*np*sizeof(int),off + 3*np*sizeof(float));
+tspyr_pwrite(fdw,vpk,np*sizeof(float),off + 6*np*sizeof(float));
+tspyr_pwrite(fdw,ivpk,np*sizeof(int),off + 7*np*sizeof(float));
+
+off = tspyr_offset(&ph,-1);
+tspyr_pwrite(fdw,tpk,3*ntx*nty*sizeof(float),off);
+tspyr_pwrite(fdw,itpk,3*ntx*nty*sizeof(int),off + 3*ntx*nty*sizeof(float));
+close(fdw);
+
+off = tspyr_offset(&ph,nlev+1);
+
+free(buf);
+free(pk);
+free(ipk);
+free(vpk);
+free(ivpk);
+free(lbuf);
+free(tpk);
+free(itpk);
+return(off);
+}
+
+/*
+   Opens the pyramid pyrfile and reads its header into ph.  Returns the
+   file descriptor, or -1 (with a message) if it can not be read or is
+   not the pyramid of a file with header tshead.
+*/
+int tspyr_open(char *pyrfile,struct tspyr_head *ph,struct tsheader *tshead)
+{
+struct stat sbuf;
+int fd;
+
+if((fd = open(pyrfile,RDONLY_FLAGS,0)) < 0)
+   {
+   fprintf(stderr,"no time slice pyramid %s\n",pyrfile);
+   return(-1);
+   }
+
+if(read(fd,ph,sizeof(struct tspyr_head)) != sizeof(struct tspyr_head) || memcmp(ph->magic,TSPYR_MAGIC,sizeof(ph->magic)) != 0)
+   {
+   fprintf(stderr,"%s is not a time slice pyramid\n",pyrfile);
+   close(fd);
+   return(-1);
+   }
+
+if(memcmp(&ph->tshead,tshead,sizeof(struct tsheader)) != 0 || fstat(fd,&sbuf) != 0 || sbuf.st_size < tspyr_offset(ph,ph->nlev+1))
+   {
+   fprintf(stderr,"time slice pyramid %s does not match its file\n",pyrfile);
+   close(fd);
+   return(-1);
+   }
+
+return(fd);
+}
+
+/*
+   The peaks in the layout of ts2xyz: for getpeak val[0..3*np-1] and
+   itlist[] the peaks of the 3 components and their slices, for
+   vectorpeak the peak squared vector amplitude in val[0..np-1] (the
+   rest -1.0 and 0, as ts2xyz leaves them).
+*/
+void tspyr_read_peak(int fd,struct tspyr_head *ph,float *val,int *itlist,int vectorpeak)
+{
+off_t np, off, ip;
+
+np = (off_t)(ph->tshead.nx)*ph->tshead.ny;
+off = tspyr_offset(ph,0);
+
+if(vectorpeak)
+   {
+   tspyr_pread(fd,val,np*sizeof(float),off + 6*np*sizeof(float));
+   tspyr_pread(fd,itlist,np*sizeof(int),off + 7*np*sizeof(float));
+   for(ip=np;ip<3*np;ip++)
+      {
+      val[ip] = -1.0;
+      itlist[ip] = 0;
+      }
+   }
+else
+   {
+   tspyr_pread(fd,val,3*np*sizeof(float),off);
+   tspyr_pread(fd,itlist,3*np*sizeof(int),off + 3*np*sizeof(float));
+   }
+}
+
+/*
+   Slice it (a multiple of tskip) of level lev into val, 3 planes of
+   nyl rows of nxl values.  Returns -1 if the pyramid does not keep it.
+*/
+int tspyr_read_level(int fd,struct tspyr_head *ph,int lev,int it,float *val)
+{
+size_t len;
+
+if(lev < 1 || lev > ph->nlev || it < 0 || it >= ph->tshead.nt || it%ph->tskip != 0)
+   return(-1);
+
+len = 3*(size_t)(tspyr_levn(ph->tshead.nx,lev))*tspyr_levn(ph->tshead.ny,lev)*sizeof(float);
+tspyr_pread(fd,val,len,tspyr_offset(ph,lev) + (off_t)(it/ph->tskip)*len);
+return(0);
+}
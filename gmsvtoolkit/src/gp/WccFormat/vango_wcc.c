@@ -14,15 +14,18 @@
 /*                                                                  */
 /********************************************************************/
 
-#include <sys/file.h>
-#include <stdio.h>
-#include <math.h>
+#include "include.h"
+#include "structure.h"
+#include "function.h"
+#include "getpar.h"
 
 #define		MAXF	2
-#define		MAXPTS	1000000
-#define		MAXSUB	100000
-#define		MAXSTAT	50
-#define		MAXTW	200
+
+/* GFs are read and summed this many floats at a time */
+#define		GF_BATCH	4194304
+
+/* threads sum the output in blocks of this many samples */
+#define		SUM_BLOCK	2048
 
 struct faultparam
    {
@@ -46,53 +49,109 @@ struct modelparam
    float *mu;
    };
 
-#define STATCHAR 8
-#define COMPCHAR 4
-#define TITLCHAR 64
-
-struct statdata
+/* one shifted and scaled GF of a batch */
+struct gfsum
    {
-   char stat[STATCHAR];
-   char comp[COMPCHAR];
-   char stitle[TITLCHAR];
+   int ic;
    int nt;
-   float dt;
-   int hr;
-   int min;
-   float sec;
-   float edist;
-   float az;
-   float baz;
+   int itst;
+   int itshft;
+   float x;
+   long long off;
    };
 
-void *check_malloc(int);
-double frand(void);
-double sfrand(long *);
-void write_wccseis(char *, struct statdata *, float *, int);
-
 int size_float = sizeof(float);
 int size_int = sizeof(int);
 
-main (ac, av)
-int ac;
-char **av;
+void normslip(struct faultparam *,struct modelparam *,float *,float *,float *,float *,int,int,float *,float *,int *,float *,int,float *);
+void getmom(struct faultparam *,struct modelparam *,float *,float *,float *,float *,int,int,float *,int *,float *,float *);
+
+/*
+   Adds the nb GFs of a batch to the seismograms.  The threads share
+   the output samples, not the GFs: every sample gets its terms in the
+   order of the serial sum, so the result does not depend on the
+   number of threads.
+*/
+
+void sum_batch(struct gfsum *gs,int nb,float *gfbuf,float **seis,int nseis)
+{
+int ib, ic, k0, k1, it, it0, it1, nblk, ik;
+float *sptr, *gf;
+
+nblk = (nseis + SUM_BLOCK - 1)/SUM_BLOCK;
+
+#pragma omp parallel for schedule(dynamic) private(ib,ic,k0,k1,it,it0,it1,sptr,gf)
+for(ik=0;ik<3*nblk;ik++)
+   {
+   ic = ik/nblk;
+   k0 = (ik%nblk)*SUM_BLOCK;
+   k1 = k0 + SUM_BLOCK;
+   if(k1 > nseis)
+      k1 = nseis;
+
+   sptr = seis[ic];
+   for(ib=0;ib<nb;ib++)
+      {
+      if(gs[ib].ic != ic)
+         continue;
+
+      it0 = gs[ib].itst;
+      if(it0 < k0 - gs[ib].itshft)
+         it0 = k0 - gs[ib].itshft;
+      it1 = gs[ib].nt;
+      if(it1 > k1 - gs[ib].itshft)
+         it1 = k1 - gs[ib].itshft;
+
+      gf = gfbuf + gs[ib].off;
+      for(it=it0;it<it1;it++)
+         sptr[it + gs[ib].itshft] = sptr[it + gs[ib].itshft] + gs[ib].x*gf[it];
+      }
+   }
+}
+
+/* grows the 3 seismograms to n samples, the new ones are 0 */
+
+void grow_seis(float **seis,int *nseis,int n)
+{
+int ic, i;
+
+if(n <= *nseis)
+   return;
+
+if(n < 2*(*nseis))
+   n = 2*(*nseis);
+
+for(ic=0;ic<3;ic++)
+   {
+   seis[ic] = (float *) check_realloc (seis[ic],n*size_float);
+   for(i=*nseis;i<n;i++)
+      seis[ic][i] = 0.0;
+   }
+*nseis = n;
+}
+
+int main(int ac,char **av)
 {
 struct statdata head1;
-FILE *fp, *fopfile();
-float space[50000];
+FILE *fp;
 struct faultparam fault;
 struct modelparam model;
 int fd[MAXF];
-float gf[MAXPTS], *seis[3], *x, *aslip, tdel[MAXTW], *sptr, dt, fac;
+float *gfbuf, *seis[3], *x, *aslip, *tdel, *sptr, dt, fac;
 float rng, gftst, tshft, avgslip, maxslip;
+double pert;
 int itst, nseq;
 int i, j, ij, ic, nc, nsum, nsumst, nsumend, nmech, nwin, nsub, ntmax;
 float mompct, momtrgt, fmnt;
 int imech, istat, smode, isub, nt, it, itshft, k, nn, nstat, iwin, nt6;
-int indx[MAXSUB], nsum1[MAXSUB];
+int *indx, *nsum1;
+int nseis, nb, nbmax;
+long long gfoff, gfmax;
+long state;
+struct gfsum *gs;
 char statlist[512], mechname[256], str[512];
-char *statname[MAXSTAT], statbuf[MAXSTAT*STATCHAR];
-char *compname[3*MAXSTAT], compbuf[3*MAXSTAT*4];
+char **statname, *statbuf;
+char **compname, *compbuf;
 char rtimesin[256], rtimesout[256];
 char lisafile[512];
 float sgn = 1.0;
@@ -108,8 +167,16 @@ float *tsf, xs[2];
 float xmax, xavg, rtmin;
 float *xp, *yp, *rt;
 
+/*
+   rng=0: the time perturbations trand*dt are drawn from the sfrand()
+          stream of seed, in the order of the summation (as always)
+     =1:  from the counter-based stream of seed (crand_philox), the
+          number of each term given by its station, mechanism,
+          subfault, component and window
+*/
 float trand = 0.0;
-long seed = 1;
+int seed = 1;
+int rng_mode = 0;
 
 int normap = 0;
 int bailey = 0;
@@ -134,6 +201,7 @@ getpar("outbin","d",&outbin);
 getpar("targetslip","f",&targetslip);
 getpar("trand","f",&trand);
 getpar("seed","d",&seed);
+getpar("rng","d",&rng_mode);
 getpar("epi","f",&epi);
 getpar("tstart","f",&tstart);
 getpar("title","s",title);
@@ -148,11 +216,19 @@ endpar();
 if(tstart > -1.0e+14)
    tst = tstart;
 
+state = seed;
+
+nseis = 0;
 for(ic=0;ic<3;ic++)
-   seis[ic] = (float *) check_malloc (size_float*MAXPTS);
+   seis[ic] = NULL;
 
 printf("Enter the number of different mechanisms\n");
 scanf("%d",&nmech);
+if(nmech > MAXF)
+   {
+   fprintf(stderr,"*** Maximum number of mechanisms (%d) exceeded, exiting...\n",MAXF);
+   exit(-1);
+   }
 
 for(i=0;i<nmech;i++)
    {
@@ -215,6 +291,9 @@ for(i=0;i<model.nlay;i++)
    exit(-99);
 */
 
+nsum1 = (int *) check_malloc (nsub*size_int);
+indx = NULL;
+
 printf("Enter the mode of subfault summation (0=all,1=select,2=sequence,3=specify rows)\n");
 scanf("%d",&smode);
 if(smode)
@@ -223,6 +302,7 @@ if(smode)
       {
       printf("Enter the number of subfaults to sum\n");
       scanf("%d",&nsum);
+      indx = (int *) check_malloc (nsum*size_int);
       printf("Enter the subfault indices\n");
       for(i=0;i<nsum;i++)
          scanf("%d",&indx[i]);
@@ -236,6 +316,8 @@ if(smode)
 	 {
          printf("Enter the first and last subfaults in sequence\n");
          scanf("%d %d",&nsumst,&nsumend);
+	 if(nsumend > nsumst)
+	    indx = (int *) check_realloc (indx,(nsum+nsumend-nsumst)*size_int);
 	 k = nsum;
          for(i=nsumst;i<nsumend;i++)
 	    {
@@ -248,6 +330,7 @@ if(smode)
       {
       printf("Enter the number of rows to read\n");
       scanf("%d",&nsum);
+      indx = (int *) check_malloc (nsum*fault.nx*size_int);
       printf("Enter the row indices\n");
       for(i=0;i<nsum;i++)
 	 {
@@ -274,11 +357,7 @@ else
 printf("Enter the number of time windows\n");
 scanf("%d",&nwin);
 printf("*** Number of time windows= %d\n",nwin);
-if(nwin > MAXTW)
-   {
-   fprintf(stderr,"*** Maximum number of time windows exceeded, exiting...\n");
-   exit(-1);
-   }
+tdel = (float *) check_malloc (nwin*size_float);
 
 for(i=0;i<nwin;i++)
    {
@@ -295,6 +374,10 @@ scanf("%d",&nstat);
 
 if(nstat > 0)
    {
+   statname = (char **) check_malloc (nstat*sizeof(char *));
+   statbuf = (char *) check_malloc (nstat*STATCHAR);
+   compname = (char **) check_malloc (3*nstat*sizeof(char *));
+   compbuf = (char *) check_malloc (3*nstat*COMPCHAR);
    for(i=0;i<nstat;i++)
       {
       printf("Enter the name for station #%2d\n",i+1);
@@ -303,7 +386,7 @@ if(nstat > 0)
       for(ic=0;ic<3;ic++)
          {
          printf("Enter the 3 letter code for %s comp #%1d\n",statname[i],ic+1);
-         compname[3*i + ic] = compbuf + (3*i + ic)*4;
+         compname[3*i + ic] = compbuf + (3*i + ic)*COMPCHAR;
          scanf("%s",compname[3*i + ic]);
          }
       }
@@ -314,13 +397,17 @@ else
    fp = fopfile(statlist,"r");
 
    fscanf(fp,"%d",&nstat);
+   statname = (char **) check_malloc (nstat*sizeof(char *));
+   statbuf = (char *) check_malloc (nstat*STATCHAR);
+   compname = (char **) check_malloc (3*nstat*sizeof(char *));
+   compbuf = (char *) check_malloc (3*nstat*COMPCHAR);
    for(i=0;i<nstat;i++)
       {
       statname[i] = statbuf + i*STATCHAR;
       fscanf(fp,"%s",statname[i]);
       for(ic=0;ic<3;ic++)
          {
-         compname[3*i + ic] = compbuf + (3*i + ic)*4;
+         compname[3*i + ic] = compbuf + (3*i + ic)*COMPCHAR;
          fscanf(fp,"%s",compname[3*i + ic]);
          }
       }
@@ -467,6 +554,18 @@ if(rtimesin[0] != '\0')
    fclose(fp);
    }
 
+gfmax = GF_BATCH;
+gfbuf = (float *) check_malloc (gfmax*size_float);
+nbmax = 1024;
+gs = (struct gfsum *) check_malloc (nbmax*sizeof(struct gfsum));
+
+/*
+   The GFs of a station are read in order into batches of GF_BATCH
+   floats, with their shifts (and the random perturbations, in the
+   order they always were drawn in); each batch is then summed by
+   sum_batch().
+*/
+
 ntmax = 0;
 for(istat=0;istat<nstat;istat++)
    {
@@ -474,10 +573,12 @@ for(istat=0;istat<nstat;istat++)
    for(ic=0;ic<3;ic++)
       {
       sptr = seis[ic];
-      for(i=0;i<MAXPTS;i++)
+      for(i=0;i<nseis;i++)
          sptr[i] = 0.0;
       }
 
+   nb = 0;
+   gfoff = 0;
    for(imech=0;imech<nmech;imech++)
       {
       for(isub=0;isub<nsub;isub++)
@@ -488,7 +589,6 @@ for(istat=0;istat<nstat;istat++)
 	 lseek(fd[imech],size_int,1); /* skip padding in Fortran binary */
 	 for(ic=0;ic<nc;ic++)
 	    {
-	    sptr = seis[ic];
 	    lseek(fd[imech],size_int,1); /* skip padding in Fortran binary */
 	    reed(fd[imech],&rng,size_float);
 	    reed(fd[imech],&gftst,size_float);
@@ -503,8 +603,20 @@ for(istat=0;istat<nstat;istat++)
 	    reed(fd[imech],&dt,size_float);
 	    lseek(fd[imech],size_int,1); /* skip padding in Fortran binary */
 
+	    if(gfoff + nt > gfmax)
+	       {
+	       sum_batch(gs,nb,gfbuf,seis,nseis);
+	       nb = 0;
+	       gfoff = 0;
+	       if(nt > gfmax)
+	          {
+	          gfmax = nt;
+	          gfbuf = (float *) check_realloc (gfbuf,gfmax*size_float);
+	          }
+	       }
+
 	    lseek(fd[imech],size_int,1); /* skip padding in Fortran binary */
-	    reed(fd[imech],gf,nt*size_float);
+	    reed(fd[imech],gfbuf+gfoff,nt*size_float);
 	    lseek(fd[imech],size_int,1); /* skip padding in Fortran binary */
 
 	    if(nsum1[isub])
@@ -513,7 +625,12 @@ for(istat=0;istat<nstat;istat++)
                   {
                   j = isub*nwin*nmech + nwin*imech + iwin;
  
-                  tshft = gftst + tdel[iwin] + trand*sfrand(&seed)*dt - tst;
+		  if(rng_mode == 1)
+		     pert = crand_philox(seed,((((long long)(istat)*nmech + imech)*nsub + isub)*3 + ic)*nwin + iwin);
+		  else
+		     pert = crand_lcg(&state);
+
+                  tshft = gftst + tdel[iwin] + trand*pert*dt - tst;
 		  tshft = tshft + tsf[isub];
 
                   if(tshft < 0.0)
@@ -527,19 +644,35 @@ for(istat=0;istat<nstat;istat++)
                      itst = 0;
 		     }
 
-                  for(it=itst;it<nt;it++)
-                     {
-                     k = it + itshft;
-                     sptr[k] = sptr[k] + x[j]*gf[it];
+		  if(nb == nbmax)
+		     {
+		     nbmax = 2*nbmax;
+		     gs = (struct gfsum *) check_realloc (gs,nbmax*sizeof(struct gfsum));
+		     }
+		  gs[nb].ic = ic;
+		  gs[nb].nt = nt;
+		  gs[nb].itst = itst;
+		  gs[nb].itshft = itshft;
+		  gs[nb].x = x[j];
+		  gs[nb].off = gfoff;
+		  nb++;
+
+		  /* k is the last sample of the term, as in the serial sum */
+		  if(itst < nt)
+		     {
+                     k = nt - 1 + itshft;
+		     grow_seis(seis,&nseis,k+1);
 		     }
 
 	          if(k > ntmax)
 	             ntmax = k;
                   }
+	       gfoff = gfoff + nt;
 	       }
 	    }
          }
       }
+   sum_batch(gs,nb,gfbuf,seis,nseis);
 
    if(tstart < -1.0e+14) /* use tst from GFs */
       {
@@ -547,6 +680,7 @@ for(istat=0;istat<nstat;istat++)
       itshft = (int)(tst/dt + 0.5);
 
       ntmax = ntmax - itshft;
+      grow_seis(seis,&nseis,ntmax);
 
       for(ic=0;ic<nc;ic++)
          {
@@ -568,6 +702,8 @@ for(istat=0;istat<nstat;istat++)
          }
       }
 
+   grow_seis(seis,&nseis,ntmax);
+
    strcpy(head1.stat,statname[istat]);
    strcpy(head1.stitle,title);
 
@@ -601,7 +737,7 @@ for(istat=0;istat<nstat;istat++)
    }
 }
 
-normslip(fault,model,x,as,avgs,mxs,nm,nw,mtrg,fmnt,nsum,momp,normap,targs)
+void normslip(fault,model,x,as,avgs,mxs,nm,nw,mtrg,fmnt,nsum,momp,normap,targs)
 struct faultparam *fault;
 struct modelparam *model;
 float *x, *mtrg, *fmnt, *as, *avgs, *mxs, *momp, *targs;
@@ -789,7 +925,7 @@ for(j=0;j<fault->nx;j++)
 *momp = (*momp)/momt;
 }
 
-getmom(fault,model,x,as,avgs,mxs,nm,nw,mtrg,nsum,momp,targs)
+void getmom(fault,model,x,as,avgs,mxs,nm,nw,mtrg,nsum,momp,targs)
 struct faultparam *fault;
 struct modelparam *model;
 float *x, *mtrg, *as, *avgs, *mxs, *momp, *targs;
@@ -869,23 +1005,3 @@ for(j=0;j<fault->nx;j++)
 *mtrg = sum*1.0e+22;
 *avgs = *avgs/(fault->nx*fault->ny);
 }
-
-static  long    frandx = 1;
-
-/* frand() returns a uniform distribution of random numbers
- * in the range -1.0 -> 1.0.
- */
-double frand(void)
-{
-frandx = (frandx * 1103515245 + 12345) & 0x7fffffff;
-return((double)(frandx)/1073741824.0 - 1.0);
-}
-
-/* sfrand() returns a uniform distribution of random numbers
- * in the range -1.0 -> 1.0.
- */
-double sfrand(long *seed)
-{
-*seed = ((*seed) * 1103515245 + 12345) & 0x7fffffff;
-return((double)(*seed)/1073741824.0 - 1.0);
-}
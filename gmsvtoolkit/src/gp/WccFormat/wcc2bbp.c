@@ -1,15 +1,59 @@
+/**********************************************************************/
+/*                                                                    */
+/*           wcc2bbp                                                  */
+/*                                                                    */
+/*           wcc2bbp=1 (default): the three WCC traces nsfile,        */
+/*           ewfile and udfile into the BBP file bbfile, one line of  */
+/*           time and the three samples (tformat=, dformat=) per      */
+/*           time step.  wcc2bbp=0: a BBP file back into the three    */
+/*           traces.                                                  */
+/*                                                                    */
+/*           The lines are formatted into a block BBP_BLOCK steps at  */
+/*           a time and written with one call; formats of the form    */
+/*           "text%W.Pe" (the defaults %.6e and \t%.6e) do not go     */
+/*           through printf at all (bbp_format_line()).               */
+/*                                                                    */
+/*           chunk= (binary traces, inbin=1) reads the traces chunk   */
+/*           samples at a time instead of holding the three whole.    */
+/*           filelist= does many stations in one run, by nthreads=    */
+/*           OpenMP threads, the lines being                          */
+/*                                                                    */
+/*              nsfile ewfile udfile bbfile                           */
+/*                                                                    */
+/**********************************************************************/
+
 #include "include.h"
 #include "structure.h"
 #include "function.h"
 #include "getpar.h"
 
+/* time steps formatted into the output block at a time */
+#define BBP_BLOCK 8192
+
+#define LINELEN 1024
+
+/* the output choices of wcc2bbp=1 */
+struct bbp_par
+   {
+   char title[128];
+   char nsname[128];
+   char ewname[128];
+   char udname[128];
+   char units[128];
+   struct bbp_format bf;
+   };
+
+void wcc2bbp_file(char *,char *,char *,char *,int,int,struct bbp_par *);
+
 int main(int ac,char **av)
 {
 FILE *fpr;
 struct statdata head1, head2, head3;
+struct bbp_par bp;
 float *s1, *s2, *s3;
-int it;
+int it, n, nfile;
 double tst, *tbuf;
+char (*nsfiles)[LINELEN], (*ewfiles)[LINELEN], (*udfiles)[LINELEN], (*bbfiles)[LINELEN];
 
 char nsfile[256];
 char ewfile[256];
@@ -24,7 +68,6 @@ char units[128];
 
 char tformat[16];
 char dformat[16];
-char frmt[256];
 
 char stat[16];
 char comp[4];
@@ -38,6 +81,11 @@ int outbin = 0;
 int bufinc = 10000;
 int bufcnt = 1;
 
+int chunk = 0;
+int nthreads = 1;
+char filelist[512];
+int nalloc;
+
 stat[0] = '\0';
 title[0] = '\0';
 
@@ -49,13 +97,20 @@ units[0] = '\0';
 sprintf(tformat,"%%.6e");
 sprintf(dformat,"\t%%.6e");
 
-setpar(ac,av);
+filelist[0] = '\0';
 
-mstpar("nsfile","s",nsfile);
-mstpar("ewfile","s",ewfile);
-mstpar("udfile","s",udfile);
+setpar(ac,av);
 
 getpar("wcc2bbp","d",&wcc2bbp);
+if(wcc2bbp == 1)
+   getpar("filelist","s",filelist);
+
+if(filelist[0] == '\0')
+   {
+   mstpar("nsfile","s",nsfile);
+   mstpar("ewfile","s",ewfile);
+   mstpar("udfile","s",udfile);
+   }
 
 if(wcc2bbp == 1)
    {
@@ -80,52 +135,71 @@ getpar("stat","s",stat);
 getpar("title","s",title);
 getpar("inbin","d",&inbin);
 getpar("outbin","d",&outbin);
+getpar("chunk","d",&chunk);
+getpar("nthreads","d",&nthreads);
 
 endpar();
 
 if(wcc2bbp == 1)
    {
-   s1 = NULL;
-   s1 = read_wccseis(nsfile,&head1,s1,inbin);
-
-   s2 = NULL;
-   s2 = read_wccseis(ewfile,&head2,s2,inbin);
-
-   s3 = NULL;
-   s3 = read_wccseis(udfile,&head3,s3,inbin);
+   if(chunk > 0 && !inbin)
+      {
+      fprintf(stderr,"chunk= needs inbin=1, exiting...\n");
+      exit(-1);
+      }
 
-   if(strcmp(bbfile,"stdout") == 0)
-      fpr = stdout;
-   else
-      fpr = fopfile(bbfile,"w");
+   strcpy(bp.title,title);
+   strcpy(bp.units,units);
+   if(bp.units[0] == '\0')
+      sprintf(bp.units,"cm/s");
 
-   if(title[0] != '\0')
-      fprintf(fpr,"# %s\n",title);
+   strcpy(bp.nsname,nsname);
+   strcpy(bp.ewname,ewname);
+   strcpy(bp.udname,udname);
+   if(bp.nsname[0] == '\0')
+      sprintf(bp.nsname,"N-S(%s)",bp.units);
+   if(bp.ewname[0] == '\0')
+      sprintf(bp.ewname,"E-W(%s)",bp.units);
+   if(bp.udname[0] == '\0')
+      sprintf(bp.udname,"U-D(%s)",bp.units);
 
-   if(units[0] == '\0')
-      sprintf(units,"cm/s");
-   if(nsname[0] == '\0')
-      sprintf(nsname,"N-S(%s)",units);
-   if(ewname[0] == '\0')
-      sprintf(ewname,"E-W(%s)",units);
-   if(udname[0] == '\0')
-      sprintf(udname,"U-D(%s)",units);
+   bbp_format_init(&bp.bf,tformat,dformat);
 
-   if(strcmp(units,"-1") != 0)
-      fprintf(fpr,"#    time(sec)      %s      %s      %s\n",nsname,ewname,udname);
+   if(filelist[0] == '\0')
+      {
+      wcc2bbp_file(nsfile,ewfile,udfile,bbfile,inbin,chunk,&bp);
+      exit(0);
+      }
 
-   sprintf(frmt,"%s%s%s%s\n",tformat,dformat,dformat,dformat);
+   nsfiles = NULL;
+   ewfiles = NULL;
+   udfiles = NULL;
+   bbfiles = NULL;
+   nfile = 0;
+   nalloc = 0;
 
-   tst = head1.sec;
-   for(it=0;it<head1.nt;it++)
+   fpr = fopfile(filelist,"r");
+   while(fgets(str,1024,fpr) != NULL)
       {
-      /*
-      fprintf(fpr,"%14.6f %14.6e %14.6e %14.6e\n",tst,s1[it],s2[it],s3[it]);
-      */
-      fprintf(fpr,frmt,tst,s1[it],s2[it],s3[it]);
-      tst = tst + head1.dt;
+      if(nfile == nalloc)
+         {
+         nalloc = nalloc + 1024;
+         nsfiles = check_realloc(nsfiles,nalloc*LINELEN);
+         ewfiles = check_realloc(ewfiles,nalloc*LINELEN);
+         udfiles = check_realloc(udfiles,nalloc*LINELEN);
+         bbfiles = check_realloc(bbfiles,nalloc*LINELEN);
+         }
+
+      n = sscanf(str,"%1023s %1023s %1023s %1023s",nsfiles[nfile],ewfiles[nfile],udfiles[nfile],bbfiles[nfile]);
+      if(n < 4 || nsfiles[nfile][0] == '#')
+         continue;
+      nfile++;
       }
    fclose(fpr);
+
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic,1)
+   for(n=0;n<nfile;n++)
+      wcc2bbp_file(nsfiles[n],ewfiles[n],udfiles[n],bbfiles[n],inbin,chunk,&bp);
    }
 else
    {
@@ -225,3 +299,113 @@ else
    }
    return(0);
 }
+
+/*
+   The BBP file bbfile of nsfile, ewfile and udfile, read whole or, with
+   chunk > 0 (binary traces), chunk samples at a time.
+*/
+void wcc2bbp_file(char *nsfile,char *ewfile,char *udfile,char *bbfile,int inbin,int chunk,struct bbp_par *bp)
+{
+FILE *fpw;
+struct statdata head1, head2, head3;
+float *s1, *s2, *s3;
+int fd1, fd2, fd3, it, i0, nc, i;
+double tst;
+char *buf, *pb;
+
+if(chunk > 0)
+   {
+   if((fd1 = opfile_ro(nsfile)) < 0 || (fd2 = opfile_ro(ewfile)) < 0 || (fd3 = opfile_ro(udfile)) < 0)
+      exit(-1);
+
+   reed(fd1,&head1,sizeof(struct statdata));
+   reed(fd2,&head2,sizeof(struct statdata));
+   reed(fd3,&head3,sizeof(struct statdata));
+
+   s1 = (float *) check_malloc(3*chunk*sizeof(float));
+   s2 = s1 + chunk;
+   s3 = s2 + chunk;
+   }
+else
+   {
+   s1 = NULL;
+   s1 = read_wccseis(nsfile,&head1,s1,inbin);
+
+   s2 = NULL;
+   s2 = read_wccseis(ewfile,&head2,s2,inbin);
+
+   s3 = NULL;
+   s3 = read_wccseis(udfile,&head3,s3,inbin);
+   }
+
+if(head2.nt < head1.nt || head3.nt < head1.nt)
+   {
+   fprintf(stderr,"*** %s (nt= %d) or %s (nt= %d) shorter than %s (nt= %d), exiting...\n",
+                             ewfile,head2.nt,udfile,head3.nt,nsfile,head1.nt);
+   exit(-1);
+   }
+
+if(strcmp(bbfile,"stdout") == 0)
+   fpw = stdout;
+else
+   fpw = fopfile(bbfile,"w");
+
+if(bp->title[0] != '\0')
+   fprintf(fpw,"# %s\n",bp->title);
+
+if(strcmp(bp->units,"-1") != 0)
+   fprintf(fpw,"#    time(sec)      %s      %s      %s\n",bp->nsname,bp->ewname,bp->udname);
+
+buf = (char *) check_malloc(BBP_BLOCK*BBP_LINE);
+
+tst = head1.sec;
+i0 = 0;
+for(it=0;it<head1.nt;it=it+nc)
+   {
+   nc = head1.nt - it;
+   if(chunk > 0)
+      {
+      if(nc > chunk)
+         nc = chunk;
+
+      reed(fd1,s1,nc*sizeof(float));
+      reed(fd2,s2,nc*sizeof(float));
+      reed(fd3,s3,nc*sizeof(float));
+      i0 = it;
+      }
+
+   pb = buf;
+   for(i=0;i<nc;i++)
+      {
+      if(pb - buf > (BBP_BLOCK-1)*BBP_LINE)
+         {
+         fwrite(buf,1,pb - buf,fpw);
+         pb = buf;
+         }
+
+      pb = bbp_format_line(pb,&bp->bf,tst,s1[it+i-i0],s2[it+i-i0],s3[it+i-i0]);
+      tst = tst + head1.dt;
+      }
+   fwrite(buf,1,pb - buf,fpw);
+   }
+
+free(buf);
+if(chunk > 0)
+   {
+   close(fd1);
+   close(fd2);
+   close(fd3);
+   free(s1);
+   }
+else
+   {
+   free(s1);
+   free(s2);
+   free(s3);
+   }
+
+if(fpw != stdout)
+   fclose(fpw);
+else
+   fflush(fpw);
+}
@@ -9,7 +9,8 @@ char **av;
 FILE *fpw, *fopfile();
 struct statdata head1;
 float *s1, tst, tt;
-int i;
+double ti, pad;
+int i, k, ns, it0, it1;
 char infile[128], outfile[128];
 
 int inbin = 0;
@@ -37,23 +38,63 @@ getpar("tstart","f",&tstart);
 getpar("tend","f",&tend);
 endpar();
  
+if(itskip < 1)
+   itskip = 1;
+
+/*
+   With a file, only the samples of [tstart,tend] (a few more at each
+   end, the test below still decides) and of the itskip grid are read.
+*/
 s1 = NULL;
-s1 = read_wccseis(infile,&head1,s1,inbin);
+if(read_wcchead(infile,&head1,inbin))
+   {
+   tst = 3600.0*head1.hr + 60.0*head1.min + head1.sec;
+   if(zerotst)
+      tst = 0.0;
+
+   it0 = 0;
+   it1 = head1.nt;
+   if(head1.dt > 0.0)
+      {
+      /* samples tt (a float) can be off by */
+      pad = 2.0 + ceil(4.0*FLT_EPSILON*(fabs(tshift) + fabs(tst) + fabs(head1.nt*head1.dt))/head1.dt);
+
+      ti = floor((tstart - tshift - tst)/head1.dt) - pad;
+      if(ti > it0)
+         it0 = (ti < it1) ? (int) ti : it1;
+
+      ti = ceil((tend - tshift - tst)/head1.dt) + pad + 1.0;
+      if(ti < it1)
+         it1 = (ti > it0) ? (int) ti : it0;
+      }
+   it0 = itskip*((it0 + itskip - 1)/itskip);
+
+   s1 = read_wccrange(infile,&head1,s1,inbin,it0,it1,itskip,&ns);
+   }
+else
+   {
+   s1 = read_wccseis(infile,&head1,s1,inbin);
+   tst = 3600.0*head1.hr + 60.0*head1.min + head1.sec;
+   if(zerotst)
+      tst = 0.0;
+
+   it0 = 0;
+   ns = (head1.nt + itskip - 1)/itskip;
+   for(k=0;k<ns;k++)
+      s1[k] = s1[k*itskip];
+   }
 
 if(strcmp(outfile,"stdout") == 0)
    fpw = stdout;
 else
    fpw = fopfile(outfile,"w");
 
-tst = 3600.0*head1.hr + 60.0*head1.min + head1.sec;
-if(zerotst)
-   tst = 0.0;
-
-for(i=0;i<head1.nt;i=i+itskip)
+for(k=0;k<ns;k++)
    {
+   i = it0 + k*itskip;
    tt = tshift+tst+i*head1.dt;
    if(tt >= tstart && tt <= tend)
-      fprintf(fpw,"%13.5e %13.5e\n",tt,scale*(s1[i]+shift));
+      fprintf(fpw,"%13.5e %13.5e\n",tt,scale*(s1[k]+shift));
    }
 
 fclose(fpw);
@@ -1,62 +1,147 @@
+/**********************************************************************/
+/*                                                                    */
+/*           wcc_2ampspec                                             */
+/*                                                                    */
+/*           Amplitude spectrum of infile into outfile, smoothed over */
+/*           smoothlen= Hz (a 1-cos window), resampled resamp= times  */
+/*           finer, against period with period=1.                     */
+/*                                                                    */
+/*           nfreq= gives the spectrum at only nfreq log-spaced       */
+/*           frequencies from fmin= to fmax= (default the first and   */
+/*           last FFT frequencies), the smoothing being done with     */
+/*           prefix sums at just the FFT points these need; resamp=   */
+/*           is not used then.  With filelist= (one "infile outfile"  */
+/*           pair per line) many traces are done in one run, by       */
+/*           nthreads= OpenMP threads.                                */
+/*                                                                    */
+/**********************************************************************/
+
 #include "include.h"
 #include "structure.h"
 #include "function.h"
+#include "getpar.h"
 
 #define TAP_PERC 0.20
 
-struct complex
+#define LINELEN 1024
+
+struct ampspec_par
    {
-   float re;
-   float im;
+   int inbin;
+   int norm1;
+   int norm2;
+   int period;
+   int resamp;
+   int nfreq;
+   float smoothlen;
+   float tap_per;
+   float fmin;
+   float fmax;
    };
 
+void ampspec_file(struct ampspec_par *,char *,char *);
+void logspec(float *,int,float,struct ampspec_par *,char *);
+void ampspec(int,struct complex *,int);
+void smooth(float *,int,float *,float *);
+void zero(float *,int);
+void taper_norm(float *,float *,int,float *);
+int getnt_p2(int);
+void norm_area(float *,int,float *);
+void resample(float *,float *,int,int,float *,int,float *);
+void cxzero(struct complex *,int);
+
 int size_float = sizeof(float);
 int size_int = sizeof(int);
 
-main(int ac, char **av)
+int main(int ac, char **av)
 {
-struct statdata head1;
-float *sx, *space, newdf;
-float df, dt, *s;
-int nt6, nt_p2, i, j, nt, newnt;
-float sec, epi, az, baz, sec1;
-int hr, min;
-float flo = 0.0;
-float fhi = 0.0;
-
-int norm2 = 0;
-int norm1 = 0;
-int period = 0;
-int resamp = 1;
-
-float smoothlen = 0.0;
-float tap_per = TAP_PERC;
-
-FILE *fpr, *fpw, *fopfile();
-char header[128];
-char infile[128];
-char outfile[128];
-char stitle[128];
-
-int inbin = 0;
+struct ampspec_par ap;
+FILE *fpr, *fopfile();
+char (*infiles)[LINELEN], (*outfiles)[LINELEN];
+char str[LINELEN];
+char infile[LINELEN];
+char outfile[LINELEN];
+char filelist[512];
+int n, na, nfile, nalloc;
+
+int nthreads = 1;
+
+ap.inbin = 0;
+ap.norm1 = 0;
+ap.norm2 = 0;
+ap.period = 0;
+ap.resamp = 1;
+ap.nfreq = 0;
+ap.smoothlen = 0.0;
+ap.tap_per = TAP_PERC;
+ap.fmin = -1.0;
+ap.fmax = -1.0;
 
 sprintf(infile,"stdin");
 sprintf(outfile,"stdout");
+filelist[0] = '\0';
 
 setpar(ac,av);
 getpar("infile","s",infile);
 getpar("outfile","s",outfile);
-getpar("inbin","d",&inbin);
-getpar("norm1","d",&norm1);
-getpar("norm2","d",&norm2);
-getpar("period","d",&period);
-getpar("resamp","d",&resamp);
-getpar("smoothlen","f",&smoothlen);
-getpar("tap_per","f",&tap_per);
+getpar("filelist","s",filelist);
+getpar("inbin","d",&ap.inbin);
+getpar("norm1","d",&ap.norm1);
+getpar("norm2","d",&ap.norm2);
+getpar("period","d",&ap.period);
+getpar("resamp","d",&ap.resamp);
+getpar("smoothlen","f",&ap.smoothlen);
+getpar("tap_per","f",&ap.tap_per);
+getpar("nfreq","d",&ap.nfreq);
+getpar("fmin","f",&ap.fmin);
+getpar("fmax","f",&ap.fmax);
+getpar("nthreads","d",&nthreads);
 endpar();
 
+if(filelist[0] == '\0')
+   {
+   ampspec_file(&ap,infile,outfile);
+   exit(0);
+   }
+
+infiles = NULL;
+outfiles = NULL;
+nfile = 0;
+nalloc = 0;
+
+fpr = fopfile(filelist,"r");
+while(fgets(str,LINELEN,fpr) != NULL)
+   {
+   if(nfile == nalloc)
+      {
+      nalloc = nalloc + 1024;
+      infiles = check_realloc(infiles,nalloc*LINELEN);
+      outfiles = check_realloc(outfiles,nalloc*LINELEN);
+      }
+
+   na = sscanf(str,"%1023s %1023s",infiles[nfile],outfiles[nfile]);
+   if(na < 2 || infiles[nfile][0] == '#')
+      continue;
+   nfile++;
+   }
+fclose(fpr);
+
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic,1)
+for(n=0;n<nfile;n++)
+   ampspec_file(&ap,infiles[n],outfiles[n]);
+}
+
+/* the spectrum of one trace, infile to outfile */
+void ampspec_file(struct ampspec_par *ap,char *infile,char *outfile)
+{
+struct statdata head1;
+float *sx, *space, newdf;
+float df, dt, *s;
+int nt_p2, j, nt, newnt, resamp;
+FILE *fpw, *fopfile();
+
 s = NULL;
-s = read_wccseis(infile,&head1,s,inbin);
+s = read_wccseis(infile,&head1,s,ap->inbin);
 
 nt = head1.nt;
 dt = head1.dt;
@@ -64,19 +149,27 @@ dt = head1.dt;
 nt_p2 = getnt_p2(nt);
 s = (float *) check_realloc (s,nt_p2*size_float);
 
-if(norm1)
+if(ap->norm1)
    norm_area(s,nt,&dt);
-taper_norm(s,&dt,nt,&tap_per);
+taper_norm(s,&dt,nt,&ap->tap_per);
 zero(s+nt,nt_p2-nt);
-forfft(s,nt_p2,-1);
-ampspec(norm2,(struct complex *)s,nt_p2);
+forfft((struct complex *)s,nt_p2,-1);
+ampspec(ap->norm2,(struct complex *)s,nt_p2);
 
 nt = nt_p2/2;
 df = 1.0/(nt_p2*dt);
 
-if(smoothlen > 0.0)
-   smooth(s,nt,&df,&smoothlen);
+if(ap->nfreq > 0)
+   {
+   logspec(s,nt,df,ap,outfile);
+   free(s);
+   return;
+   }
+
+if(ap->smoothlen > 0.0)
+   smooth(s,nt,&df,&ap->smoothlen);
 
+resamp = ap->resamp;
 if(resamp > 1)
    {
    newnt = nt*resamp;
@@ -91,6 +184,7 @@ if(resamp > 1)
       sx[nt+j] = s[nt-1-j];
 
    resample(sx,&df,2*nt,resamp,&newdf,2*newnt,space);
+   free(space);
    }
 else
    {
@@ -105,7 +199,7 @@ fprintf(stderr,"nf= %8d df= %13.5e\n",newnt,newdf);
 
 fpw = fopfile(outfile,"w");
 
-if(period)
+if(ap->period)
    {
    for(j=newnt-1;j>=1;j--)
       fprintf(fpw,"%13.5e %13.5e\n",1.0/(j*newdf),sx[j]);
@@ -117,9 +211,112 @@ else
    }
 
 fclose(fpw);
+free(sx);
+free(s);
+}
+
+/*
+   The n point spectrum s (of spacing df) at nfreq log-spaced
+   frequencies, interpolated linearly between the FFT points.  With
+   smoothlen the points are first smoothed by the window of smooth(),
+
+      x[c] = sum (1 - cos((m-c)*fac))*s[m]/wsum, |m-c| <= nw2,
+
+   from the prefix sums of s, s*cos(m*fac) and s*sin(m*fac), so that
+   each costs the same whatever the window length; as in smooth() the
+   nw2 points at either end are left as they are.
+*/
+void logspec(float *s,int n,float df,struct ampspec_par *ap,char *outfile)
+{
+FILE *fpw, *fopfile();
+double *p0, *pc, *ps, fac, wsum, x[2], arg;
+float fmin, fmax, f, a;
+int nw, nw2, i, j, k, m, m0, m1;
+
+nw2 = -1;
+if(ap->smoothlen > 0.0)
+   {
+   nw = (ap->smoothlen)/df;
+   if(nw%2 == 0)
+      nw++;
+   nw2 = nw/2;
+   }
+
+if(nw2 > 0 && n > 2*nw2)
+   {
+   fac = 3.14159/(double)(nw2+1);
+
+   wsum = 0.0;
+   for(i=-nw2;i<=nw2;i++)
+      wsum = wsum + (1.0 - cos(i*fac));
+
+   p0 = (double *) check_malloc (3*(n+1)*sizeof(double));
+   pc = p0 + (n+1);
+   ps = pc + (n+1);
+
+   p0[0] = pc[0] = ps[0] = 0.0;
+   for(m=0;m<n;m++)
+      {
+      p0[m+1] = p0[m] + s[m];
+      pc[m+1] = pc[m] + s[m]*cos(m*fac);
+      ps[m+1] = ps[m] + s[m]*sin(m*fac);
+      }
+   }
+else
+   {
+   nw2 = 0;
+   p0 = NULL;
+   }
+
+fmin = ap->fmin;
+if(fmin <= 0.0)
+   fmin = df;
+fmax = ap->fmax;
+if(fmax <= 0.0 || fmax > (n-1)*df)
+   fmax = (n-1)*df;
+
+fpw = fopfile(outfile,"w");
+for(k=0;k<ap->nfreq;k++)
+   {
+   j = k;
+   if(ap->period)
+      j = ap->nfreq - 1 - k;
+
+   if(ap->nfreq > 1)
+      f = fmin*exp(j*log(fmax/fmin)/(ap->nfreq - 1));
+   else
+      f = fmin;
+
+   i = (int)(f/df);
+   if(i > n-2)
+      i = n-2;
+   a = f/df - i;
+
+   for(m=0;m<2;m++)
+      {
+      if(p0 != NULL && i+m >= nw2 && i+m < n-nw2)
+         {
+         m0 = i + m - nw2;
+         m1 = i + m + nw2 + 1;
+         arg = (i+m)*fac;
+         x[m] = ((p0[m1]-p0[m0]) - cos(arg)*(pc[m1]-pc[m0]) - sin(arg)*(ps[m1]-ps[m0]))/wsum;
+         }
+      else
+         x[m] = s[i+m];
+      }
+
+   if(ap->period)
+      fprintf(fpw,"%13.5e %13.5e\n",1.0/f,(1.0-a)*x[0] + a*x[1]);
+   else
+      fprintf(fpw,"%13.5e %13.5e\n",f,(1.0-a)*x[0] + a*x[1]);
+   }
+fclose(fpw);
+
+if(p0 != NULL)
+   free(p0);
 }
 
-ampspec(norm,g,n)
+void ampspec(norm,g,n)
 struct complex *g;
 int n, norm;
 {
@@ -146,7 +343,7 @@ if(norm)
 */
 }
 
-smooth(s,n,df,len)
+void smooth(s,n,df,len)
 float *s, *df, *len;
 int n;
 {
@@ -198,7 +395,7 @@ free(w);
 free(x);
 }
 
-zero(s,n)
+void zero(s,n)
 float *s;
 int n;
 {
@@ -209,7 +406,7 @@ while(n--)
    }
 }
 
-taper_norm(g,dt,nt,tap_per)
+void taper_norm(g,dt,nt,tap_per)
 float *g, *dt, *tap_per;
 int nt;
 {
@@ -234,7 +431,7 @@ if(ntap > 0)
    }
 }
 
-getnt_p2(nt)
+int getnt_p2(nt)
 int nt;
 {
 int i = 0;
@@ -255,7 +452,7 @@ while(i--)
 return(nt);
 }
 
-norm_area(s,n,dt)
+void norm_area(s,n,dt)
 float *s, *dt;
 int n;
 {
@@ -272,31 +469,33 @@ for(i=0;i<n;i++)
    s[i] = s[i]/area;
 }
 
-resample(s,olddt,oldnt,isamp,newdt,newnt,p)
+void resample(s,olddt,oldnt,isamp,newdt,newnt,p)
 float *s, *p, *olddt, *newdt;
 int isamp, oldnt, newnt;
 {
 struct complex *sc;
 float fac;
+float tap0 = 0.0;
 int i, nt_p2;
 
 sc = (struct complex *) s;
 
+/* scale only, the spectrum is not tapered */
 nt_p2 = getnt_p2(oldnt);
-taper_norm(s,olddt,oldnt);
+taper_norm(s,olddt,oldnt,&tap0);
 zero(s+oldnt,(nt_p2)-(oldnt));
 forfft(sc,nt_p2,-1);
 
 if(isamp > 0)
    cxzero(sc+(nt_p2/2),(newnt-nt_p2)/2);
 
-invdft(sc,p,newnt,1);
+invdft(sc,(struct complex *)p,newnt,1);
 
 fac = 1.0/((*newdt)*newnt);
-taper_norm(s,&fac,newnt);
+taper_norm(s,&fac,newnt,&tap0);
 }
  
-cxzero(p,n)
+void cxzero(p,n)
 struct complex *p;
 int n;
 {
@@ -1,199 +1,595 @@
+/**********************************************************************/
+/*                                                                    */
+/*           wcc_Xcor                                                 */
+/*                                                                    */
+/*           Normalized cross correlation of two WCC traces, as a     */
+/*           function of the time shift of infile2 against infile1.   */
+/*           printmax=1 (default) gives the peak correlation inside   */
+/*           +/- twin of the header time difference,                  */
+/*                                                                    */
+/*              cc= cc t= tdel                                        */
+/*                                                                    */
+/*           tval= the correlation at that shift and printall=1 every */
+/*           shift, "t= tdel cc= cc" (only within +/- twin of tval    */
+/*           when both are given).                                    */
+/*                                                                    */
+/*           The correlation sums are done with double precision      */
+/*           FFTs and the window energies with running sums, instead  */
+/*           of one dot product per shift.  When only a narrow band   */
+/*           of shifts is wanted (twin= small next to the trace       */
+/*           length) infile2 is taken in blocks, overlap-save, with   */
+/*           FFTs of a few times the band width.                      */
+/*                                                                    */
+/*           Many pairs are done in one run with filelist= (one name  */
+/*           per line, pack paths "pack:stat/comp" allowed): with     */
+/*           infile1= each trace of the list is correlated against    */
+/*           infile1, without it every pair of the list.  The         */
+/*           spectrum of each trace is computed once and shared by    */
+/*           all of its pairs, and nthreads= OpenMP threads share out */
+/*           the pairs.  The output lines are those above, in pair    */
+/*           order, each following the names of the two traces.      */
+/*                                                                    */
+/**********************************************************************/
+
 #include "include.h"
 #include "structure.h"
 #include "function.h"
+#include "getpar.h"
 
 #define          SMALL   1.0e-15
+#define          MAXFILES        50000
+#define          NDIRECT         64
 
 int size_float = sizeof(float);
 int size_int = sizeof(int);
 
-main(ac,av)
-int ac;
-char **av;
+struct xctrace
+   {
+   char *name;
+   struct statdata hd;
+   float *s;
+   double *e;      /* e[i] = s[0]^2 + ... + s[i-1]^2, i = 0 ... nt */
+   double *f;      /* f[i] = s[i]^2 + ... + s[nt-1]^2 */
+   double *spec;   /* spectrum with nfft zero padded samples, or NULL */
+   };
+
+struct xcopt
+   {
+   float twin, tval;
+   int printmax, printall;
+   };
+
+void xc_load(char *name,int inbin,struct xctrace *tr)
 {
-struct statdata shead1, shead2, shead3;
-float *s1, *s2;
-char infile1[512], infile2[512];
+int i;
 
-float dt, time1, time2, *p1, *p2;
-float cvel, *cc, tdel;
-int i, nt, itcc;
-int istr, iend;
+tr->name = name;
+tr->s = NULL;
+tr->s = read_wccseis(name,&tr->hd,tr->s,inbin);
 
-int inbin1 = 0;
-int inbin2 = 0;
+tr->e = (double *) check_malloc((tr->hd.nt+1)*sizeof(double));
+tr->e[0] = 0.0;
+for(i=0;i<tr->hd.nt;i++)
+   tr->e[i+1] = tr->e[i] + (double)(tr->s[i])*(double)(tr->s[i]);
 
-int itwin;
-float twin = -99.9;
+tr->f = (double *) check_malloc((tr->hd.nt+1)*sizeof(double));
+tr->f[tr->hd.nt] = 0.0;
+for(i=tr->hd.nt-1;i>=0;i--)
+   tr->f[i] = tr->f[i+1] + (double)(tr->s[i])*(double)(tr->s[i]);
 
-int printmax = 1;
-int printall = 0;
-float tval = -1.0e+15;
+tr->spec = NULL;
+}
 
-setpar(ac,av);
-mstpar("infile1","s",infile1);
-mstpar("infile2","s",infile2);
-getpar("inbin1","d",&inbin1);
-getpar("inbin2","d",&inbin2);
-getpar("twin","f",&twin);
-getpar("tval","f",&tval);
-getpar("printmax","d",&printmax);
-getpar("printall","d",&printall);
-endpar();
+void xc_spec(struct xctrace *tr,int nfft)
+{
+int i;
+
+tr->spec = (double *) check_malloc((nfft+2)*sizeof(double));
+for(i=0;i<tr->hd.nt && i<nfft;i++)
+   tr->spec[i] = tr->s[i];
+for(;i<nfft+2;i++)
+   tr->spec[i] = 0.0;
+drfft_r2c(tr->spec,nfft,-1);
+}
 
-s1 = NULL;
-s1 = read_wccseis(infile1,&shead1,s1,inbin1);
-s2 = NULL;
-s2 = read_wccseis(infile2,&shead2,s2,inbin2);
+/*
+   energy of s[ib] ... s[ie-1], zero outside the trace; the windows
+   of xcor reach one end of the trace, so the energy is a sum from
+   that end, as exact for the quiet ends of a trace as for the rest
+*/
+double xc_energy(struct xctrace *tr,int ib,int ie)
+{
+if(ib < 0)
+   ib = 0;
+if(ie > tr->hd.nt)
+   ie = tr->hd.nt;
+if(ie <= ib)
+   return(0.0);
+
+if(ib == 0)
+   return(tr->e[ie]);
+if(ie == tr->hd.nt)
+   return(tr->f[ib]);
+return(tr->e[ie] - tr->e[ib]);
+}
 
-time1 = shead1.hr*3600 + shead1.min*60 + shead1.sec;
-time2 = shead2.hr*3600 + shead2.min*60 + shead2.sec;
+/*
+   cc from the correlation sum and the two energies, with the small
+   offsets and the rescaling of very small energies of the direct sums
+*/
+float xc_norm(double num,double en2,double en3)
+{
+int i2 = 0;
+int i3 = 0;
+float fac = 1.0;
+float sum1 = SMALL + num;
+float sum2 = SMALL + en2;
+float sum3 = SMALL + en3;
+float smin = 1.0e-10;
 
-if(shead1.dt != shead2.dt)
+if(sum2 == 0.0 || sum3 == 0.0)
+   return(-1.0);
+
+while(sum2 <= smin)  /* for very low sum2,sum3 adjust to prevent underflow */
    {
-   fprintf(stderr,"dt1 not equal to dt2, exiting...\n");
-   exit(-1);
+   sum2 = sum2/smin;
+   i2++;
    }
-else
-   dt = shead1.dt;
+while(sum3 <= smin)
+   {
+   sum3 = sum3/smin;
+   i3++;
+   }
+
+if(i2 || i3)
+   fac = 1.0/sqrt((i2+i3)*smin);
+
+return((fac*sum1)/sqrt(sum2*sum3));
+}
+
+/*
+   Correlation sums r[l] = sum_j s1[l+lb+j]*s2[j], l = 0 ... nl-1, by
+   overlap-save: s2 in blocks of nl samples, each against the nl+nl
+   samples of s1 it reaches, with FFTs of length getnt_fft(2*nl).
+*/
+void xc_sums_blocks(struct xctrace *t1,struct xctrace *t2,int lb,int nl,double *r)
+{
+double *x1, *x2, re, im;
+int nfft, nb, j0, i, j, k;
+
+nfft = getnt_fft(2*nl);
+x1 = (double *) check_malloc((nfft+2)*sizeof(double));
+x2 = (double *) check_malloc((nfft+2)*sizeof(double));
+
+for(i=0;i<nl;i++)
+   r[i] = 0.0;
 
-if(shead1.nt < shead2.nt)
-   nt = shead2.nt;
+for(j0=0;j0<t2->hd.nt;j0=j0+nl)
+   {
+   nb = nl;
+   if(j0 + nb > t2->hd.nt)
+      nb = t2->hd.nt - j0;
+
+   for(i=0;i<nfft+2;i++)
+      x1[i] = x2[i] = 0.0;
+   for(i=0;i<nb;i++)
+      x2[i] = t2->s[j0+i];
+   for(i=0;i<nl+nb;i++)
+      {
+      j = lb + j0 + i;
+      if(j >= 0 && j < t1->hd.nt)
+         x1[i] = t1->s[j];
+      }
+
+   drfft_r2c(x1,nfft,-1);
+   drfft_r2c(x2,nfft,-1);
+   for(k=0;k<=nfft/2;k++)
+      {
+      re = x1[2*k]*x2[2*k] + x1[2*k+1]*x2[2*k+1];
+      im = x1[2*k+1]*x2[2*k] - x1[2*k]*x2[2*k+1];
+      x1[2*k] = re;
+      x1[2*k+1] = im;
+      }
+   drfft_c2r(x1,nfft,1);
+
+   for(i=0;i<nl;i++)
+      r[i] = r[i] + x1[i]/nfft;
+   }
+
+free(x1);
+free(x2);
+}
+
+/*
+   cc[it], it = ilo ... ihi-1 (of 0 ... 2*nt-1), of t2 shifted by
+   it-nt samples against t1; cc is -1 elsewhere.  With both spectra
+   (of length nfft >= 2*nt) the sums come from one inverse FFT.
+*/
+void xcor(struct xctrace *t1,struct xctrace *t2,int nt,int nfft,float *cc,int ilo,int ihi)
+{
+double *x, *r, en2, en3, re, im;
+int it, k, l, j, jb, je;
+
+for(it=0;it<2*nt;it++)
+   cc[it] = -1.0;
+if(ilo < 0)
+   ilo = 0;
+if(ihi > 2*nt)
+   ihi = 2*nt;
+if(ihi <= ilo)
+   return;
+
+r = (double *) check_malloc((ihi-ilo)*sizeof(double));
+
+if(t1->spec != NULL && t2->spec != NULL)
+   {
+   x = (double *) check_malloc((nfft+2)*sizeof(double));
+   for(k=0;k<=nfft/2;k++)
+      {
+      re = t1->spec[2*k];
+      im = t1->spec[2*k+1];
+      x[2*k] = re*t2->spec[2*k] + im*t2->spec[2*k+1];
+      x[2*k+1] = im*t2->spec[2*k] - re*t2->spec[2*k+1];
+      }
+   drfft_c2r(x,nfft,1);
+
+   for(it=ilo;it<ihi;it++)
+      {
+      l = it - nt;
+      if(l < 0)
+         l = l + nfft;
+      r[it-ilo] = x[l]/nfft;
+      }
+   free(x);
+   }
 else
-   nt = shead1.nt;
+   xc_sums_blocks(t1,t2,ilo-nt,ihi-ilo,r);
+
+/*
+   at the ends, where the traces hardly overlap, the sums are small
+   next to the rounding of the FFTs and are done directly
+*/
+for(it=ilo;it<ihi;it++)
+   {
+   l = it - nt;
+   jb = (l < 0) ? -l : 0;
+   je = t1->hd.nt - l;
+   if(je > t2->hd.nt)
+      je = t2->hd.nt;
+   if(je - jb > NDIRECT)
+      continue;
+
+   r[it-ilo] = 0.0;
+   for(j=jb;j<je;j++)
+      r[it-ilo] = r[it-ilo] + (double)(t1->s[l+j])*(double)(t2->s[j]);
+   }
+
+en3 = xc_energy(t2,0,t2->hd.nt);
+for(it=ilo;it<ihi;it++)
+   {
+   en2 = xc_energy(t1,it-nt,it);
+   cc[it] = xc_norm(r[it-ilo],en2,en3);
+   }
+
+free(r);
+}
 
-p1 = (float *) check_malloc (3*nt*size_float);
-p2 = (float *) check_malloc (nt*size_float);
+int maxcctime(float *cc,int nt,float t1,float t2,float dt,float tw)
+{
+int it, itx, its, ite;
+float max = -10.0;
 
-for(i=0;i<nt;i++)
-   p1[i] = p1[i+2*nt] = 0.0;
-for(i=0;i<shead1.nt;i++)
-   p1[i+nt] = s1[i];
-for(i=shead1.nt;i<nt;i++)
-   p1[i+nt] = 0.0;
+its = nt + (t2 - t1 - tw)/dt;
+if(its < 0)
+   its = 0;
+
+ite = nt + (t2 - t1 + tw)/dt;
+if(ite > 2*nt)
+   ite = 2*nt;
+
+itx = its;
+for(it=its;it<ite;it++)
+   {
+   if(cc[it] > max)
+      {
+      max = cc[it];
+      itx = it;
+      }
+   }
+return(itx);
+}
 
-for(i=0;i<shead2.nt;i++)
-   p2[i] = s2[i];
-for(i=shead2.nt;i<nt;i++)
-   p2[i] = 0.0;
+/* shifts nt + (t2 - t1 - tdel)/dt, it in [ilo,ihi), the output needs */
+void xc_range(struct xcopt *op,int nt,float time1,float time2,float dt,float twin,int *ilo,int *ihi)
+{
+int is, ie;
 
+*ilo = 2*nt;
+*ihi = 0;
+if(op->printmax)
+   {
+   is = nt + (time2 - time1 - twin)/dt;
+   ie = nt + (time2 - time1 + twin)/dt;
+   if(is < *ilo) *ilo = is;
+   if(ie > *ihi) *ihi = ie;
+   }
+if(op->tval > -1.0e+10)
+   {
+   is = nt + (time2 - time1 - op->tval)/dt;
+   if(is < *ilo) *ilo = is;
+   if(is+1 > *ihi) *ihi = is+1;
+   }
+if(op->printall)
+   {
+   is = 0;
+   ie = 2*nt;
+   if(op->tval > -1.0e+10 && twin > 0)
+      {
+      is = nt + (time2 - time1 - op->tval - twin)/dt;
+      ie = nt + (time2 - time1 - op->tval + twin)/dt;
+      }
+   if(is < *ilo) *ilo = is;
+   if(ie > *ihi) *ihi = ie;
+   }
+
+if(*ilo < 0)
+   *ilo = 0;
+if(*ihi > 2*nt)
+   *ihi = 2*nt;
+}
+
+/*
+   Correlation of one pair, output into a string allocated here (with
+   the prefix pre on each line); nfft > 0 when the traces come with
+   their spectra of that length.
+*/
+char *xc_pair(struct xctrace *t1,struct xctrace *t2,struct xcopt *op,int nfft,char *pre)
+{
+struct xctrace a, b;
+float dt, time1, time2, twin, tdel, *cc;
+int i, nt, itcc, istr, iend, ilo, ihi, own;
+size_t nc;
+char *out, *po;
+
+time1 = t1->hd.hr*3600 + t1->hd.min*60 + t1->hd.sec;
+time2 = t2->hd.hr*3600 + t2->hd.min*60 + t2->hd.sec;
+
+if(t1->hd.dt != t2->hd.dt)
+   {
+   fprintf(stderr,"dt1 not equal to dt2, exiting...\n");
+   exit(-1);
+   }
+else
+   dt = t1->hd.dt;
+
+if(t1->hd.nt < t2->hd.nt)
+   nt = t2->hd.nt;
+else
+   nt = t1->hd.nt;
+
+twin = op->twin;
 if(twin < 0.0)
    twin = 2*nt*dt;
 
+xc_range(op,nt,time1,time2,dt,twin,&ilo,&ihi);
+
 cc = (float *) check_malloc (2*nt*size_float);
 
-xcor(p1,p2,nt,cc);
+/* a narrow band of shifts: overlap-save blocks, not the spectra */
+a = *t1;
+b = *t2;
+own = 0;
+if(4*(ihi-ilo) < nt)
+   {
+   a.spec = b.spec = NULL;
+   nfft = 0;
+   }
+else if(nfft <= 0 || a.spec == NULL || b.spec == NULL)
+   {
+   nfft = getnt_fft(2*nt);
+   xc_spec(&a,nfft);
+   xc_spec(&b,nfft);
+   own = 1;
+   }
+
+xcor(&a,&b,nt,nfft,cc,ilo,ihi);
 
-if(printmax)
+if(own)
    {
-   itcc = maxcctime(cc,nt,&time1,&time2,&dt,&twin);
+   free(a.spec);
+   free(b.spec);
+   }
+
+nc = 128 + strlen(pre);
+if(op->printall)
+   nc = nc*(2*nt+3);
+else
+   nc = nc*3;
+out = (char *) check_malloc(nc);
+po = out;
+po[0] = '\0';
+
+if(op->printmax)
+   {
+   itcc = maxcctime(cc,nt,time1,time2,dt,twin);
    tdel = time2 - time1 - (itcc-nt)*dt;
 
-   printf("cc= %13.5e t= %13.8f\n",cc[itcc],tdel);
+   po = po + sprintf(po,"%scc= %13.5e t= %13.8f\n",pre,cc[itcc],tdel);
    }
 
-if(tval > -1.0e+10)
+if(op->tval > -1.0e+10)
    {
-   itcc = nt + (time2 - time1 - tval)/dt;
+   itcc = nt + (time2 - time1 - op->tval)/dt;
 
-   printf("cc= %13.5e t= %13.8f\n",cc[itcc],tval);
+   if(itcc >= 0 && itcc < 2*nt)
+      po = po + sprintf(po,"%scc= %13.5e t= %13.8f\n",pre,cc[itcc],op->tval);
    }
 
-if(printall)
+if(op->printall)
    {
    istr = 0;
    iend = 2*nt;
-   if(tval > -1.0e+10 && twin > 0)
+   if(op->tval > -1.0e+10 && twin > 0)
       {
-      istr = nt + (time2 - time1 - tval - twin)/dt;
-      iend = nt + (time2 - time1 - tval + twin)/dt;
+      istr = nt + (time2 - time1 - op->tval - twin)/dt;
+      iend = nt + (time2 - time1 - op->tval + twin)/dt;
+      if(istr < 0)
+         istr = 0;
+      if(iend > 2*nt)
+         iend = 2*nt;
       }
    for(i=istr;i<iend;i++)
-      printf("t= %f cc= %13.5e\n",time2 - time1 - (i-nt)*dt,cc[i]);
+      po = po + sprintf(po,"%st= %f cc= %13.5e\n",pre,time2 - time1 - (i-nt)*dt,cc[i]);
    }
+
+free(cc);
+return(out);
 }
 
-xcor(s1,s2,nt,cc)
-float *s1, *s2, *cc;
-int nt;
+int main(int ac,char **av)
 {
-float *s1ptr;
-float zap = 0.0;
-int it;
+struct xctrace *tr, tref;
+struct xcopt op;
+char infile1[512], infile2[512], filelist[512], str[1024], *line;
+char **out, pre[1100];
+int i, j, k, ntr, npair, nfft, ntmax, *pa, *pb;
+FILE *fpr;
 
-for(it=0;it<2*nt;it++)
-   cc[it] = zap;
+int inbin1 = 0;
+int inbin2 = 0;
+int nthreads = 1;
 
-for(it=0;it<2*nt;it++)
+op.twin = -99.9;
+op.printmax = 1;
+op.printall = 0;
+op.tval = -1.0e+15;
+
+infile1[0] = '\0';
+infile2[0] = '\0';
+filelist[0] = '\0';
+
+setpar(ac,av);
+getpar("infile1","s",infile1);
+getpar("infile2","s",infile2);
+getpar("filelist","s",filelist);
+getpar("inbin1","d",&inbin1);
+getpar("inbin2","d",&inbin2);
+getpar("twin","f",&op.twin);
+getpar("tval","f",&op.tval);
+getpar("printmax","d",&op.printmax);
+getpar("printall","d",&op.printall);
+getpar("nthreads","d",&nthreads);
+endpar();
+
+if(filelist[0] == '\0')
    {
-   s1ptr = s1 + it;
-   cor(s1ptr,s2,nt,&cc[it],1);
+   if(infile1[0] == '\0' || infile2[0] == '\0')
+      {
+      fprintf(stderr,"infile1= and infile2= (or filelist=) needed, exiting...\n");
+      exit(-1);
+      }
+
+   tr = (struct xctrace *) check_malloc(2*sizeof(struct xctrace));
+   xc_load(infile1,inbin1,&tr[0]);
+   xc_load(infile2,inbin2,&tr[1]);
+
+   fputs(xc_pair(&tr[0],&tr[1],&op,0,""),stdout);
+   exit(0);
    }
-}
 
-cor(s1,s2,span,p,it)
-float *s1, *s2, *p;
-int span, it;
-{
-int i;
-int i2 = 0;
-int i3 = 0;
-float fac = 1.0;
-float sum1 = SMALL;
-float sum2 = SMALL;
-float sum3 = SMALL;
-float smin = 1.0e-10;
+/* the traces of the list, all in memory */
 
-for(i=0;i<span;i=i+it)
+tr = (struct xctrace *) check_malloc(MAXFILES*sizeof(struct xctrace));
+ntr = 0;
+line = (char *) check_malloc(1024);
+fpr = fopfile(filelist,"r");
+while(fgets(line,1024,fpr) != NULL && ntr < MAXFILES)
    {
-   sum1 = sum1 + s1[i]*s2[i];
-   sum2 = sum2 + s1[i]*s1[i];
-   sum3 = sum3 + s2[i]*s2[i];
+   if(sscanf(line,"%1023s",str) != 1)
+      continue;
+
+   tr[ntr].name = (char *) check_malloc(strlen(str)+1);
+   strcpy(tr[ntr].name,str);
+   ntr++;
    }
+fclose(fpr);
+free(line);
 
-if(sum2 == 0.0 || sum3 == 0.0)
-   *p = -1.0;
-else
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic,1)
+for(i=0;i<ntr;i++)
+   xc_load(tr[i].name,inbin2,&tr[i]);
+
+ntmax = 0;
+for(i=0;i<ntr;i++)
    {
-   while(sum2 <= smin)  /* for very low sum2,sum3 adjust to prevent underflow */      {  
-      sum2 = sum2/smin;
-      i2++;
-      }    
-   while(sum3 <= smin)
-      {  
-      sum3 = sum3/smin;
-      i3++;
-      }    
+   if(tr[i].hd.nt > ntmax)
+      ntmax = tr[i].hd.nt;
+   }
 
-   if(i2 || i3)
-      fac = 1.0/sqrt((i2+i3)*smin);
+if(infile1[0] != '\0')
+   {
+   xc_load(infile1,inbin1,&tref);
+   if(tref.hd.nt > ntmax)
+      ntmax = tref.hd.nt;
+   npair = ntr;
+   }
+else
+   npair = ntr*(ntr-1)/2;
 
-   *p = (fac*sum1)/sqrt(sum2*sum3);
+pa = (int *) check_malloc((npair+1)*size_int);
+pb = (int *) check_malloc((npair+1)*size_int);
+k = 0;
+for(i=0;i<ntr;i++)
+   {
+   if(infile1[0] != '\0')
+      {
+      pa[k] = -1;
+      pb[k] = i;
+      k++;
+      }
+   else
+      {
+      for(j=i+1;j<ntr;j++)
+         {
+         pa[k] = i;
+         pb[k] = j;
+         k++;
+         }
+      }
    }
-}
 
-maxcctime(cc,nt,t1,t2,dt,tw)
-float *cc, *t1, *t2, *dt, *tw;
-int nt;
-{
-int it, itx, its, ite;
-float max = -10.0;
+/*
+   one FFT length long enough for every pair, so each spectrum is done
+   once; not needed when all there is to find is in a narrow band
+*/
+nfft = getnt_fft(2*ntmax);
+if(!op.printall && op.tval < -1.0e+10 && op.twin >= 0.0 && 8*op.twin/tr[0].hd.dt < ntmax)
+   nfft = 0;
 
-its = nt + ((*t2) - (*t1) - (*tw))/(*dt);
-if(its < 0)
-   its = 0;
+if(nfft > 0)
+   {
+   if(infile1[0] != '\0')
+      xc_spec(&tref,nfft);
 
-ite = nt + ((*t2) - (*t1) + (*tw))/(*dt);
-if(ite > 2*nt)
-   ite = 2*nt;
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic,1)
+   for(i=0;i<ntr;i++)
+      xc_spec(&tr[i],nfft);
+   }
 
-for(it=its;it<ite;it++)
+out = (char **) check_malloc((npair+1)*sizeof(char *));
+
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic,1) private(pre)
+for(k=0;k<npair;k++)
    {
-   if(cc[it] > max)
-      {  
-      max = cc[it];
-      itx = it;
-      }  
-   }   
-return(itx);
+   struct xctrace *t1 = (pa[k] < 0) ? &tref : &tr[pa[k]];
+   struct xctrace *t2 = &tr[pb[k]];
+
+   sprintf(pre,"%s %s ",t1->name,t2->name);
+   out[k] = xc_pair(t1,t2,&op,nfft,pre);
+   }
+
+for(k=0;k<npair;k++)
+   fputs(out[k],stdout);
+
+exit(0);
 }
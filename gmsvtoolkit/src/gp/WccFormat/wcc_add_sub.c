@@ -3,6 +3,12 @@
 #include "function.h"
 #include "getpar.h"
 
+/* fractional shifts closer than this to a whole sample are not done */
+#define FSHIFT_EPS 1.0e-04
+
+/* add_rand draws are split over the threads in blocks of this size */
+#define RAND_BLOCK 4096
+
 double frand(void);
 double sfrand(long *);
 
@@ -100,28 +106,213 @@ return((double)(*seed)/1073741824.0 - 1.0);
 }
 
 void wcc_add(int param_string_len, char** param_string, float* s1, struct statdata* shead1, float* s2, struct statdata* shead2, float* p, struct statdata* shead3) {
+	gp_ctx *gp;
 	float f1 = 1.0;
 	float f2 = 1.0;
 
 	float t1 = 0.0;
 	float t2 = 0.0;
 
-	int it;
+	int it, ib, nb;
+	long state;
 	float add_rand = 0.0;
 
-	setpar(param_string_len,param_string);
-	getpar("f1","f",&f1);
-	getpar("t1","f",&t1);
-	getpar("f2","f",&f2);
-	getpar("t2","f",&t2);
-	getpar("add_rand","f",&add_rand);
-	endpar();
+	gp = gp_setpar(param_string_len,param_string);
+	gp_getpar(gp,"f1","f",&f1);
+	gp_getpar(gp,"t1","f",&t1);
+	gp_getpar(gp,"f2","f",&f2);
+	gp_getpar(gp,"t2","f",&t2);
+	gp_getpar(gp,"add_rand","f",&add_rand);
+	gp_endpar(gp);
 
 	sum(s1,shead1,&f1,&t1,s2,shead2,&f2,&t2,p,shead3);
 
+	/*
+	   the frand() stream, each block starting where the serial loop
+	   would be, so the noise is the same at any thread count
+	*/
 	if(add_rand > (float)(0.0))
 	   {
-	   for(it=0;it<shead3->nt;it++)
-	      p[it] = p[it] + add_rand*frand();
+	   nb = (shead3->nt + RAND_BLOCK - 1)/RAND_BLOCK;
+#pragma omp parallel for schedule(static) private(it,state)
+	   for(ib=0;ib<nb;ib++)
+	      {
+	      state = crand_lcg_skip(frandx,(long long)(ib)*RAND_BLOCK);
+	      for(it=ib*RAND_BLOCK;it<shead3->nt && it<(ib+1)*RAND_BLOCK;it++)
+	         p[it] = p[it] + add_rand*crand_lcg(&state);
+	      }
+	   frandx = crand_lcg_skip(frandx,shead3->nt);
+	   }
+}
+
+/* y = y + a*x, n samples, vectorized for the CPU (SIMD_CLONES) */
+SIMD_CLONES void wcc_axpy(float a, float *x, float *y, int n) {
+	int i;
+
+	for(i=0;i<n;i++)
+	   y[i] = y[i] + a*x[i];
+}
+
+/*
+	s[0..nt-1] delayed by frac (0 < frac < 1) samples, by the phase
+	ramp of its spectrum, into w[0..nt]; w is space for nfft+2 floats,
+	nfft >= nt+1 (getnt_fftpad(nt+1) keeps the wrap-around small)
+*/
+void wcc_fshift(float *s, int nt, float frac, float *w, int nfft) {
+	double c, sn, c1, s1, tc, arg;
+	float re, fac;
+	int i;
+
+	for(i=0;i<nt;i++)
+	   w[i] = s[i];
+	for(;i<nfft+2;i++)
+	   w[i] = 0.0;
+
+	rfft_r2c(w,nfft,-1);
+
+	arg = -2.0*M_PI*frac/nfft;
+	c1 = cos(arg);
+	s1 = sin(arg);
+	c = 1.0;
+	sn = 0.0;
+	fac = 1.0/nfft;
+	for(i=0;i<nfft/2;i++)
+	   {
+	   re = fac*(w[2*i]*c - w[2*i+1]*sn);
+	   w[2*i+1] = fac*(w[2*i]*sn + w[2*i+1]*c);
+	   w[2*i] = re;
+
+	   tc = c*c1 - sn*s1;
+	   sn = sn*c1 + c*s1;
+	   c = tc;
 	   }
+	/* Nyquist: only the real part of the ramp keeps the trace real */
+	w[nfft] = fac*w[nfft]*cos(M_PI*frac);
+	w[nfft+1] = 0.0;
+
+	rfft_c2r(w,nfft,1);
+}
+
+/*
+	Sum of the nterm traces tm[i].scale*tm[i].s, tm[i].s starting at
+	time tm[i].t, into a new trace (returned) starting at the earliest
+	of the tm[i].t; its start, nt and dt go into hd.  Shifts are to the
+	nearest sample, as wcc_add does them, or with fshift=1 to the exact
+	time, the fraction of a sample by wcc_fshift().  The terms are dealt
+	out in nthreads contiguous groups, each summed into its own trace,
+	and these are then added in order, so the result does not depend
+	on the scheduling.
+*/
+float *wcc_gfsum(struct gfterm *tm, int nterm, int fshift, int nthreads, struct statdata *hd) {
+	float **acc, *p;
+	double t0, x;
+	int *k0, i, ig, ng, nout, nfmax;
+	float *frac;
+
+	if(nterm < 1)
+	   return(NULL);
+
+	if(nthreads < 1)
+	   nthreads = 1;
+	ng = nthreads;
+	if(ng > nterm)
+	   ng = nterm;
+
+	t0 = tm[0].t;
+	for(i=0;i<nterm;i++)
+	   {
+	   if(tm[i].dt != tm[0].dt)
+	      {
+	      fprintf(stderr,"*** dt of term %d not equal to dt of term 0, exiting...\n",i);
+	      exit(-1);
+	      }
+	   if(tm[i].t < t0)
+	      t0 = tm[i].t;
+	   }
+
+	/* where each term goes: whole samples k0 and the fraction left */
+	k0 = (int *) check_malloc(nterm*sizeof(int));
+	frac = (float *) check_malloc(nterm*sizeof(float));
+	nout = 0;
+	nfmax = 0;
+	for(i=0;i<nterm;i++)
+	   {
+	   x = (tm[i].t - t0)/tm[i].dt;
+	   if(fshift)
+	      {
+	      k0[i] = (int)(floor(x));
+	      frac[i] = x - k0[i];
+	      if(frac[i] > 1.0 - FSHIFT_EPS)
+	         {
+	         k0[i]++;
+	         frac[i] = 0.0;
+	         }
+	      else if(frac[i] < FSHIFT_EPS)
+	         frac[i] = 0.0;
+	      }
+	   else
+	      {
+	      k0[i] = (int)(x + 0.5);
+	      frac[i] = 0.0;
+	      }
+
+	   if(k0[i] + tm[i].nt + (frac[i] > 0.0) > nout)
+	      nout = k0[i] + tm[i].nt + (frac[i] > 0.0);
+	   if(frac[i] > 0.0 && tm[i].nt > nfmax)
+	      nfmax = tm[i].nt;
+	   }
+
+	acc = (float **) check_malloc(ng*sizeof(float *));
+
+#pragma omp parallel for num_threads(ng) schedule(static,1) private(i)
+	for(ig=0;ig<ng;ig++)
+	   {
+	   float *w = NULL;
+	   int nfft;
+
+	   acc[ig] = (float *) check_malloc(nout*sizeof(float));
+	   for(i=0;i<nout;i++)
+	      acc[ig][i] = 0.0;
+
+	   if(nfmax > 0)
+	      w = (float *) check_malloc((getnt_fftpad(nfmax+1)+2)*sizeof(float));
+
+	   for(i=(int)(((long long)(ig)*nterm)/ng);i<(int)(((long long)(ig+1)*nterm)/ng);i++)
+	      {
+	      if(frac[i] > 0.0)
+	         {
+	         nfft = getnt_fftpad(tm[i].nt+1);
+	         wcc_fshift(tm[i].s,tm[i].nt,frac[i],w,nfft);
+	         wcc_axpy(tm[i].scale,w,acc[ig]+k0[i],tm[i].nt+1);
+	         }
+	      else
+	         wcc_axpy(tm[i].scale,tm[i].s,acc[ig]+k0[i],tm[i].nt);
+	      }
+	   free(w);
+	   }
+
+	/* the group sums, added in order, a block of samples per thread */
+	p = acc[0];
+#pragma omp parallel for num_threads(nthreads) schedule(static) private(ig)
+	for(i=0;i<nout;i=i+4096)
+	   {
+	   int n = (nout - i < 4096) ? nout - i : 4096;
+
+	   for(ig=1;ig<ng;ig++)
+	      wcc_axpy(1.0,acc[ig]+i,p+i,n);
+	   }
+
+	for(ig=1;ig<ng;ig++)
+	   free(acc[ig]);
+	free(acc);
+	free(k0);
+	free(frac);
+
+	hd->nt = nout;
+	hd->dt = tm[0].dt;
+	hd->hr = (int)(t0/3600.0);
+	hd->min = (int)((t0 - 3600.0*hd->hr)/60.0);
+	hd->sec = (float)(t0 - 60.0*hd->min - 3600.0*hd->hr);
+
+	return(p);
 }
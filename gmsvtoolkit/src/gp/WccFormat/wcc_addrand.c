@@ -1,17 +1,28 @@
 #include "include.h"
 #include "structure.h"
 #include "function.h"
+#include "getpar.h"
 
-double frand(void);
-double sfrand(long *);
+/* the draws are split over the threads in blocks of this size */
+#define RAND_BLOCK 4096
 
 int size_float = sizeof(float);
 int size_int = sizeof(int);
 
-main(int ac,char **av)
+/*
+   Adds add_rand times uniform (-1,1) noise to a trace.
+
+   rng=0 (default) is the frand() stream of seed (1 as it always was),
+   rng=1 the counter-based stream (crand_philox) of seed.  Either way
+   the noise only depends on seed, not on the number of threads.
+*/
+
+int main(int ac,char **av)
 {
 struct statdata shead1;
 float *s1;
+long state;
+int ib, nb;
 
 char infile[128];
 char outfile[128];
@@ -21,6 +32,8 @@ int outbin = 0;
 
 int it;
 float add_rand = 0.0;
+int seed = 1;
+int rng = 0;
 
 setpar(ac,av);
 mstpar("infile","s",infile);
@@ -28,36 +41,30 @@ mstpar("outfile","s",outfile);
 getpar("inbin","d",&inbin);
 getpar("outbin","d",&outbin);
 mstpar("add_rand","f",&add_rand);
+getpar("seed","d",&seed);
+getpar("rng","d",&rng);
 endpar();
 
 s1 = NULL;
 s1 = read_wccseis(infile,&shead1,s1,inbin);
 
-if(add_rand > (float)(0.0))
+if(add_rand > (float)(0.0) && rng == 1)
    {
+#pragma omp parallel for schedule(static)
    for(it=0;it<shead1.nt;it++)
-      s1[it] = s1[it] + add_rand*frand();
+      s1[it] = s1[it] + add_rand*crand_philox(seed,(long long)(it));
+   }
+else if(add_rand > (float)(0.0))
+   {
+   nb = (shead1.nt + RAND_BLOCK - 1)/RAND_BLOCK;
+#pragma omp parallel for schedule(static) private(it,state)
+   for(ib=0;ib<nb;ib++)
+      {
+      state = crand_lcg_skip(seed,(long long)(ib)*RAND_BLOCK);
+      for(it=ib*RAND_BLOCK;it<shead1.nt && it<(ib+1)*RAND_BLOCK;it++)
+         s1[it] = s1[it] + add_rand*crand_lcg(&state);
+      }
    }
 
 write_wccseis(outfile,&shead1,s1,outbin);
 }
-
-static  long    frandx = 1;
-
-/* frand() returns a uniform distribution of random numbers
- * in the range -1.0 -> 1.0.
- */
-double frand(void)
-{
-frandx = (frandx * 1103515245 + 12345) & 0x7fffffff;
-return((double)(frandx)/1073741824.0 - 1.0);
-}
-
-/* sfrand() returns a uniform distribution of random numbers
- * in the range -1.0 -> 1.0.
- */
-double sfrand(long *seed)
-{
-*seed = ((*seed) * 1103515245 + 12345) & 0x7fffffff;
-return((double)(*seed)/1073741824.0 - 1.0);
-}
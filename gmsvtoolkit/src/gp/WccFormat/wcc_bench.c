@@ -0,0 +1,365 @@
+/**********************************************************************/
+/*                                                                    */
+/*           wcc_bench                                                */
+/*                                                                    */
+/*           Times the WccFormat kernels on synthetic traces of       */
+/*           nt_min= (default 1024) to nt_max= (default 4194304)      */
+/*           samples, nt growing by nt_fac= (default 4).  Each        */
+/*           kernel is repeated until min_time= seconds (default      */
+/*           0.2) have passed and the time of a call is reported as   */
+/*           ns per sample and GB/s of samples read and written.      */
+/*                                                                    */
+/*           kernel= is a comma list (default all) of                 */
+/*                                                                    */
+/*              cfft       complex FFT of the next power of 2         */
+/*              forfft     real FFT (packed) of the next power of 2   */
+/*              rfft       rfft_r2c + rfft_c2r of getnt_fftpad(nt)    */
+/*              tfilter    wcc_tfilter cascade, hp+lp, order=4        */
+/*              sosfilter  the same filter as sos=1                   */
+/*              resamp     wcc_resamp_arbdt to dt/2                   */
+/*              integrate  integ_diff's integrate()                   */
+/*              baseline   integ_diff's baseline(), order 3           */
+/*              cb2014     cb2014_ampf on the getnt_fftpad(nt)        */
+/*                         point spectrum                             */
+/*                                                                    */
+/*           One JSON object per kernel and nt is written per line    */
+/*           to outfile= (default stdout), e.g.                       */
+/*                                                                    */
+/*              {"kernel": "cfft", "nt": 1024, "n": 1024,             */
+/*               "reps": 4321, "ns_per_sample": 3.1,                  */
+/*               "gb_per_s": 10.2}                                    */
+/*                                                                    */
+/*           The kernels work on a fresh copy of the trace each       */
+/*           call; the time of the copy is measured apart and taken   */
+/*           off.  The trace is a deterministic synthetic record      */
+/*           (seed=, default 1): white noise smoothed and shaped by   */
+/*           a rise-and-decay envelope, dt= (default 0.01).  The      */
+/*           kernels' messages on stderr are discarded while timing.  */
+/*                                                                    */
+/*           make bench builds this and writes bench.json.            */
+/*                                                                    */
+/**********************************************************************/
+
+#include        "include.h"
+#include        "structure.h"
+#include        "function.h"
+#include        "getpar.h"
+#include        "fftw3.h"
+
+void integrate(float *, int, float *, float *);
+void baseline(float *, int, float *, int);
+void zero(float *, int);
+void cb2014_ampf(float *,float *,int,float *,float *,float *,float *,float *,float *,float *,float *,float *,float *,float *);
+
+#define         NKERNEL         9
+
+static char *kernel_name[NKERNEL] = { "cfft", "forfft", "rfft", "tfilter",
+   "sosfilter", "resamp", "integrate", "baseline", "cb2014" };
+
+struct bench_ctx
+   {
+   int nt;
+   float dt;
+   float *trace;        /* the synthetic trace, nt samples */
+   float *s;            /* work trace, FFT aligned */
+   float *r;            /* work trace of resamp, which reallocs it */
+   struct statdata shead;
+   struct complex *c;
+   struct tfilter_par tp, tps;
+   struct resamp_arbdt_par rp;
+   struct siteamp14_par sp;
+   };
+
+static double bench_clock()
+{
+struct timespec ts;
+
+clock_gettime(CLOCK_MONOTONIC,&ts);
+return(ts.tv_sec + 1.0e-09*ts.tv_nsec);
+}
+
+/* noise smoothed by two one-pole passes, times t^2 exp(-t/tau) */
+void synth_trace(float *s,int nt,float dt,unsigned int seed)
+{
+double t, tau, env, emax, x, y1, y2, a;
+unsigned int r;
+int i;
+
+tau = 0.1*nt*dt;
+emax = 4.0*tau*tau*exp(-2.0);
+a = 0.7;
+r = seed;
+y1 = y2 = 0.0;
+for(i=0;i<nt;i++)
+   {
+   r = 1664525u*r + 1013904223u;
+   x = (r >> 8)*(1.0/16777216.0) - 0.5;
+   y1 = a*y1 + (1.0 - a)*x;
+   y2 = a*y2 + (1.0 - a)*y1;
+
+   t = i*dt;
+   env = t*t*exp(-t/tau)/emax;
+   s[i] = 100.0*env*y2;
+   }
+}
+
+static int next_p2(int n)
+{
+int p = 2;
+
+while(p < n)
+   p = 2*p;
+return(p);
+}
+
+/* length the kernel works on and the bytes moved per call */
+static int kernel_size(int k,int nt,double *bytes)
+{
+int n;
+
+n = nt;
+if(k == 0)
+   {
+   n = next_p2(nt);
+   *bytes = 2.0*n*sizeof(struct complex);
+   }
+else if(k == 1)
+   {
+   n = next_p2(nt);
+   *bytes = 2.0*n*sizeof(float);
+   }
+else if(k == 2 || k == 8)
+   {
+   n = getnt_fftpad(nt);
+   *bytes = (k == 2) ? 4.0*(n+2)*sizeof(float) : (n/2)*sizeof(float);
+   }
+else if(k == 5)
+   *bytes = 3.0*nt*sizeof(float);
+else
+   *bytes = 2.0*nt*sizeof(float);
+return(n);
+}
+
+/* loads the work arrays for kernel k; this part is timed as the copy */
+static void kernel_load(struct bench_ctx *bc,int k,int n)
+{
+int i;
+
+if(k == 0)
+   {
+   for(i=0;i<bc->nt;i++)
+      {
+      bc->c[i].re = bc->trace[i];
+      bc->c[i].im = 0.0;
+      }
+   czero(bc->c+bc->nt,n-bc->nt);
+   }
+else
+   {
+   memcpy(bc->s,bc->trace,bc->nt*sizeof(float));
+   if(n > bc->nt && k != 8)
+      zero(bc->s+bc->nt,n-bc->nt);
+   }
+if(k == 5)
+   memcpy(bc->r,bc->trace,bc->nt*sizeof(float));
+bc->shead.nt = bc->nt;
+bc->shead.dt = bc->dt;
+}
+
+static void kernel_run(struct bench_ctx *bc,int k,int n)
+{
+float iv = 0.0;
+float vref = 865.0;
+float vsite = 400.0;
+float vpga = 865.0;
+float pga = 0.3;
+
+switch(k)
+   {
+   case 0: cfft(bc->c,n,-1);
+      break;
+   case 1: forfft((struct complex *)bc->s,n,-1);
+      break;
+   case 2: rfft_r2c(bc->s,n,-1);
+      rfft_c2r(bc->s,n,1);
+      break;
+   case 3: wcc_tfilter_apply(&bc->tp,bc->s,&bc->shead);
+      break;
+   case 4: wcc_tfilter_apply(&bc->tps,bc->s,&bc->shead);
+      break;
+   case 5: wcc_resamp_arbdt_apply(&bc->rp,&bc->r,&bc->shead);
+      break;
+   case 6: integrate(bc->s,bc->nt,&bc->dt,&iv);
+      break;
+   case 7: baseline(bc->s,bc->nt,&bc->dt,3);
+      break;
+   case 8: cb2014_ampf(bc->s,&bc->dt,n,&vref,&vsite,&vpga,&pga,&bc->sp.fmin,&bc->sp.fmidbot,
+              &bc->sp.fmid,&bc->sp.fhigh,&bc->sp.fhightop,&bc->sp.fmax,&bc->sp.flowcap);
+      break;
+   }
+}
+
+/* seconds per call of kernel k (run 1) or of its load only (run 0) */
+static double kernel_time(struct bench_ctx *bc,int k,int n,int run,double min_time,int *reps)
+{
+double t0, t;
+int i, nrep;
+
+nrep = 1;
+while(1)
+   {
+   t0 = bench_clock();
+   for(i=0;i<nrep;i++)
+      {
+      kernel_load(bc,k,n);
+      if(run)
+         kernel_run(bc,k,n);
+      }
+   t = bench_clock() - t0;
+
+   if(t >= min_time || nrep >= (1 << 30))
+      break;
+   if(t < 0.01*min_time)
+      nrep = 10*nrep;
+   else
+      nrep = (int)(1.2*nrep*min_time/t) + 1;
+   }
+
+*reps = nrep;
+return(t/nrep);
+}
+
+int main(int ac,char **av)
+{
+FILE *fpw;
+struct bench_ctx bc;
+double t, tcopy, bytes, ns;
+char *sptr, *tf_av[4], *tfs_av[5], *rp_av[2], newdt[64];
+int k, n, nt, reps, nreps, fd2, dev0, use[NKERNEL];
+
+int nt_min = 1024;
+int nt_max = 4194304;
+int nt_fac = 4;
+float min_time = 0.2;
+float dt = 0.01;
+int seed = 1;
+char outfile[1024];
+char kernel[1024];
+
+sprintf(outfile,"stdout");
+kernel[0] = '\0';
+
+setpar(ac,av);
+getpar("kernel","s",kernel);
+getpar("nt_min","d",&nt_min);
+getpar("nt_max","d",&nt_max);
+getpar("nt_fac","d",&nt_fac);
+getpar("min_time","f",&min_time);
+getpar("dt","f",&dt);
+getpar("seed","d",&seed);
+getpar("outfile","s",outfile);
+endpar();
+
+if(nt_fac < 2)
+   nt_fac = 2;
+
+for(k=0;k<NKERNEL;k++)
+   use[k] = (kernel[0] == '\0');
+for(sptr=strtok(kernel,",");sptr!=NULL;sptr=strtok(NULL,","))
+   {
+   for(k=0;k<NKERNEL;k++)
+      {
+      if(strcmp(sptr,kernel_name[k]) == 0)
+         break;
+      }
+   if(k == NKERNEL)
+      {
+      fprintf(stderr,"*** unknown kernel= %s, exiting...\n",sptr);
+      exit(-1);
+      }
+   use[k] = 1;
+   }
+
+if(strcmp(outfile,"stdout") == 0)
+   fpw = stdout;
+else
+   fpw = fopfile(outfile,"w");
+
+/* the stage parameters, as on the command lines of the tools */
+tf_av[0] = "wcc_tfilter";
+tf_av[1] = "fhi=0.1";
+tf_av[2] = "flo=20.0";
+tf_av[3] = "order=4";
+wcc_tfilter_config(4,tf_av,&bc.tp);
+tfs_av[0] = tf_av[0];
+tfs_av[1] = tf_av[1];
+tfs_av[2] = tf_av[2];
+tfs_av[3] = tf_av[3];
+tfs_av[4] = "sos=1";
+wcc_tfilter_config(5,tfs_av,&bc.tps);
+
+sprintf(newdt,"newdt=%g",0.5*dt);
+rp_av[0] = "wcc_resamp_arbdt";
+rp_av[1] = newdt;
+wcc_resamp_arbdt_config(2,rp_av,&bc.rp);
+
+siteamp_par_init(&bc.sp);
+
+memset(&bc.shead,0,sizeof(struct statdata));
+strcpy(bc.shead.stat,"bench");
+strcpy(bc.shead.comp,"000");
+
+dev0 = open("/dev/null",O_WRONLY);
+
+for(nt=nt_min;nt<=nt_max;nt=nt*nt_fac)
+   {
+   bc.nt = nt;
+   bc.dt = dt;
+   bc.trace = (float *) check_malloc(nt*sizeof(float));
+   synth_trace(bc.trace,nt,dt,seed);
+
+   n = getnt_fftpad(nt);
+   if(next_p2(nt) > n)
+      n = next_p2(nt);
+   bc.s = (float *) fftwf_malloc((n+2)*sizeof(float));
+   bc.r = (float *) check_malloc(nt*sizeof(float));
+   bc.c = (struct complex *) fftwf_malloc(next_p2(nt)*sizeof(struct complex));
+
+   for(k=0;k<NKERNEL;k++)
+      {
+      if(!use[k])
+         continue;
+
+      n = kernel_size(k,nt,&bytes);
+
+      fflush(stderr);
+      fd2 = dup(2);
+      dup2(dev0,2);
+
+      tcopy = kernel_time(&bc,k,n,0,0.25*min_time,&nreps);
+      t = kernel_time(&bc,k,n,1,min_time,&reps) - tcopy;
+
+      fflush(stderr);
+      dup2(fd2,2);
+      close(fd2);
+
+      if(t < 0.0)
+         t = 0.0;
+      ns = 1.0e+09*t/nt;
+      fprintf(fpw,"{\"kernel\": \"%s\", \"nt\": %d, \"n\": %d, \"reps\": %d, \"ns_per_sample\": %.4f, \"gb_per_s\": %.4f}\n",
+         kernel_name[k],nt,n,reps,ns,(t > 0.0) ? 1.0e-09*bytes/t : 0.0);
+      fflush(fpw);
+      fprintf(stderr,"%-10s nt= %8d %10.3f ns/sample\n",kernel_name[k],nt,ns);
+      }
+
+   free(bc.trace);
+   free(bc.r);
+   fftwf_free(bc.s);
+   fftwf_free(bc.c);
+   }
+
+close(dev0);
+if(fpw != stdout)
+   fclose(fpw);
+return(0);
+}
@@ -1,98 +1,146 @@
+/**********************************************************************/
+/*                                                                    */
+/*           wcc_cnvlv                                                */
+/*                                                                    */
+/*           Convolves the trace infile2 (the Green's function) with  */
+/*           the source time function infile1, or with a gaussian     */
+/*           pulse (gaus=1, nb= tzero=); decon=1 deconvolves instead  */
+/*           and integ=1 integrates infile2.  Output to outfile.      */
+/*                                                                    */
+/*           When one of the two traces is short next to the other    */
+/*           (an STF against a long Green's function) the plain       */
+/*           convolution is done by overlap-add: the long trace in    */
+/*           blocks, FFTs of a few times the length of the short one  */
+/*           and the spectrum of the short one kept, instead of FFTs  */
+/*           of the whole padded length.  blocks=0 always uses the    */
+/*           whole length; decon=, integ= and order= always do.       */
+/*                                                                    */
+/*           filelist= convolves the one STF with many Green's        */
+/*           functions, one "infile2 outfile" pair per line, by       */
+/*           nthreads= OpenMP threads.                                */
+/*                                                                    */
+/**********************************************************************/
+
 #include "include.h"
 #include "structure.h"
 #include "function.h"
+#include "getpar.h"
 
 #define AMP 3.0
-
-struct complex
-   {
-   float re;
-   float im;
-   };
+#define MINBLOCK_FFT 1024
 
 int size_float = sizeof(float);
 int size_int = sizeof(int);
 
-main(ac,av)
-int ac;
-char **av;
-{
-struct statdata shead, ghead;
-struct complex *sc, *gc;
-float *s, *g;
-int nt_p2, i, j, nsrc, nt;
-int ntshft;
-float tstart = 0.0;
-float samp;
-int isamp;
-int npad = 1;
-int gaus = 0;
-int decon = 0;
-int integ = 0;
-int norm1 = 1;
-int ntap = 25;
-int nb;
-float tzero;
-float t0 = 0.0;
-double wlevel = 1.0e-15;
-
-float scale = 1.0;
-
-int ntout = -999;
-int inbin1 = 0;
-int inbin2 = 0;
-int outbin = 0;
+struct cnvopt
+   {
+   int integ, decon, norm1, gaus, nb, ntap, npad, ntout;
+   int inbin2, outbin, order, npass, blocks;
+   float tstart, tzero, t0, scale, f1, f2;
+   double wlevel;
+   };
 
-int order = 0;
-int npass = 2;
-float f1 = 0.0;
-float f2 = 1.0e+15;
+/* spectrum of the STF for the overlap-add blocks, kept between traces */
+struct kcache
+   {
+   int nfft, nk;
+   float dt;
+   float *spec;
+   };
 
-FILE *fpr1, *fpr2, *fpw, *fopfile();
-char infile1[128];
-char infile2[128];
-char outfile[128];
+void integrate(struct complex *,int,float *);
+void convolve(struct complex *,struct complex *,int,int,int,double *,float *);
+void zero(float *,int);
+void taper_norm(float *,float *,int,int);
+void norm(float *,float *,int);
+void norm_area(float *,int,float *);
+void makesource(float *,float *,int,float *,int);
+void resample(float *,float *,int);
+void wfilter(struct complex *,float *,int,float *,float *,int,int);
+void wfilter2(struct complex *,float *,int,float *,float *,float *,float *);
 
-setpar(ac,av);
-getpar("integ","d",&integ);
-getpar("decon","d",&decon);
-getpar("ntout","d",&ntout);
-getpar("tstart","f",&tstart);
-getpar("npad","d",&npad);
-getpar("ntap","d",&ntap);
-getpar("norm1","d",&norm1);
-getpar("gaus","d",&gaus);
-if(gaus)
-   {
-   mstpar("nb","d",&nb);
-   mstpar("tzero","f",&tzero);
-   }
+/*
+   Linear convolution y = k*x/dt (as the whole length FFTs give it),
+   k of nk samples (the short trace) and x of nx, into y[0..ny-1], by
+   overlap-add with FFTs of length nfft; with kc the spectrum of k is
+   taken from, or kept in, kc.
+*/
+void ola_convolve(float *k,int nk,float *x,int nx,float *y,int ny,float dt,int nfft,struct kcache *kc)
+{
+float *ks, *w, re, fac;
+int i, j0, nb, nblk;
+
+if(kc != NULL && kc->spec != NULL && kc->nfft == nfft && kc->nk == nk && kc->dt == dt)
+   ks = kc->spec;
 else
    {
-   mstpar("infile1","s",infile1);
-   getpar("inbin1","d",&inbin1);
+   ks = (float *) check_malloc((nfft+2)*size_float);
+   for(i=0;i<nk;i++)
+      ks[i] = k[i];
+   zero(ks+nk,nfft+2-nk);
+   rfft_r2c(ks,nfft,-1);
+
+   if(kc != NULL)
+      {
+      free(kc->spec);
+      kc->spec = ks;
+      kc->nfft = nfft;
+      kc->nk = nk;
+      kc->dt = dt;
+      }
    }
 
-mstpar("infile2","s",infile2);
-getpar("inbin2","d",&inbin2);
-mstpar("outfile","s",outfile);
-getpar("outbin","d",&outbin);
-getpar("scale","f",&scale);
-getpar("t0","f",&t0);
-getpar("wlevel","F",&wlevel);
-getpar("order","d",&order);
-if(order)
+w = (float *) check_malloc((nfft+2)*size_float);
+zero(y,ny);
+
+fac = 1.0/(dt*nfft);
+nblk = nfft - nk + 1;
+for(j0=0;j0<nx;j0=j0+nblk)
    {
-   mstpar("f1","f",&f1);
-   mstpar("f2","f",&f2);
-   getpar("npass","d",&npass);
+   nb = nblk;
+   if(j0 + nb > nx)
+      nb = nx - j0;
+
+   for(i=0;i<nb;i++)
+      w[i] = x[j0+i];
+   zero(w+nb,nfft+2-nb);
+
+   rfft_r2c(w,nfft,-1);
+   for(i=0;i<=nfft/2;i++)
+      {
+      re = w[2*i]*ks[2*i] - w[2*i+1]*ks[2*i+1];
+      w[2*i+1] = w[2*i]*ks[2*i+1] + w[2*i+1]*ks[2*i];
+      w[2*i] = re;
+      }
+   rfft_c2r(w,nfft,1);
+
+   for(i=0;i<nb+nk-1 && j0+i<ny;i++)
+      y[j0+i] = y[j0+i] + fac*w[i];
    }
-endpar();
+
+free(w);
+if(kc == NULL)
+   free(ks);
+}
+
+/*
+   One Green's function: infile2 with the STF s1 (header sh1, not used
+   with gaus=1) into outfile.
+*/
+void cnvlv_trace(struct cnvopt *op,float *s1,struct statdata *sh1,char *infile2,char *outfile,struct kcache *kc)
+{
+struct statdata shead, ghead;
+struct complex *sc, *gc;
+float *s, *g, *y;
+int nt_p2, i, nt, nk, nfft;
+int ntshft;
+float samp;
+int isamp;
 
 g = NULL;
 s = NULL;
 
-g = read_wccseis(infile2,&ghead,g,inbin2);
+g = read_wccseis(infile2,&ghead,g,op->inbin2);
 
 if(ghead.hr < -24 || ghead.hr > 23)
    ghead.hr = 0;
@@ -101,8 +149,13 @@ if(ghead.min < -60 || ghead.min > 59)
 
 shead.hr = shead.min = 0;
 shead.sec = 0.0;
-if(!gaus)
-   s = read_wccseis(infile1,&shead,s,inbin1);
+if(!op->gaus)
+   {
+   shead = *sh1;
+   s = (float *) check_malloc(shead.nt*size_float);
+   for(i=0;i<shead.nt;i++)
+      s[i] = s1[i];
+   }
 else
    {
    shead.nt = ghead.nt;
@@ -111,7 +164,7 @@ else
 
 ghead.hr = ghead.hr + shead.hr;
 ghead.min = ghead.min + shead.min;
-ghead.sec = ghead.sec - t0;
+ghead.sec = ghead.sec - op->t0;
 
 samp = 1;
 isamp = 1;
@@ -145,53 +198,102 @@ if(ghead.dt != shead.dt)
    }
 
 nt = shead.nt + samp*ghead.nt;
-nt_p2 = npad*getnt_p2(nt);
-s = (float *) check_realloc (s,nt_p2*size_float);
-g = (float *) check_realloc (g,nt_p2*size_float);
+nt_p2 = op->npad*getnt_fft(nt);
+
+/* overlap-add blocks: a fast FFT length of about four kernel lengths */
+nk = shead.nt;
+if(samp*ghead.nt < nk)
+   nk = samp*ghead.nt;
+nfft = 4*nk;
+if(nfft < MINBLOCK_FFT)
+   nfft = MINBLOCK_FFT;
+nfft = getnt_fft(nfft);
+
+if(op->blocks && !op->decon && !op->integ && !op->order && nk > 0 && nfft < nt_p2)
+   {
+   s = (float *) check_realloc (s,nt*size_float);
+   g = (float *) check_realloc (g,nt*size_float);
 
-sc = (struct complex *) s;
-gc = (struct complex *) g;
+   if(op->gaus)
+      makesource(s,&shead.dt,shead.nt,&op->tzero,op->nb);
 
-if(gaus)
-   makesource(s,&shead.dt,shead.nt,&tzero,nb);
+   if(op->norm1)
+      norm_area(s,shead.nt,&shead.dt);
 
-if(norm1)
-   norm_area(s,shead.nt,&shead.dt);
+   if(samp != 1)
+      {
+      resample(g,&samp,ghead.nt);
+      ghead.nt = ghead.nt*samp;
+      ghead.dt = shead.dt;
+      }
 
-if(samp != 1)
-   {
-   resample(g,&samp,ghead.nt);
-   ghead.nt = ghead.nt*samp;
-   ghead.dt = shead.dt;
+   taper_norm(s,&shead.dt,shead.nt,op->ntap);
+   taper_norm(g,&ghead.dt,ghead.nt,op->ntap);
+
+   y = (float *) check_malloc(nt*size_float);
+   if(shead.nt <= ghead.nt)
+      ola_convolve(s,shead.nt,g,ghead.nt,y,nt,ghead.dt,nfft,kc);
+   else
+      ola_convolve(g,ghead.nt,s,shead.nt,y,nt,ghead.dt,nfft,NULL);
+   free(g);
+   g = y;
+
+   /* the output is nt long, as is the nonzero part of the padded one */
+   nt_p2 = nt;
+   fprintf(stderr,"**** nfft= %d (blocks)\n",nfft);
    }
+else
+   {
+   s = (float *) check_realloc (s,nt_p2*size_float);
+   g = (float *) check_realloc (g,nt_p2*size_float);
 
-taper_norm(s,&shead.dt,shead.nt,ntap);
-zero(s+shead.nt,(nt_p2)-shead.nt);
-forfft(sc,nt_p2,-1);
+   sc = (struct complex *) s;
+   gc = (struct complex *) g;
 
-taper_norm(g,&ghead.dt,ghead.nt,ntap);
-zero(g+ghead.nt,nt_p2-ghead.nt);
-forfft(gc,nt_p2,-1);
+   if(op->gaus)
+      makesource(s,&shead.dt,shead.nt,&op->tzero,op->nb);
 
-if(integ)
-   integrate(gc,nt_p2,&ghead.dt);
-else
-   convolve(sc,gc,nt_p2,decon,(int)(t0/ghead.dt),&wlevel,&ghead.dt);
+   if(op->norm1)
+      norm_area(s,shead.nt,&shead.dt);
+
+   if(samp != 1)
+      {
+      resample(g,&samp,ghead.nt);
+      ghead.nt = ghead.nt*samp;
+      ghead.dt = shead.dt;
+      }
+
+   taper_norm(s,&shead.dt,shead.nt,op->ntap);
+   zero(s+shead.nt,(nt_p2)-shead.nt);
+   forfft(sc,nt_p2,-1);
+
+   taper_norm(g,&ghead.dt,ghead.nt,op->ntap);
+   zero(g+ghead.nt,nt_p2-ghead.nt);
+   forfft(gc,nt_p2,-1);
 
-if(order)
-   wfilter(gc,&ghead.dt,nt_p2,&f1,&f2,order,npass);
+   if(op->integ)
+      integrate(gc,nt_p2,&ghead.dt);
+   else
+      convolve(sc,gc,nt_p2,op->decon,(int)(op->t0/ghead.dt),&op->wlevel,&ghead.dt);
+
+   if(op->order)
+      wfilter(gc,&ghead.dt,nt_p2,&op->f1,&op->f2,op->order,op->npass);
 
-invfft(gc,nt_p2,1);
-norm(g,&ghead.dt,nt_p2);
+   invfft(gc,nt_p2,1);
+   norm(g,&ghead.dt,nt_p2);
+
+   fprintf(stderr,"**** nt_p2= %d\n",nt_p2);
+   }
+free(s);
 
-if(decon)
+if(op->decon)
    nt = nt_p2;
 else
    {
    ghead.sec = ghead.sec + shead.sec;
-   if(tstart > ghead.sec)
+   if(op->tstart > ghead.sec)
       {
-      ntshft = (tstart - ghead.sec)/ghead.dt;
+      ntshft = (op->tstart - ghead.sec)/ghead.dt;
 
       if(nt+ntshft > nt_p2)
          {
@@ -205,11 +307,11 @@ else
          for(i=0;i<nt;i++)
             g[i] = g[i+ntshft];
          }
-      ghead.sec = tstart;
+      ghead.sec = op->tstart;
       }
-   else if(tstart < ghead.sec)
+   else if(op->tstart < ghead.sec)
       {
-      ntshft = (ghead.sec - tstart)/ghead.dt;
+      ntshft = (ghead.sec - op->tstart)/ghead.dt;
       nt = nt + ntshft;
 
       if(nt > nt_p2)
@@ -220,41 +322,157 @@ else
       for(i=ntshft-1;i>=0;i--)
          g[i] = 0.0;
 
-      /*
-      for(i=nt-1;i>=ntshft;i--)
-         g[i] = g[i-ntshft];
-      for(i=ntshft-1;i>=0;i--)
-         g[i] = 0.0;
-*/
-
-      ghead.sec = tstart;
+      ghead.sec = op->tstart;
       }
    }
 
 ghead.nt = nt;
-if(ntout > -99)
+if(op->ntout > -99)
    {
-   if(ntout > nt)
+   if(op->ntout > nt)
       {
-      g = (float *) check_realloc (g,ntout*size_float);
+      g = (float *) check_realloc (g,op->ntout*size_float);
 
-      for(i=nt;i<ntout;i++)
+      for(i=nt;i<op->ntout;i++)
          g[i] = 0.0;
       }
 
-   ghead.nt = ntout;
+   ghead.nt = op->ntout;
    }
 
-fprintf(stderr,"**** nt_p2= %d\n",nt_p2);
 fprintf(stderr,"**** output nt= %d\n",ghead.nt);
 
 for(i=0;i<ghead.nt;i++)
-      g[i] = scale*g[i];
+      g[i] = op->scale*g[i];
+
+write_wccseis(outfile,&ghead,g,op->outbin);
+free(g);
+}
+
+int main(int ac,char **av)
+{
+struct cnvopt op;
+struct kcache kc;
+struct statdata shead;
+float *s;
+char infile1[128];
+char infile2[128];
+char outfile[128];
+char filelist[512], line[1024], **in2, **out;
+int i, nf;
+FILE *fpr;
+
+int inbin1 = 0;
+int nthreads = 1;
+
+op.integ = 0;
+op.decon = 0;
+op.norm1 = 1;
+op.gaus = 0;
+op.ntap = 25;
+op.npad = 1;
+op.ntout = -999;
+op.inbin2 = 0;
+op.outbin = 0;
+op.order = 0;
+op.npass = 2;
+op.blocks = 1;
+op.tstart = 0.0;
+op.t0 = 0.0;
+op.scale = 1.0;
+op.f1 = 0.0;
+op.f2 = 1.0e+15;
+op.wlevel = 1.0e-15;
+
+filelist[0] = '\0';
+
+setpar(ac,av);
+getpar("integ","d",&op.integ);
+getpar("decon","d",&op.decon);
+getpar("ntout","d",&op.ntout);
+getpar("tstart","f",&op.tstart);
+getpar("npad","d",&op.npad);
+getpar("ntap","d",&op.ntap);
+getpar("norm1","d",&op.norm1);
+getpar("gaus","d",&op.gaus);
+if(op.gaus)
+   {
+   mstpar("nb","d",&op.nb);
+   mstpar("tzero","f",&op.tzero);
+   }
+else
+   {
+   mstpar("infile1","s",infile1);
+   getpar("inbin1","d",&inbin1);
+   }
+
+getpar("filelist","s",filelist);
+if(filelist[0] == '\0')
+   {
+   mstpar("infile2","s",infile2);
+   mstpar("outfile","s",outfile);
+   }
+getpar("inbin2","d",&op.inbin2);
+getpar("outbin","d",&op.outbin);
+getpar("scale","f",&op.scale);
+getpar("t0","f",&op.t0);
+getpar("wlevel","F",&op.wlevel);
+getpar("order","d",&op.order);
+if(op.order)
+   {
+   mstpar("f1","f",&op.f1);
+   mstpar("f2","f",&op.f2);
+   getpar("npass","d",&op.npass);
+   }
+getpar("blocks","d",&op.blocks);
+getpar("nthreads","d",&nthreads);
+endpar();
 
-write_wccseis(outfile,&ghead,g,outbin);
+s = NULL;
+if(!op.gaus)
+   s = read_wccseis(infile1,&shead,s,inbin1);
+
+if(filelist[0] == '\0')
+   {
+   kc.spec = NULL;
+   cnvlv_trace(&op,s,&shead,infile2,outfile,&kc);
+   exit(0);
+   }
+
+in2 = NULL;
+out = NULL;
+nf = 0;
+fpr = fopfile(filelist,"r");
+while(fgets(line,1024,fpr) != NULL)
+   {
+   if(sscanf(line,"%127s %127s",infile2,outfile) != 2)
+      continue;
+
+   in2 = (char **) check_realloc(in2,(nf+1)*sizeof(char *));
+   out = (char **) check_realloc(out,(nf+1)*sizeof(char *));
+   in2[nf] = (char *) check_malloc(strlen(infile2)+1);
+   out[nf] = (char *) check_malloc(strlen(outfile)+1);
+   strcpy(in2[nf],infile2);
+   strcpy(out[nf],outfile);
+   nf++;
+   }
+fclose(fpr);
+
+#pragma omp parallel num_threads(nthreads) private(kc)
+   {
+   kc.spec = NULL;
+
+#pragma omp for schedule(dynamic,1)
+   for(i=0;i<nf;i++)
+      cnvlv_trace(&op,s,&shead,in2[i],out[i],&kc);
+
+   free(kc.spec);
+   }
+
+exit(0);
 }
 
-integrate(g,n,dt)
+void integrate(g,n,dt)
 struct complex *g;
 float *dt;
 int n;
@@ -276,7 +494,7 @@ for(i=1;i<n/2;i++)
    }
 }
 
-convolve(s,g,n,dc,it0,wlev,dt)
+void convolve(s,g,n,dc,it0,wlev,dt)
 struct complex *s, *g;
 float *dt;
 double *wlev;
@@ -386,7 +604,7 @@ else
    }
 }
 
-zero(s,n)
+void zero(s,n)
 float *s;
 int n;
 {
@@ -397,7 +615,7 @@ while(n--)
    }
 }
 
-taper_norm(g,dt,nt,ntap)
+void taper_norm(g,dt,nt,ntap)
 float *g, *dt;
 int nt, ntap;
 {
@@ -415,7 +633,7 @@ for(i=nt-ntap;i<nt;i++)
    }
 }
 
-norm(g,dt,nt)
+void norm(g,dt,nt)
 float *g, *dt;
 int nt;
 {
@@ -429,7 +647,7 @@ while(nt--)
    }
 }
 
-norm_area(s,n,dt)
+void norm_area(s,n,dt)
 float *s, *dt;
 int n;
 {
@@ -446,28 +664,8 @@ for(i=0;i<n;i++)
    s[i] = s[i]/area;
 }
 
-getnt_p2(nt)
-int nt;
-{
-int i = 0;
-
-while(nt > 1)
-   {
-   if(nt%2)
-      nt++;
-
-   nt = nt/2;
-   i++;
-   }
-
-nt = 1;
-while(i--)
-   nt = nt*2;
-
-return(nt);
-}
  
-makesource(s,dt,nt,a,nb)
+void makesource(s,dt,nt,a,nb)
 float *s;
 float *dt, *a;
 int nt, nb;
@@ -502,7 +700,7 @@ for(it=1;it<nt;it++)
    }
 }
 
-resample(g,samp,nt)
+void resample(g,samp,nt)
 float *g, *samp;
 int nt;
 {
@@ -538,7 +736,7 @@ else
    }
 }
 
-wfilter(g,dt,n,f1,f2,ord,np)
+void wfilter(g,dt,n,f1,f2,ord,np)
 struct complex *g;
 float *dt, *f1, *f2;
 int n, ord, np;
@@ -570,7 +768,7 @@ for(i=1;i<n/2;i++)
    }
 }
 
-wfilter2(g,dt,n,f1,f2,f3,f4)
+void wfilter2(g,dt,n,f1,f2,f3,f4)
 struct complex *g;
 float *dt, *f1, *f2, *f3, *f4;
 int n;
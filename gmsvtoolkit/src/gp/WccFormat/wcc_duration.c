@@ -1,70 +1,330 @@
+/**********************************************************************/
+/*                                                                    */
+/*           wcc_duration                                             */
+/*                                                                    */
+/*           Significant duration of WCC traces: the normalized       */
+/*           running integral of |s| (of s*s with arias=1, the Husid  */
+/*           plot of the Arias intensity) first exceeds pstart at t0  */
+/*           and pend at t1.  For one trace (infile=) the output is,  */
+/*           as before,                                               */
+/*                                                                    */
+/*              t0 t1 (t1-t0)/(pend-pstart)                           */
+/*                 tmax-t0+pstart*(t1-t0)/(pend-pstart)               */
+/*                                                                    */
+/*           with tmax the time of the peak |s|.                      */
+/*                                                                    */
+/*           Many traces are done in one run with filelist= (one name */
+/*           per line, pack paths "pack:stat/comp" allowed) or pack=  */
+/*           (every trace of a WCC pack), by nthreads= OpenMP         */
+/*           threads.  Each trace gives one line, in input order,     */
+/*                                                                    */
+/*              name t0 t1 t1-t0 D5-75 D5-95 Ia                       */
+/*                                                                    */
+/*           where D5-75 and D5-95 are always from the Husid plot and */
+/*           Ia = pi/(2g)*integral(s*s)dt (g= in the units of s,      */
+/*           default 980.665 for cm/s/s; Ia is then in cm/s).         */
+/*           summary=1 gives this line for infile= too.               */
+/*                                                                    */
+/**********************************************************************/
+
 #include "include.h"
 #include "structure.h"
 #include "function.h"
+#include "getpar.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define         MAXFILES        50000
+#define         NOT_FOUND       -99.9
 
 int size_float = sizeof(float);
 int size_int = sizeof(int);
 
-main(int ac,char **av)
+/*
+   Running sum c[i] = dt*(w(s[0]) + ... + w(s[i])), w(x) = |x| or x*x
+   (sq=1), in double; returns c[nt-1].  Two samples at a time with SSE2:
+   [w0,w1] -> [w0,w0+w1] plus the carry of the samples before.
+*/
+double energy_scan(float *s,int nt,float dt,int sq,double *c)
+{
+double carry, w0, w1;
+int it;
+
+carry = 0.0;
+it = 0;
+
+#if defined(__SSE2__)
+{
+__m128d x, vc, vdt;
+__m128 f;
+
+vdt = _mm_set1_pd((double)(dt));
+vc = _mm_setzero_pd();
+for(;it+2<=nt;it=it+2)
+   {
+   f = _mm_castsi128_ps(_mm_loadl_epi64((__m128i *)(s+it)));
+   x = _mm_cvtps_pd(f);
+   if(sq)
+      x = _mm_mul_pd(x,x);
+   else
+      x = _mm_andnot_pd(_mm_set1_pd(-0.0),x);
+   x = _mm_mul_pd(x,vdt);
+   x = _mm_add_pd(x,_mm_castsi128_pd(_mm_slli_si128(_mm_castpd_si128(x),8)));
+   x = _mm_add_pd(x,vc);
+   _mm_storeu_pd(c+it,x);
+   vc = _mm_unpackhi_pd(x,x);
+   }
+_mm_store_sd(&carry,vc);
+}
+#endif
+
+for(;it<nt;it++)
+   {
+   w0 = s[it];
+   w1 = sq ? w0*w0 : fabs(w0);
+   carry = carry + w1*dt;
+   c[it] = carry;
+   }
+
+return(carry);
+}
+
+/* first it with c[it]/ctot > p (c is non-decreasing), -1 if none */
+int energy_cross(double *c,int nt,double ctot,float p)
+{
+int lo, hi, mid;
+
+if(nt < 1 || !(c[nt-1]/ctot > p))
+   return(-1);
+
+lo = 0;
+hi = nt-1;
+while(lo < hi)
+   {
+   mid = lo + (hi-lo)/2;
+   if(c[mid]/ctot > p)
+      hi = mid;
+   else
+      lo = mid+1;
+   }
+return(lo);
+}
+
+float cross_time(double *c,int nt,double ctot,float p,float dt)
+{
+int it;
+
+if(ctot <= 0.0)
+   return(NOT_FOUND);
+
+it = energy_cross(c,nt,ctot,p);
+if(it < 0)
+   return(NOT_FOUND);
+return(it*dt);
+}
+
+/* time of the peak |s|, over s[1] ... s[nt-1] */
+float peak_time(float *s,int nt,float dt)
+{
+float amax, tmax;
+int it;
+
+amax = 0.0;
+tmax = 0.0;
+for(it=1;it<nt;it++)
+   {
+   if(s[it] > amax)
+      {
+      amax = s[it];
+      tmax = it*dt;
+      }
+   if(-s[it] > amax)
+      {
+      amax = -s[it];
+      tmax = it*dt;
+      }
+   }
+return(tmax);
+}
+
+/*
+   Durations of one trace into line (summary format) or, with
+   summary=0, the line of the single trace mode.  c is work space of
+   length nt.
+*/
+void duration(char *name,float *s,struct statdata *hd,float pstart,float pend,int arias,float g,int summary,double *c,char *line)
+{
+double ctot, atot;
+float t0, t1, t5, t75, t95, tmax, ia;
+float d575, d595;
+
+ctot = energy_scan(s,hd->nt,hd->dt,arias,c);
+t0 = cross_time(c,hd->nt,ctot,pstart,hd->dt);
+t1 = cross_time(c,hd->nt,ctot,pend,hd->dt);
+
+if(!summary)
+   {
+   tmax = peak_time(s,hd->nt,hd->dt);
+   sprintf(line,"%10.2f %10.2f %10.2f %10.2f\n",t0,t1,(t1-t0)/(pend-pstart),tmax - t0 + pstart*(t1-t0)/(pend-pstart));
+   return;
+   }
+
+if(!arias)
+   ctot = energy_scan(s,hd->nt,hd->dt,1,c);
+atot = ctot;
+t5 = cross_time(c,hd->nt,atot,0.05,hd->dt);
+t75 = cross_time(c,hd->nt,atot,0.75,hd->dt);
+t95 = cross_time(c,hd->nt,atot,0.95,hd->dt);
+ia = 0.5*M_PI*atot/g;
+
+d575 = NOT_FOUND;
+d595 = NOT_FOUND;
+if(t5 != NOT_FOUND && t75 != NOT_FOUND)
+   d575 = t75 - t5;
+if(t5 != NOT_FOUND && t95 != NOT_FOUND)
+   d595 = t95 - t5;
+
+sprintf(line,"%s %10.2f %10.2f %10.2f %10.2f %10.2f %13.5e\n",name,t0,t1,t1-t0,d575,d595,ia);
+}
+
+int main(int ac,char **av)
 {
 struct statdata head0;
+struct wccmap wm0;
+struct wccpack *wp;
 float *s0;
-float t0, t1, amax, time, tmax;
-int it;
+double *c;
+int i, nc, ntr;
+char **name, *line, *lines, str[1024];
+FILE *fpr;
 
-char infile[128];
+char infile[1024];
+char filelist[1024];
+char pack[1024];
 
 float pstart = 0.05;
 float pend = 0.95;
+float g = 980.665;
 int inbin = 0;
+int arias = 0;
+int summary = 0;
+int nthreads = 1;
 
 sprintf(infile,"stdin");
+filelist[0] = '\0';
+pack[0] = '\0';
 
 setpar(ac, av);
 getpar("infile","s",infile);
+getpar("filelist","s",filelist);
+getpar("pack","s",pack);
 getpar("pstart","f",&pstart);
 getpar("pend","f",&pend);
 getpar("inbin","d",&inbin);
+getpar("arias","d",&arias);
+getpar("g","f",&g);
+getpar("summary","d",&summary);
+getpar("nthreads","d",&nthreads);
 endpar();
 
-s0 = NULL;
-s0 = read_wccseis(infile,&head0,s0,inbin);
-
-s0[0] = head0.dt*sqrt(s0[0]*s0[0]);
-amax = 0.0;
-tmax = 0.0;
-for(it=1;it<head0.nt;it++)
+if(filelist[0] == '\0' && pack[0] == '\0')
    {
-   if(s0[it] > amax)
+   s0 = NULL;
+   if(inbin)
       {
-      amax = s0[it];
-      tmax = it*head0.dt;
+      s0 = map_wccseis(infile,&wm0);
+      head0 = *(wm0.shead);
       }
-   if(-s0[it] > amax)
+   else
+      s0 = read_wccseis(infile,&head0,s0,inbin);
+
+   c = (double *) check_malloc(head0.nt*sizeof(double));
+   line = (char *) check_malloc(2048);
+   duration(infile,s0,&head0,pstart,pend,arias,g,summary,c,line);
+   fputs(line,stdout);
+   exit(0);
+   }
+
+/* the trace names: the entries of filelist, or pack:stat/comp */
+
+name = (char **) check_malloc(MAXFILES*sizeof(char *));
+ntr = 0;
+if(pack[0] != '\0')
+   {
+   wp = wccpack_open(pack,0);
+   for(i=0;i<wp->ntrace && ntr<MAXFILES;i++)
       {
-      amax = -s0[it];
-      tmax = it*head0.dt;
+      if(wccpack_find(wp,wp->index[i].stat,wp->index[i].comp) != i)
+         continue;   /* replaced by a later trace */
+
+      sprintf(str,"%s:%s/%s",pack,wp->index[i].stat,wp->index[i].comp);
+      name[ntr] = (char *) check_malloc(strlen(str)+1);
+      strcpy(name[ntr],str);
+      ntr++;
       }
+   wccpack_close(wp);
+   }
+else
+   {
+   line = (char *) check_malloc(1024);
+   fpr = fopfile(filelist,"r");
+   while(fgets(line,1024,fpr) != NULL && ntr < MAXFILES)
+      {
+      if(sscanf(line,"%1023s",str) != 1)
+         continue;
 
-   s0[it] = s0[it-1] + head0.dt*sqrt(s0[it]*s0[it]);
+      name[ntr] = (char *) check_malloc(strlen(str)+1);
+      strcpy(name[ntr],str);
+      ntr++;
+      }
+   fclose(fpr);
+   free(line);
    }
 
-amax = s0[head0.nt-1];
-for(it=0;it<head0.nt;it++)
-   s0[it] = s0[it]/amax;
+/* each trace's line is kept so the output is in input order */
+
+lines = (char *) check_malloc((size_t)(ntr)*2048);
 
-t0 = -99.9;
-t1 = -99.9;
-for(it=0;it<head0.nt;it++)
+#pragma omp parallel num_threads(nthreads) private(i,s0,c,nc,head0,wm0)
    {
-   time = it*head0.dt;
+   s0 = NULL;
+   c = NULL;
+   nc = 0;
+
+#pragma omp for schedule(dynamic,1)
+   for(i=0;i<ntr;i++)
+      {
+      if(inbin && pack[0] == '\0')
+         {
+         s0 = map_wccseis(name[i],&wm0);
+         head0 = *(wm0.shead);
+         }
+      else
+         s0 = read_wccseis(name[i],&head0,s0,inbin);
 
-   if(s0[it] > pstart && t0 < 0.0)
-      t0 = time;
+      if(head0.nt > nc)
+         {
+         nc = head0.nt;
+         c = (double *) check_realloc(c,nc*sizeof(double));
+         }
 
-   if(s0[it] > pend && t1 < 0.0)
-      t1 = time;
+      duration(name[i],s0,&head0,pstart,pend,arias,g,1,c,lines+(size_t)(i)*2048);
+
+      if(inbin && pack[0] == '\0')
+         {
+         unmap_wccseis(&wm0);
+         s0 = NULL;
+         }
+      }
+
+   free(s0);
+   free(c);
    }
 
-printf("%10.2f %10.2f %10.2f %10.2f\n",t0,t1,(t1-t0)/(pend-pstart),tmax - t0 + pstart*(t1-t0)/(pend-pstart));
+for(i=0;i<ntr;i++)
+   fputs(lines+(size_t)(i)*2048,stdout);
+
+exit(0);
 }
@@ -1,31 +1,73 @@
+/**********************************************************************/
+/*                                                                    */
+/*           wcc_genstf                                               */
+/*                                                                    */
+/*           Source time function of npeak peaks (t0= ts= a0= lists)  */
+/*           of type stype= into outfile.                             */
+/*                                                                    */
+/*           With stflist= many STFs, typically one per subfault,     */
+/*           are made in one run, by nthreads= OpenMP threads, into   */
+/*           the WCC pack outfile (as name/comp).  The lines of       */
+/*           stflist are                                              */
+/*                                                                    */
+/*              name tshift t0 ts a0 [t0 ts a0 ...]                   */
+/*                                                                    */
+/*           one t0 ts a0 group per peak (3 t0 values for trap, 2     */
+/*           for 2tri); each STF is the one a run with these          */
+/*           parameters would write, the random part of rand= being   */
+/*           drawn from seed= for each of them.  The pack traces      */
+/*           can be given to wcc_gfsum as "outfile:name/comp".        */
+/*                                                                    */
+/**********************************************************************/
+
 #include "include.h"
 #include "structure.h"
 #include "function.h"
+#include "getpar.h"
 
 #define AMP 3.0
 #define PI 3.141592654
 
-struct complex
+#define LINELEN 4096
+
+/* STFs made by the threads before they are added to the pack */
+#define STF_BATCH 1024
+
+/* one line of stflist */
+struct stfline
    {
-   float re;
-   float im;
+   char name[STATCHAR];
+   float tshift;
+   int npeak;
+   float *t0, *ts, *a0;
    };
 
 void wfilt(struct complex *,int,float *,float *);
 void randomize(float *,int,float *,float *,float *,long *,int);
+void gen_stf(char *,float *,int,float,int,float *,float *,float *,float *,int,float,float,long,int,float);
+void set_header(struct statdata *,char *,char *,char *,int,float,float);
+int peak_nt0(char *);
+struct stfline *read_stflist(char *,int,int *);
 double frand(void);
 double sfrand(long *);
+void makesource(char *,float *,float *,int,float *,float *,float *,int);
+void zap(float *,int);
+void apply_tsh(float *,int,float *,float *);
+void normal(float *,int,float *,float *);
 
 int size_float = sizeof(float);
 
-main(int ac,char **av)
+int main(int ac,char **av)
 {
 FILE *fpw, *fopfile();
 struct statdata head1;
+struct stfline *sl;
+struct wccpack *wp;
 float *st;
-int nt6, nt, it, i, j, ip;
-float tsh, dt;
-float *t0ptr, t0[60], ts[20], a0[20];
+int nt6, nt, it, i, j, ip, i0, nb, nstf;
+float dt;
+float *t0, *ts, *a0;
+int nt0, nts, na0;
 
 float tshift = 0.0;
 int npeak = 1;
@@ -34,6 +76,7 @@ int bigN = 1;
 int pos_only = 1;
 
 int outbin = 0;
+int nthreads = 1;
 
 char title[128];
 char name[16];
@@ -41,6 +84,7 @@ char comp[8];
 char stype[16];
 
 char outfile[256];
+char stflist[512];
 
 float rand = 0.0;
 float fzero = 1.0;
@@ -52,15 +96,23 @@ sprintf(stype,"tri");
 sprintf(name,"stf");
 sprintf(comp,"stf");
 sprintf(title,"TITLE");
+stflist[0] = '\0';
 
 setpar(ac,av);
 mstpar("dt","f",&dt);
 mstpar("nt","d",&nt);
 mstpar("outfile","s",outfile);
-mstpar("npeak","d",&npeak);
-mstpar("t0","vf",t0);
-mstpar("ts","vf",ts);
-mstpar("a0","vf",a0);
+getpar("stflist","s",stflist);
+
+if(stflist[0] == '\0')
+   {
+   mstpar("npeak","d",&npeak);
+
+   /* any number of peaks, the lists may also be given as t0=@file */
+   nt0 = mstpar("t0","vf@",&t0);
+   nts = mstpar("ts","vf@",&ts);
+   na0 = mstpar("a0","vf@",&a0);
+   }
 
 getpar("tshift","f",&tshift);
 getpar("stype","s",stype);
@@ -76,55 +128,175 @@ getpar("pos_only","d",&pos_only);
 getpar("fzero","f",&fzero);
 getpar("seed","d",&seed);
 getpar("outbin","d",&outbin);
+getpar("nthreads","d",&nthreads);
 
 getpar("scale2slip","f",&scale2slip);
 endpar();
 
+if(stflist[0] != '\0')
+   {
+   sl = read_stflist(stflist,peak_nt0(stype),&nstf);
+
+   wp = wccpack_open(outfile,1);
+   st = (float *) check_malloc ((long long)(STF_BATCH)*nt*size_float);
+
+   /* made in parallel a batch at a time, added to the pack in order */
+   for(i0=0;i0<nstf;i0=i0+STF_BATCH)
+      {
+      nb = nstf - i0;
+      if(nb > STF_BATCH)
+         nb = STF_BATCH;
+
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic,1)
+      for(i=0;i<nb;i++)
+         gen_stf(stype,st+(long long)(i)*nt,nt,dt,sl[i0+i].npeak,sl[i0+i].t0,sl[i0+i].ts,sl[i0+i].a0,&sl[i0+i].tshift,bigN,rand,fzero,seed,pos_only,scale2slip);
+
+      for(i=0;i<nb;i++)
+         {
+         set_header(&head1,sl[i0+i].name,comp,title,nt,dt,sl[i0+i].tshift);
+         wccpack_add(wp,head1.stat,head1.comp,&head1,st+(long long)(i)*nt);
+         }
+      }
+   wccpack_close(wp);
+
+   fprintf(stderr,"%d STFs written to %s\n",nstf,outfile);
+   exit(0);
+   }
+
+if(nts < npeak || na0 < npeak || nt0 < npeak)
+   {
+   fprintf(stderr,"*** npeak= %d but t0= has %d, ts= %d and a0= %d values, exiting...\n",npeak,nt0,nts,na0);
+   exit(-1);
+   }
+
 st = (float *) check_malloc (nt*size_float);
 
+gen_stf(stype,st,nt,dt,npeak,t0,ts,a0,&tshift,bigN,rand,fzero,seed,pos_only,scale2slip);
+
+set_header(&head1,name,comp,title,nt,dt,tshift);
+write_wccseis(outfile,&head1,st,outbin);
+}
+
+/*
+   The STF of npeak peaks into st; *tshift is replaced by the shift
+   actually done (a whole number of samples).
+*/
+void gen_stf(char *stype,float *st,int nt,float dt,int npeak,float *t0,float *ts,float *a0,float *tshift,int bigN,float rand,float fzero,long seed,int pos_only,float scale2slip)
+{
+float *t0ptr;
+float tsh;
+int ip;
+
 zap(st,nt);
 t0ptr = t0;
 for(ip=0;ip<npeak;ip++)
    {
-   tsh = tshift + ts[ip];
    tsh = ts[ip];
    makesource(stype,st,&dt,nt,t0ptr,&a0[ip],&tsh,bigN);
-
-   if(strncmp("trap",stype,4) == 0)
-      t0ptr = t0ptr + 3;
-   else if(strncmp("2tri",stype,4) == 0)
-      t0ptr = t0ptr + 2;
-   else
-      t0ptr++;
+   t0ptr = t0ptr + peak_nt0(stype);
    }
 
 if(rand != (float)(0.0))
    randomize(st,nt,&rand,&dt,&fzero,&seed,pos_only);
 
-if(tshift != (float)(0.0))
-   apply_tsh(st,nt,&dt,&tshift);
+if(*tshift != (float)(0.0))
+   apply_tsh(st,nt,&dt,tshift);
 
 normal(st,nt,&dt,&scale2slip);
+}
 
-strcpy(head1.stat,name);
-strcpy(head1.comp,comp);
-strcpy(head1.stitle,title);
+void set_header(struct statdata *hd,char *name,char *comp,char *title,int nt,float dt,float tshift)
+{
+memset(hd,0,sizeof(struct statdata));
+strncpy(hd->stat,name,STATCHAR-1);
+strncpy(hd->comp,comp,COMPCHAR-1);
+strncpy(hd->stitle,title,TITLCHAR-1);
 
-head1.nt = nt;
-head1.dt = dt;
+hd->nt = nt;
+hd->dt = dt;
 
-head1.hr = 0;
-head1.min = 0;
-head1.sec = -tshift;
+hd->hr = 0;
+hd->min = 0;
+hd->sec = -tshift;
 
-head1.edist = 0.0;
-head1.az = 0.0;
-head1.baz = 0.0;
+hd->edist = 0.0;
+hd->az = 0.0;
+hd->baz = 0.0;
+}
 
-write_wccseis(outfile,&head1,st,outbin);
+/* the t0 values of one peak of an STF of type stype */
+int peak_nt0(char *stype)
+{
+if(strncmp("trap",stype,4) == 0)
+   return(3);
+else if(strncmp("2tri",stype,4) == 0)
+   return(2);
+
+return(1);
+}
+
+/* the lines of stflist, see the top of the file */
+struct stfline *read_stflist(char *stflist,int nx0,int *nstf)
+{
+FILE *fpr, *fopfile();
+struct stfline *sl;
+char line[LINELEN], *pb;
+float *v;
+int n, nalloc, nv, ip, k;
+
+sl = NULL;
+n = 0;
+nalloc = 0;
+v = (float *) check_malloc (LINELEN*size_float);
+
+fpr = fopfile(stflist,"r");
+while(fgets(line,LINELEN,fpr) != NULL)
+   {
+   pb = strtok(line," \t\n");
+   if(pb == NULL || pb[0] == '#')
+      continue;
+
+   if(n == nalloc)
+      {
+      nalloc = nalloc + 1024;
+      sl = (struct stfline *) check_realloc(sl,nalloc*sizeof(struct stfline));
+      }
+
+   strncpy(sl[n].name,pb,STATCHAR-1);
+   sl[n].name[STATCHAR-1] = '\0';
+
+   nv = 0;
+   while((pb = strtok(NULL," \t\n")) != NULL && nv < LINELEN)
+      v[nv++] = atof(pb);
+
+   if(nv < nx0+3 || (nv-1)%(nx0+2) != 0)
+      {
+      fprintf(stderr,"*** bad line for %s in %s (tshift and groups of %d t0, ts, a0 expected), exiting...\n",sl[n].name,stflist,nx0);
+      exit(-1);
+      }
+
+   sl[n].tshift = v[0];
+   sl[n].npeak = (nv-1)/(nx0+2);
+   sl[n].t0 = (float *) check_malloc (sl[n].npeak*(nx0+2)*size_float);
+   sl[n].ts = sl[n].t0 + sl[n].npeak*nx0;
+   sl[n].a0 = sl[n].ts + sl[n].npeak;
+   for(ip=0;ip<sl[n].npeak;ip++)
+      {
+      for(k=0;k<nx0;k++)
+         sl[n].t0[ip*nx0 + k] = v[1 + ip*(nx0+2) + k];
+      sl[n].ts[ip] = v[1 + ip*(nx0+2) + nx0];
+      sl[n].a0[ip] = v[1 + ip*(nx0+2) + nx0 + 1];
+      }
+   n++;
+   }
+fclose(fpr);
+free(v);
+
+*nstf = n;
+return(sl);
 }
 
-makesource(type,s,dt,nt,x0,src_amp,tsh,bn)
+void makesource(type,s,dt,nt,x0,src_amp,tsh,bn)
 float *s;
 float *dt, *x0, *src_amp, *tsh;
 int nt, bn;
@@ -577,7 +749,7 @@ if(strncmp("irikura",type,7) == 0)
    }
 }
 
-zap(s,n)
+void zap(s,n)
 float *s;
 int n;
 {
@@ -587,7 +759,7 @@ for(i=0;i<n;i++)
    s[i] = 0.0;
 }
 
-apply_tsh(s,nt,dt,tsh)
+void apply_tsh(s,nt,dt,tsh)
 float *s, *dt, *tsh;
 int nt;
 {
@@ -612,7 +784,7 @@ else if(itsh < 0)
 *tsh = (*dt)*itsh;
 }
 
-normal(s,n,dt,scl)
+void normal(s,n,dt,scl)
 float *s, *dt, *scl;
 int n;
 {
@@ -663,9 +835,9 @@ rt = (float *) check_malloc (ntp2*sizeof(float));
 for(it=0;it<ntp2;it++)
    rt[it] = sfrand(seed);
 
-forfft(rt,ntp2,-1);
+forfft((struct complex *) rt,ntp2,-1);
 wfilt((struct complex *) rt,ntp2,dt,f0);
-invfft(rt,ntp2,1);
+invfft((struct complex *) rt,ntp2,1);
 
 tapl = (int)(0.5/((*f0)*(*dt)));
 for(it=0;it<tapl;it++)
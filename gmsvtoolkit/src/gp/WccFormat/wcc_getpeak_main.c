@@ -3,28 +3,199 @@
 #include "function.h"
 #include "getpar.h"
 
+#define         MAXFILES        50000
+#define         MAXCOMP         3
+#define         LINELEN         512
+
+/*
+   Batch mode: filelist= has one station per line, the names of its
+   1 to 3 component traces (pack paths allowed), or pack= takes every
+   station of a WCC pack with the components in pack order.  For each
+   station, in input order, the line is
+
+      stat edist  peak1 tpeak1 [peak2 tpeak2 peak3 tpeak3]  [vpeak tvpeak]
+
+   with peak as in the one-trace mode (scale=, keepsign=), tpeak the
+   time of the peak |s| from the start of the trace, and for more than
+   one component the peak vector amplitude (times scale) and its time.
+   nthreads= OpenMP threads share out the stations.
+*/
+
+struct pkstat
+   {
+   int ncomp;
+   char stat[STATCHAR];     /* pack= only */
+   char *name[MAXCOMP];
+   };
+
+void peak_station(int ac,char **av,struct pkstat *ps,int inbin,float scale,char *line)
+{
+struct statdata head[MAXCOMP];
+struct wccmap wm[MAXCOMP];
+float *s[MAXCOMP], *work, peak, vpeak;
+int ic, it, nt;
+char *pl;
+
+for(ic=0;ic<ps->ncomp;ic++)
+   {
+   s[ic] = NULL;
+   if(inbin)
+      {
+      s[ic] = map_wccseis(ps->name[ic],&wm[ic]);
+      head[ic] = *(wm[ic].shead);
+      }
+   else
+      s[ic] = read_wccseis(ps->name[ic],&head[ic],s[ic],inbin);
+   }
+
+pl = line;
+pl = pl + sprintf(pl,"%s %10.2f",head[0].stat,head[0].edist);
+
+nt = head[0].nt;
+for(ic=0;ic<ps->ncomp;ic++)
+   {
+   peak = wcc_getpeak(ac,av,s[ic],&head[ic]);
+   wcc_absmax(s[ic],head[ic].nt,&it);
+   pl = pl + sprintf(pl," %13.5e %10.3f",peak,it*head[ic].dt);
+
+   if(head[ic].nt < nt)
+      nt = head[ic].nt;
+   }
+
+if(ps->ncomp > 1)
+   {
+   work = (float *) check_malloc(nt*sizeof(float));
+   vpeak = wcc_vecmax(s,ps->ncomp,nt,work,&it);
+   pl = pl + sprintf(pl," %13.5e %10.3f",scale*vpeak,it*head[0].dt);
+   free(work);
+   }
+sprintf(pl,"\n");
+
+for(ic=0;ic<ps->ncomp;ic++)
+   {
+   if(inbin)
+      unmap_wccseis(&wm[ic]);
+   else
+      free(s[ic]);
+   }
+}
+
 int main(ac,av)
 int ac;
 char **av;
 {
 struct statdata head1;
+struct wccmap wm1;
+struct wccpack *wp;
+struct pkstat *ps;
 float *s1;
 char infile[128];
+char filelist[512], pack[512], str[LINELEN], *lines, *pb;
+int i, j, nst;
+FILE *fpr;
 
 int inbin = 0;
 int outbin = 0;
+int nthreads = 1;
+float scale = 1.0;
 
 sprintf(infile,"stdin");
+filelist[0] = '\0';
+pack[0] = '\0';
 
 setpar(ac,av);
 getpar("infile","s",infile);
 getpar("inbin","d",&inbin);
+getpar("filelist","s",filelist);
+getpar("pack","s",pack);
+getpar("nthreads","d",&nthreads);
+getpar("scale","f",&scale);
 endpar();
 
-s1 = NULL;
-s1 = read_wccseis(infile,&head1,s1,inbin);
+if(filelist[0] == '\0' && pack[0] == '\0')
+   {
+   s1 = NULL;
+   if(inbin)
+      {
+      s1 = map_wccseis(infile,&wm1);
+      head1 = *(wm1.shead);
+      }
+   else
+      s1 = read_wccseis(infile,&head1,s1,inbin);
+
+   float peak = wcc_getpeak(ac, av, s1, &head1);
+
+   printf("%10.2f %13.5e %s\n",head1.edist,peak,head1.stat);
+   return(0);
+   }
+
+/* the stations and the names of their components */
+
+ps = (struct pkstat *) check_malloc(MAXFILES*sizeof(struct pkstat));
+nst = 0;
+if(pack[0] != '\0')
+   {
+   wp = wccpack_open(pack,0);
+   for(i=0;i<wp->ntrace;i++)
+      {
+      if(wccpack_find(wp,wp->index[i].stat,wp->index[i].comp) != i)
+         continue;   /* replaced by a later trace */
+
+      for(j=0;j<nst;j++)
+         {
+         if(strncmp(ps[j].stat,wp->index[i].stat,STATCHAR) == 0)
+            break;
+         }
+      if(j == nst)
+         {
+         if(nst == MAXFILES)
+            continue;
+         ps[nst].ncomp = 0;
+         strncpy(ps[nst].stat,wp->index[i].stat,STATCHAR);
+         nst++;
+         }
+      if(ps[j].ncomp == MAXCOMP)
+         continue;
+
+      sprintf(str,"%s:%s/%s",pack,wp->index[i].stat,wp->index[i].comp);
+      ps[j].name[ps[j].ncomp] = (char *) check_malloc(strlen(str)+1);
+      strcpy(ps[j].name[ps[j].ncomp],str);
+      ps[j].ncomp++;
+      }
+   wccpack_close(wp);
+   }
+else
+   {
+   fpr = fopfile(filelist,"r");
+   while(fgets(str,LINELEN,fpr) != NULL && nst < MAXFILES)
+      {
+      ps[nst].ncomp = 0;
+      pb = strtok(str," \t\n");
+      while(pb != NULL && ps[nst].ncomp < MAXCOMP)
+         {
+         ps[nst].name[ps[nst].ncomp] = (char *) check_malloc(strlen(pb)+1);
+         strcpy(ps[nst].name[ps[nst].ncomp],pb);
+         ps[nst].ncomp++;
+         pb = strtok(NULL," \t\n");
+         }
+      if(ps[nst].ncomp > 0)
+         nst++;
+      }
+   fclose(fpr);
+   }
+
+/* pack traces are read with read_wccseis, which knows pack paths */
+if(pack[0] != '\0')
+   inbin = 0;
+
+lines = (char *) check_malloc((size_t)(nst)*LINELEN);
+
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic,1)
+for(i=0;i<nst;i++)
+   peak_station(ac,av,&ps[i],inbin,scale,lines+(size_t)(i)*LINELEN);
 
-float peak = wcc_getpeak(ac, av, s1, &head1);
+for(i=0;i<nst;i++)
+   fputs(lines+(size_t)(i)*LINELEN,stdout);
 
-printf("%10.2f %13.5e %s\n",head1.edist,peak,head1.stat);
+return(0);
 }
@@ -3,28 +3,128 @@
 #include "function.h"
 #include "getpar.h"
 
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+/*
+	Shared peak primitives.  The reductions run four samples at a
+	time with SSE (scalar elsewhere); max and min are exact, so the
+	results are those of the plain loops.
+*/
+
+/* smallest and largest value of s[0..nt-1] */
+void wcc_minmax(float *s, int nt, float *min, float *max) {
+	float mn = 1.0e+20;
+	float mx = -1.0e+20;
+	int i = 0;
+
+#if defined(__SSE__)
+	if(nt >= 8)
+	   {
+	   __m128 vmn = _mm_loadu_ps(s);
+	   __m128 vmx = vmn;
+	   float t[4];
+
+	   for(i=4;i+4<=nt;i=i+4)
+	      {
+	      __m128 x = _mm_loadu_ps(s+i);
+	      vmn = _mm_min_ps(vmn,x);
+	      vmx = _mm_max_ps(vmx,x);
+	      }
+	   _mm_storeu_ps(t,vmn);
+	   mn = t[0];
+	   if(t[1] < mn) mn = t[1];
+	   if(t[2] < mn) mn = t[2];
+	   if(t[3] < mn) mn = t[3];
+	   _mm_storeu_ps(t,vmx);
+	   mx = t[0];
+	   if(t[1] > mx) mx = t[1];
+	   if(t[2] > mx) mx = t[2];
+	   if(t[3] > mx) mx = t[3];
+	   if(mn > 1.0e+20) mn = 1.0e+20;
+	   if(mx < -1.0e+20) mx = -1.0e+20;
+	   }
+#endif
+
+	for(;i<nt;i++)
+	   {
+	   if(s[i] > mx)
+	      mx = s[i];
+	   if(s[i] < mn)
+	      mn = s[i];
+	   }
+
+	*min = mn;
+	*max = mx;
+}
+
+/*
+	peak |s| over s[0..nt-1]; if imax is not NULL it gets the index of
+	the first sample with that |s| (-1 if nt < 1)
+*/
+float wcc_absmax(float *s, int nt, int *imax) {
+	float mn, mx, amax;
+	int i;
+
+	if(nt < 1)
+	   {
+	   if(imax != NULL)
+	      *imax = -1;
+	   return(0.0);
+	   }
+
+	wcc_minmax(s,nt,&mn,&mx);
+	amax = mx;
+	if(-mn > amax)
+	   amax = -mn;
+
+	if(imax != NULL)
+	   {
+	   for(i=0;i<nt;i++)
+	      {
+	      if(s[i] == amax || -s[i] == amax)
+	         break;
+	      }
+	   *imax = i;
+	   }
+	return(amax);
+}
+
+/*
+	peak vector amplitude sqrt(s[0][i]^2 + ... ) of ncomp components of
+	nt samples, index of the first peak in imax (if not NULL); work is
+	space for nt floats
+*/
+float wcc_vecmax(float **s, int ncomp, int nt, float *work, int *imax) {
+	int i, ic;
+
+	for(i=0;i<nt;i++)
+	   work[i] = 0.0;
+	for(ic=0;ic<ncomp;ic++)
+	   {
+	   for(i=0;i<nt;i++)
+	      work[i] = work[i] + s[ic][i]*s[ic][i];
+	   }
+
+	return(sqrt(wcc_absmax(work,nt,imax)));
+}
+
 float wcc_getpeak(int param_string_len, char** param_string, float* s1, struct statdata* head1) {
+	gp_ctx *gp;
 	float amax;
-	int i;
 
-	float max = -1.0e+20;
-	float min = 1.0e+20;
+	float max, min;
 	int keepsign = 0;
 	float scale = 1.0;
 
-	setpar(param_string_len, param_string);
-	getpar("keepsign","d",&keepsign);
-	getpar("scale","f",&scale);
-	endpar();
- 
-	for(i=0;i<head1->nt;i++)
-	   {
-	   if(s1[i] > max)
-	      max = s1[i];
-	   if(s1[i] < min)
-	      min = s1[i];
-	   }
-	 
+	gp = gp_setpar(param_string_len, param_string);
+	gp_getpar(gp,"keepsign","d",&keepsign);
+	gp_getpar(gp,"scale","f",&scale);
+	gp_endpar(gp);
+
+	wcc_minmax(s1,head1->nt,&min,&max);
+
 	if(max >= 0.0 && min < 0.0)
 	   {
 	   if(max > -min)
@@ -36,10 +136,10 @@ float wcc_getpeak(int param_string_len, char** param_string, float* s1, struct s
 	         amax = -amax;
 	      }
 	   }
-	
+
 	else if(max >= 0.0 && min >= 0.0)
 	   amax = max;
-	
+
 	else if(max < 0.0 && min < 0.0)
 	   {
 	   amax = -min;
@@ -3,6 +3,7 @@
 #include "function.h"
 
 void integrate(float *,int,float *);
+void set_window(struct statdata *,float,float,int *,int *);
 
 int size_float = sizeof(float);
 int size_int = sizeof(int);
@@ -11,7 +12,7 @@ main(int ac, char **av)
 {
 struct statdata head1;
 float *s1;
-int i, itst, itend;
+int i, itst, itend, ns;
 float sum;
 
 int n_integ = 0;
@@ -38,44 +39,63 @@ getpar("inbin","d",&inbin);
 getpar("outbin","d",&outbin);
 endpar();
 
+/*
+   Without integration only the samples averaged are read (by default
+   just the last one); integrating needs the whole trace.
+*/
 s1 = NULL;
-s1 = read_wccseis(infile,&head1,s1,inbin);
-
-if(n_integ) /*  integrate  */
+if(n_integ == 0 && read_wcchead(infile,&head1,inbin))
    {
+   set_window(&head1,tstart,tlen,&itst,&itend);
+   s1 = read_wccrange(infile,&head1,s1,inbin,itst,itend,1,&ns);
+   }
+else
+   {
+   s1 = read_wccseis(infile,&head1,s1,inbin);
    for(i=0;i<n_integ;i++)
       integrate(s1,head1.nt,&head1.dt);
-   }
 
-itst = head1.nt - 1;
-if(tstart > 0.0)
-   itst = (int)(0.5 + tstart/head1.dt);
-
-if(itst > head1.nt - 1)
-   itst = head1.nt - 1;
-
-itend = head1.nt;
-if(tlen > 0.0)
-   itend = itst + (int)(0.5 + tlen/head1.dt) + 1;
-
-if(itend > head1.nt)
-   itend = head1.nt;
+   set_window(&head1,tstart,tlen,&itst,&itend);
+   s1 = s1 + itst;
+   ns = itend - itst;
+   }
 
 sum = 0.0;
-for(i=itst;i<itend;i++)
+for(i=0;i<ns;i++)
    sum = sum + s1[i];
 
 sum = sum/(itend - itst);
 
-for(i=0;i<head1.nt;i++)
-   s1[i] = sum;
-
 if(print2file)
+   {
+   s1 = (float *) check_malloc(head1.nt*sizeof(float));
+   for(i=0;i<head1.nt;i++)
+      s1[i] = sum;
+
    write_wccseis(outfile,&head1,s1,outbin);
+   }
 else
    fprintf(stdout,"%13.5e\n",sum);
 }
 
+/* the samples [itst,itend) averaged, see tstart= and tlen= */
+void set_window(struct statdata *hd,float tstart,float tlen,int *itst,int *itend)
+{
+*itst = hd->nt - 1;
+if(tstart > 0.0)
+   *itst = (int)(0.5 + tstart/hd->dt);
+
+if(*itst > hd->nt - 1)
+   *itst = hd->nt - 1;
+
+*itend = hd->nt;
+if(tlen > 0.0)
+   *itend = *itst + (int)(0.5 + tlen/hd->dt) + 1;
+
+if(*itend > hd->nt)
+   *itend = hd->nt;
+}
+
 void integrate(float *s,int nt,float *dt)
 {
 float s0, s1;
@@ -0,0 +1,234 @@
+/**********************************************************************/
+/*                                                                    */
+/*           wcc_gfsum                                                */
+/*                                                                    */
+/*           Sums many time shifted and scaled traces, typically the  */
+/*           subfault Green's functions of one station, into one      */
+/*           trace in memory, in place of a chain of wcc_add runs.    */
+/*           termlist= has one term per line,                         */
+/*                                                                    */
+/*              name tshift [scale]                                   */
+/*                                                                    */
+/*           name a WCC trace (pack paths "pack:stat/comp" allowed),  */
+/*           tshift added to its header start time and scale (default */
+/*           1) its factor.  With gfbank= the terms are subfaults of  */
+/*           a Green's function bank (the file of subgf2wcc),         */
+/*                                                                    */
+/*              isub tshift [scale]                                   */
+/*                                                                    */
+/*           and each component is summed, into outfile.000,          */
+/*           outfile.090 and outfile.ver.                             */
+/*                                                                    */
+/*           The output starts at the earliest term.  fshift=1        */
+/*           (default) shifts each term to its exact time, the        */
+/*           fraction of a sample in the frequency domain; fshift=0   */
+/*           rounds to the nearest sample as wcc_add does.            */
+/*           nthreads= OpenMP threads share out the terms.            */
+/*                                                                    */
+/**********************************************************************/
+
+#include "include.h"
+#include "structure.h"
+#include "function.h"
+#include "getpar.h"
+
+#define         LINELEN         1024
+
+int size_float = sizeof(float);
+int size_int = sizeof(int);
+
+struct termline
+   {
+   char name[LINELEN];
+   int isub;
+   float tshift, scale;
+   };
+
+struct termline *read_termlist(char *termlist,int bank,int *nterm)
+{
+struct termline *tl;
+char line[LINELEN], str[LINELEN];
+int n, nalloc, na;
+float tsh, sc;
+FILE *fpr;
+
+tl = NULL;
+n = 0;
+nalloc = 0;
+fpr = fopfile(termlist,"r");
+while(fgets(line,LINELEN,fpr) != NULL)
+   {
+   sc = 1.0;
+   na = sscanf(line,"%1023s %f %f",str,&tsh,&sc);
+   if(na < 2 || str[0] == '#')
+      continue;
+
+   if(n == nalloc)
+      {
+      nalloc = nalloc + 1024;
+      tl = (struct termline *) check_realloc(tl,nalloc*sizeof(struct termline));
+      }
+
+   strcpy(tl[n].name,str);
+   tl[n].isub = -1;
+   if(bank && sscanf(str,"%d",&tl[n].isub) != 1)
+      {
+      fprintf(stderr,"*** bad subfault '%s' in %s, exiting...\n",str,termlist);
+      exit(-1);
+      }
+   tl[n].tshift = tsh;
+   tl[n].scale = sc;
+   n++;
+   }
+fclose(fpr);
+
+*nterm = n;
+return(tl);
+}
+
+int main(int ac,char **av)
+{
+struct termline *tl;
+struct gfterm *tm;
+struct statdata *th, hd, sh[3];
+float *p, **sgf[3];
+char termlist[LINELEN], gfbank[LINELEN], outfile[LINELEN], ofile[LINELEN+8];
+char stat[STATCHAR], comp[COMPCHAR];
+int i, j, nterm, nsub, nc, fdr;
+
+static char *gfcomp[] = {"000","090","ver"};
+
+int inbin = 0;
+int outbin = 0;
+int fshift = 1;
+int nthreads = 1;
+
+gfbank[0] = '\0';
+stat[0] = '\0';
+comp[0] = '\0';
+
+setpar(ac,av);
+mstpar("termlist","s",termlist);
+mstpar("outfile","s",outfile);
+getpar("gfbank","s",gfbank);
+getpar("inbin","d",&inbin);
+getpar("outbin","d",&outbin);
+getpar("fshift","d",&fshift);
+getpar("nthreads","d",&nthreads);
+getpar("stat","s",stat);
+getpar("comp","s",comp);
+endpar();
+
+tl = read_termlist(termlist,gfbank[0] != '\0',&nterm);
+if(nterm < 1)
+   {
+   fprintf(stderr,"*** no terms in %s, exiting...\n",termlist);
+   exit(-1);
+   }
+
+tm = (struct gfterm *) check_malloc(nterm*sizeof(struct gfterm));
+
+if(gfbank[0] == '\0')
+   {
+   th = (struct statdata *) check_malloc(nterm*sizeof(struct statdata));
+
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic,16)
+   for(i=0;i<nterm;i++)
+      {
+      tm[i].s = NULL;
+      tm[i].s = read_wccseis(tl[i].name,&th[i],tm[i].s,inbin);
+      tm[i].nt = th[i].nt;
+      tm[i].dt = th[i].dt;
+      tm[i].t = th[i].hr*3600.0 + th[i].min*60.0 + th[i].sec + tl[i].tshift;
+      tm[i].scale = tl[i].scale;
+      }
+
+   p = wcc_gfsum(tm,nterm,fshift,nthreads,&hd);
+
+   strncpy(hd.stat,th[0].stat,STATCHAR);
+   strncpy(hd.comp,th[0].comp,COMPCHAR);
+   if(stat[0] != '\0')
+      strncpy(hd.stat,stat,STATCHAR);
+   if(comp[0] != '\0')
+      strncpy(hd.comp,comp,COMPCHAR);
+   sprintf(hd.stitle,"summed output");
+   hd.edist = th[0].edist;
+   hd.az = th[0].az;
+   hd.baz = th[0].baz;
+
+   write_wccseis(outfile,&hd,p,outbin);
+   exit(0);
+   }
+
+/* the bank, read once up to the last subfault used */
+
+nsub = 0;
+for(i=0;i<nterm;i++)
+   {
+   if(tl[i].isub < 0)
+      {
+      fprintf(stderr,"*** subfault %d < 0, exiting...\n",tl[i].isub);
+      exit(-1);
+      }
+   if(tl[i].isub+1 > nsub)
+      nsub = tl[i].isub+1;
+   }
+
+th = (struct statdata *) check_malloc(3*nsub*sizeof(struct statdata));
+for(j=0;j<3;j++)
+   {
+   sgf[j] = (float **) check_malloc(nsub*sizeof(float *));
+   for(i=0;i<nsub;i++)
+      sgf[j][i] = NULL;
+   }
+
+fdr = opfile_ro(gfbank);
+nc = 3;
+for(i=0;i<nsub;i++)
+   {
+   float *gf[3];
+
+   gf[0] = gf[1] = gf[2] = NULL;
+   j = read_subgf(fdr,sh,gf);
+   if(j < nc)
+      nc = j;
+   for(j=0;j<3;j++)
+      {
+      sgf[j][i] = gf[j];
+      th[3*i+j] = sh[j];
+      }
+   }
+close(fdr);
+
+if(stat[0] == '\0')
+   sprintf(stat,"gfsum");
+
+for(j=0;j<nc;j++)
+   {
+   for(i=0;i<nterm;i++)
+      {
+      struct statdata *h = &th[3*tl[i].isub+j];
+
+      tm[i].s = sgf[j][tl[i].isub];
+      tm[i].nt = h->nt;
+      tm[i].dt = h->dt;
+      tm[i].t = h->hr*3600.0 + h->min*60.0 + h->sec + tl[i].tshift;
+      tm[i].scale = tl[i].scale;
+      }
+
+   p = wcc_gfsum(tm,nterm,fshift,nthreads,&hd);
+
+   strncpy(hd.stat,stat,STATCHAR);
+   strcpy(hd.comp,gfcomp[j]);
+   sprintf(hd.stitle,"summed output");
+   hd.edist = th[3*tl[0].isub+j].edist;
+   hd.az = 0.0;
+   hd.baz = 0.0;
+
+   sprintf(ofile,"%s.%s",outfile,gfcomp[j]);
+   write_wccseis(ofile,&hd,p,outbin);
+   free(p);
+   }
+
+exit(0);
+}
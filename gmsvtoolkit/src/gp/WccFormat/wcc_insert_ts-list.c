@@ -4,9 +4,21 @@
 
 #define MAXL 1024
 
+#define TS_GAPMAX       4096     /* largest gap (floats) inside a write group */
+#define TS_MAXSPAN      4194304  /* largest span (floats) of a write group */
+
 int size_float = sizeof(float);
 float float_swap(char *);
 
+struct tsinsert    /* one station to insert in the time-slice file */
+   {
+   off_t ip;       /* ixp + iyp*nx */
+   int order;      /* position in the list, later entries win */
+   char seisfile[3][128];
+   };
+
+void insert_stations(int,struct tsheader *,struct tsinsert *,int,size_t,int);
+
 main(int ac, char **av)
 {
 FILE *fpr, *fopfile();
@@ -14,8 +26,8 @@ struct statdata head1, head2, head3;
 struct tsheader tshead;
 float *s1, *s2, *s3, *sbuf, *sptr1, *sptr2, *sptr3;
 int i, it, ixp, iyp;
-off_t np1_byte, off1, off2, off3, slen;
-int fdr, fdw1, fdw2, fdw3;
+off_t np1_byte, slen;
+int fdr, fdw1;
 char filelist[128], str[MAXL];
 char seisfile1[128], seisfile2[128], seisfile3[128];
 char in_tsfile[128], out_tsfile[128];
@@ -29,6 +41,10 @@ int nt = -1;
 int intmem = 0;
 int endlist = 0;
 
+struct tsinsert *slist;
+int ns, maxs;
+int max_mem = 256;
+
 filelist[0] = '\0';
 
 setpar(ac, av);
@@ -44,6 +60,7 @@ if(zero_tsfile == 0)
    {
    getpar("intmem","d",&intmem);
    getpar("filelist","s",filelist);
+   getpar("max_mem","d",&max_mem);
 
    if(filelist[0] == '\0')
       {
@@ -90,17 +107,18 @@ if(zero_tsfile == 1)
    if(dt > 0)
       tshead.dt = dt;
 
-   s1 = (float *) check_malloc(3*tshead.nt*size_float);
-   for(it=0;it<tshead.nt;it++)
-      s1[it] = 0.0;
-
    fdw1 = croptrfile(out_tsfile);
 
    fprintf(stderr,"nx= %d ny= %d nt= %d\n",tshead.nx,tshead.ny,tshead.nt);
 
+   /* the zeros are left to the filesystem: the file is sized, not written */
+
    rite(fdw1,&tshead,sizeof(struct tsheader));
-   for(i=0;i<tshead.nx*tshead.ny*tshead.nz;i++)
-      rite(fdw1,s1,3*tshead.nt*size_float);
+   if(ftruncate(fdw1,sizeof(struct tsheader) + (off_t)(3*tshead.nt)*tshead.nx*tshead.ny*tshead.nz*size_float) != 0)
+      {
+      fprintf(stderr,"can't set size of %s, exiting ...\n",out_tsfile);
+      exit(-1);
+      }
 
    close(fdw1);
    }
@@ -206,12 +224,6 @@ else
       fdw1 = opfile(out_tsfile);
       reed(fdw1,&tshead,sizeof(struct tsheader));
 
-      fdw2 = opfile(out_tsfile);
-      reed(fdw2,&tshead,sizeof(struct tsheader));
-
-      fdw3 = opfile(out_tsfile);
-      reed(fdw3,&tshead,sizeof(struct tsheader));
-
       if(swap_bytes)
          {
          swap_in_place(1,(char *)(&tshead.ix0));
@@ -233,76 +245,197 @@ else
 
       fprintf(stderr,"nx= %d ny= %d nt= %d\n",tshead.nx,tshead.ny,tshead.nt);
 
+      maxs = 1;
+      slist = (struct tsinsert *) check_malloc (maxs*sizeof(struct tsinsert));
+
+      ns = 0;
       if(filelist[0] != '\0')
          {
 	 fpr = fopfile(filelist,"r");
-	 if(fgets(str,MAXL,fpr) == NULL)
+	 while(fgets(str,MAXL,fpr) != NULL)
 	    {
-	    endlist = 1;
-	    fclose(fpr);
-	    }
-	 else
+	    if(ns == maxs)
+	       {
+	       maxs = 2*maxs;
+	       slist = (struct tsinsert *) check_realloc (slist,maxs*sizeof(struct tsinsert));
+	       }
+
 	    sscanf(str,"%d %d %s %s %s",&ixp,&iyp,seisfile1,seisfile2,seisfile3);
-	 }
 
-      endlist = 0;
-      while(endlist == 0)
+	    slist[ns].ip = ixp + (off_t)(iyp)*tshead.nx;
+	    slist[ns].order = ns;
+	    strcpy(slist[ns].seisfile[0],seisfile1);
+	    strcpy(slist[ns].seisfile[1],seisfile2);
+	    strcpy(slist[ns].seisfile[2],seisfile3);
+	    ns++;
+	    }
+	 fclose(fpr);
+	 }
+      else
          {
-         s1 = NULL;
-         s1 = read_wccseis(seisfile1,&head1,s1,inbin);
+	 slist[0].ip = ixp + (off_t)(iyp)*tshead.nx;
+	 slist[0].order = 0;
+	 strcpy(slist[0].seisfile[0],seisfile1);
+	 strcpy(slist[0].seisfile[1],seisfile2);
+	 strcpy(slist[0].seisfile[2],seisfile3);
+	 ns = 1;
+	 }
 
-         s2 = NULL;
-         s2 = read_wccseis(seisfile2,&head2,s2,inbin);
+      insert_stations(fdw1,&tshead,slist,ns,(size_t)(max_mem)*1048576,inbin);
 
-         s3 = NULL;
-         s3 = read_wccseis(seisfile3,&head3,s3,inbin);
+      free(slist);
+      close(fdw1);
+      }
+   }
+}
 
-         np1_byte = (3*tshead.nx*tshead.ny - 1)*size_float;
+int cmp_tsinsert(const void *a,const void *b)
+{
+const struct tsinsert *sa = (const struct tsinsert *) a;
+const struct tsinsert *sb = (const struct tsinsert *) b;
 
-         off1 = (ixp + iyp*tshead.nx)*size_float;
-         lseek(fdw1,off1,SEEK_CUR);
+if(sa->ip != sb->ip)
+   return((sa->ip < sb->ip) ? -1 : 1);
 
-         off2 = (tshead.nx*tshead.ny + ixp + iyp*tshead.nx)*size_float;
-         lseek(fdw2,off2,SEEK_CUR);
+return(sa->order - sb->order);
+}
 
-         off3 = (2*tshead.nx*tshead.ny + ixp + iyp*tshead.nx)*size_float;
-         lseek(fdw3,off3,SEEK_CUR);
+/*
+   Positioned transfers of len bytes that carry on after short counts.
+   A read that runs past the end of the file returns the zeros that are
+   there after the file is extended, as the holes of a sparse file.
+*/
+void preed(int fd,char *buf,size_t len,off_t off)
+{
+ssize_t nr;
 
-         for(it=0;it<tshead.nt;it++)
-            {
-            rite(fdw1,&s1[it],size_float);
-            lseek(fdw1,np1_byte,SEEK_CUR);
+while(len > 0)
+   {
+   nr = pread(fd,buf,len,off);
+   if(nr < 0 && errno == EINTR)
+      continue;
+   if(nr < 0)
+      {
+      fprintf(stderr,"READ ERROR\n");
+      exit(-1);
+      }
+   if(nr == 0)
+      {
+      memset(buf,0,len);
+      return;
+      }
 
-            rite(fdw2,&s2[it],size_float);
-            lseek(fdw2,np1_byte,SEEK_CUR);
+   buf = buf + nr;
+   off = off + nr;
+   len = len - nr;
+   }
+}
 
-            rite(fdw3,&s3[it],size_float);
-            lseek(fdw3,np1_byte,SEEK_CUR);
-            }
+void prite(int fd,char *buf,size_t len,off_t off)
+{
+ssize_t nw;
 
-         if(filelist[0] != '\0')
-            {
-            lseek(fdw1,sizeof(struct tsheader),SEEK_SET);
-            lseek(fdw2,sizeof(struct tsheader),SEEK_SET);
-            lseek(fdw3,sizeof(struct tsheader),SEEK_SET);
+while(len > 0)
+   {
+   nw = pwrite(fd,buf,len,off);
+   if(nw < 0 && errno == EINTR)
+      continue;
+   if(nw <= 0)
+      {
+      fprintf(stderr,"WRITE ERROR\n");
+      fprintf(stderr,"%lld attempted  %lld written\n",(long long)(len),(long long)(nw));
+      exit(-1);
+      }
 
-	    if(fgets(str,MAXL,fpr) == NULL)
-	       {
-	       endlist = 1;
-	       fclose(fpr);
-	       }
-	    else
-	       sscanf(str,"%d %d %s %s %s",&ixp,&iyp,seisfile1,seisfile2,seisfile3);
-	    }
-	 else
-	    endlist = 1;
+   buf = buf + nw;
+   off = off + nw;
+   len = len - nw;
+   }
+}
+
+/*
+   Inserts the ns stations of sl[] in the time-slice file fdw.  The
+   stations are sorted by grid position and taken in groups of nearby
+   points whose traces fit in max_mem bytes; for every time step and
+   component the span of the group is then read, patched and written
+   back with one pread() and one pwrite() (no read when the group fills
+   its span), instead of one seek and 4 byte write per sample.  A point
+   listed more than once gets the last of its traces, as before.
+*/
+void insert_stations(int fdw,struct tsheader *tsh,struct tsinsert *sl,int ns,size_t max_mem,int inbin)
+{
+struct statdata head;
+float **s, *band;
+off_t nxy, ip0, span, maxspan, off;
+int i0, i1, ig, ic, it, ng, maxg, nfull;
+
+nxy = (off_t)(tsh->nx)*tsh->ny;
+
+qsort(sl,ns,sizeof(struct tsinsert),cmp_tsinsert);
+
+maxg = max_mem/(3*tsh->nt*size_float);
+if(maxg < 1)
+   maxg = 1;
+
+maxspan = 1;
+for(i0=0;i0<ns;i0=i1)
+   {
+   i1 = i0 + 1;
+   while(i1 < ns && i1 - i0 < maxg && sl[i1].ip - sl[i1-1].ip <= TS_GAPMAX && sl[i1].ip - sl[i0].ip < TS_MAXSPAN)
+      i1++;
+
+   if(sl[i1-1].ip - sl[i0].ip + 1 > maxspan)
+      maxspan = sl[i1-1].ip - sl[i0].ip + 1;
+   }
+
+band = (float *) check_malloc (maxspan*size_float);
+s = (float **) check_malloc (3*maxg*sizeof(float *));
+
+for(i0=0;i0<ns;i0=i1)
+   {
+   i1 = i0 + 1;
+   while(i1 < ns && i1 - i0 < maxg && sl[i1].ip - sl[i1-1].ip <= TS_GAPMAX && sl[i1].ip - sl[i0].ip < TS_MAXSPAN)
+      i1++;
+
+   ng = i1 - i0;
+   ip0 = sl[i0].ip;
+   span = sl[i1-1].ip - ip0 + 1;
+
+   nfull = 1;
+   for(ig=0;ig<ng;ig++)
+      {
+      if(ig > 0 && sl[i0+ig].ip - sl[i0+ig-1].ip > 1)
+         nfull = 0;
+
+      for(ic=0;ic<3;ic++)
+         {
+         s[3*ig+ic] = NULL;
+         s[3*ig+ic] = read_wccseis(sl[i0+ig].seisfile[ic],&head,s[3*ig+ic],inbin);
 	 }
+      }
 
-      close(fdw1);
-      close(fdw2);
-      close(fdw3);
+   for(it=0;it<tsh->nt;it++)
+      {
+      for(ic=0;ic<3;ic++)
+         {
+         off = sizeof(struct tsheader) + ((off_t)(3*it+ic)*nxy + ip0)*size_float;
+
+	 if(nfull == 0)
+	    preed(fdw,(char *)(band),span*size_float,off);
+
+	 for(ig=0;ig<ng;ig++)
+	    band[sl[i0+ig].ip - ip0] = s[3*ig+ic][it];
+
+	 prite(fdw,(char *)(band),span*size_float,off);
+	 }
       }
+
+   for(ig=0;ig<3*ng;ig++)
+      free(s[ig]);
    }
+
+free(band);
+free(s);
 }
 
 long long_swap(char *cbuf)
@@ -336,21 +469,3 @@ f_union.cval[0] = cbuf[3];
 
 return(f_union.fval);
 }
-
-void swap_in_place(int n,char *cbuf)
-{
-char cv;
-
-while(n--)
-   {
-   cv = cbuf[0];
-   cbuf[0] = cbuf[3];
-   cbuf[3] = cv;
-
-   cv = cbuf[1];
-   cbuf[1] = cbuf[2];
-   cbuf[2] = cv;
-
-   cbuf = cbuf + 4;
-   }
-}
@@ -0,0 +1,663 @@
+/**********************************************************************/
+/*                                                                    */
+/*           wcc_peakmap                                              */
+/*                                                                    */
+/*           Gridded peak motion maps straight from the seismograms.  */
+/*           The stations of statfile (lines of lon lat stat) are     */
+/*           projected in one call (gcproj_batch() of ModelCords, as  */
+/*           ll2xy geoproj=1 mlon= mlat= xazim=) onto the grid of nx  */
+/*           by ny nodes h km apart, each node getting the station    */
+/*           closest to it within h/2.  Only those stations are       */
+/*           read: the traces stat/comp of the WCC pack pack= (mapped */
+/*           once), or the files inroot/stat.comp (inbin=).  The      */
+/*           stations are shared out over nthreads= OpenMP threads.   */
+/*                                                                    */
+/*           ims= is a list of                                        */
+/*                                                                    */
+/*              pga pgv pgd  the peak of the comps= components,       */
+/*                           derived or integrated from intype=       */
+/*                           (acc, vel or disp) as integ_diff does    */
+/*                           and combined by comb= (max, geom, the    */
+/*                           geometric mean, or vector)               */
+/*              psa          RotD50 of the first two components       */
+/*                           (librotd, 5% damping) at each of         */
+/*                           periods=                                 */
+/*                                                                    */
+/*           Each map is written to outroot.<im>.bin (psa:            */
+/*           outroot.psa<period>.bin), ny rows of nx floats from the  */
+/*           x, y origin row by row, nodata= where there is no        */
+/*           station, e.g. for GMT                                    */
+/*                                                                    */
+/*              gmt xyz2grd map.pgv.bin -ZBLf -R0/xmax/0/ymax -Ih     */
+/*                 -di-99 -Gmap.pgv.grd                               */
+/*                                                                    */
+/*           with center_origin=1 the grid is centered on mlon, mlat. */
+/*                                                                    */
+/**********************************************************************/
+
+#include "include.h"
+#include "structure.h"
+#include "function.h"
+#include "getpar.h"
+#include "rotdlib.h"
+#include "../ModelCords/function.h"
+
+#define         PM_ERAD         6378.139
+#define         PM_MAXCOMP      3
+#define         PM_MAXPER       64
+#define         PM_CHUNK        256     /* stations per RotD batch */
+#define         PM_LINE         1024
+
+/* integ_diff_sub.c */
+void integrate(float *,int,float *,float *);
+void differ(float *,int,float *,float *);
+
+/* the map choices */
+struct pm_par
+   {
+   int npk;                 /* peak maps, pk_order[] of each */
+   int pk_order[3];
+   char pk_name[3][8];
+   int intype;              /* 0 disp, 1 vel, 2 acc, as pk_order */
+   int comb;                /* 0 max, 1 geom, 2 vector */
+   int nper;                /* psa periods, 0 for no psa maps */
+   float per[PM_MAXPER];
+   int ncomp;
+   char comp[PM_MAXCOMP][COMPCHAR];
+   };
+
+/* the traces of a station */
+struct pm_station
+   {
+   char stat[STATCHAR];
+   struct statdata hd[PM_MAXCOMP];
+   float *s[PM_MAXCOMP];    /* into the pack mapping, or malloc'd */
+   };
+
+/* sorted index of the pack, see pm_find() */
+struct pm_key
+   {
+   char stat[STATCHAR];
+   char comp[COMPCHAR];
+   int itr;
+   long long offset;        /* of the trace's statdata in the pack */
+   };
+
+int size_float = sizeof(float);
+int size_int = sizeof(int);
+
+static int pm_key_cmp(const void *a,const void *b)
+{
+const struct pm_key *ka = (const struct pm_key *) a;
+const struct pm_key *kb = (const struct pm_key *) b;
+int c;
+
+if((c = strncmp(ka->stat,kb->stat,STATCHAR)) != 0)
+   return(c);
+if((c = strncmp(ka->comp,kb->comp,COMPCHAR)) != 0)
+   return(c);
+return(kb->itr - ka->itr);  /* the latest first, it replaces the others */
+}
+
+void pm_parse(struct pm_par *,char *,char *,char *,char *,char *);
+struct pm_key *pm_find(struct pm_key *,int,char *,char *);
+int pm_load(struct pm_station *,struct pm_par *,struct pm_key *,int,char *,char *,int);
+void pm_unload(struct pm_station *,struct pm_par *,char *);
+void pm_peaks(struct pm_station *,struct pm_par *,float *);
+void pm_accel(struct pm_station *,struct pm_par *,float *,float *);
+void pm_write(char *,char *,float *,int,int);
+
+int main(int ac,char **av)
+{
+FILE *fpr;
+struct pm_par pp;
+struct pm_station *st;
+struct pm_key *key;
+struct wccpack *wp;
+struct stat sbuf;
+float *slon, *slat, *sx, *sy, *node_d, *val, *map, *acc1, *acc2, *psa_n, *psa_e, *rotd;
+float d, fx, fy, mrot, xshift, yshift, pct, erad;
+double amat[9], ainv[9], g0, b0;
+int i, ig, ix, iy, ns, nalloc, nw, nmap, im, ip, i0, i1, j, npts, nbad, ib;
+int *node_s, *wsta;
+char (*sname)[STATCHAR];
+char *pmap;
+size_t plen;
+char statfile[512], pack[512], inroot[512], outroot[512], str[PM_LINE];
+char ims[256], comps[256], intype[16], comb[16], periods[1024], name[64];
+
+float mlon, mlat;
+float xazim = 90.0;
+int nx, ny;
+float h = 1.0;
+int center_origin = 0;
+int inbin = 0;
+float nodata = -99.0;
+int nthreads = 1;
+
+pack[0] = '\0';
+inroot[0] = '\0';
+sprintf(ims,"pgv");
+sprintf(comps,"000,090");
+sprintf(intype,"vel");
+sprintf(comb,"max");
+periods[0] = '\0';
+
+setpar(ac,av);
+mstpar("statfile","s",statfile);
+mstpar("outroot","s",outroot);
+mstpar("mlon","f",&mlon);
+mstpar("mlat","f",&mlat);
+mstpar("nx","d",&nx);
+mstpar("ny","d",&ny);
+getpar("h","f",&h);
+getpar("xazim","f",&xazim);
+getpar("center_origin","d",&center_origin);
+getpar("pack","s",pack);
+getpar("inroot","s",inroot);
+getpar("inbin","d",&inbin);
+getpar("ims","s",ims);
+getpar("comps","s",comps);
+getpar("intype","s",intype);
+getpar("comb","s",comb);
+getpar("periods","s",periods);
+getpar("nodata","f",&nodata);
+getpar("nthreads","d",&nthreads);
+endpar();
+
+if((pack[0] == '\0') == (inroot[0] == '\0'))
+   {
+   fprintf(stderr,"*** give one of pack= and inroot=, exiting...\n");
+   exit(-1);
+   }
+if(nx < 1 || ny < 1 || h <= 0.0)
+   {
+   fprintf(stderr,"*** nx= %d ny= %d h= %f, exiting...\n",nx,ny,h);
+   exit(-1);
+   }
+
+pm_parse(&pp,ims,comps,intype,comb,periods);
+
+/* the stations, projected in one call */
+slon = NULL;
+slat = NULL;
+sname = NULL;
+ns = 0;
+nalloc = 0;
+
+fpr = fopfile(statfile,"r");
+while(fgets(str,PM_LINE,fpr) != NULL)
+   {
+   if(ns == nalloc)
+      {
+      nalloc = nalloc + 4096;
+      slon = (float *) check_realloc(slon,nalloc*sizeof(float));
+      slat = (float *) check_realloc(slat,nalloc*sizeof(float));
+      sname = check_realloc(sname,nalloc*STATCHAR);
+      }
+
+   if(sscanf(str,"%f %f %63s",&slon[ns],&slat[ns],name) < 3 || str[0] == '#')
+      continue;
+   strncpy(sname[ns],name,STATCHAR-1);
+   sname[ns][STATCHAR-1] = '\0';
+   ns++;
+   }
+fclose(fpr);
+
+sx = (float *) check_malloc((ns+1)*sizeof(float));
+sy = (float *) check_malloc((ns+1)*sizeof(float));
+
+mrot = xazim - 90.0;
+gen_matrices(amat,ainv,&mrot,&mlon,&mlat);
+g0 = 0.0;
+b0 = 0.0;
+erad = PM_ERAD;
+gcproj_batch(sx,sy,slon,slat,ns,&erad,&g0,&b0,amat,ainv,1);
+
+xshift = 0.0;
+yshift = 0.0;
+if(center_origin != 0)
+   {
+   xshift = -0.5*(nx-1)*h;
+   yshift = -0.5*(ny-1)*h;
+   }
+
+/* the station closest to each node, the first one on ties */
+node_s = (int *) check_malloc(nx*ny*sizeof(int));
+node_d = (float *) check_malloc(nx*ny*sizeof(float));
+for(ig=0;ig<nx*ny;ig++)
+   node_s[ig] = -1;
+
+for(i=0;i<ns;i++)
+   {
+   fx = (sx[i] - xshift)/h;
+   fy = (sy[i] - yshift)/h;
+   ix = (int)(floor(fx + 0.5));
+   iy = (int)(floor(fy + 0.5));
+   if(ix < 0 || ix >= nx || iy < 0 || iy >= ny)
+      continue;
+
+   d = (fx-ix)*(fx-ix) + (fy-iy)*(fy-iy);
+   ig = ix + iy*nx;
+   if(node_s[ig] < 0 || d < node_d[ig])
+      {
+      node_s[ig] = i;
+      node_d[ig] = d;
+      }
+   }
+
+wsta = (int *) check_malloc((nx*ny+1)*sizeof(int));
+nw = 0;
+for(ig=0;ig<nx*ny;ig++)
+   {
+   if(node_s[ig] >= 0)
+      {
+      wsta[nw] = node_s[ig];
+      node_s[ig] = nw;
+      nw++;
+      }
+   }
+
+/* the pack is mapped once, its index sorted for lookups */
+pmap = NULL;
+plen = 0;
+key = NULL;
+if(pack[0] != '\0')
+   {
+   wp = wccpack_open(pack,0);
+   key = (struct pm_key *) check_malloc((wp->ntrace+1)*sizeof(struct pm_key));
+   for(i=0;i<wp->ntrace;i++)
+      {
+      strncpy(key[i].stat,wp->index[i].stat,STATCHAR);
+      strncpy(key[i].comp,wp->index[i].comp,COMPCHAR);
+      key[i].itr = i;
+      key[i].offset = wp->index[i].offset;
+      }
+   qsort(key,wp->ntrace,sizeof(struct pm_key),pm_key_cmp);
+
+   fstat(wp->fd,&sbuf);
+   plen = sbuf.st_size;
+   pmap = mmap(NULL,plen,PROT_READ,MAP_PRIVATE,wp->fd,0);
+   if(pmap == MAP_FAILED)
+      {
+      fprintf(stderr,"*** cannot map %s, exiting...\n",pack);
+      exit(-1);
+      }
+   nalloc = wp->ntrace;
+   wccpack_close(wp);
+   }
+
+nmap = pp.npk + pp.nper;
+val = (float *) check_malloc(((size_t) nw*nmap + 1)*sizeof(float));
+
+st = (struct pm_station *) check_malloc(PM_CHUNK*sizeof(struct pm_station));
+acc1 = NULL;
+acc2 = NULL;
+psa_n = (float *) check_malloc(PM_CHUNK*PM_MAXPER*sizeof(float));
+psa_e = (float *) check_malloc(PM_CHUNK*PM_MAXPER*sizeof(float));
+rotd = (float *) check_malloc(PM_CHUNK*PM_MAXPER*sizeof(float));
+pct = 50.0;
+nbad = 0;
+
+for(i0=0;i0<nw;i0=i0+PM_CHUNK)
+   {
+   i1 = i0 + PM_CHUNK;
+   if(i1 > nw)
+      i1 = nw;
+
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic,1) reduction(+:nbad)
+   for(i=i0;i<i1;i++)
+      {
+      strncpy(st[i-i0].stat,sname[wsta[i]],STATCHAR);
+      if(pm_load(&st[i-i0],&pp,key,nalloc,pmap,inroot,inbin) == 0)
+         {
+         for(j=0;j<nmap;j++)
+            val[(size_t) i*nmap + j] = nodata;
+         st[i-i0].hd[0].nt = -1;
+         nbad++;
+         continue;
+         }
+      pm_peaks(&st[i-i0],&pp,val + (size_t) i*nmap);
+      }
+
+   /* RotD50 of the runs of stations with the same nt and dt */
+   for(j=i0;pp.nper > 0 && j<i1;j=ib)
+      {
+      if(st[j-i0].hd[0].nt < 0)
+         {
+         ib = j+1;
+         continue;
+         }
+
+      npts = st[j-i0].hd[0].nt;
+      for(ib=j+1;ib<i1;ib++)
+         {
+         if(st[ib-i0].hd[0].nt != npts || st[ib-i0].hd[0].dt != st[j-i0].hd[0].dt)
+            break;
+         }
+
+      acc1 = (float *) check_realloc(acc1,(size_t)(ib-j)*npts*sizeof(float));
+      acc2 = (float *) check_realloc(acc2,(size_t)(ib-j)*npts*sizeof(float));
+
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic,1)
+      for(i=j;i<ib;i++)
+         pm_accel(&st[i-i0],&pp,acc1 + (size_t)(i-j)*npts,acc2 + (size_t)(i-j)*npts);
+
+      if(rotd_compute_batch(acc1,acc2,npts,ib-j,st[j-i0].hd[0].dt,pp.per,pp.nper,
+                           0.05,2,&pct,1,nthreads,psa_n,psa_e,rotd) != 0)
+         {
+         fprintf(stderr,"*** RotD50 failed for %s (nt= %d dt= %f), exiting...\n",
+                                   st[j-i0].stat,npts,st[j-i0].hd[0].dt);
+         exit(-1);
+         }
+
+      for(i=j;i<ib;i++)
+         {
+         for(ip=0;ip<pp.nper;ip++)
+            val[(size_t) i*nmap + pp.npk + ip] = rotd[(i-j)*pp.nper + ip];
+         }
+      }
+
+   for(i=i0;i<i1;i++)
+      pm_unload(&st[i-i0],&pp,pmap);
+   }
+
+/* one map per measure */
+map = (float *) check_malloc(nx*ny*sizeof(float));
+for(im=0;im<nmap;im++)
+   {
+   for(ig=0;ig<nx*ny;ig++)
+      {
+      map[ig] = nodata;
+      if(node_s[ig] >= 0)
+         map[ig] = val[(size_t) node_s[ig]*nmap + im];
+      }
+
+   if(im < pp.npk)
+      sprintf(name,"%s",pp.pk_name[im]);
+   else
+      sprintf(name,"psa%.3f",pp.per[im-pp.npk]);
+   pm_write(outroot,name,map,nx,ny);
+   }
+
+fprintf(stderr,"%d of %d stations on the %d x %d grid\n",nw,ns,nx,ny);
+
+if(pmap != NULL)
+   munmap(pmap,plen);
+
+if(nbad)
+   {
+   fprintf(stderr,"*** %d stations without all of comps=%s, set to nodata\n",nbad,comps);
+   exit(-1);
+   }
+exit(0);
+}
+
+/* the choices of ims=, comps=, intype=, comb= and periods= */
+void pm_parse(struct pm_par *pp,char *ims,char *comps,char *intype,char *comb,char *periods)
+{
+char *tok, *save, list[1024];
+
+pp->npk = 0;
+pp->nper = 0;
+
+strncpy(list,ims,1023);
+list[1023] = '\0';
+for(tok=strtok_r(list,",",&save);tok!=NULL;tok=strtok_r(NULL,",",&save))
+   {
+   if(strcmp(tok,"psa") == 0)
+      {
+      pp->nper = -1;
+      continue;
+      }
+   if(pp->npk == 3 || (strcmp(tok,"pga") != 0 && strcmp(tok,"pgv") != 0 && strcmp(tok,"pgd") != 0))
+      {
+      fprintf(stderr,"*** ims= item %s, not pga, pgv, pgd or psa (each once), exiting...\n",tok);
+      exit(-1);
+      }
+   strcpy(pp->pk_name[pp->npk],tok);
+   pp->pk_order[pp->npk] = (tok[2] == 'a') ? 2 : ((tok[2] == 'v') ? 1 : 0);
+   pp->npk++;
+   }
+
+if(pp->nper < 0)
+   {
+   pp->nper = 0;
+   strncpy(list,periods,1023);
+   list[1023] = '\0';
+   for(tok=strtok_r(list,",",&save);tok!=NULL;tok=strtok_r(NULL,",",&save))
+      {
+      if(pp->nper == PM_MAXPER || sscanf(tok,"%f",&pp->per[pp->nper]) != 1 || pp->per[pp->nper] <= 0.0)
+         {
+         fprintf(stderr,"*** periods= item %s (at most %d periods > 0), exiting...\n",tok,PM_MAXPER);
+         exit(-1);
+         }
+      pp->nper++;
+      }
+   if(pp->nper == 0)
+      {
+      fprintf(stderr,"*** ims= has psa but periods= is not given, exiting...\n");
+      exit(-1);
+      }
+   }
+
+pp->ncomp = 0;
+strncpy(list,comps,1023);
+list[1023] = '\0';
+for(tok=strtok_r(list,",",&save);tok!=NULL;tok=strtok_r(NULL,",",&save))
+   {
+   if(pp->ncomp == PM_MAXCOMP)
+      {
+      fprintf(stderr,"*** more than %d comps=, exiting...\n",PM_MAXCOMP);
+      exit(-1);
+      }
+   strncpy(pp->comp[pp->ncomp],tok,COMPCHAR-1);
+   pp->comp[pp->ncomp][COMPCHAR-1] = '\0';
+   pp->ncomp++;
+   }
+if(pp->ncomp < 1 || (pp->nper > 0 && pp->ncomp < 2))
+   {
+   fprintf(stderr,"*** comps=%s, psa needs two horizontal components, exiting...\n",comps);
+   exit(-1);
+   }
+
+if(strcmp(intype,"acc") == 0)
+   pp->intype = 2;
+else if(strcmp(intype,"vel") == 0)
+   pp->intype = 1;
+else if(strcmp(intype,"disp") == 0)
+   pp->intype = 0;
+else
+   {
+   fprintf(stderr,"*** intype= %s, not acc, vel or disp, exiting...\n",intype);
+   exit(-1);
+   }
+
+if(strcmp(comb,"max") == 0)
+   pp->comb = 0;
+else if(strcmp(comb,"geom") == 0)
+   pp->comb = 1;
+else if(strcmp(comb,"vector") == 0)
+   pp->comb = 2;
+else
+   {
+   fprintf(stderr,"*** comb= %s, not max, geom or vector, exiting...\n",comb);
+   exit(-1);
+   }
+}
+
+/* the latest trace stat/comp of the sorted pack index key, NULL if none */
+struct pm_key *pm_find(struct pm_key *key,int nkey,char *stat,char *comp)
+{
+int lo, hi, mid, c;
+
+lo = 0;
+hi = nkey;
+while(lo < hi)
+   {
+   mid = (lo+hi)/2;
+   c = strncmp(key[mid].stat,stat,STATCHAR);
+   if(c == 0)
+      c = strncmp(key[mid].comp,comp,COMPCHAR);
+   if(c < 0)
+      lo = mid+1;
+   else
+      hi = mid;
+   }
+
+/* the first of the equal keys is the latest trace */
+if(lo < nkey && strncmp(key[lo].stat,stat,STATCHAR) == 0 && strncmp(key[lo].comp,comp,COMPCHAR) == 0)
+   return(&key[lo]);
+return(NULL);
+}
+
+/*
+   The traces of station st->stat, from the pack mapped at pmap (key
+   is its sorted index) or from the files inroot/stat.comp; 0, with a
+   message, if a component is missing or the components differ in nt
+   or dt.  The traces of the pack are not copied.
+*/
+int pm_load(struct pm_station *st,struct pm_par *pp,struct pm_key *key,int nkey,char *pmap,char *inroot,int inbin)
+{
+struct pm_key *kf;
+char file[1024];
+int ic, ok;
+
+for(ic=0;ic<pp->ncomp;ic++)
+   st->s[ic] = NULL;
+
+ok = 1;
+for(ic=0;ic<pp->ncomp && ok;ic++)
+   {
+   if(pmap != NULL)
+      {
+      if((kf = pm_find(key,nkey,st->stat,pp->comp[ic])) == NULL)
+         {
+         fprintf(stderr,"*** no trace %s/%s in the pack\n",st->stat,pp->comp[ic]);
+         ok = 0;
+         break;
+         }
+
+      memcpy(&st->hd[ic],pmap + kf->offset,sizeof(struct statdata));
+      st->s[ic] = (float *) (pmap + kf->offset + sizeof(struct statdata));
+      }
+   else
+      {
+      sprintf(file,"%s/%s.%s",inroot,st->stat,pp->comp[ic]);
+      if(access(file,R_OK) != 0)
+         {
+         fprintf(stderr,"*** cannot read %s\n",file);
+         ok = 0;
+         break;
+         }
+      st->s[ic] = read_wccseis(file,&st->hd[ic],NULL,inbin);
+      }
+
+   if(st->hd[ic].nt < 1 || st->hd[ic].nt != st->hd[0].nt || st->hd[ic].dt != st->hd[0].dt)
+      {
+      fprintf(stderr,"*** %s.%s: nt= %d dt= %f, not those of %s.%s\n",st->stat,pp->comp[ic],
+                st->hd[ic].nt,st->hd[ic].dt,st->stat,pp->comp[0]);
+      ok = 0;
+      }
+   }
+
+if(!ok)
+   pm_unload(st,pp,pmap);
+return(ok);
+}
+
+/* frees the traces pm_load() read from files */
+void pm_unload(struct pm_station *st,struct pm_par *pp,char *pmap)
+{
+int ic;
+
+for(ic=0;ic<pp->ncomp;ic++)
+   {
+   if(pmap == NULL && st->s[ic] != NULL)
+      free(st->s[ic]);
+   st->s[ic] = NULL;
+   }
+}
+
+/* the trace s of nt samples turned from order "from" into order "to" (0 disp, 1 vel, 2 acc) */
+static void pm_order(float *s,int nt,float dt,int from,int to)
+{
+float iv = 0.0;
+
+for(;from<to;from++)
+   differ(s,nt,&dt,&iv);
+for(;from>to;from--)
+   integrate(s,nt,&dt,&iv);
+}
+
+/* the peak measures of station st into val[0 ... pp->npk-1] */
+void pm_peaks(struct pm_station *st,struct pm_par *pp,float *val)
+{
+float *w[PM_MAXCOMP], *tmp, pk, lsum;
+int nt, ic, ik;
+
+nt = st->hd[0].nt;
+if(pp->npk < 1)
+   return;
+
+for(ic=0;ic<pp->ncomp;ic++)
+   w[ic] = (float *) check_malloc(nt*sizeof(float));
+tmp = (float *) check_malloc(nt*sizeof(float));
+
+for(ik=0;ik<pp->npk;ik++)
+   {
+   for(ic=0;ic<pp->ncomp;ic++)
+      {
+      memcpy(w[ic],st->s[ic],nt*sizeof(float));
+      pm_order(w[ic],nt,st->hd[0].dt,pp->intype,pp->pk_order[ik]);
+      }
+
+   if(pp->comb == 2)
+      val[ik] = wcc_vecmax(w,pp->ncomp,nt,tmp,NULL);
+   else
+      {
+      val[ik] = 0.0;
+      lsum = 0.0;
+      for(ic=0;ic<pp->ncomp;ic++)
+         {
+         pk = wcc_absmax(w[ic],nt,NULL);
+         if(pk > val[ik])
+            val[ik] = pk;
+         if(pk > 0.0)
+            lsum = lsum + log(pk);
+         else
+            lsum = -1.0e+20;
+         }
+      if(pp->comb == 1)
+         val[ik] = (lsum > -1.0e+19) ? exp(lsum/pp->ncomp) : 0.0;
+      }
+   }
+
+for(ic=0;ic<pp->ncomp;ic++)
+   free(w[ic]);
+free(tmp);
+}
+
+/* the first two components of station st as accelerations in acc1, acc2 */
+void pm_accel(struct pm_station *st,struct pm_par *pp,float *acc1,float *acc2)
+{
+int nt;
+
+nt = st->hd[0].nt;
+memcpy(acc1,st->s[0],nt*sizeof(float));
+memcpy(acc2,st->s[1],nt*sizeof(float));
+pm_order(acc1,nt,st->hd[0].dt,pp->intype,2);
+pm_order(acc2,nt,st->hd[0].dt,pp->intype,2);
+}
+
+/* the map of nx*ny floats into outroot.name.bin */
+void pm_write(char *outroot,char *name,float *map,int nx,int ny)
+{
+char file[1024];
+int fdw;
+
+sprintf(file,"%s.%s.bin",outroot,name);
+fdw = croptrfile(file);
+rite(fdw,map,(size_t) nx*ny*sizeof(float));
+close(fdw);
+}
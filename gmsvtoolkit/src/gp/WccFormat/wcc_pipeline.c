@@ -0,0 +1,675 @@
+/**********************************************************************/
+/*                                                                    */
+/*           wcc_pipeline                                             */
+/*                                                                    */
+/*           Runs a chain of the wcc_* processing stages on each      */
+/*           trace in memory: the trace is read once, goes through    */
+/*           the stages in order and only the result is written.      */
+/*                                                                    */
+/*           stagefile= has one stage per line, the stage name        */
+/*           followed by the parameters of the matching program,      */
+/*           e.g.                                                     */
+/*                                                                    */
+/*              tfilter fhi=0.05 flo=1.0e+10 order=4                  */
+/*              integ_diff integ=1                                    */
+/*              resamp_arbdt newdt=0.01                               */
+/*                                                                    */
+/*           Stages: tfilter, integ_diff, resamp_arbdt, siteamp14,    */
+/*           getpeak (prints the peak, the trace is unchanged) and    */
+/*           add (adds infile2=, with inbin2=, as wcc_add).  Blank    */
+/*           lines and lines starting with # are skipped.             */
+/*                                                                    */
+/*           One trace: infile=, outfile= (default stdin/stdout).     */
+/*           Many traces: filelist= and outpath= as in wcc_tfilter,   */
+/*           run by nproc= worker processes.  The stage parameters    */
+/*           are parsed once, before the first trace.  Each worker    */
+/*           reads prefetch= traces (default 4) ahead and writes its  */
+/*           results behind in two I/O threads (traceio.c), so the    */
+/*           stages run while the files are read and written;         */
+/*           prefetch=0 does the I/O in line.                         */
+/*                                                                    */
+/*           serve=1 runs it as a worker: jobs, one per line, come    */
+/*           from stdin (or from the connections to the Unix socket   */
+/*           socket=) and each is answered with "[DONE] status",      */
+/*           after the lines of its getpeak stages.  A job is         */
+/*                                                                    */
+/*              infile=in outfile=out [inbin= outbin=] [stagefile=]   */
+/*                 [stage args | stage args ...]                      */
+/*                                                                    */
+/*           the stages of stagefile= followed by the ones on the     */
+/*           line.  The parsed stages (site-amp tables, filter        */
+/*           sections) are kept from job to job, keyed on their       */
+/*           text.  "quit" ends the worker.  A job that cannot be     */
+/*           run (no input, unknown stage) gets status 1; bad stage   */
+/*           parameters still end the worker, as they end a run.      */
+/*                                                                    */
+/**********************************************************************/
+
+#include "include.h"
+#include "structure.h"
+#include "function.h"
+#include "getpar.h"
+
+#include <sys/wait.h>
+#include <sys/un.h>
+
+#define         MAXFILES        50000
+#define         MAXSTAGES       32
+#define         MAXSARGS        64
+#define         MAXCACHE        64
+#define         JOBLEN          8192
+
+#define         TFILTER         1
+#define         INTEG_DIFF      2
+#define         RESAMP_ARBDT    3
+#define         SITEAMP14       4
+#define         GETPEAK         5
+#define         ADD             6
+
+struct stage
+   {
+   int type;
+   int ac;
+   char *av[MAXSARGS];
+   char buf[1024];
+   union                /* parameters parsed once, by read_stages() */
+      {
+      struct tfilter_par tf;
+      struct integ_diff_par id;
+      struct resamp_arbdt_par ra;
+      struct siteamp14_par sa;
+      } par;
+   struct tfilter_coef tc;      /* tfilter sections for the last dt */
+   struct tfilter_sos ts;
+   };
+
+/* the stages of serve=, kept from job to job, keyed on their text */
+struct stagecache
+   {
+   int n;
+   int next;
+   char spec[MAXCACHE][1024];
+   struct stage st[MAXCACHE];
+   };
+
+char *readline(FILE *);
+
+/* the stage type of the name, 0 if there is no such stage */
+int stage_type(char *name)
+{
+if(strcmp(name,"tfilter") == 0)
+   return(TFILTER);
+else if(strcmp(name,"integ_diff") == 0)
+   return(INTEG_DIFF);
+else if(strcmp(name,"resamp_arbdt") == 0)
+   return(RESAMP_ARBDT);
+else if(strcmp(name,"siteamp14") == 0)
+   return(SITEAMP14);
+else if(strcmp(name,"getpeak") == 0)
+   return(GETPEAK);
+else if(strcmp(name,"add") == 0)
+   return(ADD);
+
+return(0);
+}
+
+/* the stage of a stagefile line str, 0 for a blank or comment line */
+int parse_stage(char *str,struct stage *st,char *where)
+{
+char *pb;
+
+strncpy(st->buf,str,1023);
+st->buf[1023] = '\0';
+
+/* split the line into an argument list, av[0] is the stage name */
+st->ac = 0;
+pb = strtok(st->buf," \t\n");
+while(pb != NULL && st->ac < MAXSARGS)
+   {
+   st->av[st->ac] = pb;
+   st->ac++;
+   pb = strtok(NULL," \t\n");
+   }
+
+if(st->ac == 0 || st->av[0][0] == '#')
+   return(0);
+
+st->type = stage_type(st->av[0]);
+if(st->type == 0)
+   {
+   fprintf(stderr,"Unknown stage %s in %s, exiting...\n",st->av[0],where);
+   exit(-1);
+   }
+
+if(st->type == TFILTER)
+   wcc_tfilter_config(st->ac,st->av,&st->par.tf);
+else if(st->type == INTEG_DIFF)
+   integ_diff_config(st->ac,st->av,&st->par.id);
+else if(st->type == RESAMP_ARBDT)
+   wcc_resamp_arbdt_config(st->ac,st->av,&st->par.ra);
+else if(st->type == SITEAMP14)
+   wcc_siteamp14_config(st->ac,st->av,&st->par.sa);
+
+st->tc.dt = -1.0;
+st->ts.dt = -1.0;
+
+return(1);
+}
+
+int read_stages(char *stagefile,struct stage *st)
+{
+FILE *fpr;
+char str[1024];
+int nst;
+
+fpr = fopfile(stagefile,"r");
+
+nst = 0;
+while(fgets(str,1024,fpr) != NULL)
+   {
+   if(parse_stage(str,&st[nst],stagefile) == 0)
+      continue;
+
+   nst++;
+   if(nst == MAXSTAGES)
+      {
+      fprintf(stderr,"More than %d stages in %s, exiting...\n",MAXSTAGES,stagefile);
+      exit(-1);
+      }
+   }
+fclose(fpr);
+
+return(nst);
+}
+
+void run_stage(struct stage *st,float **s,struct statdata *shead,FILE *fpo)
+{
+gp_ctx *gp;
+struct statdata shead2, shead3;
+float *s2, *p;
+float peak;
+char infile2[1024];
+int inbin2 = 0;
+double t0;
+
+/* as wcc_tfilter_apply(), the sections being computed once per dt */
+if(st->type == TFILTER)
+   {
+   t0 = prof_start();
+   if(st->par.tf.sos)
+      {
+      if(shead->dt != st->ts.dt)
+         wcc_tfilter_sos(&st->par.tf,shead->dt,&st->ts);
+      wcc_tfilter_sos_run(&st->ts,*s,shead->nt);
+      }
+   else
+      {
+      if(shead->dt != st->tc.dt)
+         wcc_tfilter_coef(&st->par.tf,shead->dt,&st->tc);
+      wcc_tfilter_run(&st->tc,*s,shead->nt);
+      }
+   prof_stop("wcc_tfilter",t0,shead->nt);
+   }
+
+else if(st->type == INTEG_DIFF)
+   integ_diff_apply(&st->par.id,*s,shead);
+
+else if(st->type == RESAMP_ARBDT)
+   wcc_resamp_arbdt_apply(&st->par.ra,s,shead);
+
+else if(st->type == SITEAMP14)
+   wcc_siteamp14_apply(&st->par.sa,s,shead);
+
+else if(st->type == GETPEAK)
+   {
+   peak = wcc_getpeak(st->ac,st->av,*s,shead);
+   fprintf(fpo,"%10.2f %13.5e %s\n",shead->edist,peak,shead->stat);
+   fflush(fpo);
+   }
+
+else if(st->type == ADD)
+   {
+   gp = gp_setpar(st->ac,st->av);
+   gp_mstpar(gp,"infile2","s",infile2);
+   gp_getpar(gp,"inbin2","d",&inbin2);
+   gp_endpar(gp);
+
+   s2 = NULL;
+   s2 = read_wccseis(infile2,&shead2,s2,inbin2);
+   p = (float *) check_malloc ((shead->nt+shead2.nt)*sizeof(float));
+
+   wcc_add(st->ac,st->av,*s,shead,s2,&shead2,p,&shead3);
+   strcpy(shead3.stat,shead->stat);
+   strcpy(shead3.comp,shead->comp);
+   sprintf(shead3.stitle,"summed output");
+
+   free(s2);
+   free(*s);
+   *s = p;
+   *shead = shead3;
+   }
+}
+
+/* tok appended to the stage text spec, -1 if it does not fit */
+int add_token(char *spec,char *tok)
+{
+int len;
+
+len = strlen(spec);
+if(len + strlen(tok) + 2 > 1024)
+   return(-1);
+
+if(len > 0)
+   spec[len++] = ' ';
+strcpy(spec+len,tok);
+return(0);
+}
+
+/* 1 if the stage text spec names a stage, a message and 0 if not */
+int known_stage(char *spec)
+{
+char name[1024];
+
+sscanf(spec,"%1023s",name);
+if(stage_type(name) == 0)
+   {
+   fprintf(stderr,"*** unknown stage %s\n",name);
+   return(0);
+   }
+return(1);
+}
+
+/* the stage of the text spec, parsed on the first job that uses it */
+struct stage *cached_stage(struct stagecache *sc,char *spec)
+{
+int i;
+
+for(i=0;i<sc->n;i++)
+   {
+   if(strcmp(sc->spec[i],spec) == 0)
+      return(&sc->st[i]);
+   }
+
+/* the oldest entry goes when the cache is full */
+i = sc->next;
+sc->next = (sc->next + 1)%MAXCACHE;
+if(sc->n < MAXCACHE)
+   sc->n++;
+
+strcpy(sc->spec[i],spec);
+parse_stage(spec,&sc->st[i],"job");
+return(&sc->st[i]);
+}
+
+/* one job of serve=, see the top of the file; returns its status */
+int run_job(char *job,struct stagecache *sc,FILE *fpo)
+{
+FILE *fpr;
+struct stage *jst[MAXSTAGES];
+struct statdata shead;
+float *s;
+char *tok, *save;
+char infile[1024], outfile[1024], stagefile[1024], str[1024];
+char spec[MAXSTAGES][1024], fspec[1024];
+int nst, nline, k, bad;
+int inbin = 0;
+int outbin = 0;
+
+infile[0] = '\0';
+outfile[0] = '\0';
+stagefile[0] = '\0';
+
+nline = 0;
+spec[0][0] = '\0';
+for(tok=strtok_r(job," \t\n",&save);tok!=NULL;tok=strtok_r(NULL," \t\n",&save))
+   {
+   if(strncmp(tok,"infile=",7) == 0)
+      strncpy(infile,tok+7,1023);
+   else if(strncmp(tok,"outfile=",8) == 0)
+      strncpy(outfile,tok+8,1023);
+   else if(strncmp(tok,"stagefile=",10) == 0)
+      strncpy(stagefile,tok+10,1023);
+   else if(strncmp(tok,"inbin=",6) == 0)
+      inbin = atoi(tok+6);
+   else if(strncmp(tok,"outbin=",7) == 0)
+      outbin = atoi(tok+7);
+   else if(strcmp(tok,"|") == 0)
+      {
+      if(spec[nline][0] == '\0')
+         continue;
+
+      nline++;
+      if(nline == MAXSTAGES)
+         {
+         fprintf(stderr,"*** more than %d stages in a job\n",MAXSTAGES);
+         return(1);
+         }
+      spec[nline][0] = '\0';
+      }
+   else if(add_token(spec[nline],tok) != 0)
+      {
+      fprintf(stderr,"*** stage %s ... too long\n",spec[nline]);
+      return(1);
+      }
+   }
+if(spec[nline][0] != '\0')
+   nline++;
+
+infile[1023] = '\0';
+outfile[1023] = '\0';
+stagefile[1023] = '\0';
+
+if(infile[0] == '\0' || outfile[0] == '\0')
+   {
+   fprintf(stderr,"*** a job needs infile= and outfile=\n");
+   return(1);
+   }
+if(access(infile,R_OK) != 0)
+   {
+   fprintf(stderr,"*** cannot read %s: %s\n",infile,strerror(errno));
+   return(1);
+   }
+
+bad = 0;
+for(k=0;k<nline;k++)
+   bad = bad + (known_stage(spec[k]) == 0);
+if(bad)
+   return(1);
+
+/* the stages of stagefile= first, then the ones on the line */
+nst = 0;
+if(stagefile[0] != '\0')
+   {
+   if((fpr = fopen(stagefile,"r")) == NULL)
+      {
+      fprintf(stderr,"*** cannot read %s: %s\n",stagefile,strerror(errno));
+      return(1);
+      }
+
+   while(fgets(str,1024,fpr) != NULL)
+      {
+      /* in the form of the stages on a line, so that they share entries */
+      fspec[0] = '\0';
+      for(tok=strtok_r(str," \t\n",&save);tok!=NULL;tok=strtok_r(NULL," \t\n",&save))
+         add_token(fspec,tok);
+      if(fspec[0] == '\0' || fspec[0] == '#')
+         continue;
+
+      if(nst + nline == MAXSTAGES || known_stage(fspec) == 0)
+         {
+         if(nst + nline == MAXSTAGES)
+            fprintf(stderr,"*** more than %d stages in a job\n",MAXSTAGES);
+         fclose(fpr);
+         return(1);
+         }
+      jst[nst] = cached_stage(sc,fspec);
+      nst++;
+      }
+   fclose(fpr);
+   }
+
+for(k=0;k<nline;k++)
+   {
+   jst[nst] = cached_stage(sc,spec[k]);
+   nst++;
+   }
+
+s = NULL;
+s = read_wccseis(infile,&shead,s,inbin);
+for(k=0;k<nst;k++)
+   run_stage(jst[k],&s,&shead,fpo);
+write_wccseis(outfile,&shead,s,outbin);
+
+free(s);
+arena_reset();
+return(0);
+}
+
+/* the jobs of serve=, one per line of fpr; 1 if one was "quit" */
+int serve_jobs(FILE *fpr,FILE *fpo,struct stagecache *sc)
+{
+char job[JOBLEN];
+char *pb;
+int c, status;
+
+while(fgets(job,JOBLEN,fpr) != NULL)
+   {
+   pb = job;
+   while(*pb == ' ' || *pb == '\t')
+      pb++;
+
+   if(*pb == '\n' || *pb == '\0' || *pb == '#')
+      continue;
+   if(strncmp(pb,"quit",4) == 0 && strchr(" \t\r\n",pb[4]) != NULL)
+      return(1);
+
+   if(strchr(pb,'\n') == NULL && !feof(fpr))
+      {
+      while((c = getc(fpr)) != EOF && c != '\n')
+         ;
+      fprintf(stderr,"*** job longer than %d characters\n",JOBLEN-1);
+      status = 1;
+      }
+   else
+      status = run_job(pb,sc,fpo);
+
+   fflush(stderr);
+   fprintf(fpo,"[DONE] %d\n",status);
+   fflush(fpo);
+   }
+
+return(0);
+}
+
+/* serve= jobs from the connections to the Unix socket path, one at a time */
+void serve_socket(char *path,struct stagecache *sc)
+{
+FILE *fpr, *fpo;
+struct sockaddr_un sa;
+int fd, cfd, done;
+
+if(strlen(path) >= sizeof(sa.sun_path))
+   {
+   fprintf(stderr,"*** socket name %s too long, exiting...\n",path);
+   exit(-1);
+   }
+
+memset(&sa,0,sizeof(sa));
+sa.sun_family = AF_UNIX;
+strcpy(sa.sun_path,path);
+unlink(path);
+
+fd = socket(AF_UNIX,SOCK_STREAM,0);
+if(fd < 0 || bind(fd,(struct sockaddr *) &sa,sizeof(sa)) != 0 || listen(fd,16) != 0)
+   {
+   fprintf(stderr,"*** cannot listen on %s: %s, exiting...\n",path,strerror(errno));
+   exit(-1);
+   }
+
+done = 0;
+while(!done)
+   {
+   if((cfd = accept(fd,NULL,NULL)) < 0)
+      {
+      if(errno == EINTR)
+         continue;
+
+      fprintf(stderr,"*** accept on %s: %s, exiting...\n",path,strerror(errno));
+      exit(-1);
+      }
+
+   fpr = fdopen(cfd,"r");
+   fpo = fdopen(dup(cfd),"w");
+   done = serve_jobs(fpr,fpo,sc);
+   fclose(fpr);
+   fclose(fpo);
+   }
+
+close(fd);
+unlink(path);
+}
+
+int main(int ac,char **av)
+{
+struct stage st[MAXSTAGES];
+struct statdata shead;
+float *s;
+char stagefile[1024];
+char sockpath[1024];
+char infile[1024];
+char outfile[1024];
+char filelist[1024];
+char outpath[1024];
+char str[2048];
+char *string, **infiles, **outfiles, *ibuf, *obuf;
+int nst, nstat, i, k, j, nshft, status;
+int iproc, nfail;
+FILE *fpr;
+struct traceio *tio;
+struct stagecache *sc;
+
+int inbin = 0;
+int outbin = 0;
+int nproc = 1;
+int prefetch = 4;
+int serve = 0;
+
+sprintf(infile,"stdin");
+sprintf(outfile,"stdout");
+filelist[0] = '\0';
+sprintf(outpath,".");
+sockpath[0] = '\0';
+
+setpar(ac,av);
+getpar("serve","d",&serve);
+if(serve == 0)
+   mstpar("stagefile","s",stagefile);
+getpar("socket","s",sockpath);
+getpar("infile","s",infile);
+getpar("outfile","s",outfile);
+getpar("filelist","s",filelist);
+getpar("outpath","s",outpath);
+getpar("inbin","d",&inbin);
+getpar("outbin","d",&outbin);
+getpar("nproc","d",&nproc);
+getpar("prefetch","d",&prefetch);
+endpar();
+
+/* worker, the jobs bring their own stages and files */
+if(serve)
+   {
+   sc = (struct stagecache *) check_malloc(sizeof(struct stagecache));
+   sc->n = 0;
+   sc->next = 0;
+
+   /* a client that goes away must not take the worker with it */
+   signal(SIGPIPE,SIG_IGN);
+
+   if(sockpath[0] != '\0')
+      serve_socket(sockpath,sc);
+   else
+      serve_jobs(stdin,stdout,sc);
+   exit(0);
+   }
+
+nst = read_stages(stagefile,st);
+
+/* one trace */
+if(filelist[0] == '\0')
+   {
+   s = NULL;
+   s = read_wccseis(infile,&shead,s,inbin);
+   for(k=0;k<nst;k++)
+      run_stage(&st[k],&s,&shead,stdout);
+   write_wccseis(outfile,&shead,s,outbin);
+   exit(0);
+   }
+
+/* list of traces, "infile [outfile]" per line as in wcc_tfilter */
+infiles = (char **) check_malloc(MAXFILES*sizeof(char *));
+outfiles = (char **) check_malloc(MAXFILES*sizeof(char *));
+ibuf = (char *) check_malloc(1024);
+obuf = (char *) check_malloc(1024);
+
+fpr = fopfile(filelist,"r");
+nstat = 0;
+while((string = readline(fpr)) != NULL && nstat < MAXFILES)
+   {
+   nshft = 0;
+   getname(string,ibuf,&nshft);
+   if(ibuf[0] == '\0')
+      continue;
+   getname(&string[nshft],obuf,&nshft);
+   if(obuf[0] == '\0')
+      {
+      j = strlen(ibuf);
+      while(j > 0 && ibuf[j-1] != '/')
+         j--;
+      strcpy(obuf,ibuf+j);
+      }
+   infiles[nstat] = strdup(ibuf);
+   outfiles[nstat] = strdup(obuf);
+   nstat++;
+   }
+fclose(fpr);
+
+makedir(outpath);
+
+/* worker iproc takes traces iproc, iproc+nproc, ... */
+iproc = 0;
+for(i=1;i<nproc;i++)
+   {
+   if(fork() == 0)
+      {
+      iproc = i;
+      break;
+      }
+   }
+
+if(prefetch > 0)
+   {
+   tio = traceio_open(infiles,outpath,outfiles,iproc,nproc,nstat,prefetch,inbin,outbin);
+   while((s = traceio_next(tio,&shead,&i)) != NULL)
+      {
+      for(k=0;k<nst;k++)
+         run_stage(&st[k],&s,&shead,stdout);
+
+      traceio_put(tio,i,&shead,s);
+      arena_reset();
+      }
+   traceio_close(tio);
+   }
+else
+   {
+   s = NULL;
+   for(i=iproc;i<nstat;i=i+nproc)
+      {
+      s = read_wccseis(infiles[i],&shead,s,inbin);
+      for(k=0;k<nst;k++)
+         run_stage(&st[k],&s,&shead,stdout);
+
+      set_fullpath(str,outpath,outfiles[i]);
+      write_wccseis(str,&shead,s,outbin);
+
+      /* the stages' scratch memory, kept for the next trace */
+      arena_reset();
+      }
+   }
+
+if(iproc != 0)
+   exit(0);
+
+nfail = 0;
+while(wait(&status) > 0)
+   {
+   if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      nfail++;
+   }
+if(nfail)
+   {
+   fprintf(stderr,"%d of %d worker processes failed\n",nfail,nproc-1);
+   exit(-1);
+   }
+
+exit(0);
+}
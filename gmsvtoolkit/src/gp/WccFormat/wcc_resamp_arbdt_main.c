@@ -21,8 +21,83 @@ wcc_resamp_arbdt:   Decimate or interpolate time series
 
 #define TAP_PERC 0.05
 
+/*
+   polyphase=1 with chunk=: the binary trace is read, resampled and
+   written chunk input samples at a time, so its length is not limited
+   by memory; same output as the whole trace at once
+*/
+void resamp_stream(char *infile,char *outfile,struct resamp_arbdt_par *rp,int chunk)
+{
+struct statdata head1, head2;
+struct rsmp_poly rs;
+float *in, *out;
+int fdr, fdw, i, n, nin, nmax, nout, ntout;
+
+if(strcmp(infile,"stdin") == 0)
+   fdr = STDIN_FILENO;
+else
+   fdr = opfile_ro(infile);
+reed(fdr,&head1,sizeof(struct statdata));
+
+ntout = rp->ntout;
+if(ntout < 0)
+   ntout = (int)(head1.nt*((double)(head1.dt)/rp->double_dt) + 0.5);
+
+head2 = head1;
+head2.nt = ntout;
+head2.dt = rp->double_dt;
+
+if(strcmp(outfile,"stdout") == 0)
+   fdw = STDOUT_FILENO;
+else
+   fdw = croptrfile(outfile);
+rite(fdw,&head2,sizeof(struct statdata));
+
+rsmp_poly_init(&rs,(double)(head1.dt),rp->double_dt,rp->taps,rp->kbeta,rp->nyq_perc);
+
+/* the most outputs one chunk and the carried over taps can give */
+nmax = (int)((chunk + rs.ntap)/rs.rate) + 2;
+in = (float *) check_malloc(chunk*sizeof(float));
+out = (float *) check_malloc(nmax*sizeof(float));
+
+nout = 0;
+for(i=0;i<head1.nt;i=i+nin)
+   {
+   nin = head1.nt - i;
+   if(nin > chunk)
+      nin = chunk;
+   reed(fdr,in,nin*sizeof(float));
+
+   n = ntout - nout;
+   if(n > nmax)
+      n = nmax;
+   n = rsmp_poly_run(&rs,in,nin,out,n);
+   rite(fdw,out,n*sizeof(float));
+   nout = nout + n;
+   }
+
+while(nout < ntout)
+   {
+   n = ntout - nout;
+   if(n > nmax)
+      n = nmax;
+   n = rsmp_poly_flush(&rs,out,n);
+   rite(fdw,out,n*sizeof(float));
+   nout = nout + n;
+   }
+
+close(fdr);
+close(fdw);
+rsmp_poly_free(&rs);
+free(in);
+free(out);
+
+fprintf(stderr,"***nt=%d dt=%f\n",head2.nt,head2.dt);
+}
+
 int main(int ac,char **av)
 {
+struct resamp_arbdt_par rp;
 struct statdata head1;
 float *s1;
 float *p;
@@ -54,6 +129,8 @@ int outbin = 0;
 
 int use_fftw = 1;
 int use_double = 0;
+int polyphase = 0;
+int chunk = 0;
 
 sprintf(infile,"stdin");
 sprintf(outfile,"stdout");
@@ -75,8 +152,23 @@ getpar("order","d",&order);
 getpar("ntout","d",&ntout);
 getpar("inbin","d",&inbin);
 getpar("outbin","d",&outbin);
+getpar("polyphase","d",&polyphase);
+getpar("chunk","d",&chunk);
 endpar();
 
+if(polyphase && chunk > 0)
+   {
+   if(!inbin || !outbin || strchr(infile,':') != NULL || strchr(outfile,':') != NULL)
+      {
+      fprintf(stderr,"chunk= needs inbin=1 outbin=1 and plain files, exiting...\n");
+      exit(-1);
+      }
+
+   wcc_resamp_arbdt_config(ac,av,&rp);
+   resamp_stream(infile,outfile,&rp,chunk);
+   exit(0);
+   }
+
 s1 = NULL;
 s1 = read_wccseis(infile,&head1,s1,inbin);
 
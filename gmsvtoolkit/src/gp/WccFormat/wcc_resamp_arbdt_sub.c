@@ -20,20 +20,101 @@ wcc_resamp_arbdt:   Decimate or interpolate time series
 #include "fftw3.h"
 #include "getpar.h"
 
-void resample_fftw(float *,int,float *,int,int,int,double *,int,float *,float *);
-void resample_fftwf(float *,int,float *,int,int,int,float *,int,float *,float *);
-void resample(float *,int,float *,int,int,int,float *,float *,int,float *,float *);
+void resample_fftw(float *,int,float *,int,int,int,double *,int,float *,float *,double **,int *,struct resamp_arbdt_par *);
+void resample_fftwf(float *,int,float *,int,int,int,float *,int,float *,float *,struct resamp_arbdt_par *);
+void resample(float *,int,float *,int,int,int,float *,float *,int,float *,float *,struct resamp_arbdt_par *);
 void zapit(float *,int);
-void taper_norm(float *,float *,int,float *);
-void norm(float *,float *,int);
 double nt_tol(float,int);
 double nt_tol_d(double,int);
 
 extern void fourg_(float *, int *, int *, float *);
 
 #define TAP_PERC 0.05
+#define PI 3.14159265   /* as in wcc_tfilter */
 
-void resample(float *s,int nt,float *dt,int isamp,int ntpad,int ntrsmp,float *newdt,float *p,int ord,float *perc, float *tp)
+/*
+   The low-pass of lp_flo= (> 0), applied to the half spectrum while it
+   is resampled, in place of a wcc_tfilter run before wcc_resamp_arbdt.
+   With lp_ftop > lp_flo it is a cosine roll-off from 1 at lp_flo to 0
+   at lp_ftop.  Otherwise it is the magnitude of the lp_order pole
+   Butterworth of wcc_tfilter flo= with phase=0 (forward and reverse
+   passes) at the input dt,
+
+      1/(1 + (tan(pi*f*dt)/tan(pi*lp_flo*dt))^(2*lp_order))
+
+   The n-1 bins i = 1 ... n-1 at f = i*df are scaled, s[2*i] and
+   s[2*i+1]; DC passes unchanged.
+*/
+static double rsmp_lp_gain(struct resamp_arbdt_par *rp,double dt,double wplo,double f)
+{
+double fl, fl2;
+int j;
+
+if(rp->lp_ftop > rp->lp_flo)
+   {
+   if(f <= rp->lp_flo)
+      return(1.0);
+   if(f >= rp->lp_ftop)
+      return(0.0);
+   return(0.5*(1.0 + cos(PI*(f - rp->lp_flo)/(rp->lp_ftop - rp->lp_flo))));
+   }
+
+fl = tan(PI*f*dt)/wplo;
+fl2 = fl*fl;
+fl = fl2;
+for(j=1;j<rp->lp_order;j++)
+   fl = fl*fl2;
+
+return(1.0/(1.0 + fl));
+}
+
+static int rsmp_lp_active(struct resamp_arbdt_par *rp,double dt)
+{
+if(rp == NULL || rp->lp_flo <= 0.0)
+   return(0);
+
+/* as wcc_tfilter, a Butterworth corner at or above Nyquist is no filter */
+if(rp->lp_ftop <= rp->lp_flo && rp->lp_flo >= 0.5/dt)
+   return(0);
+
+return(1);
+}
+
+void rsmp_lowpass(float *s,int n,double df,double dt,struct resamp_arbdt_par *rp)
+{
+double wplo, fac;
+int i;
+
+if(rsmp_lp_active(rp,dt) == 0)
+   return;
+
+wplo = tan(PI*rp->lp_flo*dt);
+for(i=1;i<n;i++)
+   {
+   fac = rsmp_lp_gain(rp,dt,wplo,i*df);
+   s[2*i] = fac*s[2*i];
+   s[2*i + 1] = fac*s[2*i + 1];
+   }
+}
+
+void rsmp_lowpass_d(double *s,int n,double df,double dt,struct resamp_arbdt_par *rp)
+{
+double wplo, fac;
+int i;
+
+if(rsmp_lp_active(rp,dt) == 0)
+   return;
+
+wplo = tan(PI*rp->lp_flo*dt);
+for(i=1;i<n;i++)
+   {
+   fac = rsmp_lp_gain(rp,dt,wplo,i*df);
+   s[2*i] = fac*s[2*i];
+   s[2*i + 1] = fac*s[2*i + 1];
+   }
+}
+
+void resample(float *s,int nt,float *dt,int isamp,int ntpad,int ntrsmp,float *newdt,float *p,int ord,float *perc, float *tp,struct resamp_arbdt_par *rp)
 {
 float df, f, f0, fl, fl2, fac;
 int i, j;
@@ -43,7 +124,7 @@ float one = 1.0;
 int minus = -1;
 int plus = 1;
 
-taper_norm(s,dt,nt,tp);
+spec_taper_norm(s,*dt,nt,*tp);
 zapit(s+nt,(ntpad)-(nt));
 
 for(i=ntpad-1;i>=0;i--)
@@ -53,6 +134,7 @@ for(i=ntpad-1;i>=0;i--)
    }
 
 fourg_(s,&ntpad,&minus,p);
+rsmp_lowpass(s,((ntpad < ntrsmp) ? ntpad : ntrsmp)/2,1.0/(ntpad*(*dt)),*dt,rp);
 
 if(isamp > 0)
    zapit(s+ntpad,2*ntrsmp-ntpad);
@@ -93,7 +175,7 @@ fourg_(s,&ntrsmp,&plus,p);
 for(i=0;i<ntrsmp;i++)
    s[i] = s[2*i];
 
-norm(s,newdt,ntrsmp);
+spec_norm(s,*newdt,ntrsmp);
 }
 
 void zapit(float *s,int n)
@@ -105,38 +187,6 @@ while(n--)
    }
 }
 
-void taper_norm(float *g,float *dt,int nt,float *tp)
-{
-float fac, df, arg;
-int i;
-int ntap;
-
-ntap = nt*(*tp);
-
-for(i=0;i<nt-ntap;i++)
-   g[i] = g[i]*(*dt);
-
-df = 3.14159/(float)(ntap);
-for(i=nt-ntap;i<nt;i++)
-   {
-   arg = (i-(nt-(ntap+1)))*df;
-   fac = (*dt)*0.5*(1.0 + cos(arg));
-   g[i] = g[i]*fac;
-   }
-}
-
-void norm(float *g,float *dt,int nt)
-{
-float fac;
-
-fac = 1.0/((*dt)*nt);
-while(nt--)
-   {
-   g[0] = g[0]*fac;
-   g++;
-   }
-}
-
 double nt_tol(float fnt,int gnt)
 {
 double diff;
@@ -163,40 +213,39 @@ if(diff < 0.0)
 return(diff);
 }
 
-void resample_fftw(float *s,int nt,float *dt,int isamp,int ntpad,int ntrsmp,double *newdt,int ord,float *perc, float *tp)
+void resample_fftw(float *s,int nt,float *dt,int isamp,int ntpad,int ntrsmp,double *newdt,int ord,float *perc, float *tp,double **work,int *nwork,struct resamp_arbdt_par *rp)
 {
 double df, f, f0, fl, fl2, fac;
-int i, j;
+double *ds;
+int i, j, n;
 
-int minus = -1;
-int plus = 1;
+spec_taper_norm(s,*dt,nt,*tp);
 
-fftw_plan plan;
-fftw_complex *dbl_cs;
-
-taper_norm(s,dt,nt,tp);
-for(i=nt;i<ntpad;i++)
-   s[i] = 0.0;
-
-dbl_cs = (fftw_complex *) check_malloc(sizeof(fftw_complex)*ntpad);
-plan = fftw_plan_dft_1d(ntpad,dbl_cs,dbl_cs,FFTW_FORWARD,FFTW_ESTIMATE);
-
-for(i=0;i<ntpad;i++)
+/* the half spectrum of the longer of ntpad and ntrsmp, kept across calls */
+n = ((ntpad > ntrsmp) ? ntpad : ntrsmp) + 2;
+if(n > *nwork)
    {
-   dbl_cs[i][0] = s[i];
-   dbl_cs[i][1] = 0.0;
+   if(*work != NULL)
+      fftw_free(*work);
+   *work = (double *) fftw_malloc(n*sizeof(double));
+   *nwork = n;
    }
+ds = *work;
 
-fftw_execute(plan);
+for(i=0;i<nt;i++)
+   ds[i] = s[i];
+for(i=nt;i<ntpad;i++)
+   ds[i] = 0.0;
 
-dbl_cs = (fftw_complex *) check_realloc(dbl_cs,sizeof(fftw_complex)*ntrsmp);
+drfft_r2c(ds,ntpad,-1);
+rsmp_lowpass_d(ds,((ntpad < ntrsmp) ? ntpad : ntrsmp)/2,1.0/(ntpad*(*dt)),*dt,rp);
 
 if(isamp > 0)
    {
-   for(i=ntpad/2;i<ntrsmp;i++)
+   for(i=ntpad/2;i<=ntrsmp/2;i++)
       {
-      dbl_cs[i][0] = 0.0;
-      dbl_cs[i][1] = 0.0;
+      ds[2*i] = 0.0;
+      ds[2*i + 1] = 0.0;
       }
    }
 else if(isamp < 0)
@@ -217,67 +266,45 @@ else if(isamp < 0)
 
          fac = 1.0/(1.0 + fl);
 
-         dbl_cs[i][0] = fac*dbl_cs[i][0];
-         dbl_cs[i][1] = fac*dbl_cs[i][1];
+         ds[2*i] = fac*ds[2*i];
+         ds[2*i + 1] = fac*ds[2*i + 1];
          }
       }
 
    /* zero nyquist */
-   dbl_cs[ntrsmp/2][0] = 0.0;
-   dbl_cs[ntrsmp/2][1] = 0.0;
-   }
-
-for(i=1;i<ntrsmp/2;i++)  /* replicate with complex-conjugate */
-   {
-   dbl_cs[(ntrsmp-i)][0] = dbl_cs[i][0];
-   dbl_cs[(ntrsmp-i)][1] = -dbl_cs[i][1];
+   ds[ntrsmp] = 0.0;
+   ds[ntrsmp + 1] = 0.0;
    }
 
-plan = fftw_plan_dft_1d(ntrsmp,dbl_cs,dbl_cs,FFTW_BACKWARD,FFTW_ESTIMATE);
-fftw_execute(plan);
+drfft_c2r(ds,ntrsmp,1);
 
 fac = 1.0/((*newdt)*ntrsmp);
 for(i=0;i<ntrsmp;i++)
-   s[i] = fac*dbl_cs[i][0];
-
-fftw_destroy_plan(plan);
-fftw_free(dbl_cs);
+   s[i] = fac*ds[i];
 }
 
-void resample_fftwf(float *s,int nt,float *dt,int isamp,int ntpad,int ntrsmp,float *newdt,int ord,float *perc, float *tp)
+void resample_fftwf(float *s,int nt,float *dt,int isamp,int ntpad,int ntrsmp,float *newdt,int ord,float *perc, float *tp,struct resamp_arbdt_par *rp)
 {
 float df, f, f0, fl, fl2, fac;
 int i, j;
 
-int minus = -1;
-int plus = 1;
-
-fftwf_plan plan;
-fftwf_complex *cs;
-
-taper_norm(s,dt,nt,tp);
+spec_taper_norm(s,*dt,nt,*tp);
 for(i=nt;i<ntpad;i++)
    s[i] = 0.0;
 
-cs = (fftwf_complex *) check_malloc(sizeof(fftwf_complex)*ntpad);
-plan = fftwf_plan_dft_1d(ntpad,cs,cs,FFTW_FORWARD,FFTW_ESTIMATE);
-
-for(i=0;i<ntpad;i++)
-   {
-   cs[i][0] = s[i];
-   cs[i][1] = 0.0;
-   }
-
-fftwf_execute(plan);
-
-cs = (fftwf_complex *) check_realloc(cs,sizeof(fftwf_complex)*ntrsmp);
+/*
+   the real transforms work in place on s, which has room for
+   2*max(ntpad,ntrsmp) floats; half spectrum as s[2*i], s[2*i+1]
+*/
+rfft_r2c(s,ntpad,-1);
+rsmp_lowpass(s,((ntpad < ntrsmp) ? ntpad : ntrsmp)/2,1.0/(ntpad*(*dt)),*dt,rp);
 
 if(isamp > 0)
    {
-   for(i=ntpad/2;i<ntrsmp;i++)
+   for(i=ntpad/2;i<=ntrsmp/2;i++)
       {
-      cs[i][0] = 0.0;
-      cs[i][1] = 0.0;
+      s[2*i] = 0.0;
+      s[2*i + 1] = 0.0;
       }
    }
 else if(isamp < 0)
@@ -298,75 +325,327 @@ else if(isamp < 0)
 
          fac = 1.0/(1.0 + fl);
 
-         cs[i][0] = fac*cs[i][0];
-         cs[i][1] = fac*cs[i][1];
+         s[2*i] = fac*s[2*i];
+         s[2*i + 1] = fac*s[2*i + 1];
          }
       }
 
    /* zero nyquist */
-   cs[ntrsmp/2][0] = 0.0;
-   cs[ntrsmp/2][1] = 0.0;
+   s[ntrsmp] = 0.0;
+   s[ntrsmp + 1] = 0.0;
    }
 
-for(i=1;i<ntrsmp/2;i++)  /* replicate with complex-conjugate */
+rfft_c2r(s,ntrsmp,1);
+
+fac = 1.0/((*newdt)*ntrsmp);
+for(i=0;i<ntrsmp;i++)
+   s[i] = fac*s[i];
+}
+
+/*
+   Polyphase FIR resampler (polyphase=1)
+
+   Output sample j is at input time t = j*rate (in input samples) and is
+   the dot product of the ntap inputs around t with a Kaiser windowed
+   sinc, low passed at nyq_perc times the lower of the two Nyquists.
+   half = taps/fc taps are kept on each side, so the kernel is widened
+   to cover taps zero crossings when decimating.  If rate is M/L with
+   L <= RSMP_MAXPHASE the L phases are exact, else the nearest two of
+   RSMP_MAXPHASE phases are interpolated.  Each phase is normalized to
+   unit DC gain.
+
+   The input can be given in pieces: rsmp_poly_run() keeps only the
+   ntap samples still needed for the next output, so memory does not
+   grow with the trace, and the result does not depend on how the
+   input is split.  Samples before the start and past the end are 0.
+*/
+
+static double bessel_i0(double x)
+{
+double sum, term, q;
+int k;
+
+q = 0.25*x*x;
+sum = term = 1.0;
+for(k=1;k<100 && term > 1.0e-12*sum;k++)
    {
-   cs[(ntrsmp-i)][0] = cs[i][0];
-   cs[(ntrsmp-i)][1] = -cs[i][1];
+   term = term*q/((double)(k)*(double)(k));
+   sum = sum + term;
    }
 
-plan = fftwf_plan_dft_1d(ntrsmp,cs,cs,FFTW_BACKWARD,FFTW_ESTIMATE);
-fftwf_execute(plan);
+return(sum);
+}
 
-fac = 1.0/((*newdt)*ntrsmp);
-for(i=0;i<ntrsmp;i++)
-   s[i] = fac*cs[i][0];
+void rsmp_poly_init(struct rsmp_poly *rs,double dt,double newdt,int taps,float kbeta,float nyq_perc)
+{
+double fc, mu, d, x, w, sum, i0b;
+float *hp;
+int ip, i, l;
+
+rs->rate = newdt/dt;
+
+/* rational ratio M/L, to about the float precision of the two dt */
+rs->exact = 0;
+for(l=1;l<=RSMP_MAXPHASE;l++)
+   {
+   d = rs->rate*l;
+   if(fabs(d - floor(d + 0.5)) < 1.0e-6)
+      {
+      rs->exact = 1;
+      rs->L = l;
+      rs->M = (int)(floor(d + 0.5));
+      break;
+      }
+   }
+rs->nph = (rs->exact) ? rs->L : RSMP_MAXPHASE;
+
+if(taps < 1)
+   taps = 1;
+fc = nyq_perc;
+if(rs->rate > 1.0)
+   fc = fc/rs->rate;
+rs->half = (int)(ceil(taps/fc));
+rs->ntap = 2*rs->half;
+
+/* phase ip is for t - floor(t) = ip/nph, tap i for input floor(t) - half + 1 + i */
+rs->h = (float *) check_malloc((rs->nph+1)*rs->ntap*sizeof(float));
+i0b = bessel_i0((double)(kbeta));
+for(ip=0;ip<=rs->nph;ip++)
+   {
+   hp = rs->h + ip*rs->ntap;
+   mu = (double)(ip)/(double)(rs->nph);
+
+   sum = 0.0;
+   for(i=0;i<rs->ntap;i++)
+      {
+      d = (i - (rs->half - 1)) - mu;
+
+      x = d/rs->half;
+      w = 1.0 - x*x;
+      if(w < 0.0)
+         w = 0.0;
+      w = bessel_i0(kbeta*sqrt(w))/i0b;
+
+      x = 3.14159265358979*fc*d;
+      if(fabs(x) < 1.0e-12)
+         hp[i] = w;
+      else
+         hp[i] = w*sin(x)/x;
+      sum = sum + hp[i];
+      }
+
+   for(i=0;i<rs->ntap;i++)
+      hp[i] = hp[i]/sum;
+   }
 
-fftwf_destroy_plan(plan);
-fftwf_free(cs);
+/* the taps before input sample 0 are zeros */
+rs->cap = 2*rs->ntap;
+rs->xb = (float *) check_malloc(rs->cap*sizeof(float));
+rs->nxb = rs->half;
+rs->x0 = -rs->half;
+for(i=0;i<rs->nxb;i++)
+   rs->xb[i] = 0.0;
+
+rs->zero = (float *) check_malloc(rs->ntap*sizeof(float));
+for(i=0;i<rs->ntap;i++)
+   rs->zero[i] = 0.0;
+
+rs->j = 0;
+}
+
+/* the first input sample of the taps for output j, and its phase */
+static long long rsmp_poly_base(struct rsmp_poly *rs,long long j,int *ip,float *w)
+{
+long long it;
+double t, pos;
+
+if(rs->exact)
+   {
+   it = (j*rs->M)/rs->L;
+   *ip = (int)((j*rs->M)%rs->L);
+   *w = 0.0;
+   }
+else
+   {
+   t = j*rs->rate;
+   it = (long long)(floor(t));
+   pos = (t - it)*rs->nph;
+   *ip = (int)(pos);
+   if(*ip >= rs->nph)
+      *ip = rs->nph - 1;
+   *w = pos - *ip;
+   }
+
+return(it - (rs->half - 1));
+}
+
+/*
+   Adds the nin samples of in and writes the output samples whose taps
+   are all in (at most nmax of them) to out.  Returns their number.
+*/
+int rsmp_poly_run(struct rsmp_poly *rs,float *in,int nin,float *out,int nmax)
+{
+long long base;
+float *hp, *xp;
+float w, y0, y1;
+int ip, i, k, n, nd;
+
+/* drop what the next output does not need, and append in */
+base = rsmp_poly_base(rs,rs->j,&ip,&w);
+nd = (int)(base - rs->x0);
+if(nd > rs->nxb)
+   nd = rs->nxb;
+if(nd > 0)
+   {
+   memmove(rs->xb,rs->xb+nd,(rs->nxb-nd)*sizeof(float));
+   rs->nxb = rs->nxb - nd;
+   rs->x0 = rs->x0 + nd;
+   }
+
+if(rs->nxb + nin > rs->cap)
+   {
+   rs->cap = rs->nxb + nin;
+   rs->xb = (float *) check_realloc(rs->xb,rs->cap*sizeof(float));
+   }
+memcpy(rs->xb+rs->nxb,in,nin*sizeof(float));
+rs->nxb = rs->nxb + nin;
+
+n = 0;
+while(n < nmax)
+   {
+   base = rsmp_poly_base(rs,rs->j,&ip,&w);
+   k = (int)(base - rs->x0);
+   if(k + rs->ntap > rs->nxb)
+      break;
+
+   xp = rs->xb + k;
+   hp = rs->h + ip*rs->ntap;
+
+   y0 = 0.0;
+   for(i=0;i<rs->ntap;i++)
+      y0 = y0 + hp[i]*xp[i];
+
+   if(!rs->exact)
+      {
+      hp = hp + rs->ntap;
+      y1 = 0.0;
+      for(i=0;i<rs->ntap;i++)
+         y1 = y1 + hp[i]*xp[i];
+
+      y0 = y0 + w*(y1 - y0);
+      }
+
+   out[n] = y0;
+   n++;
+   rs->j++;
+   }
+
+return(n);
+}
+
+/* after the last input: the next nmax output samples, over zeros past the end */
+int rsmp_poly_flush(struct rsmp_poly *rs,float *out,int nmax)
+{
+int n = 0;
+
+while(n < nmax)
+   n = n + rsmp_poly_run(rs,rs->zero,rs->ntap,out+n,nmax-n);
+
+return(n);
+}
+
+void rsmp_poly_free(struct rsmp_poly *rs)
+{
+free(rs->h);
+free(rs->xb);
+free(rs->zero);
 }
 
 void wcc_resamp_arbdt(int param_string_len, char** param_string, float** s, struct statdata* head1) {
+  struct resamp_arbdt_par rp;
+
+  wcc_resamp_arbdt_config(param_string_len,param_string,&rp);
+  wcc_resamp_arbdt_apply(&rp,s,head1);
+
+  if(rp.work != NULL)
+    fftw_free(rp.work);
+}
+
+/* parse the wcc_resamp_arbdt parameters once, for wcc_resamp_arbdt_apply() */
+void wcc_resamp_arbdt_config(int param_string_len, char** param_string, struct resamp_arbdt_par* rp) {
+  gp_ctx *gp;
+  char dt_str[128];
+
+  rp->order = 4;
+  rp->nyq_perc = 1.0;
+  rp->tap_perc = TAP_PERC;
+  rp->ntout = -1;
+  rp->use_fftw = 1;
+  rp->use_double = 0;
+  rp->work = NULL;
+  rp->nwork = 0;
+  rp->polyphase = 0;
+  rp->taps = 16;
+  rp->kbeta = 8.0;
+  rp->lp_flo = 0.0;
+  rp->lp_order = 4;
+  rp->lp_ftop = 0.0;
+
+  gp = gp_setpar(param_string_len,param_string);
+
+  gp_mstpar(gp,"newdt","f",&rp->single_dt);
+  gp_mstpar(gp,"newdt","s",&dt_str);
+  rp->double_dt = 1.000000*atof(dt_str);
+
+  gp_getpar(gp,"use_fftw","d",&rp->use_fftw);
+  gp_getpar(gp,"use_double","d",&rp->use_double);
+  gp_getpar(gp,"nyq_perc","f",&rp->nyq_perc);
+  gp_getpar(gp,"tap_perc","f",&rp->tap_perc);
+  gp_getpar(gp,"order","d",&rp->order);
+  gp_getpar(gp,"ntout","d",&rp->ntout);
+  gp_getpar(gp,"polyphase","d",&rp->polyphase);
+  gp_getpar(gp,"taps","d",&rp->taps);
+  gp_getpar(gp,"kbeta","f",&rp->kbeta);
+  gp_getpar(gp,"lp_flo","f",&rp->lp_flo);
+  gp_getpar(gp,"lp_order","d",&rp->lp_order);
+  gp_getpar(gp,"lp_ftop","f",&rp->lp_ftop);
+  gp_endpar(gp);
+}
+
+void wcc_resamp_arbdt_apply(struct resamp_arbdt_par* rp, float** s, struct statdata* head1) {
   float *p;
   int nt1, i, j;
 
-  int order = 4;
-  float nyq_perc = 1.0;
-  float tap_perc = TAP_PERC;
+  int order = rp->order;
+  float nyq_perc = rp->nyq_perc;
+  float tap_perc = rp->tap_perc;
 
   int resamp = 0;
   int ntpad, ntrsmp;
   float *space = NULL;
-  int ntout = -1;
+  int ntout = rp->ntout;
 
   int it, ntmax, ntap;
-  char dt_str[128];
   float df, fac, arg;
-  double dnt, double_dt;
-  float single_dt;
+  double dnt;
+  double double_dt = rp->double_dt;
+  float single_dt = rp->single_dt;
 
   double dt_tol = 1.0001;
   double tol = 1.0e-02;
 
-  int use_fftw = 1;
-  int use_double = 0;
+  int use_fftw = rp->use_fftw;
+  int use_double = rp->use_double;
   float* s1 = NULL;
+  struct rsmp_poly rs;
+  double t0;
 
-  setpar(param_string_len,param_string);
-
-  mstpar("newdt","f",&single_dt);
-  mstpar("newdt","s",&dt_str);
-  double_dt = 1.000000*atof(dt_str);
-
-  getpar("use_fftw","d",&use_fftw);
-  getpar("use_double","d",&use_double);
-  getpar("nyq_perc","f",&nyq_perc);
-  getpar("tap_perc","f",&tap_perc);
-  getpar("order","d",&order);
-  getpar("ntout","d",&ntout);
-  endpar();
-
+  t0 = prof_start();
   fprintf(stderr,"***nt=%d dt=%f\n",head1->nt,head1->dt);
 
+  if(((double_dt <= 0.0 || (double_dt >= head1->dt/dt_tol && double_dt <= head1->dt*dt_tol)) || rp->polyphase) && rp->lp_flo > 0.0)
+    fprintf(stderr,"*** lp_flo= is applied by the spectral resampler only, ignored\n");
+
   if(double_dt <= 0.0 || (double_dt >= head1->dt/dt_tol && double_dt <= head1->dt*dt_tol))
     {
       resamp = 0;
@@ -395,6 +674,23 @@ void wcc_resamp_arbdt(int param_string_len, char** param_string, float** s, stru
 	  head1->nt = ntout;
 	}
     }
+  else if(rp->polyphase)      /* time-domain FIR, no padding or taper */
+    {
+      if(ntout < 0)
+	ntout = (int)(head1->nt*((double)(head1->dt)/double_dt) + 0.5);
+
+      rsmp_poly_init(&rs,(double)(head1->dt),double_dt,rp->taps,rp->kbeta,nyq_perc);
+      s1 = (float *) check_malloc(ntout*sizeof(float));
+      it = rsmp_poly_run(&rs,*s,head1->nt,s1,ntout);
+      rsmp_poly_flush(&rs,s1+it,ntout-it);
+      rsmp_poly_free(&rs);
+
+      free(*s);
+      *s = s1;
+
+      head1->nt = ntout;
+      head1->dt = double_dt;
+    }
   else                /* need to resample time history */
     {
       ntpad = 2*head1->nt;
@@ -426,14 +722,14 @@ void wcc_resamp_arbdt(int param_string_len, char** param_string, float** s, stru
       if(use_fftw == 0)
 	{
 	  space = (float *) check_malloc (ntmax*sizeof(float));
-	  resample(s1,head1->nt,&(head1->dt),resamp,ntpad,ntrsmp,&single_dt,space,order,&nyq_perc,&tap_perc);
+	  resample(s1,head1->nt,&(head1->dt),resamp,ntpad,ntrsmp,&single_dt,space,order,&nyq_perc,&tap_perc,rp);
 	}
       else
 	{
 	  if(use_double == 0)
-	    resample_fftwf(s1,head1->nt,&(head1->dt),resamp,ntpad,ntrsmp,&single_dt,order,&nyq_perc,&tap_perc);
+	    resample_fftwf(s1,head1->nt,&(head1->dt),resamp,ntpad,ntrsmp,&single_dt,order,&nyq_perc,&tap_perc,rp);
 	  else
-	    resample_fftw(s1,head1->nt,&(head1->dt),resamp,ntpad,ntrsmp,&double_dt,order,&nyq_perc,&tap_perc);
+	    resample_fftw(s1,head1->nt,&(head1->dt),resamp,ntpad,ntrsmp,&double_dt,order,&nyq_perc,&tap_perc,&rp->work,&rp->nwork,rp);
 	}
 
       if(ntout < 0)
@@ -464,4 +760,5 @@ void wcc_resamp_arbdt(int param_string_len, char** param_string, float** s, stru
 
   fprintf(stderr,"***nt=%d dt=%f\n",head1->nt,head1->dt);
   free(space);
+  prof_stop("wcc_resamp_arbdt",t0,head1->nt);
 }
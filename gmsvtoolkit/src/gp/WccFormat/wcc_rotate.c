@@ -1,75 +1,92 @@
+/**********************************************************************/
+/*                                                                    */
+/*           wcc_rotate                                               */
+/*                                                                    */
+/*           Rotates a pair of horizontal components, filein1 and     */
+/*           filein2, to the azimuth rot= (default the back-azimuth   */
+/*           of the header minus 180) and rot+90, into fileout1 and   */
+/*           fileout2.  The component orientations come from their    */
+/*           names (n, e, s, w, vx, vy or the azimuth in degrees).    */
+/*                                                                    */
+/*           angles= (a list) gives the component at each of these    */
+/*           azimuths instead, all from one pass over the samples,    */
+/*           into fileout1.<azimuth> (for RotD and the like).         */
+/*                                                                    */
+/*           Many stations are done in one run, by nthreads= OpenMP   */
+/*           threads, with filelist= (one pair per line,              */
+/*                                                                    */
+/*              filein1 filein2 fileout1 fileout2 [rot]               */
+/*                                                                    */
+/*           or "filein1 filein2 fileout1 [rot]" with angles=) or     */
+/*           with pack= and outpack=: the first two horizontal        */
+/*           components of every station of the pack are rotated      */
+/*           into outpack, and its vertical copied.  A pair that is   */
+/*           not 90 deg. apart stops a one pair run and is skipped    */
+/*           with a warning in a batch.                               */
+/*                                                                    */
+/**********************************************************************/
+
 #include "include.h"
 #include "structure.h"
 #include "function.h"
 #include "getpar.h"
 
-int size_float = sizeof(float);
-int size_int = sizeof(int);
 
-int main(ac,av)
-int ac;
-char **av;
-{
-struct statdata *hptr, *shead1, *shead2;
-float *fptr, *h1, *h2, *r1, *r2;
-float ang1, ang2, ang, t1, t2, tt;
-int nt, nts;
-float rot = -999.9;
-
-char datafile[128];
-char filein1[128];
-char filein2[128];
-char fileout1[128];
-char fileout2[128];
+#define         MAXANG          360
+#define         MAXFILES        50000
+#define         LINELEN         1024
 
-int inbin1 = 0;
-int inbin2 = 0;
-int outbin1 = 0;
-int outbin2 = 0;
+int size_float = sizeof(float);
+int size_int = sizeof(int);
 
 float pi = 3.14159265;
 
-setpar(ac, av);
-mstpar("filein1","s",filein1);
-mstpar("filein2","s",filein2);
-mstpar("fileout1","s",fileout1);
-mstpar("fileout2","s",fileout2);
-getpar("rot","f",&rot);
-getpar("inbin1","d",&inbin1);
-getpar("inbin2","d",&inbin2);
-getpar("outbin1","d",&outbin1);
-getpar("outbin2","d",&outbin2);
-endpar();
+struct rotjob
+   {
+   char in1[LINELEN], in2[LINELEN];
+   char out1[LINELEN], out2[LINELEN];
+   char stat[STATCHAR];     /* pack= only */
+   char vcomp[COMPCHAR];    /* pack= vertical, "" if none */
+   float rot;
+   };
 
-shead1 = (struct statdata *) check_malloc (sizeof(struct statdata));
-shead2 = (struct statdata *) check_malloc (sizeof(struct statdata));
-
-h1 = NULL;
-h1 = read_wccseis(filein1,shead1,h1,inbin1);
-h2 = NULL;
-h2 = read_wccseis(filein2,shead2,h2,inbin2);
-
-if(shead1->comp[0] == 'n' || shead1->comp[0] == 'N')
-   ang1 = 0.0;
-else if(shead1->comp[0] == 'e'  || shead1->comp[0] == 'E' || strcmp(shead1->comp,"vx") == 0)
-   ang1 = 90.0;
-else if(shead1->comp[0] == 's'  || shead1->comp[0] == 'S' || strcmp(shead1->comp,"vy") == 0)
-   ang1 = 180.0;
-else if(shead1->comp[0] == 'w' || shead1->comp[0] == 'W')
-   ang1 = 270.0;
-else
-   ang1 = atof(shead1->comp);
-
-if(shead2->comp[0] == 'n' || shead2->comp[0] == 'N')
-   ang2 = 0.0;
-else if(shead2->comp[0] == 'e' || shead2->comp[0] == 'E' || strcmp(shead2->comp,"vx") == 0)
-   ang2 = 90.0;
-else if(shead2->comp[0] == 's' || shead2->comp[0] == 'S' || strcmp(shead2->comp,"vy") == 0)
-   ang2 = 180.0;
-else if(shead2->comp[0] == 'w' || shead2->comp[0] == 'W')
-   ang2 = 270.0;
+/* orientation of a component, from its name */
+float comp_angle(char *comp)
+{
+if(comp[0] == 'n' || comp[0] == 'N')
+   return(0.0);
+else if(comp[0] == 'e'  || comp[0] == 'E' || strcmp(comp,"vx") == 0)
+   return(90.0);
+else if(comp[0] == 's'  || comp[0] == 'S' || strcmp(comp,"vy") == 0)
+   return(180.0);
+else if(comp[0] == 'w' || comp[0] == 'W')
+   return(270.0);
 else
-   ang2 = atof(shead2->comp);
+   return(atof(comp));
+}
+
+int comp_vertical(char *comp)
+{
+if(strcmp(comp,"ver") == 0 || strcmp(comp,"up") == 0 || strcmp(comp,"z") == 0)
+   return(1);
+if(comp[0] == 'u' || comp[0] == 'U' || comp[0] == 'Z')
+   return(1);
+return(0);
+}
+
+/*
+   Trims the two traces to their common start and length and orders
+   them so that ang2 = ang1 + 90 (swapping headers and samples);
+   returns ang1, or -999.9 if the two are not 90 deg. apart.
+*/
+float rot_prepare(struct statdata *shead1,float **h1,struct statdata *shead2,float **h2)
+{
+struct statdata htmp;
+float *fptr, ang1, ang2, ang, t1, t2;
+int nts;
+
+ang1 = comp_angle(shead1->comp);
+ang2 = comp_angle(shead2->comp);
 
 t1 = shead1->hr*3600.0 + shead1->min*60.0 + shead1->sec;
 t2 = shead2->hr*3600.0 + shead2->min*60.0 + shead2->sec;
@@ -77,7 +94,7 @@ t2 = shead2->hr*3600.0 + shead2->min*60.0 + shead2->sec;
 if(t1 < t2)
    {
    nts = (t2-t1)/shead1->dt;
-   h1 = h1 + nts;
+   *h1 = *h1 + nts;
    shead1->nt = shead1->nt - nts;
 
    shead1->hr = shead2->hr;
@@ -87,7 +104,7 @@ if(t1 < t2)
 else if(t1 > t2)
    {
    nts = (t1-t2)/shead1->dt;
-   h2 = h2 + nts;
+   *h2 = *h2 + nts;
    shead2->nt = shead2->nt - nts;
 
    shead2->hr = shead1->hr;
@@ -100,11 +117,6 @@ if(shead1->nt < shead2->nt)
 if(shead1->nt > shead2->nt)
    shead1->nt = shead2->nt;
 
-nt = shead1->nt;
-
-r1 = (float *) check_malloc (nt*size_float);
-r2 = (float *) check_malloc (nt*size_float);
-
 while(ang1 > 360.0)
    ang1 = ang1 - 360.0;
 while(ang2 > 360.0)
@@ -112,51 +124,86 @@ while(ang2 > 360.0)
 
 if(ang2 < ang1 && ang2+270 != ang1)
    {
-   fptr = h1; h1 = h2; h2 = fptr;
-   hptr = shead1; shead1 = shead2; shead2 = hptr;
+   fptr = *h1; *h1 = *h2; *h2 = fptr;
+   htmp = *shead1; *shead1 = *shead2; *shead2 = htmp;
    ang = ang1; ang1 = ang2; ang2 = ang;
    }
 
 if(ang2 > ang1 && ang1+90 != ang2)
    {
-   fptr = h1; h1 = h2; h2 = fptr;
-   hptr = shead1; shead1 = shead2; shead2 = hptr;
+   fptr = *h1; *h1 = *h2; *h2 = fptr;
+   htmp = *shead1; *shead1 = *shead2; *shead2 = htmp;
    ang = ang1; ang1 = ang2; ang2 = ang;
    }
 
 if(ang2 != ang1+90.0 && ang2 != ang1-270.0)
    {
    fprintf(stderr,"ang1= %f ang2= %f\n",ang1,ang2);
-   fprintf(stderr,"Input components differ by more than 90 deg., exiting...\n");
-   exit(-1);
-   }
-
-if(rot < -999.0)
-   {
-   fprintf(stderr,"Using back-azimuth for rotation angle.\n");
-   rot = shead1->baz - 180.0;
+   return(-999.9);
    }
+return(ang1);
+}
 
-ang = (rot-ang1)*pi/180.0;
-rotate(nt,r1,r2,h1,h2,&ang);
-
-ang = rot;
+/* component name of azimuth ang, in [0,360) */
+void rot_label(float ang,char *comp)
+{
 while(ang >= 360.0)
    ang -= 360.0;
 while(ang < 0.0)
    ang += 360.0;
 
-sprintf(shead1->comp,"%d",(int)(ang));
-write_wccseis(fileout1,shead1,r1,outbin1);
+sprintf(comp,"%d",(int)(ang));
+}
 
-ang = 90.0 + ang;
-while(ang > 360.0)
-   ang -= 360.0;
-while(ang < 0.0)
-   ang += 360.0;
+/*
+   In place rotation by a (radians): north gets east*sin(a) +
+   north*cos(a), east gets east*cos(a) - north*sin(a), as rotate()
+   gives r and t; the loop is vectorized for the CPU (SIMD_CLONES)
+*/
+SIMD_CLONES void rotate_inplace(int n,float *north,float *east,float a)
+{
+float cosA, sinA, r;
+int i;
+
+cosA = cos(a);
+sinA = sin(a);
+
+for(i=0;i<n;i++)
+   {
+   r = east[i]*sinA + north[i]*cosA;
+   east[i] = east[i]*cosA - north[i]*sinA;
+   north[i] = r;
+   }
+}
 
-sprintf(shead2->comp,"%d",(int)(ang));
-write_wccseis(fileout2,shead2,r2,outbin2);
+/*
+   r[k][i] = east[i]*sin(a[k]) + north[i]*cos(a[k]), k = 0 ... na-1,
+   a block of samples at a time for all the angles, vectorized for
+   the CPU (SIMD_CLONES)
+*/
+SIMD_CLONES void rotate_multi(int n,float *north,float *east,int na,float *a,float **r)
+{
+float cosA[MAXANG], sinA[MAXANG];
+int i, k, ib, ie;
+
+for(k=0;k<na;k++)
+   {
+   cosA[k] = cos(a[k]);
+   sinA[k] = sin(a[k]);
+   }
+
+for(ib=0;ib<n;ib=ib+1024)
+   {
+   ie = ib + 1024;
+   if(ie > n)
+      ie = n;
+
+   for(k=0;k<na;k++)
+      {
+      for(i=ib;i<ie;i++)
+         r[k][i] = east[i]*sinA[k] + north[i]*cosA[k];
+      }
+   }
 }
 
 void rotate(n,r,t,north,east,a)
@@ -177,3 +224,352 @@ while(n--)
    north++; east++;
    }
 }
+
+/* the traces of one job, rotated and ready to be written */
+struct rotout
+   {
+   int ntr;
+   struct statdata hd[MAXANG+3];
+   float *s[MAXANG+3];
+   int own[MAXANG+3];       /* s[k] is to be freed */
+   float *b1, *b2;          /* the input samples (rotated in place) */
+   };
+
+/*
+   One pair, rotated into ro (in place unless there are angles);
+   with vert the station's vertical is taken along.  Returns -1 if the
+   pair is skipped.
+*/
+int rotate_job(struct rotjob *jb,int inbin,int nang,float *angles,int vert,struct rotout *ro,int verbose)
+{
+struct statdata shead1, shead2;
+float *h1, *h2, **r, a[MAXANG], ang1, rot;
+char name[3*LINELEN];
+int k;
+
+ro->ntr = 0;
+ro->b1 = NULL;
+ro->b1 = read_wccseis(jb->in1,&shead1,ro->b1,inbin);
+ro->b2 = NULL;
+ro->b2 = read_wccseis(jb->in2,&shead2,ro->b2,inbin);
+h1 = ro->b1;
+h2 = ro->b2;
+
+ang1 = rot_prepare(&shead1,&h1,&shead2,&h2);
+if(ang1 < -999.0)
+   {
+   fprintf(stderr,"%s %s: input components differ by more than 90 deg., skipped\n",jb->in1,jb->in2);
+   return(-1);
+   }
+
+rot = jb->rot;
+if(rot < -999.0 && nang <= 0)
+   {
+   if(verbose)
+      fprintf(stderr,"Using back-azimuth for rotation angle.\n");
+   rot = shead1.baz - 180.0;
+   }
+
+if(nang > 0)
+   {
+   r = ro->s;
+   for(k=0;k<nang;k++)
+      {
+      a[k] = (angles[k]-ang1)*pi/180.0;
+      r[k] = (float *) check_malloc(shead1.nt*size_float);
+      ro->own[k] = 1;
+      ro->hd[k] = shead1;
+      rot_label(angles[k],ro->hd[k].comp);
+      }
+   rotate_multi(shead1.nt,h1,h2,nang,a,r);
+   ro->ntr = nang;
+   }
+else
+   {
+   rotate_inplace(shead1.nt,h1,h2,(rot-ang1)*pi/180.0);
+
+   ro->hd[0] = shead1;
+   ro->hd[1] = shead2;
+   rot_label(rot,ro->hd[0].comp);
+   rot_label(90.0+rot,ro->hd[1].comp);
+   ro->s[0] = h1;
+   ro->s[1] = h2;
+   ro->own[0] = ro->own[1] = 0;
+   ro->ntr = 2;
+   }
+
+if(vert && jb->vcomp[0] != '\0')
+   {
+   sprintf(name,"%s:%s/%s",jb->out1,jb->stat,jb->vcomp);
+   k = ro->ntr;
+   ro->s[k] = NULL;
+   ro->s[k] = read_wccseis(name,&ro->hd[k],ro->s[k],0);
+   ro->own[k] = 1;
+   ro->ntr++;
+   }
+
+return(0);
+}
+
+/* writes the traces of ro to the pack wp, or to the files of jb */
+void rotout_write(struct rotout *ro,struct rotjob *jb,int nang,int outbin,struct wccpack *wp)
+{
+char name[LINELEN+16];
+int k;
+
+for(k=0;k<ro->ntr;k++)
+   {
+   if(wp != NULL)
+      wccpack_add(wp,jb->stat,ro->hd[k].comp,&ro->hd[k],ro->s[k]);
+   else if(nang > 0)
+      {
+      sprintf(name,"%s.%s",jb->out1,ro->hd[k].comp);
+      write_wccseis(name,&ro->hd[k],ro->s[k],outbin);
+      }
+   else
+      write_wccseis((k == 0) ? jb->out1 : jb->out2,&ro->hd[k],ro->s[k],outbin);
+   }
+}
+
+void rotout_free(struct rotout *ro)
+{
+int k;
+
+for(k=0;k<ro->ntr;k++)
+   {
+   if(ro->own[k])
+      free(ro->s[k]);
+   }
+free(ro->b1);
+free(ro->b2);
+ro->ntr = 0;
+}
+
+int main(int ac,char **av)
+{
+struct rotjob *jb;
+struct rotout *ro;
+struct wccpack *wp, *wpo;
+float angles[MAXANG], rot = -999.9;
+char filelist[LINELEN], pack[LINELEN], outpack[LINELEN], line[LINELEN];
+char c1[COMPCHAR], c2[COMPCHAR], cv[COMPCHAR];
+int i, j, na, njob, nang, i0, n, nchunk;
+
+char filein1[LINELEN];
+char filein2[LINELEN];
+char fileout1[LINELEN];
+char fileout2[LINELEN];
+
+int inbin1 = 0;
+int inbin2 = 0;
+int outbin1 = 0;
+int outbin2 = 0;
+int nthreads = 1;
+
+filelist[0] = '\0';
+pack[0] = '\0';
+outpack[0] = '\0';
+fileout2[0] = '\0';
+
+setpar(ac, av);
+getpar("filelist","s",filelist);
+getpar("pack","s",pack);
+if(pack[0] != '\0')
+   mstpar("outpack","s",outpack);
+nang = getpar("angles","vf",angles);
+if(filelist[0] == '\0' && pack[0] == '\0')
+   {
+   mstpar("filein1","s",filein1);
+   mstpar("filein2","s",filein2);
+   mstpar("fileout1","s",fileout1);
+   if(nang <= 0)
+      mstpar("fileout2","s",fileout2);
+   }
+getpar("rot","f",&rot);
+getpar("inbin1","d",&inbin1);
+getpar("inbin2","d",&inbin2);
+getpar("outbin1","d",&outbin1);
+getpar("outbin2","d",&outbin2);
+getpar("nthreads","d",&nthreads);
+endpar();
+
+if(nang > MAXANG)
+   nang = MAXANG;
+
+if(filelist[0] == '\0' && pack[0] == '\0')
+   {
+   struct statdata shead1, shead2;
+   float *h1, *h2, *r1, *r2, ang1, ang;
+   int nt;
+
+   h1 = NULL;
+   h1 = read_wccseis(filein1,&shead1,h1,inbin1);
+   h2 = NULL;
+   h2 = read_wccseis(filein2,&shead2,h2,inbin2);
+
+   ang1 = rot_prepare(&shead1,&h1,&shead2,&h2);
+   if(ang1 < -999.0)
+      {
+      fprintf(stderr,"Input components differ by more than 90 deg., exiting...\n");
+      exit(-1);
+      }
+
+   if(rot < -999.0 && nang <= 0)
+      {
+      fprintf(stderr,"Using back-azimuth for rotation angle.\n");
+      rot = shead1.baz - 180.0;
+      }
+
+   nt = shead1.nt;
+   if(nang > 0)
+      {
+      float *r[MAXANG], a[MAXANG];
+      char name[LINELEN+16];
+      int k;
+
+      for(k=0;k<nang;k++)
+         {
+         a[k] = (angles[k]-ang1)*pi/180.0;
+         r[k] = (float *) check_malloc(nt*size_float);
+         }
+      rotate_multi(nt,h1,h2,nang,a,r);
+
+      for(k=0;k<nang;k++)
+         {
+         rot_label(angles[k],shead1.comp);
+         sprintf(name,"%s.%s",fileout1,shead1.comp);
+         write_wccseis(name,&shead1,r[k],outbin1);
+         }
+      exit(0);
+      }
+
+   r1 = h1;
+   r2 = h2;
+   ang = (rot-ang1)*pi/180.0;
+   rotate_inplace(nt,r1,r2,ang);
+
+   rot_label(rot,shead1.comp);
+   write_wccseis(fileout1,&shead1,r1,outbin1);
+
+   rot_label(90.0+rot,shead2.comp);
+   write_wccseis(fileout2,&shead2,r2,outbin2);
+   exit(0);
+   }
+
+/* the pairs: the lines of filelist, or the stations of the pack */
+
+jb = (struct rotjob *) check_malloc(MAXFILES*sizeof(struct rotjob));
+njob = 0;
+wpo = NULL;
+if(pack[0] != '\0')
+   {
+   wp = wccpack_open(pack,0);
+   for(i=0;i<wp->ntrace && njob<MAXFILES;i++)
+      {
+      if(wccpack_find(wp,wp->index[i].stat,wp->index[i].comp) != i)
+         continue;   /* replaced by a later trace */
+
+      for(j=0;j<njob;j++)
+         {
+         if(strncmp(jb[j].stat,wp->index[i].stat,STATCHAR) == 0)
+            break;
+         }
+      if(j < njob)
+         continue;   /* station already taken */
+
+      /* the station's first two horizontals and its vertical */
+      c1[0] = c2[0] = cv[0] = '\0';
+      for(na=i;na<wp->ntrace;na++)
+         {
+         if(strncmp(wp->index[na].stat,wp->index[i].stat,STATCHAR) != 0)
+            continue;
+         if(wccpack_find(wp,wp->index[na].stat,wp->index[na].comp) != na)
+            continue;
+
+         if(comp_vertical(wp->index[na].comp))
+            {
+            if(cv[0] == '\0')
+               strncpy(cv,wp->index[na].comp,COMPCHAR);
+            }
+         else if(c1[0] == '\0')
+            strncpy(c1,wp->index[na].comp,COMPCHAR);
+         else if(c2[0] == '\0')
+            strncpy(c2,wp->index[na].comp,COMPCHAR);
+         }
+      if(c2[0] == '\0')
+         {
+         fprintf(stderr,"%s: fewer than two horizontal components, skipped\n",wp->index[i].stat);
+         continue;
+         }
+
+      strncpy(jb[njob].stat,wp->index[i].stat,STATCHAR);
+      sprintf(jb[njob].in1,"%s:%s/%s",pack,jb[njob].stat,c1);
+      sprintf(jb[njob].in2,"%s:%s/%s",pack,jb[njob].stat,c2);
+      strcpy(jb[njob].out1,pack);
+      strncpy(jb[njob].vcomp,cv,COMPCHAR);
+      jb[njob].rot = rot;
+      njob++;
+      }
+   wccpack_close(wp);
+
+   wpo = wccpack_open(outpack,1);
+   inbin1 = 0;   /* pack paths are read by read_wccseis */
+   }
+else
+   {
+   FILE *fpr = fopfile(filelist,"r");
+
+   while(fgets(line,LINELEN,fpr) != NULL && njob < MAXFILES)
+      {
+      jb[njob].rot = rot;
+      jb[njob].vcomp[0] = '\0';
+      jb[njob].out2[0] = '\0';
+      if(nang > 0)
+         na = sscanf(line,"%1023s %1023s %1023s %f",jb[njob].in1,jb[njob].in2,jb[njob].out1,&jb[njob].rot);
+      else
+         na = sscanf(line,"%1023s %1023s %1023s %1023s %f",jb[njob].in1,jb[njob].in2,jb[njob].out1,jb[njob].out2,&jb[njob].rot);
+      if(na < ((nang > 0) ? 3 : 4))
+         continue;
+      njob++;
+      }
+   fclose(fpr);
+   }
+
+/*
+   The pairs are done in parallel a chunk at a time; the files are
+   written by the threads, the pack (wccpack_add is serial) after each
+   chunk, in the order of the stations.
+*/
+nchunk = 64*nthreads;
+ro = (struct rotout *) check_malloc(nchunk*sizeof(struct rotout));
+
+for(i0=0;i0<njob;i0=i0+nchunk)
+   {
+   n = njob - i0;
+   if(n > nchunk)
+      n = nchunk;
+
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic,1)
+   for(i=0;i<n;i++)
+      {
+      if(rotate_job(&jb[i0+i],inbin1,nang,angles,wpo != NULL,&ro[i],i0+i == 0) == 0 && wpo == NULL)
+         rotout_write(&ro[i],&jb[i0+i],nang,outbin1,NULL);
+      if(wpo == NULL)
+         rotout_free(&ro[i]);
+      }
+
+   if(wpo != NULL)
+      {
+      for(i=0;i<n;i++)
+         {
+         rotout_write(&ro[i],&jb[i0+i],nang,outbin1,wpo);
+         rotout_free(&ro[i]);
+         }
+      }
+   }
+
+if(wpo != NULL)
+   wccpack_close(wpo);
+
+exit(0);
+}
@@ -1,3 +1,21 @@
+/**********************************************************************/
+/*                                                                    */
+/*           wcc_siteamp14                                            */
+/*                                                                    */
+/*           Site amplification of one trace (infile=, outfile=) or   */
+/*           of every station in statlist=, one per line:             */
+/*                                                                    */
+/*              infile outfile vsite [vpga [pga]]                     */
+/*                                                                    */
+/*           outfile goes in outpath=; a missing vpga or pga takes    */
+/*           the command line value.  nthreads= OpenMP threads        */
+/*           share out the stations, each keeping the ampf curves it  */
+/*           has computed, so stations of the same Vs30 class and     */
+/*           pga reuse one curve; pgabin= rounds the pga to steps of  */
+/*           pgabin in ln(pga) (e.g. 0.01) to let more traces share.  */
+/*                                                                    */
+/**********************************************************************/
+
 #include "include.h"
 #include "structure.h"
 #include "function.h"
@@ -9,33 +27,139 @@ void borch_ampf(float *,float *,int,float *,float *,float *,float *,float *,floa
 void cb2008_ampf(float *,float *,int,float *,float *,float *,float *,float *,float *,float *,float *,float *,float *,float *);
 void cb2014_ampf(float *,float *,int,float *,float *,float *,float *,float *,float *,float *,float *,float *,float *,float *);
 void bssa2014_ampf(float *,float *,int,float *,float *,float *,float *,float *,float *,float *,float *,float *,float *,float *);
-void ampfac(struct complex *,float *,int);
 void zero(float *, int);
-void norm(float *, float *, int);
-void taper_norm(float *, float *, int, float *);
-int getnt_p2(int);
 void getpeak(float *, int, float *);
 
+#define MAXFILES 50000
+
+struct station
+   {
+   char *infile, *outfile;
+   float vsite, vpga, pga;
+   };
+
+char *readline(FILE *);
+
+int read_stations(char *statlist,struct siteamp14_par *sp,struct station *st)
+{
+FILE *fpr;
+char *string, ibuf[1024], obuf[1024];
+float v[3];
+int nstat, nshft, nv;
+
+fpr = fopfile(statlist,"r");
+
+nstat = 0;
+while((string = readline(fpr)) != NULL && nstat < MAXFILES)
+   {
+   nshft = 0;
+   getname(string,ibuf,&nshft);
+   if(ibuf[0] == '\0' || ibuf[0] == '#')
+      continue;
+   getname(&string[nshft],obuf,&nshft);
+
+   nv = sscanf(&string[nshft],"%f %f %f",&v[0],&v[1],&v[2]);
+   if(obuf[0] == '\0' || nv < 1)
+      {
+      fprintf(stderr,"%s: need 'infile outfile vsite [vpga [pga]]' in line %d, exiting...\n",statlist,nstat+1);
+      exit(-1);
+      }
+
+   st[nstat].infile = strdup(ibuf);
+   st[nstat].outfile = strdup(obuf);
+   st[nstat].vsite = v[0];
+   st[nstat].vpga = (nv > 1) ? v[1] : sp->vpga;
+   st[nstat].pga = (nv > 2) ? v[2] : sp->pga;
+   nstat++;
+   }
+fclose(fpr);
+
+return(nstat);
+}
+
 int main(int ac,char **av)
 {
 struct statdata head1;
+struct siteamp14_par sp, sps;
+struct siteamp14_cache *cc;
+struct station *st;
 float *s1;
+int i, nstat, nhit, nmiss;
 
-char infile[128];
-char outfile[128];
+char infile[1024];
+char outfile[1024];
+char statlist[1024];
+char outpath[1024];
+char str[2048];
 
 int inbin = 0;
 int outbin = 0;
+int nthreads = 1;
+float pgabin = 0.0;
+
+statlist[0] = '\0';
+sprintf(outpath,".");
 
 setpar(ac,av);
 
-mstpar("infile","s",infile);
-mstpar("outfile","s",outfile);
+getpar("statlist","s",statlist);
+if(statlist[0] == '\0')
+   {
+   mstpar("infile","s",infile);
+   mstpar("outfile","s",outfile);
+   }
+getpar("outpath","s",outpath);
 getpar("inbin","d",&inbin);
 getpar("outbin","d",&outbin);
+getpar("nthreads","d",&nthreads);
+getpar("pgabin","f",&pgabin);
 
 endpar();
 
+/* many stations */
+if(statlist[0] != '\0')
+   {
+   wcc_siteamp14_config(ac, av, &sp);
+
+   st = (struct station *) check_malloc(MAXFILES*sizeof(struct station));
+   nstat = read_stations(statlist,&sp,st);
+   makedir(outpath);
+
+   nhit = 0;
+   nmiss = 0;
+
+#pragma omp parallel num_threads(nthreads) private(i,s1,head1,sps,cc,str) reduction(+:nhit,nmiss)
+   {
+   s1 = NULL;
+   cc = (struct siteamp14_cache *) check_malloc(sizeof(struct siteamp14_cache));
+   siteamp14_cache_init(cc,pgabin);
+
+#pragma omp for schedule(dynamic,1)
+   for(i=0;i<nstat;i++)
+      {
+      s1 = read_wccseis(st[i].infile,&head1,s1,inbin);
+
+      sps = sp;
+      sps.vsite = st[i].vsite;
+      sps.vpga = st[i].vpga;
+      sps.pga = st[i].pga;
+      wcc_siteamp14_apply_cached(&sps, cc, &s1, &head1);
+
+      set_fullpath(str,outpath,st[i].outfile);
+      write_wccseis(str,&head1,s1,outbin);
+      }
+
+   nhit = nhit + cc->nhit;
+   nmiss = nmiss + cc->nmiss;
+   siteamp14_cache_free(cc);
+   free(cc);
+   free(s1);
+   }
+
+   fprintf(stderr,"%d stations, %d ampf curves computed\n",nstat,nmiss);
+   exit(0);
+   }
+
 s1 = NULL;
 s1 = read_wccseis(infile,&head1,s1,inbin);
 
@@ -1,47 +1,138 @@
+/**********************************************************************/
+/*                                                                    */
+/*           wcc_specmod                                              */
+/*                                                                    */
+/*           Scales the spectrum of infile by the curve of specfile   */
+/*           (frequency, factor lines, interpolated linearly, 1       */
+/*           outside of it) into outfile.                             */
+/*                                                                    */
+/*           With filelist= (one "infile outfile" pair per line)      */
+/*           many traces are done in one run, by nthreads= OpenMP     */
+/*           threads.  specfile is read once and the curve is put on  */
+/*           the FFT frequencies once for each FFT length and dt.     */
+/*                                                                    */
+/**********************************************************************/
+
 #include "include.h"
 #include "structure.h"
 #include "function.h"
+#include "getpar.h"
 
 #define TAP_PERC 0.05
 #define SPEC_BLOCK 10000
 
-struct complex
+#define LINELEN 1024
+#define MAXCURVES 64
+
+/* the factors of the FFT frequencies i*df, i < n/2, for FFT length n and dt */
+struct specmod_curve
    {
-   float re;
-   float im;
+   int n;
+   float dt;
+   float *fac;
    };
 
+static struct specmod_curve curves[MAXCURVES];
+static int ncurves = 0;
+
+float *read_specfile(char *,int *);
+float *get_curve(int,float,float *,int);
+void specmod(char *,char *,int,int,float,float *,int);
+void curve(float *,float *,int,float *,float *,int);
+void ampfac(struct complex *,float *,int);
+void norm(float *,float *,int);
+void zero(float *,int);
+void taper_norm(float *,float *,int,float *);
+void getpeak(float *,int,float *);
+
 int size_float = sizeof(float);
 int size_int = sizeof(int);
 
-main(int ac,char **av)
+int main(int ac,char **av)
 {
 FILE *fpr, *fopfile();
-struct statdata head1;
-float *s1, vref, vsite, vrat;
-int nt_p2;
-float *fsp, *asp;
-int ns, n;
+float *fsp;
+int ns, n, na, nfile, nalloc;
+char (*infiles)[LINELEN], (*outfiles)[LINELEN];
 
 float tap_per = TAP_PERC;
 
-char str[512];
-char infile[128];
+char str[LINELEN];
+char infile[LINELEN];
 char specfile[128];
-char outfile[128];
+char outfile[LINELEN];
+char filelist[512];
 
 int inbin = 0;
 int outbin = 0;
+int nthreads = 1;
+
+filelist[0] = '\0';
 
 setpar(ac,av);
-mstpar("infile","s",infile);
+getpar("filelist","s",filelist);
+if(filelist[0] == '\0')
+   {
+   mstpar("infile","s",infile);
+   mstpar("outfile","s",outfile);
+   }
 mstpar("specfile","s",specfile);
-mstpar("outfile","s",outfile);
 getpar("tap_per","f",&tap_per);
 getpar("inbin","d",&inbin);
 getpar("outbin","d",&outbin);
+getpar("nthreads","d",&nthreads);
 endpar();
 
+fsp = read_specfile(specfile,&ns);
+
+for(n=0;n<ns;n++)
+   fprintf(stderr,"%13.5e %13.5e\n",fsp[n],fsp[ns+n]);
+
+if(filelist[0] == '\0')
+   {
+   specmod(infile,outfile,inbin,outbin,tap_per,fsp,ns);
+   exit(0);
+   }
+
+infiles = NULL;
+outfiles = NULL;
+nfile = 0;
+nalloc = 0;
+
+fpr = fopfile(filelist,"r");
+while(fgets(str,LINELEN,fpr) != NULL)
+   {
+   if(nfile == nalloc)
+      {
+      nalloc = nalloc + 1024;
+      infiles = check_realloc(infiles,nalloc*LINELEN);
+      outfiles = check_realloc(outfiles,nalloc*LINELEN);
+      }
+
+   na = sscanf(str,"%1023s %1023s",infiles[nfile],outfiles[nfile]);
+   if(na < 2 || infiles[nfile][0] == '#')
+      continue;
+   nfile++;
+   }
+fclose(fpr);
+
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic,1)
+for(n=0;n<nfile;n++)
+   specmod(infiles[n],outfiles[n],inbin,outbin,tap_per,fsp,ns);
+}
+
+/*
+   The ns points of specfile, the frequencies in fsp[0..ns-1] and the
+   factors in fsp[ns..2*ns-1], with a first point (0.0, 1.0) and a
+   last one (1.0e+15, 1.0) added.
+*/
+float *read_specfile(char *specfile,int *nsp)
+{
+FILE *fpr, *fopfile();
+float *fsp, *asp, *sp;
+char str[512];
+int ns, n;
+
 fsp = (float *)check_malloc(SPEC_BLOCK*sizeof(float));
 asp = (float *)check_malloc(SPEC_BLOCK*sizeof(float));
 
@@ -78,33 +169,89 @@ fsp[ns] = 1.0e+15;
 asp[ns] = 1.0;
 ns++;
 
+sp = (float *)check_malloc(2*ns*sizeof(float));
 for(n=0;n<ns;n++)
-   fprintf(stderr,"%13.5e %13.5e\n",fsp[n],asp[n]);
+   {
+   sp[n] = fsp[n];
+   sp[ns+n] = asp[n];
+   }
+free(fsp);
+free(asp);
+
+*nsp = ns;
+return(sp);
+}
+
+/* the curve of FFT length n and dt, made the first time it is asked for */
+float *get_curve(int n,float dt,float *fsp,int ns)
+{
+float *fac;
+int i;
+
+fac = NULL;
+
+#pragma omp critical (specmod_curves)
+{
+for(i=0;i<ncurves;i++)
+   {
+   if(curves[i].n == n && curves[i].dt == dt)
+      {
+      fac = curves[i].fac;
+      break;
+      }
+   }
+
+if(fac == NULL)
+   {
+   fac = (float *)check_malloc((n/2+1)*sizeof(float));
+   curve(fac,&dt,n,fsp,fsp+ns,ns);
+
+   if(ncurves < MAXCURVES)
+      {
+      curves[ncurves].n = n;
+      curves[ncurves].dt = dt;
+      curves[ncurves].fac = fac;
+      ncurves++;
+      }
+   }
+}
+
+return(fac);
+}
+
+/* one trace, infile to outfile */
+void specmod(char *infile,char *outfile,int inbin,int outbin,float tap_per,float *fsp,int ns)
+{
+struct statdata head1;
+float *s1, *fac;
+int nt_p2;
 
 s1 = NULL;
 s1 = read_wccseis(infile,&head1,s1,inbin);
 
-nt_p2 = getnt_p2(head1.nt);
-s1 = (float *) check_realloc (s1,nt_p2*size_float);
+nt_p2 = getnt_fftpad(head1.nt);
+s1 = (float *) check_realloc (s1,(nt_p2+2)*size_float);
 
 taper_norm(s1,&head1.dt,head1.nt,&tap_per);
 zero(s1+head1.nt,(nt_p2)-head1.nt);
-forfft(s1,nt_p2,-1);
+rfft_r2c(s1,nt_p2,-1);
 
-ampfac(s1,&head1.dt,nt_p2,fsp,asp,ns);
+fac = get_curve(nt_p2,head1.dt,fsp,ns);
+ampfac((struct complex *)s1,fac,nt_p2);
 
-invfft(s1,nt_p2,1);
+rfft_c2r(s1,nt_p2,1);
 norm(s1,&head1.dt,nt_p2);
 
 write_wccseis(outfile,&head1,s1,outbin);
+free(s1);
 }
 
-ampfac(g,dt,n,fsp,asp,nsp)
-struct complex *g;
-float *dt, *fsp, *asp;
+/* the factors of the frequencies i*df, 0 < i < n/2 */
+void curve(fac,dt,n,fsp,asp,nsp)
+float *fac, *dt, *fsp, *asp;
 int n, nsp;
 {
-float fac, df, freq;
+float df, freq;
 int i, j, jb, j1, nsp1;
 
 nsp1 = nsp - 1;
@@ -116,9 +263,9 @@ for(i=1;i<n/2;i++)
    freq = i*df;
 
    if(freq < fsp[0])
-      fac = 1.0;
+      fac[i] = 1.0;
    else if(freq >= fsp[nsp1])
-      fac = 1.0;
+      fac[i] = 1.0;
    else
       {
       j = jb;
@@ -128,19 +275,26 @@ for(i=1;i<n/2;i++)
       jb = j;
       j1 = j - 1;
 
-      fac = asp[j1] + (freq-fsp[j1])*(asp[j]-asp[j1])/(fsp[j]-fsp[j1]);
+      fac[i] = asp[j1] + (freq-fsp[j1])*(asp[j]-asp[j1])/(fsp[j]-fsp[j1]);
       }
+   }
+}
 
-   /*
-   fprintf(stderr,"%13.5e %13.5e\n",freq,fac);
-   */
+void ampfac(g,fac,n)
+struct complex *g;
+float *fac;
+int n;
+{
+int i;
 
-   g[i].re = fac*g[i].re;
-   g[i].im = fac*g[i].im;
+for(i=1;i<n/2;i++)
+   {
+   g[i].re = fac[i]*g[i].re;
+   g[i].im = fac[i]*g[i].im;
    }
 }
 
-norm(g,dt,nt)
+void norm(g,dt,nt)
 float *g, *dt;
 int nt;
 {
@@ -154,7 +308,7 @@ while(nt--)
    }
 }
 
-zero(s,n)
+void zero(s,n)
 float *s;
 int n;
 {
@@ -165,7 +319,7 @@ while(n--)
    }
 }
 
-taper_norm(g,dt,nt,tap_per)
+void taper_norm(g,dt,nt,tap_per)
 float *g, *dt, *tap_per;
 int nt;
 {
@@ -190,28 +344,7 @@ if(ntap > 0)
    }
 }
 
-getnt_p2(nt)
-int nt;
-{
-int i = 0;
-
-while(nt > 1)
-   {
-   if(nt%2)
-      nt++;
-
-   nt = nt/2;
-   i++;
-   }
-
-nt = 1;
-while(i--)
-   nt = nt*2;
-
-return(nt);
-}
-
-getpeak(s,nt,pga)
+void getpeak(s,nt,pga)
 float *s, *pga;
 int nt;
 {
@@ -5,6 +5,11 @@
 /*           N-th order high-pass, low-pass and band-pass             */
 /*           Butterworth filters for time series.                     */
 /*                                                                    */
+/*           All traces in filelist= are filtered with one set of     */
+/*           parameters.  The filter sections are computed once per   */
+/*           dt, and nthreads= OpenMP threads share out the traces.   */
+/*           With sos=1, lanes= traces are filtered in lockstep.      */
+/*                                                                    */
 /**********************************************************************/
 
 #include "include.h"
@@ -13,7 +18,7 @@
 #include "getpar.h"
 
 #define 	PI 		3.14159265
-#define         MAXFILES        500
+#define         MAXFILES        50000
 
 void hp_filter(struct complex* q,struct complex* p,int n,float* alpha,float* beta,int sgn);
 void lp_filter(struct complex* q,struct complex* p,int n,float* alpha,float* beta,int sgn);
@@ -23,19 +28,25 @@ int main (ac, av)
 int ac;
 char **av;
 {
-char infilebuf[MAXFILES*256];
-char outfilebuf[MAXFILES*256];
+char *infilebuf, *outfilebuf;
 
 struct statdata shead1;
-char *infile[MAXFILES], *outfile[MAXFILES], *string, *readline(), filelist[256];
+struct tfilter_par tp;
+struct tfilter_coef tc;
+struct tfilter_sos ts;
+char **infile, **outfile, *string, *readline(), filelist[256];
 char str[512];
-struct complex *q, *p;
 float *s1;
 int j, it, i;
 int nshft, inchar, outchar, nstat, nt6;
 
 int inbin = 0;
 int outbin = 0;
+int nthreads = 1;
+int lanes = 8;
+float **sl;
+struct statdata *hl;
+int nl, k;
 
 FILE *fopfile(), *fmake_or_open(), *fpr, *fpw;
 char outpath[256];
@@ -48,7 +59,11 @@ if(ac == 1)
    printf("     This means that the passband will be:  'fhi' < f < 'flo'.\n\n");
    printf("     For a high-pass only filter, set fhi=f0, flo=1.0e+10;\n");
    printf("     for a low-pass only filter, set fhi=0.0, flo=f0;\n");
-   printf("     where 'f0' is the cutoff frequency in either case.\n");
+   printf("     where 'f0' is the cutoff frequency in either case.\n\n");
+   printf("     sos=1 runs the same filter as real second-order sections\n");
+   printf("     (same response to rounding, less memory and time);\n");
+   printf("     with sos=1, lanes=n (default 8, at most 16) filters n traces\n");
+   printf("     at a time, each identical to filtering it alone.\n");
    exit(1);
    }
 
@@ -57,8 +72,17 @@ mstpar("filelist","s",filelist);
 mstpar("outpath","s",outpath);
 getpar("inbin","d",&inbin);
 getpar("outbin","d",&outbin);
+getpar("nthreads","d",&nthreads);
+getpar("lanes","d",&lanes);
 endpar();
 
+wcc_tfilter_config(ac, av, &tp);
+
+infilebuf = (char *) check_malloc(MAXFILES*256);
+outfilebuf = (char *) check_malloc(MAXFILES*256);
+infile = (char **) check_malloc(MAXFILES*sizeof(char *));
+outfile = (char **) check_malloc(MAXFILES*sizeof(char *));
+
 /*  read in input data filenames */
  
 fpr = fopfile(filelist,"r");
@@ -110,22 +134,91 @@ if(!nstat) {
   exit(0);
 }
 
-s1 = NULL;
-p = NULL;
-q = NULL;
-for(i=0;i<nstat;i++)
+/* make sure output directory exists */
+
+makedir(outpath);
+set_fullpath(str,outpath,"");   /* adds the trailing '/', outpath is read-only below */
+
+/* each thread keeps its trace buffer and the sections for the last dt */
+
+if(tp.sos && lanes > 1)
+   {
+   if(lanes > TFILTER_MAXLANE)
+      lanes = TFILTER_MAXLANE;
+
+   /* groups of 'lanes' traces; runs with the same nt and dt are filtered together */
+#pragma omp parallel num_threads(nthreads) private(i,j,k,nl,sl,hl,ts,str)
    {
-   s1 = read_wccseis(infile[i],&shead1,s1,inbin);
+   sl = (float **) check_malloc(lanes*sizeof(float *));
+   hl = (struct statdata *) check_malloc(lanes*sizeof(struct statdata));
+   for(k=0;k<lanes;k++)
+      sl[k] = NULL;
+   ts.dt = -1.0;
+
+#pragma omp for schedule(dynamic,1)
+   for(i=0;i<nstat;i=i+lanes)
+      {
+      nl = (nstat-i < lanes) ? nstat-i : lanes;
+      for(k=0;k<nl;k++)
+         sl[k] = read_wccseis(infile[i+k],&hl[k],sl[k],inbin);
+
+      for(k=0;k<nl;k=k+j)
+         {
+         j = 1;
+         while(k+j < nl && hl[k+j].nt == hl[k].nt && hl[k+j].dt == hl[k].dt)
+            j++;
+
+         if(hl[k].dt != ts.dt)
+            wcc_tfilter_sos(&tp, hl[k].dt, &ts);
+         wcc_tfilter_sos_multi(&ts, sl+k, j, hl[k].nt, j);
+         }
+
+      for(k=0;k<nl;k++)
+         {
+         set_fullpath(str,outpath,outfile[i+k]);
+         printf("Writing to %s.\n", str);
+         write_wccseis(str,&hl[k],sl[k],outbin);
+         }
+      }
 
-   wcc_tfilter(ac, av, s1, &shead1);
+   for(k=0;k<lanes;k++)
+      free(sl[k]);
+   free(sl);
+   free(hl);
+   }
+   return(0);
+   }
 
-   /* make sure output directory exists */
- 
-   makedir(outpath);
+#pragma omp parallel num_threads(nthreads) private(i,s1,shead1,tc,ts,str)
+   {
+   s1 = NULL;
+   tc.dt = -1.0;
+   ts.dt = -1.0;
+
+#pragma omp for schedule(dynamic,1)
+   for(i=0;i<nstat;i++)
+      {
+      s1 = read_wccseis(infile[i],&shead1,s1,inbin);
+
+      if(tp.sos)
+         {
+         if(shead1.dt != ts.dt)
+            wcc_tfilter_sos(&tp, shead1.dt, &ts);
+         wcc_tfilter_sos_run(&ts, s1, shead1.nt);
+         }
+      else
+         {
+         if(shead1.dt != tc.dt)
+            wcc_tfilter_coef(&tp, shead1.dt, &tc);
+         wcc_tfilter_run(&tc, s1, shead1.nt);
+         }
+
+      set_fullpath(str,outpath,outfile[i]);
+      printf("Writing to %s.\n", str);
+      write_wccseis(str,&shead1,s1,outbin);
+      }
 
-   set_fullpath(str,outpath,outfile[i]);
-   printf("Writing to %s.\n", str);
-   write_wccseis(str,&shead1,s1,outbin);
+   free(s1);
    }
    return(0);
 }
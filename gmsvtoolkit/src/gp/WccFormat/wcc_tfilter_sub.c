@@ -32,24 +32,52 @@ for(i=0;i<n;i++)
    p[i].re = p[i].im = zap;
 }
 
-void hp_filter(q,p,n,alpha,beta,sgn)
-struct complex *q, *p;
+/* bilinear factors of one first-order section with pole (alpha,beta) */
+
+void hp_sect(fs,alpha,beta)
+struct tfilter_sect *fs;
 float *alpha, *beta;
-int n, sgn;
 {
-float are, aim, bre, bim;
 float tmpre, tmpim, denom;
 float one = 1.0;
-int i, n1, k;
 
 tmpre = one - (*alpha);
 tmpim = -(*beta);
 denom = one/(tmpre*tmpre + tmpim*tmpim);
-are = tmpre*denom;
-aim = -tmpim*denom;
+fs->are = tmpre*denom;
+fs->aim = -tmpim*denom;
+
+fs->bre = one + (*alpha);
+fs->bim = (*beta);
+
+fs->lp = 0;
+}
 
-bre = one + (*alpha);
-bim = (*beta);
+void lp_sect(fs,alpha,beta)
+struct tfilter_sect *fs;
+float *alpha, *beta;
+{
+hp_sect(fs,alpha,beta);
+
+fs->cre = -(*alpha);
+fs->cim = -(*beta);
+
+fs->lp = 1;
+}
+
+void hp_run(q,p,n,fs,sgn)
+struct complex *q, *p;
+struct tfilter_sect *fs;
+int n, sgn;
+{
+float are, aim, bre, bim;
+float tmpre, tmpim;
+int i, n1, k;
+
+are = fs->are;
+aim = fs->aim;
+bre = fs->bre;
+bim = fs->bim;
 
 n1 = n - 1;
 if(sgn == 1)
@@ -75,27 +103,21 @@ while(n1--)
    }
 }
 
-void lp_filter(q,p,n,alpha,beta,sgn)
+void lp_run(q,p,n,fs,sgn)
 struct complex *q, *p;
-float *alpha, *beta;
+struct tfilter_sect *fs;
 int n, sgn;
 {
 float are, aim, bre, bim, cre, cim;
-float tmpre, tmpim, denom;
-float one = 1.0;
+float tmpre, tmpim;
 int i, n1, k;
 
-tmpre = one - (*alpha);
-tmpim = -(*beta);
-denom = one/(tmpre*tmpre + tmpim*tmpim);
-are = tmpre*denom;
-aim = -tmpim*denom;
-
-bre = one + (*alpha);
-bim = (*beta);
-
-cre = -(*alpha);
-cim = -(*beta);
+are = fs->are;
+aim = fs->aim;
+bre = fs->bre;
+bim = fs->bim;
+cre = fs->cre;
+cim = fs->cim;
 
 n1 = n - 1;
 if(sgn == 1)
@@ -126,6 +148,28 @@ while(n1--)
    }
 }
 
+void hp_filter(q,p,n,alpha,beta,sgn)
+struct complex *q, *p;
+float *alpha, *beta;
+int n, sgn;
+{
+struct tfilter_sect fs;
+
+hp_sect(&fs,alpha,beta);
+hp_run(q,p,n,&fs,sgn);
+}
+
+void lp_filter(q,p,n,alpha,beta,sgn)
+struct complex *q, *p;
+float *alpha, *beta;
+int n, sgn;
+{
+struct tfilter_sect fs;
+
+lp_sect(&fs,alpha,beta);
+lp_run(q,p,n,&fs,sgn);
+}
+
 void set_fullpath(fname,path,name)
 char *path, *name, *fname;
 {
@@ -254,109 +298,341 @@ return(nc);
 }
 
 void wcc_tfilter (int param_string_len, char** param_string, float* s1, struct statdata* shead1) {
-	struct complex *q, *p, *tmpptr;
-	double trig_arg;
-	int j, it, order, i;
-	int rval;
-	float wplo, wphi, cosA, sinA;
-	float fhi, flo, fnyq;
-	float are, aim;
-	float one = 1.0;
-	float two = 2.0;
-	int phase = 0;
+	struct tfilter_par tp;
 
-	order = 0;
-	fhi = 0.0;
-	flo = 1.0e+15;
+	wcc_tfilter_config(param_string_len, param_string, &tp);
+	wcc_tfilter_apply(&tp, s1, shead1);
+}
 
-	setpar(param_string_len, param_string);
-	getpar("order","d",&order);
-	getpar("fhi","f",&fhi);
-	getpar("flo","f",&flo);
-	getpar("phase","d",&phase);
-	endpar();
+/* parse the wcc_tfilter parameters once, for wcc_tfilter_apply() */
+void wcc_tfilter_config (int param_string_len, char** param_string, struct tfilter_par* tp) {
+	gp_ctx *gp;
+
+	tp->order = 0;
+	tp->fhi = 0.0;
+	tp->flo = 1.0e+15;
+	tp->phase = 0;
+	tp->sos = 0;
+
+	gp = gp_setpar(param_string_len, param_string);
+	gp_getpar(gp,"order","d",&tp->order);
+	gp_getpar(gp,"fhi","f",&tp->fhi);
+	gp_getpar(gp,"flo","f",&tp->flo);
+	gp_getpar(gp,"phase","d",&tp->phase);
+	gp_getpar(gp,"sos","d",&tp->sos);
+	gp_endpar(gp);
+
+	if(tp->order > TFILTER_MAXORDER)
+	{
+		fprintf(stderr,"wcc_tfilter: order=%d, at most %d, exiting...\n",tp->order,TFILTER_MAXORDER);
+		exit(-1);
+	}
+}
 
-	p = NULL;
-	q = NULL;
-	p = (struct complex *) check_realloc(p,shead1->nt*size_cx);
-	q = (struct complex *) check_realloc(q,shead1->nt*size_cx);
+void wcc_tfilter_apply (struct tfilter_par* tp, float* s1, struct statdata* shead1) {
+	struct tfilter_coef tc;
+	struct tfilter_sos ts;
+	double t0;
 
-	for(it=0;it<shead1->nt;it++)
+	t0 = prof_start();
+	if(tp->sos)
 	{
-		p[it].re = s1[it];
-		p[it].im = 0.0;
+		wcc_tfilter_sos(tp, shead1->dt, &ts);
+		wcc_tfilter_sos_run(&ts, s1, shead1->nt);
+	}
+	else
+	{
+		wcc_tfilter_coef(tp, shead1->dt, &tc);
+		wcc_tfilter_run(&tc, s1, shead1->nt);
 	}
+	prof_stop("wcc_tfilter", t0, shead1->nt);
+}
+
+/* cascade of first-order sections for the parameters tp at time step dt */
+void wcc_tfilter_coef (struct tfilter_par* tp, float dt, struct tfilter_coef* tc) {
+	double trig_arg;
+	int j;
+	float wplo, wphi, cosA, sinA;
+	float fnyq;
+	float are, aim;
+	float one = 1.0;
+	float two = 2.0;
 
-	czero(q,shead1->nt);
+	tc->order = tp->order;
+	tc->fhi = tp->fhi;
+	tc->flo = tp->flo;
+	tc->dt = dt;
+	tc->phase = tp->phase;
+	tc->nsect = 0;
 
-	fnyq = one/(two*shead1->dt);
+	fnyq = one/(two*dt);
 
-	if(fhi < fnyq)
-		wphi = tan(PI*fhi*shead1->dt);
+	if(tp->fhi < fnyq)
+		wphi = tan(PI*tp->fhi*dt);
 	else
 	wphi = 1.0e+10;
 
-	if(flo < fnyq)
-		wplo = tan(PI*flo*shead1->dt);
-
-        /*  forward pass  */
+	if(tp->flo < fnyq)
+		wplo = tan(PI*tp->flo*dt);
 
-	for(j=0;j<order;j++)
+	for(j=0;j<tp->order;j++)
 	{
-		trig_arg = 0.5*(two*j + one)*PI/order;
+		trig_arg = 0.5*(two*j + one)*PI/tp->order;
 		cosA = cos(trig_arg);
 		sinA = -sin(trig_arg);
 
-		if(flo < fnyq)    /* low-pass filter */
+		if(tp->flo < fnyq)    /* low-pass filter */
 		{
 			are = wplo*sinA;
 		        aim = -wplo*cosA;
-			lp_filter(q,p,shead1->nt,&are,&aim,1);
-
-		        tmpptr = p; p = q; q = tmpptr;
+			lp_sect(&tc->sect[tc->nsect],&are,&aim);
+			tc->nsect++;
 		}
-		if(fhi >= 0.0)    /* high-pass filter */
+		if(tp->fhi >= 0.0)    /* high-pass filter */
          	{
          	are = wphi*sinA;
          	aim = -wphi*cosA;
-         	hp_filter(q,p,shead1->nt,&are,&aim,1);
-
-         	tmpptr = p; p = q; q = tmpptr;
+			hp_sect(&tc->sect[tc->nsect],&are,&aim);
+			tc->nsect++;
          	}
 	}
+}
+
+/* run the cascade tc over the nt samples of s1, in place */
+void wcc_tfilter_run (struct tfilter_coef* tc, float* s1, int nt) {
+	struct complex *q, *p, *tmpptr;
+	size_t mark;
+	int j, it;
+
+	mark = arena_mark();
+	p = (struct complex *) arena_alloc(nt*size_cx);
+	q = (struct complex *) arena_alloc(nt*size_cx);
+
+	for(it=0;it<nt;it++)
+	{
+		p[it].re = s1[it];
+		p[it].im = 0.0;
+	}
+
+	czero(q,nt);
+
+        /*  forward pass  */
+
+	for(j=0;j<tc->nsect;j++)
+	{
+		if(tc->sect[j].lp)
+			lp_run(q,p,nt,&tc->sect[j],1);
+		else
+			hp_run(q,p,nt,&tc->sect[j],1);
+
+		tmpptr = p; p = q; q = tmpptr;
+	}
 
         /*  reverse pass to obtain zero-phase response  */
 
-	if(phase == 0)
+	if(tc->phase == 0)
 	{
-   		for(j=0;j<order;j++)
-        	{
-        		trig_arg = 0.5*(two*j + one)*PI/order;
-         		cosA = cos(trig_arg);
-         		sinA = -sin(trig_arg);
-
-         		if(flo < fnyq)    /* low-pass filter */
-            		{
-            			are = wplo*sinA;
-            			aim = -wplo*cosA;
-            			lp_filter(q,p,shead1->nt,&are,&aim,-1);
-
-            			tmpptr = p; p = q; q = tmpptr;
-            		}
-
-         		if(fhi >= 0.0)    /* high-pass filter */
-            		{
-            			are = wphi*sinA;
-            			aim = -wphi*cosA;
-            			hp_filter(q,p,shead1->nt,&are,&aim,-1);
-
-            			tmpptr = p; p = q; q = tmpptr;
-            		}
-         	}
-      }
-	for(it=0;it<shead1->nt;it++)
+		for(j=0;j<tc->nsect;j++)
+		{
+			if(tc->sect[j].lp)
+				lp_run(q,p,nt,&tc->sect[j],-1);
+			else
+				hp_run(q,p,nt,&tc->sect[j],-1);
+
+			tmpptr = p; p = q; q = tmpptr;
+		}
+	}
+	for(it=0;it<nt;it++)
 		s1[it] = p[it].re;
 
-	free(p);
-	free(q);
+	arena_release(mark);
+}
+
+/*
+ *  Real-valued form of the same filter.  A first-order section above
+ *  with pole parameter c = alpha + i*beta is
+ *
+ *     high-pass:  (1 - 1/z) / ((1-c) - (1+c)/z)
+ *     low-pass:  -c (1 + 1/z) / ((1-c) - (1+c)/z)
+ *
+ *  and the poles j and order-1-j are complex conjugates, so each pair
+ *  multiplies out to a biquad with real coefficients
+ *
+ *     den = |1-c|^2 - 2(1-|c|^2)/z + |1+c|^2/z^2
+ *     num = (1 - 1/z)^2  or  |c|^2 (1 + 1/z)^2
+ *
+ *  while for odd order the middle pole is real and stays first order.
+ *  The coefficients and the filter state are double, which also keeps
+ *  poles close to z=1 (low fhi*dt) well conditioned; the trace is
+ *  filtered in place as float.
+ */
+
+static void sos_add(ts,c_re,c_im,lp,npair)
+struct tfilter_sos *ts;
+double c_re, c_im;
+int lp, npair;
+{
+double a0, cc, g;
+int k = ts->nsos;
+
+cc = c_re*c_re + c_im*c_im;
+if(npair)
+   {
+   a0 = (1.0-c_re)*(1.0-c_re) + c_im*c_im;
+   ts->a1[k] = -2.0*(1.0 - cc)/a0;
+   ts->a2[k] = ((1.0+c_re)*(1.0+c_re) + c_im*c_im)/a0;
+   g = (lp ? cc : 1.0)/a0;
+   ts->b0[k] = g;
+   ts->b1[k] = (lp ? 2.0 : -2.0)*g;
+   ts->b2[k] = g;
+   }
+else
+   {
+   a0 = 1.0 - c_re;
+   ts->a1[k] = -(1.0 + c_re)/a0;
+   ts->a2[k] = 0.0;
+   g = (lp ? -c_re : 1.0)/a0;
+   ts->b0[k] = g;
+   ts->b1[k] = (lp ? g : -g);
+   ts->b2[k] = 0.0;
+   }
+ts->nsos++;
+}
+
+/* biquad cascade for the parameters tp at time step dt */
+void wcc_tfilter_sos (struct tfilter_par* tp, float dt, struct tfilter_sos* ts) {
+	double trig_arg, w, cosA, sinA;
+	double fnyq;
+	int j, lp;
+
+	ts->dt = dt;
+	ts->phase = tp->phase;
+	ts->nsos = 0;
+
+	fnyq = 1.0/(2.0*dt);
+
+	for(lp=1;lp>=0;lp--)
+	{
+		if(lp && tp->flo >= fnyq)
+			continue;
+		if(!lp && (tp->fhi < 0.0 || tp->fhi == 0.0))
+			continue;     /* fhi=0 is the identity */
+
+		if(lp)
+			w = tan(PI*tp->flo*dt);
+		else if(tp->fhi < fnyq)
+			w = tan(PI*tp->fhi*dt);
+		else
+			w = 1.0e+10;
+
+		for(j=0;j<tp->order/2;j++)
+		{
+			trig_arg = 0.5*(2.0*j + 1.0)*PI/tp->order;
+			cosA = cos(trig_arg);
+			sinA = -sin(trig_arg);
+			sos_add(ts,w*sinA,-w*cosA,lp,1);
+		}
+		if(tp->order%2)
+			sos_add(ts,-w,0.0,lp,0);
+	}
+}
+
+/*
+ *  Runs the cascade over nl traces interleaved sample by sample,
+ *  s[it*nl + l], forward (dir=1) or backward (dir=-1).  All sections
+ *  are applied to a sample before the next one (transposed direct
+ *  form II), and the inner loop is over the lanes, with no dependency
+ *  between them; it is vectorized for the CPU (SIMD_CLONES).
+ */
+SIMD_CLONES static void sos_lanes(struct tfilter_sos *ts,float *s,int nt,int nl,int dir)
+{
+double z1[TFILTER_MAXORDER+2][TFILTER_MAXLANE];
+double z2[TFILTER_MAXORDER+2][TFILTER_MAXLANE];
+double v[TFILTER_MAXLANE], y;
+double b0, b1, b2, a1, a2;
+float *ps;
+int it, k, l;
+
+for(k=0;k<ts->nsos;k++)
+   {
+   for(l=0;l<nl;l++)
+      z1[k][l] = z2[k][l] = 0.0;
+   }
+
+for(it=0;it<nt;it++)
+   {
+   ps = s + ((dir > 0) ? it : nt-1-it)*nl;
+   for(l=0;l<nl;l++)
+      v[l] = ps[l];
+
+   for(k=0;k<ts->nsos;k++)
+      {
+      b0 = ts->b0[k];
+      b1 = ts->b1[k];
+      b2 = ts->b2[k];
+      a1 = ts->a1[k];
+      a2 = ts->a2[k];
+      for(l=0;l<nl;l++)
+         {
+         y = b0*v[l] + z1[k][l];
+         z1[k][l] = b1*v[l] - a1*y + z2[k][l];
+         z2[k][l] = b2*v[l] - a2*y;
+         v[l] = y;
+         }
+      }
+
+   for(l=0;l<nl;l++)
+      ps[l] = v[l];
+   }
+}
+
+static void sos_pass(struct tfilter_sos *ts,float *s,int nt,int nl)
+{
+sos_lanes(ts,s,nt,nl,1);
+if(ts->phase == 0)
+   sos_lanes(ts,s,nt,nl,-1);
+}
+
+/* filter the nt samples of s1 in place with the biquads ts */
+void wcc_tfilter_sos_run (struct tfilter_sos* ts, float* s1, int nt) {
+	sos_pass(ts, s1, nt, 1);
+}
+
+/*
+ *  Filters the ntr traces s[0..ntr-1], all nt samples long, in groups
+ *  of nl (at most TFILTER_MAXLANE) interleaved lanes, e.g. the three
+ *  components of a station or 8/16 traces of one run.  Each lane does
+ *  exactly the operations of wcc_tfilter_sos_run() in the same order,
+ *  so every trace comes out bit-for-bit as filtered alone, provided
+ *  the file is built without floating-point contraction (see makefile).
+ */
+void wcc_tfilter_sos_multi (struct tfilter_sos* ts, float** s, int ntr, int nt, int nl) {
+	float *buf;
+	size_t mark;
+	int i, it, l, ng;
+
+	if(nl < 1)
+		nl = 1;
+	if(nl > TFILTER_MAXLANE)
+		nl = TFILTER_MAXLANE;
+
+	mark = arena_mark();
+	buf = (float *) arena_alloc(nt*nl*size_float);
+
+	for(i=0;i<ntr;i=i+nl)
+	{
+		ng = (ntr-i < nl) ? ntr-i : nl;
+
+		for(it=0;it<nt;it++)
+			for(l=0;l<ng;l++)
+				buf[it*ng+l] = s[i+l][it];
+
+		sos_pass(ts, buf, nt, ng);
+
+		for(it=0;it<nt;it++)
+			for(l=0;l<ng;l++)
+				s[i+l][it] = buf[it*ng+l];
+	}
+
+	arena_release(mark);
 }
@@ -0,0 +1,372 @@
+/*
+ * wcczip.c - compressed binary WCC files (see structure.h), bit exact.
+ *
+ * The samples are cut into chunks of wccz_head.chunk samples, each
+ * coded on its own, so a window of the trace decodes only the chunks
+ * it overlaps and chunks may be decoded by different threads.  In a
+ * chunk every float is first mapped to an integer key that orders like
+ * the float (wccz_key()); the keys are predicted from the previous one
+ * or two (order 0, 1 or 2, whichever codes the chunk shortest) and the
+ * zigzagged residuals are bit packed in blocks of WCCZ_BLOCK, each
+ * block as its width in bits (a byte) and then the packed residuals.
+ * A chunk is
+ *
+ *    order (a byte), then per block: width, packed residuals
+ *
+ * or, when that would be longer, WCCZ_RAW and the floats.
+ * Smooth synthetics and zero padding pack to a fraction of their
+ * size, noisy data to somewhat less than the 4 bytes per sample.
+ */
+
+#include "include.h"
+#include "structure.h"
+#include "function.h"
+
+#define WCCZ_BLOCK 32
+#define WCCZ_RAW 255     /* order byte of a chunk stored as floats */
+
+/* residuals of order p of the keys k[0..n-1], zigzagged */
+static void wccz_resid(unsigned int *k,int n,int p,unsigned int *z)
+{
+unsigned int r;
+int i;
+
+for(i=0;i<n;i++)
+   {
+   if(p == 0 || i == 0)
+      r = k[i];
+   else if(p == 1 || i == 1)
+      r = k[i] - k[i-1];
+   else
+      r = k[i] - 2*k[i-1] + k[i-2];
+
+   z[i] = (r << 1) ^ (unsigned int) ((int) r >> 31);
+   }
+}
+
+static int wccz_width(unsigned int *z,int n)
+{
+unsigned int m;
+int i, b;
+
+m = 0;
+for(i=0;i<n;i++)
+   m = m | z[i];
+
+b = 0;
+while(m)
+   {
+   b++;
+   m = m >> 1;
+   }
+return(b);
+}
+
+/* bytes of a chunk of the residuals z[0..n-1] */
+static size_t wccz_size(unsigned int *z,int n)
+{
+size_t len;
+int i, nb;
+
+len = 1;
+for(i=0;i<n;i=i+WCCZ_BLOCK)
+   {
+   nb = (n - i < WCCZ_BLOCK) ? n - i : WCCZ_BLOCK;
+   len = len + 1 + (nb*wccz_width(z+i,nb) + 7)/8;
+   }
+return(len);
+}
+
+static unsigned int wccz_key(float f)
+{
+unsigned int u;
+
+memcpy(&u,&f,sizeof(u));
+return((u & 0x80000000u) ? ~u : u | 0x80000000u);
+}
+
+static float wccz_unkey(unsigned int k)
+{
+unsigned int u;
+float f;
+
+u = (k & 0x80000000u) ? k & 0x7fffffffu : ~k;
+memcpy(&f,&u,sizeof(f));
+return(f);
+}
+
+/*
+   Chunk of the n samples s into buf (room for wccz_bound(n) bytes),
+   returns the bytes used.  key and z are work space of n ints each.
+*/
+static size_t wccz_chunk(float *s,int n,unsigned char *buf,unsigned int *key,unsigned int *z)
+{
+unsigned long long acc;
+size_t len, best;
+int i, j, p, pbest, nb, b, nbit;
+unsigned char *pb;
+
+for(i=0;i<n;i++)
+   key[i] = wccz_key(s[i]);
+
+pbest = 0;
+best = 0;
+for(p=0;p<3;p++)
+   {
+   wccz_resid(key,n,p,z);
+   len = wccz_size(z,n);
+   if(p == 0 || len < best)
+      {
+      best = len;
+      pbest = p;
+      }
+   }
+
+/* samples that do not pack are stored as they are */
+if(best >= 1 + n*sizeof(float))
+   {
+   buf[0] = WCCZ_RAW;
+   memcpy(buf+1,s,n*sizeof(float));
+   return(1 + n*sizeof(float));
+   }
+wccz_resid(key,n,pbest,z);
+
+pb = buf;
+*pb++ = (unsigned char) pbest;
+for(i=0;i<n;i=i+WCCZ_BLOCK)
+   {
+   nb = (n - i < WCCZ_BLOCK) ? n - i : WCCZ_BLOCK;
+   b = wccz_width(z+i,nb);
+   *pb++ = (unsigned char) b;
+
+   acc = 0;
+   nbit = 0;
+   for(j=0;j<nb && b;j++)
+      {
+      acc = acc | ((unsigned long long) z[i+j] << nbit);
+      nbit = nbit + b;
+      while(nbit >= 8)
+         {
+         *pb++ = (unsigned char) acc;
+         acc = acc >> 8;
+         nbit = nbit - 8;
+         }
+      }
+   if(nbit > 0)
+      *pb++ = (unsigned char) acc;
+   }
+return(pb - buf);
+}
+
+/* the n samples of the chunk at buf (len bytes) into s, -1 if corrupt */
+static int wccz_unchunk(unsigned char *buf,size_t len,int n,float *s)
+{
+unsigned long long acc;
+unsigned int r, k1, k2, mask;
+unsigned char *pb, *pe;
+int i, j, p, nb, b, nbit;
+
+pb = buf;
+pe = buf + len;
+if(pb >= pe)
+   return(-1);
+
+p = *pb++;
+if(p == WCCZ_RAW && len == 1 + n*sizeof(float))
+   {
+   memcpy(s,pb,n*sizeof(float));
+   return(0);
+   }
+if(p > 2)
+   return(-1);
+
+k1 = k2 = 0;
+for(i=0;i<n;i=i+WCCZ_BLOCK)
+   {
+   nb = (n - i < WCCZ_BLOCK) ? n - i : WCCZ_BLOCK;
+   if(pb >= pe || (b = *pb++) > 32)
+      return(-1);
+   if(pb + (nb*b + 7)/8 > pe)
+      return(-1);
+
+   mask = (b == 32) ? 0xffffffffu : (1u << b) - 1;
+   acc = 0;
+   nbit = 0;
+   for(j=0;j<nb;j++)
+      {
+      while(nbit < b)
+         {
+         acc = acc | ((unsigned long long) *pb++ << nbit);
+         nbit = nbit + 8;
+         }
+      r = (unsigned int) acc & mask;
+      if(b)
+         {
+         acc = acc >> b;
+         nbit = nbit - b;
+         }
+
+      r = (r >> 1) ^ (0u - (r & 1));
+      if(p == 1 && i + j > 0)
+         r = r + k1;
+      else if(p == 2 && i + j > 1)
+         r = r + 2*k1 - k2;
+      else if(p == 2 && i + j == 1)
+         r = r + k1;
+
+      k2 = k1;
+      k1 = r;
+      s[i+j] = wccz_unkey(r);
+      }
+   }
+return(0);
+}
+
+static size_t wccz_bound(int n)
+{
+return(1 + ((size_t) n/WCCZ_BLOCK + 1)*(1 + 4*WCCZ_BLOCK));
+}
+
+/*
+   Compressed file of the trace shead, s to fd, chunks of chunk samples
+   (<= 0 for WCCZ_CHUNK).  Returns the bytes written.
+*/
+size_t wccz_write(int fd,struct statdata *shead,float *s,int chunk)
+{
+struct wccz_head zh;
+long long *off;
+unsigned char *buf;
+unsigned int *key, *z;
+size_t len;
+int ic, i0, n;
+
+if(chunk <= 0)
+   chunk = WCCZ_CHUNK;
+
+memset(&zh,0,sizeof(zh));
+memcpy(zh.magic,WCCZ_MAGIC,sizeof(zh.magic));
+zh.shead = *shead;
+zh.chunk = chunk;
+zh.nchunk = (shead->nt + chunk - 1)/chunk;
+
+off = (long long *) check_malloc((zh.nchunk + 1)*sizeof(long long));
+buf = (unsigned char *) check_malloc(zh.nchunk*wccz_bound(chunk) + 1);
+key = (unsigned int *) check_malloc(chunk*sizeof(unsigned int));
+z = (unsigned int *) check_malloc(chunk*sizeof(unsigned int));
+
+len = 0;
+off[0] = sizeof(zh) + (zh.nchunk + 1)*sizeof(long long);
+for(ic=0;ic<zh.nchunk;ic++)
+   {
+   i0 = ic*chunk;
+   n = (shead->nt - i0 < chunk) ? shead->nt - i0 : chunk;
+   len = len + wccz_chunk(s+i0,n,buf+len,key,z);
+   off[ic+1] = off[0] + len;
+   }
+
+rite(fd,&zh,sizeof(zh));
+rite(fd,off,(zh.nchunk + 1)*sizeof(long long));
+rite(fd,buf,len);
+len = len + off[0];
+
+free(off);
+free(buf);
+free(key);
+free(z);
+return(len);
+}
+
+int wccz_check(void *head)
+{
+return(memcmp(head,WCCZ_MAGIC,8) == 0);
+}
+
+/*
+   Samples it0, it0+itskip, ... (before it1) of the compressed file fd
+   into s (reallocated), their number in *ns, shead its header.  The
+   first npre bytes of the file have been read into pre already and fd
+   is just past them.  A seekable fd reads only the chunks of the
+   window, others are read up to its end.
+*/
+float *wccz_read(int fd,char *pre,int npre,struct statdata *shead,float *s,int it0,int it1,int itskip,int *ns)
+{
+struct wccz_head zh;
+long long *off, pos;
+unsigned char *buf;
+size_t len;
+int ic, c0, c1, n, nw;
+
+if(npre > sizeof(zh))
+   npre = sizeof(zh);
+memcpy(&zh,pre,npre);
+reed(fd,(char *) &zh + npre,sizeof(zh) - npre);
+pos = sizeof(zh);
+
+*shead = zh.shead;
+if(!wccz_check(zh.magic) || zh.chunk <= 0 || zh.nchunk != (shead->nt + zh.chunk - 1)/zh.chunk)
+   {
+   fprintf(stderr,"BAD COMPRESSED WCC HEADER\n");
+   exit(-1);
+   }
+
+off = (long long *) check_malloc((zh.nchunk + 1)*sizeof(long long));
+reed(fd,off,(zh.nchunk + 1)*sizeof(long long));
+pos = pos + (zh.nchunk + 1)*sizeof(long long);
+
+if(itskip < 1)
+   itskip = 1;
+if(it0 < 0)
+   it0 = 0;
+if(it1 > shead->nt)
+   it1 = shead->nt;
+
+*ns = 0;
+if(it1 > it0)
+   *ns = (it1 - it0 + itskip - 1)/itskip;
+
+if(*ns == 0)
+   {
+   free(off);
+   return((float *) check_realloc(s,sizeof(float)));
+   }
+
+c0 = it0/zh.chunk;
+c1 = (it1 - 1)/zh.chunk;
+
+nw = (c1 - c0 + 1)*zh.chunk;
+s = (float *) check_realloc(s,nw*sizeof(float));
+
+if(lseek(fd,off[c0],SEEK_SET) != off[c0])
+   {
+   len = off[c0] - pos;
+   buf = (unsigned char *) check_malloc(len + 1);
+   reed(fd,buf,len);
+   free(buf);
+   }
+
+len = off[c1+1] - off[c0];
+buf = (unsigned char *) check_malloc(len + 1);
+if(reed(fd,buf,len) != len)
+   {
+   fprintf(stderr,"COMPRESSED WCC FILE TOO SHORT\n");
+   exit(-1);
+   }
+
+for(ic=c0;ic<=c1;ic++)
+   {
+   n = (shead->nt - ic*zh.chunk < zh.chunk) ? shead->nt - ic*zh.chunk : zh.chunk;
+   if(wccz_unchunk(buf + (off[ic] - off[c0]),off[ic+1] - off[ic],n,s + (ic - c0)*zh.chunk) != 0)
+      {
+      fprintf(stderr,"CORRUPT CHUNK %d OF COMPRESSED WCC FILE\n",ic);
+      exit(-1);
+      }
+   }
+
+it0 = it0 - c0*zh.chunk;
+for(n=0;n<*ns;n++)
+   s[n] = s[it0 + n*itskip];
+
+free(buf);
+free(off);
+return(s);
+}
@@ -20,6 +20,18 @@
  *		mstpar(name,type,valptr)
  *		endpar()
  *
+ * Reentrant versions, each call of gp_setpar() has its own list so
+ * that several threads can parse parameter lists at the same time:
+ *
+ *		c= gp_setpar(argc,argv)
+ *		gp_getpar(c,name,type,valptr)
+ *		gp_mstpar(c,name,type,valptr)
+ *		gp_endpar(c)
+ *
+ * Vector values "@file" (text) and "@@file" (native binary) are read
+ * from the file in one pass, and the types "vd@", "vf@", "vF@" and
+ * "s@" return a malloc'ed vector or string list of any length.
+ *
  * To get C-version:
  *		cc -c getpar.c
  *
@@ -103,32 +115,42 @@ struct ext_par		/* global variables for getpar */
 	int listmax;
 	int bufmax;
 	FILE *listout;
-  }	ext_par;
+  }	ext_par;	/* the list of setpar/getpar/endpar */
+
+/* the routines below work on the list ep points to */
 
 
 /* abbreviations: */
 #define AL 		struct arglist
-#define PROGNAME	ext_par.progname
-#define FLAGS		ext_par.argflags
-#define ARGLIST		ext_par.arglist
-#define ARGHEAD		ext_par.arghead
-#define ARGBUF		ext_par.argbuf
-#define NLIST		ext_par.nlist
-#define NBUF		ext_par.nbuf
-#define LISTMAX		ext_par.listmax
-#define BUFMAX		ext_par.bufmax
-#define LISTFILE	ext_par.listout
-
-static int gp_getvector(char *list, char *type, void *val);
+#define PROGNAME	ep->progname
+#define FLAGS		ep->argflags
+#define ARGLIST		ep->arglist
+#define ARGHEAD		ep->arghead
+#define ARGBUF		ep->argbuf
+#define NLIST		ep->nlist
+#define NBUF		ep->nbuf
+#define LISTMAX		ep->listmax
+#define BUFMAX		ep->bufmax
+#define LISTFILE	ep->listout
+
+static int gp_init(struct ext_par *ep, int ac, char **av);
+static int gp_get(struct ext_par *ep, char *name, char *type, void *val, int lens);
+static int gp_mst(struct ext_par *ep, char *name, char *type, void *val, int lens);
+static void gp_end(struct ext_par *ep);
+static int gp_getvector(struct ext_par *ep, char *list, char *type, void *val);
+static int gp_listvector(struct ext_par *ep, char *list, int vtype, void *val, int limit);
+static int gp_filevector(struct ext_par *ep, char *fname, int vtype, void **val, int limit, int alloc);
+static int gp_getlist(struct ext_par *ep, char *list, char ***val);
+static char *gp_readfile(struct ext_par *ep, char *fname, long *len);
 static int gp_compute_hash(char *s);
 static char *gp_fgets(char *line, int maxline, FILE *file);
-static FILE *gp_create_dump(char *fname, char *filetype);
-static void gp_add_entry(char *name, char *value);
+static FILE *gp_create_dump(struct ext_par *ep, char *fname, char *filetype);
+static void gp_add_entry(struct ext_par *ep, char *name, char *value);
 static void gp_close_dump(FILE *file);
-static void gp_do_par_file(char *fname, int level);
-static void gp_subpar(char **apl, char **apv);
-static void gp_getpar_err(char *subname, char *format, ...);
-static void gp_do_environment(int ac, char **av);
+static void gp_do_par_file(struct ext_par *ep, char *fname, int level);
+static void gp_subpar(struct ext_par *ep, char **apl, char **apv);
+static void gp_getpar_err(struct ext_par *ep, char *subname, char *format, ...);
+static void gp_do_environment(struct ext_par *ep, int ac, char **av);
 
 int
 #ifdef FORTRAN
@@ -136,6 +158,32 @@ setpar_()
 #else
 setpar(int ac, char **av)	/* set up arglist & process INPUT command */
 #endif
+   {
+#ifdef FORTRAN
+	int ac; char **av;
+	extern int xargc; extern char **xargv;
+	ac= xargc; av= xargv;
+#endif
+	return(gp_init(&ext_par,ac,av));
+   }
+
+#ifndef FORTRAN
+gp_ctx *gp_setpar(int ac, char **av)	/* reentrant setpar */
+   {
+	struct ext_par *ep;
+
+	if( (ep= (struct ext_par *)malloc(sizeof(struct ext_par))) == NULL)
+	   {
+		fprintf(stderr,"%s[gp_setpar]: cannot allocate memory\n",
+			(av == NULL || *av == NULL) ? "(unknown)" : *av);
+		exit(GETPAR_ERROR);
+	   }
+	gp_init(ep,ac,av);
+	return(ep);
+   }
+#endif
+
+int gp_init(struct ext_par *ep, int ac, char **av)
    {
 	register char *pl, *pn, *pv;
 	char  t, name[MAXNAME], value[MAXVALUE];
@@ -146,12 +194,6 @@ setpar(int ac, char **av)	/* set up arglist & process INPUT command */
 	
 	char  *apl, *apv;
 
-#ifdef FORTRAN
-	int ac; char **av;
-	extern int xargc; extern char **xargv;
-	ac= xargc; av= xargv;
-#endif
-
 	if(av != (char **) NULL)
 	{
 		PROGNAME = *av;
@@ -169,7 +211,7 @@ setpar(int ac, char **av)	/* set up arglist & process INPUT command */
 	ARGBUF = NULL;
 	NLIST= NBUF= LISTMAX= BUFMAX= 0;
 #ifdef ENVIRONMENT
-	gp_do_environment(ac,av);
+	gp_do_environment(ep,ac,av);
 #endif
 	nevlist= NLIST;
 	while(--ac > 0 && endsetpar == 0)
@@ -203,7 +245,7 @@ setpar(int ac, char **av)	/* set up arglist & process INPUT command */
 					{
 						apl = pl;
 						apv = pv;
-						gp_subpar(&apl, &apv);
+						gp_subpar(ep, &apl, &apv);
 						pl = apl;
 						pv = apv;
 					}
@@ -218,17 +260,17 @@ setpar(int ac, char **av)	/* set up arglist & process INPUT command */
 				{
 					apl = pl;
 					apv = pv;
-					gp_subpar(&apl, &apv);
+					gp_subpar(ep, &apl, &apv);
 					pl = apl;
 					pv = apv;
 				}
 				else *pv++ = *pl++;
 		}
 		*pv= '\0';
-		if(name[0] == '-') gp_add_entry("SWITCH",&name[1]);
-		else		gp_add_entry(name,value);
+		if(name[0] == '-') gp_add_entry(ep,"SWITCH",&name[1]);
+		else		gp_add_entry(ep,name,value);
 		if(strcmp("par",name)==0) /* par file */
-			gp_do_par_file(value,1);
+			gp_do_par_file(ep,value,1);
 
 	/* Added by Glenn Nelson (nelson@ollie.UCSC.EDU) to allow mixture
 	   of getpar() and ordinary command line stuff. */
@@ -239,31 +281,23 @@ setpar(int ac, char **av)	/* set up arglist & process INPUT command */
 
 #ifdef ENVIRONMENT
 	*value= '\0';
-	if(GETPAR("NOENV","b",value)) ARGHEAD= ARGLIST+ nevlist;
+	if(gp_get(ep,"NOENV","b",value,0)) ARGHEAD= ARGLIST+ nevlist;
 #endif
 	addflags= 0;
 	*value= '\0';
-	if(GETPAR("STOP","b",value)) addflags |= STOP;
+	if(gp_get(ep,"STOP","b",value,0)) addflags |= STOP;
 	*value= '\0';
-	if(GETPAR("VERBOSE","b",value)) addflags |= VERBOSE;
+	if(gp_get(ep,"VERBOSE","b",value,0)) addflags |= VERBOSE;
 	*value= '\0';
-#ifdef FORTRAN
-	if(GETPAR("LIST","s",value, 0, 0, 0))
-#else
-	if(GETPAR("LIST","s",value))
-#endif
+	if(gp_get(ep,"LIST","s",value,0))
 	   {
 		addflags |= LIST;
-		LISTFILE =gp_create_dump(value,"list");
+		LISTFILE =gp_create_dump(ep,value,"list");
 	   }
 	*value= '\0';
-#ifdef FORTRAN
-	if(GETPAR("INPUT","s",value, 0, 0, 0))
-#else
-	if(GETPAR("INPUT","s",value))
-#endif
+	if(gp_get(ep,"INPUT","s",value,0))
 	   {
-		file =gp_create_dump(value,"list input");
+		file =gp_create_dump(ep,value,"list input");
 		fprintf(file,"%s: getpar input listing\n",PROGNAME);
 		for(i=0, alptr=ARGLIST; i<NLIST; i++, alptr++)
 		   {
@@ -281,7 +315,7 @@ setpar(int ac, char **av)	/* set up arglist & process INPUT command */
    }
 
 /* add an entry to arglist, expanding memory if necessary */
-void gp_add_entry(char *name, char *value)
+void gp_add_entry(struct ext_par *ep, char *name, char *value)
    {
 	struct arglist *alptr;
 	int len;
@@ -305,7 +339,7 @@ void gp_add_entry(char *name, char *value)
 		 else	ARGBUF= (char *)realloc(ARGBUF,BUFMAX);
 	   }
 	if(ARGBUF == NULL || ARGLIST == NULL)
-		gp_getpar_err("setpar","cannot allocate memory");
+		gp_getpar_err(ep,"setpar","cannot allocate memory");
 
 	/* add name */
 	alptr= ARGLIST + NLIST;
@@ -324,7 +358,7 @@ void gp_add_entry(char *name, char *value)
 #define BETTER_WAY	/* The environment is always available (as
 			   suggested by Glenn Nelson (nelson@ollie.UCSC.EDU) */
 
-void gp_do_environment(int ac, char **av)
+void gp_do_environment(struct ext_par *ep, int ac, char **av)
    {
 	char **ae;
 	register char *pl, *pn, *pv;
@@ -371,11 +405,24 @@ void gp_do_environment(int ac, char **av)
 		   }
 		 else	while(*pl) *pv++ = *pl++;
 		*pv= '\0';
-		gp_add_entry(name,value);
+		gp_add_entry(ep,name,value);
 	   }
    }
 
 void ENDPAR(void)  /* free arglist & argbuf memory, & process STOP command */
+   {
+	gp_end(&ext_par);
+   }
+
+#ifndef FORTRAN
+void gp_endpar(gp_ctx *ep)	/* reentrant endpar, also frees ep */
+   {
+	gp_end(ep);
+	free(ep);
+   }
+#endif
+
+void gp_end(struct ext_par *ep)
    {
 	if(ARGLIST != NULL) free(ARGLIST);
 	if(ARGBUF  != NULL) free(ARGBUF);
@@ -398,13 +445,26 @@ mstpar_(char *name, char *type, int *val, int dum1, int dum2, int lens)
 mstpar(char *name, char *type, void *val)
 #endif
    {
-	int cnt;
-	char *typemess;
 #ifndef	FORTRAN
-	if( (cnt= GETPAR(name,type,val)) > 0) return(cnt);
+	return(gp_mst(&ext_par,name,type,val,0));
 #else
-	if( (cnt= GETPAR(name,type,val,dum1,dum2,lens)) > 0) return(cnt);
+	return(gp_mst(&ext_par,name,type,val,lens));
+#endif
+   }
+
+#ifndef FORTRAN
+int gp_mstpar(gp_ctx *ep, char *name, char *type, void *val)
+   {
+	return(gp_mst(ep,name,type,val,0));
+   }
 #endif
+
+int gp_mst(struct ext_par *ep, char *name, char *type, void *val, int lens)
+   {
+	int cnt;
+	char *typemess;
+
+	if( (cnt= gp_get(ep,name,type,val,lens)) > 0) return(cnt);
 	/* The following line corrects a common input error */
 	if(type[1]=='v') { type[1]= type[0]; type[0]='v'; }
 
@@ -426,7 +486,7 @@ mstpar(char *name, char *type, void *val)
 			  break;
 		default : typemess= "unknown (error)";	break;
 	   }
-	gp_getpar_err("mstpar","must specify value for '%s', expecting %s",
+	gp_getpar_err(ep,"mstpar","must specify value for '%s', expecting %s",
 		name,typemess);
 	return 0;
    }
@@ -438,6 +498,22 @@ getpar_(char *name, char *type, void* val, int dum1, int dum2, int lens)
 #else
 getpar(char *name, char *type, void *val)
 #endif
+   {
+#ifndef	FORTRAN
+	return(gp_get(&ext_par,name,type,val,0));
+#else
+	return(gp_get(&ext_par,name,type,val,lens));
+#endif
+   }
+
+#ifndef FORTRAN
+int gp_getpar(gp_ctx *ep, char *name, char *type, void *val)
+   {
+	return(gp_get(ep,name,type,val,0));
+   }
+#endif
+
+int gp_get(struct ext_par *ep, char *name, char *type, void *val, int lens)
    {
 	register char *sptr;
 	register struct arglist *alptr;
@@ -450,9 +526,9 @@ getpar(char *name, char *type, void *val)
 #endif
 	char line[MAXLINE], *str, *noname;
 	if(FLAGS & END_PAR)
-		gp_getpar_err("getpar","called after endpar");
+		gp_getpar_err(ep,"getpar","called after endpar");
 	if( (FLAGS & INIT) == 0)
-		gp_getpar_err("getpar","not initialized with setpar");
+		gp_getpar_err(ep,"getpar","not initialized with setpar");
 	if(FLAGS & VERBOSE)
 		fprintf(stderr,"getpar: looking for %s\n",name);
 
@@ -497,6 +573,11 @@ getpar(char *name, char *type, void *val)
 				found=1;
 				break;
 			case 's':
+				if(type[1] == '@')
+				   {
+					found= gp_getlist(ep,str,(char ***)val);
+					break;
+				   }
                                 sptr= (char *) val;
                                 while(*str) *sptr++ = *str++;
                                 *sptr= '\0';
@@ -513,10 +594,10 @@ getpar(char *name, char *type, void *val)
                                 found=1;
                                 break;
 			case 'v':
-				found= gp_getvector(str,type,val);
+				found= gp_getvector(ep,str,type,val);
 				break;
 			default:
-				gp_getpar_err("getpar",
+				gp_getpar_err(ep,"getpar",
 					"unknown conversion type %s",type);
 				break;
 		   }
@@ -567,7 +648,10 @@ boolean:
 				
 				break;
 #else
-                        case 's': sprintf(line,"(str) = %s", (char *) val);
+                        case 's': if(type[1] == '@')
+					sprintf(line,"(str list)");
+				  else
+					sprintf(line,"(str) = %s", (char *) val);
 			        break;
 #endif
 			case 'b': sprintf(line,"(boo) = %d",*( (int *) val));
@@ -593,7 +677,7 @@ boolean:
 	return(found);
    }
 
-FILE *gp_create_dump(char *fname, char *filetype)
+FILE *gp_create_dump(struct ext_par *ep, char *fname, char *filetype)
    {
 	FILE *temp;
 
@@ -622,7 +706,7 @@ int gp_compute_hash(char *s)
 	return(h);
    }
 
-void gp_do_par_file(char *fname, int level)
+void gp_do_par_file(struct ext_par *ep, char *fname, int level)
    {
 	register char *pl, *pn, *pv;
 	char t, line[MAXLINE], name[MAXNAME], value[MAXVALUE];
@@ -630,12 +714,12 @@ void gp_do_par_file(char *fname, int level)
 	char *apl, *apv;
  
 	if(level > MAXPARLEVEL)
-		gp_getpar_err("setpar","%d (too many) recursive par file",level);
+		gp_getpar_err(ep,"setpar","%d (too many) recursive par file",level);
 		
 	if(*fname == '\0') return;
 	
 	if( (file=fopen(fname,"r"))==NULL)
-		gp_getpar_err("setpar","cannot open par file %s",fname);
+		gp_getpar_err(ep,"setpar","cannot open par file %s",fname);
 
 	while( gp_fgets(line,MAXLINE,file) != NULL )
 	   {
@@ -680,7 +764,7 @@ void gp_do_par_file(char *fname, int level)
 					{
 						apl = pl;
 						apv = pv;
-						gp_subpar(&apl, &apv);
+						gp_subpar(ep, &apl, &apv);
 						pl = apl;
 						pv = apv;
 					}
@@ -696,7 +780,7 @@ void gp_do_par_file(char *fname, int level)
 				{
 					apl = pl;
 					apv = pv;
-					gp_subpar(&apl, &apv);
+					gp_subpar(ep, &apl, &apv);
 					pl = apl;
 					pv = apv;
 				}
@@ -704,15 +788,15 @@ void gp_do_par_file(char *fname, int level)
 		}
 		*pv= '\0';
 
-		gp_add_entry(name,value);
+		gp_add_entry(ep,name,value);
 		if(strcmp("par",name) == 0)
-			gp_do_par_file(value,level+1);
+			gp_do_par_file(ep,value,level+1);
 		goto loop;
 	   }
 	fclose(file);
    }
 
-void gp_getpar_err(char *subname, char *format, ...)
+void gp_getpar_err(struct ext_par *ep, char *subname, char *format, ...)
    {
         va_list ap;
 	va_start(ap, format);
@@ -723,23 +807,66 @@ void gp_getpar_err(char *subname, char *format, ...)
 	(void) fprintf(stderr,"\n");
 	exit(GETPAR_ERROR);
    }
-int gp_getvector(char *list, char *type, void *val)
+/*
+ * Vector parameters.  The value is a comma separated list, with n*v
+ * for n copies of v, or "@file" for the numbers of a text file, or
+ * "@@file" for the native binary values of a file.  type "vf[n]" fills
+ * at most n elements of val, type "vf@" allocates the vector, val
+ * being a (float **), and returns its length whatever it is.
+ */
+int gp_getvector(struct ext_par *ep, char *list, char *type, void *val)
+   {
+	int limit, n, esize;
+	void **vptr;
+
+	if(type[1] != 'd' && type[1] != 'f' && type[1] != 'F')
+		gp_getpar_err(ep,"getpar",
+			"bad vector type=%c specified",type[1]);
+
+	if(type[2] == '@')
+	   {
+#ifdef FORTRAN
+		gp_getpar_err(ep,"getpar",
+			"allocated vector type=%s not in FORTRAN",type);
+#endif
+		vptr= (void **) val;
+		if(list[0] == '@')
+			return(gp_filevector(ep,list+1,type[1],vptr,0,1));
+
+		esize= (type[1] == 'd') ? sizeof(int) :
+		       (type[1] == 'f') ? sizeof(float) : sizeof(double);
+		n= gp_listvector(ep,list,type[1],NULL,-1);
+		if( (*vptr= malloc((n+1)*esize)) == NULL)
+			gp_getpar_err(ep,"getpar","cannot allocate %d elements",n);
+		return(gp_listvector(ep,list,type[1],*vptr,n));
+	   }
+
+	limit= MAXVECTOR;
+	if(type[2] == '(' || type[2] == '[') limit= (int)atol(&type[3]);
+	if(limit <= 0)
+		gp_getpar_err(ep,"getpar","bad limit=%d specified",limit);
+
+	if(list[0] == '@')
+		return(gp_filevector(ep,list+1,type[1],&val,limit,0));
+	return(gp_listvector(ep,list,type[1],val,limit));
+   }
+
+/*
+ * The comma list parser of gp_getvector, at most limit elements into
+ * val.  With val NULL (and limit < 0) the elements are only counted.
+ */
+int gp_listvector(struct ext_par *ep, char *list, int vtype, void *val, int limit)
    {
 	register char *p;
 	register int index, cnt;
 	char *valptr;
-	int limit;
 	int ival, *iptr;
 	float fval, *fptr;
 	double dval, *dptr;
 
-	limit= MAXVECTOR;
-	if(type[2] == '(' || type[2] == '[') limit= (int)atol(&type[3]);
-	if(limit <= 0)
-		gp_getpar_err("getpar","bad limit=%d specified",limit);
 	index= 0;
 	p= list;
-	while(*p != '\0'  && index < limit)
+	while(*p != '\0'  && (limit < 0 || index < limit))
 	   {
 		cnt=1;
 	 backup: /* return to here if we find a repetition factor */
@@ -752,14 +879,16 @@ int gp_getvector(char *list, char *type, void *val)
 		   {
 			cnt= (int)atol(valptr);
 			if(cnt <= 0)
-				gp_getpar_err("getpar",
+				gp_getpar_err(ep,"getpar",
 					"bad repetition factor=%d specified",
 					 cnt);
-			if(index+cnt > limit) cnt= limit - index;
+			if(limit >= 0 && index+cnt > limit) cnt= limit - index;
 			p++;
 			goto backup;
 		   }
-		switch(type[1])
+		if(val == NULL)
+			index= index + cnt;
+		else switch(vtype)
 		   {
 			case 'd':
 				iptr= (int *) val;
@@ -776,19 +905,201 @@ int gp_getvector(char *list, char *type, void *val)
 				dval= atof(valptr);
 				while(cnt--) dptr[index++] = dval;
 				break;
-			default:
-				gp_getpar_err("getpar",
-					"bad vector type=%c specified",type[1]);
-				break;
 		   }
 		if(*p != '\0') p++;
 	   }
 	return(index);
    }
 
+/* the whole of fname in one malloc'ed, NUL terminated buffer */
+char *gp_readfile(struct ext_par *ep, char *fname, long *len)
+   {
+	FILE *file;
+	char *buf;
+
+	if( (file=fopen(fname,"r"))==NULL)
+		gp_getpar_err(ep,"getpar","cannot open vector file %s",fname);
+
+	if(fseek(file,0L,SEEK_END) != 0 || (*len= ftell(file)) < 0)
+		gp_getpar_err(ep,"getpar","cannot seek vector file %s",fname);
+	rewind(file);
+
+	if( (buf= (char *) malloc(*len+1)) == NULL)
+		gp_getpar_err(ep,"getpar","cannot allocate %ld bytes for %s",
+			*len,fname);
+	if(fread(buf,1,*len,file) != *len)
+		gp_getpar_err(ep,"getpar","short read on vector file %s",fname);
+	buf[*len]= '\0';
+
+	fclose(file);
+	return(buf);
+   }
+
+#define GP_SEP(c)	((c) == ' ' || (c) == '\t' || (c) == '\n' || \
+			 (c) == '\r' || (c) == ',')
+
+/*
+ * A vector from the file of "@file" (fname without the '@'): the
+ * numbers of a text file, separated by blanks, commas or new lines,
+ * '#' starting a comment to the end of the line; or, for "@@file",
+ * the native binary ints, floats or doubles of the file.  The file is
+ * read at once and the text converted with strtol/strtod.  With alloc
+ * *val is allocated to the length of the file, otherwise at most limit
+ * elements go to *val.
+ */
+int gp_filevector(struct ext_par *ep, char *fname, int vtype, void **val, int limit, int alloc)
+   {
+	char *buf, *p, *q;
+	long len;
+	int n, nalloc, esize;
+
+	esize= (vtype == 'd') ? sizeof(int) :
+	       (vtype == 'f') ? sizeof(float) : sizeof(double);
+
+	if(fname[0] == '@')
+	   {
+		buf= gp_readfile(ep,fname+1,&len);
+		if(len % esize != 0)
+			gp_getpar_err(ep,"getpar",
+				"%s is not a whole number of %d byte values",
+				fname+1,esize);
+		n= len/esize;
+		if(alloc)
+		   {
+			*val= buf;
+			return(n);
+		   }
+		if(n > limit) n= limit;
+		memcpy(*val,buf,n*esize);
+		free(buf);
+		return(n);
+	   }
+
+	buf= gp_readfile(ep,fname,&len);
+	nalloc= limit;
+	if(alloc)
+	   {
+		nalloc= 1024;
+		if( (*val= malloc(nalloc*esize)) == NULL)
+			gp_getpar_err(ep,"getpar","cannot allocate %d elements",nalloc);
+	   }
+
+	n= 0;
+	p= buf;
+	while(alloc || n < limit)
+	   {
+		while(GP_SEP(*p)) p++;
+		if(*p == '#')
+		   {
+			while(*p != '\0' && *p != '\n') p++;
+			continue;
+		   }
+		if(*p == '\0') break;
+
+		if(n == nalloc)
+		   {
+			nalloc= 2*nalloc;
+			if( (*val= realloc(*val,nalloc*esize)) == NULL)
+				gp_getpar_err(ep,"getpar",
+					"cannot allocate %d elements",nalloc);
+		   }
+
+		switch(vtype)
+		   {
+			case 'd': ((int *)(*val))[n]= (int)strtol(p,&q,10);
+				break;
+			case 'f': ((float *)(*val))[n]= (float)strtod(p,&q);
+				break;
+			default:  ((double *)(*val))[n]= strtod(p,&q);
+				break;
+		   }
+		if(q == p)
+			gp_getpar_err(ep,"getpar","bad value in vector file %s",fname);
+
+		/* the rest of the item, as atol/atof ignore it */
+		p= q;
+		while(*p != '\0' && *p != '#' && !GP_SEP(*p)) p++;
+		n++;
+	   }
+
+	free(buf);
+	return(n);
+   }
+
+/*
+ * "s@" string lists: the value split at commas, or for "@file" the
+ * words of the file (blanks and new lines apart, '#' comments).  *val
+ * becomes a NULL terminated (char **) whose strings are in the same
+ * malloc'ed block, so free(*val) releases the list.
+ */
+int gp_getlist(struct ext_par *ep, char *list, char ***val)
+   {
+	char *buf, *p, *q, **lp;
+	long len;
+	int n, word, file;
+
+#ifdef FORTRAN
+	gp_getpar_err(ep,"getpar","string list type=s@ not in FORTRAN");
+#endif
+	file= (list[0] == '@');
+	if(file)
+		buf= gp_readfile(ep,list+1,&len);
+	else
+	   {
+		len= strlen(list);
+		if( (buf= (char *) malloc(len+1)) == NULL)
+			gp_getpar_err(ep,"getpar","cannot allocate %ld bytes",len);
+		memcpy(buf,list,len+1);
+	   }
+
+	/* NUL-terminate the words in place, counting them */
+	n= 0;
+	word= 0;
+	for(p=buf; p < buf+len; p++)
+	   {
+		if(file && *p == '#' && !word)
+			while(p < buf+len && *p != '\n') *p++ = '\0';
+
+		if(file ? (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+			: (*p == ','))
+			*p= '\0';
+
+		if(*p == '\0')
+			word= 0;
+		else if(!word)
+		   {
+			word= 1;
+			n++;
+		   }
+	   }
+
+	if( (lp= (char **) malloc((n+1)*sizeof(char *) + len+1)) == NULL)
+		gp_getpar_err(ep,"getpar","cannot allocate %d strings",n);
+	q= (char *)(lp + n+1);
+	memcpy(q,buf,len+1);
+	free(buf);
+
+	n= 0;
+	word= 0;
+	for(p=q; p < q+len; p++)
+	   {
+		if(*p == '\0')
+			word= 0;
+		else if(!word)
+		   {
+			word= 1;
+			lp[n++]= p;
+		   }
+	   }
+	lp[n]= NULL;
+
+	*val= lp;
+	return(n);
+   }
+
 /*  This allows parameter substitution */
 
-void gp_subpar(char **apl, char **apv)
+void gp_subpar(struct ext_par *ep, char **apl, char **apv)
 {
 	register char *pl, *pv;
 	char     subname[MAXNAME];
@@ -815,7 +1126,7 @@ void gp_subpar(char **apl, char **apv)
 			{
 				bpl = pl;
 				bpv = pv;
-				gp_subpar(&bpl, &bpv);
+				gp_subpar(ep, &bpl, &bpv);
 				pl = bpl;
 				pv = bpv;
 			}
@@ -828,11 +1139,7 @@ void gp_subpar(char **apl, char **apv)
 			pv = *apv;
 			valid = 1;
 			ARGHEAD= ARGLIST;
-#ifndef	FORTRAN
-			if(GETPAR(subname, "s", pv))
-#else
-			if(GETPAR(subname, "s", pv, 0, 0, 0))
-#endif
+			if(gp_get(ep, subname, "s", pv, 0))
 			{
 				pv += strlen(pv);
 			}
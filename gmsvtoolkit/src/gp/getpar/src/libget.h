@@ -32,6 +32,14 @@ extern float	getfpar(char *name, float defvalue);
 extern double	getffpar(char *name, double defvalue);
 extern int      getlocation(char *keyname, char *location, int fatal);
 
+/* reentrant getpar, one parameter list per gp_setpar() (see getpar.3) */
+typedef struct ext_par gp_ctx;
+
+extern gp_ctx  *gp_setpar(int argc, char **argv);
+extern int	gp_getpar(gp_ctx *c, char *name, char *type, void *ptr_to_some_type);
+extern int	gp_mstpar(gp_ctx *c, char *name, char *type, void *ptr_to_some_type);
+extern void	gp_endpar(gp_ctx *c);
+
 #ifdef __cplusplus
 }
 #endif
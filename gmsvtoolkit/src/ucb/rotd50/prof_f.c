@@ -0,0 +1,67 @@
+/*
+ * prof_f.c - Fortran entry points of the stage timers of
+ * gp/WccFormat/prof.c (GMSV_PROFILE=file.json), as
+ *
+ *    double precision t0
+ *    call prof_start ( t0 )
+ *    ...
+ *    call prof_stop ( 'rotd_rotsa', t0, npts )
+ *
+ * and prof_io ( name, nread, nwritten ) with integer*8 byte counts,
+ * prof_fft ( name, t0, n ).
+ * The names are trimmed Fortran strings, the lengths are the hidden
+ * arguments gfortran passes at the end.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#define PROF_NAMELEN 48
+
+double prof_start(void);
+void prof_stop(char *, double, long long);
+void prof_io(char *, long long, long long);
+void prof_fft(char *, double, int);
+
+static void prof_name(char *buf,const char *name,size_t len)
+{
+while(len > 0 && name[len-1] == ' ')
+   len--;
+if(len > PROF_NAMELEN-1)
+   len = PROF_NAMELEN-1;
+memcpy(buf,name,len);
+buf[len] = '\0';
+}
+
+void prof_start_(double *t0)
+{
+*t0 = prof_start();
+}
+
+void prof_stop_(char *name,double *t0,int *nsamp,size_t len)
+{
+char buf[PROF_NAMELEN];
+
+if(*t0 < 0.0)
+   return;
+prof_name(buf,name,len);
+prof_stop(buf,*t0,*nsamp);
+}
+
+void prof_io_(char *name,long long *nread,long long *nwritten,size_t len)
+{
+char buf[PROF_NAMELEN];
+
+prof_name(buf,name,len);
+prof_io(buf,*nread,*nwritten);
+}
+
+void prof_fft_(char *name,double *t0,int *n,size_t len)
+{
+char buf[PROF_NAMELEN];
+
+if(*t0 < 0.0)
+   return;
+prof_name(buf,name,len);
+prof_fft(buf,*t0,*n);
+}
@@ -0,0 +1,333 @@
+#!/usr/bin/env python
+"""
+BSD 3-Clause License
+
+Copyright (c) 2022, University of Southern California
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+End-to-end throughput benchmark of the rotd50 and rotd100 programs.
+
+The corpus is made here, from a fixed generator (CORPUS_VERSION) so
+that every run, on every machine, sees the same record pairs: a short
+record, a long one and a high sample rate one.  Each program is run on
+each case with each interpolation method (jInterp 1, 2 and 3) and the
+records/sec, the cost per oscillator period and the peak RSS of the
+process are reported as JSON.  The spectra are compared with the
+golden outputs in rotd_bench_golden.txt (made by --update-golden with
+a trusted build); any difference larger than --rtol fails the run, so
+a faster kernel cannot quietly change the results.
+
+    python rotd_bench.py [--bindir .] [--repeat 2] [--output bench.json]
+"""
+from __future__ import division, print_function
+
+# Import Python modules
+import os
+import sys
+import json
+import math
+import time
+import shutil
+import argparse
+import tempfile
+import subprocess
+
+CORPUS_VERSION = 1
+GOLDEN_FILE = "rotd_bench_golden.txt"
+NHEAD = 4
+NFREQ = 63
+
+# name, npts, dt, seed: short, long and high sample rate records
+CASES = [("short", 2000, 0.01, 11),
+         ("long", 24000, 0.01, 23),
+         ("highrate", 40000, 0.001, 37)]
+PROGRAMS = ["rotd50", "rotd100"]
+INTERP = [1, 2, 3]
+
+def make_component(npts, dt, seed, comp):
+    """
+    One horizontal component: a sum of decaying sines of fixed,
+    seeded frequencies and phases under a rise-and-decay envelope
+    """
+    state = [seed * 7919 + comp * 104729]
+
+    def rand():
+        # 31 bit LCG, the same numbers in every Python
+        state[0] = (1103515245 * state[0] + 12345) % 2147483648
+        return state[0] / 2147483648.0
+
+    duration = npts * dt
+    tau = 0.15 * duration
+    terms = []
+    for _ in range(24):
+        # 0.1 Hz up to 40% of the Nyquist frequency, log spaced
+        fmax = 0.4 / dt
+        freq = 0.1 * math.exp(rand() * math.log(fmax / 0.1))
+        terms.append((2.0 * math.pi * freq, 2.0 * math.pi * rand(),
+                      (0.5 + rand()) / math.sqrt(freq)))
+
+    values = []
+    for i in range(npts):
+        t = i * dt
+        env = (t / tau) ** 2 * math.exp(2.0 - 2.0 * t / tau)
+        acc = 0.0
+        for w, phase, amp in terms:
+            acc += amp * math.sin(w * t + phase)
+        values.append(0.05 * env * acc)
+    return values
+
+def write_peer(filename, name, comp, npts, dt, values):
+    """
+    Writes a record in the PEER-like format the rotd programs read,
+    NHEAD lines of header, the last one with npts and dt
+    """
+    out = open(filename, 'w')
+    out.write("rotd_bench corpus v%d %s comp %d\n" % (CORPUS_VERSION,
+                                                     name, comp))
+    out.write("ACCELERATION TIME SERIES IN UNITS OF G\n")
+    out.write("synthetic\n")
+    out.write("%d %10.6f NPTS, DT\n" % (npts, dt))
+    for value in values:
+        out.write("%15.7e\n" % (value))
+    out.close()
+
+def make_corpus(corpus_dir):
+    """
+    Makes the record pairs of CASES in corpus_dir, kept there between
+    runs for the same CORPUS_VERSION
+    """
+    stamp = os.path.join(corpus_dir, "version")
+    if os.path.exists(stamp) and open(stamp).read().strip() == str(CORPUS_VERSION):
+        return
+    if not os.path.exists(corpus_dir):
+        os.makedirs(corpus_dir)
+    for name, npts, dt, seed in CASES:
+        for comp in [1, 2]:
+            values = make_component(npts, dt, seed, comp)
+            write_peer(os.path.join(corpus_dir, "%s.%d" % (name, comp)),
+                       name, comp, npts, dt, values)
+    open(stamp, 'w').write("%d\n" % (CORPUS_VERSION))
+
+def write_config(work_dir, jinterp, case, npairs, nthreads, program):
+    """
+    Writes the rotdXX_inp.cfg of npairs copies of case
+    """
+    cfg = open(os.path.join(work_dir, "%s_inp.cfg" % (program)), 'w')
+    cfg.write("%d interp flag\n" % (jinterp))
+    cfg.write("%d Npairs\n" % (npairs))
+    cfg.write("%d Nhead\n" % (NHEAD))
+    if nthreads > 1:
+        cfg.write("nthreads %d\n" % (nthreads))
+    outputs = []
+    for i in range(npairs):
+        outputs.append("out_%d" % (i))
+        cfg.write("%s\n%s\n%s\n" % (case + ".1", case + ".2", outputs[-1]))
+    cfg.close()
+    for output in outputs:
+        if os.path.exists(os.path.join(work_dir, output)):
+            os.unlink(os.path.join(work_dir, output))
+    return outputs
+
+def run_timed(cmd, work_dir):
+    """
+    Runs cmd in work_dir, returns the wall time and peak RSS (kB)
+    """
+    devnull = open(os.devnull, 'w')
+    start = time.time()
+    proc = subprocess.Popen(cmd, cwd=work_dir, stdout=devnull,
+                            stderr=devnull)
+    _, status, rusage = os.wait4(proc.pid, 0)
+    wall = time.time() - start
+    devnull.close()
+    if status != 0:
+        raise RuntimeError("%s failed in %s" % (cmd[0], work_dir))
+    # ru_maxrss is in kB on Linux, bytes on macOS
+    rss = rusage.ru_maxrss
+    if sys.platform == "darwin":
+        rss = rss // 1024
+    return wall, rss
+
+def read_spectrum(filename):
+    """
+    The rows of a rotd50/rotd100 output, period and values
+    """
+    rows = []
+    for line in open(filename):
+        if line.startswith("#"):
+            continue
+        pieces = line.split()
+        if pieces:
+            rows.append([float(piece) for piece in pieces])
+    return rows
+
+def read_golden(filename):
+    """
+    Golden spectra keyed on (program, case, jinterp)
+    """
+    golden = {}
+    if not os.path.exists(filename):
+        return golden
+    for line in open(filename):
+        if line.startswith("#") or not line.strip():
+            continue
+        pieces = line.split()
+        key = (pieces[0], pieces[1], int(pieces[2]))
+        golden.setdefault(key, []).append([float(piece)
+                                           for piece in pieces[3:]])
+    return golden
+
+def write_golden(filename, spectra):
+    """
+    Writes the spectra of this run as the golden outputs
+    """
+    out = open(filename, 'w')
+    out.write("# rotd_bench golden spectra, corpus version %d\n" %
+              (CORPUS_VERSION))
+    out.write("# program case jInterp period Psa5_N Psa5_E RotD50 [RotD100]\n")
+    for key in sorted(spectra):
+        for row in spectra[key]:
+            out.write("%s %s %d %s\n" % (key[0], key[1], key[2],
+                                         " ".join(["%.5e" % (value)
+                                                   for value in row])))
+    out.close()
+
+def compare(rows, golden_rows, rtol):
+    """
+    Largest relative difference of rows from golden_rows, None if
+    their shapes differ
+    """
+    if len(rows) != len(golden_rows):
+        return None
+    worst = 0.0
+    for row, grow in zip(rows, golden_rows):
+        if len(row) != len(grow):
+            return None
+        for value, gvalue in zip(row, grow):
+            scale = max(abs(gvalue), 1.0e-30)
+            worst = max(worst, abs(value - gvalue) / scale)
+    return worst
+
+def main():
+    """
+    Runs the benchmark
+    """
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(description="Throughput benchmark of "
+                                     "rotd50 and rotd100")
+    parser.add_argument("--bindir", default=here,
+                        help="directory of the rotd50 and rotd100 binaries")
+    parser.add_argument("--corpus", default=None,
+                        help="corpus directory (default: a temporary one)")
+    parser.add_argument("--repeat", type=int, default=1,
+                        help="pairs per run, copies of the case")
+    parser.add_argument("--nthreads", type=int, default=1,
+                        help="nthreads option of the rotd programs")
+    parser.add_argument("--rtol", type=float, default=2.0e-4,
+                        help="relative tolerance of the golden check")
+    parser.add_argument("--golden", default=os.path.join(here, GOLDEN_FILE),
+                        help="golden spectra file")
+    parser.add_argument("--update-golden", action="store_true",
+                        help="write the spectra of this run as the golden ones")
+    parser.add_argument("--output", default=None,
+                        help="JSON results file (default: stdout)")
+    args = parser.parse_args()
+
+    tmp_dir = tempfile.mkdtemp(prefix="rotd_bench_")
+    corpus_dir = args.corpus or os.path.join(tmp_dir, "corpus")
+    make_corpus(corpus_dir)
+
+    golden = read_golden(args.golden)
+    spectra = {}
+    results = []
+    failed = 0
+    npairs = max(args.repeat, 1)
+
+    try:
+        for program in PROGRAMS:
+            binary = os.path.abspath(os.path.join(args.bindir, program))
+            for name, npts, dt, _ in CASES:
+                for jinterp in INTERP:
+                    work_dir = os.path.join(tmp_dir, "%s_%s_%d" %
+                                            (program, name, jinterp))
+                    if not os.path.exists(work_dir):
+                        os.makedirs(work_dir)
+                    for comp in [1, 2]:
+                        src = os.path.join(corpus_dir, "%s.%d" % (name, comp))
+                        dst = os.path.join(work_dir, "%s.%d" % (name, comp))
+                        if not os.path.exists(dst):
+                            shutil.copy(src, dst)
+                    outputs = write_config(work_dir, jinterp, name,
+                                           npairs, args.nthreads, program)
+                    wall, rss = run_timed([binary], work_dir)
+
+                    rows = read_spectrum(os.path.join(work_dir, outputs[0]))
+                    key = (program, name, jinterp)
+                    spectra[key] = rows
+                    result = {"program": program, "case": name,
+                              "npts": npts, "dt": dt, "jinterp": jinterp,
+                              "pairs": npairs, "wall_s": round(wall, 4),
+                              "records_per_s": round(npairs / wall, 4),
+                              "us_per_period": round(1.0e+06 * wall /
+                                                     (npairs * NFREQ), 2),
+                              "peak_rss_kb": rss}
+                    if not args.update_golden:
+                        if key not in golden:
+                            result["golden"] = "missing"
+                            failed += 1
+                        else:
+                            worst = compare(rows, golden[key], args.rtol)
+                            if worst is None or worst > args.rtol:
+                                result["golden"] = "FAIL"
+                                failed += 1
+                            else:
+                                result["golden"] = "ok"
+                            result["max_rel_diff"] = worst
+                    results.append(result)
+                    print("%-8s %-9s jInterp=%d %8.3f s %8.3f rec/s %8d kB %s" %
+                          (program, name, jinterp, wall, npairs / wall, rss,
+                           result.get("golden", "")), file=sys.stderr)
+    finally:
+        shutil.rmtree(tmp_dir, ignore_errors=True)
+
+    if args.update_golden:
+        write_golden(args.golden, spectra)
+
+    report = {"corpus_version": CORPUS_VERSION, "results": results,
+              "golden_failures": failed}
+    if args.output:
+        out = open(args.output, 'w')
+        json.dump(report, out, indent=2)
+        out.write("\n")
+        out.close()
+    else:
+        print(json.dumps(report, indent=2))
+
+    return 1 if failed else 0
+
+if __name__ == '__main__':
+    sys.exit(main())
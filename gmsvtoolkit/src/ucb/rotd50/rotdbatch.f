@@ -0,0 +1,124 @@
+!     ------------------------------------------------------------------
+!
+!      rotdbatch.f
+!      RotD of a batch of pairs with the same number of points and time
+!      step, e.g. all the stations of one simulation, for librotd.  The
+!      oscillators and the 90 angle peak search of all the pairs and
+!      periods run in one OpenMP target region: on a GPU when librotd
+!      is built with make OFFLOAD=nvptx-none (or amdgcn-amdhsa), else
+!      on the host threads.
+!     ------------------------------------------------------------------
+
+! ---------------------------------------------------------------------
+!     acc1(npts0,nPair), acc2(npts0,nPair) hold the pairs at time step
+!     dt0.  On return saAll(1..180,k,ip) holds the rotated peaks of
+!     pair ip for frequency w(k), the same as RotDAcc with accuracy 0.
+!     Every point is rotated (there is no candidate pruning, which
+!     does not suit a GPU), so on the host this is slower than RotDAcc.
+
+      subroutine RotDBatch ( acc1in, acc2in, npts0, nPair, dt0, jInterp,
+     1                       nFreq, w, damping, dt_max, nThreads, saAll )
+
+      integer npts0, nPair, jInterp, nFreq, nThreads
+      real acc1in(npts0,1), acc2in(npts0,1), dt0, w(1), damping, dt_max
+      real saAll(180,nFreq,1)
+      integer NN, nAlloc, npts, nptsI, ip, i, j, k
+      real dt, dtI, rotangle
+      real, allocatable :: acc1(:,:), acc2(:,:), cs(:), sn(:)
+      real*8, allocatable :: cf(:,:)
+
+!     Interpolate the pairs on the host
+      call InterpSize ( npts0, dt0, jInterp, dt_max, NN, nAlloc )
+      allocate ( acc1(nAlloc,nPair), acc2(nAlloc,nPair) )
+
+!$omp parallel do if (nThreads .gt. 1) num_threads(nThreads)
+!$omp&  private(i, npts, dt) schedule(dynamic,1)
+      do ip=1,nPair
+        npts = npts0
+        dt = dt0
+        do i=1,npts
+          acc1(i,ip) = acc1in(i,ip)
+          acc2(i,ip) = acc2in(i,ip)
+        enddo
+        call InterpPair ( acc1(1,ip), acc2(1,ip), npts, dt, jInterp,
+     1                    NN, nAlloc )
+        if ( ip .eq. 1 ) then
+          nptsI = npts
+          dtI = dt
+        endif
+      enddo
+!$omp end parallel do
+
+!     Oscillator coefficients and rotation angles, as in RotSa
+      allocate ( cf(nFreq,9), cs(90), sn(90) )
+      call CoeffMulti ( w, nFreq, damping, dtI, cf, nFreq )
+      do j=1,90
+        rotangle = real(((j-1)*3.14159)/180.0)
+        cs(j) = cos(rotangle)
+        sn(j) = sin(rotangle)
+      enddo
+
+!$omp target teams distribute parallel do collapse(2)
+!$omp&  map(to: acc1, acc2, cf, cs, sn)
+!$omp&  map(from: saAll(1:180,1:nFreq,1:nPair))
+      do ip=1,nPair
+        do k=1,nFreq
+          call RotPeakOne ( acc1(1,ip), acc2(1,ip), nptsI, cf, nFreq,
+     1                      k, cs, sn, saAll(1,k,ip) )
+        enddo
+      enddo
+!$omp end target teams distribute parallel do
+
+      return
+      end
+
+! ---------------------------------------------------------------------
+!     Rotated peaks sa(1..180) of frequency k of one pair: the recursion
+!     of CandRspMulti for both components and, at every point, the
+!     rotation of RotSa to the 90 angles cs/sn.
+
+      subroutine RotPeakOne ( acc1, acc2, npts, cf, ldc, k, cs, sn, sa )
+!$omp declare target
+
+      integer npts, ldc, k, i, j
+      real acc1(1), acc2(1), cs(90), sn(90), sa(180)
+      real*8 cf(ldc,9)
+      real*8 d1, v1, d2, v2, a1, a2, ap1, ap2, dp1, vp1, dp2, vp2
+      real r1, r2, x1, y1
+
+      do j=1,180
+        sa(j) = -1E30
+      enddo
+      d1 = 0.
+      v1 = 0.
+      d2 = 0.
+      v2 = 0.
+      a1 = 0.
+      a2 = 0.
+
+      do i=1,npts
+        ap1 = dble( acc1(i) )
+        ap2 = dble( acc2(i) )
+        dp1 = cf(k,1)*d1 + cf(k,2)*v1 + cf(k,5)*a1 + cf(k,6)*ap1
+        vp1 = cf(k,3)*d1 + cf(k,4)*v1 + cf(k,7)*a1 + cf(k,8)*ap1
+        dp2 = cf(k,1)*d2 + cf(k,2)*v2 + cf(k,5)*a2 + cf(k,6)*ap2
+        vp2 = cf(k,3)*d2 + cf(k,4)*v2 + cf(k,7)*a2 + cf(k,8)*ap2
+        d1 = dp1
+        v1 = vp1
+        d2 = dp2
+        v2 = vp2
+        a1 = ap1
+        a2 = ap2
+        r1 = sngl( dp1 ) * cf(k,9)
+        r2 = sngl( dp2 ) * cf(k,9)
+
+        do j=1,90
+          x1 = abs(cs(j)*r1 - sn(j)*r2)
+          y1 = abs(sn(j)*r1 + cs(j)*r2)
+          if ( x1 .gt. sa(j) ) sa(j) = x1
+          if ( y1 .gt. sa(j+90) ) sa(j+90) = y1
+        enddo
+      enddo
+
+      return
+      end
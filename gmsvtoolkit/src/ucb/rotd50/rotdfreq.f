@@ -0,0 +1,291 @@
+!     ------------------------------------------------------------------
+!
+!      rotdfreq.f
+!      Frequency domain engine of the rotd drivers ("engine freq", see
+!      ReadRotdOpts): the oscillator responses are computed from one
+!      FFT of the record, without interpolating it to a finer step
+!     ------------------------------------------------------------------
+
+c ----------------------------------------------------------------------
+c     Same results as RotDAcc with the sine wave interpolation (jInterp
+c     2) in the limit of a fine dt_max (saAll(1..180,k), the peaks of
+c     the 180 rotated components for frequency w(k)) for the npts
+c     points of acc1/acc2 at step dt, which are not changed.
+c
+c     The time domain engine integrates, from rest at t = 0, the band
+c     limited series of InterpFreqW: the record padded with zeros to
+c     the power of 2 nFFT, periodic over nFFT*dt, with the Nyquist term
+c     split between the positive and negative frequencies.  Here the
+c     pair is packed as acc1 + i*acc2 and transformed once.  Since the
+c     oscillator is real, multiplying that spectrum by the SDOF transfer
+c     function (pseudo acceleration, w**2 times the relative
+c     displacement)
+c
+c        H(om) = w**2 / (w**2 - om**2 + 2i*damping*w*om)
+c
+c     and transforming back gives the periodic responses of both
+c     components, as the real and imaginary parts.  The same is done
+c     for i*om*H and -om**2*H, the first two time derivatives.  Less the
+c     free vibration that starts from the values and derivatives of the
+c     periodic response at t = 0, these are the responses from rest
+c     (RotDFreqOne), and the trajectory between samples is their
+c     quintic Hermite interpolant.  All frequencies share the forward
+c     transform and run in parallel on nThreads threads.  accur is the
+c     accuracy of the peaks of the oscillator responses to this input
+c     (RFREQ_ACC when 0).
+      subroutine RotDFreq ( acc1, acc2, npts, dt, w, nFreq, damping,
+     1                      accur, iRotMode, nThreads, saAll )
+
+      real acc1(*), acc2(*), dt, w(*), damping, accur, saAll(180,*)
+      integer npts, nFreq, iRotMode, nThreads
+      real RFREQ_ACC
+      parameter ( RFREQ_ACC=1.E-4 )
+      integer nFFT, m2, i, k, nThr
+      real acc
+      complex, allocatable :: z(:)
+
+!     The power of 2 of InterpFreqW
+      m2 = int( alog(float(npts))/alog(2.) + 0.9999 )
+      nFFT = 2**m2
+
+      allocate ( z(nFFT) )
+      do i=1,npts
+        z(i) = cmplx( acc1(i), acc2(i) )
+      enddo
+      do i=npts+1,nFFT
+        z(i) = cmplx( 0., 0. )
+      enddo
+      call CFFTW ( z, nFFT, m2, -1 )
+
+      acc = accur
+      if ( acc .le. 0. ) acc = RFREQ_ACC
+
+      nThr = max( 1, min( nThreads, nFreq ) )
+!$omp parallel do if (nThr .gt. 1) num_threads(nThr)
+!$omp&  schedule(dynamic,1)
+      do k=1,nFreq
+        call RotDFreqOne ( z, acc1, acc2, nFFT, m2, npts, dt,
+     1                     w(k), damping, acc, iRotMode, saAll(1,k) )
+      enddo
+!$omp end parallel do
+
+      return
+      end
+
+c ----------------------------------------------------------------------
+c     Rotated peaks sa(1..180) for frequency w, from the spectrum z(nFFT)
+c     of RotDFreq, over the period 0 <= t < nFFT*dt of the time domain
+c     engine.  The responses are transformed back on the step h =
+c     dt/mOver, mOver the power of 2 that makes w*h at most RFREQ_WH
+c     and the worst Hermite error on the spectrum at most acc/4 of the
+c     response (RFreqHerm), by padding the spectrum.  The sampled
+c     points that can be the peak (amplitude on one component at least
+c     SaMin/1.5, as in RotDSaRange, less the most a sine wave can rise
+c     between samples) are kept, and each interval next to one of them
+c     is filled with nSub-1 points of the Hermite interpolant, nSub
+c     making the sub-step sample a sine wave peak within acc/2.  The
+c     points then go through CandWindow and RotSa.  Without
+c     oversampling the second derivatives come from the oscillator
+c     equation, y'' = w**2*(a - y) - 2*damping*w*y', saving a transform.
+      subroutine RotDFreqOne ( z, acc1, acc2, nFFT, m2, npts, dt,
+     1                         w, damping, acc, iRotMode, sa )
+
+      complex z(*)
+      real acc1(*), acc2(*)
+      integer nFFT, m2, npts, iRotMode
+      real dt, w, damping, acc, sa(180)
+      real RFREQ_WH
+      parameter ( RFREQ_WH=1. )
+      integer mOver, lOver, nBig, nOut, nSub, nPool, nMax
+      integer i, j, l, iDer, nDer, jb
+      real h, s, sa1, sa2, test, scale, wh, a1, a2
+      real*8 pi, om, w2, wd, fac, herr, ysum, RFreqHerm
+      complex*16 hs, hd, lam, eh, e, c1, c2
+      complex, allocatable :: y(:)
+      real, allocatable :: r(:,:), hb(:,:)
+      real, allocatable :: pool1(:), pool2(:), x(:), yw(:)
+      integer, allocatable :: iSort(:), iHull(:)
+      logical, allocatable :: keep(:), fill(:)
+
+      pi = 4.d0*atan(1.d0)
+      w2 = dble(w)**2
+
+!     The step: w*h at most RFREQ_WH, and the Hermite interpolant of
+!     every frequency of the response within acc/4 of its sum
+      mOver = 1
+      lOver = 0
+      do while ( w*dt/mOver .gt. RFREQ_WH )
+        mOver = 2*mOver
+        lOver = lOver + 1
+      enddo
+      do while ( lOver .lt. 8 )
+        herr = 0.d0
+        ysum = 0.d0
+        do j=1,nFFT/2
+          om = 2.d0*pi*j / (nFFT*dble(dt))
+          hs = w2 / dcmplx( w2 - om**2, 2.d0*damping*dble(w)*om )
+          fac = abs(hs) * ( abs(z(j+1)) + abs(z(nFFT-j+1)) )
+          ysum = ysum + fac
+          herr = herr + fac * RFreqHerm( om*dt/mOver )
+        enddo
+        if ( herr .le. 0.25d0*acc*ysum ) exit
+        mOver = 2*mOver
+        lOver = lOver + 1
+      enddo
+      h = dt/mOver
+      nBig = mOver*nFFT
+      nOut = nBig
+
+!     r(:,1..2) the responses, r(:,3..4) their derivatives times h and
+!     r(:,5..6) the second derivatives times h**2, at t = 0 .. (nOut-1)*h
+      allocate ( y(nBig), r(nOut,6) )
+      nDer = 2
+      if ( mOver .eq. 1 ) nDer = 1
+      do iDer=0,nDer
+        do i=1,nBig
+          y(i) = cmplx( 0., 0. )
+        enddo
+
+!       The positive frequencies, then the negative ones at the top of
+!       the padded spectrum; half the Nyquist term goes to each (the
+!       same place without oversampling)
+        do j=0,nFFT/2
+          om = 2.d0*pi*j / (nFFT*dble(dt))
+          hs = w2 / dcmplx( w2 - om**2, 2.d0*damping*dble(w)*om )
+          hd = hs * dcmplx( 0.d0, om*h )**iDer
+          if ( j .lt. nFFT/2 ) then
+            y(j+1) = cmplx( hd*z(j+1) )
+            if ( j .gt. 0 ) y(nBig-j+1) = cmplx( dconjg(hd)*z(nFFT-j+1) )
+          else
+            jb = nBig-j+1
+            y(j+1) = y(j+1) + cmplx( 0.5d0*hd*z(j+1) )
+            y(jb) = y(jb) + cmplx( 0.5d0*dconjg(hd)*z(j+1) )
+          endif
+        enddo
+
+        call CFFTW ( y, nBig, m2+lOver, 1 )
+
+        scale = 1./nFFT
+        do i=1,nOut
+          r(i,2*iDer+1) = real( y(i) )*scale
+          r(i,2*iDer+2) = aimag( y(i) )*scale
+        enddo
+      enddo
+      deallocate ( y )
+
+      wh = w*h
+      if ( mOver .eq. 1 ) then
+        do i=1,nOut
+          a1 = 0.
+          a2 = 0.
+          if ( i .le. npts ) then
+            a1 = acc1(i)
+            a2 = acc2(i)
+          endif
+          r(i,5) = wh**2*(a1 - r(i,1)) - 2.*damping*wh*r(i,3)
+          r(i,6) = wh**2*(a2 - r(i,2)) - 2.*damping*wh*r(i,4)
+        enddo
+      endif
+
+!     From rest: less the free vibration Re(c*exp(lam*t)) with the
+!     value and derivative of the periodic response at t = 0, lam*h
+!     the step in units of h, until it has decayed
+      wd = dble(wh)*sqrt( 1.d0 - dble(damping)**2 )
+      lam = dcmplx( -dble(damping*wh), wd )
+      eh = exp( lam )
+      c1 = dcmplx( dble(r(1,1)), -(dble(r(1,3)) + dble(damping*wh)*r(1,1))/wd )
+      c2 = dcmplx( dble(r(1,2)), -(dble(r(1,4)) + dble(damping*wh)*r(1,2))/wd )
+      e = dcmplx( 1.d0, 0.d0 )
+      do i=1,nOut
+        r(i,1) = r(i,1) - real( c1*e )
+        r(i,2) = r(i,2) - real( c2*e )
+        r(i,3) = r(i,3) - real( c1*lam*e )
+        r(i,4) = r(i,4) - real( c2*lam*e )
+        r(i,5) = r(i,5) - real( c1*lam**2*e )
+        r(i,6) = r(i,6) - real( c2*lam**2*e )
+        e = e*eh
+        if ( abs(e) .lt. 1.d-12 ) exit
+      enddo
+
+!     Points that can be the peak, and the intervals next to them
+      sa1 = 0.
+      sa2 = 0.
+      do i=1,nOut
+        sa1 = amax1( sa1, abs(r(i,1)) )
+        sa2 = amax1( sa2, abs(r(i,2)) )
+      enddo
+      test = amin1( sa1, sa2 ) / 1.5 * cos( 0.5*w*h )
+
+      nSub = max( 1, int( w*h / (2.*acos(1.-0.5*acc)) ) + 1 )
+      allocate ( keep(nOut), fill(nOut) )
+      nPool = 0
+      do i=1,nOut
+        keep(i) = abs(r(i,1)) .ge. test .or. abs(r(i,2)) .ge. test
+        fill(i) = .false.
+        if ( keep(i) ) nPool = nPool + 1
+      enddo
+      do i=1,nOut-1
+        fill(i) = keep(i) .or. keep(i+1)
+        if ( fill(i) ) nPool = nPool + nSub - 1
+      enddo
+
+!     Quintic Hermite basis at s = l/nSub: the values, derivatives and
+!     second derivatives at the start, then at the end of the interval
+      allocate ( hb(max(1,nSub-1),6) )
+      do l=1,nSub-1
+        s = real(l)/nSub
+        hb(l,1) = 1. - s**3*(10. - 15.*s + 6.*s**2)
+        hb(l,2) = s - s**3*(6. - 8.*s + 3.*s**2)
+        hb(l,3) = 0.5*s**2*(1. - 3.*s + 3.*s**2 - s**3)
+        hb(l,4) = s**3*(10. - 15.*s + 6.*s**2)
+        hb(l,5) = -s**3*(4. - 7.*s + 3.*s**2)
+        hb(l,6) = 0.5*s**3*(1. - 2.*s + s**2)
+      enddo
+
+!     The pool, in time order
+      nMax = max( 1, nPool )
+      allocate ( pool1(nMax), pool2(nMax) )
+      nPool = 0
+      do i=1,nOut
+        if ( keep(i) ) then
+          nPool = nPool + 1
+          pool1(nPool) = r(i,1)
+          pool2(nPool) = r(i,2)
+        endif
+        if ( fill(i) ) then
+          do l=1,nSub-1
+            nPool = nPool + 1
+            pool1(nPool) = hb(l,1)*r(i,1) + hb(l,2)*r(i,3)
+     1                   + hb(l,3)*r(i,5) + hb(l,4)*r(i+1,1)
+     2                   + hb(l,5)*r(i+1,3) + hb(l,6)*r(i+1,5)
+            pool2(nPool) = hb(l,1)*r(i,2) + hb(l,2)*r(i,4)
+     1                   + hb(l,3)*r(i,6) + hb(l,4)*r(i+1,2)
+     2                   + hb(l,5)*r(i+1,4) + hb(l,6)*r(i+1,6)
+          enddo
+        endif
+      enddo
+      deallocate ( r, keep, fill, hb )
+
+      allocate ( x(nMax), yw(nMax), iSort(nMax), iHull(nMax+1) )
+      call CandWindow ( pool1, pool2, nPool, x )
+      call RotSa ( pool1, pool2, nPool, sa, iRotMode, x, yw,
+     1             iSort, iHull )
+
+      return
+      end
+
+c ----------------------------------------------------------------------
+c     Largest error, relative to the amplitude, of the quintic Hermite
+c     interpolant (RotDFreqOne, from the values and two derivatives
+c     at the ends) of a sine wave of om*h radians per interval (at most
+c     2, the error of dropping it).  The interpolation
+c     error of a function f is at most max|f**(6)|*h**6 * s**3*(1-s)**3
+c     / 6!, which is (om*h)**6/46080 at s = 1/2.
+      real*8 function RFreqHerm ( omh )
+
+      real*8 omh
+
+      RFreqHerm = min( 2.d0, omh**6/46080.d0 )
+
+      return
+      end
@@ -0,0 +1,96 @@
+/*
+ * rotdisa.c - load time choice of the rotd kernels.
+ *
+ * rotdsimd.F is built once per instruction set (see the makefile), the
+ * copies named peakrspmulti_avx2_, rotsa_sve_ and so on.  The plain
+ * names the Fortran callers use (peakrspmulti_, rotsa_, ...) are GNU
+ * indirect functions: when the program or librotd.so is loaded, the
+ * resolvers below look at the CPU and bind each name to the widest copy
+ * it can run,
+ *
+ *    x86-64    avx512 (AVX-512F), avx2, sse42, base (SSE2)
+ *    aarch64   sve, base (NEON)
+ *
+ * so a single build runs the best code on every node.  The call costs
+ * what a call into a shared library does.  All the copies give the same
+ * results (none of them contracts to FMA).
+ */
+
+#if defined(__aarch64__)
+#include <sys/auxv.h>
+#ifndef HWCAP_SVE
+#define HWCAP_SVE (1 << 22)
+#endif
+#endif
+
+#define ROTD_KERNELS(isa) \
+   void peakrspmulti_##isa##_(); \
+   void candrspmulti_##isa##_(); \
+   void peakrspmultis_##isa##_(); \
+   void candrspmultis_##isa##_(); \
+   void rotsa_##isa##_();
+
+ROTD_KERNELS(base)
+
+#if defined(__x86_64__)
+
+ROTD_KERNELS(avx512)
+ROTD_KERNELS(avx2)
+ROTD_KERNELS(sse42)
+
+/* 3 avx512, 2 avx2, 1 sse42, 0 base */
+static int rotd_isa_level()
+{
+__builtin_cpu_init();
+if(__builtin_cpu_supports("avx512f"))
+   return(3);
+if(__builtin_cpu_supports("avx2"))
+   return(2);
+if(__builtin_cpu_supports("sse4.2"))
+   return(1);
+return(0);
+}
+
+#define ROTD_RESOLVE(name) \
+static void (*name##resolve())() \
+{ \
+switch(rotd_isa_level()) \
+   { \
+   case 3: return(name##avx512_); \
+   case 2: return(name##avx2_); \
+   case 1: return(name##sse42_); \
+   } \
+return(name##base_); \
+} \
+void name() __attribute__((ifunc(#name "resolve")));
+
+#elif defined(__aarch64__)
+
+ROTD_KERNELS(sve)
+
+/* glibc hands the resolvers of aarch64 the AT_HWCAP bits */
+#define ROTD_RESOLVE(name) \
+static void (*name##resolve(unsigned long hwcap))() \
+{ \
+if(hwcap & HWCAP_SVE) \
+   return(name##sve_); \
+return(name##base_); \
+} \
+void name() __attribute__((ifunc(#name "resolve")));
+
+#else
+
+#define ROTD_RESOLVE(name) \
+static void (*name##resolve())() \
+{ \
+return(name##base_); \
+} \
+void name() __attribute__((ifunc(#name "resolve")));
+
+#endif
+
+ROTD_RESOLVE(peakrspmulti_)
+ROTD_RESOLVE(candrspmulti_)
+ROTD_RESOLVE(peakrspmultis_)
+ROTD_RESOLVE(candrspmultis_)
+ROTD_RESOLVE(rotsa_)
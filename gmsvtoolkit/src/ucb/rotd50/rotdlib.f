@@ -0,0 +1,128 @@
+!     ------------------------------------------------------------------
+!
+!      rotdlib.f
+!      C-callable entry points of librotd: the rotdnn computation for one
+!      pair of components already in memory, or for a batch of pairs
+!      (see rotdbatch.f), without the input file, the file names or the
+!      output file.  See rotdlib.h for the C prototypes and
+!      metrics/rotdlib.py for the Python binding.
+!     ------------------------------------------------------------------
+
+! ---------------------------------------------------------------------
+!     Computes, for the nPer periods (s) in period, the as-recorded PSa
+!     of both components and the nPct RotDnn percentiles pct.  acc1 is
+!     the E (Psa5_E, azimuth 0) and acc2 the N component, both npts
+!     points at time step dt.  jInterp, rotmode, nthreads, accuracy and
+!     precision (0 double, 1 single) are the same as in the rotdnn input
+!     file, except that nthreads 0 means one thread.  The results go to
+!     the caller's buffers: psaN(nPer), psaE(nPer) and rotd(nPct,nPer),
+!     i.e. in C rotd[iper*npct + ipct].  Returns 0, or 1 for bad
+!     arguments.
+
+      integer(c_int) function rotd_compute ( acc1, acc2, npts, dt,
+     1      period, nPer, damping, jInterp, pct, nPct, iRotMode,
+     2      nThreads, accur, iPrec, psaN, psaE, rotd )
+     3      bind(C, name='rotd_compute')
+      use iso_c_binding
+      implicit none
+
+      integer(c_int), value :: npts, nPer, jInterp, nPct, iRotMode, nThreads
+      integer(c_int), value :: iPrec
+      real(c_float), value :: dt, damping, accur
+      real(c_float) :: acc1(npts), acc2(npts), period(nPer), pct(nPct)
+      real(c_float) :: psaN(nPer), psaE(nPer), rotd(nPct,nPer)
+
+      integer iFreq, nThr
+      real dt_max
+      real, allocatable :: w(:), saAll(:,:)
+
+      rotd_compute = 1
+      if ( npts .lt. 2 .or. nPer .lt. 1 .or. nPct .lt. 1 ) return
+      if ( dt .le. 0. .or. jInterp .lt. 0 .or. jInterp .gt. 3 ) return
+      if ( accur .lt. 0. .or. accur .ge. 1. ) return
+      if ( iPrec .lt. 0 .or. iPrec .gt. 1 ) return
+      do iFreq=1,nPer
+        if ( period(iFreq) .le. 0. ) return
+      enddo
+
+!     Same settings as the drivers
+      dt_max = 0.001
+      nThr = max( 1, nThreads )
+
+!     Convert periods to freq in Radians
+      allocate ( w(nPer), saAll(180,nPer) )
+      do iFreq=1,nPer
+        w(iFreq) = 2.0*3.14159 / period(iFreq)
+      enddo
+
+      call RotDAcc ( acc1, acc2, npts, dt, jInterp, nPer, w, damping,
+     1               dt_max, accur, iRotMode, iPrec, 0, nThr, saAll )
+
+      do iFreq=1,nPer
+        psaE(iFreq) = saAll(1,iFreq)
+        psaN(iFreq) = saAll(91,iFreq)
+        call SaPercentile ( saAll(1,iFreq), 180, pct, nPct, rotd(1,iFreq) )
+      enddo
+
+      rotd_compute = 0
+      return
+      end
+
+! ---------------------------------------------------------------------
+!     Same as rotd_compute for nPair pairs of npts points each, all at
+!     time step dt, with the oscillators of all the pairs and periods
+!     computed together by RotDBatch (on a GPU if librotd was built
+!     with OFFLOAD).  acc1(npts,nPair), acc2(npts,nPair), i.e. in C
+!     acc1[ipair*npts + i]; psaN(nPer,nPair), psaE(nPer,nPair) and
+!     rotd(nPct,nPer,nPair).  nthreads is used for the interpolation.
+!     Returns 0, or 1 for bad arguments.
+
+      integer(c_int) function rotd_compute_batch ( acc1, acc2, npts,
+     1      nPair, dt, period, nPer, damping, jInterp, pct, nPct,
+     2      nThreads, psaN, psaE, rotd )
+     3      bind(C, name='rotd_compute_batch')
+      use iso_c_binding
+      implicit none
+
+      integer(c_int), value :: npts, nPair, nPer, jInterp, nPct, nThreads
+      real(c_float), value :: dt, damping
+      real(c_float) :: acc1(npts,nPair), acc2(npts,nPair)
+      real(c_float) :: period(nPer), pct(nPct)
+      real(c_float) :: psaN(nPer,nPair), psaE(nPer,nPair)
+      real(c_float) :: rotd(nPct,nPer,nPair)
+
+      integer iFreq, iPair
+      real dt_max
+      real, allocatable :: w(:), saAll(:,:,:)
+
+      rotd_compute_batch = 1
+      if ( npts .lt. 2 .or. nPair .lt. 1 ) return
+      if ( nPer .lt. 1 .or. nPct .lt. 1 ) return
+      if ( dt .le. 0. .or. jInterp .lt. 0 .or. jInterp .gt. 3 ) return
+      do iFreq=1,nPer
+        if ( period(iFreq) .le. 0. ) return
+      enddo
+
+!     Same settings as the drivers
+      dt_max = 0.001
+
+      allocate ( w(nPer), saAll(180,nPer,nPair) )
+      do iFreq=1,nPer
+        w(iFreq) = 2.0*3.14159 / period(iFreq)
+      enddo
+
+      call RotDBatch ( acc1, acc2, npts, nPair, dt, jInterp, nPer, w,
+     1                 damping, dt_max, max( 1, nThreads ), saAll )
+
+      do iPair=1,nPair
+        do iFreq=1,nPer
+          psaE(iFreq,iPair) = saAll(1,iFreq,iPair)
+          psaN(iFreq,iPair) = saAll(91,iFreq,iPair)
+          call SaPercentile ( saAll(1,iFreq,iPair), 180, pct, nPct,
+     1                        rotd(1,iFreq,iPair) )
+        enddo
+      enddo
+
+      rotd_compute_batch = 0
+      return
+      end
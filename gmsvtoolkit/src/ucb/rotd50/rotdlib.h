@@ -0,0 +1,49 @@
+/*
+ * rotdlib.h
+ * C prototypes of librotd (see rotdlib.f): RotDnn of pairs of
+ * horizontal components held in memory.
+ *
+ *   acc1, acc2  E and N components, npts points at time step dt
+ *   period      nper oscillator periods (s)
+ *   damping     fraction of critical (0.05)
+ *   interp      1 linear, 2 sine wave, 3 cubic spline interpolation
+ *   pct         npct percentiles (e.g. 50, 100)
+ *   rotmode, nthreads, accuracy, precision
+ *               as the options of the rotdnn input file (precision
+ *               0 double, 1 single)
+ *   psa_n, psa_e
+ *               as-recorded PSa of each component, nper values
+ *   rotd        RotDnn, nper*npct values: rotd[iper*npct + ipct]
+ *
+ * rotd_compute_batch does the same for npair pairs of npts points at
+ * the same dt in one call, with the oscillators of all the pairs run
+ * together (on a GPU when librotd is built with make OFFLOAD=...):
+ * acc1[ipair*npts + i], psa_n[ipair*nper + iper] and
+ * rotd[(ipair*nper + iper)*npct + ipct].  Like accuracy 0, rotmode 0.
+ *
+ * Both return 0 on success, 1 for bad arguments.
+ */
+#ifndef ROTDLIB_H
+#define ROTDLIB_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int rotd_compute(const float *acc1, const float *acc2, int npts, float dt,
+                 const float *period, int nper, float damping, int interp,
+                 const float *pct, int npct, int rotmode, int nthreads,
+                 float accuracy, int precision, float *psa_n,
+                 float *psa_e, float *rotd);
+
+int rotd_compute_batch(const float *acc1, const float *acc2, int npts,
+                       int npair, float dt, const float *period, int nper,
+                       float damping, int interp, const float *pct,
+                       int npct, int nthreads, float *psa_n,
+                       float *psa_e, float *rotd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,215 @@
+!     ------------------------------------------------------------------
+!
+!      rotDnn.f
+!      Computes the as-recorded PSa and any list of RotDnn percentiles
+!      (e.g. RotD00, RotD50, RotD84, RotD100) in one pass, using pairs of
+!      orthogonal horizontal components.  Built on rotD50.f / rotD100.f.
+!     ------------------------------------------------------------------
+!      Input provided in filein (rotdnn_inp.cfg), same as rotd100:
+!             -  Interp: mode of interpolation for small dt 
+!                 1. linear interpolation
+!                 2. sine wave interpolation (e.g. frequency domain interpolation)
+!                 3. cubic spline interpolation 
+!             - NPairs: number of pairs to read
+!             - NHead: number of header lines in ASCII time series files
+!             - Optional keyword lines, one per option:
+!                  percentiles p1 p2 ...
+!                              percentiles to write, space separated
+!                              (default 50 100, the rotd100 columns)
+!                  rotmode 0   rotate all points for every angle (default)
+!                  rotmode 1   only rotate the convex hull vertices of the
+!                              oscillator trajectory (same result, faster)
+!                  nthreads n  run on n OpenMP threads, over the pairs when
+!                              there are several, else over the periods
+!                              (0 = all available, default 1 unless
+!                              OMP_NUM_THREADS is set)
+!                  accuracy e  integrate the long periods on coarser steps
+!                              of the interpolated series, keeping the
+!                              peak error on a sine wave below e (e.g.
+!                              0.001); 0 = fine step for all (default)
+!                  precision single
+!                              run the oscillators in single precision
+!                              with compensated updates (peaks within
+!                              about 1E-6 of the default double)
+!                  engine freq compute the responses from one FFT of the
+!                              record and the SDOF transfer functions:
+!                              the Interp 2 results in the limit of a
+!                              fine dt_max, without interpolating (needs
+!                              Interp 2; accuracy is then the relative
+!                              accuracy of the peaks, 1E-4 by default),
+!                              for long records
+!                  periods p1 p2 ...
+!                              oscillator periods (s), instead of the 63
+!                              period table below, or the name of a
+!                              file holding them (up to 1000)
+!                  damping d1 d2 ...
+!                              damping ratios (default 0.05); with more
+!                              than one each goes to the output file
+!                              name with _d and the damping appended
+!                              (e.g. out_d0.020)
+!             - Series of file names:
+!                  file name component 1 (input)
+!                  file name component 2 (input)
+!                  file name RotDnn output
+!            Input files in the WCC binary layout (write_wccseis with bflag=1)
+!            are also accepted and recognized by their size (see ReadPeerHead)
+!     ------------------------------------------------------------------
+
+      program Calc_RotDnn
+      include 'rotdopt.h'
+
+      character*80 filein
+      character*80, allocatable :: fileacc1(:), fileacc2(:), fileout_rdnn(:)
+      integer npair, nhead, iFlag, nThrPair
+      real rsp_Period(63), w(MAXPER)
+    
+      data RSP_Period / 0.010, 0.011, 0.012, 0.013, 0.015, 0.017, 0.020, 0.022, 0.025, 0.029, 
+     1               0.032, 0.035, 0.040, 0.045, 0.050, 0.055, 0.060, 0.065, 0.075, 0.085, 
+     2               0.100, 0.110, 0.120, 0.130, 0.150, 0.170, 0.200, 0.220, 0.240, 0.260, 
+     3               0.280, 0.300, 0.350, 0.400, 0.450, 0.500, 0.550, 0.600, 0.650, 0.750, 
+     4               0.850, 1.000, 1.100, 1.200, 1.300, 1.500, 1.700, 2.000, 2.200, 2.400, 
+     5               2.600, 2.800, 3.000, 3.500, 4.000, 4.400, 5.000, 5.500, 6.000, 6.500, 
+     6               7.500, 8.500, 10.000 /	
+
+      dt_max = 0.001
+
+!     Read in the input filename filein 
+      filein = "rotdnn_inp.cfg"
+!     Uncomment below to make interactive instead
+!     write (*,*) 'Enter the input filename.'
+!     read (*,*) filein
+      open (30,file=filein, status='old')
+
+
+!      write (*,'( 2x,''write out interpolations? (0=no, 1=yes)'')')
+!     read (*,*) iFlag
+      iFlag = 0
+      if ( iFlag .eq. 1 ) then
+        write (*,'( 2x,'' enter times (sec) of first and last points to write out'')')
+        read (*,*) time1, time2
+      endif
+
+!     Read interpolation method to be used
+      read (30,*) jInterp
+!     Read number of pairs and number of header lines
+      read (30,*) nPair
+      read (30,*) nHead
+!     Read the optional keyword lines (e.g. rotmode)
+      call ReadRotdOpts ( 30, jInterp )
+
+!     Periods of the periods option, else the table above
+      if ( nPer .eq. 0 ) then
+        nPer = 63
+        do iFreq=1,nPer
+          per(iFreq) = rsp_period(iFreq)
+        enddo
+      endif
+      nFreq = nPer
+
+!     Convert periods to freq in Radians
+      do iFreq=1,nFreq
+        w(iFreq) = 2.0*3.14159 / per(iFreq)
+      enddo
+
+!     Read the file names of all pairs
+      allocate ( fileacc1(nPair), fileacc2(nPair), fileout_rdnn(nPair) )
+      do iPair=1,nPair
+        read (30,'(a80)') fileacc1(iPair)
+        read (30,'(a80)') fileacc2(iPair)
+        read (30,'(a80)') fileout_rdnn(iPair)
+      enddo
+      close (30)
+
+!     Loop over each pair.  With several pairs the threads share out the
+!     pairs, with a single pair they share out its periods.
+      nThrPair = 1
+      if ( nPair .eq. 1 ) nThrPair = nThreads
+!$omp parallel do if (nThreads .gt. 1 .and. nPair .gt. 1) num_threads(nThreads)
+!$omp& schedule(dynamic,1)
+      do iPair=1,nPair
+
+!    Uncomment below for screen output
+!        write (*,'( 2x,'' set '',i5)') ipair
+
+        call RotDnnPair ( fileacc1(iPair), fileacc2(iPair), fileout_rdnn(iPair), nHead,
+     1                    jInterp, nFreq, per, w, nDamp, damp, dt_max, accur, iRotMode, iPrec, iEngine, nThrPair,
+     2                    nPct, pct )
+      enddo
+!$omp end parallel do
+
+      stop
+      end
+
+! ---------------------------------------------------------------------
+!     Computes the RotDnn percentiles pct(1..nPct) for one pair of
+!     horizontal components and writes them to fileout_rdnn, one file
+!     per damping when there are several (see DampFile).
+
+      subroutine RotDnnPair ( fileacc1, fileacc2, fileout_rdnn, nHead, jInterp,
+     1                        nFreq, rsp_period, w, nDamp, damp, dt_max, accur, iRotMode, iPrec, iEngine, nThreads,
+     2                        nPct, pct )
+
+      character*80 fileacc1, fileacc2, fileout_rdnn
+      integer nHead, jInterp, nFreq, nDamp, iRotMode, iPrec, iEngine, nThreads, nPct
+      real rsp_Period(1), w(1), damp(1), dt_max, accur, pct(1)
+      integer iu, i, ic, id
+      character*90 filed
+      real sa(180)
+      real, allocatable :: psa5E(:), psa5N(:)
+      character*400 header
+      character*8 label
+      real, allocatable :: saAll(:,:,:), rotDnn(:,:)
+
+!     Compute the rotated peak responses of each oscilator frequency
+      allocate ( saAll(180,nFreq,nDamp), rotDnn(nPct,nFreq), psa5E(nFreq),
+     1           psa5N(nFreq) )
+      call RotDPair ( fileacc1, fileacc2, nHead, jInterp, nFreq, w, nDamp, damp,
+     1                dt_max, accur, iRotMode, iPrec, iEngine, nThreads, saAll )
+
+!     Percentiles and output file of each damping
+      do id=1,nDamp
+        call DampFile ( fileout_rdnn, damp(id), nDamp, filed )
+
+        do iFreq=1,nFreq 
+          do j=1,180
+            sa(j) = saAll(j,iFreq,id)
+          enddo
+
+!         Get the as-recorded PSa
+          psa5E(iFreq) = sa(1)
+          psa5N(iFreq) = sa(91)
+
+!         Select the percentiles
+          call SaPercentile ( sa, 180, pct, nPct, rotDnn(1,iFreq) )
+        enddo
+
+!       Header names the percentile columns, e.g. RotD00, RotD50, RotD100
+        header = '#  Psa5_N Psa5_E'
+        ic = len_trim(header)
+        do i=1,nPct
+          if ( nint(pct(i)) .lt. 10 ) then
+            write (label,'(''RotD'',i2.2)') nint(pct(i))
+          else
+            write (label,'(''RotD'',i0)') nint(pct(i))
+          endif
+          header = header(1:ic) // ' ' // label
+          ic = len_trim(header)
+        enddo
+
+!       Open output files for writing
+        open (newunit=iu,file=filed,status='replace')
+
+!       Write Psa5 and RotDnn file
+        write (iu,'(a)') header(1:ic)
+        write (iu,'(''#'', 2x, a80)') fileacc1
+        write (iu,'(''#'', 2x, a80)') fileacc2
+        write (iu,'(''#'', 2x, i5, f10.4)') nFreq, damp(id)
+        do iFreq=1,nFreq
+          write (iu,'(f10.4, 1x, e10.5, 1x, e10.5, 20(1x, e10.5))') rsp_period(iFreq),psa5N(iFreq),psa5E(iFreq),
+     1          (rotDnn(i,iFreq),i=1,nPct)
+        enddo
+        close (iu)
+      enddo
+
+      return
+      end
@@ -0,0 +1,28 @@
+c     Run-time options read from the optional keyword lines of
+c     rotd50_inp.cfg / rotd100_inp.cfg / rotdnn_inp.cfg (see
+c     ReadRotdOpts in rotsa.f)
+c        iRotMode: 0 = brute-force rotation of all points
+c                  1 = pruned search over the convex hull vertices
+c        nThreads: number of OpenMP threads, spread over the pairs
+c                  when there is more than one, else over the periods
+c        nPct, pct: percentiles written by rotdnn
+c        accur:    accuracy target of the adaptive time step (see
+c                  RotDSaDecim in rotdpair.f), 0 = fine step for all
+c        iPrec:    0 = real*8 oscillators, 1 = real*4 (see PeakRspMultiS
+c                  in calcrsp.f)
+c        iEngine:  0 = oscillators integrated in the time domain on the
+c                  interpolated series, 1 = responses from the spectrum
+c                  of the record (see RotDFreq in rotdfreq.f), only
+c                  with Interp 2
+c        nPer, per: oscillator periods (s) of the periods option, 0 =
+c                  the 63 period table of the drivers
+c        nDamp, damp: damping ratios of the damping option, each run
+c                  on every pair (default the one 0.05)
+      integer MAXPCT, MAXPER, MAXDAMP
+      parameter ( MAXPCT=20, MAXPER=1000, MAXDAMP=10 )
+      integer iRotMode, iPrec, iEngine, nThreads, nPct
+      real pct(MAXPCT), accur
+      common /rotdopt/ iRotMode, iPrec, iEngine, nThreads, nPct, pct, accur
+      integer nPer, nDamp
+      real per(MAXPER), damp(MAXDAMP)
+      common /rotdper/ nPer, nDamp, per, damp
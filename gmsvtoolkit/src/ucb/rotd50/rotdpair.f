@@ -0,0 +1,392 @@
+!     ------------------------------------------------------------------
+!
+!      rotdpair.f
+!      Front end shared by the rotd50, rotd100 and rotdnn drivers: reads
+!      one pair of horizontal components, interpolates them to a finer
+!      time step and computes the rotated peak responses of all periods
+!     ------------------------------------------------------------------
+
+! ---------------------------------------------------------------------
+!     On return saAll(1..180,k,id) holds the peaks of the 180 rotated
+!     components for oscillator frequency w(k) and damping damp(id)
+!     (see RotSa); the pair is read once for all the nDamp dampings.
+!     All the work arrays are local to the call so that several pairs
+!     can be processed at the same time.
+
+      subroutine RotDPair ( fileacc1, fileacc2, nHead, jInterp, nFreq, w, nDamp, damp,
+     1                      dt_max, accur, iRotMode, iPrec, iEngine, nThreads, saAll )
+
+      character*80 fileacc1, fileacc2
+      integer nHead, jInterp, nFreq, nDamp, iRotMode, iPrec, iEngine, nThreads
+      real w(*), damp(*), dt_max, accur, saAll(180,nFreq,*)
+      integer npts1, npts2, iu1, iu2, id
+      integer*8 nBytes1, nBytes2
+      real dt1, dt2, dt
+      real, allocatable :: acc1(:), acc2(:)
+      double precision t0
+
+!     Read the headers of Horiz 1 (x) and Horiz 2 (y) components
+!    Uncomment below for screen output
+!      write (*,'( a70)') fileacc1
+!      write (*,'( a70)') fileacc2
+      call prof_start ( t0 )
+      call ReadPeerHead ( fileacc1, nHead, iu1, npts1, dt1 )
+      call ReadPeerHead ( fileacc2, nHead, iu2, npts2, dt2 )
+      allocate ( acc1(npts1), acc2(npts2) )
+      call ReadPeerData ( iu1, acc1, npts1 )
+      call ReadPeerData ( iu2, acc2, npts2 )
+      if ( t0 .ge. 0. ) then
+        inquire ( file=fileacc1, size=nBytes1 )
+        inquire ( file=fileacc2, size=nBytes2 )
+        call prof_io ( 'rotd_read', nBytes1+nBytes2, 0_8 )
+        call prof_stop ( 'rotd_read', t0, npts1+npts2 )
+      endif
+
+!     Check that the two time series have the same number of points.  If not, reset to smaller value
+      if (npts1 .lt. npts2) then
+        npts0 = npts1
+      elseif (npts2 .lt. npts1) then
+        npts0 = npts2
+      elseif (npts1 .eq. npts2) then
+        npts0 = npts1
+      endif
+      
+!     Check that the two time series have the same dt.
+      if (dt1 .ne. dt2) then
+        write (*,*) 'DT values are not equal!!!'
+        write (*,*) 'DT1 = ', dt1
+        write (*,*) 'DT2 = ', dt2
+      else
+        dt = dt1
+      endif
+
+      do id=1,nDamp
+        call RotDAcc ( acc1, acc2, npts0, dt, jInterp, nFreq, w, damp(id),
+     1                 dt_max, accur, iRotMode, iPrec, iEngine, nThreads, saAll(1,1,id) )
+      enddo
+
+      return
+      end
+
+! ---------------------------------------------------------------------
+!     Same as RotDPair for a pair already in memory: acc1/acc2 hold the
+!     npts0 points of the two components, at time step dt; they are
+!     not changed.  The series are copied to work arrays large enough
+!     for the interpolated series.  With iEngine = 1 the responses are
+!     computed in the frequency domain instead (RotDFreq), from the
+!     series itself: the jInterp 2 results in the limit of a fine
+!     dt_max, to the relative accuracy accur (dt_max and iPrec are not
+!     used).
+
+      subroutine RotDAcc ( acc1in, acc2in, npts0, dt0, jInterp, nFreq, w, damping,
+     1                     dt_max, accur, iRotMode, iPrec, iEngine, nThreads, saAll )
+
+      real acc1in(*), acc2in(*), dt0
+      integer npts0, jInterp, nFreq, iRotMode, iPrec, iEngine, nThreads
+      real w(*), damping, dt_max, accur, saAll(180,*)
+      integer npts, nAlloc, i
+      real dt
+      real, allocatable :: acc1(:), acc2(:)
+      double precision t0
+
+      call prof_start ( t0 )
+      if ( iEngine .eq. 1 ) then
+        call RotDFreq ( acc1in, acc2in, npts0, dt0, w, nFreq, damping,
+     1                  accur, iRotMode, nThreads, saAll )
+        call prof_stop ( 'rotd_freq', t0, npts0 )
+        return
+      endif
+
+      call InterpSize ( npts0, dt0, jInterp, dt_max, NN, nAlloc )
+      allocate ( acc1(nAlloc), acc2(nAlloc) )
+
+      npts = npts0
+      dt = dt0
+      do i=1,npts
+        acc1(i) = acc1in(i)
+        acc2(i) = acc2in(i)
+      enddo
+
+!     Interpolate to finer time step for calculating the Spectral acceleration
+      call InterpPair ( acc1, acc2, npts, dt, jInterp, NN, nAlloc )
+      if ( jInterp .eq. 2 ) then
+        call prof_fft ( 'rotd_interp', t0, nAlloc )
+      else
+        call prof_stop ( 'rotd_interp', t0, npts )
+      endif
+
+!     Compute the rotated peak responses of each oscilator frequency
+      call prof_start ( t0 )
+      if ( accur .gt. 0. .and. NN .gt. 1 ) then
+        call RotDSaDecim ( acc1, acc2, npts, dt, NN, w, nFreq, damping,
+     1                     accur, iRotMode, iPrec, nThreads, saAll )
+      else
+        call RotDSa ( acc1, acc2, npts, dt, w, nFreq, damping, iRotMode, iPrec, nThreads, saAll )
+      endif
+      call prof_stop ( 'rotd_rotsa', t0, npts )
+
+      return
+      end
+
+! ---------------------------------------------------------------------
+!     Interpolation factor NN of a series of npts points at time step
+!     dt (fine step at most dt_max) and the length nAlloc of the arrays
+!     that hold it once interpolated.  The frequency domain
+!     interpolation first pads the series to a power of 2.
+
+      subroutine InterpSize ( npts, dt, jInterp, dt_max, NN, nAlloc )
+
+      integer npts, jInterp, NN, nAlloc, npts2p
+      real dt, dt_max
+
+      nAlloc = npts
+      NN = 1
+      if ( jInterp .ne. 0 ) then
+        NN = 2**(int(alog(dt/dt_max)/alog(2.))+1)
+        npts2p = npts
+        if ( jInterp .eq. 2 ) npts2p = 2**int( alog(float(npts))/alog(2.) + 0.9999 )
+        nAlloc = NN*npts2p
+      endif
+
+      return
+      end
+
+! ---------------------------------------------------------------------
+!     Interpolates the pair acc1/acc2 (arrays of nAlloc, see InterpSize)
+!     in place by NN with method jInterp; npts and dt are updated.
+
+      subroutine InterpPair ( acc1, acc2, npts, dt, jInterp, NN, nAlloc )
+
+      real acc1(*), acc2(*), dt
+      integer npts, jInterp, NN, nAlloc
+      real, allocatable :: u(:)
+      complex, allocatable :: cu1(:)
+
+      if ( jInterp .eq. 1 ) allocate ( u(nAlloc) )
+      if ( jInterp .eq. 2 ) allocate ( cu1(nAlloc) )
+
+      if ( jInterp .ne. 0 ) then
+
+!    Uncomment below for screen output
+!        write (*,'( 2x,''jInterp, dt, interpolation factor '',i5,f10.5,i5)') jinterp, dt, NN
+
+!       Time domain linear interpolation
+        if ( jINterp .eq. 1 ) then
+          call InterpTime (acc1, dt, npts, dt10, npts10, NN, u )
+          call InterpTime (acc2, dt, npts, dt10, npts10, NN, u )
+
+!       Freq domain interpolation (sine wave)
+        elseif (jInterp .eq. 2 ) then
+          call InterpFreqW (acc1, npts, cu1, NN, npts10, dt )
+          call InterpFreqW (acc2, npts, cu1, NN, npts10, dt )
+          dt10 = dt / NN
+
+!       Time domain cubic spline interpolation
+        elseif (jInterp .eq. 3 ) then
+          call InterpSpline ( acc1, acc2, dt, npts, dt10, npts10, NN )
+        endif
+        npts = npts10    
+        dt = dt10
+      endif
+
+      return
+      end
+
+! ---------------------------------------------------------------------
+!     Same as RotDSa, but each frequency is integrated on the coarsest
+!     step dt*2**lev (lev = 0 .. log2(NN), i.e. at most the original
+!     step) whose worst sampled peak of a sine wave of that frequency,
+!     cos(w*h/2), is within accur of the true peak.  The levels are
+!     nested decimations of the interpolated series, made in place by
+!     keeping every other point, so acc1/acc2 are destroyed.  With
+!     linear interpolation the decimated series are the same piecewise
+!     linear input, so only the peak sampling changes.
+
+      subroutine RotDSaDecim ( acc1, acc2, npts, dt, NN, w, nFreq, damping,
+     1                         accur, iRotMode, iPrec, nThreads, saAll )
+
+      real acc1(*), acc2(*), dt, w(*), damping, accur, saAll(180,*)
+      integer npts, NN, nFreq, iRotMode, iPrec, nThreads
+      integer maxLev, lev, nLev, n, nL, i, k
+      real h, hMax
+      integer, allocatable :: iLev(:), indx(:)
+      real, allocatable :: wL(:), saL(:,:)
+
+      allocate ( iLev(nFreq), indx(nFreq), wL(nFreq), saL(180,nFreq) )
+
+!     Pick the level of each frequency
+      maxLev = nint( alog(float(NN))/alog(2.) )
+      nLev = 0
+      do k=1,nFreq
+        hMax = 2. * acos(1.-accur) / w(k)
+        lev = 0
+        do while ( lev .lt. maxLev .and. dt*2.**(lev+1) .le. hMax )
+          lev = lev + 1
+        enddo
+        iLev(k) = lev
+        nLev = max( nLev, lev )
+      enddo
+
+      n = npts
+      h = dt
+      do lev=0,nLev
+
+!       Gather the frequencies of this level and compute them together
+        nL = 0
+        do k=1,nFreq
+          if ( iLev(k) .eq. lev ) then
+            nL = nL + 1
+            indx(nL) = k
+            wL(nL) = w(k)
+          endif
+        enddo
+        if ( nL .gt. 0 ) then
+          call RotDSa ( acc1, acc2, n, h, wL, nL, damping, iRotMode, iPrec, nThreads, saL )
+          do k=1,nL
+            do i=1,180
+              saAll(i,indx(k)) = saL(i,k)
+            enddo
+          enddo
+        endif
+
+!       Decimate by 2 for the next level
+        n = (n+1)/2
+        do i=2,n
+          acc1(i) = acc1(2*i-1)
+          acc2(i) = acc2(2*i-1)
+        enddo
+        h = 2.*h
+      enddo
+
+      return
+      end
+
+! ---------------------------------------------------------------------
+
+      subroutine Calc_Sa ( x, Sa, npts )
+      real x(*), Sa
+
+      sa = -1E30
+      do i=1,npts
+        x1 = abs(x(i))
+        if ( x1 .gt. Sa ) Sa = x1
+      enddo
+      return
+      end
+
+! ---------------------------------------------------------------------
+      Subroutine InterpTime (acc1, dt, npts, dt10, npts10, NN, acc2 )
+
+      real acc1(*)
+      real acc2(*)
+
+      k = 1
+      do i=1,npts-1
+        do j=1,NN
+          dy = (acc1(i+1)-acc1(i))/NN
+          acc2(k) = acc1(i) + dy*(j-1)
+          k = k + 1
+        enddo
+      enddo
+      acc2(k) = acc1(npts)
+      npts10 = k
+      dt10 = dt / NN
+
+      do i=1,npts10
+        acc1(i) = acc2(i)
+      enddo
+      return
+      end
+
+      
+
+! ---------------------------------------------------------------------
+
+!     Cubic spline interpolation of the pair acc1/acc2 (npts points at
+!     step dt, zero end slopes) by NN, in place in arrays of nAlloc (see
+!     InterpSize); npts10 is the new number of points.  This is spline
+!     and splint done for both components at once, with the same
+!     arithmetic (knots x0(i) = i*dt in single precision, so the results
+!     are those of the two calls bit for bit): the knots and the
+!     elimination factors of spline are shared, and each output point
+!     finds its interval by stepping up from the knot it starts from
+!     instead of splint's bisection, its weights then serving both
+!     components.
+
+      subroutine InterpSpline ( acc1, acc2, dt, npts, dt10, npts10, NN )
+
+      real acc1(*), acc2(*), dt, dt10
+      integer npts, npts10, NN
+      integer i, j, k, klo, khi
+      real yp1, ypn, sig, p, qn, un1, un2, x_new, h, a, b
+      real, allocatable :: x0(:), g(:), y01(:), y02(:), u1(:), u2(:)
+
+      if ( npts .lt. 2 ) then
+        npts10 = npts
+        dt10 = dt / NN
+        return
+      endif
+
+      allocate ( x0(npts), g(npts), y01(npts), y02(npts), u1(npts),
+     1           u2(npts) )
+
+c     Set x array
+      do i=1,npts
+        x0(i) = i*dt
+        y01(i) = acc1(i)
+        y02(i) = acc2(i)
+      enddo
+      yp1 = 0.
+      ypn = 0.
+
+!     spline: g holds the shared y2 factors of the elimination, u1/u2
+!     the right hand sides and then the second derivatives
+      g(1) = -0.5
+      u1(1) = (3./(x0(2)-x0(1)))*((y01(2)-y01(1))/(x0(2)-x0(1))-yp1)
+      u2(1) = (3./(x0(2)-x0(1)))*((y02(2)-y02(1))/(x0(2)-x0(1))-yp1)
+      do i=2,npts-1
+        sig = (x0(i)-x0(i-1))/(x0(i+1)-x0(i-1))
+        p = sig*g(i-1)+2.
+        g(i) = (sig-1.)/p
+        u1(i) = (6.*((y01(i+1)-y01(i))/(x0(i+1)-x0(i))-(y01(i)-y01(i-1))
+     1          /(x0(i)-x0(i-1)))/(x0(i+1)-x0(i-1))-sig*u1(i-1))/p
+        u2(i) = (6.*((y02(i+1)-y02(i))/(x0(i+1)-x0(i))-(y02(i)-y02(i-1))
+     1          /(x0(i)-x0(i-1)))/(x0(i+1)-x0(i-1))-sig*u2(i-1))/p
+      enddo
+      qn = 0.5
+      un1 = (3./(x0(npts)-x0(npts-1)))*(ypn-(y01(npts)-y01(npts-1))/(x0(npts)-x0(npts-1)))
+      un2 = (3./(x0(npts)-x0(npts-1)))*(ypn-(y02(npts)-y02(npts-1))/(x0(npts)-x0(npts-1)))
+      u1(npts) = (un1-qn*u1(npts-1))/(qn*g(npts-1)+1.)
+      u2(npts) = (un2-qn*u2(npts-1))/(qn*g(npts-1)+1.)
+      do k=npts-1,1,-1
+        u1(k) = g(k)*u1(k+1)+u1(k)
+        u2(k) = g(k)*u2(k+1)+u2(k)
+      enddo
+
+!     splint at the NN points of each interval; klo is the last knot
+!     not past x_new, as the bisection finds it
+      k = 1
+      do i=1,npts-1
+        do j=1,NN
+          x_new = x0(i) + dt*float(j-1)/NN
+          klo = i
+          do while ( klo .lt. npts-1 .and. x0(klo+1) .le. x_new )
+            klo = klo + 1
+          enddo
+          khi = klo + 1
+          h = x0(khi)-x0(klo)
+          a = (x0(khi)-x_new)/h
+          b = (x_new-x0(klo))/h
+          acc1(k) = a*y01(klo)+b*y01(khi)+((a**3-a)*u1(klo)+(b**3-b)*u1(khi))*(h**2)/6.
+          acc2(k) = a*y02(klo)+b*y02(khi)+((a**3-a)*u2(klo)+(b**3-b)*u2(khi))*(h**2)/6.
+          k = k + 1
+        enddo
+      enddo
+      acc1(k) = y01(npts)
+      acc2(k) = y02(npts)
+      dt10 = dt / NN
+      npts10 = k
+
+      return
+      end
+
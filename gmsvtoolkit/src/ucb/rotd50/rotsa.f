@@ -0,0 +1,651 @@
+c ----------------------------------------------------------------------
+c     This subroutine reads the optional keyword lines that may follow
+c     the Nhead line of the rotd input file.  Each line holds a keyword
+c     and its value, for example
+c        rotmode 1
+c     The first line that does not start with a known keyword is the
+c     first input file name, so it is pushed back for the caller.
+c     The periods option takes either the periods themselves or, for
+c     longer lists, the name of a file of periods (any layout).
+c     jInterp is the interpolation of the input file, checked against
+c     the engine option: engine freq only reproduces Interp 2.
+      subroutine ReadRotdOpts ( iunit, jInterp )
+      include 'rotdopt.h'
+
+      integer iunit, jInterp, i, ic, ios, iu, n
+      character*80 line, key
+      character*256 rec
+!$    integer omp_get_max_threads
+
+c     Defaults.  Threads are only used when asked for, either with the
+c     nthreads option or by setting OMP_NUM_THREADS.
+      iRotMode = 0
+      nThreads = 1
+      nPct = 2
+      pct(1) = 50.
+      pct(2) = 100.
+      accur = 0.
+      iPrec = 0
+      iEngine = 0
+      nPer = 0
+      nDamp = 1
+      damp(1) = 0.05
+!$    call get_environment_variable ( 'OMP_NUM_THREADS', status=ios )
+!$    if ( ios .eq. 0 ) nThreads = omp_get_max_threads()
+
+  10  read (iunit,'(a80)',end=20) line
+      line = adjustl(line)
+      i = index(line,' ')
+      key = line(1:i)
+      do ic=1,i
+        if ( key(ic:ic) .ge. 'A' .and. key(ic:ic) .le. 'Z' ) then
+          key(ic:ic) = char(ichar(key(ic:ic)) + 32)
+        endif
+      enddo
+
+      if ( key .eq. 'rotmode' ) then
+        read (line(i:80),*,iostat=ios) iRotMode
+        if ( ios .ne. 0 ) then
+          write (*,'( 2x,''Bad rotmode option: '',a80)') line
+          stop 99
+        endif
+      elseif ( key .eq. 'nthreads' ) then
+c       0 means all the threads OpenMP makes available
+        read (line(i:80),*,iostat=ios) nThreads
+        if ( ios .ne. 0 ) then
+          write (*,'( 2x,''Bad nthreads option: '',a80)') line
+          stop 99
+        endif
+!$      if ( nThreads .le. 0 ) nThreads = omp_get_max_threads()
+        if ( nThreads .le. 0 ) nThreads = 1
+      elseif ( key .eq. 'accuracy' ) then
+c       Must be below 1, see RotDSaDecim
+        read (line(i:80),*,iostat=ios) accur
+        if ( ios .ne. 0 .or. accur .lt. 0. .or. accur .ge. 1. ) then
+          write (*,'( 2x,''Bad accuracy option: '',a80)') line
+          stop 99
+        endif
+      elseif ( key .eq. 'precision' ) then
+c       Oscillator arithmetic, double (default) or single
+        key = adjustl(line(i:80))
+        if ( key .eq. 'double' ) then
+          iPrec = 0
+        elseif ( key .eq. 'single' ) then
+          iPrec = 1
+        else
+          write (*,'( 2x,''Bad precision option: '',a80)') line
+          stop 99
+        endif
+      elseif ( key .eq. 'engine' ) then
+c       Time domain oscillators (default) or frequency domain responses
+        key = adjustl(line(i:80))
+        if ( key .eq. 'time' ) then
+          iEngine = 0
+        elseif ( key .eq. 'freq' ) then
+          iEngine = 1
+        else
+          write (*,'( 2x,''Bad engine option: '',a80)') line
+          stop 99
+        endif
+      elseif ( key .eq. 'periods' ) then
+c       A list of values, else a file of them
+        nPer = 0
+        do ic=i,79
+          if ( line(ic:ic) .eq. ' ' .and. line(ic+1:ic+1) .ne. ' ' )
+     1      nPer = nPer + 1
+        enddo
+        nPer = min( nPer, MAXPER )
+        read (line(i:80),*,iostat=ios) (per(ic),ic=1,nPer)
+        if ( ios .ne. 0 .and. nPer .eq. 1 ) then
+          key = adjustl(line(i:80))
+          open (newunit=iu,file=key,status='old',iostat=ios)
+          if ( ios .ne. 0 ) then
+            write (*,'( 2x,''Cannot open periods file: '',a80)') key
+            stop 99
+          endif
+          nPer = 0
+          do
+            read (iu,'(a256)',iostat=ios) rec
+            if ( ios .ne. 0 ) exit
+            n = 0
+            if ( rec(1:1) .ne. ' ' ) n = 1
+            do ic=1,255
+              if ( rec(ic:ic) .eq. ' ' .and. rec(ic+1:ic+1) .ne. ' ' )
+     1          n = n + 1
+            enddo
+            if ( nPer + n .gt. MAXPER ) then
+              write (*,'( 2x,''Too many periods, max is '',i5)') MAXPER
+              stop 99
+            endif
+            read (rec,*,iostat=ios) (per(nPer+ic),ic=1,n)
+            if ( ios .ne. 0 ) then
+              write (*,'( 2x,''Bad line in periods file: '',a80)') rec
+              stop 99
+            endif
+            nPer = nPer + n
+          enddo
+          close (iu)
+          ios = 0
+        endif
+        n = 0
+        do ic=1,nPer
+          if ( per(ic) .le. 0. ) n = n + 1
+        enddo
+        if ( ios .ne. 0 .or. nPer .eq. 0 .or. n .gt. 0 ) then
+          write (*,'( 2x,''Bad periods option: '',a80)') line
+          stop 99
+        endif
+      elseif ( key .eq. 'damping' ) then
+c       Damping ratios, e.g. 0.02 0.05 0.1
+        nDamp = 0
+        do ic=i,79
+          if ( line(ic:ic) .eq. ' ' .and. line(ic+1:ic+1) .ne. ' ' )
+     1      nDamp = nDamp + 1
+        enddo
+        if ( nDamp .gt. MAXDAMP ) then
+          write (*,'( 2x,''Too many dampings, max is '',i3)') MAXDAMP
+          stop 99
+        endif
+        read (line(i:80),*,iostat=ios) (damp(ic),ic=1,nDamp)
+        n = 0
+        do ic=1,nDamp
+          if ( damp(ic) .le. 0. .or. damp(ic) .ge. 1. ) n = n + 1
+        enddo
+        if ( ios .ne. 0 .or. nDamp .eq. 0 .or. n .gt. 0 ) then
+          write (*,'( 2x,''Bad damping option: '',a80)') line
+          stop 99
+        endif
+      elseif ( key .eq. 'percentiles' ) then
+c       Count the values first, list-directed reads need to know
+        nPct = 0
+        do ic=i,79
+          if ( line(ic:ic) .eq. ' ' .and. line(ic+1:ic+1) .ne. ' ' )
+     1      nPct = nPct + 1
+        enddo
+        if ( nPct .gt. MAXPCT ) then
+          write (*,'( 2x,''Too many percentiles, max is '',i3)') MAXPCT
+          stop 99
+        endif
+        read (line(i:80),*,iostat=ios) (pct(ic),ic=1,nPct)
+        if ( ios .ne. 0 .or. nPct .eq. 0 ) then
+          write (*,'( 2x,''Bad percentiles option: '',a80)') line
+          stop 99
+        endif
+      else
+        backspace (iunit)
+        goto 20
+      endif
+      goto 10
+
+  20  if ( iEngine .eq. 1 .and. jInterp .ne. 2 ) then
+        write (*,'( 2x,''Bad engine option: engine freq needs '',
+     1              ''Interp 2, not '',i0)') jInterp
+        stop 99
+      endif
+
+      return
+      end
+
+c ----------------------------------------------------------------------
+c     Output file name for damping of the nDamp of the damping option:
+c     fileout itself when there is only one, else fileout with _d and
+c     the damping appended (e.g. out.rd50_d0.050).
+      subroutine DampFile ( fileout, damping, nDamp, filed )
+
+      character*(*) fileout, filed
+      real damping
+      integer nDamp
+      character*7 suffix
+
+      if ( nDamp .eq. 1 ) then
+        filed = fileout
+      else
+        write (suffix,'(''_d'',f5.3)') damping
+        filed = fileout(1:len_trim(fileout)) // suffix
+      endif
+
+      return
+      end
+
+c ----------------------------------------------------------------------
+c     Open an acceleration time series and read its header.  A file in
+c     the WCC binary layout (write_wccseis with bflag=1: 112 byte
+c     statdata header with nt and dt, then nt native float32 values) is
+c     recognized by its size and read as a stream, ignoring nhead.  Any
+c     other file is PEER format: nhead-1 header lines, then a line with
+c     npts and dt.  The file is left open on unit iu, positioned on the
+c     first value, for ReadPeerData.
+      subroutine ReadPeerHead ( fileacc, nhead, iu, npts, dt )
+
+      character*80 fileacc
+      integer nhead, iu, npts, i, ios
+      real dt
+      integer*8 nSize
+      integer*4 nt4
+      real*4 dt4
+      character*80 title
+
+      inquire (file=fileacc, size=nSize)
+      if ( nSize .ge. 112 ) then
+        open (newunit=iu,file=fileacc,status='old',access='stream',
+     1        form='unformatted')
+        read (iu,iostat=ios) title, nt4, dt4
+        if ( ios .eq. 0 .and. nt4 .gt. 0 .and.
+     1       nSize .eq. 112 + 4*int(nt4,8) ) then
+          npts = nt4
+          dt = dt4
+          read (iu,pos=113)
+          return
+        endif
+        close (iu)
+      endif
+
+      open (newunit=iu,file=fileacc,status='old')
+      do i=1,nhead-1
+        read (iu,*)
+      enddo
+      read (iu,*) npts, dt
+
+      return
+      end
+
+c ----------------------------------------------------------------------
+c     Read the npts values of the file opened by ReadPeerHead and close
+c     it.  The values of a binary file are read in one transfer.
+      subroutine ReadPeerData ( iu, acc, npts )
+
+      integer iu, npts, i
+      real acc(1)
+      character*12 acc0
+
+      inquire (unit=iu, access=acc0)
+      if ( acc0 .eq. 'STREAM' ) then
+        read (iu) (acc(i),i=1,npts)
+      else
+        read (iu,*) (acc(i),i=1,npts)
+      endif
+      close (iu)
+
+      return
+      end
+
+c ----------------------------------------------------------------------
+c     This subroutine computes the rotated peak responses of the pair
+c     acc1/acc2 for all nFreq oscillator frequencies w (rad/s): on
+c     return sa(1..180,k) holds, for frequency k, the peaks loaded by
+c     RotSa.  With nThreads > 1 the frequencies are split in contiguous
+c     blocks, one per thread, each with its own work arrays.  iPrec = 1
+c     runs the oscillators in single precision (see PeakRspMultiS).
+      subroutine RotDSa ( acc1, acc2, npts, dt, w, nFreq, damping,
+     1                    iRotMode, iPrec, nThreads, sa )
+
+      real acc1(1), acc2(1), dt, w(1), damping, sa(180,1)
+      integer npts, nFreq, iRotMode, iPrec, nThreads
+      integer nChunk, iChunk, k0, k1
+
+      nChunk = max( 1, min( nThreads, nFreq ) )
+!$omp parallel do if (nChunk .gt. 1) num_threads(nChunk)
+!$omp&  private(k0, k1) schedule(static,1)
+      do iChunk=1,nChunk
+        k0 = ((iChunk-1)*nFreq)/nChunk + 1
+        k1 = (iChunk*nFreq)/nChunk
+        call RotDSaRange ( acc1, acc2, npts, dt, w(k0), k1-k0+1,
+     1                     damping, iRotMode, iPrec, sa(1,k0) )
+      enddo
+!$omp end parallel do
+
+      return
+      end
+
+c ----------------------------------------------------------------------
+c     Rotated peak responses for the block of nFreq frequencies w.  The
+c     oscillator histories of all frequencies are computed together
+c     (see CandRspMulti); for each frequency only the points with
+c     amplitude on one component at least SaMin/1.5 are kept, and of
+c     those only the ones CandWindow cannot rule out are rotated.
+      subroutine RotDSaRange ( acc1, acc2, npts, dt, w, nFreq, damping,
+     1                         iRotMode, iPrec, sa )
+
+      real acc1(1), acc2(1), dt, w(1), damping, sa(180,1)
+      integer npts, nFreq, iRotMode, iPrec
+      integer nPoolMax, nPool, nMax, n, i, k
+      real*8, allocatable :: cf(:,:), d1(:), v1(:), d2(:), v2(:)
+      real, allocatable :: sa1(:), sa2(:), test(:), r1(:), r2(:)
+      real, allocatable :: pool1(:), pool2(:)
+      real, allocatable :: rsp1(:), rsp2(:), x(:), y(:)
+      real, allocatable :: cs(:,:), ws(:,:)
+      integer, allocatable :: iHead(:), iTail(:), iNext(:)
+      integer, allocatable :: iSort(:), iHull(:)
+
+      allocate ( cf(nFreq,9), d1(nFreq), v1(nFreq), d2(nFreq),
+     1           v2(nFreq) )
+      allocate ( sa1(nFreq), sa2(nFreq), test(nFreq), r1(nFreq),
+     1           r2(nFreq), iHead(nFreq), iTail(nFreq) )
+
+      call CoeffMulti ( w, nFreq, damping, dt, cf, nFreq )
+      if ( iPrec .eq. 1 ) then
+        allocate ( cs(nFreq,9), ws(nFreq,8) )
+        call CoeffMultiS ( cf, nFreq, nFreq, cs )
+        call PeakRspMultiS ( acc1, acc2, npts, nFreq, cs, nFreq,
+     1                       sa1, sa2, ws(1,1), ws(1,2), ws(1,3),
+     2                       ws(1,4), ws(1,5), ws(1,6), ws(1,7),
+     3                       ws(1,8) )
+      else
+        call PeakRspMulti ( acc1, acc2, npts, nFreq, cf, nFreq,
+     1                      sa1, sa2, d1, v1, d2, v2 )
+      endif
+      do k=1,nFreq
+        test(k) = amin1(sa1(k), sa2(k)) / 1.5
+      enddo
+
+c     Keep the points above test in the pool, growing it until they fit
+      nPoolMax = npts
+  10  allocate ( pool1(nPoolMax), pool2(nPoolMax), iNext(nPoolMax) )
+      if ( iPrec .eq. 1 ) then
+        call CandRspMultiS ( acc1, acc2, npts, nFreq, cs, nFreq, test,
+     1                       iHead, iNext, pool1, pool2, nPoolMax,
+     2                       nPool, ws(1,1), ws(1,2), ws(1,3),
+     3                       ws(1,4), ws(1,5), ws(1,6), ws(1,7),
+     4                       ws(1,8), r1, r2, iTail )
+      else
+        call CandRspMulti ( acc1, acc2, npts, nFreq, cf, nFreq, test,
+     1                      iHead, iNext, pool1, pool2, nPoolMax, nPool,
+     2                      d1, v1, d2, v2, r1, r2, iTail )
+      endif
+      if ( nPool .lt. 0 ) then
+        deallocate ( pool1, pool2, iNext )
+        nPoolMax = 2*nPoolMax
+        goto 10
+      endif
+
+c     Size the rotation work arrays for the longest chain
+      nMax = 1
+      do k=1,nFreq
+        n = 0
+        i = iHead(k)
+        do while ( i .gt. 0 )
+          n = n + 1
+          i = iNext(i)
+        enddo
+        nMax = max( nMax, n )
+      enddo
+      allocate ( rsp1(nMax), rsp2(nMax), x(nMax), y(nMax),
+     1           iSort(nMax), iHull(nMax+1) )
+
+      do k=1,nFreq
+        n = 0
+        i = iHead(k)
+        do while ( i .gt. 0 )
+          n = n + 1
+          rsp1(n) = pool1(i)
+          rsp2(n) = pool2(i)
+          i = iNext(i)
+        enddo
+        call CandWindow ( rsp1, rsp2, n, x )
+        call RotSa ( rsp1, rsp2, n, sa(1,k), iRotMode, x, y,
+     1               iSort, iHull )
+      enddo
+
+      return
+      end
+
+c ----------------------------------------------------------------------
+c     Drops the candidate points that cannot be the peak at any angle.
+c     The points (in time order) are split in windows of NWIN and the
+c     point of largest radius of each window, a local extremum of the
+c     trajectory, is rotated to all angles (same arithmetic as RotSa):
+c     the smallest of these peaks, saLow, is a lower bound of the peak
+c     at every angle.  A point with radius below saLow projects below
+c     saLow at every angle, so only the points at or above it (less a
+c     rounding margin) are kept, compacted in place.  r2 is a work
+c     array of length n.
+      subroutine CandWindow ( rsp1, rsp2, n, r2 )
+
+      real rsp1(1), rsp2(1), r2(1)
+      integer n
+      integer NWIN
+      parameter ( NWIN=32 )
+      integer i, i0, j, k, m, nSeed
+      real rotangle, cos1, sin1, saX, saY, x1, y1, saLow, r2Low
+      real, allocatable :: s1(:), s2(:)
+
+      if ( n .le. 2*NWIN ) return
+
+      do i=1,n
+        r2(i) = rsp1(i)*rsp1(i) + rsp2(i)*rsp2(i)
+      enddo
+
+c     One seed per window
+      allocate ( s1(n/NWIN+1), s2(n/NWIN+1) )
+      nSeed = 0
+      do i0=1,n,NWIN
+        k = i0
+        do i=i0+1,min(i0+NWIN-1,n)
+          if ( r2(i) .gt. r2(k) ) k = i
+        enddo
+        nSeed = nSeed + 1
+        s1(nSeed) = rsp1(k)
+        s2(nSeed) = rsp2(k)
+      enddo
+
+      saLow = 1E30
+      do j=1,90
+        rotangle = real(((j-1)*3.14159)/180.0)
+        cos1 = cos(rotangle)
+        sin1 = sin(rotangle)
+        saX = -1E30
+        saY = -1E30
+        do i=1,nSeed
+          x1 = abs(cos1*s1(i) - sin1*s2(i))
+          y1 = abs(sin1*s1(i) + cos1*s2(i))
+          if ( x1 .gt. saX ) saX = x1
+          if ( y1 .gt. saY ) saY = y1
+        enddo
+        saLow = amin1( saLow, saX, saY )
+      enddo
+
+      r2Low = (saLow*(1.-1.E-5))**2
+      m = 0
+      do i=1,n
+        if ( r2(i) .ge. r2Low ) then
+          m = m + 1
+          rsp1(m) = rsp1(i)
+          rsp2(m) = rsp2(i)
+        endif
+      enddo
+      n = m
+
+      return
+      end
+
+c ----------------------------------------------------------------------
+c     Percentiles of the n values in sa: on return rotDnn(i) is the
+c     pct(i) percentile, interpolated linearly between the ranked
+c     values, so 50 is the mean of the two middle values and 0 and 100
+c     are the smallest and largest.  The ranks are found by selection
+c     (SelectK) instead of a full sort; sa is reordered in place.
+c
+c     Note that sa(j+90) is the peak at angle j-1+90 degrees, not a
+c     copy of sa(j), so the 180 values of RotSa are all used.
+      subroutine SaPercentile ( sa, n, pct, nPct, rotDnn )
+
+      real sa(1), pct(1), rotDnn(1)
+      integer n, nPct, i, j, k
+      real pos, frac, lo, hi, SelectK
+
+      do i=1,nPct
+        pos = pct(i)/100. * (n-1) + 1.
+        k = min( max( int(pos), 1 ), n )
+        frac = pos - k
+        lo = SelectK ( sa, n, k )
+        if ( k .lt. n .and. frac .gt. 0. ) then
+c         After SelectK the next rank is the smallest value above k
+          hi = sa(k+1)
+          do j=k+2,n
+            if ( sa(j) .lt. hi ) hi = sa(j)
+          enddo
+          rotDnn(i) = (1.-frac)*lo + frac*hi
+        else
+          rotDnn(i) = lo
+        endif
+      enddo
+
+      return
+      end
+
+c ----------------------------------------------------------------------
+c     k-th smallest of the n values in a (Wirth's selection, O(n) on
+c     average).  On return a is reordered so that a(1..k-1) <= a(k) <=
+c     a(k+1..n).
+      real function SelectK ( a, n, k )
+
+      real a(1), x, t
+      integer n, k, i, j, l, m
+
+      l = 1
+      m = n
+      do while ( l .lt. m )
+        x = a(k)
+        i = l
+        j = m
+  10    do while ( a(i) .lt. x )
+          i = i + 1
+        enddo
+        do while ( x .lt. a(j) )
+          j = j - 1
+        enddo
+        if ( i .le. j ) then
+          t = a(i)
+          a(i) = a(j)
+          a(j) = t
+          i = i + 1
+          j = j - 1
+        endif
+        if ( i .le. j ) goto 10
+        if ( j .lt. k ) l = i
+        if ( k .lt. i ) m = j
+      enddo
+      SelectK = a(k)
+
+      return
+      end
+
+c ----------------------------------------------------------------------
+c     Convex hull of the points (px(i), py(i)), i=1..n, using Andrew's
+c     monotone chain.  The indices of the nHull hull vertices are
+c     returned in iHull (counter-clockwise, collinear points dropped).
+c     iSort is a work array of length n; iHull needs n+1 entries.
+      subroutine ConvHull ( px, py, n, iSort, iHull, nHull )
+
+      real px(1), py(1)
+      integer n, iSort(1), iHull(1), nHull
+      integer i, k, kLow, ip, i1, i2
+      real*8 cross
+
+      if ( n .le. 2 ) then
+        do i=1,n
+          iHull(i) = i
+        enddo
+        nHull = n
+        return
+      endif
+
+      call SortIndex2 ( n, px, py, iSort )
+
+c     Lower hull
+      k = 0
+      do i=1,n
+        ip = iSort(i)
+  10    if ( k .ge. 2 ) then
+          i1 = iHull(k-1)
+          i2 = iHull(k)
+          cross = dble(px(i2)-px(i1))*dble(py(ip)-py(i1))
+     1          - dble(py(i2)-py(i1))*dble(px(ip)-px(i1))
+          if ( cross .le. 0.d0 ) then
+            k = k - 1
+            goto 10
+          endif
+        endif
+        k = k + 1
+        iHull(k) = ip
+      enddo
+
+c     Upper hull
+      kLow = k + 1
+      do i=n-1,1,-1
+        ip = iSort(i)
+  20    if ( k .ge. kLow ) then
+          i1 = iHull(k-1)
+          i2 = iHull(k)
+          cross = dble(px(i2)-px(i1))*dble(py(ip)-py(i1))
+     1          - dble(py(i2)-py(i1))*dble(px(ip)-px(i1))
+          if ( cross .le. 0.d0 ) then
+            k = k - 1
+            goto 20
+          endif
+        endif
+        k = k + 1
+        iHull(k) = ip
+      enddo
+
+c     The last point is the first one again
+      nHull = k - 1
+
+      return
+      end
+
+c ----------------------------------------------------------------------
+c     Heapsort of the index array indx so that the points
+c     (px(indx(i)), py(indx(i))) are in increasing order of px, then py.
+      subroutine SortIndex2 ( n, px, py, indx )
+
+      real px(1), py(1)
+      integer n, indx(1)
+      integer i, j, l, ir, indxt
+      real qx, qy
+      logical jLess
+
+      do j=1,n
+        indx(j) = j
+      enddo
+      if ( n .lt. 2 ) return
+
+      l = n/2 + 1
+      ir = n
+  10  if ( l .gt. 1 ) then
+        l = l - 1
+        indxt = indx(l)
+      else
+        indxt = indx(ir)
+        indx(ir) = indx(1)
+        ir = ir - 1
+        if ( ir .eq. 1 ) then
+          indx(1) = indxt
+          return
+        endif
+      endif
+      qx = px(indxt)
+      qy = py(indxt)
+      i = l
+      j = l + l
+  20  if ( j .le. ir ) then
+        if ( j .lt. ir ) then
+          jLess = px(indx(j)) .lt. px(indx(j+1)) .or.
+     1            ( px(indx(j)) .eq. px(indx(j+1)) .and.
+     2              py(indx(j)) .lt. py(indx(j+1)) )
+          if ( jLess ) j = j + 1
+        endif
+        if ( qx .lt. px(indx(j)) .or.
+     1       ( qx .eq. px(indx(j)) .and. qy .lt. py(indx(j)) ) ) then
+          indx(i) = indx(j)
+          i = j
+          j = j + j
+        else
+          j = ir + 1
+        endif
+        goto 20
+      endif
+      indx(i) = indxt
+      goto 10
+
+      end
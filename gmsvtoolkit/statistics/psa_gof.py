@@ -38,7 +38,10 @@ from __future__ import division, print_function
 import os
 import sys
 import glob
+import struct
 import argparse
+import multiprocessing
+from multiprocessing.pool import ThreadPool
 
 # Import GMSV Toolkit functions
 from core import gmsvtoolkit_config
@@ -46,9 +49,72 @@ from core.station_list import StationList
 from utils.file_utilities import read_rdxx
 from utils.src_utilities import parse_src_file
 from utils import os_utilities
+from utils import result_cache
+from utils import gmsvlib
+from utils import fault_utilities
 
-# Import Pynga and its utilities
-import pynga.utils as putils
+def station_resid_line(job):
+    """
+    Computes Rrup (unless the job has it) and finds the observed and
+    simulated files for one station, returns (statlist line, None) or
+    (None, error message). Runs in the worker processes of PSAGoF.run,
+    so it must not exit
+    """
+    (station_name, station_lon, station_lat, vs30, low_freq_corner,
+     high_freq_corner, src_keys, obs_dir, sims_dir, extension, rrup) = job
+
+    # Calculate Rrup, with pynga when libgmsv did not do all the
+    # stations at once
+    if rrup is None:
+        # Pynga is only needed here, it is imported on the first
+        # station rather than when the module is loaded
+        import pynga.utils as putils
+
+        origin = (src_keys['lon_top_center'],
+                  src_keys['lat_top_center'])
+        dims = (src_keys['fault_length'], src_keys['dlen'],
+                src_keys['fault_width'], src_keys['dwid'],
+                src_keys['depth_to_top'])
+        mech = (src_keys['strike'], src_keys['dip'],
+                src_keys['rake'])
+
+        site_geom = [station_lon, station_lat, 0.0]
+        (fault_trace1, up_seis_depth,
+         low_seis_depth, ave_dip,
+         dummy1, dummy2) = putils.FaultTraceGen(origin, dims, mech)
+        _, rrup, _ = putils.DistanceToSimpleFaultSurface(site_geom,
+                                                         fault_trace1,
+                                                         up_seis_depth,
+                                                         low_seis_depth,
+                                                         ave_dip)
+
+    # Find input files for observed and simulated data
+    obs_files = glob.glob("%s%s*%s*.%s" %
+                          (obs_dir, os.sep,
+                           station_name, extension))
+    if len(obs_files) != 1:
+        return None, ("Can't find observation file for station %s" %
+                      (station_name))
+    obs_file = obs_files[0]
+
+    sim_files = glob.glob("%s%s*%s*.%s" %
+                          (sims_dir, os.sep,
+                           station_name, extension))
+    if len(sim_files) != 1:
+        return None, ("Can't find simulation file for station %s" %
+                      (station_name))
+    sim_file = sim_files[0]
+
+    return ("%s %.4f %.4f %d %.2f %f %f %s %s\n" %
+            (station_name, station_lon, station_lat,
+             vs30, rrup, low_freq_corner, high_freq_corner,
+             obs_file, sim_file)), None
+
+def run_summary(cmd):
+    """
+    Runs one resid2uncer_varN command, for the ThreadPool in PSAGoF.run
+    """
+    return os_utilities.runprog(cmd, abort_on_error=True, print_cmd=False)
 
 class PSAGoF(object):
 
@@ -57,11 +123,13 @@ class PSAGoF(object):
         self.src_keys = None
         self.min_cdst = 0
         self.max_cutoff = None
+        self.resid_key = None
 
-    def parse_arguments(self):
+    def parse_arguments(self, argv=None):
         """
         This function takes care of parsing the command-line arguments and
-        asking the user for any missing parameters that we need
+        asking the user for any missing parameters that we need, from
+        argv (sys.argv[1:] if None)
         """
         parser = argparse.ArgumentParser(description="Generates PSA comparison "
                                          " files needed to create PSA GoF.")
@@ -88,18 +156,71 @@ class PSAGoF(object):
                             help="select RotD50 comparison (default)")
         parser.add_argument("--max-cutoff", dest="max_cutoff", type=float, default=1000.0,
                             help="select max cutoff distance (km) for the comparison")
-        args = parser.parse_args()
+        parser.add_argument("--dist-bins", dest="dist_bins",
+                            help="comma-separated distance bin edges (km) for "
+                            "additional per-bin GoF files")
+        parser.add_argument("--jobs", "-j", dest="jobs", type=int,
+                            default=multiprocessing.cpu_count(),
+                            help="number of parallel processes (default: "
+                            "number of CPUs)")
+        args = parser.parse_args(argv)
 
         return args
         
-    def run(self):
+    def cached_residuals(self, resid_lines, options, outfile, binfile):
+        """
+        Looks the residual tables up in the result cache, keyed on the
+        contents of the observed and simulated files of each station
+        rather than on their names, which do not appear in the tables,
+        and on options, the other gen_resid_tbl_batch parameters. On a hit writes outfile and binfile and returns True
+        """
+        self.resid_key = None
+        cache = result_cache.get_cache()
+        if cache is None:
+            return False
+        stations = []
+        for line in resid_lines:
+            tokens = line.split()
+            stations.append(tokens[0:7] +
+                            [result_cache.file_digest(tokens[7]),
+                             result_cache.file_digest(tokens[8])])
+        self.resid_key = result_cache.make_key("gen_resid_tbl_batch",
+                                               stations, options)
+        result = cache.get(self.resid_key)
+        if result is None or len(result) < 16:
+            return False
+        text_len, bin_len = struct.unpack("<QQ", result[0:16])
+        if len(result) != 16 + text_len + bin_len:
+            return False
+        with open(outfile, 'wb') as output_file:
+            output_file.write(result[16:16 + text_len])
+        with open(binfile, 'wb') as output_file:
+            output_file.write(result[16 + text_len:])
+        return True
+
+    def cache_residuals(self, outfile, binfile):
+        """
+        Stores the tables gen_resid_tbl_batch wrote under the key of
+        cached_residuals
+        """
+        if self.resid_key is None:
+            return
+        with open(outfile, 'rb') as input_file:
+            text = input_file.read()
+        with open(binfile, 'rb') as input_file:
+            data = input_file.read()
+        result_cache.get_cache().put(self.resid_key,
+                                     struct.pack("<QQ", len(text), len(data)) +
+                                     text + data)
+
+    def run(self, argv=None):
         """
         Run PSAGoF module
         """
         install = gmsvtoolkit_config.GMSVToolKitConfig.get_instance()
 
         # Parse command-line options
-        args = self.parse_arguments()
+        args = self.parse_arguments(argv)
 
         # Check input parameters
         if not args.src_file:
@@ -140,95 +261,106 @@ class PSAGoF(object):
         self.src_keys = parse_src_file(args.src_file)
         stations = StationList(args.station_list)
         station_list = stations.get_station_list()
-        print_header = 1
 
         # Select output file
         outfile = os.path.join(output_dir, "%s.%s-resid.txt" %
                                (args.comp_label, extension))
         if os.path.exists(outfile):
             os.remove(outfile)
+        binfile = os.path.join(output_dir, "%s.%s-resid.bin" %
+                               (args.comp_label, extension))
+        residlist = os.path.join(output_dir, "%s.%s-resid.list" %
+                                 (args.comp_label, extension))
 
-        # Loop through stations
-        for station in station_list:
-            station_name = station.scode
-            station_lon = float(station.lon)
-            station_lat = float(station.lat)
-
-            # Calculate Rrup
-            origin = (self.src_keys['lon_top_center'],
-                      self.src_keys['lat_top_center'])
-            dims = (self.src_keys['fault_length'], self.src_keys['dlen'],
-                    self.src_keys['fault_width'], self.src_keys['dwid'],
-                    self.src_keys['depth_to_top'])
-            mech = (self.src_keys['strike'], self.src_keys['dip'],
-                    self.src_keys['rake'])
-
-            site_geom = [station_lon, station_lat, 0.0]
-            (fault_trace1, up_seis_depth,
-             low_seis_depth, ave_dip,
-             dummy1, dummy2) = putils.FaultTraceGen(origin, dims, mech)
-            _, rrup, _ = putils.DistanceToSimpleFaultSurface(site_geom,
-                                                             fault_trace1,
-                                                             up_seis_depth,
-                                                             low_seis_depth,
-                                                             ave_dip)
-
-            # Find input files for observed and simulated data
-            obs_files = glob.glob("%s%s*%s*.%s" %
-                                   (args.obs_dir, os.sep,
-                                    station_name, extension))
-            if len(obs_files) != 1:
-                print("[ERROR]: Can't find observation file for station %s" % (station_name))
-                sys.exit(1)
-            obs_file = obs_files[0]
+        # Rrup of all the stations in one libgmsv call, or per
+        # station with pynga in station_resid_line without it
+        rrups = [None] * len(station_list)
+        if gmsvlib.load_library() is not None:
+            rects = fault_utilities.fault_rects_from_src(self.src_keys)
+            rrups, _, _ = fault_utilities.calculate_fault_distances(rects,
+                [float(station.lon) for station in station_list],
+                [float(station.lat) for station in station_list],
+                max(1, args.jobs))
 
-            sim_files = glob.glob("%s%s*%s*.%s" %
-                                   (args.sims_dir, os.sep,
-                                    station_name, extension))
-            if len(sim_files) != 1:
-                print("[ERROR]: Can't find simulation file for station %s" % (station_name))
+        # Collect one statlist line per station, the pool returns them
+        # in station order so the list does not depend on the timing
+        jobs = [(station.scode, float(station.lon), float(station.lat),
+                 int(station.vs30), float(station.low_freq_corner),
+                 float(station.high_freq_corner), self.src_keys,
+                 args.obs_dir, args.sims_dir, extension, rrup)
+                for station, rrup in zip(station_list, rrups)]
+        num_procs = max(1, min(args.jobs, len(jobs)))
+        if num_procs > 1:
+            pool = multiprocessing.Pool(num_procs)
+            results = pool.map(station_resid_line, jobs,
+                               chunksize=max(1, len(jobs) // (4 * num_procs)))
+            pool.close()
+            pool.join()
+        else:
+            results = [station_resid_line(job) for job in jobs]
+        resid_lines = []
+        for line, error in results:
+            if error is not None:
+                print("[ERROR]: %s" % (error))
                 sys.exit(1)
-            sim_file = sim_files[0]
-
-            os_utilities.check_path_lengths([obs_file, sim_file, outfile],
-                                            os_utilities.GP_MAX_FILENAME)
-
-            # Calculate residuals
-            cmd = ("%s bbp_format=1 " %
-                   (os.path.join(install.GP_BIN_DIR, "gen_resid_tbl_3comp")) +
-                   "datafile1=%s simfile1=%s " % (obs_file, sim_file) +
-                   "comp1=%s comp2=%s comp3=%s " % (comps[0], comps[1], comps[2]) +
-                   "eqname=%s mag=%s stat=%s lon=%.4f lat=%.4f " %
-                   (args.comp_label.split("-")[0], self.src_keys['magnitude'],
-                    station_name, station_lon, station_lat) +
-                   "vs30=%d cd=%.2f " % (int(station.vs30), rrup) +
-                   "flo=%f fhi=%f " % (float(station.low_freq_corner),
-                                       float(station.high_freq_corner)) +
-                   "print_header=%d >> %s 2>> /dev/null" %
-                   (print_header, outfile))
-            os_utilities.runprog(cmd, abort_on_error=True, print_cmd=False)
+            resid_lines.append(line)
+
+        with open(residlist, 'w') as list_file:
+            list_file.writelines(resid_lines)
+        os_utilities.check_path_lengths([residlist, outfile, binfile],
+                                        os_utilities.GP_MAX_FILENAME)
 
-            # Only print header the first time
-            if print_header == 1:
-                print_header = 0
-
-        # Now summarize the results
-        for comp in comps:
-            # Build paths and check lengths
-            fileroot = os.path.join(output_dir, "%s_r%d-%d-%s-%s" %
-                                    (args.comp_label, self.min_cdst,
-                                     self.max_cutoff, extension, comp))
-            os_utilities.check_path_lengths([outfile, fileroot],
-                                            os_utilities.GP_MAX_FILENAME)
-
-            cmd = ("%s " % (os.path.join(install.GP_BIN_DIR, "resid2uncer_varN")) +
-                   "residfile=%s fileroot=%s " % (outfile, fileroot) +
-                   "comp=%s nstat=%d nper=63 " % (comp, len(station_list)) +
-                   "min_cdst=%d max_cdst=%d >> /dev/null 2>&1" %
-                   (self.min_cdst, self.max_cutoff))
+        # Calculate residuals for all stations in a single run
+        cmd = ("%s statlist=%s outfile=%s binfile=%s " %
+               (os.path.join(install.GP_BIN_DIR, "gen_resid_tbl_batch"),
+                residlist, outfile, binfile) +
+               "comp1=%s comp2=%s comp3=%s " % (comps[0], comps[1], comps[2]) +
+               "eqname=%s mag=%s " % (args.comp_label.split("-")[0],
+                                      self.src_keys['magnitude']) +
+               "print_header=1 nthreads=%d 2>> /dev/null" %
+               (max(1, args.jobs)))
+        options = comps + [args.comp_label.split("-")[0],
+                           str(self.src_keys['magnitude'])]
+        if not self.cached_residuals(resid_lines, options, outfile, binfile):
             os_utilities.runprog(cmd, abort_on_error=True, print_cmd=False)
+            self.cache_residuals(outfile, binfile)
+        os.remove(residlist)
+
+        # Now summarize the results, all components in a single pass
+        fileroot = os.path.join(output_dir, "%s_r%d-%d-%s" %
+                                (args.comp_label, self.min_cdst,
+                                 self.max_cutoff, extension))
+        os_utilities.check_path_lengths([binfile, "%s-%s" %
+                                         (fileroot, max(comps, key=len))],
+                                        os_utilities.GP_MAX_FILENAME)
+
+        cmds = [("%s " % (os.path.join(install.GP_BIN_DIR, "resid2uncer_varN")) +
+                 "residfile=%s fileroot=%s " % (binfile, fileroot) +
+                 "comps=%s nstat=%d nper=63 " % (",".join(comps), len(station_list)) +
+                 "min_cdst=%d max_cdst=%d >> /dev/null 2>&1" %
+                 (self.min_cdst, self.max_cutoff))]
+
+        # Distance-binned results, all bins in the same pass
+        if args.dist_bins:
+            edges = [float(edge) for edge in args.dist_bins.split(",")]
+            fileroot = os.path.join(output_dir, args.comp_label)
+            cmds.append("%s " % (os.path.join(install.GP_BIN_DIR, "resid2uncer_varN")) +
+                        "residfile=%s fileroot=%s " % (binfile, fileroot) +
+                        "comps=%s nper=63 " % (",".join(comps)) +
+                        "bin_var=cdst bins=%s suffix=%s " %
+                        (",".join(["%g" % (edge) for edge in edges]), extension) +
+                        ">> /dev/null 2>&1")
+
+        # The summaries write different files, run them side by side
+        if len(cmds) > 1 and args.jobs > 1:
+            pool = ThreadPool(len(cmds))
+            pool.map(run_summary, cmds)
+            pool.close()
+            pool.join()
+        else:
+            for cmd in cmds:
+                run_summary(cmd)
 
 if __name__ == '__main__':
     print("Running module: %s" % (os.path.basename(sys.argv[0])))
-    ME = PSAGoF()
-    ME.run()
+    os_utilities.run_entry_point(lambda argv: PSAGoF().run(argv))
@@ -45,6 +45,7 @@ import tempfile
 from core import gmsvtoolkit_config
 from core import exceptions
 from utils import os_utilities
+from utils import gmsvlib
 from utils import srf_utilities
 from utils import src_utilities
 from core.station_list import StationList
@@ -88,7 +89,8 @@ def calculate_epicenter(input_file):
     """
     This function returns the epicenter of an event using either a SRC
     file or a SRF file to look for the hypocenter location. It uses
-    Rob Graves' xy2ll utility to convert the coordinates to lat/lon.
+    Rob Graves' xy2ll projection (in libgmsv, or the xy2ll utility)
+    to convert the coordinates to lat/lon.
     """
     # If we have a SRF file, we already have a function that does this
     if input_file.endswith(".srf"):
@@ -147,6 +149,15 @@ def calculate_epicenter(input_file):
     # Ok, we have all the parameters that we need!
     hypo_perpendicular_strike = hypo_down_dip * math.cos(math.radians(dip))
 
+    if gmsvlib.load_library() is not None:
+        # Rounded as on the xy2ll command line and output below
+        lon, lat = gmsvlib.xy2ll([float("%f" % (hypo_along_strike))],
+                                 [float("%f" % (hypo_perpendicular_strike))],
+                                 float("%f" % (lon_top_center)),
+                                 float("%f" % (lat_top_center)),
+                                 float("%f" % (strike)))
+        return float("%.6f" % (lon[0])), float("%.6f" % (lat[0]))
+
     # Now call xy2ll program to convert it to lat/long
     # Create temp directory to avoid any race conditions
     tmpdir = tempfile.mkdtemp(prefix="bbp-")
@@ -167,6 +178,45 @@ def calculate_epicenter(input_file):
     # Return calculated lon/lat
     return src_hypo[0], src_hypo[1]
 
+def fault_rects_from_src(src_keys):
+    """
+    The fault of the SRC parameters src_keys (parse_src_file) as the
+    one rectangle of gmsvlib.fault_dist
+    """
+    return [gmsvlib.fault_plane(float(src_keys['lon_top_center']),
+                                float(src_keys['lat_top_center']),
+                                float(src_keys['depth_to_top']),
+                                float(src_keys['fault_length']),
+                                float(src_keys['fault_width']),
+                                float(src_keys['strike']),
+                                float(src_keys['dip']))]
+
+def fault_rects_from_srf(srf_file):
+    """
+    The subfaults of srf_file as the rectangles of gmsvlib.fault_dist,
+    centered on the points with the strike, dip and subfault size of
+    their segment's PLANE; None without libgmsv
+    """
+    lib_srf = srf_utilities.open_srf(srf_file)
+    if lib_srf is None:
+        return None
+    rects = []
+    for segment in range(0, lib_srf.num_segments()):
+        plane = lib_srf.plane(segment)
+        dlen = plane["len"] / max(1, plane["nstk"])
+        dwid = plane["wid"] / max(1, plane["ndip"])
+        for lon, lat, dep in lib_srf.points(segment):
+            rects.append([lon, lat, dep, plane["stk"], plane["dip"],
+                          dlen, dwid, segment])
+    return rects
+
+def calculate_fault_distances(rects, lons, lats, nthreads=1):
+    """
+    Rrup, Rjb and Rx (km) of all the stations lons, lats to the fault
+    rectangles rects in one libgmsv call, three lists
+    """
+    return gmsvlib.fault_dist(rects, lons, lats, nthreads)
+
 def write_simple_stations(station_file, out_file):
     """
     This function parses the station file and writes a simple
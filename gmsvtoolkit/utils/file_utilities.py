@@ -38,7 +38,96 @@ from __future__ import division, print_function, absolute_import
 # Import Python modules
 import os
 import sys
-import numpy as np
+import mmap
+import struct
+import threading
+
+# NumPy is imported by the functions that need it, not here, so the
+# modules that only use cached_read (station lists, say) and the
+# entry points that never read a table start without it
+
+# Residual table columns, see GoodFit/resid_bin.c for the binary layout
+RESID_META_COLUMNS = ["EQ", "Mag", "stat", "lon", "lat", "stat_seq_no",
+                      "Vs30", "close_dist", "Xcos", "Ycos", "T_min",
+                      "T_max", "comp"]
+RESID_BIN_MAGIC = b"GFRESID1"
+RESID_BIN_HEADER = "=8s8i"
+
+# Parsed files are kept here, keyed on their absolute path, and
+# dropped when the file's mtime or size changes. The lock makes the
+# cache safe to share between the threads of a plot or GoF run.
+READ_CACHE_MAX_FILES = 64
+_READ_CACHE = {}
+_READ_CACHE_LOCK = threading.Lock()
+
+def cached_read(filename, parser):
+    """
+    Returns parser(filename), re-using the result of an earlier call
+    for the same file and parser as long as the file has not been
+    modified since. The result is shared, so callers must not modify it
+    """
+    filename = os.path.abspath(filename)
+    stat = os.stat(filename)
+    key = (filename, parser)
+    stamp = (stat.st_mtime_ns, stat.st_size)
+    with _READ_CACHE_LOCK:
+        entry = _READ_CACHE.get(key, None)
+    if entry is not None and entry[0] == stamp:
+        return entry[1]
+
+    # Parse outside the lock, two threads asking for the same new file
+    # at the same time parse it twice but get the same result
+    value = parser(filename)
+    with _READ_CACHE_LOCK:
+        _READ_CACHE.pop(key, None)
+        while len(_READ_CACHE) >= READ_CACHE_MAX_FILES:
+            # Dictionaries keep insertion order, drop the oldest entry
+            _READ_CACHE.pop(next(iter(_READ_CACHE)))
+        _READ_CACHE[key] = (stamp, value)
+    return value
+
+def parse_numeric_table(filename):
+    """
+    Parses a whitespace separated numeric table (BBP, RotDXX, GoF
+    output), skipping blank lines and lines starting with # or %,
+    and trimming in-line comments. Rows longer than the shortest one
+    are truncated. Returns a 2D array with one row per data line
+    """
+    import numpy as np
+
+    with open(filename, 'rb') as input_file:
+        if os.fstat(input_file.fileno()).st_size == 0:
+            return np.zeros((0, 0))
+        # Lines are read one at a time straight from the mapping, the
+        # file is never copied as a whole
+        data = mmap.mmap(input_file.fileno(), 0, access=mmap.ACCESS_READ)
+        rows = []
+        try:
+            for line in iter(data.readline, b''):
+                line = line.strip()
+                if (not line or line.startswith(b'#') or
+                        line.startswith(b'%')):
+                    continue
+                for mark in (b'#', b'%'):
+                    if line.find(mark) > 0:
+                        line = line[:line.find(mark)]
+                rows.append(line.split())
+        finally:
+            data.close()
+
+    if not rows:
+        return np.zeros((0, 0))
+    num_cols = min([len(row) for row in rows])
+    table = np.array([[float(item) for item in row[0:num_cols]]
+                      for row in rows])
+    table.flags.writeable = False
+    return table
+
+def read_numeric_table(filename):
+    """
+    Cached parse_numeric_table, the returned array is read-only
+    """
+    return cached_read(filename, parse_numeric_table)
 
 def peer_get_num_lines(input_file):
     """
@@ -61,56 +150,27 @@ def bbp_get_num_samples(input_file):
     """
     Read the number of samples from a BBP file
     """
-    num_samples = 0
-
     try:
-        ifile = open(input_file)
-        for line in ifile:
-            line = line.strip()
-            if not line:
-                continue
-            # Skip comments
-            if line.startswith("#") or line.startswith("%"):
-                continue
-            num_samples = num_samples + 1
-        ifile.close()
+        table = read_numeric_table(input_file)
     except OSError as e:
         print("[ERROR]: error reading bbp file: %s" % (e.filename))
         sys.exit(1)
 
-    return num_samples
+    return table.shape[0]
 
 def bbp_get_dt(input_file):
     """
     Read timeseries file and return dt
     """
-    val1 = None
-    val2 = None
-    file_dt = None
-
-    # Figure out dt first, we need it later
-    ifile = open(input_file)
-    for line in ifile:
-        # Skip comments
-        if line.startswith("#") or line.startswith("%"):
-            continue
-        pieces = line.split()
-        pieces = [float(piece) for piece in pieces]
-        if val1 is None:
-            val1 = pieces[0]
-            continue
-        if val2 is None:
-            val2 = pieces[0]
-            break
-    ifile.close()
+    table = read_numeric_table(input_file)
 
     # Quit if cannot figure out dt
-    if val1 is None or val2 is None:
+    if table.shape[0] < 2:
         print("[ERROR]: Cannot determine dt from file! Exiting...")
         sys.exit(1)
 
     # Return dt
-    return val2 - val1
+    return table[1, 0] - table[0, 0]
 # end get_dt
 
 def read_file_bbp2(filename):
@@ -118,40 +178,24 @@ def read_file_bbp2(filename):
     This function reads a bbp file and returns the timeseries in the
     format time, h1, h2, up tuple
     """
-    time = []
-    h1_comp = []
-    h2_comp = []
-    ud_comp = []
+    import numpy as np
 
     try:
-        input_file = open(filename, 'r')
-        for line in input_file:
-            line = line.strip()
-            if line.startswith('#') or line.startswith('%'):
-                # Skip comments
-                continue
-            # Trim in-line comments
-            if line.find('#') > 0:
-                line = line[:line.find('#')]
-            if line.find('%') > 0:
-                line = line[:line.find('%')]
-            # Make them float
-            pieces = line.split()
-            pieces = [float(piece) for piece in pieces]
-            time.append(pieces[0])
-            h1_comp.append(pieces[1])
-            h2_comp.append(pieces[2])
-            ud_comp.append(pieces[3])
-        input_file.close()
+        table = read_numeric_table(filename)
     except OSError as e:
         print("[ERROR]: error reading bbp file: %s" % (e.filename))
         sys.exit(1)
+    if not table.shape[0]:
+        return np.array([]), np.array([]), np.array([]), np.array([])
+    if table.shape[1] < 4:
+        print("[ERROR]: bbp file %s has less than 4 columns" % (filename))
+        sys.exit(1)
 
-    # Convert to NumPy Arrays
-    time = np.array(time)
-    h1_comp = np.array(h1_comp)
-    h2_comp = np.array(h2_comp)
-    ud_comp = np.array(ud_comp)
+    # Copies, the caller may modify them
+    time = np.array(table[:, 0])
+    h1_comp = np.array(table[:, 1])
+    h2_comp = np.array(table[:, 2])
+    ud_comp = np.array(table[:, 3])
 
     # All done!
     return time, h1_comp, h2_comp, ud_comp
@@ -169,23 +213,121 @@ def read_rdxx(input_rdxx_file):
         comp2 - array with second component from the file
         comp3 - array with third component from the file
     """
-    periods = []
-    comp1 = []
-    comp2 = []
-    comp3 = []
-    input_file = open(input_rdxx_file, 'r')
-    for line in input_file:
-        line = line.strip()
-        if not line:
-            continue
-        if line.startswith("#"):
-            continue
-        items = line.split()
-        items = [float(item) for item in items]
-        periods.append(items[0])
-        comp1.append(items[1])
-        comp2.append(items[2])
-        comp3.append(items[3])
+    import numpy as np
+
+    table = read_numeric_table(input_rdxx_file)
+    if not table.shape[0]:
+        return np.array([]), np.array([]), np.array([]), np.array([])
+
+    return (np.array(table[:, 0]), np.array(table[:, 1]),
+            np.array(table[:, 2]), np.array(table[:, 3]))
+
+def get_resid_file(input_dir, comp_label, extension):
+    """
+    Returns the residual table for comp_label, preferring the binary
+    (-resid.bin) table over the text one (-resid.txt) when both exist
+    """
+    resid_file = os.path.join(input_dir, "%s.%s-resid.bin" %
+                              (comp_label, extension))
+    if not os.path.exists(resid_file):
+        resid_file = os.path.join(input_dir, "%s.%s-resid.txt" %
+                                  (comp_label, extension))
+    return resid_file
+
+def parse_resid_text(filename):
+    """
+    Parses a text residual table in one pass into its header periods,
+    one tuple of strings per metadata column and a read-only array
+    with one column of residuals per period
+    """
+    import numpy as np
+
+    rows = []
+    with open(filename, 'r') as input_file:
+        items = input_file.readline().split()
+        for line in input_file:
+            line = line.split()
+            if line:
+                rows.append(line)
+    nmeta = len(RESID_META_COLUMNS)
+    periods = [float(item) for item in items[nmeta:]]
+    meta = list(zip(*[row[0:nmeta] for row in rows]))
+    if not meta:
+        meta = [()] * nmeta
+    values = np.array([[float(item) for item in row[nmeta:nmeta + len(periods)]]
+                       for row in rows]).reshape(len(rows), len(periods))
+    values.flags.writeable = False
+    return periods, meta, values
+
+def read_resid_periods(resid_file, columns, periods):
+    """
+    Reads the requested metadata columns, and the residuals for a list
+    of periods, from a residual table written by gen_resid_tbl* (text)
+    or gen_resid_tbl_batch binfile= (binary). The text table is parsed
+    once (and kept, see cached_read) for all periods and callers, with
+    the binary table only the requested columns are read from disk.
+
+    Inputs:
+        resid_file - residual table filename
+        columns - list of metadata column names (see RESID_META_COLUMNS)
+        periods - list of periods to return residuals for
+    Outputs:
+        meta - dictionary with a list of strings for each column
+        values - list with an array of residuals for each period, None
+                 if the table does not have that period
+    """
+    import numpy as np
+
+    col_idx = [RESID_META_COLUMNS.index(column) for column in columns]
+    meta = {}
+    values = [None] * len(periods)
+
+    input_file = open(resid_file, 'rb')
+    header_size = struct.calcsize(RESID_BIN_HEADER)
+    header = input_file.read(header_size)
+    if len(header) == header_size and header[0:8] == RESID_BIN_MAGIC:
+        (_, nrow, nper, nmeta,
+         mwidth, _, _, _, _) = struct.unpack(RESID_BIN_HEADER, header)
+        if nmeta != len(RESID_META_COLUMNS) or nrow < 0 or nper < 0:
+            input_file.close()
+            raise ValueError("%s: bad residual table header" % (resid_file))
+        table_periods = np.fromfile(input_file, dtype=np.float32, count=nper)
+        # Periods are matched as printed in the text table
+        table_periods = [float("%.5e" % (val)) for val in table_periods]
+        meta_offset = header_size + 4 * nper
+        for column, idx in zip(columns, col_idx):
+            input_file.seek(meta_offset + idx * nrow * mwidth)
+            data = np.fromfile(input_file, dtype="S%d" % (mwidth), count=nrow)
+            meta[column] = [item.decode() for item in data]
+        for pidx, period in enumerate(periods):
+            if period not in table_periods:
+                continue
+            input_file.seek(meta_offset + nmeta * nrow * mwidth +
+                            4 * table_periods.index(period) * nrow)
+            values[pidx] = np.fromfile(input_file, dtype=np.float32,
+                                       count=nrow).astype(float)
+        input_file.close()
+        return meta, values
     input_file.close()
 
-    return np.array(periods), np.array(comp1), np.array(comp2), np.array(comp3)
+    # Text table, header line has the periods after the metadata
+    table_periods, table_meta, table_values = cached_read(resid_file,
+                                                          parse_resid_text)
+    for column, idx in zip(columns, col_idx):
+        meta[column] = list(table_meta[idx])
+    for pidx, period in enumerate(periods):
+        if period in table_periods:
+            values[pidx] = table_values[:, table_periods.index(period)].copy()
+
+    return meta, values
+
+def read_resid_table(resid_file, columns, period=None):
+    """
+    Same as read_resid_periods, for a single period (or None for no
+    residuals), values is None if the table does not have this period
+    """
+    if period is None:
+        meta, _ = read_resid_periods(resid_file, columns, [])
+        return meta, None
+    meta, values = read_resid_periods(resid_file, columns, [period])
+    return meta, values[0]
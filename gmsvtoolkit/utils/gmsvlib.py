@@ -0,0 +1,558 @@
+#!/usr/bin/env python
+"""
+BSD 3-Clause License
+
+Copyright (c) 2022, University of Southern California
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+Python binding to libgmsv (src/gp/WccFormat/gmsvlib.h), running the
+wcc_pipeline stages, the WCC I/O, the GoodFit residuals, rotd, the
+ModelCords projection and fault distances in this process instead of
+one program per trace (or point). float32 NumPy arrays
+are handed to the library as they are (run_stages_array)
+"""
+from __future__ import division, print_function
+
+# Import Python modules
+import os
+import ctypes
+
+# NumPy is imported by the functions working on arrays, loading the
+# library (rotdlib, srf_utilities) does not need it
+
+# Import GMSVToolkit modules
+from core import gmsvtoolkit_config
+
+# Must match GMSV_ABI_VERSION of gmsvlib.h
+GMSV_ABI_VERSION = 1
+
+# Loaded library, False if we already tried and it is not there
+GMSV_LIB = None
+
+class Header(ctypes.Structure):
+    """
+    struct gmsv_header, the header of a WCC trace
+    """
+    _fields_ = [("stat", ctypes.c_char * 12),
+                ("comp", ctypes.c_char * 4),
+                ("stitle", ctypes.c_char * 64),
+                ("nt", ctypes.c_int),
+                ("dt", ctypes.c_float),
+                ("hr", ctypes.c_int),
+                ("min", ctypes.c_int),
+                ("sec", ctypes.c_float),
+                ("edist", ctypes.c_float),
+                ("az", ctypes.c_float),
+                ("baz", ctypes.c_float)]
+
+class SrfPlane(ctypes.Structure):
+    """
+    struct gmsv_srf_plane, a segment of the PLANE block of an SRF
+    """
+    _fields_ = [("elon", ctypes.c_float),
+                ("elat", ctypes.c_float),
+                ("nstk", ctypes.c_int),
+                ("ndip", ctypes.c_int),
+                ("len", ctypes.c_float),
+                ("wid", ctypes.c_float),
+                ("stk", ctypes.c_float),
+                ("dip", ctypes.c_float),
+                ("dtop", ctypes.c_float),
+                ("shyp", ctypes.c_float),
+                ("dhyp", ctypes.c_float),
+                ("npts", ctypes.c_int)]
+
+def make_header(nt, dt, stat="", comp="", stitle=""):
+    """
+    Returns a Header for nt samples at time step dt
+    """
+    header = Header()
+    header.stat = stat.encode()[0:11]
+    header.comp = comp.encode()[0:3]
+    header.stitle = stitle.encode()[0:63]
+    header.nt = nt
+    header.dt = dt
+    return header
+
+def load_library():
+    """
+    Returns the libgmsv library, or None if it has not been built or
+    was built for another ABI version
+    """
+    global GMSV_LIB
+    if GMSV_LIB is None:
+        install = gmsvtoolkit_config.GMSVToolKitConfig.get_instance()
+        lib_file = os.path.join(install.GP_BIN_DIR,
+                                "libgmsv.so.%d" % (GMSV_ABI_VERSION))
+        GMSV_LIB = False
+        if os.path.exists(lib_file):
+            lib = ctypes.CDLL(lib_file)
+            lib.gmsv_abi_version.restype = ctypes.c_int
+            lib.gmsv_abi_version.argtypes = []
+            if lib.gmsv_abi_version() == GMSV_ABI_VERSION:
+                _set_prototypes(lib)
+                GMSV_LIB = lib
+    if GMSV_LIB is False:
+        return None
+    return GMSV_LIB
+
+def _set_prototypes(lib):
+    """
+    Argument and return types of the gmsvlib.h functions
+    """
+    float_p = ctypes.POINTER(ctypes.c_float)
+    header_p = ctypes.POINTER(Header)
+    c_int = ctypes.c_int
+    c_float = ctypes.c_float
+
+    lib.gmsv_alloc.restype = float_p
+    lib.gmsv_alloc.argtypes = [c_int]
+    lib.gmsv_free.restype = None
+    lib.gmsv_free.argtypes = [ctypes.c_void_p]
+    lib.gmsv_read_wcc.restype = float_p
+    lib.gmsv_read_wcc.argtypes = [ctypes.c_char_p, c_int, header_p]
+    lib.gmsv_write_wcc.restype = None
+    lib.gmsv_write_wcc.argtypes = [ctypes.c_char_p, c_int, header_p, float_p]
+    for func in (lib.gmsv_cfft, lib.gmsv_rfft_r2c, lib.gmsv_rfft_c2r):
+        func.restype = None
+        func.argtypes = [float_p, c_int, c_int]
+    lib.gmsv_fftpad.restype = c_int
+    lib.gmsv_fftpad.argtypes = [c_int]
+    lib.gmsv_stage_new.restype = ctypes.c_void_p
+    lib.gmsv_stage_new.argtypes = [ctypes.c_char_p]
+    lib.gmsv_stage_apply.restype = float_p
+    lib.gmsv_stage_apply.argtypes = [ctypes.c_void_p, float_p, header_p]
+    lib.gmsv_stage_room.restype = c_int
+    lib.gmsv_stage_room.argtypes = [ctypes.c_void_p, c_int]
+    lib.gmsv_stage_apply_buf.restype = float_p
+    lib.gmsv_stage_apply_buf.argtypes = [ctypes.c_void_p, float_p, c_int,
+                                         header_p]
+    lib.gmsv_stage_peak.restype = c_float
+    lib.gmsv_stage_peak.argtypes = [ctypes.c_void_p]
+    lib.gmsv_stage_free.restype = None
+    lib.gmsv_stage_free.argtypes = [ctypes.c_void_p]
+    lib.gmsv_resid.restype = None
+    lib.gmsv_resid.argtypes = [float_p, float_p, c_int, float_p, float_p,
+                               c_int, float_p, c_int, float_p]
+    lib.gmsv_srf_open.restype = ctypes.c_void_p
+    lib.gmsv_srf_open.argtypes = [ctypes.c_char_p, ctypes.c_char_p]
+    lib.gmsv_srf_version.restype = c_float
+    lib.gmsv_srf_version.argtypes = [ctypes.c_void_p]
+    lib.gmsv_srf_nseg.restype = c_int
+    lib.gmsv_srf_nseg.argtypes = [ctypes.c_void_p]
+    lib.gmsv_srf_plane.restype = c_int
+    lib.gmsv_srf_plane.argtypes = [ctypes.c_void_p, c_int,
+                                   ctypes.POINTER(SrfPlane)]
+    lib.gmsv_srf_npoints.restype = c_int
+    lib.gmsv_srf_npoints.argtypes = [ctypes.c_void_p, c_int]
+    lib.gmsv_srf_points.restype = c_int
+    lib.gmsv_srf_points.argtypes = [ctypes.c_void_p, c_int, c_int, c_int,
+                                    float_p,
+                                    ctypes.POINTER(ctypes.c_longlong)]
+    lib.gmsv_srf_hypocenter.restype = c_int
+    lib.gmsv_srf_hypocenter.argtypes = [ctypes.c_void_p, float_p]
+    lib.gmsv_srf_moment.restype = ctypes.c_double
+    lib.gmsv_srf_moment.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+    lib.gmsv_srf_close.restype = None
+    lib.gmsv_srf_close.argtypes = [ctypes.c_void_p]
+    lib.gmsv_baseline.restype = c_int
+    lib.gmsv_baseline.argtypes = [float_p, c_int, c_int, c_int]
+    for func in [lib.gmsv_xy2ll, lib.gmsv_ll2xy]:
+        func.restype = c_int
+        func.argtypes = [float_p, float_p, c_int, c_float, c_float, c_float,
+                         float_p, float_p]
+    lib.gmsv_fault_dist.restype = c_int
+    lib.gmsv_fault_dist.argtypes = [float_p, c_int, float_p, float_p, c_int,
+                                    c_int, float_p, float_p, float_p]
+    lib.gmsv_fault_plane.restype = c_int
+    lib.gmsv_fault_plane.argtypes = [c_float, c_float, c_float, c_float,
+                                     c_float, c_float, c_float, float_p]
+    lib.gmsv_rotd_compute.restype = c_int
+    lib.gmsv_rotd_compute.argtypes = [float_p, float_p, c_int, c_float,
+                                      float_p, c_int, c_float, c_int,
+                                      float_p, c_int, c_int, c_int,
+                                      c_float, c_int,
+                                      float_p, float_p, float_p]
+    lib.gmsv_rotd_compute_batch.restype = c_int
+    lib.gmsv_rotd_compute_batch.argtypes = [float_p, float_p, c_int, c_int,
+                                            c_float, float_p, c_int,
+                                            c_float, c_int, float_p, c_int,
+                                            c_int, float_p, float_p, float_p]
+
+def _get_library():
+    """
+    Same as load_library, but raises an error if libgmsv is missing
+    """
+    lib = load_library()
+    if lib is None:
+        raise OSError("libgmsv.so not found, build it with "
+                      "make libgmsv in src/gp/WccFormat")
+    return lib
+
+def _to_trace(lib, samples):
+    """
+    Copies samples to a block from gmsv_alloc
+    """
+    nt = len(samples)
+    trace = lib.gmsv_alloc(nt)
+    ctypes.memmove(trace, (ctypes.c_float * nt)(*samples), nt * 4)
+    return trace
+
+def read_wcc(filename, inbin=0):
+    """
+    Reads a WCC file (binary if inbin), returns the Header and the
+    list of samples
+    """
+    lib = _get_library()
+    header = Header()
+    trace = lib.gmsv_read_wcc(filename.encode(), inbin, ctypes.byref(header))
+    samples = trace[0:header.nt]
+    lib.gmsv_free(trace)
+    return header, samples
+
+def write_wcc(filename, header, samples, outbin=0):
+    """
+    Writes the header.nt first samples to a WCC file
+    """
+    lib = _get_library()
+    trace = (ctypes.c_float * header.nt)(*samples[0:header.nt])
+    lib.gmsv_write_wcc(filename.encode(), outbin, ctypes.byref(header), trace)
+
+class Stage(object):
+    """
+    A processing stage, from a line of a wcc_pipeline stagefile such
+    as "tfilter fhi=0.1 flo=20.0 order=4". The arguments are those of
+    the tool of the same name, bad ones end the process as they end
+    the tool
+    """
+    def __init__(self, spec):
+        self.lib = _get_library()
+        self.spec = spec
+        self.stage = self.lib.gmsv_stage_new(spec.encode())
+
+    def __del__(self):
+        if getattr(self, "stage", None):
+            self.lib.gmsv_stage_free(self.stage)
+            self.stage = None
+
+    def apply(self, header, samples):
+        """
+        Runs the stage on the samples, returns the new list; header
+        is updated when the stage changes nt or dt
+        """
+        return run_stages([self], header, samples)
+
+    def peak(self):
+        """
+        Peak of the last trace, for a getpeak stage
+        """
+        return self.lib.gmsv_stage_peak(self.stage)
+
+def run_stages(stages, header, samples):
+    """
+    Runs the list of Stage objects on samples, in order, with a single
+    copy in and out. Returns the new list of samples, header is updated
+    """
+    lib = _get_library()
+    header.nt = len(samples)
+    trace = _to_trace(lib, samples)
+    for stage in stages:
+        trace = lib.gmsv_stage_apply(stage.stage, trace, ctypes.byref(header))
+    samples = trace[0:header.nt]
+    lib.gmsv_free(trace)
+    return samples
+
+def float32_array(values):
+    """
+    values as a contiguous float32 array, the array itself (no copy)
+    when it already is one
+    """
+    import numpy as np
+
+    return np.ascontiguousarray(values, dtype=np.float32)
+
+def float_pointer(array):
+    """
+    float * to the samples of a float32_array, valid while array is
+    """
+    return array.ctypes.data_as(ctypes.POINTER(ctypes.c_float))
+
+def trace_room(stages, nt):
+    """
+    Size of an array of nt samples that all the stages can run in
+    without copying (see run_stages_array)
+    """
+    lib = _get_library()
+    return max([nt] + [lib.gmsv_stage_room(stage.stage, nt)
+                       for stage in stages])
+
+def run_stages_array(stages, header, data):
+    """
+    Runs the list of Stage objects on the first header.nt samples of
+    data, a writeable contiguous float32 array (all of it if header.nt
+    is 0). The stages work in data itself, siteamp14 when data has
+    trace_room samples; a resamp_arbdt stage, or a siteamp14 without
+    the room, goes on in a new array. Returns the header.nt samples of
+    the result, a view of data when nothing had to be copied. header
+    is updated
+    """
+    import numpy as np
+
+    lib = _get_library()
+    if (not isinstance(data, np.ndarray) or data.dtype != np.float32 or
+            data.ndim != 1 or not data.flags.c_contiguous or
+            not data.flags.writeable):
+        raise ValueError("run_stages_array: data must be a writeable "
+                         "contiguous 1-D float32 array")
+    if header.nt <= 0:
+        header.nt = len(data)
+    if header.nt > len(data):
+        raise ValueError("run_stages_array: header.nt > len(data)")
+    for stage in stages:
+        trace = lib.gmsv_stage_apply_buf(stage.stage, float_pointer(data),
+                                         len(data), ctypes.byref(header))
+        if ctypes.cast(trace, ctypes.c_void_p).value != data.ctypes.data:
+            data = np.ctypeslib.as_array(trace, shape=(header.nt,)).copy()
+            lib.gmsv_free(trace)
+    return data[0:header.nt]
+
+def resid(obs_periods, obs, sim_periods, sim, periods):
+    """
+    Residuals log(obs/sim) on periods as gen_resid_tbl_batch computes
+    them, obs and sim being interpolated from their own period grids.
+    Returns a list, -99 where sim is 0 or the period is out of range
+    """
+    lib = _get_library()
+    ndo = len(obs_periods)
+    nds = len(sim_periods)
+    nper = len(periods)
+    c_res = (ctypes.c_float * nper)()
+    lib.gmsv_resid((ctypes.c_float * ndo)(*obs_periods),
+                   (ctypes.c_float * ndo)(*obs[0:ndo]), ndo,
+                   (ctypes.c_float * nds)(*sim_periods),
+                   (ctypes.c_float * nds)(*sim[0:nds]), nds,
+                   (ctypes.c_float * nper)(*periods), nper, c_res)
+    return list(c_res)
+
+def float32_value(value):
+    """
+    The shortest decimal that reads back as the float32 value, so
+    34.1 stored in a float comes back as 34.1
+    """
+    packed = ctypes.c_float(value).value
+    for digits in range(6, 10):
+        short = float("%.*g" % (digits, packed))
+        if ctypes.c_float(short).value == packed:
+            return short
+    return packed
+
+class SrfFile(object):
+    """
+    An SRF file read once by libgmsv (gmsv_srf_open). index_file, if
+    given, keeps the index of the points for the next open, which then
+    does not read the SRF again while it does not change
+    """
+    def __init__(self, srf_file, index_file=None):
+        self.lib = _get_library()
+        self.srf_file = srf_file
+        self.srf = self.lib.gmsv_srf_open(srf_file.encode(),
+                                          (index_file or "").encode())
+        if not self.srf:
+            raise IOError("Cannot read SRF file %s" % (srf_file))
+
+    def __del__(self):
+        if getattr(self, "srf", None):
+            self.lib.gmsv_srf_close(self.srf)
+            self.srf = None
+
+    def version(self):
+        """
+        Version in the first line of the SRF
+        """
+        return float32_value(self.lib.gmsv_srf_version(self.srf))
+
+    def num_segments(self):
+        """
+        Segments in the PLANE block, 0 without one
+        """
+        return self.lib.gmsv_srf_nseg(self.srf)
+
+    def plane(self, segment):
+        """
+        The PLANE parameters of segment (0-based) as a dictionary
+        """
+        plane = SrfPlane()
+        if self.lib.gmsv_srf_plane(self.srf, segment,
+                                   ctypes.byref(plane)) != 0:
+            raise IndexError("SRF file %s has no segment %d" %
+                             (self.srf_file, segment))
+        values = {}
+        for name, ctype in SrfPlane._fields_:
+            values[name] = getattr(plane, name)
+            if ctype is ctypes.c_float:
+                values[name] = float32_value(values[name])
+        return values
+
+    def num_points(self, segment=-1):
+        """
+        Points of segment, of the whole file for segment < 0
+        """
+        return self.lib.gmsv_srf_npoints(self.srf, segment)
+
+    def points(self, segment=-1, first=0, count=None):
+        """
+        (lon, lat, dep) of count points from first in segment, as
+        srf2xyz lonlatdep=1 lists them
+        """
+        if count is None:
+            count = self.num_points(segment) - first
+        if count <= 0:
+            return []
+        values = (ctypes.c_float * (3 * count))()
+        count = self.lib.gmsv_srf_points(self.srf, segment, first, count,
+                                         values, None)
+        return [(float32_value(values[3 * idx]),
+                 float32_value(values[3 * idx + 1]),
+                 float32_value(values[3 * idx + 2]))
+                for idx in range(count)]
+
+    def hypocenter(self):
+        """
+        lon, lat, dep of the point with the earliest rupture time
+        """
+        hypo = (ctypes.c_float * 3)()
+        if self.lib.gmsv_srf_hypocenter(self.srf, hypo) != 0:
+            raise ValueError("SRF file %s has no points" % (self.srf_file))
+        return [float32_value(value) for value in hypo]
+
+    def moment(self, velfile):
+        """
+        Seismic moment (dyne-cm), mu from the 1D velocity model velfile
+        """
+        moment = self.lib.gmsv_srf_moment(self.srf, velfile.encode())
+        if moment < 0.0:
+            raise IOError("Cannot read velocity model %s" % (velfile))
+        return moment
+
+def baseline(data, order):
+    """
+    Removes the least squares polynomial of the given order (as
+    integ_diff rbase=order) from each row of data, a writeable
+    contiguous float32 array of one trace (1-D) or of many traces of
+    one length (2-D), in place. All the rows are fitted in one call
+    """
+    import numpy as np
+
+    lib = _get_library()
+    if (not isinstance(data, np.ndarray) or data.dtype != np.float32 or
+            data.ndim not in (1, 2) or not data.flags.c_contiguous or
+            not data.flags.writeable):
+        raise ValueError("baseline: data must be a writeable contiguous "
+                         "1-D or 2-D float32 array")
+    if data.ndim == 1:
+        ntr, nt = 1, data.shape[0]
+    else:
+        ntr, nt = data.shape
+    if lib.gmsv_baseline(float_pointer(data), nt, ntr, order) != 0:
+        raise ValueError("baseline: order %d out of range or singular fit" %
+                         (order))
+    return data
+
+def _project(func, in_1, in_2, mlon, mlat, xazim):
+    """
+    Runs gmsv_xy2ll or gmsv_ll2xy on the points in_1, in_2
+    """
+    import numpy as np
+
+    in_1 = float32_array(in_1)
+    in_2 = float32_array(in_2)
+    if len(in_1) != len(in_2):
+        raise ValueError("projection: coordinate arrays differ in length")
+    out_1 = np.zeros(len(in_1), dtype=np.float32)
+    out_2 = np.zeros(len(in_1), dtype=np.float32)
+    func(float_pointer(in_1), float_pointer(in_2), len(in_1),
+         mlon, mlat, xazim, float_pointer(out_1), float_pointer(out_2))
+    return out_1, out_2
+
+def xy2ll(x, y, mlon, mlat, xazim):
+    """
+    Model coordinates x, y (km) of any number of points to lon, lat,
+    the great circle projection of xy2ll mlat= mlon= xazim=. Returns
+    two float32 arrays
+    """
+    return _project(_get_library().gmsv_xy2ll, x, y, mlon, mlat, xazim)
+
+def ll2xy(lon, lat, mlon, mlat, xazim):
+    """
+    The reverse of xy2ll, as ll2xy mlat= mlon= xazim=
+    """
+    return _project(_get_library().gmsv_ll2xy, lon, lat, mlon, mlat, xazim)
+
+# Floats of a fault rectangle, FDIST_NPAR of ModelCords/faultdist.h
+FAULT_RECT_NPAR = 8
+
+def fault_plane(lon, lat, dtop, length, width, strike, dip):
+    """
+    The rectangle (lon, lat, dep of its center, strike, dip, length,
+    width, segment 0) of the plane of an SRC file, lon, lat being the
+    center of its top edge
+    """
+    lib = _get_library()
+    rect = (ctypes.c_float * FAULT_RECT_NPAR)()
+    if lib.gmsv_fault_plane(lon, lat, dtop, length, width,
+                            strike, dip, rect) != 0:
+        raise ValueError("fault_plane: length and width must be > 0")
+    return list(rect)
+
+def fault_dist(rects, lons, lats, nthreads=1):
+    """
+    Rrup, Rjb and Rx (km) from the stations lons, lats to the fault
+    rectangles rects (lists of FAULT_RECT_NPAR values, see fault_plane),
+    all the stations in one call. Returns three lists
+    """
+    lib = _get_library()
+    nrect = len(rects)
+    nsta = len(lons)
+    if len(lats) != nsta:
+        raise ValueError("fault_dist: lons and lats differ in length")
+    c_rects = (ctypes.c_float * (FAULT_RECT_NPAR * max(nrect, 1)))()
+    for idx, rect in enumerate(rects):
+        if len(rect) < FAULT_RECT_NPAR - 1:
+            raise ValueError("fault_dist: rectangle %d has %d values" %
+                             (idx, len(rect)))
+        c_rects[FAULT_RECT_NPAR * idx:
+                FAULT_RECT_NPAR * idx + len(rect)] = rect[0:FAULT_RECT_NPAR]
+    c_rrup = (ctypes.c_float * nsta)()
+    c_rjb = (ctypes.c_float * nsta)()
+    c_rx = (ctypes.c_float * nsta)()
+    if lib.gmsv_fault_dist(c_rects, nrect, (ctypes.c_float * nsta)(*lons),
+                           (ctypes.c_float * nsta)(*lats), nsta, nthreads,
+                           c_rrup, c_rjb, c_rx) < 0:
+        raise ValueError("fault_dist: no fault rectangles")
+    return list(c_rrup), list(c_rjb), list(c_rx)
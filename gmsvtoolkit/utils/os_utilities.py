@@ -37,22 +37,149 @@ from __future__ import division, print_function
 # Import Python modules
 import os
 import sys
+import shlex
+import atexit
+import threading
 import traceback
 import subprocess
 
 # GMSVToolkit files
 from core import exceptions
+from core import gmsvtoolkit_config
 
 # Set to the maximum allows filename in the GP codebase
 GP_MAX_FILENAME = 256
 # Set to the maximum allowed filename in the SDSU codebase
 SDSU_MAX_FILENAME = 256
 
-def runprog(cmd, print_cmd=True, abort_on_error=False):
+# Command line option selecting the server mode of the entry points
+SERVE_OPTION = "--serve"
+
+# Parameters of a wcc_pipeline command line that a worker job takes
+WORKER_PARAMS = ["stagefile", "infile", "outfile", "inbin", "outbin"]
+WORKER_PATHS = ["stagefile", "infile", "outfile"]
+
+class GMSVWorker(object):
+    """
+    A wcc_pipeline serve=1 worker, started on the first job and kept
+    until close() (or the end of the program), so the stages it parsed
+    (site-amp tables, filter sections) and the FFT plans stay loaded
+    from one job to the next. Jobs are sent one at a time, the threads
+    of a pool take turns
+    """
+
+    def __init__(self, program=None):
+        if program is None:
+            install = gmsvtoolkit_config.GMSVToolKitConfig.get_instance()
+            program = os.path.join(install.GP_BIN_DIR, "wcc_pipeline")
+        self.program = program
+        self.proc = None
+        self.lock = threading.Lock()
+
+    def job(self, cmd, cwd=None):
+        """
+        The worker job for the command line cmd, None unless cmd is a
+        single trace wcc_pipeline run (stagefile=, infile=, outfile=,
+        inbin=, outbin= and nothing else, no redirections). The paths
+        are made absolute, relative to cwd if given
+        """
+        try:
+            args = shlex.split(cmd)
+        except ValueError:
+            return None
+        if not args or os.path.basename(args[0]) != "wcc_pipeline":
+            return None
+        params = {}
+        for arg in args[1:]:
+            key, sep, value = arg.partition("=")
+            if (not sep or key not in WORKER_PARAMS or not value or
+                    any([char in value for char in " \t|<>;&$`"])):
+                return None
+            if key in WORKER_PATHS:
+                value = os.path.abspath(os.path.join(cwd or os.curdir, value))
+            params[key] = value
+        if "infile" not in params or "outfile" not in params:
+            return None
+        return " ".join(["%s=%s" % (key, params[key]) for key in
+                         WORKER_PARAMS if key in params])
+
+    def run(self, job):
+        """
+        Runs one job, printing the lines it writes (getpeak), returns its
+        status, or None if the worker could not be started or went away
+        (it ends on bad stage parameters), in which case the next job
+        starts a new one
+        """
+        with self.lock:
+            try:
+                if self.proc is None or self.proc.poll() is not None:
+                    self.proc = subprocess.Popen([self.program, "serve=1"],
+                                                 stdin=subprocess.PIPE,
+                                                 stdout=subprocess.PIPE,
+                                                 universal_newlines=True)
+                self.proc.stdin.write("%s\n" % (job))
+                self.proc.stdin.flush()
+                for line in iter(self.proc.stdout.readline, ""):
+                    if line.startswith("[DONE]"):
+                        return int(line.split()[1])
+                    sys.stdout.write(line)
+            except (OSError, IOError, ValueError):
+                pass
+            self.proc = None
+            return None
+
+    def close(self):
+        """
+        Ends the worker
+        """
+        with self.lock:
+            if self.proc is not None and self.proc.poll() is None:
+                try:
+                    self.proc.stdin.write("quit\n")
+                    self.proc.stdin.close()
+                except (OSError, IOError, ValueError):
+                    pass
+                self.proc.wait()
+            self.proc = None
+
+# Worker shared by the runprog calls with worker=True
+WORKER = None
+
+def get_worker():
+    """
+    Returns the shared GMSVWorker, ended at exit
+    """
+    global WORKER
+    if WORKER is None:
+        WORKER = GMSVWorker()
+        atexit.register(WORKER.close)
+    return WORKER
+
+def runprog(cmd, print_cmd=True, abort_on_error=False, cwd=None,
+            worker=None):
     """
     Run a program on the command line and capture the output and print
-    the output to stdout
+    the output to stdout. With cwd the program runs in that directory,
+    the caller's working directory is not changed. With worker (a
+    GMSVWorker, or True for the shared one) a command the worker can
+    run (see GMSVWorker.job) is sent to it instead of to a shell; if
+    the worker is not there the command runs as usual
     """
+    if worker is True:
+        worker = get_worker()
+    if worker is not None:
+        job = worker.job(cmd, cwd)
+        if job is not None:
+            if print_cmd:
+                print("Running: %s" % (cmd))
+            status = worker.run(job)
+            if status is not None:
+                if abort_on_error and status != 0:
+                    raise exceptions.GMSVToolkitExternalError("%s returned %d" %
+                                                              (cmd, status))
+                return status
+            print_cmd = False
+
     # Check if we have a binary to run
     if not os.access(cmd.split()[0], os.X_OK) and cmd.startswith("/"):
         raise exceptions.GMSVToolkitExternalError("%s does not seem an executable path!" %
@@ -61,7 +188,7 @@ def runprog(cmd, print_cmd=True, abort_on_error=False):
     try:
         if print_cmd:
             print("Running: %s" % (cmd))
-        proc = subprocess.Popen(cmd, shell=True)
+        proc = subprocess.Popen(cmd, shell=True, cwd=cwd)
         proc.wait()
     except KeyboardInterrupt:
         print("Interrupted!")
@@ -175,6 +302,72 @@ def list_subdirs(d):
     # Use list comprehension
     return [sub for sub in os.listdir(d) if os.path.isdir(os.path.join(d, sub))]
 
+def serve_commands(run_command, input_file=None, output_file=None):
+    """
+    Server mode of the entry points: reads one command line (the
+    arguments the module would get, shell quoted) per line of
+    input_file (stdin) and runs run_command(argument list) for each in
+    this process, so the interpreter start-up, the imports and the
+    loaded libraries and caches are paid for once rather than per
+    station. Blank lines and lines starting with # are skipped, "quit"
+    ends the loop. After each command "[DONE] status" goes to
+    output_file (stdout), status being the exit code the command would
+    have had (0 when it returns, 1 on an exception). Returns the number
+    of commands that failed
+    """
+    if input_file is None:
+        input_file = sys.stdin
+    if output_file is None:
+        output_file = sys.stdout
+
+    # readline rather than iterating over the file, which reads ahead
+    # and would wait for more commands than the one sent
+    failed = 0
+    for line in iter(input_file.readline, ""):
+        line = line.strip()
+        if not line or line.startswith('#'):
+            continue
+        if line == "quit":
+            break
+
+        try:
+            run_command(shlex.split(line))
+            status = 0
+        except SystemExit as err:
+            if err.code is None:
+                status = 0
+            elif isinstance(err.code, int):
+                status = err.code
+            else:
+                print(err.code, file=sys.stderr)
+                status = 1
+        except Exception:
+            traceback.print_exc()
+            status = 1
+        if status != 0:
+            failed = failed + 1
+
+        sys.stdout.flush()
+        sys.stderr.flush()
+        output_file.write("[DONE] %d\n" % (status))
+        output_file.flush()
+
+    return failed
+
+def run_entry_point(run_command, argv=None):
+    """
+    The main of an entry point: run_command(None) to take the arguments
+    from sys.argv, or with SERVE_OPTION as the only argument the
+    server mode (serve_commands)
+    """
+    if argv is None:
+        argv = sys.argv[1:]
+    if argv == [SERVE_OPTION]:
+        if serve_commands(run_command) != 0:
+            sys.exit(1)
+        return
+    run_command(None)
+
 if __name__ == "__main__":
     print("Testing: %s" % (sys.argv[0]))
     CMD = "/bin/date"
@@ -45,85 +45,132 @@ from __future__ import division, print_function
 PEER_HEADER_LINES = 6
 
 # Import Python modules
+import os
 import sys
+import array
+import struct
+import operator
+import multiprocessing
+from itertools import accumulate, chain, repeat
 
 # Import GMSVToolkit modules
 from core import constants
 from core import exceptions
-from utils.file_utilities import bbp_get_dt, bbp_get_num_samples, peer_get_num_lines
+from utils.file_utilities import bbp_get_dt, bbp_get_num_samples
+from utils.file_utilities import read_file_bbp2
+
+# WCC binary header (struct statdata in src/gp/WccFormat/structure.h):
+# stat, comp, stitle, nt, dt, hr, min, sec, edist, az, baz
+WCC_BIN_HEADER = "=12s4s64sifiiffff"
+
+def read_peer_file(in_peer_file):
+    """
+    Reads a PEER file in one pass, returns its lines, the number of
+    lines before the data and dt
+    """
+    try:
+        with open(in_peer_file, 'r') as peer_file:
+            text = peer_file.read()
+    except OSError as e:
+        print("[ERROR]: error reading file: %s" % (e.filename))
+        sys.exit(1)
+
+    lines = text.split("\n")
+    if not lines[-1]:
+        # File ends with a newline
+        lines.pop()
+
+    # Header ends with the "Acceleration in g" line
+    idx = 0
+    while idx < len(lines):
+        pieces = lines[idx].split()
+        idx = idx + 1
+        if pieces and pieces[0].lower() == "acceleration":
+            break
+
+    # Next line should have dt and number of points in the file
+    num_header_lines = idx + 1
+    dt = None
+    if idx < len(lines):
+        pieces = lines[idx].split()
+        if len(pieces) > 1:
+            dt = float(pieces[1])
+
+    return lines, num_header_lines, dt
 
 def peer2bbp(in_peer_n_file, in_peer_e_file, in_peer_z_file, out_bbp_file):
     """
     This function converts the 3 input peer files (N/E/Z) to a
     3-component bbp file
     """
-    # Check if input files match
-    num_lines_n = peer_get_num_lines(in_peer_n_file)
-    num_lines_e = peer_get_num_lines(in_peer_e_file)
-    num_lines_z = peer_get_num_lines(in_peer_z_file)
+    lines_n, num_header_lines, dt = read_peer_file(in_peer_n_file)
+    lines_e, _, _ = read_peer_file(in_peer_e_file)
+    lines_z, _, _ = read_peer_file(in_peer_z_file)
 
-    if num_lines_n == num_lines_e  == num_lines_z:
+    # Check if input files match
+    if len(lines_n) == len(lines_e)  == len(lines_z):
         # Good, this is what we want!
         pass
     else:
         raise exceptions.ProcessingError("Input files don't have "
                                          "same number of lines!")
-
-    # Write bbp file header
+    if dt is None:
+        raise exceptions.ProcessingError("Cannot find NPTS, DT line "
+                                         "in %s!" % (in_peer_n_file))
+
+    # The E and Z headers are skipped line for line with the N one,
+    # their data start on the same line
+    lines_n = lines_n[num_header_lines:]
+    lines_e = lines_e[num_header_lines:]
+    lines_z = lines_z[num_header_lines:]
+
+    # Split all the samples at once, the line layout only matters if
+    # the three files are laid out differently
+    pieces_n = " ".join(lines_n).split()
+    pieces_e = " ".join(lines_e).split()
+    pieces_z = " ".join(lines_z).split()
+    if not len(pieces_n) == len(pieces_e) == len(pieces_z):
+        pieces_n, pieces_e, pieces_z = peer_lockstep_samples(lines_n,
+                                                             lines_e,
+                                                             lines_z)
+    npts = len(pieces_n)
+
+    # Same values as float(piece) * G2CMSS and cur_dt = cur_dt + dt
+    # one sample at a time
+    vals_n = map(operator.mul, map(float, pieces_n), repeat(constants.G2CMSS))
+    vals_e = map(operator.mul, map(float, pieces_e), repeat(constants.G2CMSS))
+    vals_z = map(operator.mul, map(float, pieces_z), repeat(constants.G2CMSS))
+    times = accumulate(chain([0.0], repeat(dt, max(npts - 1, 0))))
+    rows = tuple(chain.from_iterable(zip(times, vals_n, vals_e, vals_z)))
+
+    # Write bbp file in one go
     bbp_file = open(out_bbp_file, "w")
     bbp_file.write("#    time(sec)      N-S(cm/s/s)      E-W(cm/s/s)      U-D(cm/s/s)\n")
-
-    # Open input files
-    with open(in_peer_n_file, 'r') as peer_fn_n, open(in_peer_e_file, 'r') as peer_fn_e, open(in_peer_z_file, 'r') as peer_fn_z:
-        # First read header
-        for line_n, line_e, line_z in zip(peer_fn_n, peer_fn_e, peer_fn_z):
-            line_n = line_n.strip()
-            line_e = line_e.strip()
-            line_z = line_z.strip()
-            
-            if not line_n:
-                continue
-
-            pieces_n = line_n.split()
-            pieces_e = line_e.split()
-            pieces_z = line_z.split()
-
-            if pieces_n[0].lower() == "acceleration":
-                break
-
-        # Next line should have dt and number of points in the file
-        line_n = peer_fn_n.readline()
-        line_e = peer_fn_e.readline()
-        line_z = peer_fn_z.readline()
-
-        line_n = line_n.strip()
-        pieces_n = line_n.split()
-        
-        pts = float(pieces_n[0])
-        dt = float(pieces_n[1])
-        cur_dt = 0.0
-
-        # Now read the data
-        for line_n, line_e, line_z in zip(peer_fn_n, peer_fn_e, peer_fn_z):
-            line_n = line_n.strip()
-            line_e = line_e.strip()
-            line_z = line_z.strip()
-            
-            if not line_n:
-                continue
-
-            pieces_n = [float(piece) * constants.G2CMSS for piece in line_n.split()]
-            pieces_e = [float(piece) * constants.G2CMSS for piece in line_e.split()]
-            pieces_z = [float(piece) * constants.G2CMSS for piece in line_z.split()]
-
-            for piece_n, piece_e, piece_z in zip(pieces_n, pieces_e, pieces_z):
-                bbp_file.write("%7e   % 8e   % 8e   % 8e\n" % (cur_dt, piece_n,
-                                                               piece_e, piece_z))
-                cur_dt = cur_dt + dt
-        
-    # Close output the file
+    bbp_file.write(("%7e   % 8e   % 8e   % 8e\n" * npts) % rows)
     bbp_file.close()
 
+def peer_lockstep_samples(lines_n, lines_e, lines_z):
+    """
+    Samples of three PEER files read line by line in lockstep, the
+    way peer2bbp always did: lines blank in the N file are skipped
+    and each line gives as many samples as its shortest component
+    """
+    pieces_n = []
+    pieces_e = []
+    pieces_z = []
+    for line_n, line_e, line_z in zip(lines_n, lines_e, lines_z):
+        line_n = line_n.split()
+        if not line_n:
+            continue
+        line_e = line_e.split()
+        line_z = line_z.split()
+        num = min(len(line_n), len(line_e), len(line_z))
+        pieces_n.extend(line_n[0:num])
+        pieces_e.extend(line_e[0:num])
+        pieces_z.extend(line_z[0:num])
+
+    return pieces_n, pieces_e, pieces_z
+
 def bbp2peer(in_bbp_file, out_peer_n_file, out_peer_e_file, out_peer_z_file):
     """
     Convert bbp file into three peer files for use by RotD50/100 and
@@ -131,7 +178,6 @@ def bbp2peer(in_bbp_file, out_peer_n_file, out_peer_e_file, out_peer_z_file):
     """
     npts = bbp_get_num_samples(in_bbp_file)
     dt = bbp_get_dt(in_bbp_file)
-    num_header_lines = 0
     header_lines = []
 
     # Open file
@@ -139,7 +185,6 @@ def bbp2peer(in_bbp_file, out_peer_n_file, out_peer_e_file, out_peer_z_file):
 
     # Loop through header
     while(True):
-        pos = bbp_file.tell()
         line = bbp_file.readline()
         if not line:
             # Test for EOF
@@ -150,70 +195,128 @@ def bbp2peer(in_bbp_file, out_peer_n_file, out_peer_e_file, out_peer_z_file):
             continue
         if line.startswith("#") or line.startswith("%"):
             # Keep track of comments
-            num_header_line = num_header_lines + 1
             header_lines.append("%s\n" % (line))
             continue
         # line contains first data point
         break
 
-    # Go back to previous line so we read the first data point again
-    bbp_file.seek(pos)
+    # Only the header is needed from here, the data come from the parse
+    bbp_file.close()
+    _, n_vals, e_vals, z_vals = read_file_bbp2(in_bbp_file)
 
     # Adjust header lines, so we always have enough
     while len(header_lines) <= (PEER_HEADER_LINES - 2):
         header_lines.append("\n")
 
-    # Prepare to write 6 colume format
-    n_file = open(out_peer_n_file, "w")
-    e_file = open(out_peer_e_file, "w")
-    z_file = open(out_peer_z_file, "w")
-
-    for line in header_lines[0:(PEER_HEADER_LINES - 2)]:
-        n_file.write(line)
-        e_file.write(line)
-        z_file.write(line)
-
-    n_file.write("Acceleration in g\n")
-    n_file.write("  %d   %1.6f   NPTS, DT\n" % (npts, dt))
-    e_file.write("Acceleration in g\n")
-    e_file.write("  %d   %1.6f   NPTS, DT\n" % (npts, dt))
-    z_file.write("Acceleration in g\n")
-    z_file.write("  %d   %1.6f   NPTS, DT\n" % (npts, dt))
-
-    cur_item = 0
-    for line in bbp_file:
-        line = line.strip()
-        if not line:
-            continue
-        if line.startswith("#") or line.startswith("%"):
-            continue
-        pieces = [float(piece) for piece in line.split()]
-        n_val = (float(pieces[1]) / constants.G2CMSS)
-        e_val = (float(pieces[2]) / constants.G2CMSS)
-        z_val = (float(pieces[3]) / constants.G2CMSS)
+    header = ("%sAcceleration in g\n  %d   %1.6f   NPTS, DT\n" %
+              ("".join(header_lines[0:(PEER_HEADER_LINES - 2)]), npts, dt))
+
+    # 5 values per line, the last line is always terminated (to avoid
+    # an issue when rotd50.f reads the file, only when compiled with
+    # gfortran 4.3.3 on HPCC) and gets an empty line after it when full
+    num_full = (npts // 5) * 5
+    for out_peer_file, vals in [(out_peer_n_file, n_vals),
+                                (out_peer_e_file, e_vals),
+                                (out_peer_z_file, z_vals)]:
+        vals = (vals[0:npts] / constants.G2CMSS).tolist()
+        peer_file = open(out_peer_file, "w")
+        peer_file.write(header)
+        peer_file.write(("% 12.7E % 12.7E % 12.7E % 12.7E % 12.7E \n" *
+                         (num_full // 5)) % tuple(vals[0:num_full]))
+        peer_file.write(("% 12.7E " * (npts - num_full)) %
+                        tuple(vals[num_full:]))
+        peer_file.write("\n")
+        peer_file.close()
+
+def bbp2peer_job(job):
+    """
+    Runs bbp2peer on a (bbp, peer_n, peer_e, peer_z) tuple, for the
+    Pool in convert_files
+    """
+    bbp2peer(*job)
+
+def peer2bbp_job(job):
+    """
+    Runs peer2bbp on a (peer_n, peer_e, peer_z, bbp) tuple, for the
+    Pool in convert_files
+    """
+    peer2bbp(*job)
 
-        # Write data
-        n_file.write("% 12.7E " % (n_val))
-        e_file.write("% 12.7E " % (e_val))
-        z_file.write("% 12.7E " % (z_val))
+def convert_files(function, jobs, num_procs=1):
+    """
+    Runs one of bbp2peer_job or peer2bbp_job on a list of stations,
+    with num_procs processes
+    """
+    num_procs = max(1, min(num_procs, len(jobs)))
+    if num_procs > 1:
+        pool = multiprocessing.Pool(num_procs)
+        pool.map(function, jobs,
+                 chunksize=max(1, len(jobs) // (4 * num_procs)))
+        pool.close()
+        pool.join()
+    else:
+        for job in jobs:
+            function(job)
 
-        if (cur_item % 5) == 4:
-            n_file.write("\n")
-            e_file.write("\n")
-            z_file.write("\n")
+def bbp2peer_dir(input_dir, output_dir, num_procs=1):
+    """
+    Converts all bbp files in input_dir into PEER files in output_dir,
+    station.bbp (or station.acc.bbp) gives station.000.peer,
+    station.090.peer and station.ver.peer.  Returns the list of
+    (bbp, peer_n, peer_e, peer_z) files
+    """
+    jobs = []
+    for input_file in sorted(os.listdir(input_dir)):
+        if not input_file.endswith(".bbp"):
+            continue
+        base = input_file[0:-len(".bbp")]
+        if base.endswith(".acc"):
+            base = base[0:-len(".acc")]
+        jobs.append((os.path.join(input_dir, input_file),
+                     os.path.join(output_dir, "%s.000.peer" % (base)),
+                     os.path.join(output_dir, "%s.090.peer" % (base)),
+                     os.path.join(output_dir, "%s.ver.peer" % (base))))
+    convert_files(bbp2peer_job, jobs, num_procs)
+
+    return jobs
+
+def peer2bbp_dir(input_dir, output_dir, num_procs=1):
+    """
+    The reverse of bbp2peer_dir, the station.000.peer, station.090.peer
+    and station.ver.peer files in input_dir give station.acc.bbp in
+    output_dir.  Returns the list of (peer_n, peer_e, peer_z, bbp) files
+    """
+    jobs = []
+    for input_file in sorted(os.listdir(input_dir)):
+        if not input_file.endswith(".000.peer"):
+            continue
+        base = input_file[0:-len(".000.peer")]
+        jobs.append((os.path.join(input_dir, input_file),
+                     os.path.join(input_dir, "%s.090.peer" % (base)),
+                     os.path.join(input_dir, "%s.ver.peer" % (base)),
+                     os.path.join(output_dir, "%s.acc.bbp" % (base))))
+    convert_files(peer2bbp_job, jobs, num_procs)
 
-        cur_item = cur_item + 1
+    return jobs
 
-    # Done reading input file
-    bbp_file.close()
-    
-    # Add newline at the end of last line to avoid issue when rotd50.f
-    # reads the file (only when compiled with gfortran 4.3.3 on HPCC)
-    n_file.write("\n")
-    e_file.write("\n")
-    z_file.write("\n")
-
-    # Close all files
-    n_file.close()
-    e_file.close()
-    z_file.close()
+def bbp2wccbin(in_bbp_file, out_n_file, out_e_file, out_z_file):
+    """
+    Same as bbp2peer, but writes the three components (in g) in the
+    WCC binary layout (write_wccseis with bflag=1), which the rotd
+    programs read in one transfer instead of parsing text
+    """
+    dt = bbp_get_dt(in_bbp_file)
+    _, n_vals, e_vals, z_vals = read_file_bbp2(in_bbp_file)
+    n_vals = array.array('f', [val / constants.G2CMSS for val in n_vals])
+    e_vals = array.array('f', [val / constants.G2CMSS for val in e_vals])
+    z_vals = array.array('f', [val / constants.G2CMSS for val in z_vals])
+
+    for out_file, comp, vals in [(out_n_file, b"000", n_vals),
+                                 (out_e_file, b"090", e_vals),
+                                 (out_z_file, b"ver", z_vals)]:
+        wcc_file = open(out_file, "wb")
+        wcc_file.write(struct.pack(WCC_BIN_HEADER, b"", comp,
+                                   b"Acceleration in g", len(vals),
+                                   dt, 0, 0, 0.0, 0.0, 0.0, 0.0))
+        vals.tofile(wcc_file)
+        wcc_file.close()
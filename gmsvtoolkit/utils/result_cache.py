@@ -0,0 +1,240 @@
+#!/usr/bin/env python
+"""
+BSD 3-Clause License
+
+Copyright (c) 2022, University of Southern California
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+Content-addressed cache of computed results (RotD spectra, residual
+tables) used in the GMSVToolkit
+"""
+from __future__ import division, print_function
+
+# Import Python modules
+import os
+import zlib
+import struct
+import hashlib
+import tempfile
+import threading
+
+# The cache is off unless GMSVTOOLKIT_CACHE_DIR names a directory.
+# GMSVTOOLKIT_CACHE_MB bounds its size on disk, the least recently
+# used entries are removed when a new one takes it over the bound.
+CACHE_DIR_ENV = "GMSVTOOLKIT_CACHE_DIR"
+CACHE_SIZE_ENV = "GMSVTOOLKIT_CACHE_MB"
+CACHE_DEFAULT_MB = 1024
+CACHE_MAGIC = b"GMSVRC01"
+CACHE_SUFFIX = ".bin"
+
+_CACHE = None
+_CACHE_LOCK = threading.Lock()
+
+def _key_part(part):
+    """
+    Bytes of one component of a cache key. Floats are packed as
+    doubles and lists or tuples item by item, each part prefixed with
+    its type and length so that no two different keys concatenate to
+    the same bytes
+    """
+    if isinstance(part, (bytes, bytearray, memoryview)):
+        data = b"b" + bytes(part)
+    elif isinstance(part, str):
+        data = b"s" + part.encode("utf-8")
+    elif isinstance(part, bool) or isinstance(part, int):
+        data = b"i" + struct.pack("<q", int(part))
+    elif isinstance(part, float):
+        data = b"f" + struct.pack("<d", part)
+    elif isinstance(part, (list, tuple)):
+        data = b"l" + b"".join([_key_part(item) for item in part])
+    elif part is None:
+        data = b"n"
+    else:
+        raise TypeError("result_cache: can't hash a %s" % (type(part)))
+    return struct.pack("<Q", len(data)) + data
+
+def make_key(kind, *parts):
+    """
+    Returns the hex SHA-256 of kind (the name of the computation,
+    which should change with its output format) and parts, the input
+    data and every parameter the result depends on
+    """
+    sha = hashlib.sha256()
+    sha.update(_key_part(kind))
+    for part in parts:
+        sha.update(_key_part(part))
+    return sha.hexdigest()
+
+def file_digest(filename):
+    """
+    SHA-256 of the contents of filename, to key results on the data
+    of a file rather than on its name
+    """
+    sha = hashlib.sha256()
+    with open(filename, 'rb') as input_file:
+        for block in iter(lambda: input_file.read(1 << 20), b""):
+            sha.update(block)
+    return sha.digest()
+
+class ResultCache(object):
+    """
+    Directory of results keyed by make_key. Each entry is a file
+    named after its key, holding the magic, the key and the zlib
+    compressed result. A hit updates the entry's mtime, which orders
+    the entries for the LRU eviction. Entries are written to a
+    temporary file and renamed, so several threads or processes can
+    share the directory, and a damaged entry reads as a miss
+    """
+
+    def __init__(self, cache_dir, max_bytes):
+        self.cache_dir = cache_dir
+        self.max_bytes = max_bytes
+        self.total_bytes = None
+        self.lock = threading.Lock()
+        if not os.path.isdir(cache_dir):
+            os.makedirs(cache_dir)
+
+    def entry_file(self, key):
+        """
+        Entries go in 256 subdirectories, on the first key byte
+        """
+        return os.path.join(self.cache_dir, key[0:2], key + CACHE_SUFFIX)
+
+    def get(self, key):
+        """
+        Returns the bytes stored under key, None on a miss
+        """
+        entry_file = self.entry_file(key)
+        try:
+            with open(entry_file, 'rb') as input_file:
+                data = input_file.read()
+        except (IOError, OSError):
+            return None
+        head_len = len(CACHE_MAGIC) + len(key)
+        if data[0:head_len] != CACHE_MAGIC + key.encode("ascii"):
+            return None
+        try:
+            result = zlib.decompress(data[head_len:])
+        except zlib.error:
+            return None
+        try:
+            os.utime(entry_file, None)
+        except OSError:
+            pass
+        return result
+
+    def put(self, key, result):
+        """
+        Stores the bytes result under key, then trims the cache to
+        max_bytes
+        """
+        entry_file = self.entry_file(key)
+        entry_dir = os.path.dirname(entry_file)
+        data = CACHE_MAGIC + key.encode("ascii") + zlib.compress(result, 6)
+        try:
+            if not os.path.isdir(entry_dir):
+                os.makedirs(entry_dir)
+        except OSError:
+            # Made by another process in the meantime
+            pass
+        try:
+            old_size = os.path.getsize(entry_file)
+        except OSError:
+            old_size = 0
+        fd, temp_file = tempfile.mkstemp(dir=entry_dir, suffix=".tmp")
+        try:
+            with os.fdopen(fd, 'wb') as output_file:
+                output_file.write(data)
+            os.rename(temp_file, entry_file)
+        except (IOError, OSError):
+            if os.path.exists(temp_file):
+                os.remove(temp_file)
+            return
+
+        with self.lock:
+            if self.total_bytes is None:
+                self.total_bytes = sum([size for _, size, _ in self.entries()])
+            else:
+                self.total_bytes = self.total_bytes + len(data) - old_size
+            if self.total_bytes > self.max_bytes:
+                self.evict()
+
+    def entries(self):
+        """
+        Returns (mtime, size, path) of every entry in the cache
+        """
+        entries = []
+        for sub_dir in os.listdir(self.cache_dir):
+            sub_path = os.path.join(self.cache_dir, sub_dir)
+            if len(sub_dir) != 2 or not os.path.isdir(sub_path):
+                continue
+            for entry in os.listdir(sub_path):
+                if not entry.endswith(CACHE_SUFFIX):
+                    continue
+                entry_path = os.path.join(sub_path, entry)
+                try:
+                    stat = os.stat(entry_path)
+                except OSError:
+                    continue
+                entries.append((stat.st_mtime, stat.st_size, entry_path))
+        return entries
+
+    def evict(self):
+        """
+        Removes the least recently used entries until the cache is
+        down to 3/4 of max_bytes, so that it is not trimmed again on
+        every put. Rescans the directory, which other processes may
+        have filled too
+        """
+        entries = sorted(self.entries())
+        total_bytes = sum([size for _, size, _ in entries])
+        target = self.max_bytes * 3 // 4
+        for _, size, entry_path in entries:
+            if total_bytes <= target:
+                break
+            try:
+                os.remove(entry_path)
+            except OSError:
+                continue
+            total_bytes = total_bytes - size
+        self.total_bytes = total_bytes
+
+def get_cache():
+    """
+    Returns the ResultCache of GMSVTOOLKIT_CACHE_DIR, None if the
+    cache is not enabled
+    """
+    global _CACHE
+    cache_dir = os.environ.get(CACHE_DIR_ENV, "")
+    if not cache_dir:
+        return None
+    with _CACHE_LOCK:
+        if _CACHE is None or _CACHE.cache_dir != cache_dir:
+            max_mb = float(os.environ.get(CACHE_SIZE_ENV, CACHE_DEFAULT_MB))
+            _CACHE = ResultCache(cache_dir, int(max_mb * 1024 * 1024))
+    return _CACHE
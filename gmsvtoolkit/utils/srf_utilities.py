@@ -37,6 +37,7 @@ from __future__ import division, print_function
 # Import Python modules
 import os
 import sys
+import math
 import uuid
 import shutil
 import tempfile
@@ -45,11 +46,39 @@ import tempfile
 from core import exceptions
 from utils import os_utilities
 from core import gmsvtoolkit_config
+from utils import gmsvlib
+
+# SRF files read by libgmsv in this process, by path
+SRF_FILES = {}
+# Index of the points, kept next to the SRF when its directory is writable
+SRF_INDEX_SUFFIX = ".gidx"
+
+def open_srf(srf_file):
+    """
+    Returns the gmsvlib.SrfFile of srf_file, read once per process
+    while the file does not change, or None without libgmsv, in which
+    case the functions below run the GP programs instead
+    """
+    if gmsvlib.load_library() is None:
+        return None
+    srf_path = os.path.abspath(srf_file)
+    srf_stat = os.stat(srf_path)
+    stamp = (srf_stat.st_size, srf_stat.st_mtime)
+    if srf_path not in SRF_FILES or SRF_FILES[srf_path][0] != stamp:
+        index_file = None
+        if os.access(os.path.dirname(srf_path), os.W_OK):
+            index_file = srf_path + SRF_INDEX_SUFFIX
+        SRF_FILES[srf_path] = (stamp, gmsvlib.SrfFile(srf_path, index_file))
+    return SRF_FILES[srf_path][1]
 
 def get_magnitude(velfile, srffile, suffix="tmp"):
     """
     Scans the srffile and returns the magnitude of the event
     """
+    srf = open_srf(srffile)
+    if srf is not None:
+        return 2.0 / 3.0 * math.log10(srf.moment(velfile)) - 10.7
+
     magfile = os.path.join(tempfile.gettempdir(),
                            "%s_%s" %
                            (str(uuid.uuid4()), suffix))
@@ -73,6 +102,10 @@ def get_hypocenter(srffile, suffix="tmp"):
     """
     Looks up the hypocenter of an event in a srffile
     """
+    srf = open_srf(srffile)
+    if srf is not None:
+        return srf.hypocenter()
+
     hypfile = os.path.join(tempfile.gettempdir(),
                            "%s_%s" %
                            (str(uuid.uuid4()), suffix))
@@ -98,13 +131,17 @@ def get_srf_num_segments(srf_file):
     """
     srf_segments = None
 
-    srf = open(srf_file, 'r')
-    for line in srf:
-        if line.startswith("PLANE"):
-            # Found the plane line, read number of segments
-            srf_segments = int(line.split()[1])
-            break
-    srf.close()
+    lib_srf = open_srf(srf_file)
+    if lib_srf is not None:
+        srf_segments = lib_srf.num_segments() or None
+    else:
+        srf = open(srf_file, 'r')
+        for line in srf:
+            if line.startswith("PLANE"):
+                # Found the plane line, read number of segments
+                srf_segments = int(line.split()[1])
+                break
+        srf.close()
 
     if srf_segments is None:
         print("[ERROR]: Could not read number of segments from "
@@ -119,6 +156,25 @@ def get_srf_params(srf_file, segment=0):
     Reads fault_len, width, dlen, dwid, and azimuth from the srf_file
     Segment allows users to specify segment of interest (0-based)
     """
+    lib_srf = open_srf(srf_file)
+    if lib_srf is not None:
+        srf_segments = lib_srf.num_segments()
+        if srf_segments < segment + 1:
+            print("[ERROR]: Requested parameters from segment %d, "
+                  "       SRF file only has %d segment(s)!" %
+                  (segment + 1, srf_segments))
+            sys.exit(1)
+        plane = lib_srf.plane(segment)
+        params = {}
+        params["lon"] = plane["elon"]
+        params["lat"] = plane["elat"]
+        params["dim_len"] = plane["nstk"]
+        params["dim_wid"] = plane["ndip"]
+        params["fault_len"] = plane["len"]
+        params["fault_width"] = plane["wid"]
+        params["azimuth"] = int(plane["stk"])
+        return params
+
     srf_params1 = None
     srf_params2 = None
     srf = open(srf_file, 'r')
@@ -176,6 +232,13 @@ def get_srf_info(srf_file):
     num_segments = None
     nstk = []
 
+    lib_srf = open_srf(srf_file)
+    if lib_srf is not None:
+        num_segments = lib_srf.num_segments()
+        nstk = [lib_srf.plane(segment)["nstk"]
+                for segment in range(num_segments)]
+        return int(lib_srf.version()), num_segments, nstk
+
     # Read SRF file
     input_file = open(srf_file, 'r')
     for line in input_file:
@@ -227,6 +290,11 @@ def read_srf_trace(srf_file, num_segment, nstk):
     This function reads an SRF file and returns the
     top layer trace for the segment specified
     """
+    lib_srf = open_srf(srf_file)
+    if lib_srf is not None:
+        return [(lon, lat) for lon, lat, _ in
+                lib_srf.points(num_segment, 0, nstk)]
+
     install = gmsvtoolkit_config.GMSVToolKitConfig.get_instance()
 
     srf2xyz_bin = os.path.join(install.GP_BIN_DIR, "srf2xyz")